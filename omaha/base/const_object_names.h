@@ -138,6 +138,12 @@ const TCHAR* const kOptUserIdLock =
 const TCHAR* const kExternalUpdaterActivityPrefix =
     _T("UpdaterRunning");
 
+// The client processing a bundle creates this event to be notified when the
+// state of the apps in the bundle changes, instead of polling the COM server.
+// The session id of the bundle is appended to this string, and the standard
+// prefixes for Omaha events are prepended. The COM server sets the event.
+const TCHAR* const kBundleProgressEventPrefix = _T("BundleProgress");
+
 // The name of the shared memory objects containing the serialized COM
 // interface pointers exposed by the machine core.
 // TODO(omaha): Rename these constants to remove "GoogleUpdate".
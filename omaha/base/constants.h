@@ -334,10 +334,27 @@ const TCHAR* const kRegValueIsEnrolledToDomain = _T("IsEnrolledToDomain");
 const TCHAR* const kRegValueAlwaysAllowCrashUploads =
     _T("AlwaysAllowCrashUploads");
 
+// Runs the work items of goopdate on the work-stealing executor instead of the
+// Windows thread pool if the value is not 0. Unlike the Windows thread pool,
+// the executor does not grow: it has max(8, 2 * number of processors) threads.
+// Since the bundle calls block on the network and on the installers, that many
+// busy bundles delay the work items queued after them until one completes.
+const TCHAR* const kRegValueUseExecutorThreadPool = _T("UseExecutorThreadPool");
+
 // Overrides the default maximum number of crash uploads we make per day.
 const TCHAR* const kRegValueMaxCrashUploadsPerDay =
     _T("MaxCrashUploadsPerDay");
 
+// Overrides the number of threads which download the apps of a bundle ahead
+// of the app being installed. A value of 0 disables the download ahead.
+const TCHAR* const kRegValueBundleDownloadConcurrency =
+    _T("BundleDownloadConcurrency");
+
+// Overrides the number of packages of an app which are downloaded
+// concurrently. Values 0 and 1 download the packages one after the other.
+const TCHAR* const kRegValuePackageDownloadConcurrency =
+    _T("PackageDownloadConcurrency");
+
 const TCHAR* const kRegValueDisableUpdateAppsHourlyJitter =
     _T("DisableUpdateAppsHourlyJitter");
 
@@ -458,6 +475,16 @@ const int kMinCodeRedCheckPeriodMs  = 60 * 1000;              // 1 minute.
 // be in OEM mode regardless of audit mode.
 const int kMinOemModeSec = 72 * 60 * 60;  // 72 hours.
 
+// The default and the maximum number of threads which download the apps of a
+// bundle while the installer of a previous app in the bundle is running.
+const int kDefaultBundleDownloadConcurrency = 2;
+const int kMaxBundleDownloadConcurrency     = 8;
+
+// The default and the maximum number of packages of an app which are
+// downloaded at the same time.
+const int kDefaultPackageDownloadConcurrency = 3;
+const int kMaxPackageDownloadConcurrency     = 8;
+
 // The amount of time to wait for the setup lock before giving up.
 const int kSetupLockWaitMs = 1000;  // 1 second.
 
@@ -1020,6 +1020,7 @@ void DebugAbort(const TCHAR *msg,
                 bool do_abort) {
   DebugReport(0, R_FATAL, "", msg, filename, linenumber, DEBUGREPORT_ABORT);
   if (do_abort) {
+    FLUSH_LOG();
     abort();
   }
 }
@@ -1062,6 +1063,7 @@ void ReleaseAbort(const TCHAR *msg,
              MB_OK | MB_SETFOREGROUND | MB_TOPMOST);
 
   if (do_abort) {
+    FLUSH_LOG();
     abort();
   }
 }
@@ -192,6 +192,14 @@ const ULONG kFacilityOmaha = 67;
 #define GOOPDATEDOWNLOAD_E_CACHING_FAILED           \
     MAKE_OMAHA_HRESULT(SEVERITY_ERROR, 0x50D)
 
+// The differential package is malformed or does not apply to its base.
+#define GOOPDATEDOWNLOAD_E_INVALID_PATCH            \
+    MAKE_OMAHA_HRESULT(SEVERITY_ERROR, 0x50E)
+
+// The base of the differential package is not in the package cache.
+#define GOOPDATEDOWNLOAD_E_PATCH_BASE_NOT_FOUND     \
+    MAKE_OMAHA_HRESULT(SEVERITY_ERROR, 0x50F)
+
 #define GOOPDATEDOWNLOAD_E_FAILED_MOVE              \
     MAKE_HRESULT(SEVERITY_ERROR, FACILITY_ITF, 0x5FF)
 
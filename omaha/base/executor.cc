@@ -0,0 +1,274 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/base/executor.h"
+
+#include <system_error>
+#include <utility>
+
+namespace omaha {
+
+namespace {
+
+// The executor and the index of the worker running on the current thread, if
+// any. The tasks submitted by a task are queued to the worker running it.
+thread_local const Executor* current_executor = nullptr;
+thread_local size_t current_worker_index = 0;
+
+}  // namespace
+
+Executor::Executor(int num_threads,
+                   size_t max_queued_tasks,
+                   ExecutorObserver* observer)
+    : num_threads_(num_threads > 0 ? num_threads : 1),
+      max_queued_tasks_(max_queued_tasks),
+      observer_(observer),
+      next_worker_(0),
+      is_exiting_(false),
+      num_queued_(0),
+      num_running_(0),
+      is_running_(false),
+      is_stopping_(false) {
+  for (int i = 0; i != num_threads_; ++i) {
+    workers_.push_back(std::unique_ptr<Worker>(new Worker));
+  }
+}
+
+Executor::~Executor() {
+  Stop(0);
+}
+
+bool Executor::Start() {
+  std::unique_lock<std::mutex> lock(state_lock_);
+  if (is_running_) {
+    return true;
+  }
+
+  is_exiting_ = false;
+  for (size_t i = 0; i != workers_.size(); ++i) {
+    try {
+      workers_[i]->thread = std::thread(&Executor::WorkerLoop, this, i);
+    } catch (const std::system_error&) {
+      is_exiting_ = true;
+      lock.unlock();
+      work_available_.notify_all();
+      for (size_t j = 0; j != i; ++j) {
+        workers_[j]->thread.join();
+      }
+      return false;
+    }
+  }
+
+  is_running_ = true;
+  return true;
+}
+
+bool Executor::Stop(int timeout_ms) {
+  std::unique_lock<std::mutex> lock(state_lock_);
+  if (!is_running_ || is_stopping_) {
+    return true;
+  }
+  is_stopping_ = true;
+
+  const bool is_drained = idle_.wait_for(
+      lock,
+      std::chrono::milliseconds(timeout_ms > 0 ? timeout_ms : 0),
+      [this]() { return !num_queued_ && !num_running_; });
+
+  is_running_ = false;
+  is_exiting_ = true;
+  lock.unlock();
+  work_available_.notify_all();
+
+  for (size_t i = 0; i != workers_.size(); ++i) {
+    workers_[i]->thread.join();
+  }
+
+  const size_t num_discarded = DiscardQueuedTasks();
+
+  lock.lock();
+  num_queued_ = 0;
+  is_stopping_ = false;
+  return is_drained && !num_discarded;
+}
+
+bool Executor::Submit(Task task, const TaskOptions& options) {
+  const ExecutorPriority priority = options.priority;
+
+  QueuedTask queued_task;
+  queued_task.task = std::move(task);
+  queued_task.cancellation_token = options.cancellation_token;
+  queued_task.on_cancelled = options.on_cancelled;
+  queued_task.priority = priority;
+  queued_task.queued_time = Clock::now();
+
+  // The task is queued under |state_lock_| so that Stop finds every task
+  // counted in |num_queued_| in the queues.
+  size_t queue_depth = 0;
+  {
+    std::lock_guard<std::mutex> lock(state_lock_);
+    if (is_running_ &&
+        (!max_queued_tasks_ || num_queued_ < max_queued_tasks_)) {
+      Worker* worker = workers_[SelectWorker()].get();
+      std::lock_guard<std::mutex> worker_lock(worker->lock);
+      worker->queues[priority].push_back(std::move(queued_task));
+      queue_depth = ++num_queued_;
+    }
+  }
+
+  if (!queue_depth) {
+    if (observer_) {
+      observer_->OnTaskRejected(priority);
+    }
+    return false;
+  }
+
+  work_available_.notify_one();
+  if (observer_) {
+    observer_->OnTaskQueued(priority, queue_depth);
+  }
+  return true;
+}
+
+bool Executor::HasTasks() const {
+  std::lock_guard<std::mutex> lock(state_lock_);
+  return num_queued_ || num_running_;
+}
+
+size_t Executor::num_queued_tasks() const {
+  std::lock_guard<std::mutex> lock(state_lock_);
+  return num_queued_;
+}
+
+bool Executor::RunsTasksOnCurrentThread() const {
+  return current_executor == this;
+}
+
+void Executor::WorkerLoop(size_t index) {
+  current_executor = this;
+  current_worker_index = index;
+
+  while (!is_exiting_) {
+    QueuedTask task;
+    bool is_stolen = false;
+    if (TakeTask(index, &task, &is_stolen)) {
+      RunTask(&task, is_stolen);
+      continue;
+    }
+
+    // Another worker may have taken a task without having uncounted it yet,
+    // in which case the worker looks again instead of sleeping.
+    std::unique_lock<std::mutex> lock(state_lock_);
+    if (!is_exiting_ && !num_queued_) {
+      work_available_.wait(lock);
+    }
+  }
+
+  current_executor = nullptr;
+}
+
+bool Executor::TakeTask(size_t index, QueuedTask* task, bool* is_stolen) {
+  const size_t num_workers = workers_.size();
+
+  for (int priority = 0; priority != EXECUTOR_PRIORITY_COUNT; ++priority) {
+    for (size_t i = 0; i != num_workers; ++i) {
+      Worker* worker = workers_[(index + i) % num_workers].get();
+      {
+        std::lock_guard<std::mutex> lock(worker->lock);
+        std::deque<QueuedTask>& queue = worker->queues[priority];
+        if (queue.empty()) {
+          continue;
+        }
+
+        // The owner takes its oldest task, so that its tasks start in the
+        // order they were queued. Thieves take the newest one, which the owner
+        // would have started last.
+        if (!i) {
+          *task = std::move(queue.front());
+          queue.pop_front();
+        } else {
+          *task = std::move(queue.back());
+          queue.pop_back();
+        }
+      }
+      *is_stolen = i != 0;
+
+      // |state_lock_| is never acquired while holding the lock of a worker.
+      std::lock_guard<std::mutex> lock(state_lock_);
+      --num_queued_;
+      ++num_running_;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void Executor::RunTask(QueuedTask* task, bool is_stolen) {
+  if (task->cancellation_token && task->cancellation_token->IsCancelled()) {
+    if (observer_) {
+      observer_->OnTaskCancelled(task->priority);
+    }
+    if (task->on_cancelled) {
+      task->on_cancelled();
+    }
+  } else {
+    if (observer_) {
+      const int64 queue_latency_us =
+          std::chrono::duration_cast<std::chrono::microseconds>(
+              Clock::now() - task->queued_time).count();
+      observer_->OnTaskStarted(task->priority, queue_latency_us, is_stolen);
+    }
+    task->task();
+  }
+
+  // The task is destroyed before it stops counting as running, so that
+  // nothing it owns outlives Stop.
+  task->task = nullptr;
+  task->cancellation_token.reset();
+  task->on_cancelled = nullptr;
+
+  std::lock_guard<std::mutex> lock(state_lock_);
+  --num_running_;
+  if (!num_queued_ && !num_running_) {
+    idle_.notify_all();
+  }
+}
+
+size_t Executor::SelectWorker() {
+  if (RunsTasksOnCurrentThread()) {
+    return current_worker_index;
+  }
+  return next_worker_++ % workers_.size();
+}
+
+size_t Executor::DiscardQueuedTasks() {
+  size_t num_discarded = 0;
+  for (size_t i = 0; i != workers_.size(); ++i) {
+    std::deque<QueuedTask> discarded[EXECUTOR_PRIORITY_COUNT];
+    {
+      std::lock_guard<std::mutex> lock(workers_[i]->lock);
+      for (int priority = 0; priority != EXECUTOR_PRIORITY_COUNT; ++priority) {
+        discarded[priority].swap(workers_[i]->queues[priority]);
+      }
+    }
+    for (int priority = 0; priority != EXECUTOR_PRIORITY_COUNT; ++priority) {
+      num_discarded += discarded[priority].size();
+    }
+  }
+  return num_discarded;
+}
+
+}  // namespace omaha
@@ -0,0 +1,201 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+//
+// A pool of worker threads which runs tasks by priority. Each worker has one
+// queue per priority. The tasks submitted from a worker thread are queued to
+// that worker and the other tasks are spread over the workers. A worker runs
+// the oldest task of its own queue, or else steals the newest task of the
+// queue of another worker, always taking the highest priority first.
+//
+// The executor only uses the C++ standard library so that it can be tested
+// and benchmarked on any platform. ExecutorThreadPool runs the UserWorkItems
+// of goopdate on it.
+
+#ifndef OMAHA_BASE_EXECUTOR_H_
+#define OMAHA_BASE_EXECUTOR_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "base/basictypes.h"
+
+namespace omaha {
+
+// The priorities, from the highest to the lowest.
+enum ExecutorPriority {
+  // Work which a user is waiting for, such as the on-demand update checks.
+  EXECUTOR_PRIORITY_INTERACTIVE = 0,
+
+  // Work done on behalf of no one in particular, such as the update checks
+  // of UpdateAllApps and the pings.
+  EXECUTOR_PRIORITY_BACKGROUND,
+
+  EXECUTOR_PRIORITY_COUNT,
+};
+
+// Cancelled by the owner of some work to tell the tasks doing it to stop.
+// Tasks which have not started yet are not run. Tasks which are running are
+// expected to check the token at convenient points.
+class CancellationToken {
+ public:
+  CancellationToken() : is_cancelled_(false) {}
+
+  void Cancel() { is_cancelled_ = true; }
+  bool IsCancelled() const { return is_cancelled_; }
+
+ private:
+  std::atomic<bool> is_cancelled_;
+
+  DISALLOW_COPY_AND_ASSIGN(CancellationToken);
+};
+
+// Receives the events of an executor, for instance to record metrics. The
+// functions are called without any lock held, on the threads submitting and
+// running the tasks, and must be thread safe.
+class ExecutorObserver {
+ public:
+  virtual ~ExecutorObserver() {}
+
+  // |queue_depth| is the number of tasks waiting to run, including this one.
+  virtual void OnTaskQueued(ExecutorPriority priority, size_t queue_depth) = 0;
+
+  // The task was not queued because the queue was full or because the
+  // executor was not running.
+  virtual void OnTaskRejected(ExecutorPriority priority) = 0;
+
+  // |is_stolen| is true if the task was queued to another worker.
+  virtual void OnTaskStarted(ExecutorPriority priority,
+                             int64 queue_latency_us,
+                             bool is_stolen) = 0;
+
+  // The cancellation token of the task was cancelled before the task started.
+  virtual void OnTaskCancelled(ExecutorPriority priority) = 0;
+};
+
+class Executor {
+ public:
+  typedef std::function<void()> Task;
+
+  struct TaskOptions {
+    TaskOptions() : priority(EXECUTOR_PRIORITY_BACKGROUND) {}
+
+    ExecutorPriority priority;
+
+    // Optional. If the token is cancelled before the task starts, the task is
+    // not run and |on_cancelled| is run instead, if any.
+    std::shared_ptr<const CancellationToken> cancellation_token;
+    Task on_cancelled;
+  };
+
+  // Submit fails once |max_queued_tasks| tasks are waiting to run. Zero
+  // means that the queue is unbounded. |observer| is optional and must
+  // outlive the executor.
+  Executor(int num_threads,
+           size_t max_queued_tasks,
+           ExecutorObserver* observer);
+
+  // Stops the executor without waiting for the queued tasks.
+  ~Executor();
+
+  // Starts the worker threads. Returns false if they can't be created.
+  bool Start();
+
+  // Waits up to |timeout_ms| for the queued tasks to run, including the tasks
+  // they queue meanwhile, then stops accepting tasks. The tasks which have not
+  // started by then are destroyed without running. Then waits for the running
+  // tasks to return and joins the worker threads. Returns false if any task
+  // was destroyed without running. Must not be called by a task.
+  bool Stop(int timeout_ms);
+
+  // Queues |task|. Returns false if the queue is full or if the executor is
+  // not running, in which case |task| is destroyed.
+  bool Submit(Task task, const TaskOptions& options);
+
+  // Returns true if there are tasks waiting to run or running.
+  bool HasTasks() const;
+
+  size_t num_queued_tasks() const;
+
+  // Returns true if the current thread is a worker of this executor.
+  bool RunsTasksOnCurrentThread() const;
+
+  int num_threads() const { return num_threads_; }
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+
+  struct QueuedTask {
+    QueuedTask() : priority(EXECUTOR_PRIORITY_BACKGROUND) {}
+
+    Task task;
+    std::shared_ptr<const CancellationToken> cancellation_token;
+    Task on_cancelled;
+    ExecutorPriority priority;
+    Clock::time_point queued_time;
+  };
+
+  struct Worker {
+    std::mutex lock;
+    std::deque<QueuedTask> queues[EXECUTOR_PRIORITY_COUNT];
+    std::thread thread;
+  };
+
+  void WorkerLoop(size_t index);
+
+  // Takes the next task for the worker at |index|.
+  bool TakeTask(size_t index, QueuedTask* task, bool* is_stolen);
+
+  void RunTask(QueuedTask* task, bool is_stolen);
+
+  // Returns the index of the worker to queue a new task to.
+  size_t SelectWorker();
+
+  // Destroys the queued tasks and returns how many there were.
+  size_t DiscardQueuedTasks();
+
+  const int num_threads_;
+  const size_t max_queued_tasks_;
+  ExecutorObserver* const observer_;
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::atomic<size_t> next_worker_;
+
+  // Set when the workers must exit, even if tasks are queued.
+  std::atomic<bool> is_exiting_;
+
+  // Guards the members below. The workers sleep on |work_available_| while
+  // the queues are empty and Stop waits on |idle_| for the queues to drain.
+  mutable std::mutex state_lock_;
+  std::condition_variable work_available_;
+  std::condition_variable idle_;
+  size_t num_queued_;
+  size_t num_running_;
+  bool is_running_;
+  bool is_stopping_;
+
+  DISALLOW_COPY_AND_ASSIGN(Executor);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_BASE_EXECUTOR_H_
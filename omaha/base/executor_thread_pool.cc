@@ -0,0 +1,143 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/base/executor_thread_pool.h"
+
+#include <utility>
+
+#include "omaha/base/debug.h"
+#include "omaha/base/error.h"
+#include "omaha/base/logging.h"
+#include "omaha/base/utils.h"
+
+namespace omaha {
+
+namespace {
+
+// Processes or cancels the work item in |slot| in a COM apartment, then
+// destroys it. The work item is shared by the task and its cancellation
+// handler, only one of which runs.
+void RunWorkItem(std::shared_ptr<std::unique_ptr<UserWorkItem>> slot,
+                 DWORD coinit_flags,
+                 bool is_cancelled) {
+  ASSERT1(slot && *slot);
+
+  scoped_co_init init_com_apt(coinit_flags);
+  ASSERT1(SUCCEEDED(init_com_apt.hresult()));
+
+  if (is_cancelled) {
+    UTIL_LOG(L3, (_T("[ExecutorThreadPool][work item cancelled]")));
+    (*slot)->Cancel();
+  } else {
+    (*slot)->Process();
+  }
+  slot->reset();
+}
+
+}  // namespace
+
+ExecutorThreadPool::ExecutorThreadPool()
+    : is_stopped_(true),
+      shutdown_delay_(0) {
+  UTIL_LOG(L2, (_T("[ExecutorThreadPool::ExecutorThreadPool]")));
+}
+
+ExecutorThreadPool::~ExecutorThreadPool() {
+  UTIL_LOG(L2, (_T("[ExecutorThreadPool::~ExecutorThreadPool]")));
+  ASSERT1(is_stopped());
+
+  // Joins the worker threads. The work items which have not started are
+  // destroyed without running.
+  executor_.reset();
+}
+
+HRESULT ExecutorThreadPool::Initialize(int num_threads,
+                                       size_t max_queued_work_items,
+                                       int shutdown_delay,
+                                       ExecutorObserver* observer) {
+  ASSERT1(!executor_);
+
+  shutdown_delay_ = shutdown_delay;
+  reset(shutdown_event_, ::CreateEvent(NULL, true, false, NULL));
+  if (!shutdown_event_) {
+    return HRESULTFromLastError();
+  }
+
+  executor_.reset(new Executor(num_threads, max_queued_work_items, observer));
+  if (!executor_->Start()) {
+    executor_.reset();
+    return E_OUTOFMEMORY;
+  }
+
+  set_is_stopped(false);
+  return S_OK;
+}
+
+void ExecutorThreadPool::Stop() {
+  UTIL_LOG(L2, (_T("[ExecutorThreadPool::Stop]")));
+
+  if (is_stopped()) {
+    return;
+  }
+
+  // The executor can't join the thread calling Stop.
+  ASSERT1(executor_);
+  ASSERT1(!executor_->RunsTasksOnCurrentThread());
+  VERIFY1(::SetEvent(get(shutdown_event_)));
+  if (!executor_->Stop(shutdown_delay_)) {
+    UTIL_LOG(LE, (_T("[ExecutorThreadPool::Stop][timeout elapsed]")));
+  }
+
+  set_is_stopped(true);
+}
+
+HRESULT ExecutorThreadPool::QueueUserWorkItem(
+    std::unique_ptr<UserWorkItem> work_item,
+    DWORD coinit_flags,
+    uint32 flags) {
+  UTIL_LOG(L4, (_T("[ExecutorThreadPool::QueueUserWorkItem]")));
+  ASSERT1(work_item);
+  UNREFERENCED_PARAMETER(flags);
+
+  if (is_stopped()) {
+    return E_FAIL;
+  }
+
+  work_item->set_shutdown_event(get(shutdown_event_));
+
+  Executor::TaskOptions options;
+  options.priority = work_item->priority();
+  options.cancellation_token = work_item->cancellation_token();
+
+  auto slot =
+      std::make_shared<std::unique_ptr<UserWorkItem>>(std::move(work_item));
+  options.on_cancelled = [slot, coinit_flags]() {
+    RunWorkItem(slot, coinit_flags, true);
+  };
+  if (!executor_->Submit([slot, coinit_flags]() {
+                           RunWorkItem(slot, coinit_flags, false);
+                         },
+                         options)) {
+    return is_stopped() ? E_FAIL : HRESULT_FROM_WIN32(ERROR_NOT_ENOUGH_QUOTA);
+  }
+
+  return S_OK;
+}
+
+bool ExecutorThreadPool::HasWorkItems() const {
+  return executor_ && executor_->HasTasks();
+}
+
+}  // namespace omaha
@@ -0,0 +1,86 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+//
+// Runs UserWorkItems on an Executor, with the same interface as ThreadPool.
+// Unlike ThreadPool, the work items run by priority on a fixed number of
+// threads, and the work items whose cancellation token is cancelled before
+// they start are cancelled instead of processed.
+
+#ifndef OMAHA_BASE_EXECUTOR_THREAD_POOL_H_
+#define OMAHA_BASE_EXECUTOR_THREAD_POOL_H_
+
+#include <windows.h>
+
+#include <memory>
+
+#include "base/basictypes.h"
+#include "omaha/base/executor.h"
+#include "omaha/base/thread_pool.h"
+#include "omaha/third_party/smartany/scoped_any.h"
+
+namespace omaha {
+
+class ExecutorThreadPool {
+ public:
+  ExecutorThreadPool();
+
+  // The destructor might block for 'shutdown_delay'.
+  ~ExecutorThreadPool();
+
+  // |max_queued_work_items| of 0 means that the queue is unbounded.
+  // |observer| is optional and must outlive the thread pool.
+  HRESULT Initialize(int num_threads,
+                     size_t max_queued_work_items,
+                     int shutdown_delay,
+                     ExecutorObserver* observer);
+
+  // Must not be called by a work item.
+  void Stop();
+
+  // Adds a work item to the queue of its priority. |flags| are ignored.
+  // Returns HRESULT_FROM_WIN32(ERROR_NOT_ENOUGH_QUOTA) if the queue is full.
+  HRESULT QueueUserWorkItem(std::unique_ptr<UserWorkItem> work_item,
+                            DWORD coinit_flags,
+                            uint32 flags);
+
+  bool HasWorkItems() const;
+
+ private:
+  bool is_stopped() const {
+    return !!is_stopped_;
+  }
+
+  void set_is_stopped(bool is_stopped) {
+    ::InterlockedExchange(&is_stopped_, is_stopped);
+  }
+
+  volatile LONG is_stopped_;
+
+  std::unique_ptr<Executor> executor_;
+
+  // This event signals when the thread pool is stopping.
+  scoped_event shutdown_event_;
+
+  // How many milliseconds to wait for the work items to finish when
+  // the thread pool is shutting down.
+  int shutdown_delay_;
+
+  DISALLOW_COPY_AND_ASSIGN(ExecutorThreadPool);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_BASE_EXECUTOR_THREAD_POOL_H_
@@ -0,0 +1,229 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/base/executor_thread_pool.h"
+
+#include <memory>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "omaha/base/synchronized.h"
+#include "omaha/base/utils.h"
+#include "omaha/testing/unit_test.h"
+
+namespace omaha {
+
+namespace {
+
+const int kShutdownDelayMs = 10000;
+
+// Appends its id to |order| when processed, or its negated id when cancelled.
+class OrderedJob : public UserWorkItem {
+ public:
+  OrderedJob(int id, LLock* lock, std::vector<int>* order)
+      : id_(id), lock_(lock), order_(order) {}
+
+ private:
+  virtual void DoProcess() {
+    __mutexScope(*lock_);
+    order_->push_back(id_);
+  }
+
+  virtual void DoCancel() {
+    __mutexScope(*lock_);
+    order_->push_back(-id_);
+  }
+
+  const int id_;
+  LLock* lock_;
+  std::vector<int>* order_;
+
+  DISALLOW_COPY_AND_ASSIGN(OrderedJob);
+};
+
+// Blocks the only thread of the pool until |event| is signaled.
+class BlockingJob : public UserWorkItem {
+ public:
+  BlockingJob(HANDLE started_event, HANDLE event)
+      : started_event_(started_event), event_(event) {}
+
+ private:
+  virtual void DoProcess() {
+    EXPECT_TRUE(::SetEvent(started_event_));
+    EXPECT_EQ(WAIT_OBJECT_0, ::WaitForSingleObject(event_, INFINITE));
+  }
+
+  HANDLE started_event_;
+  HANDLE event_;
+
+  DISALLOW_COPY_AND_ASSIGN(BlockingJob);
+};
+
+// Checks that COM is initialized for DoProcess and for the destructor.
+class CoInitJob : public UserWorkItem {
+ public:
+  CoInitJob(DWORD coinit_flags, HRESULT coinit_expected_hresult)
+      : coinit_flags_(coinit_flags),
+        coinit_expected_hresult_(coinit_expected_hresult) {}
+
+  ~CoInitJob() {
+    scoped_co_init init_com_apt(coinit_flags_);
+    EXPECT_EQ(coinit_expected_hresult_, init_com_apt.hresult());
+  }
+
+ private:
+  virtual void DoProcess() {
+    scoped_co_init init_com_apt(coinit_flags_);
+    EXPECT_EQ(coinit_expected_hresult_, init_com_apt.hresult());
+  }
+
+  const DWORD coinit_flags_;
+  const HRESULT coinit_expected_hresult_;
+
+  DISALLOW_COPY_AND_ASSIGN(CoInitJob);
+};
+
+}  // namespace
+
+class ExecutorThreadPoolTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    reset(started_event_, ::CreateEvent(NULL, true, false, NULL));
+    ASSERT_TRUE(started_event_);
+    reset(release_event_, ::CreateEvent(NULL, true, false, NULL));
+    ASSERT_TRUE(release_event_);
+  }
+
+  // Occupies the only thread of |thread_pool| until ReleaseThread is called.
+  void BlockThread(ExecutorThreadPool* thread_pool) {
+    ASSERT_HRESULT_SUCCEEDED(thread_pool->QueueUserWorkItem(
+        std::make_unique<BlockingJob>(get(started_event_),
+                                      get(release_event_)),
+        COINIT_MULTITHREADED,
+        WT_EXECUTEDEFAULT));
+    ASSERT_EQ(WAIT_OBJECT_0,
+              ::WaitForSingleObject(get(started_event_), kShutdownDelayMs));
+  }
+
+  void ReleaseThread() {
+    EXPECT_TRUE(::SetEvent(get(release_event_)));
+  }
+
+  HRESULT QueueOrderedJob(ExecutorThreadPool* thread_pool,
+                          int id,
+                          ExecutorPriority priority,
+                          std::shared_ptr<const CancellationToken> token) {
+    auto job = std::make_unique<OrderedJob>(id, &lock_, &order_);
+    job->set_priority(priority);
+    job->set_cancellation_token(token);
+    return thread_pool->QueueUserWorkItem(std::move(job),
+                                          COINIT_MULTITHREADED,
+                                          WT_EXECUTEDEFAULT);
+  }
+
+  scoped_event started_event_;
+  scoped_event release_event_;
+  LLock lock_;
+  std::vector<int> order_;
+};
+
+TEST_F(ExecutorThreadPoolTest, RunsWorkItemsByPriority) {
+  ExecutorThreadPool thread_pool;
+  ASSERT_HRESULT_SUCCEEDED(
+      thread_pool.Initialize(1, 0, kShutdownDelayMs, NULL));
+
+  BlockThread(&thread_pool);
+  EXPECT_HRESULT_SUCCEEDED(QueueOrderedJob(
+      &thread_pool, 1, EXECUTOR_PRIORITY_BACKGROUND, nullptr));
+  EXPECT_HRESULT_SUCCEEDED(QueueOrderedJob(
+      &thread_pool, 2, EXECUTOR_PRIORITY_INTERACTIVE, nullptr));
+  EXPECT_HRESULT_SUCCEEDED(QueueOrderedJob(
+      &thread_pool, 3, EXECUTOR_PRIORITY_BACKGROUND, nullptr));
+  EXPECT_HRESULT_SUCCEEDED(QueueOrderedJob(
+      &thread_pool, 4, EXECUTOR_PRIORITY_INTERACTIVE, nullptr));
+  EXPECT_TRUE(thread_pool.HasWorkItems());
+  ReleaseThread();
+
+  thread_pool.Stop();
+  EXPECT_FALSE(thread_pool.HasWorkItems());
+
+  const int kExpectedOrder[] = {2, 4, 1, 3};
+  EXPECT_EQ(std::vector<int>(kExpectedOrder, kExpectedOrder + 4), order_);
+}
+
+TEST_F(ExecutorThreadPoolTest, CancelsWorkItems) {
+  ExecutorThreadPool thread_pool;
+  ASSERT_HRESULT_SUCCEEDED(
+      thread_pool.Initialize(1, 0, kShutdownDelayMs, NULL));
+
+  auto token = std::make_shared<CancellationToken>();
+  BlockThread(&thread_pool);
+  EXPECT_HRESULT_SUCCEEDED(QueueOrderedJob(
+      &thread_pool, 1, EXECUTOR_PRIORITY_BACKGROUND, token));
+  EXPECT_HRESULT_SUCCEEDED(QueueOrderedJob(
+      &thread_pool, 2, EXECUTOR_PRIORITY_BACKGROUND, nullptr));
+  token->Cancel();
+  ReleaseThread();
+
+  thread_pool.Stop();
+
+  const int kExpectedOrder[] = {-1, 2};
+  EXPECT_EQ(std::vector<int>(kExpectedOrder, kExpectedOrder + 2), order_);
+}
+
+TEST_F(ExecutorThreadPoolTest, RejectsWorkItems) {
+  ExecutorThreadPool thread_pool;
+  EXPECT_EQ(E_FAIL, QueueOrderedJob(
+      &thread_pool, 1, EXECUTOR_PRIORITY_BACKGROUND, nullptr));
+
+  ASSERT_HRESULT_SUCCEEDED(
+      thread_pool.Initialize(1, 1, kShutdownDelayMs, NULL));
+  BlockThread(&thread_pool);
+  EXPECT_HRESULT_SUCCEEDED(QueueOrderedJob(
+      &thread_pool, 2, EXECUTOR_PRIORITY_BACKGROUND, nullptr));
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_NOT_ENOUGH_QUOTA), QueueOrderedJob(
+      &thread_pool, 3, EXECUTOR_PRIORITY_INTERACTIVE, nullptr));
+  ReleaseThread();
+
+  thread_pool.Stop();
+  EXPECT_EQ(E_FAIL, QueueOrderedJob(
+      &thread_pool, 4, EXECUTOR_PRIORITY_BACKGROUND, nullptr));
+
+  EXPECT_EQ(std::vector<int>(1, 2), order_);
+}
+
+TEST_F(ExecutorThreadPoolTest, CoInit) {
+  ExecutorThreadPool thread_pool;
+  ASSERT_HRESULT_SUCCEEDED(
+      thread_pool.Initialize(2, 0, kShutdownDelayMs, NULL));
+
+  EXPECT_HRESULT_SUCCEEDED(thread_pool.QueueUserWorkItem(
+      std::make_unique<CoInitJob>(COINIT_APARTMENTTHREADED, S_FALSE),
+      COINIT_APARTMENTTHREADED,
+      WT_EXECUTEDEFAULT));
+  EXPECT_HRESULT_SUCCEEDED(thread_pool.QueueUserWorkItem(
+      std::make_unique<CoInitJob>(COINIT_MULTITHREADED, S_FALSE),
+      COINIT_MULTITHREADED,
+      WT_EXECUTEDEFAULT));
+  EXPECT_HRESULT_SUCCEEDED(thread_pool.QueueUserWorkItem(
+      std::make_unique<CoInitJob>(COINIT_APARTMENTTHREADED,
+                                  RPC_E_CHANGED_MODE),
+      COINIT_MULTITHREADED,
+      WT_EXECUTEDEFAULT));
+
+  thread_pool.Stop();
+}
+
+}  // namespace omaha
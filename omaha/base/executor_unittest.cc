@@ -0,0 +1,382 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+// The tests only use the standard library so that they can run on any
+// platform.
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "omaha/base/executor.h"
+
+namespace omaha {
+
+namespace {
+
+const int kStopTimeoutMs = 10000;
+
+// Blocks the tasks calling Wait until Release is called.
+class Gate {
+ public:
+  Gate() : is_open_(false) {}
+
+  void Wait() {
+    std::unique_lock<std::mutex> lock(lock_);
+    is_open_changed_.wait(lock, [this]() { return is_open_; });
+  }
+
+  void Release() {
+    std::lock_guard<std::mutex> lock(lock_);
+    is_open_ = true;
+    is_open_changed_.notify_all();
+  }
+
+ private:
+  std::mutex lock_;
+  std::condition_variable is_open_changed_;
+  bool is_open_;
+};
+
+class CountingObserver : public ExecutorObserver {
+ public:
+  CountingObserver()
+      : num_queued_(0),
+        num_rejected_(0),
+        num_started_(0),
+        num_stolen_(0),
+        num_cancelled_(0),
+        max_queue_depth_(0) {}
+
+  virtual void OnTaskQueued(ExecutorPriority, size_t queue_depth) {
+    ++num_queued_;
+    size_t max_queue_depth = max_queue_depth_;
+    while (queue_depth > max_queue_depth &&
+           !max_queue_depth_.compare_exchange_weak(max_queue_depth,
+                                                   queue_depth)) {
+    }
+  }
+
+  virtual void OnTaskRejected(ExecutorPriority) {
+    ++num_rejected_;
+  }
+
+  virtual void OnTaskStarted(ExecutorPriority, int64 latency_us, bool stolen) {
+    EXPECT_LE(0, latency_us);
+    ++num_started_;
+    if (stolen) {
+      ++num_stolen_;
+    }
+  }
+
+  virtual void OnTaskCancelled(ExecutorPriority) {
+    ++num_cancelled_;
+  }
+
+  std::atomic<int> num_queued_;
+  std::atomic<int> num_rejected_;
+  std::atomic<int> num_started_;
+  std::atomic<int> num_stolen_;
+  std::atomic<int> num_cancelled_;
+  std::atomic<size_t> max_queue_depth_;
+};
+
+Executor::TaskOptions MakeOptions(ExecutorPriority priority) {
+  Executor::TaskOptions options;
+  options.priority = priority;
+  return options;
+}
+
+}  // namespace
+
+TEST(ExecutorTest, RunsTasks) {
+  const int kNumTasks = 1000;
+
+  CountingObserver observer;
+  Executor executor(4, 0, &observer);
+  ASSERT_TRUE(executor.Start());
+
+  std::atomic<int> count(0);
+  for (int i = 0; i != kNumTasks; ++i) {
+    EXPECT_TRUE(executor.Submit([&count]() { ++count; },
+                                MakeOptions(EXECUTOR_PRIORITY_BACKGROUND)));
+  }
+
+  EXPECT_TRUE(executor.Stop(kStopTimeoutMs));
+  EXPECT_EQ(kNumTasks, count);
+  EXPECT_FALSE(executor.HasTasks());
+  EXPECT_EQ(kNumTasks, observer.num_queued_);
+  EXPECT_EQ(kNumTasks, observer.num_started_);
+  EXPECT_EQ(0, observer.num_rejected_);
+  EXPECT_EQ(0, observer.num_cancelled_);
+  EXPECT_LE(1u, observer.max_queue_depth_);
+}
+
+TEST(ExecutorTest, RejectsTasksWhenNotRunning) {
+  CountingObserver observer;
+  Executor executor(1, 0, &observer);
+
+  bool has_run = false;
+  EXPECT_FALSE(executor.Submit([&has_run]() { has_run = true; },
+                               MakeOptions(EXECUTOR_PRIORITY_INTERACTIVE)));
+
+  ASSERT_TRUE(executor.Start());
+  EXPECT_TRUE(executor.Stop(kStopTimeoutMs));
+  EXPECT_FALSE(executor.Submit([&has_run]() { has_run = true; },
+                               MakeOptions(EXECUTOR_PRIORITY_INTERACTIVE)));
+
+  // The executor can be started again.
+  ASSERT_TRUE(executor.Start());
+  EXPECT_TRUE(executor.Submit([&has_run]() { has_run = true; },
+                              MakeOptions(EXECUTOR_PRIORITY_INTERACTIVE)));
+  EXPECT_TRUE(executor.Stop(kStopTimeoutMs));
+
+  EXPECT_TRUE(has_run);
+  EXPECT_EQ(2, observer.num_rejected_);
+  EXPECT_EQ(1, observer.num_started_);
+}
+
+// The interactive tasks run before the background tasks queued before them.
+TEST(ExecutorTest, RunsTasksByPriority) {
+  Executor executor(1, 0, NULL);
+  ASSERT_TRUE(executor.Start());
+
+  Gate gate;
+  std::atomic<bool> has_started(false);
+  ASSERT_TRUE(executor.Submit([&gate, &has_started]() {
+                                has_started = true;
+                                gate.Wait();
+                              },
+                              MakeOptions(EXECUTOR_PRIORITY_BACKGROUND)));
+  while (!has_started) {
+    std::this_thread::yield();
+  }
+
+  // Only the worker thread writes |order| once the gate is released.
+  std::vector<int> order;
+  for (int i = 0; i != 3; ++i) {
+    ASSERT_TRUE(executor.Submit([&order, i]() { order.push_back(i); },
+                                MakeOptions(EXECUTOR_PRIORITY_BACKGROUND)));
+  }
+  for (int i = 10; i != 12; ++i) {
+    ASSERT_TRUE(executor.Submit([&order, i]() { order.push_back(i); },
+                                MakeOptions(EXECUTOR_PRIORITY_INTERACTIVE)));
+  }
+  EXPECT_EQ(5u, executor.num_queued_tasks());
+
+  gate.Release();
+  EXPECT_TRUE(executor.Stop(kStopTimeoutMs));
+
+  const int kExpectedOrder[] = {10, 11, 0, 1, 2};
+  EXPECT_EQ(std::vector<int>(kExpectedOrder, kExpectedOrder + 5), order);
+}
+
+// The tasks queued by a task go to the queue of its worker, which is busy
+// running it, so the other worker has to steal them.
+TEST(ExecutorTest, StealsTasks) {
+  const int kNumChildTasks = 20;
+
+  CountingObserver observer;
+  Executor executor(2, 0, &observer);
+  ASSERT_TRUE(executor.Start());
+
+  std::atomic<int> num_children_run(0);
+  std::atomic<bool> have_children_run(false);
+  auto parent = [&]() {
+    EXPECT_TRUE(executor.RunsTasksOnCurrentThread());
+    for (int i = 0; i != kNumChildTasks; ++i) {
+      EXPECT_TRUE(executor.Submit([&num_children_run]() { ++num_children_run; },
+                                  MakeOptions(EXECUTOR_PRIORITY_BACKGROUND)));
+    }
+
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (num_children_run != kNumChildTasks &&
+           std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::yield();
+    }
+    have_children_run = num_children_run == kNumChildTasks;
+  };
+  ASSERT_TRUE(executor.Submit(parent,
+                              MakeOptions(EXECUTOR_PRIORITY_BACKGROUND)));
+  EXPECT_FALSE(executor.RunsTasksOnCurrentThread());
+
+  EXPECT_TRUE(executor.Stop(kStopTimeoutMs));
+  EXPECT_TRUE(have_children_run);
+  EXPECT_EQ(kNumChildTasks + 1, observer.num_started_);
+  EXPECT_EQ(kNumChildTasks, observer.num_stolen_);
+}
+
+TEST(ExecutorTest, SkipsCancelledTasks) {
+  CountingObserver observer;
+  Executor executor(1, 0, &observer);
+  ASSERT_TRUE(executor.Start());
+
+  Gate gate;
+  ASSERT_TRUE(executor.Submit([&gate]() { gate.Wait(); },
+                              MakeOptions(EXECUTOR_PRIORITY_BACKGROUND)));
+
+  auto token = std::make_shared<CancellationToken>();
+  bool has_run = false;
+  bool has_been_cancelled = false;
+  Executor::TaskOptions options(MakeOptions(EXECUTOR_PRIORITY_INTERACTIVE));
+  options.cancellation_token = token;
+  options.on_cancelled = [&has_been_cancelled]() {
+    has_been_cancelled = true;
+  };
+  ASSERT_TRUE(executor.Submit([&has_run]() { has_run = true; }, options));
+
+  // The same token does not affect the tasks which are not cancelled.
+  auto other_token = std::make_shared<CancellationToken>();
+  bool has_other_run = false;
+  options.cancellation_token = other_token;
+  ASSERT_TRUE(executor.Submit([&has_other_run]() { has_other_run = true; },
+                              options));
+
+  token->Cancel();
+  EXPECT_TRUE(token->IsCancelled());
+  EXPECT_FALSE(other_token->IsCancelled());
+  gate.Release();
+  EXPECT_TRUE(executor.Stop(kStopTimeoutMs));
+
+  EXPECT_FALSE(has_run);
+  EXPECT_TRUE(has_been_cancelled);
+  EXPECT_TRUE(has_other_run);
+  EXPECT_EQ(1, observer.num_cancelled_);
+  EXPECT_EQ(2, observer.num_started_);
+}
+
+TEST(ExecutorTest, BoundedQueue) {
+  CountingObserver observer;
+  Executor executor(1, 2, &observer);
+  ASSERT_TRUE(executor.Start());
+
+  // The running task does not count against the bound.
+  Gate gate;
+  std::atomic<bool> has_started(false);
+  ASSERT_TRUE(executor.Submit([&gate, &has_started]() {
+                                has_started = true;
+                                gate.Wait();
+                              },
+                              MakeOptions(EXECUTOR_PRIORITY_BACKGROUND)));
+  while (!has_started) {
+    std::this_thread::yield();
+  }
+
+  std::atomic<int> count(0);
+  EXPECT_TRUE(executor.Submit([&count]() { ++count; },
+                              MakeOptions(EXECUTOR_PRIORITY_BACKGROUND)));
+  EXPECT_TRUE(executor.Submit([&count]() { ++count; },
+                              MakeOptions(EXECUTOR_PRIORITY_INTERACTIVE)));
+  EXPECT_FALSE(executor.Submit([&count]() { ++count; },
+                               MakeOptions(EXECUTOR_PRIORITY_INTERACTIVE)));
+
+  gate.Release();
+  EXPECT_TRUE(executor.Stop(kStopTimeoutMs));
+  EXPECT_EQ(2, count);
+  EXPECT_EQ(1, observer.num_rejected_);
+  EXPECT_EQ(2u, observer.max_queue_depth_);
+}
+
+TEST(ExecutorTest, StopDiscardsQueuedTasks) {
+  Executor executor(1, 0, NULL);
+  ASSERT_TRUE(executor.Start());
+
+  std::atomic<bool> has_started(false);
+  std::atomic<bool> has_returned(false);
+  ASSERT_TRUE(executor.Submit([&has_started, &has_returned]() {
+                                has_started = true;
+                                std::this_thread::sleep_for(
+                                    std::chrono::milliseconds(200));
+                                has_returned = true;
+                              },
+                              MakeOptions(EXECUTOR_PRIORITY_BACKGROUND)));
+  while (!has_started) {
+    std::this_thread::yield();
+  }
+
+  std::atomic<int> count(0);
+  auto shared_count = std::make_shared<int>(0);
+  for (int i = 0; i != 3; ++i) {
+    ASSERT_TRUE(executor.Submit([&count, shared_count]() { ++count; },
+                                MakeOptions(EXECUTOR_PRIORITY_BACKGROUND)));
+  }
+  EXPECT_EQ(4, shared_count.use_count());
+
+  // The running task returns before Stop does, and the queued tasks are
+  // destroyed without running.
+  EXPECT_FALSE(executor.Stop(10));
+  EXPECT_TRUE(has_returned);
+  EXPECT_EQ(0, count);
+  EXPECT_EQ(1, shared_count.use_count());
+  EXPECT_FALSE(executor.HasTasks());
+}
+
+// Measures the time to run many short tasks queued from outside the executor
+// and from the tasks themselves.
+TEST(ExecutorTest, Benchmark) {
+  const int kNumTasks = 100000;
+  const int kNumThreads[] = {1, 2, 4, 8};
+
+  for (size_t i = 0; i != sizeof(kNumThreads) / sizeof(kNumThreads[0]); ++i) {
+    Executor executor(kNumThreads[i], 0, NULL);
+    ASSERT_TRUE(executor.Start());
+
+    std::atomic<int> count(0);
+    const auto start_time = std::chrono::steady_clock::now();
+    for (int j = 0; j != kNumTasks; ++j) {
+      executor.Submit([&count]() { ++count; },
+                      MakeOptions(j % 4 ? EXECUTOR_PRIORITY_BACKGROUND :
+                                          EXECUTOR_PRIORITY_INTERACTIVE));
+    }
+    EXPECT_TRUE(executor.Stop(kStopTimeoutMs * 6));
+    const auto external_time = std::chrono::steady_clock::now() - start_time;
+    EXPECT_EQ(kNumTasks, count);
+
+    ASSERT_TRUE(executor.Start());
+    count = 0;
+    const int kNumParents = 100;
+    const auto fan_out_start_time = std::chrono::steady_clock::now();
+    for (int j = 0; j != kNumParents; ++j) {
+      executor.Submit([&executor, &count]() {
+                        for (int k = 0; k != kNumTasks / kNumParents; ++k) {
+                          executor.Submit(
+                              [&count]() { ++count; },
+                              MakeOptions(EXECUTOR_PRIORITY_BACKGROUND));
+                        }
+                      },
+                      MakeOptions(EXECUTOR_PRIORITY_INTERACTIVE));
+    }
+    EXPECT_TRUE(executor.Stop(kStopTimeoutMs * 6));
+    const auto fan_out_time =
+        std::chrono::steady_clock::now() - fan_out_start_time;
+    EXPECT_EQ(kNumTasks, count);
+
+    typedef std::chrono::duration<double, std::milli> Milliseconds;
+    std::cout << "\t" << kNumThreads[i] << " threads, " << kNumTasks
+              << " tasks: queued from outside "
+              << Milliseconds(external_time).count() << " ms, queued by tasks "
+              << Milliseconds(fan_out_time).count() << " ms" << std::endl;
+  }
+}
+
+}  // namespace omaha
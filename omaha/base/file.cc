@@ -1188,7 +1188,7 @@ HRESULT File::GetReloadDiskSpaceNeeded(uint64* bytes_needed) {
 }
 
 // Get the file size
-HRESULT File::GetFileSizeUnopen(const TCHAR* filename, uint32* out_size) {
+HRESULT File::GetFileSizeUnopen(const TCHAR* filename, uint64* out_size) {
   ASSERT1(filename);
   ASSERT1(out_size);
 
@@ -1199,7 +1199,10 @@ HRESULT File::GetFileSizeUnopen(const TCHAR* filename, uint32* out_size) {
     return HRESULTFromLastError();
   }
 
-  *out_size = data.nFileSizeLow;
+  ULARGE_INTEGER size = {};
+  size.LowPart = data.nFileSizeLow;
+  size.HighPart = data.nFileSizeHigh;
+  *out_size = size.QuadPart;
 
   return S_OK;
 }
@@ -1245,14 +1248,14 @@ HRESULT File::GetLastWriteTimeAndSize(const TCHAR* file_path,
 bool File::AreFilesIdentical(const TCHAR* filename1, const TCHAR* filename2) {
   UTIL_LOG(L4, (_T("[File::AreFilesIdentical][%s][%s]"), filename1, filename2));
 
-  uint32 file_size1 = 0;
+  uint64 file_size1 = 0;
   HRESULT hr = File::GetFileSizeUnopen(filename1, &file_size1);
   if (FAILED(hr)) {
     UTIL_LOG(LE, (_T("[GetFileSizeUnopen failed file_size1][0x%x]"), hr));
     return false;
   }
 
-  uint32 file_size2 = 0;
+  uint64 file_size2 = 0;
   hr = File::GetFileSizeUnopen(filename2, &file_size2);
   if (FAILED(hr)) {
     UTIL_LOG(LE, (_T("[GetFileSizeUnopen failed file_size2][0x%x]"), hr));
@@ -1260,7 +1263,7 @@ bool File::AreFilesIdentical(const TCHAR* filename1, const TCHAR* filename2) {
   }
 
   if (file_size1 != file_size2) {
-    UTIL_LOG(L3, (_T("[file_size1 != file_size2][%d][%d]"),
+    UTIL_LOG(L3, (_T("[file_size1 != file_size2][%I64u][%I64u]"),
                   file_size1, file_size2));
     return false;
   }
@@ -1282,23 +1285,24 @@ bool File::AreFilesIdentical(const TCHAR* filename1, const TCHAR* filename2) {
   static const uint32 kBufferSize = 0x10000;
   std::vector<uint8> buffer1(kBufferSize);
   std::vector<uint8> buffer2(kBufferSize);
-  uint32 bytes_left = file_size1;
+  uint64 bytes_left = file_size1;
 
   while (bytes_left > 0) {
-    uint32 bytes_to_read = std::min(bytes_left, kBufferSize);
+    const uint32 bytes_to_read = static_cast<uint32>(
+        std::min(bytes_left, static_cast<uint64>(kBufferSize)));
     uint32 bytes_read1 = 0;
     uint32 bytes_read2 = 0;
 
     hr = file1.Read(bytes_to_read, &buffer1.front(), &bytes_read1);
     if (FAILED(hr)) {
-      UTIL_LOG(LE, (_T("[file1.Read failed][%d][%d][0x%x]"),
+      UTIL_LOG(LE, (_T("[file1.Read failed][%I64u][%u][0x%x]"),
                     bytes_left, bytes_to_read, hr));
       return false;
     }
 
     hr = file2.Read(bytes_to_read, &buffer2.front(), &bytes_read2);
     if (FAILED(hr)) {
-      UTIL_LOG(LE, (_T("[file2.Read failed][%d][%d][0x%x]"),
+      UTIL_LOG(LE, (_T("[file2.Read failed][%I64u][%u][0x%x]"),
                     bytes_left, bytes_to_read, hr));
       return false;
     }
@@ -1311,12 +1315,13 @@ bool File::AreFilesIdentical(const TCHAR* filename1, const TCHAR* filename2) {
     }
 
     if (memcmp(&buffer1.front(), &buffer2.front(), bytes_read1) != 0) {
-      UTIL_LOG(L3, (_T("[memcmp failed][%d][%d]"), bytes_left, bytes_read1));
+      UTIL_LOG(L3, (_T("[memcmp failed][%I64u][%u]"),
+                    bytes_left, bytes_read1));
       return false;
     }
 
     if (bytes_left < bytes_to_read) {
-      UTIL_LOG(LE, (_T("[bytes_left < bytes_to_read][%d][%d]"),
+      UTIL_LOG(LE, (_T("[bytes_left < bytes_to_read][%I64u][%u]"),
                     bytes_left, bytes_to_read));
       return false;
     }
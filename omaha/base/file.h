@@ -152,7 +152,7 @@ class File {
     // requires a file handle, which conflicts if the file is already opened
     // and locked]
     static HRESULT GetFileSizeUnopen(const TCHAR * filename,
-                                     uint32 * out_size);
+                                     uint64 * out_size);
 
     // Optimized function that gets the last write time and size
     static HRESULT GetLastWriteTimeAndSize(const TCHAR* file_path,
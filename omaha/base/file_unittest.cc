@@ -227,9 +227,9 @@ TEST(FileTest, File) {
     CString known_file2(windows_dir + L"\\REGEDIT.EXE");
     CString temp_file1(temp_dir + L"\\FOO.TMP");
     CString temp_file2(temp_dir + L"\\BAR.TMP");
-    uint32 known_size1 = 0;
-    uint32 known_size2 = 0;
-    uint32 temp_size1 = 0;
+    uint64 known_size1 = 0;
+    uint64 known_size2 = 0;
+    uint64 temp_size1 = 0;
 
     // Start with neither file existing
     if (File::Exists(temp_file1))
@@ -53,6 +53,7 @@
 #include <atlpath.h>
 #include <atlsecurity.h>
 #include <memory>
+#include <vector>
 
 #include "base/basictypes.h"
 #include "omaha/base/app_util.h"
@@ -851,6 +852,37 @@ void Logging::OutputMessage(DWORD writer_mask,
   }
 }
 
+void Logging::Flush() {
+  // Flush may be called while handling the crash of a thread which owns the
+  // lock, therefore the lock is not waited on indefinitely. For the same
+  // reason, the writers do not wait on their own locks.
+  int i = 0;
+  while (++i <= kNumLockRetries) {
+    if (lock_.Lock(0)) {
+      for (int j = 0; j < num_writers_; ++j) {
+        __try {
+          if (!writers_[j]->TryFlush()) {
+            OutputDebugStringA("LOG_SYSTEM: Couldn't flush a log writer\n\r");
+          }
+        }
+        __except(SehNoMinidump(GetExceptionCode(),
+                               GetExceptionInformation(),
+                               __FILE__,
+                               __LINE__,
+                               true)) {
+          OutputDebugStringA("Unexpected exception in: " __FUNCTION__ "\r\n");
+        }
+      }
+      lock_.Unlock();
+      return;
+    }
+
+    Sleep(kLockRetryDelayMs);
+  }
+
+  OutputDebugStringA("LOG_SYSTEM: Couldn't acquire lock to flush the log\n\r");
+}
+
 bool Logging::InternalRegisterWriter(LogWriter* log_writer) {
   if (num_writers_ >= max_writers) {
     return false;
@@ -930,6 +962,13 @@ bool LogWriter::IsCatLevelEnabled(LogCategory, LogLevel) const {
 
 void LogWriter::OutputMessage(const OutputInfo*) { }
 
+void LogWriter::Flush() { }
+
+bool LogWriter::TryFlush() {
+  Flush();
+  return true;
+}
+
 bool LogWriter::Register() {
   Logging* logger = GetLogging();
   if (logger) {
@@ -962,7 +1001,12 @@ FileLogWriter::FileLogWriter(const wchar_t* file_name, bool append)
       log_file_wide_(kDefaultLogFileWide),
       log_file_mutex_(NULL),
       file_name_(file_name),
-      log_file_(NULL) {
+      log_file_(NULL),
+      async_(kDefaultLogFileAsync != 0),
+      flush_thread_(NULL),
+      flush_event_(NULL),
+      stop_event_(NULL),
+      flush_thread_done_(NULL) {
   Logging* logger = GetLogging();
   if (logger) {
     CString config_file_path = logger->GetCurrentConfigurationFilePath();
@@ -977,9 +1021,15 @@ FileLogWriter::FileLogWriter(const wchar_t* file_name, bool append)
             kConfigAttrLogFileWide,
             kDefaultLogFileWide,
             config_file_path) == 0 ? false : true;
+        async_ = ::GetPrivateProfileInt(
+            kConfigSectionLoggingSettings,
+            kConfigAttrLogFileAsync,
+            kDefaultLogFileAsync,
+            config_file_path) == 0 ? false : true;
     } else {
       max_file_size_ = kDefaultMaxLogFileSize;
       log_file_wide_ = kDefaultLogFileWide;
+      async_ = kDefaultLogFileAsync != 0;
     }
     proc_name_ = logger->proc_name();
   }
@@ -1031,9 +1081,21 @@ void FileLogWriter::Initialize() {
 
   valid_ = true;
   ReleaseMutex();
+
+  if (async_ && !StartFlushThread()) {
+    ::OutputDebugString(SPRINTF(L"LOG_SYSTEM: [%s]: "
+                                L"Could not start the log flush thread %u\n",
+                                proc_name_,
+                                ::GetLastError()));
+    StopFlushThread();
+    async_ = false;
+  }
 }
 
 void FileLogWriter::Cleanup() {
+  StopFlushThread();
+  Flush();
+
   if (log_file_) {
     ::CloseHandle(log_file_);
   }
@@ -1064,7 +1126,7 @@ bool FileLogWriter::CreateLoggingMutex() {
 }
 
 bool FileLogWriter::CreateLoggingFile() {
-  uint32 file_size(0);
+  uint64 file_size(0);
   File::GetFileSizeUnopen(file_name_, &file_size);
   if (file_size > max_file_size_) {
     ArchiveLoggingFile();
@@ -1223,6 +1285,102 @@ void FileLogWriter::OutputMessage(const OutputInfo* output_info) {
     return;
   }
 
+  if (!async_) {
+    std::vector<char> record;
+    FormatRecord(output_info, &record);
+    WriteRecords(&record.front(), record.size());
+    return;
+  }
+
+  size_t pending_size = 0;
+  {
+    __mutexScope(pending_lock_);
+    FormatRecord(output_info, &pending_records_);
+    pending_size = pending_records_.size();
+  }
+
+  // Write the records on this thread if the flush thread does not keep up,
+  // so that the memory used by the records stays bounded.
+  if (pending_size >= kMaxPendingLogSize) {
+    Flush();
+  } else if (pending_size >= kLogFlushThresholdSize) {
+    ::SetEvent(flush_event_);
+  }
+}
+
+void FileLogWriter::Flush() {
+  if (!async_) {
+    return;
+  }
+
+  __mutexScope(flush_lock_);
+  {
+    __mutexScope(pending_lock_);
+    flushing_records_.swap(pending_records_);
+  }
+  WriteFlushingRecords();
+}
+
+bool FileLogWriter::TryFlush() {
+  if (!async_) {
+    return true;
+  }
+
+  // The locks are reentrant, therefore they are not taken if the calling
+  // thread owns them: it crashed while it was changing the buffers.
+  const DWORD_PTR thread_id = ::GetCurrentThreadId();
+  if (flush_lock_.GetOwner() == thread_id ||
+      pending_lock_.GetOwner() == thread_id) {
+    return false;
+  }
+
+  if (!flush_lock_.Lock(0)) {
+    return false;
+  }
+
+  bool is_flushed = false;
+  if (pending_lock_.Lock(0)) {
+    flushing_records_.swap(pending_records_);
+    pending_lock_.Unlock();
+
+    WriteFlushingRecords();
+    is_flushed = true;
+  }
+
+  flush_lock_.Unlock();
+  return is_flushed;
+}
+
+void FileLogWriter::WriteFlushingRecords() {
+  // The buffers are swapped back and forth so that their memory is reused.
+  if (!flushing_records_.empty()) {
+    WriteRecords(&flushing_records_.front(), flushing_records_.size());
+    flushing_records_.clear();
+  }
+}
+
+void FileLogWriter::FormatRecord(const OutputInfo* output_info,
+                                 std::vector<char>* record) const {
+  const wchar_t* msgs[] = {output_info->msg1, output_info->msg2, L"\r\n"};
+  for (size_t i = 0; i != arraysize(msgs); ++i) {
+    if (!msgs[i]) {
+      continue;
+    }
+    if (log_file_wide_) {
+      const char* msg = reinterpret_cast<const char*>(msgs[i]);
+      record->insert(record->end(),
+                     msg,
+                     msg + lstrlen(msgs[i]) * sizeof(wchar_t));
+    } else {
+      CStringA msg(WideToAnsiDirect(msgs[i]));
+      record->insert(record->end(),
+                     msg.GetString(),
+                     msg.GetString() + msg.GetLength());
+    }
+  }
+}
+
+void FileLogWriter::WriteRecords(const char* records, size_t size) {
   // Acquire the mutex.
   if (!GetMutex()) {
     return;
@@ -1236,44 +1394,76 @@ void FileLogWriter::OutputMessage(const OutputInfo* output_info) {
     if (!TruncateLoggingFile()) {
       // Logging stops until the log can be archived over since we do not
       // want to overfill the disk.
+      ReleaseMutex();
       return;
     }
   }
   pos = ::SetFilePointer(log_file_, 0, NULL, FILE_END);
 
-  // Write the date, followed by a CRLF
   DWORD written_size = 0;
-  if (output_info->msg1) {
-    if (log_file_wide_) {
-      ::WriteFile(log_file_, output_info->msg1,
-                  lstrlen(output_info->msg1) * sizeof(wchar_t), &written_size,
-                  NULL);
-    } else {
-      CStringA msg(WideToAnsiDirect(output_info->msg1));
-      ::WriteFile(log_file_, msg.GetString(), msg.GetLength(), &written_size,
-                  NULL);
-    }
+  ::WriteFile(log_file_, records, static_cast<DWORD>(size), &written_size,
+              NULL);
+
+  ReleaseMutex();
+}
+
+bool FileLogWriter::StartFlushThread() {
+  flush_event_ = ::CreateEvent(NULL, false, false, NULL);
+  stop_event_ = ::CreateEvent(NULL, true, false, NULL);
+  flush_thread_done_ = ::CreateEvent(NULL, true, false, NULL);
+  if (!flush_event_ || !stop_event_ || !flush_thread_done_) {
+    return false;
   }
 
-  if (output_info->msg2) {
-    if (log_file_wide_) {
-      ::WriteFile(log_file_, output_info->msg2,
-                  lstrlen(output_info->msg2) * sizeof(wchar_t), &written_size,
-                  NULL);
-    } else {
-      CStringA msg(WideToAnsiDirect(output_info->msg2));
-      ::WriteFile(log_file_, msg.GetString(), msg.GetLength(), &written_size,
-                  NULL);
-    }
+  pending_records_.reserve(kLogFlushThresholdSize);
+  flushing_records_.reserve(kLogFlushThresholdSize);
+
+  flush_thread_ = ::CreateThread(NULL, 0, &FileLogWriter::FlushThreadProc,
+                                 this, 0, NULL);
+  return flush_thread_ != NULL;
+}
+
+void FileLogWriter::StopFlushThread() {
+  if (flush_thread_) {
+    // The writer may be destroyed by the static destructors while the loader
+    // lock is held. The thread can't exit then, so the wait ends when the
+    // thread is done flushing. The thread is gone already if the process is
+    // exiting.
+    ::SetEvent(stop_event_);
+    HANDLE handles[] = {flush_thread_, flush_thread_done_};
+    ::WaitForMultipleObjects(arraysize(handles), handles, false, INFINITE);
+    ::CloseHandle(flush_thread_);
+    flush_thread_ = NULL;
   }
 
-  if (log_file_wide_) {
-    ::WriteFile(log_file_, L"\r\n", 2 * sizeof(wchar_t), &written_size, NULL);
-  } else {
-    ::WriteFile(log_file_, "\r\n", 2, &written_size, NULL);
+  if (flush_event_) {
+    ::CloseHandle(flush_event_);
+    flush_event_ = NULL;
   }
+  if (stop_event_) {
+    ::CloseHandle(stop_event_);
+    stop_event_ = NULL;
+  }
+  if (flush_thread_done_) {
+    ::CloseHandle(flush_thread_done_);
+    flush_thread_done_ = NULL;
+  }
+}
 
-  ReleaseMutex();
+DWORD WINAPI FileLogWriter::FlushThreadProc(void* param) {
+  FileLogWriter* writer = static_cast<FileLogWriter*>(param);
+  HANDLE handles[] = {writer->stop_event_, writer->flush_event_};
+  for (;;) {
+    DWORD res = ::WaitForMultipleObjects(arraysize(handles), handles, false,
+                                         kLogFlushIntervalMs);
+    if (res != WAIT_OBJECT_0 + 1 && res != WAIT_TIMEOUT) {
+      break;
+    }
+    writer->Flush();
+  }
+
+  ::SetEvent(writer->flush_thread_done_);
+  return 0;
 }
 
 bool FileLogWriter::GetMutex() {
@@ -1367,6 +1557,16 @@ void OverrideConfigLogWriter::OutputMessage(const OutputInfo* output_info) {
   return;
 }
 
+void OverrideConfigLogWriter::Flush() {
+  if (log_writer_) {
+    log_writer_->Flush();
+  }
+}
+
+bool OverrideConfigLogWriter::TryFlush() {
+  return log_writer_ ? log_writer_->TryFlush() : true;
+}
+
 }  // namespace omaha
 
 #endif  // LOGGING
@@ -21,6 +21,8 @@
 #ifndef OMAHA_BASE_LOGGING_H_
 #define OMAHA_BASE_LOGGING_H_
 
+#include <vector>
+
 #include "omaha/base/constants.h"
 #include "omaha/base/synchronized.h"
 #include "omaha/base/time.h"
@@ -55,6 +57,7 @@ namespace omaha {
 #define kDefaultLogFileWide             1
 #define kDefaultShowTime                1
 #define kDefaultAppendToFile            1
+#define kDefaultLogFileAsync            0
 
 #ifdef _DEBUG
 #define kDefaultMaxLogFileSize          0xFFFFFFFF  // 4GB
@@ -72,6 +75,14 @@ namespace omaha {
 // times over the MaxLogFileSize to prevent disk overfill.
 #define kStopGapLogFileSizeFactor       10
 
+// In the asynchronous file logging mode, the records are written to the log
+// file at least every kLogFlushIntervalMs or as soon as kLogFlushThresholdSize
+// bytes are pending. The threads which log block on the file while more than
+// kMaxPendingLogSize bytes are pending.
+#define kLogFlushIntervalMs             100
+#define kLogFlushThresholdSize          (64 * 1024)
+#define kMaxPendingLogSize              (4 * 1024 * 1024)
+
 // config file sections
 #define kConfigSectionLoggingLevel      L"LoggingLevel"
 #define kConfigSectionLoggingSettings   L"LoggingSettings"
@@ -85,6 +96,7 @@ namespace omaha {
 #define kConfigAttrLogToOutputDebug     L"LogToOutputDebug"
 #define kConfigAttrAppendToFile         L"AppendToFile"
 #define kConfigAttrMaxLogFileSize       L"MaxLogFileSize"
+#define kConfigAttrLogFileAsync         L"LogFileAsync"
 
 #define kLoggingMutexName               kLockPrefix L"logging_mutex"
 #define kMaxMutexWaitTimeMs             500
@@ -116,8 +128,19 @@ namespace omaha {
 
 #define LC_LOG_OPT(cat, level, msg)   LC_LOG(cat, level, msg)
 
+// Writes the pending log records out. Called before the process terminates
+// without running the static destructors, such as on crashes.
+#define FLUSH_LOG() \
+  do {                                                     \
+    omaha::Logging* logger = omaha::GetLogging();          \
+    if (logger) {                                          \
+      logger->Flush();                                     \
+    }                                                      \
+  } while (0)
+
 #else
 #define LC_LOG(cat, level, msg)   ((void)0)
+#define FLUSH_LOG()               ((void)0)
 #endif
 
 #ifdef _DEBUG
@@ -228,6 +251,15 @@ class LogWriter {
 
   virtual void OutputMessage(const OutputInfo* output_info);
 
+  // Writes out the messages the LogWriter has buffered, if any.
+  virtual void Flush();
+
+  // Same as Flush, but does not wait on the locks of the LogWriter. Called
+  // when the process crashes, possibly on a thread which owns them. Returns
+  // false if the messages could not be written out. The default
+  // implementation calls Flush.
+  virtual bool TryFlush();
+
   // Registers and unregisters this LogWriter with the Logging system.  When
   // registered, the Logging class assumes ownership.
   bool Register();
@@ -238,6 +270,12 @@ class LogWriter {
 };
 
 // A LogWriter that writes to a named file.
+//
+// By default, each message is written to the file by the thread which logs
+// it. In the asynchronous mode, which is enabled by the LogFileAsync setting,
+// the messages are formatted into an in-memory buffer and a background thread
+// writes the buffer to the file in one write every kLogFlushIntervalMs. The
+// buffer is written out when the writer is destroyed and by Flush.
 class FileLogWriter : public LogWriter {
  protected:
   FileLogWriter(const wchar_t* file_name, bool append);
@@ -247,6 +285,8 @@ class FileLogWriter : public LogWriter {
  public:
   static FileLogWriter* Create(const wchar_t* file_name, bool append);
   virtual void OutputMessage(const OutputInfo* output_info);
+  virtual void Flush();
+  virtual bool TryFlush();
 
  private:
   void Initialize();
@@ -257,6 +297,20 @@ class FileLogWriter : public LogWriter {
   bool GetMutex();
   void ReleaseMutex();
 
+  // Appends the message, as it is stored in the log file, to |record|.
+  void FormatRecord(const OutputInfo* output_info,
+                    std::vector<char>* record) const;
+
+  // Appends |size| bytes at the end of the log file.
+  void WriteRecords(const char* records, size_t size);
+
+  // Writes |flushing_records_| to the file. Called under |flush_lock_|.
+  void WriteFlushingRecords();
+
+  bool StartFlushThread();
+  void StopFlushThread();
+  static DWORD WINAPI FlushThreadProc(void* param);
+
   // Returns true if archiving of the log file is pending a computer restart.
   bool IsArchivePending();
 
@@ -277,6 +331,19 @@ class FileLogWriter : public LogWriter {
   HANDLE log_file_;
   CString proc_name_;
 
+  // Members used in the asynchronous mode only. The messages are appended to
+  // |pending_records_| under |pending_lock_|. |flush_lock_| serializes the
+  // writes to the file, so that the records are written in order.
+  bool async_;
+  LLock pending_lock_;
+  std::vector<char> pending_records_;
+  LLock flush_lock_;
+  std::vector<char> flushing_records_;
+  HANDLE flush_thread_;
+  HANDLE flush_event_;
+  HANDLE stop_event_;
+  HANDLE flush_thread_done_;
+
   friend class FileLogWriterTest;
 
   DISALLOW_COPY_AND_ASSIGN(FileLogWriter);
@@ -307,6 +374,8 @@ class OverrideConfigLogWriter : public LogWriter {
   virtual bool WantsToLogRegardless() const;
   virtual bool IsCatLevelEnabled(LogCategory category, LogLevel level) const;
   virtual void OutputMessage(const OutputInfo* output_info);
+  virtual void Flush();
+  virtual bool TryFlush();
  private:
   LogCategory category_;
   LogLevel level_;
@@ -391,6 +460,9 @@ class Logging {
   // Initializes the logging engine. Harmless to call multiple times.
   bool InitializeLogging();
 
+  // Writes out the messages buffered by the log writers.
+  void Flush();
+
   // Configures/unconfigures the log writers for the current settings.  That
   // is, given the current settings from GoogleUpdate.ini, either initializes
   // and registers the file-out and debug-out logwriters, or unregisters them.
@@ -13,8 +13,15 @@
 // limitations under the License.
 // ========================================================================
 
+#include <iostream>
+#include <vector>
+
 #include "base/basictypes.h"
+#include "omaha/base/app_util.h"
+#include "omaha/base/highres_timer-win32.h"
 #include "omaha/base/logging.h"
+#include "omaha/base/safe_format.h"
+#include "omaha/base/utils.h"
 #include "omaha/testing/unit_test.h"
 
 namespace omaha {
@@ -35,6 +42,91 @@ class FileLogWriterTest : public testing::Test {
                              const TCHAR* str) {
     return FileLogWriter::FindFirstInMultiString(multi_str, count, str);
   }
+
+ protected:
+  FileLogWriterTest() : writer_(NULL), num_messages_(0) {}
+
+  virtual void SetUp() {
+    log_file_ = GetTempFilenameAt(app_util::GetTempDir(), _T("log"));
+    ASSERT_FALSE(log_file_.IsEmpty());
+  }
+
+  virtual void TearDown() {
+    DeleteWriter();
+    ::DeleteFile(log_file_);
+  }
+
+  // Creates a writer which appends narrow strings to |log_file_|.
+  void CreateWriter(bool async) {
+    writer_ = FileLogWriter::Create(log_file_, true);
+    writer_->log_file_wide_ = false;
+    writer_->async_ = async;
+  }
+
+  // Deletes the writer, which writes out the pending messages.
+  void DeleteWriter() {
+    delete static_cast<LogWriter*>(writer_);
+    writer_ = NULL;
+  }
+
+  bool IsAsync() const {
+    return writer_->async_;
+  }
+
+  const LLock& pending_lock() const {
+    return writer_->pending_lock_;
+  }
+
+  CStringA ReadLogFile() {
+    std::vector<byte> buffer;
+    EXPECT_SUCCEEDED(ReadEntireFileShareMode(log_file_,
+                                             0,
+                                             FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                             &buffer));
+    return buffer.empty() ?
+        CStringA() :
+        CStringA(reinterpret_cast<const char*>(&buffer.front()),
+                 static_cast<int>(buffer.size()));
+  }
+
+  // Logs |num_messages| messages from each one of |num_threads| threads and
+  // returns the elapsed time in milliseconds.
+  ULONGLONG LogFromThreads(int num_threads, int num_messages) {
+    num_messages_ = num_messages;
+
+    HighresTimer timer;
+    std::vector<HANDLE> threads;
+    for (int i = 0; i < num_threads; ++i) {
+      HANDLE thread = ::CreateThread(NULL, 0, &ThreadProc, this, 0, NULL);
+      EXPECT_TRUE(thread);
+      if (thread) {
+        threads.push_back(thread);
+      }
+    }
+
+    for (size_t i = 0; i < threads.size(); ++i) {
+      EXPECT_EQ(WAIT_OBJECT_0, ::WaitForSingleObject(threads[i], INFINITE));
+      ::CloseHandle(threads[i]);
+    }
+    writer_->Flush();
+    return timer.GetElapsedMs();
+  }
+
+  static DWORD WINAPI ThreadProc(void* param) {
+    FileLogWriterTest* test = static_cast<FileLogWriterTest*>(param);
+    const CString prefix(_T("[01/02/26 10:11:12.123][GoogleUpdate][1234:5678]"));
+    for (int i = 0; i < test->num_messages_; ++i) {
+      CString msg;
+      SafeCStringFormat(&msg, _T("[LogFromThreads][message %d]"), i);
+      OutputInfo info(LC_CORE, L3, prefix, msg);
+      test->writer_->OutputMessage(&info);
+    }
+    return 0;
+  }
+
+  CString log_file_;
+  FileLogWriter* writer_;
+  int num_messages_;
 };
 
 class HistoryTest : public testing::Test {
@@ -101,6 +193,113 @@ TEST_F(FileLogWriterTest, FindInMultiString) {
   EXPECT_EQ(FindFirstInMultiString(s11, arraysize(s11), _T("a")), -1);
 }
 
+TEST_F(FileLogWriterTest, OutputMessage) {
+  CreateWriter(false);
+
+  OutputInfo info1(LC_CORE, L1, _T("[prefix]"), _T("message 1"));
+  writer_->OutputMessage(&info1);
+  OutputInfo info2(LC_CORE, L1, _T("[prefix]"), _T("message 2"));
+  writer_->OutputMessage(&info2);
+
+  EXPECT_STREQ("[prefix]message 1\r\n[prefix]message 2\r\n", ReadLogFile());
+}
+
+TEST_F(FileLogWriterTest, OutputMessage_Async) {
+  CreateWriter(true);
+
+  OutputInfo info1(LC_CORE, L1, _T("[prefix]"), _T("message 1"));
+  writer_->OutputMessage(&info1);
+  ASSERT_TRUE(IsAsync());
+  OutputInfo info2(LC_CORE, L1, _T("[prefix]"), _T("message 2"));
+  writer_->OutputMessage(&info2);
+
+  writer_->Flush();
+  EXPECT_STREQ("[prefix]message 1\r\n[prefix]message 2\r\n", ReadLogFile());
+
+  // Nothing is written twice.
+  writer_->Flush();
+  EXPECT_STREQ("[prefix]message 1\r\n[prefix]message 2\r\n", ReadLogFile());
+}
+
+// Simulates a crash of a thread which is appending a message.
+TEST_F(FileLogWriterTest, TryFlush_Async) {
+  CreateWriter(true);
+
+  OutputInfo info(LC_CORE, L1, _T("[prefix]"), _T("message"));
+  writer_->OutputMessage(&info);
+  ASSERT_TRUE(IsAsync());
+
+  ASSERT_TRUE(pending_lock().Lock());
+  EXPECT_FALSE(writer_->TryFlush());
+  EXPECT_TRUE(pending_lock().Unlock());
+
+  // The flush thread may be holding the locks for a moment.
+  bool is_flushed = false;
+  for (int i = 0; i != 10 && !is_flushed; ++i) {
+    is_flushed = writer_->TryFlush();
+    if (!is_flushed) {
+      ::Sleep(kLogFlushIntervalMs);
+    }
+  }
+  EXPECT_TRUE(is_flushed);
+  EXPECT_STREQ("[prefix]message\r\n", ReadLogFile());
+}
+
+TEST_F(FileLogWriterTest, OutputMessage_AsyncFlushedByTheThread) {
+  CreateWriter(true);
+
+  OutputInfo info(LC_CORE, L1, _T("[prefix]"), _T("message"));
+  writer_->OutputMessage(&info);
+
+  ::Sleep(10 * kLogFlushIntervalMs);
+  EXPECT_STREQ("[prefix]message\r\n", ReadLogFile());
+}
+
+TEST_F(FileLogWriterTest, OutputMessage_AsyncFlushedOnDelete) {
+  CreateWriter(true);
+
+  OutputInfo info(LC_CORE, L1, _T("[prefix]"), _T("message"));
+  writer_->OutputMessage(&info);
+  DeleteWriter();
+
+  EXPECT_STREQ("[prefix]message\r\n", ReadLogFile());
+}
+
+TEST_F(FileLogWriterTest, OutputMessage_AsyncFromThreads) {
+  const int kNumThreads = 8;
+  const int kNumMessages = 1000;
+
+  CreateWriter(true);
+  LogFromThreads(kNumThreads, kNumMessages);
+  DeleteWriter();
+
+  const CStringA log = ReadLogFile();
+  int num_lines = 0;
+  for (int pos = log.Find("\r\n"); pos != -1;
+       pos = log.Find("\r\n", pos + 2)) {
+    ++num_lines;
+  }
+  EXPECT_EQ(kNumThreads * kNumMessages, num_lines);
+}
+
+// Reports the number of log lines per second written by 8 threads, with the
+// asynchronous mode off and on.
+TEST_F(FileLogWriterTest, DISABLED_Throughput) {
+  const int kNumThreads = 8;
+  const int kNumMessages = 20000;
+
+  for (int async = 0; async <= 1; ++async) {
+    CreateWriter(async != 0);
+    const ULONGLONG elapsed_ms = LogFromThreads(kNumThreads, kNumMessages);
+    DeleteWriter();
+    ::DeleteFile(log_file_);
+
+    std::cout << (async ? "async: " : "sync: ")
+              << kNumThreads * kNumMessages * 1000ULL / (elapsed_ms + 1)
+              << " lines/s" << std::endl;
+  }
+}
+
 TEST_F(HistoryTest, GetHistory) {
   EXPECT_TRUE(GetHistory().IsEmpty());
 
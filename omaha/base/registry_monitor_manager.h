@@ -68,6 +68,14 @@ class RegistryMonitor {
                      RegistryKeyChangeCallback callback,
                      void* user_data);
 
+  // Monitors an existing registry sub key and all of its subkeys for changes.
+  // Unlike MonitorKey, the sub key is not created if it does not exist, so
+  // keys owned by others, such as the policy keys, can be monitored.
+  HRESULT MonitorKeyTree(HKEY root_key,
+                         const CString& sub_key,
+                         RegistryKeyChangeCallback callback,
+                         void* user_data);
+
   // Adds a registry value to the list of values to monitor for changes.
   // All values must be registered before starting monitoring. Registering
   // the same value is allowed, although not particularly useful.
@@ -231,5 +231,27 @@ TEST_F(RegistryMonitorTest, MonitorKey) {
                                                  kWaitForChangeMs));
 }
 
-}  // namespace omaha
+// Changes to the values of the subkeys are reported for a tree.
+TEST_F(RegistryMonitorTest, MonitorKeyTree) {
+  EXPECT_HRESULT_SUCCEEDED(RegKey::CreateKey(_T("HKCU\\key\\subkey")));
+
+  RegistryMonitor registry_monitor;
+  EXPECT_HRESULT_SUCCEEDED(registry_monitor.Initialize());
+  EXPECT_HRESULT_SUCCEEDED(registry_monitor.MonitorKeyTree(
+      HKEY_CURRENT_USER, kKeyName, RegistryKeyCallback, this));
+
+  EXPECT_HRESULT_SUCCEEDED(registry_monitor.StartMonitoring());
 
+  EXPECT_HRESULT_SUCCEEDED(RegKey::SetValue(_T("HKCU\\key\\subkey"),
+                                            kValueName,
+                                            static_cast<DWORD>(1)));
+  EXPECT_EQ(WAIT_OBJECT_0, ::WaitForSingleObject(get(registry_changed_event_),
+                                                 kWaitForChangeMs));
+
+  EXPECT_TRUE(::ResetEvent(get(registry_changed_event_)));
+  EXPECT_HRESULT_SUCCEEDED(RegKey::DeleteKey(_T("HKCU\\key\\subkey")));
+  EXPECT_EQ(WAIT_OBJECT_0, ::WaitForSingleObject(get(registry_changed_event_),
+                                                 kWaitForChangeMs));
+}
+
+}  // namespace omaha
@@ -25,6 +25,7 @@
 #include <stdint.h>
 #include <string.h>
 #include "p256.h"
+#include "p256_ec64.h"
 
 typedef uint8_t u8;
 typedef uint32_t u32;
@@ -1278,3 +1279,204 @@ void p256_points_mul_vartime(
   from_montgomery(out_x, px);
   from_montgomery(out_y, py);
 }
+
+#ifndef P256_64BIT_FIELD
+
+/* point_add_mixed_vartime sets {x_out,y_out,z_out} = {x1,y1,z1} + {x2,y2,1}
+ * and returns 1, or returns 0 if the sum is the point at infinity. Unlike
+ * point_add_mixed, it handles P+P and P+(-P). The outputs may alias the first
+ * point, which must not be the point at infinity. */
+static int point_add_mixed_vartime(felem x_out, felem y_out, felem z_out,
+                                   const felem x1, const felem y1,
+                                   const felem z1, const felem x2,
+                                   const felem y2) {
+  felem z1z1, z1z1z1, s2, u2, h, i, j, r, rr, v, tmp, tx, ty, tz;
+
+  felem_square(z1z1, z1);
+  felem_mul(u2, x2, z1z1);
+  felem_mul(z1z1z1, z1, z1z1);
+  felem_mul(s2, y2, z1z1z1);
+  felem_diff(h, u2, x1);
+  felem_diff(r, s2, y1);
+
+  if (felem_is_zero_vartime(h)) {
+    if (felem_is_zero_vartime(r)) {
+      point_double(x_out, y_out, z_out, x1, y1, z1);
+      return 1;
+    }
+    return 0;
+  }
+
+  /* The rest is the same as point_add_mixed. */
+  felem_sum(i, h, h);
+  felem_square(i, i);
+  felem_mul(j, h, i);
+  felem_sum(r, r, r);
+  felem_mul(v, x1, i);
+
+  felem_sum(tmp, z1, z1);
+  felem_mul(tz, tmp, h);
+  felem_square(rr, r);
+  felem_diff(tx, rr, j);
+  felem_diff(tx, tx, v);
+  felem_diff(tx, tx, v);
+
+  felem_diff(tmp, v, tx);
+  felem_mul(ty, tmp, r);
+  felem_mul(tmp, y1, j);
+  felem_diff(ty, ty, tmp);
+  felem_diff(ty, ty, tmp);
+
+  felem_assign(x_out, tx);
+  felem_assign(y_out, ty);
+  felem_assign(z_out, tz);
+  return 1;
+}
+
+/* comb_index returns the table index for the i'th iteration of the comb in
+ * the table selected by |j|, which is 0 or 32. See scalar_base_mult. */
+static limb comb_index(const p256_int* scalar, int i, int j) {
+  return p256_get_bit(scalar, 31 - i + j) |
+         (p256_get_bit(scalar, 95 - i + j) << 1) |
+         (p256_get_bit(scalar, 159 - i + j) << 2) |
+         (p256_get_bit(scalar, 223 - i + j) << 3);
+}
+
+/* make_point_table fills |table| with the multiples of {x,y} in the layout
+ * of kPrecomputed. */
+static void make_point_table(limb* table, const felem x, const felem y) {
+  felem base_x[8], base_y[8];
+  felem nx, ny, nz;
+  int i, k, t, index;
+
+  /* base_{x,y}[k] = 2**(32k){x,y} */
+  felem_assign(base_x[0], x);
+  felem_assign(base_y[0], y);
+  felem_assign(nx, x);
+  felem_assign(ny, y);
+  felem_assign(nz, kOne);
+  for (k = 1; k < 8; k++) {
+    for (i = 0; i < 32; i++) {
+      point_double(nx, ny, nz, nx, ny, nz);
+    }
+    point_to_affine(base_x[k], base_y[k], nx, ny, nz);
+  }
+
+  /* Each entry is the sum of a previous entry and of a multiple, none of
+   * which are equal or opposite points, therefore point_add_mixed is
+   * sufficient. */
+  for (t = 0; t < 2; t++) {
+    limb* entries = table + t * 30 * NLIMBS;
+    for (index = 1; index < 16; index++) {
+      limb* entry = entries + (index - 1) * 2 * NLIMBS;
+      int top = 3;
+      int rest;
+      while (!(index & (1 << top))) {
+        top--;
+      }
+      rest = index & ~(1 << top);
+
+      if (!rest) {
+        memcpy(entry, base_x[t + 2 * top], sizeof(felem));
+        memcpy(entry + NLIMBS, base_y[t + 2 * top], sizeof(felem));
+      } else {
+        const limb* prev = entries + (rest - 1) * 2 * NLIMBS;
+        point_add_mixed(nx, ny, nz, prev, prev + NLIMBS, kOne,
+                        base_x[t + 2 * top], base_y[t + 2 * top]);
+        point_to_affine(entry, entry + NLIMBS, nx, ny, nz);
+      }
+    }
+  }
+}
+
+/* points_mul_table_vartime sets {nx,ny,nz} = n1*G + n2*P, where |table| holds
+ * the multiples of P, and returns 1, or returns 0 if the result is the point
+ * at infinity. Both products are evaluated with the comb method of
+ * scalar_base_mult, sharing the doublings. */
+static int points_mul_table_vartime(felem nx, felem ny, felem nz,
+                                    const p256_int* n1, const p256_int* n2,
+                                    const limb* table) {
+  const limb* tables[2];
+  const p256_int* scalars[2];
+  int is_infinity = 1;
+  int i, j, k;
+
+  tables[0] = kPrecomputed;
+  tables[1] = table;
+  scalars[0] = n1;
+  scalars[1] = n2;
+
+  for (i = 0; i < 32; i++) {
+    if (!is_infinity) {
+      point_double(nx, ny, nz, nx, ny, nz);
+    }
+    for (j = 0; j <= 32; j += 32) {
+      for (k = 0; k < 2; k++) {
+        const limb index = comb_index(scalars[k], i, j);
+        const limb* entry;
+        if (!index) {
+          continue;
+        }
+
+        entry = tables[k] + (j ? 30 * NLIMBS : 0) + (index - 1) * 2 * NLIMBS;
+        if (is_infinity) {
+          memcpy(nx, entry, sizeof(felem));
+          memcpy(ny, entry + NLIMBS, sizeof(felem));
+          felem_assign(nz, kOne);
+          is_infinity = 0;
+        } else {
+          is_infinity = !point_add_mixed_vartime(nx, ny, nz, nx, ny, nz,
+                                                 entry, entry + NLIMBS);
+        }
+      }
+    }
+  }
+
+  return !is_infinity;
+}
+
+#endif  // P256_64BIT_FIELD
+
+int p256_point_table_init(const p256_int* in_x, const p256_int* in_y,
+                          p256_point_table* table) {
+  if (!p256_is_valid_point(in_x, in_y)) {
+    return 0;
+  }
+
+#ifdef P256_64BIT_FIELD
+  p256_ec64_point_table_init(in_x, in_y, table->limbs64);
+#else
+  {
+    felem px, py;
+
+    to_montgomery(px, in_x);
+    to_montgomery(py, in_y);
+    make_point_table(table->limbs32, px, py);
+  }
+#endif
+  return 1;
+}
+
+/* p256_points_mul_table_vartime sets {out_x,out_y} = n1*G + n2*P, where n1
+ * and n2 are < the order of the group and |table| holds the multiples of P.
+ *
+ * Like p256_points_mul_vartime, this function operates in variable time. */
+void p256_points_mul_table_vartime(
+    const p256_int* n1, const p256_int* n2, const p256_point_table* table,
+    p256_int* out_x, p256_int* out_y) {
+#ifdef P256_64BIT_FIELD
+  p256_ec64_points_mul_table_vartime(n1, n2, table->limbs64, out_x, out_y);
+#else
+  felem x, y, z, px, py;
+
+  if (!points_mul_table_vartime(x, y, z, n1, n2, table->limbs32)) {
+    p256_clear(out_x);
+    p256_clear(out_y);
+    return;
+  }
+
+  point_to_affine(px, py, x, y, z);
+  from_montgomery(out_x, px);
+  from_montgomery(out_y, py);
+#endif
+}
@@ -0,0 +1,560 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// P-256 field and group arithmetic with four 64-bit limbs per field element.
+//
+// WARNING: Unlike p256_ec.c, this code is NOT constant-time. It is only used
+//          to verify signatures, which does not involve secrets.
+
+#include "p256_ec64.h"
+
+#ifdef P256_64BIT_FIELD
+
+#include <string.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+typedef uint64_t u64;
+
+/* Field elements are four 64-bit limbs in little-endian order. The values are
+ * fully reduced and in Montgomery form: |y| is stored as (y*R) mod p, where
+ * R is 2**256. */
+typedef u64 fe64[4];
+
+/* p = 2**256 - 2**224 + 2**192 + 2**96 - 1 */
+static const fe64 kP64 = {
+  0xffffffffffffffffULL, 0x00000000ffffffffULL,
+  0x0000000000000000ULL, 0xffffffff00000001ULL
+};
+
+/* p - 2, the exponent which inverts a field element. */
+static const fe64 kPMinus2 = {
+  0xfffffffffffffffdULL, 0x00000000ffffffffULL,
+  0x0000000000000000ULL, 0xffffffff00000001ULL
+};
+
+/* 1 in Montgomery form, that is R mod p. */
+static const fe64 kOne64 = {
+  0x0000000000000001ULL, 0xffffffff00000000ULL,
+  0xffffffffffffffffULL, 0x00000000fffffffeULL
+};
+
+/* R**2 mod p, which converts to Montgomery form. */
+static const fe64 kR2 = {
+  0x0000000000000003ULL, 0xfffffffbffffffffULL,
+  0xfffffffffffffffeULL, 0x00000004fffffffdULL
+};
+
+/* kPrecomputed64 holds the same multiples of the base point G as
+ * kPrecomputed in p256_ec.c, as affine (x,y) pairs of fe64:
+ *
+ *   Index  |  Value
+ *   0..14  |  sums of the subsets of {G, 2**64G, 2**128G, 2**192G}
+ *  15..29  |  sums of the subsets of {2**32G, 2**96G, 2**160G, 2**224G}
+ *
+ * where bit k of (index % 15 + 1) selects the k'th term. */
+static const u64 kPrecomputed64[4 * 2 * 15 * 2] = {
+  0x79e730d418a9143cULL, 0x75ba95fc5fedb601ULL,
+  0x79fb732b77622510ULL, 0x18905f76a53755c6ULL,
+  0xddf25357ce95560aULL, 0x8b4ab8e4ba19e45cULL,
+  0xd2e88688dd21f325ULL, 0x8571ff1825885d85ULL,
+  0x4f922fc516a0d2bbULL, 0x0d5cc16c1a623499ULL,
+  0x9241cf3a57c62c8bULL, 0x2f5e6961fd1b667fULL,
+  0x5c15c70bf5a01797ULL, 0x3d20b44d60956192ULL,
+  0x04911b37071fdb52ULL, 0xf648f9168d6f0f7bULL,
+  0x9e566847e137bbbcULL, 0xe434469e8a6a0becULL,
+  0xb1c4276179d73463ULL, 0x5abe0285133d0015ULL,
+  0x92aa837cc04c7dabULL, 0x573d9f4c43260c07ULL,
+  0x0c93156278e6cc37ULL, 0x94bb725b6b6f7383ULL,
+  0x62a8c244bfe20925ULL, 0x91c19ac38fdce867ULL,
+  0x5a96a5d5dd387063ULL, 0x61d587d421d324f6ULL,
+  0xe87673a2a37173eaULL, 0x2384800853778b65ULL,
+  0x10f8441e05bab43eULL, 0xfa11fe124621efbeULL,
+  0x1c891f2b2cb19ffdULL, 0x01ba8d5bb1923c23ULL,
+  0xb6d03d678ac5ca8eULL, 0x586eb04c1f13bedcULL,
+  0x0c35c6e527e8ed09ULL, 0x1e81a33c1819ede2ULL,
+  0x278fd6c056c652faULL, 0x19d5ac0870864f11ULL,
+  0x62577734d2b533d5ULL, 0x673b8af6a1bdddc0ULL,
+  0x577e7c9aa79ec293ULL, 0xbb6de651c3b266b1ULL,
+  0xe7e9303ab65259b3ULL, 0xd6a0afd3d03a7480ULL,
+  0xc5ac83d19b3cfc27ULL, 0x60b4619a5d18b99bULL,
+  0xbd6a38e11ae5aa1cULL, 0xb8b7652b49e73658ULL,
+  0x0b130014ee5f87edULL, 0x9d0f27b2aeebffcdULL,
+  0xca9246317a730a55ULL, 0x9c955b2fddbbc83aULL,
+  0x07c1dfe0ac019a71ULL, 0x244a566d356ec48dULL,
+  0x56f8410ef4f8b16aULL, 0x97241afec47b266aULL,
+  0x0a406b8e6d9c87c1ULL, 0x803f3e02cd42ab1bULL,
+  0x7f0309a804dbec69ULL, 0xa83b85f73bbad05fULL,
+  0xc6097273ad8e197fULL, 0xc097440e5067adc1ULL,
+  0x846a56f2c379ab34ULL, 0xa8ee068b841df8d1ULL,
+  0x20314459176c68efULL, 0xf1af32d5915f1f30ULL,
+  0x99c375315d75bd50ULL, 0x837cffbaf72f67bcULL,
+  0x0613a41848d7723fULL, 0x23d0f130e2d41c8bULL,
+  0xed93e225d5be5a2bULL, 0x6fe799835934f3c6ULL,
+  0x4314092622626ffcULL, 0x50bbb4d97990216aULL,
+  0x378191c6e57ec63eULL, 0x65422c40181dcdb2ULL,
+  0x41a8099b0236e0f6ULL, 0x2b10011801fe49c3ULL,
+  0xfc68b5c59b391593ULL, 0xc385f5a2598270fcULL,
+  0x7144f3aad19adcbbULL, 0xdd55899983fbae0cULL,
+  0x93b88b8e74b82ff4ULL, 0xd2e03c4071e734c9ULL,
+  0x9a7a9eaf43c0322aULL, 0xe6e4c551149d6041ULL,
+  0x5fe14bfe80ec21feULL, 0xf6ce116ac255be82ULL,
+  0x98bc5a072f4a5d67ULL, 0xfad27148db7e63afULL,
+  0x90c0b6ac29ab05b3ULL, 0x37a9a83c4e251ae6ULL,
+  0x0a7dc875c2aade7dULL, 0x77387de39f0e1a84ULL,
+  0x1e9ecc49a56c0dd7ULL, 0xa5cffcd846086c74ULL,
+  0x8f7a1408f505aeceULL, 0xb37b85c0bef0c47eULL,
+  0x3596b6e4cc0e6a8fULL, 0xfd6d4bbf6b388f23ULL,
+  0xaba453fac39cef4eULL, 0x9c135ac8f9f628d5ULL,
+  0x0a1c729495c8f8beULL, 0x2961c4803bf362bfULL,
+  0x9e418403df63d4acULL, 0xc109f9cb91ece900ULL,
+  0xc2d095d058945705ULL, 0xb9083d96ddeb85c0ULL,
+  0x84692b8d7a40449bULL, 0x9bc3344f2eee1ee1ULL,
+  0x0d5ae35642913074ULL, 0x55491b2748a542b1ULL,
+  0x469ca665b310732aULL, 0x29591d525f1a4cc1ULL,
+  0xe76f5b6bb84f983fULL, 0xbe7eef419f5f84e1ULL,
+  0x1200d49680baa189ULL, 0x6376551f18ef332cULL,
+  0x202886024147519aULL, 0xd0981eac26b372f0ULL,
+  0xa9d4a7caa785ebc8ULL, 0xd953c50ddbdf58e9ULL,
+  0x9d6361ccfd590f8fULL, 0x72e9626b44e6c917ULL,
+  0x7fd9611022eb64cfULL, 0x863ebb7e9eb288f3ULL,
+  0x4fe7ee31b0e63d34ULL, 0xf4600572a9e54fabULL,
+  0xc0493334d5e7b5a4ULL, 0x8589fb9206d54831ULL,
+  0xaa70f5cc6583553aULL, 0x0879094ae25649e5ULL,
+  0xcc90450710044652ULL, 0xebb0696d02541c4fULL,
+  0xabbaa0c03b89da99ULL, 0xa6f2d79eb8284022ULL,
+  0x27847862b81c05e8ULL, 0x337a4b5905e54d63ULL,
+  0x3c67500d21f7794aULL, 0x207005b77d6d7f61ULL,
+  0x0a5a378104cfd6e8ULL, 0x0d65e0d5f4c2fbd6ULL,
+  0xd433e50f6d3549cfULL, 0x6f33696ffacd665eULL,
+  0x695bfdacce11fcb4ULL, 0x810ee252af7c9860ULL,
+  0x65450fe17159bb2cULL, 0xf7dfbebe758b357bULL,
+  0x2b057e74d69fea72ULL, 0xd485717a92731745ULL,
+  0xce1f69bbe83f7669ULL, 0x09f8ae8272877d6bULL,
+  0x9548ae543244278dULL, 0x207755dee3c2c19cULL,
+  0x87bd61d96fef1945ULL, 0x18813cefb12d28c3ULL,
+  0x9fbcd1d672df64aaULL, 0x48dc5ee57154b00dULL,
+  0xef0f469ef49a3154ULL, 0x3e85a5956e2b2e9aULL,
+  0x45aaec1eaa924a9cULL, 0xaa12dfc8a09e4719ULL,
+  0x26f272274df69f1dULL, 0xe0e4c82ca2ff5e73ULL,
+  0xb9d8ce73b7a9dd44ULL, 0x6c036e73e48ca901ULL,
+  0xe1e421e1a47153f0ULL, 0xb86c3b79920418c9ULL,
+  0x93bdce87705d7672ULL, 0xf25ae793cab79a77ULL,
+  0x1f3194a36d869d0cULL, 0x9d55c8824986c264ULL,
+  0x49fb5ea3096e945eULL, 0x39b8e65313db0a3eULL,
+  0xe3417bc035d0b34aULL, 0x440b386b8327c0a7ULL,
+  0x8fb7262dac0362d1ULL, 0x2c41114ce0cdf943ULL,
+  0x2ba5cef1ad95a0b1ULL, 0xc09b37a867d54362ULL,
+  0x26d6cdd201e486c9ULL, 0x20477abf42ff9297ULL,
+  0x0f121b41bc0a67d2ULL, 0x62d4760a444d248aULL,
+  0x0e044f1d659b4737ULL, 0x08fde365250bb4a8ULL,
+  0xaceec3da848bf287ULL, 0xc2a62182d3369d6eULL,
+  0x3582dfdc92449482ULL, 0x2f7e2fd2565d6cd7ULL,
+  0x0a0122b5178a876bULL, 0x51ff96ff085104b4ULL,
+  0x050b31ab14f29f76ULL, 0x84abb28b5f87d4e6ULL,
+  0xd5ed439f8270790aULL, 0x2d6cb59d85e3f46bULL,
+  0x75f55c1b6c1e2212ULL, 0xe5436f6717655640ULL,
+  0xc2965ecc9aeb596dULL, 0x01ea03e7023c92b4ULL,
+  0x4704b4b62e013961ULL, 0x0ca8fd3f905ea367ULL,
+  0x92523a42551b2b61ULL, 0x1eb7a89c390fcd06ULL,
+  0xe7f1d2be0392a63eULL, 0x96dca2644ddb0c33ULL,
+  0x231c210e15339848ULL, 0xe87a28e870778c8dULL,
+  0x9d1de6616956e170ULL, 0x4ac3c9382bb09c0bULL,
+  0x19be05516998987dULL, 0x8b2376c4ae09f4d6ULL,
+  0x1de0b7651a3f933dULL, 0x380d94c7e39705f4ULL,
+  0x3685954b8c31c31dULL, 0x68533d005bf21a0cULL,
+  0x0bd7626e75c79ec9ULL, 0xca17754742c69d54ULL,
+  0xcc6edafff6d2dbb2ULL, 0xfd0d8cbd174a9d18ULL,
+  0x875e8793aa4578e8ULL, 0xa976a7139cab2ce6ULL,
+  0xce37ab11b43ea1dbULL, 0x0a7ff1a95259d292ULL,
+  0x851b02218f84f186ULL, 0xa7222beadefaad13ULL,
+  0xa2ac78ec2b0a9144ULL, 0x5a024051f2fa59c5ULL,
+  0x91d1eca56147ce38ULL, 0xbe94d523bc2ac690ULL,
+  0x2d8daefd79ec1a0fULL, 0x3bbcd6fdceb39c97ULL,
+  0xf5575ffc58f61a95ULL, 0xdbd986c4adf7b420ULL,
+  0x81aa881415f39eb7ULL, 0x6ee2fcf5b98d976cULL,
+  0x5465475dcf2f717dULL, 0x8e24d3c46860bbd0ULL,
+};
+
+/* mul_add returns the low word of a*b + c + d and sets |hi| to the high
+ * word. The result cannot overflow 128 bits. */
+static u64 mul_add(u64 a, u64 b, u64 c, u64 d, u64* hi) {
+#ifdef _MSC_VER
+  u64 high;
+  u64 low = _umul128(a, b, &high);
+  low += c;
+  high += low < c;
+  low += d;
+  high += low < d;
+  *hi = high;
+  return low;
+#else
+  unsigned __int128 r = (unsigned __int128)a * b + c + d;
+  *hi = (u64)(r >> 64);
+  return (u64)r;
+#endif
+}
+
+/* sub_borrow returns a - b - |borrow| and updates |borrow|. */
+static u64 sub_borrow(u64 a, u64 b, u64* borrow) {
+  u64 d = a - b;
+  u64 out = d - *borrow;
+  *borrow = (a < b) | (d < *borrow);
+  return out;
+}
+
+/* fe64_reduce_once sets out = {in,top} mod p for {in,top} < 2p. */
+static void fe64_reduce_once(fe64 out, const u64 in[4], u64 top) {
+  u64 s[4];
+  u64 borrow = 0;
+  int i;
+
+  for (i = 0; i < 4; i++) {
+    s[i] = sub_borrow(in[i], kP64[i], &borrow);
+  }
+  if (top || !borrow) {
+    memcpy(out, s, sizeof(s));
+  } else if (out != in) {
+    memcpy(out, in, sizeof(fe64));
+  }
+}
+
+/* fe64_mul sets out = a*b/R mod p. The output may alias the inputs.
+ *
+ * This is the CIOS Montgomery multiplication. Since p = -1 mod 2**64, the
+ * multiple of p which clears the lowest word is that word itself. */
+static void fe64_mul(fe64 out, const fe64 a, const fe64 b) {
+  u64 t[6] = {0};
+  u64 carry, m;
+  int i, j;
+
+  for (i = 0; i < 4; i++) {
+    carry = 0;
+    for (j = 0; j < 4; j++) {
+      t[j] = mul_add(a[j], b[i], t[j], carry, &carry);
+    }
+    t[4] += carry;
+    t[5] = t[4] < carry;
+
+    m = t[0];
+    mul_add(m, kP64[0], t[0], 0, &carry);
+    for (j = 1; j < 4; j++) {
+      t[j - 1] = mul_add(m, kP64[j], t[j], carry, &carry);
+    }
+    t[3] = t[4] + carry;
+    t[4] = t[5] + (t[3] < carry);
+  }
+
+  fe64_reduce_once(out, t, t[4]);
+}
+
+static void fe64_square(fe64 out, const fe64 in) {
+  fe64_mul(out, in, in);
+}
+
+/* fe64_add sets out = a+b mod p. */
+static void fe64_add(fe64 out, const fe64 a, const fe64 b) {
+  u64 s[4];
+  u64 carry = 0;
+  int i;
+
+  for (i = 0; i < 4; i++) {
+    u64 sum = a[i] + carry;
+    carry = sum < carry;
+    s[i] = sum + b[i];
+    carry += s[i] < sum;
+  }
+  fe64_reduce_once(out, s, carry);
+}
+
+/* fe64_sub sets out = a-b mod p. */
+static void fe64_sub(fe64 out, const fe64 a, const fe64 b) {
+  u64 borrow = 0;
+  u64 carry = 0;
+  int i;
+
+  for (i = 0; i < 4; i++) {
+    out[i] = sub_borrow(a[i], b[i], &borrow);
+  }
+  if (borrow) {
+    for (i = 0; i < 4; i++) {
+      u64 sum = out[i] + carry;
+      carry = sum < carry;
+      out[i] = sum + kP64[i];
+      carry += out[i] < sum;
+    }
+  }
+}
+
+static int fe64_is_zero(const fe64 in) {
+  return (in[0] | in[1] | in[2] | in[3]) == 0;
+}
+
+/* fe64_inv sets out = in**-1 mod p, computed as in**(p-2). */
+static void fe64_inv(fe64 out, const fe64 in) {
+  fe64 r;
+  int i;
+
+  memcpy(r, kOne64, sizeof(r));
+  for (i = 255; i >= 0; i--) {
+    fe64_square(r, r);
+    if ((kPMinus2[i / 64] >> (i % 64)) & 1) {
+      fe64_mul(r, r, in);
+    }
+  }
+  memcpy(out, r, sizeof(r));
+}
+
+/* fe64_from_p256 sets out = in*R mod p. On entry: in < p. */
+static void fe64_from_p256(fe64 out, const p256_int* in) {
+  fe64 tmp;
+  int i;
+
+  for (i = 0; i < 4; i++) {
+    tmp[i] = (u64)P256_DIGIT(in, 2 * i) |
+             ((u64)P256_DIGIT(in, 2 * i + 1) << 32);
+  }
+  fe64_mul(out, tmp, kR2);
+}
+
+/* fe64_to_p256 sets out = in/R. */
+static void fe64_to_p256(p256_int* out, const fe64 in) {
+  static const fe64 kOneNotMontgomery = {1, 0, 0, 0};
+  fe64 tmp;
+  int i;
+
+  fe64_mul(tmp, in, kOneNotMontgomery);
+  for (i = 0; i < 4; i++) {
+    P256_DIGIT(out, 2 * i) = (p256_digit)tmp[i];
+    P256_DIGIT(out, 2 * i + 1) = (p256_digit)(tmp[i] >> 32);
+  }
+}
+
+/* Group operations, in Jacobian coordinates as in p256_ec.c. */
+
+/* point64_double sets {x_out,y_out,z_out} = 2*{x,y,z}. The outputs may alias
+ * the inputs.
+ *
+ * See http://www.hyperelliptic.org/EFD/g1p/auto-shortw-jacobian-0.html#doubling-dbl-2009-l */
+static void point64_double(fe64 x_out, fe64 y_out, fe64 z_out,
+                           const fe64 x, const fe64 y, const fe64 z) {
+  fe64 delta, gamma, alpha, beta, tmp, tmp2;
+
+  fe64_square(delta, z);
+  fe64_square(gamma, y);
+  fe64_mul(beta, x, gamma);
+
+  fe64_sub(tmp, x, delta);
+  fe64_add(tmp2, x, delta);
+  fe64_mul(alpha, tmp, tmp2);
+  fe64_add(tmp, alpha, alpha);
+  fe64_add(alpha, tmp, alpha);
+
+  fe64_add(tmp, y, z);
+  fe64_square(tmp, tmp);
+  fe64_sub(tmp, tmp, gamma);
+  fe64_sub(z_out, tmp, delta);
+
+  fe64_add(beta, beta, beta);
+  fe64_add(beta, beta, beta);
+  fe64_square(tmp, alpha);
+  fe64_sub(tmp, tmp, beta);
+  fe64_sub(x_out, tmp, beta);
+
+  fe64_sub(tmp, beta, x_out);
+  fe64_mul(tmp, alpha, tmp);
+  fe64_square(tmp2, gamma);
+  fe64_add(tmp2, tmp2, tmp2);
+  fe64_add(tmp2, tmp2, tmp2);
+  fe64_add(tmp2, tmp2, tmp2);
+  fe64_sub(y_out, tmp, tmp2);
+}
+
+/* point64_add_mixed_vartime sets {x_out,y_out,z_out} = {x1,y1,z1} + {x2,y2,1}
+ * and returns 1, or returns 0 if the sum is the point at infinity. The
+ * outputs may alias the first point, which must not be the point at
+ * infinity.
+ *
+ * See http://www.hyperelliptic.org/EFD/g1p/auto-shortw-jacobian-0.html#addition-madd-2007-bl */
+static int point64_add_mixed_vartime(fe64 x_out, fe64 y_out, fe64 z_out,
+                                     const fe64 x1, const fe64 y1,
+                                     const fe64 z1, const fe64 x2,
+                                     const fe64 y2) {
+  fe64 z1z1, u2, s2, h, r, i, j, v, tmp;
+
+  fe64_square(z1z1, z1);
+  fe64_mul(u2, x2, z1z1);
+  fe64_mul(s2, z1, z1z1);
+  fe64_mul(s2, y2, s2);
+  fe64_sub(h, u2, x1);
+  fe64_sub(r, s2, y1);
+
+  if (fe64_is_zero(h)) {
+    if (fe64_is_zero(r)) {
+      point64_double(x_out, y_out, z_out, x1, y1, z1);
+      return 1;
+    }
+    return 0;
+  }
+
+  fe64_add(r, r, r);
+  fe64_add(i, h, h);
+  fe64_square(i, i);
+  fe64_mul(j, h, i);
+  fe64_mul(v, x1, i);
+
+  fe64_mul(tmp, z1, h);
+  fe64_add(z_out, tmp, tmp);
+
+  fe64_square(tmp, r);
+  fe64_sub(tmp, tmp, j);
+  fe64_sub(tmp, tmp, v);
+  fe64_sub(x_out, tmp, v);
+
+  fe64_sub(tmp, v, x_out);
+  fe64_mul(tmp, r, tmp);
+  fe64_mul(j, y1, j);
+  fe64_add(j, j, j);
+  fe64_sub(y_out, tmp, j);
+  return 1;
+}
+
+/* point64_to_affine converts a Jacobian point, which must not be the point at
+ * infinity, to an affine point. */
+static void point64_to_affine(fe64 x_out, fe64 y_out, const fe64 x,
+                              const fe64 y, const fe64 z) {
+  fe64 z_inv, z_inv_sq;
+
+  fe64_inv(z_inv, z);
+  fe64_square(z_inv_sq, z_inv);
+  fe64_mul(x_out, x, z_inv_sq);
+  fe64_mul(z_inv, z_inv, z_inv_sq);
+  fe64_mul(y_out, y, z_inv);
+}
+
+/* comb_index returns the table index for the i'th iteration of the comb in
+ * the table selected by |j|, which is 0 or 32. */
+static int comb_index(const p256_int* scalar, int i, int j) {
+  return p256_get_bit(scalar, 31 - i + j) |
+         (p256_get_bit(scalar, 95 - i + j) << 1) |
+         (p256_get_bit(scalar, 159 - i + j) << 2) |
+         (p256_get_bit(scalar, 223 - i + j) << 3);
+}
+
+void p256_ec64_point_table_init(const p256_int* in_x,
+                                const p256_int* in_y,
+                                uint64_t* table) {
+  fe64 base_x[8], base_y[8];
+  fe64 x, y, z;
+  int i, k, t, index;
+
+  /* base_{x,y}[k] = 2**(32k){in_x,in_y} */
+  fe64_from_p256(base_x[0], in_x);
+  fe64_from_p256(base_y[0], in_y);
+  memcpy(x, base_x[0], sizeof(x));
+  memcpy(y, base_y[0], sizeof(y));
+  memcpy(z, kOne64, sizeof(z));
+  for (k = 1; k < 8; k++) {
+    for (i = 0; i < 32; i++) {
+      point64_double(x, y, z, x, y, z);
+    }
+    point64_to_affine(base_x[k], base_y[k], x, y, z);
+  }
+
+  /* The entries of the first table combine the multiples by 2**0, 2**64,
+   * 2**128 and 2**192, the entries of the second table combine the other
+   * four. Each entry is the sum of a previous entry and of a multiple, none
+   * of which are equal or opposite points. */
+  for (t = 0; t < 2; t++) {
+    u64* entries = table + t * 15 * 8;
+    for (index = 1; index < 16; index++) {
+      u64* entry = entries + (index - 1) * 8;
+      int top = 3;
+      int rest;
+      while (!(index & (1 << top))) {
+        top--;
+      }
+      rest = index & ~(1 << top);
+
+      if (!rest) {
+        memcpy(entry, base_x[t + 2 * top], sizeof(fe64));
+        memcpy(entry + 4, base_y[t + 2 * top], sizeof(fe64));
+      } else {
+        const u64* prev = entries + (rest - 1) * 8;
+        point64_add_mixed_vartime(x, y, z, prev, prev + 4, kOne64,
+                                  base_x[t + 2 * top], base_y[t + 2 * top]);
+        point64_to_affine(entry, entry + 4, x, y, z);
+      }
+    }
+  }
+}
+
+/* p256_ec64_points_mul_table_vartime evaluates both products with the comb
+ * method of scalar_base_mult in p256_ec.c, sharing the doublings. */
+void p256_ec64_points_mul_table_vartime(const p256_int* n1,
+                                        const p256_int* n2,
+                                        const uint64_t* table,
+                                        p256_int* out_x,
+                                        p256_int* out_y) {
+  const u64* tables[2];
+  const p256_int* scalars[2];
+  fe64 x, y, z;
+  int is_infinity = 1;
+  int i, j, k;
+
+  tables[0] = kPrecomputed64;
+  tables[1] = table;
+  scalars[0] = n1;
+  scalars[1] = n2;
+
+  for (i = 0; i < 32; i++) {
+    if (!is_infinity) {
+      point64_double(x, y, z, x, y, z);
+    }
+    for (j = 0; j <= 32; j += 32) {
+      for (k = 0; k < 2; k++) {
+        const int index = comb_index(scalars[k], i, j);
+        const u64* entry;
+        if (!index) {
+          continue;
+        }
+
+        entry = tables[k] + (j ? 15 * 8 : 0) + (index - 1) * 8;
+        if (is_infinity) {
+          memcpy(x, entry, sizeof(x));
+          memcpy(y, entry + 4, sizeof(y));
+          memcpy(z, kOne64, sizeof(z));
+          is_infinity = 0;
+        } else {
+          is_infinity = !point64_add_mixed_vartime(x, y, z, x, y, z,
+                                                   entry, entry + 4);
+        }
+      }
+    }
+  }
+
+  if (is_infinity) {
+    p256_clear(out_x);
+    p256_clear(out_y);
+    return;
+  }
+
+  point64_to_affine(x, y, x, y, z);
+  fe64_to_p256(out_x, x);
+  fe64_to_p256(out_y, y);
+}
+
+#endif  // P256_64BIT_FIELD
@@ -0,0 +1,56 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// Multiplications with precomputed tables using four 64-bit limbs per field
+// element. These back p256_point_table_init and
+// p256_points_mul_table_vartime on 64-bit builds.
+
+#ifndef OMAHA_BASE_SECURITY_P256_EC64_H_
+#define OMAHA_BASE_SECURITY_P256_EC64_H_
+
+#include <stdint.h>
+#include "p256.h"
+
+// Define P256_NO_64BIT_FIELD to use the portable 32-bit limbs of p256_ec.c on
+// 64-bit builds too.
+#if (defined(_M_X64) || defined(__x86_64__)) && !defined(P256_NO_64BIT_FIELD)
+#define P256_64BIT_FIELD
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef P256_64BIT_FIELD
+
+// Fills |table| with the multiples of {in_x,in_y}, which must be on the curve.
+void p256_ec64_point_table_init(const p256_int* in_x,
+                                const p256_int* in_y,
+                                uint64_t* table);
+
+// {out_x,out_y} := n1G + n2P, where |table| holds the multiples of P.
+void p256_ec64_points_mul_table_vartime(const p256_int* n1,
+                                        const p256_int* n2,
+                                        const uint64_t* table,
+                                        p256_int* out_x,
+                                        p256_int* out_y);
+
+#endif  // P256_64BIT_FIELD
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // OMAHA_BASE_SECURITY_P256_EC64_H_
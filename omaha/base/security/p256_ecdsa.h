@@ -43,6 +43,12 @@ int p256_ecdsa_verify(const p256_int* key_x,
                       const p256_int* message,
                       const p256_int* r, const p256_int* s);
 
+// Same as p256_ecdsa_verify, for a public key whose multiples have been
+// precomputed with p256_point_table_init, which also checked the key.
+int p256_ecdsa_verify_table(const p256_point_table* key_table,
+                            const p256_int* message,
+                            const p256_int* r, const p256_int* s);
+
 #ifdef __cplusplus
 }
 #endif
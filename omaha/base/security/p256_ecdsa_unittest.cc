@@ -20,9 +20,12 @@
 #include <ctype.h>
 
 
+#include <iostream>
+
 #include "p256.h"
 #include "p256_ecdsa.h"
 #include "p256_prng.h"
+#include "omaha/base/highres_timer-win32.h"
 #include "omaha/testing/unit_test.h"
 
 
@@ -110,3 +113,109 @@ TEST(P256_ECDSA, InvalidSigsTest) {
   }
 }
 
+// Picks a well distributed random number 0 < a < n.
+static void PickScalar(P256_PRNG_CTX* prng, p256_int* a) {
+  uint8_t tmp[P256_PRNG_SIZE];
+  do {
+    p256_int p1, p2;
+    p256_prng_draw(prng, tmp);
+    p256_from_bin(tmp, &p1);
+    p256_prng_draw(prng, tmp);
+    p256_from_bin(tmp, &p2);
+    p256_modmul(&SECP256r1_n, &p1, 0, &p2, a);
+  } while (p256_is_zero(a));
+}
+
+// Verifies random signatures with and without the precomputed multiples of
+// the public key.
+TEST(P256_ECDSA, TableSigsTest) {
+  P256_PRNG_CTX prng;
+  uint8_t tmp[P256_PRNG_SIZE];
+  uint32_t boot_count = static_cast<uint32_t>(time(NULL));
+
+  p256_prng_init(&prng, "table_sigs_test", 15, boot_count);
+
+  for (int n = 0; n < 20; ++n) {
+    p256_int a, b, Gx, Gy;
+    p256_int r, s;
+    p256_point_table table;
+
+    PickScalar(&prng, &a);
+    p256_base_point_mul(&a, &Gx, &Gy);
+    ASSERT_TRUE(p256_point_table_init(&Gx, &Gy, &table));
+
+    // The table products match the products computed from the point.
+    {
+      p256_int u1, u2, x1, y1, x2, y2;
+      PickScalar(&prng, &u1);
+      PickScalar(&prng, &u2);
+      p256_points_mul_vartime(&u1, &u2, &Gx, &Gy, &x1, &y1);
+      p256_points_mul_table_vartime(&u1, &u2, &table, &x2, &y2);
+      EXPECT_EQ(0, p256_cmp(&x1, &x2));
+      EXPECT_EQ(0, p256_cmp(&y1, &y2));
+    }
+
+    p256_prng_draw(&prng, tmp);
+    p256_from_bin(tmp, &b);
+    p256_ecdsa_sign(&a, &b, &r, &s);
+
+    EXPECT_TRUE(p256_ecdsa_verify(&Gx, &Gy, &b, &r, &s));
+    EXPECT_TRUE(p256_ecdsa_verify_table(&table, &b, &r, &s));
+
+    // Tamper with the message.
+    p256_add_d(&b, 1, &b);
+    EXPECT_FALSE(p256_ecdsa_verify(&Gx, &Gy, &b, &r, &s));
+    EXPECT_FALSE(p256_ecdsa_verify_table(&table, &b, &r, &s));
+  }
+
+  // A point which is not on the curve.
+  {
+    p256_int x = P256_ONE;
+    p256_int y = P256_ONE;
+    p256_point_table table;
+    EXPECT_FALSE(p256_point_table_init(&x, &y, &table));
+  }
+}
+
+// Reports the number of verifications per second with and without the
+// precomputed multiples of the public key.
+TEST(P256_ECDSA, DISABLED_VerifyThroughput) {
+  const int kNumVerifications = 2000;
+
+  P256_PRNG_CTX prng;
+  uint8_t tmp[P256_PRNG_SIZE];
+  p256_prng_init(&prng, "verify_throughput", 17, 0);
+
+  p256_int a, b, Gx, Gy;
+  p256_int r, s;
+  PickScalar(&prng, &a);
+  p256_base_point_mul(&a, &Gx, &Gy);
+  p256_prng_draw(&prng, tmp);
+  p256_from_bin(tmp, &b);
+  p256_ecdsa_sign(&a, &b, &r, &s);
+
+  HighresTimer verify_timer;
+  for (int i = 0; i < kNumVerifications; ++i) {
+    EXPECT_TRUE(p256_ecdsa_verify(&Gx, &Gy, &b, &r, &s));
+  }
+  const ULONGLONG verify_ms = verify_timer.GetElapsedMs();
+
+  HighresTimer init_timer;
+  p256_point_table table;
+  EXPECT_TRUE(p256_point_table_init(&Gx, &Gy, &table));
+  const ULONGLONG init_ms = init_timer.GetElapsedMs();
+
+  HighresTimer verify_table_timer;
+  for (int i = 0; i < kNumVerifications; ++i) {
+    EXPECT_TRUE(p256_ecdsa_verify_table(&table, &b, &r, &s));
+  }
+  const ULONGLONG verify_table_ms = verify_table_timer.GetElapsedMs();
+
+  std::cout << "p256_ecdsa_verify: "
+            << kNumVerifications * 1000 / (verify_ms + 1)
+            << " verifications/s" << std::endl;
+  std::cout << "p256_point_table_init: " << init_ms << " ms" << std::endl;
+  std::cout << "p256_ecdsa_verify_table: "
+            << kNumVerifications * 1000 / (verify_table_ms + 1)
+            << " verifications/s" << std::endl;
+}
@@ -0,0 +1,84 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// SHA-256 block functions. These are exposed for the sha256 implementation
+// and its unit tests only.
+
+#ifndef OMAHA_BASE_SECURITY_SHA256_INTERNAL_H_
+#define OMAHA_BASE_SECURITY_SHA256_INTERNAL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The x86 kernels are left out of size-constrained builds, which define
+// LITE_SHA256_SMALL to get the portable implementation only.
+#if (defined(_M_IX86) || defined(_M_X64)) && !defined(LITE_SHA256_SMALL)
+#define SHA256_X86_KERNELS
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif  // __cplusplus
+
+extern const uint32_t SHA256_K[64];
+
+// Processes |num_blocks| consecutive 64-byte blocks of |data|.
+typedef void (*SHA256_BLOCKS_FN)(uint32_t state[8],
+                                 const uint8_t* data,
+                                 size_t num_blocks);
+
+// Processes |num_blocks| 64-byte blocks for each of eight independent
+// messages. |state[i]| is updated with the blocks at |data[i]|.
+typedef void (*SHA256_BLOCKS_X8_FN)(uint32_t* const state[8],
+                                    const uint8_t* const data[8],
+                                    size_t num_blocks);
+
+// Portable implementation.
+void SHA256_blocks_generic(uint32_t state[8],
+                           const uint8_t* data,
+                           size_t num_blocks);
+
+#ifdef SHA256_X86_KERNELS
+
+// Returns non-zero if the CPU and the OS support the kernel.
+int SHA256_has_shani(void);
+int SHA256_has_avx2(void);
+
+// Uses the SHA extensions. Requires SHA256_has_shani().
+void SHA256_blocks_shani(uint32_t state[8],
+                         const uint8_t* data,
+                         size_t num_blocks);
+
+// Hashes eight messages in the eight 32-bit lanes of the AVX2 registers.
+// Requires SHA256_has_avx2().
+void SHA256_blocks_x8_avx2(uint32_t* const state[8],
+                           const uint8_t* const data[8],
+                           size_t num_blocks);
+
+#endif  // SHA256_X86_KERNELS
+
+// Returns the fastest block function for this CPU.
+SHA256_BLOCKS_FN SHA256_get_blocks_fn(void);
+
+// Returns the fastest eight-way block function for this CPU or NULL if
+// hashing the messages one after the other with SHA256_get_blocks_fn() is
+// faster.
+SHA256_BLOCKS_X8_FN SHA256_get_blocks_x8_fn(void);
+
+#ifdef __cplusplus
+}
+#endif  // __cplusplus
+
+#endif  // OMAHA_BASE_SECURITY_SHA256_INTERNAL_H_
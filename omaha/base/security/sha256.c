@@ -13,17 +13,21 @@
 // limitations under the License.
 // ========================================================================
 //
-// Optimized for minimal code size.
+// The portable block function is optimized for minimal code size. Unless
+// LITE_SHA256_SMALL is defined, x86 builds select a faster block function at
+// runtime, depending on the instruction set extensions of the CPU.
 
 #include "sha256.h"
 
 #include <stdint.h>
 #include <string.h>
 
+#include "sha256-internal.h"
+
 #define ror(value, bits) (((value) >> (bits)) | ((value) << (32 - (bits))))
 #define shr(value, bits) ((value) >> (bits))
 
-static const uint32_t K[64] = {
+const uint32_t SHA256_K[64] = {
   0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
   0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
   0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
@@ -41,61 +45,93 @@ static const uint32_t K[64] = {
   0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
   0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2 };
 
-static void SHA256_Transform(LITE_SHA256_CTX* ctx) {
+void SHA256_blocks_generic(uint32_t state[8],
+                           const uint8_t* data,
+                           size_t num_blocks) {
   uint32_t W[64];
   uint32_t A, B, C, D, E, F, G, H;
-  uint8_t* p = ctx->buf;
+  const uint8_t* p = data;
   int t;
 
-  for(t = 0; t < 16; ++t) {
-    uint32_t tmp =  (uint32_t)*p++ << 24;
-    tmp |= (uint32_t)*p++ << 16;
-    tmp |= (uint32_t)*p++ << 8;
-    tmp |= (uint32_t)*p++;
-    W[t] = tmp;
-  }
+  while (num_blocks--) {
+    for(t = 0; t < 16; ++t) {
+      uint32_t tmp =  (uint32_t)*p++ << 24;
+      tmp |= (uint32_t)*p++ << 16;
+      tmp |= (uint32_t)*p++ << 8;
+      tmp |= (uint32_t)*p++;
+      W[t] = tmp;
+    }
+
+    for(; t < 64; t++) {
+      uint32_t s0 = ror(W[t-15], 7) ^ ror(W[t-15], 18) ^ shr(W[t-15], 3);
+      uint32_t s1 = ror(W[t-2], 17) ^ ror(W[t-2], 19) ^ shr(W[t-2], 10);
+      W[t] = W[t-16] + s0 + W[t-7] + s1;
+    }
+
+    A = state[0];
+    B = state[1];
+    C = state[2];
+    D = state[3];
+    E = state[4];
+    F = state[5];
+    G = state[6];
+    H = state[7];
+
+    for(t = 0; t < 64; t++) {
+      uint32_t s0 = ror(A, 2) ^ ror(A, 13) ^ ror(A, 22);
+      uint32_t maj = (A & B) ^ (A & C) ^ (B & C);
+      uint32_t t2 = s0 + maj;
+      uint32_t s1 = ror(E, 6) ^ ror(E, 11) ^ ror(E, 25);
+      uint32_t ch = (E & F) ^ ((~E) & G);
+      uint32_t t1 = H + s1 + ch + SHA256_K[t] + W[t];
+
+      H = G;
+      G = F;
+      F = E;
+      E = D + t1;
+      D = C;
+      C = B;
+      B = A;
+      A = t1 + t2;
+    }
 
-  for(; t < 64; t++) {
-    uint32_t s0 = ror(W[t-15], 7) ^ ror(W[t-15], 18) ^ shr(W[t-15], 3);
-    uint32_t s1 = ror(W[t-2], 17) ^ ror(W[t-2], 19) ^ shr(W[t-2], 10);
-    W[t] = W[t-16] + s0 + W[t-7] + s1;
+    state[0] += A;
+    state[1] += B;
+    state[2] += C;
+    state[3] += D;
+    state[4] += E;
+    state[5] += F;
+    state[6] += G;
+    state[7] += H;
   }
+}
 
-  A = ctx->state[0];
-  B = ctx->state[1];
-  C = ctx->state[2];
-  D = ctx->state[3];
-  E = ctx->state[4];
-  F = ctx->state[5];
-  G = ctx->state[6];
-  H = ctx->state[7];
-
-  for(t = 0; t < 64; t++) {
-    uint32_t s0 = ror(A, 2) ^ ror(A, 13) ^ ror(A, 22);
-    uint32_t maj = (A & B) ^ (A & C) ^ (B & C);
-    uint32_t t2 = s0 + maj;
-    uint32_t s1 = ror(E, 6) ^ ror(E, 11) ^ ror(E, 25);
-    uint32_t ch = (E & F) ^ ((~E) & G);
-    uint32_t t1 = H + s1 + ch + K[t] + W[t];
-
-    H = G;
-    G = F;
-    F = E;
-    E = D + t1;
-    D = C;
-    C = B;
-    B = A;
-    A = t1 + t2;
+// The selected function is cached. Concurrent callers may race to select it
+// but they all select the same function.
+SHA256_BLOCKS_FN SHA256_get_blocks_fn(void) {
+  static volatile SHA256_BLOCKS_FN blocks_fn = NULL;
+  SHA256_BLOCKS_FN fn = blocks_fn;
+  if (!fn) {
+    fn = SHA256_blocks_generic;
+#ifdef SHA256_X86_KERNELS
+    if (SHA256_has_shani()) {
+      fn = SHA256_blocks_shani;
+    }
+#endif
+    blocks_fn = fn;
   }
+  return fn;
+}
 
-  ctx->state[0] += A;
-  ctx->state[1] += B;
-  ctx->state[2] += C;
-  ctx->state[3] += D;
-  ctx->state[4] += E;
-  ctx->state[5] += F;
-  ctx->state[6] += G;
-  ctx->state[7] += H;
+SHA256_BLOCKS_X8_FN SHA256_get_blocks_x8_fn(void) {
+#ifdef SHA256_X86_KERNELS
+  // A single stream hashed with the SHA extensions is faster than eight
+  // streams hashed with AVX2.
+  if (!SHA256_has_shani() && SHA256_has_avx2()) {
+    return SHA256_blocks_x8_avx2;
+  }
+#endif
+  return NULL;
 }
 
 static const HASH_VTAB SHA256_VTAB = {
@@ -121,17 +157,104 @@ void SHA256_init(LITE_SHA256_CTX* ctx) {
 
 
 void SHA256_update(LITE_SHA256_CTX* ctx, const void* data, size_t len) {
-  int i = (int) (ctx->count & 63);
+  size_t i = (size_t) (ctx->count & 63);
   const uint8_t* p = (const uint8_t*)data;
+  SHA256_BLOCKS_FN blocks = SHA256_get_blocks_fn();
 
   ctx->count += len;
 
-  while (len--) {
-    ctx->buf[i++] = *p++;
-    if (i == 64) {
-      SHA256_Transform(ctx);
-      i = 0;
+  // Complete the partial block buffered by a previous update.
+  if (i) {
+    size_t n = 64 - i;
+    if (n > len) {
+      n = len;
+    }
+    memcpy(ctx->buf + i, p, n);
+    p += n;
+    len -= n;
+    if (i + n < 64) {
+      return;
     }
+    blocks(ctx->state, ctx->buf, 1);
+  }
+
+  // Hash the whole blocks in place.
+  if (len >= 64) {
+    size_t num_blocks = len / 64;
+    blocks(ctx->state, p, num_blocks);
+    p += num_blocks * 64;
+    len -= num_blocks * 64;
+  }
+
+  if (len) {
+    memcpy(ctx->buf, p, len);
+  }
+}
+
+
+void SHA256_update_multi(LITE_SHA256_CTX* const ctx[],
+                         const void* const data[],
+                         size_t num_ctx,
+                         size_t len) {
+  SHA256_BLOCKS_X8_FN blocks_x8 = SHA256_get_blocks_x8_fn();
+  size_t first = 0;
+
+  while (first < num_ctx) {
+    uint32_t unused_state[8];
+    uint32_t* state[8];
+    const uint8_t* blocks[8];
+    size_t num_lanes = num_ctx - first;
+    size_t num_blocks = (size_t)-1;
+    size_t k;
+
+    if (num_lanes > 8) {
+      num_lanes = 8;
+    }
+
+    if (!blocks_x8 || num_lanes == 1) {
+      for (k = 0; k < num_lanes; ++k) {
+        SHA256_update(ctx[first + k], data[first + k], len);
+      }
+      first += num_lanes;
+      continue;
+    }
+
+    // Complete the partial blocks, then hash the whole blocks all lanes have
+    // in common in parallel. The contexts usually are at the same offset.
+    for (k = 0; k < num_lanes; ++k) {
+      LITE_SHA256_CTX* c = ctx[first + k];
+      const uint8_t* p = (const uint8_t*)data[first + k];
+      size_t i = (size_t) (c->count & 63);
+      size_t n = i ? 64 - i : 0;
+      if (n > len) {
+        n = len;
+      }
+      SHA256_update(c, p, n);
+      if ((len - n) / 64 < num_blocks) {
+        num_blocks = (len - n) / 64;
+      }
+      state[k] = c->state;
+      blocks[k] = p + n;
+    }
+    for (; k < 8; ++k) {
+      state[k] = unused_state;
+      blocks[k] = blocks[0];
+    }
+
+    if (num_blocks) {
+      memcpy(unused_state, ctx[first]->state, sizeof(unused_state));
+      blocks_x8(state, blocks, num_blocks);
+    }
+
+    for (k = 0; k < num_lanes; ++k) {
+      LITE_SHA256_CTX* c = ctx[first + k];
+      const uint8_t* begin = (const uint8_t*)data[first + k];
+      const uint8_t* p = blocks[k] + num_blocks * 64;
+      c->count += num_blocks * 64;
+      SHA256_update(c, p, len - (size_t)(p - begin));
+    }
+
+    first += num_lanes;
   }
 }
 
@@ -139,17 +262,21 @@ void SHA256_update(LITE_SHA256_CTX* ctx, const void* data, size_t len) {
 const uint8_t* SHA256_final(LITE_SHA256_CTX* ctx) {
   uint8_t *p = ctx->buf;
   uint64_t cnt = LITE_LShiftU64(ctx->count, 3);
-  int i;
+  size_t i = (size_t) (ctx->count & 63);
+  SHA256_BLOCKS_FN blocks = SHA256_get_blocks_fn();
 
-  SHA256_update(ctx, (uint8_t*)"\x80", 1);
-  while ((ctx->count & 63) != 56) {
-    SHA256_update(ctx, (uint8_t*)"\0", 1);
+  ctx->buf[i++] = 0x80;
+  if (i > 56) {
+    memset(ctx->buf + i, 0, 64 - i);
+    blocks(ctx->state, ctx->buf, 1);
+    i = 0;
   }
+  memset(ctx->buf + i, 0, 56 - i);
   for (i = 0; i < 8; ++i) {
-    uint8_t tmp = (uint8_t)LITE_RShiftU64(cnt, 56);
-    cnt = LITE_LShiftU64(cnt, 8);
-    SHA256_update(ctx, &tmp, 1);
+    ctx->buf[63 - i] = (uint8_t)cnt;
+    cnt = LITE_RShiftU64(cnt, 8);
   }
+  blocks(ctx->state, ctx->buf, 1);
 
   for (i = 0; i < 8; i++) {
     uint32_t tmp = ctx->state[i];
@@ -30,6 +30,15 @@ void SHA256_init(LITE_SHA256_CTX* ctx);
 void SHA256_update(LITE_SHA256_CTX* ctx, const void* data, size_t len);
 const uint8_t* SHA256_final(LITE_SHA256_CTX* ctx);
 
+// Updates each of the |num_ctx| contexts with |len| bytes from the matching
+// element of |data|. The result is the same as calling SHA256_update for each
+// context, but on CPUs without SHA extensions and with AVX2, up to eight
+// contexts are updated at once.
+void SHA256_update_multi(LITE_SHA256_CTX* const ctx[],
+                         const void* const data[],
+                         size_t num_ctx,
+                         size_t len);
+
 // Convenience method. Returns digest address.
 const uint8_t* SHA256_hash(const void* data, size_t len, uint8_t* digest);
 
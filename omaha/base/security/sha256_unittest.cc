@@ -14,8 +14,12 @@
 // ========================================================================
 
 #include "omaha/base/security/sha256.h"
+#include <algorithm>
 #include <cstring>
+#include <iostream>
 #include <vector>
+#include "omaha/base/highres_timer-win32.h"
+#include "omaha/base/security/sha256-internal.h"
 #include "omaha/testing/unit_test.h"
 
 namespace omaha {
@@ -66,5 +70,167 @@ TEST(Security, Sha256) {
   }
 }
 
+namespace {
+
+const uint32_t kInitialState[8] = {
+  0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+  0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+std::vector<uint8_t> MakeTestData(size_t size) {
+  std::vector<uint8_t> data(size);
+  uint32_t x = 0x12345678;
+  for (size_t i = 0; i != size; ++i) {
+    x = x * 1103515245 + 12345;
+    data[i] = static_cast<uint8_t>(x >> 16);
+  }
+  return data;
+}
+
+}  // namespace
+
+// The data is hashed in pieces which are not multiples of the block size, at
+// offsets which are not aligned.
+TEST(Security, Sha256_Update) {
+  const std::vector<uint8_t> data = MakeTestData(4096);
+
+  for (size_t piece_size = 1; piece_size < 200; piece_size += 7) {
+    LITE_SHA256_CTX context = {0};
+    SHA256_init(&context);
+    for (size_t i = 0; i < data.size(); i += piece_size) {
+      SHA256_update(&context,
+                    &data[i],
+                    std::min(piece_size, data.size() - i));
+    }
+
+    uint8_t expected[SHA256_DIGEST_SIZE] = {0};
+    SHA256_hash(&data[0], data.size(), expected);
+    EXPECT_EQ(0, memcmp(expected, SHA256_final(&context), sizeof(expected)));
+  }
+}
+
+TEST(Security, Sha256_Kernels) {
+  const std::vector<uint8_t> data = MakeTestData(8 * 64 * 17 + 8);
+
+  for (size_t num_blocks = 0; num_blocks <= 17; ++num_blocks) {
+    uint32_t expected[8] = {0};
+    memcpy(expected, kInitialState, sizeof(expected));
+    SHA256_blocks_generic(expected, &data[1], num_blocks);
+
+    uint32_t actual[8] = {0};
+    memcpy(actual, kInitialState, sizeof(actual));
+    SHA256_get_blocks_fn()(actual, &data[1], num_blocks);
+    EXPECT_EQ(0, memcmp(expected, actual, sizeof(expected)));
+
+#ifdef SHA256_X86_KERNELS
+    if (SHA256_has_shani()) {
+      memcpy(actual, kInitialState, sizeof(actual));
+      SHA256_blocks_shani(actual, &data[1], num_blocks);
+      EXPECT_EQ(0, memcmp(expected, actual, sizeof(expected)));
+    }
+
+    if (SHA256_has_avx2()) {
+      uint32_t states[8][8] = {0};
+      uint32_t* state_ptrs[8] = {0};
+      const uint8_t* block_ptrs[8] = {0};
+      for (size_t k = 0; k != 8; ++k) {
+        memcpy(states[k], kInitialState, sizeof(states[k]));
+        state_ptrs[k] = states[k];
+        block_ptrs[k] = &data[k * 64 * num_blocks + k];
+      }
+      SHA256_blocks_x8_avx2(state_ptrs, block_ptrs, num_blocks);
+
+      for (size_t k = 0; k != 8; ++k) {
+        memcpy(expected, kInitialState, sizeof(expected));
+        SHA256_blocks_generic(expected, block_ptrs[k], num_blocks);
+        EXPECT_EQ(0, memcmp(expected, states[k], sizeof(expected)));
+      }
+    }
+#endif  // SHA256_X86_KERNELS
+  }
+}
+
+TEST(Security, Sha256_UpdateMulti) {
+  const size_t kNumContexts = 11;
+  const std::vector<uint8_t> data = MakeTestData(kNumContexts * 1000);
+
+  LITE_SHA256_CTX contexts[kNumContexts] = {0};
+  LITE_SHA256_CTX* context_ptrs[kNumContexts] = {0};
+  for (size_t k = 0; k != kNumContexts; ++k) {
+    SHA256_init(&contexts[k]);
+    context_ptrs[k] = &contexts[k];
+  }
+
+  // Update the contexts with pieces of different sizes.
+  const size_t kPieceSizes[] = {0, 3, 64, 61, 200, 1, 128, 543};
+  size_t offset = 0;
+  for (size_t i = 0; i != arraysize(kPieceSizes); ++i) {
+    const void* pieces[kNumContexts] = {0};
+    for (size_t k = 0; k != kNumContexts; ++k) {
+      pieces[k] = &data[k * 1000 + offset];
+    }
+    SHA256_update_multi(context_ptrs, pieces, kNumContexts, kPieceSizes[i]);
+    offset += kPieceSizes[i];
+  }
+  ASSERT_EQ(1000u, offset);
+
+  for (size_t k = 0; k != kNumContexts; ++k) {
+    uint8_t expected[SHA256_DIGEST_SIZE] = {0};
+    SHA256_hash(&data[k * 1000], 1000, expected);
+    EXPECT_EQ(0, memcmp(expected, SHA256_final(&contexts[k]),
+                        sizeof(expected)));
+  }
+}
+
+// Reports the throughput of the block functions. The portable function is the
+// one the library used on all CPUs before the x86 kernels were added.
+TEST(Security, DISABLED_Sha256_Throughput) {
+  const size_t kSize = 64 * 1024 * 1024;
+  const std::vector<uint8_t> data = MakeTestData(kSize);
+  const double size_mb = static_cast<double>(kSize) / (1024 * 1024);
+
+  uint32_t state[8] = {0};
+  memcpy(state, kInitialState, sizeof(state));
+
+  HighresTimer generic_timer;
+  SHA256_blocks_generic(state, &data[0], kSize / 64);
+  std::cout << "generic: "
+            << size_mb * 1000 / (generic_timer.GetElapsedMs() + 1)
+            << " MB/s" << std::endl;
+
+  HighresTimer hash_timer;
+  uint8_t digest[SHA256_DIGEST_SIZE] = {0};
+  SHA256_hash(&data[0], kSize, digest);
+  std::cout << "SHA256_hash: "
+            << size_mb * 1000 / (hash_timer.GetElapsedMs() + 1)
+            << " MB/s" << std::endl;
+
+#ifdef SHA256_X86_KERNELS
+  if (SHA256_has_shani()) {
+    HighresTimer shani_timer;
+    SHA256_blocks_shani(state, &data[0], kSize / 64);
+    std::cout << "SHA extensions: "
+              << size_mb * 1000 / (shani_timer.GetElapsedMs() + 1)
+              << " MB/s" << std::endl;
+  }
+
+  if (SHA256_has_avx2()) {
+    uint32_t states[8][8] = {0};
+    uint32_t* state_ptrs[8] = {0};
+    const uint8_t* block_ptrs[8] = {0};
+    for (size_t k = 0; k != 8; ++k) {
+      state_ptrs[k] = states[k];
+      block_ptrs[k] = &data[k * (kSize / 8)];
+    }
+
+    HighresTimer avx2_timer;
+    SHA256_blocks_x8_avx2(state_ptrs, block_ptrs, kSize / 8 / 64);
+    std::cout << "AVX2, eight messages: "
+              << size_mb * 1000 / (avx2_timer.GetElapsedMs() + 1)
+              << " MB/s" << std::endl;
+  }
+#endif  // SHA256_X86_KERNELS
+}
+
 }  // namespace omaha
 
@@ -0,0 +1,266 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// SHA-256 block functions for x86 CPUs with the SHA extensions or AVX2. The
+// functions are selected at runtime by sha256.c, therefore this file must be
+// compiled without /arch flags which would let the compiler use the
+// extensions elsewhere.
+
+#include "sha256-internal.h"
+
+#ifdef SHA256_X86_KERNELS
+
+#include <intrin.h>
+#include <immintrin.h>
+#include <string.h>
+
+#define SHA256_CPU_SHA  0x1
+#define SHA256_CPU_AVX2 0x2
+
+static int SHA256_GetCpuFeatures(void) {
+  static volatile int cpu_features = -1;
+  int features = cpu_features;
+  int regs[4] = {0};
+  int max_leaf = 0;
+  int ecx1 = 0;
+  int ebx7 = 0;
+
+  if (features >= 0) {
+    return features;
+  }
+
+  __cpuid(regs, 0);
+  max_leaf = regs[0];
+  if (max_leaf >= 1) {
+    __cpuid(regs, 1);
+    ecx1 = regs[2];
+  }
+  if (max_leaf >= 7) {
+    __cpuidex(regs, 7, 0);
+    ebx7 = regs[1];
+  }
+
+  features = 0;
+
+  // SHA (CPUID.7:EBX[29]). The kernel uses SSSE3 (CPUID.1:ECX[9]) and
+  // SSE4.1 (CPUID.1:ECX[19]) too.
+  if ((ebx7 & (1 << 29)) && (ecx1 & (1 << 9)) && (ecx1 & (1 << 19))) {
+    features |= SHA256_CPU_SHA;
+  }
+
+  // AVX2 (CPUID.7:EBX[5]) requires the OS to save the YMM registers, which is
+  // indicated by OSXSAVE (CPUID.1:ECX[27]) and by XCR0[2:1].
+  if ((ebx7 & (1 << 5)) &&
+      (ecx1 & (1 << 27)) &&
+      (ecx1 & (1 << 28)) &&
+      (_xgetbv(0) & 0x6) == 0x6) {
+    features |= SHA256_CPU_AVX2;
+  }
+
+  cpu_features = features;
+  return features;
+}
+
+int SHA256_has_shani(void) {
+  return (SHA256_GetCpuFeatures() & SHA256_CPU_SHA) != 0;
+}
+
+int SHA256_has_avx2(void) {
+  return (SHA256_GetCpuFeatures() & SHA256_CPU_AVX2) != 0;
+}
+
+// Four rounds with the message words in |w|.
+#define SHANI_ROUNDS(i, w)                                                    \
+  msg = _mm_add_epi32((w),                                                    \
+      _mm_loadu_si128((const __m128i*)&SHA256_K[4 * (i)]));                   \
+  state1 = _mm_sha256rnds2_epu32(state1, state0, msg);                        \
+  msg = _mm_shuffle_epi32(msg, 0x0E);                                         \
+  state0 = _mm_sha256rnds2_epu32(state0, state1, msg)
+
+// Replaces the message words in |w0| with the message words four rounds
+// after |w3|.
+#define SHANI_SCHEDULE(w0, w1, w2, w3)                                        \
+  w0 = _mm_sha256msg2_epu32(                                                  \
+      _mm_add_epi32(_mm_sha256msg1_epu32((w0), (w1)),                         \
+                    _mm_alignr_epi8((w3), (w2), 4)),                          \
+      (w3))
+
+void SHA256_blocks_shani(uint32_t state[8],
+                         const uint8_t* data,
+                         size_t num_blocks) {
+  const __m128i byte_swap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+                                           0x0405060700010203ULL);
+  __m128i state0, state1, msg, tmp;
+  __m128i w0, w1, w2, w3;
+  __m128i abef, cdgh;
+  int i;
+
+  // The SHA instructions operate on the state as ABEF and CDGH.
+  tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[0]), 0xB1);
+  state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[4]), 0x1B);
+  state0 = _mm_alignr_epi8(tmp, state1, 8);
+  state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+  while (num_blocks--) {
+    abef = state0;
+    cdgh = state1;
+
+    w0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 0)),
+                          byte_swap);
+    w1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 16)),
+                          byte_swap);
+    w2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 32)),
+                          byte_swap);
+    w3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 48)),
+                          byte_swap);
+
+    SHANI_ROUNDS(0, w0);
+    SHANI_ROUNDS(1, w1);
+    SHANI_ROUNDS(2, w2);
+    SHANI_ROUNDS(3, w3);
+
+    for (i = 4; i < 16; i += 4) {
+      SHANI_SCHEDULE(w0, w1, w2, w3);
+      SHANI_ROUNDS(i, w0);
+      SHANI_SCHEDULE(w1, w2, w3, w0);
+      SHANI_ROUNDS(i + 1, w1);
+      SHANI_SCHEDULE(w2, w3, w0, w1);
+      SHANI_ROUNDS(i + 2, w2);
+      SHANI_SCHEDULE(w3, w0, w1, w2);
+      SHANI_ROUNDS(i + 3, w3);
+    }
+
+    state0 = _mm_add_epi32(state0, abef);
+    state1 = _mm_add_epi32(state1, cdgh);
+    data += 64;
+  }
+
+  tmp = _mm_shuffle_epi32(state0, 0x1B);
+  state1 = _mm_shuffle_epi32(state1, 0xB1);
+  state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+  state1 = _mm_alignr_epi8(state1, tmp, 8);
+  _mm_storeu_si128((__m128i*)&state[0], state0);
+  _mm_storeu_si128((__m128i*)&state[4], state1);
+}
+
+#undef SHANI_ROUNDS
+#undef SHANI_SCHEDULE
+
+#define AVX2_ROR(x, n) \
+  _mm256_or_si256(_mm256_srli_epi32((x), (n)), _mm256_slli_epi32((x), 32 - (n)))
+
+static __m256i SHA256_Load8(const uint8_t* const data[8],
+                            size_t offset,
+                            __m256i byte_swap) {
+  uint32_t w[8];
+  int k;
+  for (k = 0; k < 8; ++k) {
+    memcpy(&w[k], data[k] + offset, sizeof(w[k]));
+  }
+  return _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)w), byte_swap);
+}
+
+void SHA256_blocks_x8_avx2(uint32_t* const state[8],
+                           const uint8_t* const data[8],
+                           size_t num_blocks) {
+  const __m256i byte_swap = _mm256_set_epi64x(0x0c0d0e0f08090a0bULL,
+                                              0x0405060700010203ULL,
+                                              0x0c0d0e0f08090a0bULL,
+                                              0x0405060700010203ULL);
+  __m256i v[8];
+  __m256i w[64];
+  uint32_t lanes[8];
+  size_t offset = 0;
+  int t;
+  int j;
+  int k;
+
+  // Transpose the states so that each register holds one state word of all
+  // eight messages.
+  for (j = 0; j < 8; ++j) {
+    for (k = 0; k < 8; ++k) {
+      lanes[k] = state[k][j];
+    }
+    v[j] = _mm256_loadu_si256((const __m256i*)lanes);
+  }
+
+  while (num_blocks--) {
+    __m256i a = v[0], b = v[1], c = v[2], d = v[3];
+    __m256i e = v[4], f = v[5], g = v[6], h = v[7];
+
+    for (t = 0; t < 16; ++t) {
+      w[t] = SHA256_Load8(data, offset + 4 * t, byte_swap);
+    }
+
+    for (; t < 64; ++t) {
+      __m256i s0 = _mm256_xor_si256(
+          _mm256_xor_si256(AVX2_ROR(w[t - 15], 7), AVX2_ROR(w[t - 15], 18)),
+          _mm256_srli_epi32(w[t - 15], 3));
+      __m256i s1 = _mm256_xor_si256(
+          _mm256_xor_si256(AVX2_ROR(w[t - 2], 17), AVX2_ROR(w[t - 2], 19)),
+          _mm256_srli_epi32(w[t - 2], 10));
+      w[t] = _mm256_add_epi32(_mm256_add_epi32(w[t - 16], s0),
+                              _mm256_add_epi32(w[t - 7], s1));
+    }
+
+    for (t = 0; t < 64; ++t) {
+      __m256i s0 = _mm256_xor_si256(
+          _mm256_xor_si256(AVX2_ROR(a, 2), AVX2_ROR(a, 13)), AVX2_ROR(a, 22));
+      __m256i maj = _mm256_xor_si256(
+          _mm256_xor_si256(_mm256_and_si256(a, b), _mm256_and_si256(a, c)),
+          _mm256_and_si256(b, c));
+      __m256i t2 = _mm256_add_epi32(s0, maj);
+      __m256i s1 = _mm256_xor_si256(
+          _mm256_xor_si256(AVX2_ROR(e, 6), AVX2_ROR(e, 11)), AVX2_ROR(e, 25));
+      __m256i ch = _mm256_xor_si256(_mm256_and_si256(e, f),
+                                    _mm256_andnot_si256(e, g));
+      __m256i t1 = _mm256_add_epi32(
+          _mm256_add_epi32(_mm256_add_epi32(h, s1), ch),
+          _mm256_add_epi32(_mm256_set1_epi32((int)SHA256_K[t]), w[t]));
+
+      h = g;
+      g = f;
+      f = e;
+      e = _mm256_add_epi32(d, t1);
+      d = c;
+      c = b;
+      b = a;
+      a = _mm256_add_epi32(t1, t2);
+    }
+
+    v[0] = _mm256_add_epi32(v[0], a);
+    v[1] = _mm256_add_epi32(v[1], b);
+    v[2] = _mm256_add_epi32(v[2], c);
+    v[3] = _mm256_add_epi32(v[3], d);
+    v[4] = _mm256_add_epi32(v[4], e);
+    v[5] = _mm256_add_epi32(v[5], f);
+    v[6] = _mm256_add_epi32(v[6], g);
+    v[7] = _mm256_add_epi32(v[7], h);
+    offset += 64;
+  }
+
+  for (j = 0; j < 8; ++j) {
+    _mm256_storeu_si256((__m256i*)lanes, v[j]);
+    for (k = 0; k < 8; ++k) {
+      state[k][j] = lanes[k];
+    }
+  }
+
+  _mm256_zeroupper();
+}
+
+#undef AVX2_ROR
+
+#endif  // SHA256_X86_KERNELS
@@ -20,6 +20,7 @@
 
 #include "omaha/base/signatures.h"
 #include <intsafe.h>
+#include <algorithm>
 #include <memory>
 #include <vector>
 
@@ -38,6 +39,10 @@ constexpr size_t kMaxFileSizeForAuthentication = 512 * 1024 * 1024;  // 512MB
 // Buffer size used to read files from disk.
 constexpr size_t kFileReadBufferSize = 128 * 1024;
 
+// Maximum number of files ComputeFileDigestsSha256 reads in lockstep, which
+// matches the number of messages the AVX2 SHA-256 kernel hashes at once.
+constexpr size_t kMaxFilesHashedAtOnce = 8;
+
 namespace CryptDetails {
 
 class SHA256Hash : public HashInterface {
@@ -159,7 +164,7 @@ HRESULT CryptoHash::ComputeOrValidate(const std::vector<CString>& filepaths,
       }
       curr_len += file_size.QuadPart;
       if (curr_len > max_len) {
-        UTIL_LOG(LE, (_T("[exceed max len][curr_len=%lu][max_len=%lu]"),
+        UTIL_LOG(LE, (_T("[exceed max len][curr_len=%I64u][max_len=%I64u]"),
                       curr_len, max_len));
         return E_FAIL;
       }
@@ -236,6 +241,73 @@ HRESULT CryptoHash::ComputeOrValidate(const std::vector<byte>& buffer_in,
   }
 }
 
+StreamingHash::StreamingHash()
+    : hasher_(CryptDetails::CreateHasher()),
+      length_(0),
+      is_finalized_(false) {
+}
+
+StreamingHash::~StreamingHash() {
+}
+
+void StreamingHash::Update(const void* data, size_t length) {
+  ASSERT1(!is_finalized_);
+  ASSERT1(data || !length);
+
+  const uint8* bytes = static_cast<const uint8*>(data);
+  while (length) {
+    const unsigned int chunk_length =
+        static_cast<unsigned int>(std::min(length,
+                                           static_cast<size_t>(UINT_MAX)));
+    hasher_->update(bytes, chunk_length);
+    bytes += chunk_length;
+    length -= chunk_length;
+    length_ += chunk_length;
+  }
+}
+
+HRESULT StreamingHash::UpdateFromFile(HANDLE file, uint64 length) {
+  ASSERT1(file && file != INVALID_HANDLE_VALUE);
+
+  LARGE_INTEGER start_pos = {0};
+  if (!::SetFilePointerEx(file, start_pos, NULL, FILE_BEGIN)) {
+    return HRESULTFromLastError();
+  }
+
+  std::vector<byte> buf(kFileReadBufferSize);
+  while (length) {
+    const DWORD bytes_to_read = static_cast<DWORD>(
+        std::min(length, static_cast<uint64>(buf.size())));
+    DWORD bytes_read = 0;
+    if (!::ReadFile(file, &buf[0], bytes_to_read, &bytes_read, NULL)) {
+      return HRESULTFromLastError();
+    }
+    if (bytes_read != bytes_to_read) {
+      return HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
+    }
+
+    Update(&buf[0], bytes_read);
+    length -= bytes_read;
+  }
+
+  return S_OK;
+}
+
+void StreamingHash::Reset() {
+  hasher_.reset(CryptDetails::CreateHasher());
+  length_ = 0;
+  is_finalized_ = false;
+}
+
+void StreamingHash::Finalize(std::vector<byte>* digest) {
+  ASSERT1(digest);
+  ASSERT1(!is_finalized_);
+
+  is_finalized_ = true;
+  const uint8* digest_data = hasher_->final();
+  digest->assign(digest_data, digest_data + hasher_->hash_size());
+}
+
 HRESULT VerifyFileHashSha256(const std::vector<CString>& files,
                              const CString& expected_hash) {
   ASSERT1(!files.empty());
@@ -252,4 +324,107 @@ HRESULT VerifyFileHashSha256(const std::vector<CString>& files,
   return crypto.Validate(files, kMaxFileSizeForAuthentication, hash_vector);
 }
 
+HRESULT ComputeFileDigestsSha256(const std::vector<CString>& filepaths,
+                                 std::vector<std::vector<byte>>* digests) {
+  ASSERT1(digests);
+
+  const size_t num_files = filepaths.size();
+  digests->resize(num_files);
+
+  const size_t chunk_size = kFileReadBufferSize / 2;
+  std::vector<byte> buf(chunk_size * kMaxFilesHashedAtOnce);
+  static_assert(kFileReadBufferSize <= INT_MAX);
+
+  for (size_t first = 0; first < num_files; first += kMaxFilesHashedAtOnce) {
+    const size_t num_group_files =
+        std::min(num_files - first, kMaxFilesHashedAtOnce);
+
+    scoped_hfile files[kMaxFilesHashedAtOnce];
+    LITE_SHA256_CTX contexts[kMaxFilesHashedAtOnce] = {};
+    for (size_t i = 0; i != num_group_files; ++i) {
+      reset(files[i], ::CreateFile(filepaths[first + i],
+                                   FILE_READ_DATA,
+                                   FILE_SHARE_READ,
+                                   NULL,
+                                   OPEN_EXISTING,
+                                   FILE_ATTRIBUTE_NORMAL,
+                                   NULL));
+      if (!files[i]) {
+        const HRESULT hr = HRESULTFromLastError();
+        UTIL_LOG(LE, (_T("[ComputeFileDigestsSha256][open failed][%s][0x%08x]"),
+                      filepaths[first + i], hr));
+        return hr;
+      }
+      SHA256_init(&contexts[i]);
+    }
+
+    // Indexes of the files which have not been read to their end yet.
+    size_t active[kMaxFilesHashedAtOnce] = {};
+    size_t num_active = num_group_files;
+    for (size_t i = 0; i != num_group_files; ++i) {
+      active[i] = i;
+    }
+
+    while (num_active) {
+      LITE_SHA256_CTX* active_contexts[kMaxFilesHashedAtOnce] = {};
+      const void* data[kMaxFilesHashedAtOnce] = {};
+      DWORD bytes_read[kMaxFilesHashedAtOnce] = {};
+      DWORD min_bytes_read = static_cast<DWORD>(chunk_size);
+
+      for (size_t j = 0; j != num_active; ++j) {
+        byte* chunk = &buf[j * chunk_size];
+        if (!::ReadFile(get(files[active[j]]),
+                        chunk,
+                        static_cast<DWORD>(chunk_size),
+                        &bytes_read[j],
+                        NULL)) {
+          return HRESULTFromLastError();
+        }
+        active_contexts[j] = &contexts[active[j]];
+        data[j] = chunk;
+        min_bytes_read = std::min(min_bytes_read, bytes_read[j]);
+      }
+
+      // Hash the bytes all files have in common at once, then the rest of
+      // each chunk on its own.
+      SHA256_update_multi(active_contexts, data, num_active, min_bytes_read);
+
+      size_t num_still_active = 0;
+      for (size_t j = 0; j != num_active; ++j) {
+        if (bytes_read[j] > min_bytes_read) {
+          SHA256_update(active_contexts[j],
+                        static_cast<const byte*>(data[j]) + min_bytes_read,
+                        bytes_read[j] - min_bytes_read);
+        }
+        if (bytes_read[j] == chunk_size) {
+          active[num_still_active++] = active[j];
+        }
+      }
+      num_active = num_still_active;
+    }
+
+    for (size_t i = 0; i != num_group_files; ++i) {
+      const uint8_t* digest = SHA256_final(&contexts[i]);
+      (*digests)[first + i].assign(digest, digest + SHA256_DIGEST_SIZE);
+    }
+  }
+
+  return S_OK;
+}
+
+HRESULT VerifyDigestSha256(const std::vector<byte>& digest,
+                           const CString& expected_hash) {
+  std::vector<uint8> hash_vector;
+  if (!SafeHexStringToVector(expected_hash, &hash_vector)) {
+    return E_INVALIDARG;
+  }
+
+  CryptoHash crypto;
+  if (!crypto.IsValidSize(hash_vector.size())) {
+    return E_INVALIDARG;
+  }
+
+  return hash_vector == digest ? S_OK : SIGS_E_INVALID_SIGNATURE;
+}
+
 }  // namespace omaha
@@ -25,6 +25,7 @@
 #include <windows.h>
 #include <wincrypt.h>
 #include <atlstr.h>
+#include <memory>
 #include <vector>
 #include "base/basictypes.h"
 #include "omaha/base/security/sha256.h"
@@ -106,11 +107,55 @@ class CryptoHash {
   DISALLOW_COPY_AND_ASSIGN(CryptoHash);
 };
 
+// Computes the SHA-256 hash of data which becomes available in chunks, such as
+// the body of an http response while it is being written to a file.
+class StreamingHash {
+ public:
+  StreamingHash();
+  ~StreamingHash();
+
+  // Adds the next chunk of data to the hash.
+  void Update(const void* data, size_t length);
+
+  // Adds the first |length| bytes of the file to the hash. The file is read
+  // from its beginning and the file pointer is left at |length|. The file
+  // handle must have been opened with read access.
+  HRESULT UpdateFromFile(HANDLE file, uint64 length);
+
+  // Discards the data hashed so far.
+  void Reset();
+
+  // Returns the number of bytes hashed so far.
+  uint64 length() const { return length_; }
+
+  // Returns the digest of the data hashed so far. Reset must be called before
+  // more data is added to the hash.
+  void Finalize(std::vector<byte>* digest);
+
+ private:
+  std::unique_ptr<CryptDetails::HashInterface> hasher_;
+  uint64 length_;
+  bool is_finalized_;
+
+  DISALLOW_COPY_AND_ASSIGN(StreamingHash);
+};
+
 // Verifies that the files' SHA256 hash is the expected_hash. The hash is
 // hex-digit encoded.
 HRESULT VerifyFileHashSha256(const std::vector<CString>& files,
                              const CString& expected_hash);
 
+// Computes the SHA-256 hash of each file in |filepaths|. Unlike
+// CryptoHash::Compute, which hashes the files as one message, this function
+// returns one digest per file. The files are read in lockstep so that the
+// hashes of several files are computed at once on CPUs which support it.
+HRESULT ComputeFileDigestsSha256(const std::vector<CString>& filepaths,
+                                 std::vector<std::vector<byte>>* digests);
+
+// Verifies that |digest| is the SHA-256 hash encoded in hex by |expected_hash|.
+HRESULT VerifyDigestSha256(const std::vector<byte>& digest,
+                           const CString& expected_hash);
+
 }  // namespace omaha
 
 #endif  // OMAHA_BASE_SIGNATURES_H_
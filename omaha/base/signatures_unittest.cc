@@ -128,5 +128,132 @@ TEST(SignaturesTest, VerifyFileHashSha256) {
   EXPECT_STREQ(hash_files, CString(actual_hash_files.c_str()));
 }
 
-}  // namespace omaha
+TEST(SignaturesTest, StreamingHashSha256) {
+  for (size_t i = 0; i != arraysize(test_hash256); i++) {
+    const char* data = test_hash256[i].binary;
+    const size_t length = strlen(data);
+
+    // Hash the data one byte at a time.
+    StreamingHash hash;
+    for (size_t j = 0; j != length; ++j) {
+      hash.Update(data + j, 1);
+    }
+    EXPECT_EQ(length, hash.length());
+
+    std::vector<byte> digest;
+    hash.Finalize(&digest);
+    ASSERT_EQ(arraysize(test_hash256[i].hash), digest.size());
+    EXPECT_EQ(0, memcmp(&digest.front(), test_hash256[i].hash, digest.size()));
+
+    // Hash the data again, in one chunk, after resetting the hash.
+    hash.Reset();
+    EXPECT_EQ(0, hash.length());
+    hash.Update(data, length);
+    std::vector<byte> digest2;
+    hash.Finalize(&digest2);
+    EXPECT_TRUE(digest == digest2);
+  }
+}
+
+TEST(SignaturesTest, StreamingHashSha256_UpdateFromFile) {
+  const CString source_file = ConcatenatePath(
+      app_util::GetCurrentModuleDirectory(),
+      _T("unittest_support\\download_cache_test\\")
+      _T("{89640431-FE64-4da8-9860-1A1085A60E13}\\gears-win32-opt.msi"));
+
+  scoped_hfile file(::CreateFile(source_file,
+                                 GENERIC_READ,
+                                 FILE_SHARE_READ,
+                                 NULL,
+                                 OPEN_EXISTING,
+                                 FILE_ATTRIBUTE_NORMAL,
+                                 NULL));
+  ASSERT_TRUE(file);
+
+  LARGE_INTEGER file_size = {0};
+  ASSERT_TRUE(::GetFileSizeEx(get(file), &file_size));
+  const uint64 length = static_cast<uint64>(file_size.QuadPart);
+
+  // Hash a prefix of the file, then the rest of the file, as a resumed
+  // download would.
+  StreamingHash hash;
+  EXPECT_SUCCEEDED(hash.UpdateFromFile(get(file), length / 2));
+  EXPECT_EQ(length / 2, hash.length());
+
+  std::vector<byte> buffer(static_cast<size_t>(length - length / 2));
+  DWORD bytes_read = 0;
+  ASSERT_TRUE(::ReadFile(get(file),
+                         &buffer.front(),
+                         static_cast<DWORD>(buffer.size()),
+                         &bytes_read,
+                         NULL));
+  ASSERT_EQ(buffer.size(), bytes_read);
+  hash.Update(&buffer.front(), buffer.size());
+  EXPECT_EQ(length, hash.length());
+
+  std::vector<byte> digest;
+  hash.Finalize(&digest);
+  EXPECT_SUCCEEDED(VerifyDigestSha256(
+      digest,
+      _T("49b45f78865621b154fa65089f955182345a67f9746841e43e2d6daa288988d0")));
+
+  // The file is shorter than the requested prefix.
+  hash.Reset();
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_HANDLE_EOF),
+            hash.UpdateFromFile(get(file), length + 1));
+}
+
+TEST(SignaturesTest, VerifyDigestSha256) {
+  const byte* hash = test_hash256[1].hash;
+  std::vector<byte> digest(hash, hash + arraysize(test_hash256[1].hash));
+  EXPECT_SUCCEEDED(VerifyDigestSha256(
+      digest,
+      _T("d7a8fbb307d7809469ca9abcb0082e4f8d5651e46d3cdb762d02d0bf37c9e592")));
+  EXPECT_EQ(SIGS_E_INVALID_SIGNATURE, VerifyDigestSha256(
+      digest,
+      _T("e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855")));
+  EXPECT_EQ(E_INVALIDARG, VerifyDigestSha256(digest, _T("00bad000")));
+  EXPECT_EQ(E_INVALIDARG, VerifyDigestSha256(digest, _T("")));
+}
 
+TEST(SignaturesTest, ComputeFileDigestsSha256) {
+  const CString executable_path(app_util::GetCurrentModuleDirectory());
+
+  const CString source_file1 = ConcatenatePath(
+      executable_path,
+      _T("unittest_support\\download_cache_test\\")
+      _T("{89640431-FE64-4da8-9860-1A1085A60E13}\\gears-win32-opt.msi"));
+  const CString source_file2 = ConcatenatePath(
+      executable_path,
+      _T("unittest_support\\download_cache_test\\")
+      _T("{7101D597-3481-4971-AD23-455542964072}\\livelysetup.exe"));
+
+  std::vector<std::vector<byte>> digests;
+  EXPECT_SUCCEEDED(ComputeFileDigestsSha256(std::vector<CString>(), &digests));
+  EXPECT_TRUE(digests.empty());
+
+  // Files of different sizes, more than are read in lockstep.
+  std::vector<CString> files;
+  for (int i = 0; i != 5; ++i) {
+    files.push_back(source_file1);
+    files.push_back(source_file2);
+  }
+
+  EXPECT_SUCCEEDED(ComputeFileDigestsSha256(files, &digests));
+  ASSERT_EQ(files.size(), digests.size());
+  for (size_t i = 0; i != files.size(); ++i) {
+    CryptoHash crypto;
+    std::vector<byte> expected_digest;
+    EXPECT_SUCCEEDED(crypto.Compute(files[i], 0, &expected_digest));
+    EXPECT_TRUE(expected_digest == digests[i]);
+  }
+
+  EXPECT_SUCCEEDED(VerifyDigestSha256(
+      digests[0],
+      _T("49b45f78865621b154fa65089f955182345a67f9746841e43e2d6daa288988d0")));
+
+  files.push_back(_T("c:\\no_such_file.bin"));
+  EXPECT_FAILED(ComputeFileDigestsSha256(files, &digests));
+}
+
+}  // namespace omaha
@@ -1806,6 +1806,34 @@ bool String_StringToDecimalIntChecked(const TCHAR* str, int* value) {
   return true;
 }
 
+bool String_StringToDecimalUint64Checked(const TCHAR* str, uint64* value) {
+  ASSERT1(str);
+  ASSERT1(value);
+
+  // _tcstoui64 negates the value of strings starting with a minus sign.
+  const TCHAR* digits = str;
+  while (IsSpace(*digits)) {
+    ++digits;
+  }
+  if (*digits == _T('-')) {
+    return false;
+  }
+
+  if (_set_errno(0)) {
+    return false;
+  }
+
+  TCHAR* end_ptr = NULL;
+  *value = _tcstoui64(str, &end_ptr, 10);
+  ASSERT1(end_ptr);
+
+  if (errno) {
+    ASSERT1(ERANGE == errno);
+    return false;
+  }
+  return str != end_ptr && *end_ptr == _T('\0');
+}
+
 HRESULT String_StringToBool(const TCHAR* str, bool* value) {
   ASSERT1(str);
   ASSERT1(value);
@@ -311,6 +311,10 @@ HRESULT StringUnescape(const CString& str_in, CString* str_out);
 // Tests for overflow and non-int strings.
 bool String_StringToDecimalIntChecked(const TCHAR* str, int* value);
 
+// Same as String_StringToDecimalIntChecked, for unsigned 64-bit values.
+// Negative values are rejected.
+bool String_StringToDecimalUint64Checked(const TCHAR* str, uint64* value);
+
 // Converts a string to a bool.
 HRESULT String_StringToBool(const TCHAR* str, bool* value);
 
@@ -849,6 +849,41 @@ TEST(StringTest, String_StringToDecimalIntChecked) {
   EXPECT_FALSE(String_StringToDecimalIntChecked(_T("2147483648"), &value));
   EXPECT_TRUE(String_StringToDecimalIntChecked(_T("935"), &value));
 }
+
+TEST(StringTest, String_StringToDecimalUint64Checked) {
+  uint64 value = 0;
+
+  EXPECT_EQ(0, _set_errno(ERANGE));
+
+  // Valid Cases
+  EXPECT_TRUE(String_StringToDecimalUint64Checked(_T("935"), &value));
+  EXPECT_EQ(935ULL, value);
+  EXPECT_TRUE(String_StringToDecimalUint64Checked(_T("0"), &value));
+  EXPECT_EQ(0ULL, value);
+  EXPECT_TRUE(String_StringToDecimalUint64Checked(_T("5368709120"), &value));
+  EXPECT_EQ(5368709120ULL, value);
+  EXPECT_TRUE(String_StringToDecimalUint64Checked(
+      _T("18446744073709551615"), &value));
+  EXPECT_EQ(ULLONG_MAX, value);
+  EXPECT_TRUE(String_StringToDecimalUint64Checked(_T(" 7"), &value));
+  EXPECT_EQ(7ULL, value);
+
+  // Failing Cases
+  EXPECT_FALSE(String_StringToDecimalUint64Checked(_T(""), &value));
+  EXPECT_FALSE(String_StringToDecimalUint64Checked(_T("-1"), &value));
+  EXPECT_FALSE(String_StringToDecimalUint64Checked(_T(" -1"), &value));
+  EXPECT_FALSE(String_StringToDecimalUint64Checked(
+      _T("18446744073709551616"), &value));
+  EXPECT_FALSE(String_StringToDecimalUint64Checked(_T("0x935"), &value));
+  EXPECT_FALSE(String_StringToDecimalUint64Checked(_T("nine"), &value));
+  EXPECT_FALSE(String_StringToDecimalUint64Checked(_T("9nine"), &value));
+
+  // A valid case after an overflow verifies that this method clears errno.
+  EXPECT_FALSE(String_StringToDecimalUint64Checked(
+      _T("18446744073709551616"), &value));
+  EXPECT_TRUE(String_StringToDecimalUint64Checked(_T("935"), &value));
+}
+
 TEST(StringTest, String_StringToTristate) {
   Tristate value = TRISTATE_NONE;
 
@@ -114,7 +114,14 @@ void ThreadPool::ProcessWorkItemInContext(std::unique_ptr<Context> context) {
     scoped_co_init init_com_apt(context->coinit_flags());
     ASSERT1(SUCCEEDED(init_com_apt.hresult()));
 
-    context->work_item()->Process();
+    UserWorkItem* work_item = context->work_item();
+    const std::shared_ptr<const CancellationToken> cancellation_token(
+        work_item->cancellation_token());
+    if (cancellation_token && cancellation_token->IsCancelled()) {
+      work_item->Cancel();
+    } else {
+      work_item->Process();
+    }
     context.reset();
   }
 
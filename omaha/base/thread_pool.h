@@ -22,31 +22,59 @@
 #include <memory>
 
 #include "base/basictypes.h"
+#include "omaha/base/executor.h"
 #include "omaha/third_party/smartany/scoped_any.h"
 
 namespace omaha {
 
 class UserWorkItem {
  public:
-  UserWorkItem() : shutdown_event_(NULL) {}
+  UserWorkItem()
+      : shutdown_event_(NULL),
+        priority_(EXECUTOR_PRIORITY_BACKGROUND) {}
   virtual ~UserWorkItem() {}
 
   // Template method interface
   void Process() { DoProcess(); }
 
+  // Called instead of Process when the cancellation token of the work item is
+  // cancelled before the work item starts.
+  void Cancel() { DoCancel(); }
+
   HANDLE shutdown_event() const { return shutdown_event_; }
   void set_shutdown_event(HANDLE shutdown_event) {
     shutdown_event_ = shutdown_event;
   }
 
+  // The priority is only honored by ExecutorThreadPool.
+  ExecutorPriority priority() const { return priority_; }
+  void set_priority(ExecutorPriority priority) { priority_ = priority; }
+
+  std::shared_ptr<const CancellationToken> cancellation_token() const {
+    return cancellation_token_;
+  }
+  void set_cancellation_token(
+      std::shared_ptr<const CancellationToken> cancellation_token) {
+    cancellation_token_ = cancellation_token;
+  }
+
  private:
   // Executes the work item.
   virtual void DoProcess() = 0;
 
+  // Runs the work item anyway by default, since many work items complete an
+  // asynchronous call or release resources when they run. Work items which
+  // can be dropped override this.
+  virtual void DoCancel() { DoProcess(); }
+
   // It is the job of implementers to watch for the signaling of this event
   // and shutdown correctly. This event is set when the thread pool is closing.
   // Do not close this event as is owned by the thread pool.
   HANDLE shutdown_event_;
+
+  ExecutorPriority priority_;
+  std::shared_ptr<const CancellationToken> cancellation_token_;
+
   DISALLOW_COPY_AND_ASSIGN(UserWorkItem);
 };
 
@@ -181,6 +181,9 @@ HRESULT ReadBooleanAttribute(IXMLDOMNode* node,
 HRESULT ReadIntAttribute(IXMLDOMNode* node,
                          const TCHAR* attr_name,
                          int* value);
+HRESULT ReadUint64Attribute(IXMLDOMNode* node,
+                            const TCHAR* attr_name,
+                            uint64* value);
 HRESULT ReadGuidAttribute(IXMLDOMNode* node,
                           const TCHAR* attr_name,
                           GUID* value);
@@ -22,6 +22,7 @@
 #include "omaha/base/safe_format.h"
 #include "omaha/client/client_utils.h"
 #include "omaha/client/help_url_builder.h"
+#include "omaha/client/progress_events.h"
 #include "omaha/client/resource.h"
 #include "omaha/client/shutdown_events.h"
 #include "omaha/common/const_goopdate.h"
@@ -474,6 +475,33 @@ LRESULT BundleInstaller::OnTimer(UINT msg,
   return 0;
 }
 
+LRESULT BundleInstaller::OnProgress(UINT msg,
+                                    WPARAM,
+                                    LPARAM,
+                                    BOOL& handled) {  // NOLINT
+  if (is_handling_message_) {
+    ASSERT(false, (_T("[Reentrancy detected]")));
+    return 0;
+  }
+  is_handling_message_ = true;
+
+  VERIFY1(msg == kProgressMessage);
+
+  // The notifications received from now on post a new message.
+  if (progress_events_.get()) {
+    progress_events_->OnMessageHandled();
+  }
+
+  if (!PollServer()) {
+    CORE_LOG(L6, (_T("[BundleInstaller::OnProgress][Stopping polling timer]")));
+    KillTimer(kPollingTimerId);
+  }
+
+  is_handling_message_ = false;
+  handled = true;
+  return 0;
+}
+
 HRESULT BundleInstaller::Initialize() {
   CORE_LOG(L3, (_T("[BundleInstaller::Initialize]")));
 
@@ -522,6 +550,38 @@ void BundleInstaller::StopListenToShutdownEvent(bool is_machine) {
   shutdown_callback_.reset();
 }
 
+// The installer keeps polling every kPollingTimerPeriodMs if the server can't
+// notify it, for instance if the bundle has no session id.
+HRESULT BundleInstaller::ListenToProgressEvents(bool is_machine) {
+  ASSERT1(app_bundle_);
+  ASSERT1(!progress_events_.get());
+
+  CComBSTR session_id;
+  HRESULT hr = app_bundle_->get_sessionId(&session_id);
+  if (FAILED(hr)) {
+    return hr;
+  }
+  if (!session_id.Length()) {
+    return E_INVALIDARG;
+  }
+
+  std::unique_ptr<ProgressEvents> progress_events(
+      new ProgressEvents(m_hWnd, kProgressMessage));
+  hr = progress_events->Initialize(is_machine, CString(session_id));
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  if (!SetTimer(kPollingTimerId, kFallbackPollingTimerPeriodMs)) {
+    return HRESULTFromLastError();
+  }
+  progress_events_.reset(progress_events.release());
+
+  // Starts processing the bundle without waiting for the fallback timer.
+  VERIFY1(PostMessage(kProgressMessage, 0, 0));
+  return S_OK;
+}
+
 HRESULT BundleInstaller::InstallBundle(bool is_machine,
                                        bool listen_to_shutdown_event,
                                        IAppBundle* app_bundle,
@@ -537,11 +597,18 @@ HRESULT BundleInstaller::InstallBundle(bool is_machine,
     ListenToShutdownEvent(is_machine);
   }
 
+  HRESULT hr = ListenToProgressEvents(is_machine);
+  if (FAILED(hr)) {
+    CORE_LOG(LW, (_T("[ListenToProgressEvents failed][0x%08x]"), hr));
+  }
+
   _pAtlModule->Lock();
 
   message_loop_.Run();
   CORE_LOG(L2, (_T("[message_loop_.Run() returned]")));
 
+  progress_events_.reset();
+
   if (listen_to_shutdown_event) {
     StopListenToShutdownEvent(is_machine);
   }
@@ -61,6 +61,7 @@ CString GetBundleCompletionMessage(
 }  // namespace internal
 
 class HelpUrlBuilder;
+class ProgressEvents;
 class ShutdownCallback;
 
 class BundleInstaller
@@ -162,6 +163,10 @@ class BundleInstaller
   // listening. Otherwise no effect.
   void StopListenToShutdownEvent(bool is_machine);
 
+  // Makes installer poll the server when the server notifies progress, and
+  // only poll periodically as a fallback.
+  HRESULT ListenToProgressEvents(bool is_machine);
+
   // These functions update the UI during HandleProcessingState().
   // TODO(omaha): Rename these to Notify*.
   HRESULT NotifyUpdateAvailable(IApp* app);
@@ -189,11 +194,21 @@ class BundleInstaller
   BEGIN_MSG_MAP(BundleInstaller)
     MESSAGE_HANDLER(WM_CLOSE, OnClose)
     MESSAGE_HANDLER(WM_TIMER, OnTimer)
+    MESSAGE_HANDLER(kProgressMessage, OnProgress)
   END_MSG_MAP()
 
   static const int kPollingTimerId = 1;
   static const int kPollingTimerPeriodMs = 100;
 
+  // The period of the polling timer when the server notifies progress. The
+  // server does not notify the install progress reported by the installers,
+  // and the notifications are rate limited, so the fallback timer keeps the
+  // UI up to date with them.
+  static const int kFallbackPollingTimerPeriodMs = 1000;
+
+  // Posted when the server notifies progress.
+  static const UINT kProgressMessage = WM_APP + 1;
+
   // The main use case for this OnClose() handler is the shutdown handler via a
   // PostMessage in the /UA scenario.
   LRESULT OnClose(UINT msg,
@@ -207,6 +222,12 @@ class BundleInstaller
                   LPARAM lparam,
                   BOOL& handled);  // NOLINT
 
+  // Calls BundleInstaller::PollServer() when the server notifies progress.
+  LRESULT OnProgress(UINT msg,
+                     WPARAM wparam,
+                     LPARAM lparam,
+                     BOOL& handled);  // NOLINT
+
   void ReleaseAppBundle();
 
   InstallProgressObserver* observer_;
@@ -224,6 +245,9 @@ class BundleInstaller
   // Shutdown event listener.
   std::unique_ptr<ShutdownCallback> shutdown_callback_;
 
+  // Progress event listener.
+  std::unique_ptr<ProgressEvents> progress_events_;
+
   // The apps in app_bundle_. Allows easier and quicker access to the apps than
   // going through app_bundle_.
   typedef CComPtr<IApp> ComPtrIApp;
@@ -0,0 +1,94 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+
+#include "omaha/client/progress_events.h"
+
+#include "omaha/base/const_object_names.h"
+#include "omaha/base/debug.h"
+#include "omaha/base/error.h"
+#include "omaha/base/logging.h"
+#include "omaha/base/reactor.h"
+#include "omaha/base/utils.h"
+
+namespace omaha {
+
+ProgressEvents::ProgressEvents(HWND window, UINT message)
+    : window_(window),
+      message_(message),
+      is_message_pending_(false) {
+  ASSERT1(window);
+}
+
+ProgressEvents::~ProgressEvents() {
+  CORE_LOG(L3, (_T("[ProgressEvents::~ProgressEvents]")));
+
+  // Waits for the callback in progress, if any, to complete.
+  if (reactor_.get() && get(progress_event_)) {
+    VERIFY1(SUCCEEDED(reactor_->UnregisterHandle(get(progress_event_))));
+  }
+  reactor_.reset();
+}
+
+HRESULT ProgressEvents::Initialize(bool is_machine,
+                                   const CString& session_id) {
+  ASSERT1(!session_id.IsEmpty());
+
+  NamedObjectAttributes attr;
+  GetNamedObjectAttributes(kBundleProgressEventPrefix + session_id,
+                           is_machine,
+                           &attr);
+
+  // The event is auto-reset, so that the notifications sent while the window
+  // reads the state of the bundle are not lost.
+  reset(progress_event_, ::CreateEvent(&attr.sa, false, false, attr.name));
+  if (!progress_event_) {
+    HRESULT hr = HRESULTFromLastError();
+    CORE_LOG(LW, (_T("[CreateEvent failed][%s][0x%08x]"), attr.name, hr));
+    return hr;
+  }
+
+  reactor_.reset(new Reactor);
+  HRESULT hr = reactor_->RegisterHandle(get(progress_event_), this, 0);
+  if (FAILED(hr)) {
+    CORE_LOG(LW, (_T("[RegisterHandle failed][0x%08x]"), hr));
+    reactor_.reset();
+    return hr;
+  }
+
+  CORE_LOG(L3, (_T("[ProgressEvents][listening][%s]"), attr.name));
+  return S_OK;
+}
+
+void ProgressEvents::OnMessageHandled() {
+  ::InterlockedExchange(&is_message_pending_, false);
+}
+
+// Called from a thread in the OS thread pool. The PostMessage marshals the
+// notification over to the thread of the window.
+void ProgressEvents::HandleEvent(HANDLE handle) {
+  ASSERT1(handle == get(progress_event_));
+
+  if (!::InterlockedExchange(&is_message_pending_, true)) {
+    if (!::PostMessage(window_, message_, 0, 0)) {
+      CORE_LOG(LW, (_T("[PostMessage failed][%u]"), ::GetLastError()));
+      ::InterlockedExchange(&is_message_pending_, false);
+    }
+  }
+
+  VERIFY1(SUCCEEDED(reactor_->RegisterHandle(handle)));
+}
+
+}  // namespace omaha
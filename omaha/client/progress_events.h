@@ -0,0 +1,68 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+//
+// Receives the progress notifications the COM server sends for a bundle and
+// posts them as messages to the window processing the bundle. See
+// goopdate/progress_notifier.h for the server side.
+
+#ifndef OMAHA_CLIENT_PROGRESS_EVENTS_H_
+#define OMAHA_CLIENT_PROGRESS_EVENTS_H_
+
+#include <windows.h>
+#include <atlstr.h>
+#include <memory>
+#include "base/basictypes.h"
+#include "omaha/base/event_handler.h"
+#include "omaha/third_party/smartany/scoped_any.h"
+
+namespace omaha {
+
+class Reactor;
+
+class ProgressEvents : public EventHandler {
+ public:
+  // Posts |message| to |window| when the COM server notifies progress.
+  ProgressEvents(HWND window, UINT message);
+  virtual ~ProgressEvents();
+
+  // Creates the event the COM server sets for the bundle with |session_id|
+  // and starts listening to it.
+  HRESULT Initialize(bool is_machine, const CString& session_id);
+
+  // Must be called by the window before it reads the state of the bundle.
+  // The notifications received while a message is pending are coalesced into
+  // the pending message, and the notifications received after this call post
+  // a new message.
+  void OnMessageHandled();
+
+  virtual void HandleEvent(HANDLE handle);
+
+ private:
+  const HWND window_;
+  const UINT message_;
+
+  // Whether a message has been posted and not handled yet.
+  volatile LONG is_message_pending_;
+
+  scoped_event progress_event_;
+  std::unique_ptr<Reactor> reactor_;
+
+  DISALLOW_COPY_AND_ASSIGN(ProgressEvents);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_CLIENT_PROGRESS_EVENTS_H_
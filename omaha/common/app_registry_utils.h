@@ -131,11 +131,18 @@ void GetClientStateData(bool is_machine,
 // Reads InstallTime and computes InstallTimeDiffSec.
 int GetInstallTimeDiffSec(bool is_machine, const CString& app_id);
 
+// Computes InstallTimeDiffSec from an InstallTime value.
+int GetInstallTimeDiffSec(DWORD install_time);
+
 // Reads day_of_install from registry.
 HRESULT GetDayOfInstall(bool is_machine,
                         const CString& app_id,
                         DWORD* day_of_install);
 
+// Truncates a day_of_install value read from the registry to the first day of
+// its week. The -1 value is returned as is.
+DWORD TruncateDayOfInstall(DWORD day_of_install);
+
 CString GetCohortKeyName(bool is_machine, const CString& app_id);
 HRESULT DeleteCohortKey(bool is_machine, const CString& app_id);
 HRESULT ReadCohort(bool is_machine, const CString& app_id, Cohort* cohort);
@@ -24,6 +24,7 @@
 #include <atlsecurity.h>
 #include <atltime.h>
 #include <math.h>
+#include <algorithm>
 #include "base/rand_util.h"
 #include "omaha/base/app_util.h"
 #include "omaha/base/constants.h"
@@ -101,20 +102,202 @@ HRESULT GetDir32(int csidl,
   return S_OK;
 }
 
+// Reads a download concurrency override from UpdateDev and clamps it to
+// [min_concurrency, max_concurrency].
+int GetDownloadConcurrency(const TCHAR* value_name,
+                           int default_concurrency,
+                           int min_concurrency,
+                           int max_concurrency) {
+  DWORD concurrency = 0;
+  if (FAILED(RegKey::GetValue(MACHINE_REG_UPDATE_DEV,
+                              value_name,
+                              &concurrency))) {
+    return default_concurrency;
+  }
+
+  concurrency = std::max(concurrency, static_cast<DWORD>(min_concurrency));
+  return static_cast<int>(std::min(concurrency,
+                                   static_cast<DWORD>(max_concurrency)));
+}
+
 }  // namespace
 
+HRESULT GroupPolicySnapshot::GetValue(const TCHAR* value_name,
+                                      DWORD* value) const {
+  ASSERT1(value_name);
+  ASSERT1(value);
+
+  CString name(value_name);
+  std::map<CString, DWORD>::const_iterator it =
+      dword_values_.find(name.MakeLower());
+  if (it == dword_values_.end()) {
+    return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+  }
+
+  *value = it->second;
+  return S_OK;
+}
+
+HRESULT GroupPolicySnapshot::GetValue(const TCHAR* value_name,
+                                      CString* value) const {
+  ASSERT1(value_name);
+  ASSERT1(value);
+
+  CString name(value_name);
+  std::map<CString, CString>::const_iterator it =
+      string_values_.find(name.MakeLower());
+  if (it == string_values_.end()) {
+    return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+  }
+
+  *value = it->second;
+  return S_OK;
+}
+
+void GroupPolicySnapshot::SetValue(const TCHAR* value_name, DWORD value) {
+  CString name(value_name);
+  dword_values_[name.MakeLower()] = value;
+}
+
+void GroupPolicySnapshot::SetValue(const TCHAR* value_name,
+                                   const CString& value) {
+  CString name(value_name);
+  string_values_[name.MakeLower()] = value;
+}
+
+void RegistryGroupPolicyStore::Load(GroupPolicySnapshot* snapshot) {
+  ASSERT1(snapshot);
+
+  if (!IsEnrolledToDomain()) {
+    return;
+  }
+
+  RegKey key;
+  if (FAILED(key.Open(kRegKeyGoopdateGroupPolicy, KEY_READ))) {
+    return;
+  }
+  snapshot->set_is_managed(true);
+
+  const uint32 value_count = key.GetValueCount();
+  for (uint32 i = 0; i != value_count; ++i) {
+    CString value_name;
+    DWORD type = REG_NONE;
+    if (FAILED(key.GetValueNameAt(i, &value_name, &type))) {
+      continue;
+    }
+
+    if (type == REG_DWORD) {
+      DWORD value = 0;
+      if (SUCCEEDED(key.GetValue(value_name, &value))) {
+        snapshot->SetValue(value_name, value);
+      }
+    } else if (type == REG_SZ || type == REG_EXPAND_SZ) {
+      CString value;
+      if (SUCCEEDED(key.GetValue(value_name, &value))) {
+        snapshot->SetValue(value_name, value);
+      }
+    }
+  }
+
+  OPT_LOG(L5, (_T("[RegistryGroupPolicyStore::Load][%u values]"),
+               value_count));
+}
+
+GroupPolicyManager::GroupPolicyManager()
+    : store_(new RegistryGroupPolicyStore),
+      is_caching_(false),
+      generation_(0) {
+}
+
+GroupPolicyManager::GroupPolicyManager(GroupPolicyStoreInterface* store)
+    : store_(store),
+      is_caching_(false),
+      generation_(0) {
+  ASSERT1(store);
+}
+
+GroupPolicyManager::~GroupPolicyManager() {
+  // Stops the monitoring thread before the members it uses are destroyed.
+  registry_monitor_.reset();
+}
+
+HRESULT GroupPolicyManager::StartMonitoring() {
+  ASSERT1(!registry_monitor_.get());
+
+  // The whole Policies key is monitored, since the Group Policy key may not
+  // exist yet and the Group Policy client deletes and recreates the keys it
+  // manages when it refreshes the policies.
+  std::unique_ptr<RegistryMonitor> registry_monitor(new RegistryMonitor);
+  HRESULT hr = registry_monitor->Initialize();
+  if (FAILED(hr)) {
+    return hr;
+  }
+  hr = registry_monitor->MonitorKeyTree(HKEY_LOCAL_MACHINE,
+                                        _T("Software\\Policies"),
+                                        PolicyKeyChangeCallback,
+                                        this);
+  if (FAILED(hr)) {
+    return hr;
+  }
+  hr = registry_monitor->StartMonitoring();
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  registry_monitor_.reset(registry_monitor.release());
+  OnPolicyChanged();
+  ::InterlockedExchange(&is_caching_, true);
+  return S_OK;
+}
+
+void GroupPolicyManager::OnPolicyChanged() {
+  ::InterlockedIncrement(&generation_);
+}
+
+void GroupPolicyManager::PolicyKeyChangeCallback(const TCHAR* key_name,
+                                                 void* user_data) {
+  ASSERT1(user_data);
+  UNREFERENCED_PARAMETER(key_name);
+
+  OPT_LOG(L3, (_T("[Group Policy changed]")));
+  static_cast<GroupPolicyManager*>(user_data)->OnPolicyChanged();
+}
+
+std::shared_ptr<const GroupPolicySnapshot> GroupPolicyManager::GetSnapshot() {
+  const LONG generation = ::InterlockedCompareExchange(&generation_, 0, 0);
+  const bool is_caching = !!::InterlockedCompareExchange(&is_caching_, 0, 0);
+  if (is_caching) {
+    std::shared_ptr<const GroupPolicySnapshot> snapshot(
+        std::atomic_load(&snapshot_));
+    if (snapshot && snapshot->generation() == generation) {
+      return snapshot;
+    }
+  }
+
+  // The snapshot is tagged with the generation read before loading it, so
+  // a change notified while it is loaded causes it to be loaded again.
+  std::shared_ptr<GroupPolicySnapshot> snapshot(
+      new GroupPolicySnapshot(generation));
+  store_->Load(snapshot.get());
+  if (is_caching) {
+    std::atomic_store(&snapshot_,
+                      std::shared_ptr<const GroupPolicySnapshot>(snapshot));
+  }
+  return snapshot;
+}
+
 bool GroupPolicyManager::IsManaged() {
-  return IsEnrolledToDomain() && RegKey::HasKey(kRegKeyGoopdateGroupPolicy);
+  return GetSnapshot()->is_managed();
 }
 
 HRESULT GroupPolicyManager::GetLastCheckPeriodMinutes(DWORD* minutes) {
-  if (!IsManaged()) {
+  std::shared_ptr<const GroupPolicySnapshot> snapshot(GetSnapshot());
+  if (!snapshot->is_managed()) {
     return E_FAIL;
   }
 
-  HRESULT hr = RegKey::GetValue(kRegKeyGoopdateGroupPolicy,
-                                kRegValueAutoUpdateCheckPeriodOverrideMinutes,
-                                minutes);
+  HRESULT hr = snapshot->GetValue(
+      kRegValueAutoUpdateCheckPeriodOverrideMinutes, minutes);
   if (FAILED(hr)) {
     return hr;
   }
@@ -126,27 +309,23 @@ HRESULT GroupPolicyManager::GetLastCheckPeriodMinutes(DWORD* minutes) {
 HRESULT GroupPolicyManager::GetUpdatesSuppressedTimes(DWORD* start_hour,
                                                       DWORD* start_min,
                                                       DWORD* duration_min) {
-  if (!IsManaged()) {
+  std::shared_ptr<const GroupPolicySnapshot> snapshot(GetSnapshot());
+  if (!snapshot->is_managed()) {
     return E_FAIL;
   }
 
-  HRESULT hr = RegKey::GetValue(kRegKeyGoopdateGroupPolicy,
-                                kRegValueUpdatesSuppressedStartHour,
-                                start_hour);
+  HRESULT hr = snapshot->GetValue(kRegValueUpdatesSuppressedStartHour,
+                                  start_hour);
   if (FAILED(hr)) {
     return hr;
   }
 
-  hr = RegKey::GetValue(kRegKeyGoopdateGroupPolicy,
-                        kRegValueUpdatesSuppressedStartMin,
-                        start_min);
+  hr = snapshot->GetValue(kRegValueUpdatesSuppressedStartMin, start_min);
   if (FAILED(hr)) {
     return hr;
   }
 
-  hr = RegKey::GetValue(kRegKeyGoopdateGroupPolicy,
-                        kRegValueUpdatesSuppressedDurationMin,
-                        duration_min);
+  hr = snapshot->GetValue(kRegValueUpdatesSuppressedDurationMin, duration_min);
   if (FAILED(hr)) {
     return hr;
   }
@@ -156,100 +335,91 @@ HRESULT GroupPolicyManager::GetUpdatesSuppressedTimes(DWORD* start_hour,
 
 HRESULT GroupPolicyManager::GetDownloadPreferenceGroupPolicy(
     CString* download_preference) {
-  if (!IsManaged()) {
+  std::shared_ptr<const GroupPolicySnapshot> snapshot(GetSnapshot());
+  if (!snapshot->is_managed()) {
     return E_FAIL;
   }
 
-  return RegKey::GetValue(kRegKeyGoopdateGroupPolicy,
-                          kRegValueDownloadPreference,
-                          download_preference);
+  return snapshot->GetValue(kRegValueDownloadPreference, download_preference);
 }
 
 HRESULT GroupPolicyManager::GetPackageCacheSizeLimitMBytes(
     DWORD* cache_size_limit) {
-  if (!IsManaged()) {
+  std::shared_ptr<const GroupPolicySnapshot> snapshot(GetSnapshot());
+  if (!snapshot->is_managed()) {
     return E_FAIL;
   }
 
-  return RegKey::GetValue(kRegKeyGoopdateGroupPolicy,
-                          kRegValueCacheSizeLimitMBytes,
-                          cache_size_limit);
+  return snapshot->GetValue(kRegValueCacheSizeLimitMBytes, cache_size_limit);
 }
 
 HRESULT GroupPolicyManager::GetPackageCacheExpirationTimeDays(
     DWORD* cache_life_limit) {
-  if (!IsManaged()) {
+  std::shared_ptr<const GroupPolicySnapshot> snapshot(GetSnapshot());
+  if (!snapshot->is_managed()) {
     return E_FAIL;
   }
 
-  return RegKey::GetValue(kRegKeyGoopdateGroupPolicy,
-                          kRegValueCacheLifeLimitDays,
-                          cache_life_limit);
+  return snapshot->GetValue(kRegValueCacheLifeLimitDays, cache_life_limit);
 }
 
 HRESULT GroupPolicyManager::GetEffectivePolicyForAppInstalls(
     const GUID& app_guid,
     DWORD* install_policy) {
-  if (!IsManaged()) {
+  std::shared_ptr<const GroupPolicySnapshot> snapshot(GetSnapshot());
+  if (!snapshot->is_managed()) {
     return E_FAIL;
   }
 
   CString app_value_name(kRegValueInstallAppPrefix);
   app_value_name.Append(GuidToString(app_guid));
-  HRESULT hr = RegKey::GetValue(kRegKeyGoopdateGroupPolicy,
-                                app_value_name,
-                                install_policy);
+  HRESULT hr = snapshot->GetValue(app_value_name, install_policy);
 
-  return SUCCEEDED(hr) ? hr : RegKey::GetValue(kRegKeyGoopdateGroupPolicy,
-                                               kRegValueInstallAppsDefault,
-                                               install_policy);
+  return SUCCEEDED(hr) ? hr : snapshot->GetValue(kRegValueInstallAppsDefault,
+                                                 install_policy);
 }
 
 HRESULT GroupPolicyManager::GetEffectivePolicyForAppUpdates(
     const GUID& app_guid,
     DWORD* update_policy) {
-  if (!IsManaged()) {
+  std::shared_ptr<const GroupPolicySnapshot> snapshot(GetSnapshot());
+  if (!snapshot->is_managed()) {
     return E_FAIL;
   }
 
   CString app_value_name(kRegValueUpdateAppPrefix);
   app_value_name.Append(GuidToString(app_guid));
-  HRESULT hr = RegKey::GetValue(kRegKeyGoopdateGroupPolicy,
-                                app_value_name,
-                                update_policy);
+  HRESULT hr = snapshot->GetValue(app_value_name, update_policy);
 
-  return SUCCEEDED(hr) ? hr : RegKey::GetValue(kRegKeyGoopdateGroupPolicy,
-                                               kRegValueUpdateAppsDefault,
-                                               update_policy);
+  return SUCCEEDED(hr) ? hr : snapshot->GetValue(kRegValueUpdateAppsDefault,
+                                                 update_policy);
 }
 
 HRESULT GroupPolicyManager::GetTargetVersionPrefix(
     const GUID& app_guid,
     CString* target_version_prefix) {
-  if (!IsManaged()) {
+  std::shared_ptr<const GroupPolicySnapshot> snapshot(GetSnapshot());
+  if (!snapshot->is_managed()) {
     return E_FAIL;
   }
 
   CString app_value_name(kRegValueTargetVersionPrefix);
   app_value_name.Append(GuidToString(app_guid));
-  return RegKey::GetValue(kRegKeyGoopdateGroupPolicy,
-                          app_value_name,
-                          target_version_prefix);
+  return snapshot->GetValue(app_value_name, target_version_prefix);
 }
 
 HRESULT GroupPolicyManager::IsRollbackToTargetVersionAllowed(
     const GUID& app_guid,
     bool* rollback_allowed) {
-  if (!IsManaged()) {
+  std::shared_ptr<const GroupPolicySnapshot> snapshot(GetSnapshot());
+  if (!snapshot->is_managed()) {
     return E_FAIL;
   }
 
   CString app_value_name(kRegValueRollbackToTargetVersion);
   app_value_name.Append(GuidToString(app_guid));
   DWORD is_rollback_allowed = 0;
-  HRESULT hr = RegKey::GetValue(kRegKeyGoopdateGroupPolicy,
-                                app_value_name,
-                                &is_rollback_allowed);
+  HRESULT hr = snapshot->GetValue(app_value_name, &is_rollback_allowed);
   if (SUCCEEDED(hr)) {
     *rollback_allowed = !!is_rollback_allowed;
   }
@@ -258,19 +428,21 @@ HRESULT GroupPolicyManager::IsRollbackToTargetVersionAllowed(
 }
 
 bool DMPolicyManager::IsManaged() {
-  return dm_policy_.is_initialized;
+  return std::atomic_load(&dm_policy_)->is_initialized;
 }
 
 HRESULT DMPolicyManager::GetLastCheckPeriodMinutes(DWORD* minutes) {
-  if (!IsManaged()) {
+  std::shared_ptr<const CachedOmahaPolicy> dm_policy(
+      std::atomic_load(&dm_policy_));
+  if (!dm_policy->is_initialized) {
     return E_FAIL;
   }
 
-  if (dm_policy_.auto_update_check_period_minutes == -1) {
+  if (dm_policy->auto_update_check_period_minutes == -1) {
     return E_FAIL;
   }
 
-  *minutes = static_cast<DWORD>(dm_policy_.auto_update_check_period_minutes);
+  *minutes = static_cast<DWORD>(dm_policy->auto_update_check_period_minutes);
   REPORT_LOG(L5, (_T("[DM Policy check period override %d]"), *minutes));
   return S_OK;
 }
@@ -278,32 +450,36 @@ HRESULT DMPolicyManager::GetLastCheckPeriodMinutes(DWORD* minutes) {
 HRESULT DMPolicyManager::GetUpdatesSuppressedTimes(DWORD* start_hour,
                                                    DWORD* start_min,
                                                    DWORD* duration_min) {
-  if (!IsManaged()) {
+  std::shared_ptr<const CachedOmahaPolicy> dm_policy(
+      std::atomic_load(&dm_policy_));
+  if (!dm_policy->is_initialized) {
     return E_FAIL;
   }
 
-  if (dm_policy_.updates_suppressed.start_hour == -1 ||
-      dm_policy_.updates_suppressed.start_minute == -1 ||
-      dm_policy_.updates_suppressed.duration_min == -1) {
+  if (dm_policy->updates_suppressed.start_hour == -1 ||
+      dm_policy->updates_suppressed.start_minute == -1 ||
+      dm_policy->updates_suppressed.duration_min == -1) {
     OPT_LOG(L5, (_T("[GetUpdatesSuppressedTimes][Missing DM time]")));
     return E_FAIL;
   }
 
-  *start_hour = static_cast<DWORD>(dm_policy_.updates_suppressed.start_hour);
-  *start_min = static_cast<DWORD>(dm_policy_.updates_suppressed.start_minute);
+  *start_hour = static_cast<DWORD>(dm_policy->updates_suppressed.start_hour);
+  *start_min = static_cast<DWORD>(dm_policy->updates_suppressed.start_minute);
   *duration_min =
-      static_cast<DWORD>(dm_policy_.updates_suppressed.duration_min);
+      static_cast<DWORD>(dm_policy->updates_suppressed.duration_min);
 
   return S_OK;
 }
 
 HRESULT DMPolicyManager::GetDownloadPreferenceGroupPolicy(
     CString* download_preference) {
-  if (!IsManaged()) {
+  std::shared_ptr<const CachedOmahaPolicy> dm_policy(
+      std::atomic_load(&dm_policy_));
+  if (!dm_policy->is_initialized) {
     return E_FAIL;
   }
 
-  *download_preference = dm_policy_.download_preference;
+  *download_preference = dm_policy->download_preference;
   return S_OK;
 }
 
@@ -322,38 +498,44 @@ HRESULT DMPolicyManager::GetPackageCacheExpirationTimeDays(
 HRESULT DMPolicyManager::GetEffectivePolicyForAppInstalls(
     const GUID& app_guid,
     DWORD* install_policy) {
-  if (!IsManaged()) {
+  std::shared_ptr<const CachedOmahaPolicy> dm_policy(
+      std::atomic_load(&dm_policy_));
+  if (!dm_policy->is_initialized) {
     return E_FAIL;
   }
 
-  *install_policy = dm_policy_.application_settings.count(app_guid) > 0 ?
-      dm_policy_.application_settings.at(app_guid).install :
-      dm_policy_.install_default;
+  *install_policy = dm_policy->application_settings.count(app_guid) > 0 ?
+      dm_policy->application_settings.at(app_guid).install :
+      dm_policy->install_default;
   return S_OK;
 }
 
 HRESULT DMPolicyManager::GetEffectivePolicyForAppUpdates(const GUID& app_guid,
                                                          DWORD* update_policy) {
-  if (!IsManaged()) {
+  std::shared_ptr<const CachedOmahaPolicy> dm_policy(
+      std::atomic_load(&dm_policy_));
+  if (!dm_policy->is_initialized) {
     return E_FAIL;
   }
 
-  *update_policy = dm_policy_.application_settings.count(app_guid) ?
-      dm_policy_.application_settings.at(app_guid).update :
-      dm_policy_.update_default;
+  *update_policy = dm_policy->application_settings.count(app_guid) ?
+      dm_policy->application_settings.at(app_guid).update :
+      dm_policy->update_default;
   return S_OK;
 }
 
 HRESULT DMPolicyManager::GetTargetVersionPrefix(
     const GUID& app_guid,
     CString* target_version_prefix) {
-  if (!IsManaged()) {
+  std::shared_ptr<const CachedOmahaPolicy> dm_policy(
+      std::atomic_load(&dm_policy_));
+  if (!dm_policy->is_initialized) {
     return E_FAIL;
   }
 
   *target_version_prefix =
-      dm_policy_.application_settings.count(app_guid) ?
-      dm_policy_.application_settings.at(app_guid).target_version_prefix :
+      dm_policy->application_settings.count(app_guid) ?
+      dm_policy->application_settings.at(app_guid).target_version_prefix :
       CString();
   return S_OK;
 }
@@ -361,12 +543,14 @@ HRESULT DMPolicyManager::GetTargetVersionPrefix(
 HRESULT DMPolicyManager::IsRollbackToTargetVersionAllowed(
     const GUID& app_guid,
     bool* rollback_allowed) {
-  if (!IsManaged()) {
+  std::shared_ptr<const CachedOmahaPolicy> dm_policy(
+      std::atomic_load(&dm_policy_));
+  if (!dm_policy->is_initialized) {
     return E_FAIL;
   }
 
-  *rollback_allowed = dm_policy_.application_settings.count(app_guid) ?
-      dm_policy_.application_settings.at(app_guid).rollback_to_target_version :
+  *rollback_allowed = dm_policy->application_settings.count(app_guid) ?
+      dm_policy->application_settings.at(app_guid).rollback_to_target_version :
       false;
   return S_OK;
 }
@@ -386,7 +570,9 @@ void ConfigManager::DeleteInstance() {
   delete config_manager_;
 }
 
-ConfigManager::ConfigManager() : dm_policy_manager_(new DMPolicyManager) {
+ConfigManager::ConfigManager()
+    : group_policy_manager_(new GroupPolicyManager),
+      dm_policy_manager_(new DMPolicyManager) {
   CString current_module_directory(app_util::GetCurrentModuleDirectory());
 
   CString path;
@@ -414,7 +600,7 @@ ConfigManager::ConfigManager() : dm_policy_manager_(new DMPolicyManager) {
                                       true) == 0) :
                       false;
 
-  policies_.emplace_back(new GroupPolicyManager);
+  policies_.push_back(group_policy_manager_);
   policies_.push_back(dm_policy_manager_);
 }
 
@@ -534,9 +720,8 @@ int ConfigManager::GetPackageCacheSizeLimitMBytes() const {
   }
 
   DWORD cache_size_limit = 0;
-  if (FAILED(RegKey::GetValue(kRegKeyGoopdateGroupPolicy,
-                              kRegValueCacheSizeLimitMBytes,
-                              &cache_size_limit)) ||
+  if (FAILED(group_policy_manager_->GetPackageCacheSizeLimitMBytes(
+                 &cache_size_limit)) ||
       cache_size_limit > kMaxCacheStorageLimit ||
       cache_size_limit == 0) {
     cache_size_limit = kDefaultCacheStorageLimit;
@@ -557,9 +742,8 @@ int ConfigManager::GetPackageCacheExpirationTimeDays() const {
   }
 
   DWORD cache_life_limit = 0;
-  if (FAILED(RegKey::GetValue(kRegKeyGoopdateGroupPolicy,
-                              kRegValueCacheLifeLimitDays,
-                              &cache_life_limit)) ||
+  if (FAILED(group_policy_manager_->GetPackageCacheExpirationTimeDays(
+                 &cache_life_limit)) ||
       cache_life_limit > kMaxCacheLifeTimeInDays ||
       cache_life_limit == 0) {
     cache_life_limit = kDefaultCacheLifeTimeInDays;
@@ -693,6 +877,12 @@ void ConfigManager::SetOmahaDMPolicies(const CachedOmahaPolicy& dm_policy) {
                   dm_policy.ToString()));
 }
 
+HRESULT ConfigManager::StartGroupPolicyMonitoring() {
+  HRESULT hr = group_policy_manager_->StartMonitoring();
+  OPT_LOG(L3, (_T("[ConfigManager::StartGroupPolicyMonitoring][0x%08x]"), hr));
+  return hr;
+}
+
 // Returns the override from the registry locations if present. Otherwise,
 // returns the default value.
 // Default value is different value for internal users to make update checks
@@ -1380,6 +1570,20 @@ int ConfigManager::MaxCrashUploadsPerDay() const {
   return static_cast<int>(num_uploads);
 }
 
+int ConfigManager::GetBundleDownloadConcurrency() const {
+  return GetDownloadConcurrency(kRegValueBundleDownloadConcurrency,
+                                kDefaultBundleDownloadConcurrency,
+                                0,
+                                kMaxBundleDownloadConcurrency);
+}
+
+int ConfigManager::GetPackageDownloadConcurrency() const {
+  return GetDownloadConcurrency(kRegValuePackageDownloadConcurrency,
+                                kDefaultPackageDownloadConcurrency,
+                                1,
+                                kMaxPackageDownloadConcurrency);
+}
+
 CString ConfigManager::GetDownloadPreferenceGroupPolicy() const {
   for (size_t i = 0; i != policies_.size(); ++i) {
     if (!policies_[i]->IsManaged()) {
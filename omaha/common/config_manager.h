@@ -26,9 +26,11 @@
 #include <windows.h>
 #include <atlpath.h>
 #include <atlstr.h>
+#include <map>
 #include <memory>
 #include "base/basictypes.h"
 #include "omaha/base/constants.h"
+#include "omaha/base/registry_monitor_manager.h"
 #include "omaha/base/synchronized.h"
 #include "omaha/base/time.h"
 #include "omaha/goopdate/dm_storage.h"
@@ -63,10 +65,75 @@ class PolicyManagerInterface {
                                                    bool* rollback_allowed) = 0;
 };
 
+// A copy of the values under the Group Policy key, read in one pass. The
+// snapshot is not modified once it is published.
+class GroupPolicySnapshot {
+ public:
+  explicit GroupPolicySnapshot(LONG generation)
+      : generation_(generation), is_managed_(false) {}
+
+  LONG generation() const { return generation_; }
+
+  bool is_managed() const { return is_managed_; }
+  void set_is_managed(bool is_managed) { is_managed_ = is_managed; }
+
+  // Like RegKey::GetValue, the value names are case-insensitive and a value
+  // of the wrong type is not found.
+  HRESULT GetValue(const TCHAR* value_name, DWORD* value) const;
+  HRESULT GetValue(const TCHAR* value_name, CString* value) const;
+  void SetValue(const TCHAR* value_name, DWORD value);
+  void SetValue(const TCHAR* value_name, const CString& value);
+
+ private:
+  const LONG generation_;
+  bool is_managed_;
+  std::map<CString, DWORD> dword_values_;
+  std::map<CString, CString> string_values_;
+
+  DISALLOW_COPY_AND_ASSIGN(GroupPolicySnapshot);
+};
+
+// Reads the Group Policy values into a snapshot.
+class GroupPolicyStoreInterface {
+ public:
+  virtual ~GroupPolicyStoreInterface() {}
+
+  virtual void Load(GroupPolicySnapshot* snapshot) = 0;
+};
+
+// Reads the Group Policy values from kRegKeyGoopdateGroupPolicy. The policies
+// only apply to machines enrolled to a domain.
+class RegistryGroupPolicyStore : public GroupPolicyStoreInterface {
+ public:
+  RegistryGroupPolicyStore() {}
+
+  void Load(GroupPolicySnapshot* snapshot) override;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(RegistryGroupPolicyStore);
+};
+
 // A version that picks up policy information from Group Policy.
+//
+// The policies are read from a snapshot. Until StartMonitoring is called, a
+// new snapshot is loaded for every query. Afterwards, the snapshot is kept
+// until the registry monitor reports a change under the Policies key, so an
+// update cycle reads the policies once. The snapshot is published with an
+// atomic pointer swap and the queries do not take locks.
 class GroupPolicyManager : public PolicyManagerInterface {
  public:
-  GroupPolicyManager() {}
+  GroupPolicyManager();
+
+  // Takes ownership of |store|.
+  explicit GroupPolicyManager(GroupPolicyStoreInterface* store);
+
+  ~GroupPolicyManager() override;
+
+  // Starts caching the snapshot and monitoring the policies for changes.
+  HRESULT StartMonitoring();
+
+  // Discards the current snapshot. The next query loads a new one.
+  void OnPolicyChanged();
 
   const TCHAR* source() override { return _T("GroupPolicyManager"); }
 
@@ -91,13 +158,28 @@ class GroupPolicyManager : public PolicyManagerInterface {
                                            bool* rollback_allowed) override;
 
  private:
+  // Returns the current snapshot, or a new one if the policies changed.
+  std::shared_ptr<const GroupPolicySnapshot> GetSnapshot();
+
+  static void PolicyKeyChangeCallback(const TCHAR* key_name, void* user_data);
+
+  std::unique_ptr<GroupPolicyStoreInterface> store_;
+  std::unique_ptr<RegistryMonitor> registry_monitor_;
+
+  // Accessed with the Interlocked functions.
+  volatile LONG is_caching_;
+  volatile LONG generation_;
+
+  // Accessed with std::atomic_load and std::atomic_store.
+  std::shared_ptr<const GroupPolicySnapshot> snapshot_;
+
   DISALLOW_COPY_AND_ASSIGN(GroupPolicyManager);
 };
 
 // A version that picks up policy information from a Device Management (DM).
 class DMPolicyManager : public PolicyManagerInterface {
  public:
-  DMPolicyManager() {}
+  DMPolicyManager() : dm_policy_(new CachedOmahaPolicy) {}
 
   const TCHAR* source() override { return _T("DeviceManagement"); }
 
@@ -121,13 +203,18 @@ class DMPolicyManager : public PolicyManagerInterface {
   HRESULT IsRollbackToTargetVersionAllowed(const GUID& app_guid,
                                            bool* rollback_allowed) override;
 
+  // Publishes a new copy of the policy, which the queries read without
+  // taking locks.
   void set_dm_policy(const CachedOmahaPolicy& dm_policy) {
-    dm_policy_ = dm_policy;
+    std::atomic_store(&dm_policy_,
+                      std::shared_ptr<const CachedOmahaPolicy>(
+                          new CachedOmahaPolicy(dm_policy)));
   }
-  CachedOmahaPolicy dm_policy() { return dm_policy_; }
+  CachedOmahaPolicy dm_policy() { return *std::atomic_load(&dm_policy_); }
 
  private:
-  CachedOmahaPolicy dm_policy_;
+  // Accessed with std::atomic_load and std::atomic_store.
+  std::shared_ptr<const CachedOmahaPolicy> dm_policy_;
 
   DISALLOW_COPY_AND_ASSIGN(DMPolicyManager);
 };
@@ -285,6 +372,10 @@ class ConfigManager {
   // ConfigManager for subsequent config queries.
   void SetOmahaDMPolicies(const CachedOmahaPolicy& dm_policy);
 
+  // Keeps the Group Policy values in memory until they change. Long-lived
+  // processes call this once at startup.
+  HRESULT StartGroupPolicyMonitoring();
+
   CachedOmahaPolicy dm_policy() { return dm_policy_manager_->dm_policy(); }
 
   // Returns the time interval between update checks in seconds.
@@ -398,6 +489,15 @@ class ConfigManager {
   // Returns the number of crashes to upload per day.
   int MaxCrashUploadsPerDay() const;
 
+  // Returns the number of threads which download the apps of a bundle ahead
+  // of the app being installed. Zero means that each app is downloaded and
+  // installed before the next app in the bundle is processed.
+  int GetBundleDownloadConcurrency() const;
+
+  // Returns the number of packages of an app which are downloaded at the same
+  // time. The return value is at least one.
+  int GetPackageDownloadConcurrency() const;
+
   // Returns the value of the "DownloadPreference" group policy or an
   // empty string if the group policy does not exist, the policy is unknown, or
   // an error happened.
@@ -437,6 +537,7 @@ class ConfigManager {
   bool is_running_from_official_user_dir_;
   bool is_running_from_official_machine_dir_;
   std::vector<std::shared_ptr<PolicyManagerInterface>> policies_;  // NOLINT
+  std::shared_ptr<GroupPolicyManager> group_policy_manager_;  // NOLINT
   std::shared_ptr<DMPolicyManager> dm_policy_manager_;  // NOLINT
 
   DISALLOW_COPY_AND_ASSIGN(ConfigManager);
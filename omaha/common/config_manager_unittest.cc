@@ -2095,6 +2095,58 @@ TEST_P(ConfigManagerTest, MaxCrashUploadsPerDay) {
   EXPECT_EQ(kDefaultUploadsPerDay, cm_->MaxCrashUploadsPerDay());
 }
 
+TEST_P(ConfigManagerTest, GetBundleDownloadConcurrency) {
+  EXPECT_EQ(kDefaultBundleDownloadConcurrency,
+            cm_->GetBundleDownloadConcurrency());
+
+  EXPECT_SUCCEEDED(RegKey::SetValue(MACHINE_REG_UPDATE_DEV,
+                                    kRegValueBundleDownloadConcurrency,
+                                    static_cast<DWORD>(0)));
+  EXPECT_EQ(0, cm_->GetBundleDownloadConcurrency());
+
+  EXPECT_SUCCEEDED(RegKey::SetValue(MACHINE_REG_UPDATE_DEV,
+                                    kRegValueBundleDownloadConcurrency,
+                                    static_cast<DWORD>(3)));
+  EXPECT_EQ(3, cm_->GetBundleDownloadConcurrency());
+
+  EXPECT_SUCCEEDED(RegKey::SetValue(MACHINE_REG_UPDATE_DEV,
+                                    kRegValueBundleDownloadConcurrency,
+                                    static_cast<DWORD>(-1)));
+  EXPECT_EQ(kMaxBundleDownloadConcurrency,
+            cm_->GetBundleDownloadConcurrency());
+
+  EXPECT_SUCCEEDED(RegKey::DeleteValue(MACHINE_REG_UPDATE_DEV,
+                                       kRegValueBundleDownloadConcurrency));
+  EXPECT_EQ(kDefaultBundleDownloadConcurrency,
+            cm_->GetBundleDownloadConcurrency());
+}
+
+TEST_P(ConfigManagerTest, GetPackageDownloadConcurrency) {
+  EXPECT_EQ(kDefaultPackageDownloadConcurrency,
+            cm_->GetPackageDownloadConcurrency());
+
+  EXPECT_SUCCEEDED(RegKey::SetValue(MACHINE_REG_UPDATE_DEV,
+                                    kRegValuePackageDownloadConcurrency,
+                                    static_cast<DWORD>(0)));
+  EXPECT_EQ(1, cm_->GetPackageDownloadConcurrency());
+
+  EXPECT_SUCCEEDED(RegKey::SetValue(MACHINE_REG_UPDATE_DEV,
+                                    kRegValuePackageDownloadConcurrency,
+                                    static_cast<DWORD>(5)));
+  EXPECT_EQ(5, cm_->GetPackageDownloadConcurrency());
+
+  EXPECT_SUCCEEDED(RegKey::SetValue(MACHINE_REG_UPDATE_DEV,
+                                    kRegValuePackageDownloadConcurrency,
+                                    static_cast<DWORD>(-1)));
+  EXPECT_EQ(kMaxPackageDownloadConcurrency,
+            cm_->GetPackageDownloadConcurrency());
+
+  EXPECT_SUCCEEDED(RegKey::DeleteValue(MACHINE_REG_UPDATE_DEV,
+                                       kRegValuePackageDownloadConcurrency));
+  EXPECT_EQ(kDefaultPackageDownloadConcurrency,
+            cm_->GetPackageDownloadConcurrency());
+}
+
 // This test is slighly flaky due to the random nature of the jitter.
 TEST_P(ConfigManagerTest, GetAutoUpdateJitterMs) {
   // Test successive calls return different values.
@@ -2157,4 +2209,165 @@ TEST_P(ConfigManagerTest, IsCloudManagementEnrollmentMandatory) {
 
 #endif  // defined(HAS_DEVICE_MANAGEMENT)
 
+
+namespace {
+
+// Stands in for the registry and counts how many times the Group Policy
+// values are read.
+class CountingGroupPolicyStore : public GroupPolicyStoreInterface {
+ public:
+  explicit CountingGroupPolicyStore(int* load_count)
+      : load_count_(load_count) {}
+
+  void Load(GroupPolicySnapshot* snapshot) override {
+    ++*load_count_;
+    snapshot->set_is_managed(true);
+    snapshot->SetValue(kRegValueAutoUpdateCheckPeriodOverrideMinutes,
+                       static_cast<DWORD>(120));
+    snapshot->SetValue(kRegValueCacheSizeLimitMBytes, static_cast<DWORD>(100));
+    snapshot->SetValue(kRegValueUpdateAppsDefault,
+                       static_cast<DWORD>(kPolicyEnabled));
+    snapshot->SetValue(kUpdatePolicyApp1,
+                       static_cast<DWORD>(kPolicyManualUpdatesOnly));
+    snapshot->SetValue(kRegValueDownloadPreference,
+                       CString(kDownloadPreferenceCacheable));
+  }
+
+ private:
+  int* load_count_;
+};
+
+// Makes the Group Policy queries of an update check of two apps, the way
+// ConfigManager does. Returns the number of queries.
+int RunUpdateCycle(GroupPolicyManager* group_policy_manager) {
+  const GUID app_guids[] = { StringToGuid(kAppGuid1),
+                             StringToGuid(kAppGuid2) };
+  int num_queries = 0;
+
+  DWORD value = 0;
+  EXPECT_TRUE(group_policy_manager->IsManaged());
+  EXPECT_SUCCEEDED(group_policy_manager->GetLastCheckPeriodMinutes(&value));
+  EXPECT_EQ(120UL, value);
+  num_queries += 2;
+
+  DWORD start_hour = 0;
+  DWORD start_min = 0;
+  DWORD duration_min = 0;
+  EXPECT_TRUE(group_policy_manager->IsManaged());
+  EXPECT_FAILED(group_policy_manager->GetUpdatesSuppressedTimes(&start_hour,
+                                                                &start_min,
+                                                                &duration_min));
+  num_queries += 2;
+
+  EXPECT_SUCCEEDED(
+      group_policy_manager->GetPackageCacheSizeLimitMBytes(&value));
+  EXPECT_EQ(100UL, value);
+  ++num_queries;
+
+  CString download_preference;
+  EXPECT_TRUE(group_policy_manager->IsManaged());
+  EXPECT_SUCCEEDED(group_policy_manager->GetDownloadPreferenceGroupPolicy(
+      &download_preference));
+  EXPECT_STREQ(kDownloadPreferenceCacheable, download_preference);
+  num_queries += 2;
+
+  for (size_t i = 0; i != arraysize(app_guids); ++i) {
+    DWORD update_policy = 0;
+    EXPECT_TRUE(group_policy_manager->IsManaged());
+    EXPECT_SUCCEEDED(group_policy_manager->GetEffectivePolicyForAppUpdates(
+        app_guids[i], &update_policy));
+    EXPECT_EQ(i == 0 ? kPolicyManualUpdatesOnly : kPolicyEnabled,
+              update_policy);
+
+    CString target_version_prefix;
+    EXPECT_TRUE(group_policy_manager->IsManaged());
+    EXPECT_FAILED(group_policy_manager->GetTargetVersionPrefix(
+        app_guids[i], &target_version_prefix));
+    num_queries += 4;
+  }
+
+  return num_queries;
+}
+
+}  // namespace
+
+TEST(GroupPolicyManagerTest, ReadsPoliciesForEveryQueryUntilMonitored) {
+  int load_count = 0;
+  GroupPolicyManager group_policy_manager(
+      new CountingGroupPolicyStore(&load_count));
+
+  const int num_queries = RunUpdateCycle(&group_policy_manager);
+  EXPECT_EQ(num_queries, load_count);
+}
+
+TEST(GroupPolicyManagerTest, ReadsPoliciesOncePerChange) {
+  int load_count = 0;
+  GroupPolicyManager group_policy_manager(
+      new CountingGroupPolicyStore(&load_count));
+  ASSERT_SUCCEEDED(group_policy_manager.StartMonitoring());
+
+  RunUpdateCycle(&group_policy_manager);
+  EXPECT_EQ(1, load_count);
+
+  RunUpdateCycle(&group_policy_manager);
+  EXPECT_EQ(1, load_count);
+
+  // The registry monitor calls OnPolicyChanged when the policies change.
+  group_policy_manager.OnPolicyChanged();
+  RunUpdateCycle(&group_policy_manager);
+  EXPECT_EQ(2, load_count);
+}
+
+TEST(GroupPolicySnapshotTest, GetValue) {
+  GroupPolicySnapshot snapshot(0);
+  snapshot.SetValue(kInstallPolicyApp1, static_cast<DWORD>(kPolicyDisabled));
+  snapshot.SetValue(kRegValueDownloadPreference, CString(_T("cacheable")));
+
+  DWORD value = 0;
+  CString install_policy_name(kInstallPolicyApp1);
+  EXPECT_SUCCEEDED(snapshot.GetValue(install_policy_name.MakeLower(), &value));
+  EXPECT_EQ(kPolicyDisabled, value);
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND),
+            snapshot.GetValue(kInstallPolicyApp2, &value));
+
+  // A value of the wrong type is not found.
+  CString string_value;
+  EXPECT_FAILED(snapshot.GetValue(kInstallPolicyApp1, &string_value));
+  EXPECT_SUCCEEDED(snapshot.GetValue(kRegValueDownloadPreference,
+                                     &string_value));
+  EXPECT_STREQ(_T("cacheable"), string_value);
+  EXPECT_FAILED(snapshot.GetValue(kRegValueDownloadPreference, &value));
+}
+
+// The cached policies are refreshed when the registry monitor reports a
+// change to the Group Policy key.
+TEST_P(ConfigManagerTest, GroupPolicyManager_RefreshedOnRegistryChange) {
+  if (!IsDomain()) {
+    return;
+  }
+
+  GroupPolicyManager group_policy_manager;
+  ASSERT_SUCCEEDED(SetPolicy(kRegValueAutoUpdateCheckPeriodOverrideMinutes,
+                             60UL));
+  ASSERT_SUCCEEDED(group_policy_manager.StartMonitoring());
+
+  DWORD minutes = 0;
+  EXPECT_SUCCEEDED(group_policy_manager.GetLastCheckPeriodMinutes(&minutes));
+  EXPECT_EQ(60UL, minutes);
+
+  ASSERT_SUCCEEDED(SetPolicy(kRegValueAutoUpdateCheckPeriodOverrideMinutes,
+                             90UL));
+  const int kWaitForChangeMs = 5000;
+  const int kPollIntervalMs = 10;
+  for (int waited_ms = 0; waited_ms < kWaitForChangeMs;
+       waited_ms += kPollIntervalMs) {
+    EXPECT_SUCCEEDED(group_policy_manager.GetLastCheckPeriodMinutes(&minutes));
+    if (minutes == 90) {
+      break;
+    }
+    ::Sleep(kPollIntervalMs);
+  }
+  EXPECT_EQ(90UL, minutes);
+}
+
 }  // namespace omaha
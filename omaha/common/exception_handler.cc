@@ -175,6 +175,10 @@ bool OmahaExceptionHandler::StaticMinidumpCallback(const wchar_t* dump_path,
     thisptr->MinidumpCallback(dump_path, minidump_id);
   }
 
+  // The static destructors do not run, therefore the buffered log messages
+  // must be written out here.
+  FLUSH_LOG();
+
   // There are two ways to stop execution of the current process: ExitProcess
   // and TerminateProcess. Calling ExitProcess results in calling the
   // destructors of the static objects before the process exits.
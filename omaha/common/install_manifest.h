@@ -30,14 +30,22 @@ namespace omaha {
 namespace xml {
 
 struct InstallPackage {
-  InstallPackage() : is_required(false), size(0) {}
+  InstallPackage() : is_required(false), size(0), size_diff(0) {}
 
   CString name;
   CString version;
   bool is_required;
-  int size;
+  uint64 size;
   CString hash_sha1;  // base64 encoded.
   CString hash_sha256;  // hex-digit encoded.
+
+  // The optional differential package, which reconstructs the package from
+  // the package of the installed version whose hash is base_hash_sha256. The
+  // name is empty if the server did not offer a differential package.
+  CString name_diff;
+  uint64 size_diff;
+  CString hash_diff_sha256;  // hex-digit encoded.
+  CString base_hash_sha256;  // hex-digit encoded.
 };
 
 struct InstallAction {
@@ -15,6 +15,8 @@
 
 #include "omaha/common/ping.h"
 
+#include <atlbase.h>
+
 #include "omaha/base/constants.h"
 #include "omaha/base/debug.h"
 #include "omaha/base/logging.h"
@@ -25,6 +27,7 @@
 #include "omaha/base/utils.h"
 #include "omaha/base/vistautil.h"
 #include "omaha/base/vista_utils.h"
+#include "omaha/base/xml_utils.h"
 #include "omaha/common/app_registry_utils.h"
 #include "omaha/common/command_line.h"
 #include "omaha/common/command_line_builder.h"
@@ -33,6 +36,7 @@
 #include "omaha/common/goopdate_utils.h"
 #include "omaha/common/update_request.h"
 #include "omaha/common/update_response.h"
+#include "omaha/common/xml_const.h"
 #include "omaha/goopdate/app.h"
 #include "omaha/goopdate/app_bundle.h"
 #include "omaha/goopdate/update_request_utils.h"
@@ -46,11 +50,166 @@ const TCHAR* const Ping::kRegValuePersistedPingTime = _T("PersistedPingTime");
 const TCHAR* const Ping::kRegValuePersistedPingString =
     _T("PersistedPingString");
 const time64 Ping::kPersistedPingExpiry100ns  = 10 * kDaysTo100ns;  // 10 days.
+const size_t Ping::kMaxPersistedPingsPerBatch = 32;
+const int Ping::kMaxPersistedPingBatchLength = 64 * 1024;  // Characters.
 
 // Minimum compatible Omaha version that understands the /ping command line.
 // 1.3.0.0.
 const ULONGLONG kMinOmahaVersionForPingOOP = 0x0001000300000000;
 
+namespace {
+
+// Persisted pings which are sent in the same request.
+struct PersistedPingBatch {
+  PersistedPingBatch() : length(0) {}
+
+  // The request element of the first ping, without its request id, which the
+  // other pings in the batch must match. The pings in a batch therefore have
+  // the same session id.
+  CString request_key;
+
+  // The request element of the first ping, which the app elements of all
+  // the pings in the batch are moved to. The batch is sent with the request
+  // id and the session id of the first ping.
+  CComPtr<IXMLDOMElement> request;
+
+  // The length of the app elements in the batch.
+  int length;
+
+  // The indexes of the persisted pings in the batch.
+  std::vector<size_t> pings;
+};
+
+// Removes the app elements from the request element of |ping_string|.
+// |request_key| is set to the rest of the request element, without the request
+// id, which is the same for all the pings that can be sent together.
+HRESULT ParsePersistedPing(const CString& ping_string,
+                           CComPtr<IXMLDOMElement>* request,
+                           std::vector<CComPtr<IXMLDOMNode> >* apps,
+                           CString* request_key) {
+  ASSERT1(request);
+  ASSERT1(apps);
+  ASSERT1(request_key);
+
+  CComPtr<IXMLDOMDocument> document;
+  HRESULT hr = LoadXMLFromMemory(ping_string, false, &document);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  CComPtr<IXMLDOMElement> root;
+  hr = document->get_documentElement(&root);
+  if (FAILED(hr)) {
+    return hr;
+  }
+  if (!root) {
+    return E_UNEXPECTED;
+  }
+
+  CComBSTR root_name;
+  hr = root->get_nodeName(&root_name);
+  if (FAILED(hr)) {
+    return hr;
+  }
+  if (CString(root_name) != xml::element::kRequest) {
+    return E_UNEXPECTED;
+  }
+
+  CComPtr<IXMLDOMNodeList> app_nodes;
+  hr = root->getElementsByTagName(CComBSTR(xml::element::kApp), &app_nodes);
+  if (FAILED(hr)) {
+    return hr;
+  }
+  long num_apps = 0;  // NOLINT
+  hr = app_nodes->get_length(&num_apps);
+  if (FAILED(hr)) {
+    return hr;
+  }
+  if (!num_apps) {
+    return E_UNEXPECTED;
+  }
+
+  // The node list is live, therefore the apps are removed after they have
+  // all been collected.
+  for (long i = 0; i != num_apps; ++i) {  // NOLINT
+    CComPtr<IXMLDOMNode> app;
+    hr = app_nodes->get_item(i, &app);
+    if (FAILED(hr)) {
+      return hr;
+    }
+    apps->push_back(app);
+  }
+  for (size_t i = 0; i != apps->size(); ++i) {
+    CComPtr<IXMLDOMNode> removed_app;
+    hr = root->removeChild((*apps)[i], &removed_app);
+    if (FAILED(hr)) {
+      return hr;
+    }
+  }
+
+  CComVariant request_id;
+  hr = root->getAttribute(CComBSTR(xml::attribute::kRequestId), &request_id);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  CComBSTR request_xml;
+  hr = root->get_xml(&request_xml);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  *request_key = request_xml;
+  if (V_VT(&request_id) == VT_BSTR && ::SysStringLen(V_BSTR(&request_id))) {
+    request_key->Replace(CString(V_BSTR(&request_id)), _T(""));
+  }
+  *request = root;
+  return S_OK;
+}
+
+// Returns the batch which |length| more characters of app elements with the
+// request |request_key| can be added to, or NULL if there is none.
+PersistedPingBatch* FindPersistedPingBatch(
+    std::vector<PersistedPingBatch>* batches,
+    const CString& request_key,
+    int length,
+    size_t max_pings,
+    int max_length) {
+  ASSERT1(batches);
+
+  for (size_t i = 0; i != batches->size(); ++i) {
+    PersistedPingBatch& batch = (*batches)[i];
+    if (batch.request &&
+        batch.request_key == request_key &&
+        batch.pings.size() < max_pings &&
+        batch.length + length <= max_length) {
+      return &batch;
+    }
+  }
+
+  return NULL;
+}
+
+// Serializes the request of a batch, which keeps the request id and the
+// session id of the first ping of the batch.
+HRESULT BuildPersistedPingBatchString(IXMLDOMElement* request,
+                                      CString* request_string) {
+  ASSERT1(request);
+  ASSERT1(request_string);
+
+  CComBSTR request_xml;
+  HRESULT hr = request->get_xml(&request_xml);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  *request_string = xml::kXmlDirective;
+  *request_string += request_xml;
+  return S_OK;
+}
+
+}  // namespace
+
 Ping::Ping(bool is_machine,
            const CString& session_id,
            const CString& install_source,
@@ -488,36 +647,119 @@ HRESULT Ping::PersistPing() {
 }
 
 HRESULT Ping::SendPersistedPings(bool is_machine) {
+  return SendPersistedPings(is_machine, &Ping::SendString);
+}
+
+HRESULT Ping::SendPersistedPings(bool is_machine, SendStringFunc send_string) {
+  ASSERT1(send_string);
+
   PingsVector persisted_pings;
   HRESULT hr = LoadPersistedPings(is_machine, &persisted_pings);
   if (FAILED(hr) && (hr != HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND))) {
     return hr;
   }
 
+  const int32 now = Time64ToInt32(GetCurrent100NSTime());
+
+  std::vector<PersistedPingBatch> batches;
   for (size_t i = 0; i != persisted_pings.size(); ++i) {
     const CString& persisted_subkey_name(persisted_pings[i].first);
     time64 persisted_time = persisted_pings[i].second.first;
-    int32 request_age = Time64ToInt32(GetCurrent100NSTime()) -
-                        Time64ToInt32(persisted_time);
+    int32 request_age = now - Time64ToInt32(persisted_time);
     const CString& persisted_ping_string(persisted_pings[i].second.second);
 
-    CORE_LOG(L3, (_T("[Resending persisted ping][%s][%I64u][%d][%s]"),
-                  persisted_subkey_name,
-                  persisted_time,
-                  request_age,
-                  persisted_ping_string));
+    CComPtr<IXMLDOMElement> request;
+    std::vector<CComPtr<IXMLDOMNode> > apps;
+    CString request_key;
+    hr = ParsePersistedPing(persisted_ping_string,
+                            &request,
+                            &apps,
+                            &request_key);
+    if (FAILED(hr)) {
+      // The ping is sent by itself, as it was persisted.
+      CORE_LOG(LW, (_T("[ParsePersistedPing failed][%s][%#x]"),
+                    persisted_subkey_name, hr));
+      batches.push_back(PersistedPingBatch());
+      batches.back().pings.push_back(i);
+      continue;
+    }
 
     CString request_age_string;
     SafeCStringFormat(&request_age_string, _T("%d"), request_age);
+    int length = 0;
+    for (size_t j = 0; j != apps.size(); ++j) {
+      CComQIPtr<IXMLDOMElement> app(apps[j]);
+      if (app) {
+        VERIFY1(SUCCEEDED(app->setAttribute(
+            CComBSTR(xml::attribute::kRequestAge),
+            CComVariant(request_age_string))));
+      }
+      CComBSTR app_xml;
+      if (SUCCEEDED(apps[j]->get_xml(&app_xml))) {
+        length += app_xml.Length();
+      }
+    }
+
+    PersistedPingBatch* batch = FindPersistedPingBatch(
+        &batches,
+        request_key,
+        length,
+        kMaxPersistedPingsPerBatch,
+        kMaxPersistedPingBatchLength);
+    if (!batch) {
+      batches.push_back(PersistedPingBatch());
+      batch = &batches.back();
+      batch->request_key = request_key;
+      batch->request = request;
+    }
+
+    for (size_t j = 0; j != apps.size(); ++j) {
+      CComPtr<IXMLDOMNode> appended_app;
+      VERIFY1(SUCCEEDED(batch->request->appendChild(apps[j], &appended_app)));
+    }
+    batch->length += length;
+    batch->pings.push_back(i);
+  }
+
+  for (size_t i = 0; i != batches.size(); ++i) {
+    const PersistedPingBatch& batch = batches[i];
+    ASSERT1(!batch.pings.empty());
+
+    hr = S_OK;
     HeadersVector headers;
-    headers.push_back(std::make_pair(kHeaderXRequestAge, request_age_string));
+    CString request_string;
+    if (batch.pings.size() == 1) {
+      // A single ping is sent as it was persisted, with its age in the
+      // request headers.
+      const size_t ping = batch.pings.front();
+      const time64 persisted_time = persisted_pings[ping].second.first;
+      CString request_age_string;
+      SafeCStringFormat(&request_age_string, _T("%d"),
+                        now - Time64ToInt32(persisted_time));
+      headers.push_back(std::make_pair(kHeaderXRequestAge, request_age_string));
+      request_string = persisted_pings[ping].second.second;
+    } else {
+      hr = BuildPersistedPingBatchString(batch.request, &request_string);
+      if (FAILED(hr)) {
+        CORE_LOG(LE, (_T("[BuildPersistedPingBatchString failed][%#x]"), hr));
+      }
+    }
 
-    hr = SendString(is_machine, headers, persisted_ping_string);
+    CORE_LOG(L3, (_T("[Resending persisted pings][%Iu pings][%s]"),
+                  batch.pings.size(), request_string));
 
-    if (SUCCEEDED(hr) || IsPingExpired(persisted_time)) {
-      CORE_LOG(L3, (_T("[Deleting persisted ping][0x%x]"), hr));
-      VERIFY1(SUCCEEDED(DeletePersistedPing(is_machine,
-                                            persisted_subkey_name)));
+    if (SUCCEEDED(hr)) {
+      hr = send_string(is_machine, headers, request_string);
+    }
+
+    for (size_t j = 0; j != batch.pings.size(); ++j) {
+      const size_t ping = batch.pings[j];
+      if (SUCCEEDED(hr) || IsPingExpired(persisted_pings[ping].second.first)) {
+        CORE_LOG(L3, (_T("[Deleting persisted ping][%s][0x%x]"),
+                      persisted_pings[ping].first, hr));
+        VERIFY1(SUCCEEDED(DeletePersistedPing(is_machine,
+                                              persisted_pings[ping].first)));
+      }
     }
   }
 
@@ -155,7 +155,13 @@ class Ping {
   // Persists the current Ping object to the registry.
   HRESULT PersistPing();
 
-  // Sends all persisted pings. Deletes successful or expired pings.
+  // Sends all persisted pings. Deletes successful or expired pings. The
+  // persisted pings of a session which only differ by their request id and by
+  // their apps are sent together, in batches of up to
+  // kMaxPersistedPingsPerBatch pings. A batch is sent with the session id and
+  // the request id of its first ping. Each app in a batch carries the age of
+  // its ping in its "requestage" attribute, in seconds. The pings are deleted
+  // only if the request which carries them succeeds.
   static HRESULT SendPersistedPings(bool is_machine);
 
   // Sends a ping string to the server, in-process. The ping_string must be web
@@ -177,6 +183,11 @@ class Ping {
   FRIEND_TEST(PingTest, PersistPing);
   FRIEND_TEST(PingTest, PersistPing_Load_Delete);
   FRIEND_TEST(PingTest, PersistAndSendPersistedPings);
+  FRIEND_TEST(PingTest, SendPersistedPings_Batch);
+  FRIEND_TEST(PingTest, SendPersistedPings_BatchFails);
+  FRIEND_TEST(PingTest, SendPersistedPings_DifferentSessions);
+  FRIEND_TEST(PingTest, SendPersistedPings_MaxPingsPerBatch);
+  FRIEND_TEST(PingTest, SendPersistedPings_NotParsed);
   FRIEND_TEST(PingTest, DISABLED_SendUsingGoogleUpdate);
   FRIEND_TEST(PersistedPingsTest, AddPingEvents);
 
@@ -187,6 +198,13 @@ class Ping {
   static const TCHAR* const kRegValuePersistedPingTime;
   static const TCHAR* const kRegValuePersistedPingString;
   static const time64 kPersistedPingExpiry100ns;
+  static const size_t kMaxPersistedPingsPerBatch;
+  static const int kMaxPersistedPingBatchLength;
+
+  // Sends a request string to the ping server.
+  typedef HRESULT (*SendStringFunc)(bool is_machine,
+                                    const HeadersVector& headers,
+                                    const CString& request_string);
 
   void Initialize(bool is_machine,
                   const CString& session_id,
@@ -213,6 +231,8 @@ class Ping {
   static bool IsPingExpired(time64 persisted_time);
   static HRESULT DeletePersistedPing(bool is_machine,
                                      const CString& persisted_subkey_name);
+  static HRESULT SendPersistedPings(bool is_machine,
+                                    SendStringFunc send_string);
   void DeletePersistedPingOnSuccess(const HRESULT& hr);
   CString GetPersistedPingRegPath();
 
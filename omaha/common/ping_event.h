@@ -25,6 +25,12 @@
 
 namespace omaha {
 
+namespace xml {
+
+class XmlWriter;
+
+}  // namespace xml
+
 class PingEvent {
  public:
   // The extra code represents the file order as defined by the setup.
@@ -134,7 +140,8 @@ class PingEvent {
 
   virtual ~PingEvent() {}
 
-  virtual HRESULT ToXml(IXMLDOMNode* parent_node) const;
+  // Adds the attributes of the event to the 'event' element just started.
+  virtual void ToXml(xml::XmlWriter* writer) const;
   virtual CString ToString() const;
 
  private:
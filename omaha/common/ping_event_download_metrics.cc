@@ -16,8 +16,8 @@
 #include "omaha/common/ping_event_download_metrics.h"
 #include "omaha/base/safe_format.h"
 #include "omaha/base/string.h"
-#include "omaha/base/xml_utils.h"
 #include "omaha/common/xml_const.h"
+#include "omaha/common/xml_writer.h"
 
 namespace omaha {
 
@@ -73,56 +73,17 @@ PingEventDownloadMetrics::PingEventDownloadMetrics(
       download_metrics_(download_metrics) {
 }
 
-HRESULT PingEventDownloadMetrics::ToXml(IXMLDOMNode* parent_node) const {
-  HRESULT hr = PingEvent::ToXml(parent_node);
-  if (FAILED(hr)) {
-    return hr;
-  }
-
-  hr = AddXMLAttributeNode(parent_node,
-                           xml::kXmlNamespace,
-                           xml::attribute::kDownloader,
-                           DownloaderToString(download_metrics_.downloader));
-  if (FAILED(hr)) {
-    return hr;
-  }
-
-  hr = AddXMLAttributeNode(parent_node,
-                           xml::kXmlNamespace,
-                           xml::attribute::kUrl,
-                           download_metrics_.url);
-  if (FAILED(hr)) {
-    return hr;
-  }
-
-  hr = AddXMLAttributeNode(
-      parent_node,
-      xml::kXmlNamespace,
-      xml::attribute::kDownloaded,
-      String_Int64ToString(download_metrics_.downloaded_bytes, 10));
-  if (FAILED(hr)) {
-    return hr;
-  }
-
-  hr = AddXMLAttributeNode(
-      parent_node,
-      xml::kXmlNamespace,
-      xml::attribute::kTotal,
-      String_Int64ToString(download_metrics_.total_bytes, 10));
-  if (FAILED(hr)) {
-    return hr;
-  }
-
-  hr = AddXMLAttributeNode(
-      parent_node,
-      xml::kXmlNamespace,
-      xml::attribute::kDownloadTime,
-      String_Int64ToString(download_metrics_.download_time_ms, 10));
-  if (FAILED(hr)) {
-    return hr;
-  }
-
-  return S_OK;
+void PingEventDownloadMetrics::ToXml(xml::XmlWriter* writer) const {
+  PingEvent::ToXml(writer);
+
+  writer->AddAttribute(xml::attribute::kDownloader,
+                       DownloaderToString(download_metrics_.downloader));
+  writer->AddAttribute(xml::attribute::kUrl, download_metrics_.url);
+  writer->AddAttribute(xml::attribute::kDownloaded,
+                       download_metrics_.downloaded_bytes);
+  writer->AddAttribute(xml::attribute::kTotal, download_metrics_.total_bytes);
+  writer->AddAttribute(xml::attribute::kDownloadTime,
+                       download_metrics_.download_time_ms);
 }
 
 CString PingEventDownloadMetrics::ToString() const {
@@ -18,6 +18,7 @@
 #include "omaha/base/file.h"
 #include "omaha/base/logging.h"
 #include "omaha/base/omaha_version.h"
+#include "omaha/base/safe_format.h"
 #include "omaha/base/string.h"
 #include "omaha/base/utils.h"
 #include "omaha/common/command_line.h"
@@ -29,15 +30,102 @@
 
 namespace omaha {
 
+// Stands in for the ping server. Records the requests instead of sending
+// them and fails them with |result_| if it is set.
+class PingServerStandIn {
+ public:
+  static HRESULT SendString(bool is_machine,
+                            const HeadersVector& headers,
+                            const CString& request_string) {
+    UNREFERENCED_PARAMETER(is_machine);
+    requests_.push_back(request_string);
+    headers_.push_back(headers);
+    return result_;
+  }
+
+  static void Reset() {
+    requests_.clear();
+    headers_.clear();
+    result_ = S_OK;
+  }
+
+  static std::vector<CString> requests_;
+  static std::vector<HeadersVector> headers_;
+  static HRESULT result_;
+};
+
+std::vector<CString> PingServerStandIn::requests_;
+std::vector<HeadersVector> PingServerStandIn::headers_;
+HRESULT PingServerStandIn::result_ = S_OK;
+
 class PingTest : public testing::Test {
  protected:
   virtual void SetUp() {
     RegKey::DeleteKey(USER_REG_UPDATE _T("\\PersistedPings"));
+    PingServerStandIn::Reset();
   }
 
   virtual void TearDown() {
     RegKey::DeleteKey(USER_REG_UPDATE _T("\\PersistedPings"));
   }
+
+  // Persists a ping for |app_id| with the given session id, |age_sec| seconds
+  // ago.
+  // Returns the request id of the ping.
+  static CString PersistPingString(const CString& session_id,
+                                   const CString& app_id,
+                                   int age_sec) {
+    CString request_id;
+    EXPECT_SUCCEEDED(GetGuid(&request_id));
+
+    CString ping_string;
+    SafeCStringFormat(&ping_string,
+        _T("<?xml version=\"1.0\" encoding=\"UTF-8\"?>")
+        _T("<request protocol=\"3.0\" version=\"1.3.99.0\" ismachine=\"0\" ")
+        _T("sessionid=\"%s\" installsource=\"taggedmi\" ")
+        _T("requestid=\"%s\"><os platform=\"win\" version=\"6.1\"/>")
+        _T("<app appid=\"%s\" version=\"1.0.0.0\">")
+        _T("<event eventtype=\"2\" eventresult=\"1\" errorcode=\"0\" ")
+        _T("extracode1=\"0\"/></app></request>"),
+        session_id, request_id, app_id);
+    PersistString(request_id, ping_string, age_sec);
+    return request_id;
+  }
+
+  static void PersistString(const CString& subkey_name,
+                            const CString& ping_string,
+                            int age_sec) {
+    CString time_string;
+    SafeCStringFormat(&time_string, _T("%I64u"),
+                      GetCurrent100NSTime() - age_sec * kSecsTo100ns);
+
+    const CString ping_reg_path(AppendRegKeyPath(
+        Ping::GetPersistedPingsRegPath(false), subkey_name));
+    EXPECT_SUCCEEDED(RegKey::SetValue(ping_reg_path,
+                                      Ping::kRegValuePersistedPingTime,
+                                      time_string));
+    EXPECT_SUCCEEDED(RegKey::SetValue(ping_reg_path,
+                                      Ping::kRegValuePersistedPingString,
+                                      ping_string));
+  }
+
+  static int CountSubstrings(const CString& str, const CString& substr) {
+    int count = 0;
+    for (int pos = str.Find(substr); pos != -1;
+         pos = str.Find(substr, pos + 1)) {
+      ++count;
+    }
+    return count;
+  }
+
+  static int GetNumPersistedPings() {
+    RegKey pings_reg_key;
+    if (FAILED(pings_reg_key.Open(Ping::GetPersistedPingsRegPath(false),
+                                  KEY_READ))) {
+      return 0;
+    }
+    return pings_reg_key.GetSubkeyCount();
+  }
 };
 
 class PersistedPingsTest : public AppTestBase {
@@ -359,6 +447,150 @@ TEST_F(PingTest, PersistAndSendPersistedPings) {
   EXPECT_EQ(0, pings_reg_key.GetSubkeyCount());
 }
 
+TEST_F(PingTest, SendPersistedPings_Batch) {
+  const CString request_ids[] = {
+    PersistPingString(_T("{0D5B6A64-45A3-4E5C-BA44-1A1E0D9E8A6B}"),
+                      _T("{00000000-0000-0000-0000-000000000001}"),
+                      100),
+    PersistPingString(_T("{0D5B6A64-45A3-4E5C-BA44-1A1E0D9E8A6B}"),
+                      _T("{00000000-0000-0000-0000-000000000002}"),
+                      200),
+    PersistPingString(_T("{0D5B6A64-45A3-4E5C-BA44-1A1E0D9E8A6B}"),
+                      _T("{00000000-0000-0000-0000-000000000003}"),
+                      300),
+  };
+  EXPECT_EQ(3, GetNumPersistedPings());
+
+  EXPECT_SUCCEEDED(Ping::SendPersistedPings(false,
+                                            &PingServerStandIn::SendString));
+
+  ASSERT_EQ(1, PingServerStandIn::requests_.size());
+  const CString& request(PingServerStandIn::requests_[0]);
+  EXPECT_EQ(0, request.Find(_T("<?xml version=\"1.0\" encoding=\"UTF-8\"?>")));
+  EXPECT_EQ(1, CountSubstrings(request, _T("<request ")));
+  EXPECT_EQ(1, CountSubstrings(request, _T("<os ")));
+  EXPECT_EQ(1, CountSubstrings(request, _T(" requestid=")));
+  EXPECT_EQ(1, CountSubstrings(request, _T(" sessionid=")));
+
+  // The batch keeps the session id and the request id of one of its pings.
+  EXPECT_NE(-1, request.Find(
+      _T(" sessionid=\"{0D5B6A64-45A3-4E5C-BA44-1A1E0D9E8A6B}\"")));
+  int num_request_ids = 0;
+  for (size_t i = 0; i != arraysize(request_ids); ++i) {
+    num_request_ids += CountSubstrings(request, request_ids[i]);
+  }
+  EXPECT_EQ(1, num_request_ids);
+
+  EXPECT_EQ(3, CountSubstrings(request, _T("<app ")));
+  EXPECT_EQ(3, CountSubstrings(request, _T("<event ")));
+  EXPECT_EQ(3, CountSubstrings(request, _T(" requestage=\"")));
+  EXPECT_NE(-1, request.Find(_T("{00000000-0000-0000-0000-000000000001}")));
+  EXPECT_NE(-1, request.Find(_T("{00000000-0000-0000-0000-000000000002}")));
+  EXPECT_NE(-1, request.Find(_T("{00000000-0000-0000-0000-000000000003}")));
+  EXPECT_TRUE(PingServerStandIn::headers_[0].empty());
+
+  EXPECT_EQ(0, GetNumPersistedPings());
+}
+
+TEST_F(PingTest, SendPersistedPings_BatchFails) {
+  PersistPingString(_T("{0D5B6A64-45A3-4E5C-BA44-1A1E0D9E8A6B}"),
+                    _T("{00000000-0000-0000-0000-000000000001}"),
+                    100);
+  PersistPingString(_T("{0D5B6A64-45A3-4E5C-BA44-1A1E0D9E8A6B}"),
+                    _T("{00000000-0000-0000-0000-000000000002}"),
+                    200);
+
+  // Pings older than the expiry are deleted even if they are not sent.
+  PersistPingString(_T("{0D5B6A64-45A3-4E5C-BA44-1A1E0D9E8A6B}"),
+                    _T("{00000000-0000-0000-0000-000000000003}"),
+                    static_cast<int>(Ping::kPersistedPingExpiry100ns /
+                                     kSecsTo100ns) + 100);
+
+  PingServerStandIn::result_ = E_FAIL;
+  EXPECT_SUCCEEDED(Ping::SendPersistedPings(false,
+                                            &PingServerStandIn::SendString));
+
+  ASSERT_EQ(1, PingServerStandIn::requests_.size());
+  EXPECT_EQ(3, CountSubstrings(PingServerStandIn::requests_[0], _T("<app ")));
+  EXPECT_EQ(2, GetNumPersistedPings());
+
+  // The pings are sent again on the next attempt.
+  PingServerStandIn::Reset();
+  EXPECT_SUCCEEDED(Ping::SendPersistedPings(false,
+                                            &PingServerStandIn::SendString));
+  ASSERT_EQ(1, PingServerStandIn::requests_.size());
+  EXPECT_EQ(2, CountSubstrings(PingServerStandIn::requests_[0], _T("<app ")));
+  EXPECT_EQ(0, GetNumPersistedPings());
+}
+
+TEST_F(PingTest, SendPersistedPings_DifferentSessions) {
+  // Pings from different sessions are not batched together, nor are pings
+  // which differ by other request attributes.
+  PersistPingString(_T("{0D5B6A64-45A3-4E5C-BA44-1A1E0D9E8A6B}"),
+                    _T("{00000000-0000-0000-0000-000000000001}"),
+                    100);
+  PersistPingString(_T("{4A0F6D0C-64E4-4B4A-9D0B-2F5C2D6E7A11}"),
+                    _T("{00000000-0000-0000-0000-000000000002}"),
+                    200);
+  PersistString(_T("{A4E6B5D4-1B36-4A40-9C30-7B0F1C6F2E55}"),
+      _T("<?xml version=\"1.0\" encoding=\"UTF-8\"?>")
+      _T("<request protocol=\"3.0\" version=\"1.3.99.0\" ismachine=\"0\" ")
+      _T("sessionid=\"{0D5B6A64-45A3-4E5C-BA44-1A1E0D9E8A6B}\" ")
+      _T("installsource=\"ondemand\" ")
+      _T("requestid=\"{A4E6B5D4-1B36-4A40-9C30-7B0F1C6F2E55}\">")
+      _T("<os platform=\"win\" version=\"6.1\"/>")
+      _T("<app appid=\"{00000000-0000-0000-0000-000000000003}\" ")
+      _T("version=\"1.0.0.0\"><event eventtype=\"2\" eventresult=\"1\" ")
+      _T("errorcode=\"0\" extracode1=\"0\"/></app></request>"),
+      300);
+
+  EXPECT_SUCCEEDED(Ping::SendPersistedPings(false,
+                                            &PingServerStandIn::SendString));
+
+  ASSERT_EQ(3, PingServerStandIn::requests_.size());
+  for (size_t i = 0; i != PingServerStandIn::requests_.size(); ++i) {
+    EXPECT_EQ(1, CountSubstrings(PingServerStandIn::requests_[i],
+                                 _T("<app ")));
+  }
+  EXPECT_EQ(0, GetNumPersistedPings());
+}
+
+TEST_F(PingTest, SendPersistedPings_MaxPingsPerBatch) {
+  const int kNumPings = static_cast<int>(Ping::kMaxPersistedPingsPerBatch) + 1;
+  for (int i = 0; i != kNumPings; ++i) {
+    CString app_id;
+    SafeCStringFormat(&app_id, _T("{00000000-0000-0000-0000-%012d}"), i);
+    PersistPingString(_T("{0D5B6A64-45A3-4E5C-BA44-1A1E0D9E8A6B}"),
+                      app_id,
+                      i);
+  }
+
+  EXPECT_SUCCEEDED(Ping::SendPersistedPings(false,
+                                            &PingServerStandIn::SendString));
+
+  ASSERT_EQ(2, PingServerStandIn::requests_.size());
+  EXPECT_EQ(kNumPings,
+            CountSubstrings(PingServerStandIn::requests_[0], _T("<app ")) +
+            CountSubstrings(PingServerStandIn::requests_[1], _T("<app ")));
+  EXPECT_EQ(0, GetNumPersistedPings());
+}
+
+TEST_F(PingTest, SendPersistedPings_NotParsed) {
+  // A ping which can't be batched is sent as it was persisted, with its age
+  // in the request headers.
+  PersistString(_T("Test Key"), _T("Test Ping"), 100);
+
+  EXPECT_SUCCEEDED(Ping::SendPersistedPings(false,
+                                            &PingServerStandIn::SendString));
+
+  ASSERT_EQ(1, PingServerStandIn::requests_.size());
+  EXPECT_STREQ(_T("Test Ping"), PingServerStandIn::requests_[0]);
+  ASSERT_EQ(1, PingServerStandIn::headers_[0].size());
+  EXPECT_STREQ(kHeaderXRequestAge, PingServerStandIn::headers_[0][0].first);
+  EXPECT_LE(100, _ttoi(PingServerStandIn::headers_[0][0].second));
+  EXPECT_EQ(0, GetNumPersistedPings());
+}
+
 // The tests below rely on the out-of-process mechanism to send install pings.
 // Enable the test to debug the sending code.
 TEST_F(PingTest, DISABLED_SendUsingGoogleUpdate) {
@@ -48,6 +48,7 @@ using stats_report::kCountsKeyName;
 using stats_report::kTimingsKeyName;
 using stats_report::kIntegersKeyName;
 using stats_report::kBooleansKeyName;
+using stats_report::kHistogramsKeyName;
 using stats_report::kStatsKeyFormatString;
 using stats_report::kLastTransmissionTimeValueName;
 
@@ -83,6 +84,10 @@ HRESULT ResetPersistentMetrics(RegKey* key) {
   if (FAILED(hr)) {
     result = hr;
   }
+  hr = key->DeleteSubKey(kHistogramsKeyName);
+  if (FAILED(hr)) {
+    result = hr;
+  }
   return result;
 }
 
@@ -153,6 +153,11 @@ HRESULT UpdateRequest::Serialize(CString* buffer) const {
   return XmlParser::SerializeRequest(*this, buffer);
 }
 
+HRESULT UpdateRequest::Serialize(CStringA* utf8_buffer) const {
+  ASSERT1(utf8_buffer);
+  return XmlParser::SerializeRequest(*this, utf8_buffer);
+}
+
 bool UpdateRequest::IsEmpty() const {
   return request_.apps.empty();
 }
@@ -51,6 +51,9 @@ class UpdateRequest {
   // Serializes the request into a buffer.
   HRESULT Serialize(CString* buffer) const;
 
+  // Serializes the request into a UTF-8 buffer, reusing its memory.
+  HRESULT Serialize(CStringA* utf8_buffer) const;
+
   // Returns true if one of the applications in the request carries a
   // trusted tester token.
   bool has_tt_token() const;
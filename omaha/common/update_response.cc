@@ -46,6 +46,10 @@ HRESULT UpdateResponse::DeserializeFromFile(const CString& filename) {
   return Deserialize(buffer);
 }
 
+void UpdateResponse::CopyFrom(const UpdateResponse& other) {
+  response_ = other.response_;
+}
+
 int UpdateResponse::GetElapsedSecondsSinceDayStart() const {
   return response_.day_start.elapsed_seconds;
 }
@@ -42,6 +42,9 @@ class UpdateResponse {
   // Initializes an update response from a xml document in a file.
   HRESULT DeserializeFromFile(const CString& filename);
 
+  // Replaces the response with a copy of |other|.
+  void CopyFrom(const UpdateResponse& other);
+
   int GetElapsedSecondsSinceDayStart() const;
 
   int GetElapsedDaysSinceDatum() const;
@@ -117,14 +117,16 @@ HRESULT WebServicesClient::Send(bool is_foreground,
     return GOOPDATE_E_CANNOT_USE_NETWORK;
   }
 
-  CString request_string;
-  HRESULT hr = update_request->Serialize(&request_string);
+  // The request is serialized to UTF-8 directly, since that is the encoding
+  // it is sent in.
+  CStringA utf8_request_string;
+  HRESULT hr = update_request->Serialize(&utf8_request_string);
   if (FAILED(hr)) {
     CORE_LOG(LE, (_T("[Serialize failed][0x%x]"), hr));
     return hr;
   }
 
-  ASSERT1(!request_string.IsEmpty());
+  ASSERT1(!utf8_request_string.IsEmpty());
 
   __mutexBlock(lock_) {
     update_request_headers_.clear();
@@ -139,7 +141,7 @@ HRESULT WebServicesClient::Send(bool is_foreground,
 
   return SendStringWithFallback(use_encryption,
                                 is_foreground,
-                                &request_string,
+                                utf8_request_string,
                                 update_response);
 }
 
@@ -156,18 +158,17 @@ HRESULT WebServicesClient::SendString(bool is_foreground,
 
   return SendStringWithFallback(false,
                                 is_foreground,
-                                request_string,
+                                WideToUtf8(*request_string),
                                 update_response);
 }
 
 HRESULT WebServicesClient::SendStringWithFallback(
     bool use_encryption,
     bool is_foreground,
-    const CString* request_string,
+    const CStringA& utf8_request_string,
     xml::UpdateResponse* update_response) {
   CORE_LOG(L3, (_T("[WebServicesClient::SendStringWithFallback]")));
 
-  ASSERT1(request_string);
   ASSERT1(update_response);
 
   __mutexBlock(lock_) {
@@ -179,7 +180,6 @@ HRESULT WebServicesClient::SendStringWithFallback(
                          is_foreground ? _T("fg") : _T("bg")));
   }
 
-  const CStringA utf8_request_string(WideToUtf8(*request_string));
   CORE_LOG(L3, (_T("[sending web services request as UTF-8][%S]"),
       utf8_request_string));
 
@@ -143,7 +143,7 @@ class WebServicesClient : public WebServicesClientInterface {
   // error corresponding to the first request sent.
   HRESULT SendStringWithFallback(bool use_encryption,
                                  bool is_foreground,
-                                 const CString* request_string,
+                                 const CStringA& utf8_request_string,
                                  xml::UpdateResponse* update_response);
 
   // Sends a string representing a protocol message and returns a parsed
@@ -64,6 +64,7 @@ extern const TCHAR* const kAppId;
 extern const TCHAR* const kArch;
 extern const TCHAR* const kArguments;
 extern const TCHAR* const kAvx;
+extern const TCHAR* const kBaseHashSha256;
 extern const TCHAR* const kBrandCode;
 extern const TCHAR* const kBrowserType;
 extern const TCHAR* const kClientId;
@@ -92,6 +93,7 @@ extern const TCHAR* const kEventType;
 extern const TCHAR* const kExperiments;
 extern const TCHAR* const kExtraCode1;
 extern const TCHAR* const kHash;
+extern const TCHAR* const kHashDiffSha256;
 extern const TCHAR* const kHashSha256;
 extern const TCHAR* const kIndex;
 extern const TCHAR* const kInstallationId;
@@ -104,6 +106,7 @@ extern const TCHAR* const kIsMachine;
 extern const TCHAR* const kLang;
 extern const TCHAR* const kMinOSVersion;
 extern const TCHAR* const kName;
+extern const TCHAR* const kNameDiff;
 extern const TCHAR* const kNextVersion;
 extern const TCHAR* const kOriginURL;
 extern const TCHAR* const kParameter;
@@ -112,6 +115,7 @@ extern const TCHAR* const kPhysMemory;
 extern const TCHAR* const kPingFreshness;
 extern const TCHAR* const kPlatform;
 extern const TCHAR* const kProtocol;
+extern const TCHAR* const kRequestAge;
 extern const TCHAR* const kRequestId;
 extern const TCHAR* const kRequired;
 extern const TCHAR* const kRollbackAllowed;
@@ -121,6 +125,7 @@ extern const TCHAR* const kSessionId;
 extern const TCHAR* const kShellVersion;
 extern const TCHAR* const kSignature;
 extern const TCHAR* const kSize;
+extern const TCHAR* const kSizeDiff;
 extern const TCHAR* const kSourceUrlIndex;
 extern const TCHAR* const kSse;
 extern const TCHAR* const kSse2;
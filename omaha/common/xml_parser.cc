@@ -14,22 +14,23 @@
 // ========================================================================
 
 #include "omaha/common/xml_parser.h"
-#include <memory>
 #include <stdlib.h>
+#include <string>
 #include <vector>
 #include "base/basictypes.h"
 #include "omaha/base/constants.h"
 #include "omaha/base/error.h"
-#include "omaha/base/safe_format.h"
 #include "omaha/base/string.h"
 #include "omaha/base/utils.h"
-#include "omaha/base/xml_utils.h"
+#include "omaha/common/common_metrics.h"
 #include "omaha/common/config_manager.h"
 #include "omaha/common/const_group_policy.h"
 #include "omaha/common/goopdate_utils.h"
 #include "omaha/common/update_request.h"
 #include "omaha/common/update_response.h"
 #include "omaha/common/xml_const.h"
+#include "omaha/common/xml_pull_parser.h"
+#include "omaha/common/xml_writer.h"
 
 namespace omaha {
 
@@ -77,7 +78,7 @@ HRESULT ConvertStringToSuccessfulInstallAction(
   // Using the default action allows Omaha to be forward-compatible with
   // new SuccessActions, meaning older versions will not fail if a config
   // uses a new action.
-  ASSERT(false, (_T("[Unrecognized success action][%s]"), str));
+  CORE_LOG(LW, (_T("[Unrecognized success action][%s]"), str));
   *successful_install_action = SUCCESS_ACTION_DEFAULT;
   return S_OK;
 }
@@ -160,1137 +161,963 @@ CString ConvertProcessorArchitectureToString(DWORD arch) {
   }
 }
 
-// The ElementHandler classes should also be in an anonymous namespace but
-// the base class cannot be because it is used in the header file.
-
-// Defines the base class of a hierarchy that deals with validating and
-// parsing of a single node element in the dom. The implementation uses
-// the template method design pattern.
-class ElementHandler {
- public:
-  ElementHandler() {}
-  virtual ~ElementHandler() {}
-
-  HRESULT Handle(IXMLDOMNode* node, response::Response* response) {
-    ASSERT1(node);
-    ASSERT1(response);
+namespace {
 
-    HRESULT hr = Validate(node);
-    if (FAILED(hr)) {
-      return hr;
+// Returns true if the UTF-8 string |str| is the same as |name|, which only
+// has ASCII characters.
+bool EqualsAscii(const std::string& str, const TCHAR* name) {
+  size_t i = 0;
+  for (; i != str.size(); ++i) {
+    if (!name[i] || static_cast<uint8>(str[i]) != name[i]) {
+      return false;
     }
+  }
+  return !name[i];
+}
 
-    hr = Parse(node, response);
-    if (FAILED(hr)) {
-      return hr;
-    }
+CString Utf8ToCString(const std::string& str) {
+  return Utf8ToWideChar(str.data(), static_cast<uint32>(str.size()));
+}
 
-    return S_OK;
-  }
+// Provides the handlers with the attributes of an element and, for the
+// elements which have a value, with the text inside the element. The accessors
+// behave like their counterparts in xml_utils.h.
+class Element {
+ public:
+  Element(const XmlPullParser::Attribute* attributes,
+          size_t num_attributes,
+          const std::string& text,
+          bool has_child_elements)
+      : attributes_(attributes),
+        num_attributes_(num_attributes),
+        text_(text),
+        has_child_elements_(has_child_elements) {}
 
- private:
-  // Validates a node and returns S_OK in case of success.
-  virtual HRESULT Validate(IXMLDOMNode* node) {
-    UNREFERENCED_PARAMETER(node);
-    return S_OK;
+  bool HasAttribute(const TCHAR* name) const {
+    return FindAttribute(name) != NULL;
   }
 
-  // Parses the node and stores its values in the response.
-  virtual HRESULT Parse(IXMLDOMNode* node, response::Response* response) {
-    UNREFERENCED_PARAMETER(node);
-    UNREFERENCED_PARAMETER(response);
+  HRESULT ReadStringAttribute(const TCHAR* name, CString* value) const {
+    ASSERT1(value);
+
+    const XmlPullParser::Attribute* attribute = FindAttribute(name);
+    if (!attribute) {
+      return E_FAIL;
+    }
+    *value = Utf8ToCString(attribute->value);
     return S_OK;
   }
 
-  DISALLOW_COPY_AND_ASSIGN(ElementHandler);
-};
-
-
-// Parses 'response'.
-class ResponseElementHandler : public ElementHandler {
- public:
-  static ElementHandler* Create() { return new ResponseElementHandler; }
+  HRESULT ReadBooleanAttribute(const TCHAR* name, bool* value) const {
+    ASSERT1(value);
 
- private:
-  virtual HRESULT Parse(IXMLDOMNode* node, response::Response* response) {
-    HRESULT hr = ReadStringAttribute(node,
-                                     xml::attribute::kProtocol,
-                                     &response->protocol);
+    CString str;
+    HRESULT hr = ReadStringAttribute(name, &str);
     if (FAILED(hr)) {
       return hr;
     }
-    hr = VerifyProtocolCompatibility(response->protocol, xml::value::kVersion3);
-    if (FAILED(hr)) {
-      return hr;
-    }
-
-    return S_OK;
+    return String_StringToBool(str, value);
   }
-};
 
-// Parses 'app'.
-class AppElementHandler : public ElementHandler {
- public:
-  static ElementHandler* Create() { return new AppElementHandler; }
+  HRESULT ReadIntAttribute(const TCHAR* name, int* value) const {
+    ASSERT1(value);
 
- private:
-  virtual HRESULT Parse(IXMLDOMNode* node, response::Response* response) {
-    response::App app;
-
-    HRESULT hr = ReadStringAttribute(node, xml::attribute::kAppId, &app.appid);
+    CString str;
+    HRESULT hr = ReadStringAttribute(name, &str);
     if (FAILED(hr)) {
       return hr;
     }
-
-    hr = ReadStringAttribute(node, xml::attribute::kStatus, &app.status);
-    if (FAILED(hr)) {
-      return hr;
+    if (!String_StringToDecimalIntChecked(str, value)) {
+      return GOOPDATEXML_E_STRTOUINT;
     }
+    return S_OK;
+  }
 
-    // At present, the server may omit the following optional attributes if the
-    // contents would be empty strings.  Guard these reads appropriately.
-    // TODO(omaha3): If we adapt the server to send an empty string for these
-    // attributes, we can remove these checks.
-    if (HasAttribute(node, xml::attribute::kExperiments)) {
-      hr = ReadStringAttribute(node,
-                               xml::attribute::kExperiments,
-                               &app.experiments);
-      if (FAILED(hr)) {
-        return hr;
-      }
-    }
+  HRESULT ReadUint64Attribute(const TCHAR* name, uint64* value) const {
+    ASSERT1(value);
 
-    hr = ReadCohortAttributes(node, &app);
+    CString str;
+    HRESULT hr = ReadStringAttribute(name, &str);
     if (FAILED(hr)) {
       return hr;
     }
-
-    response->apps.push_back(app);
+    if (!String_StringToDecimalUint64Checked(str, value)) {
+      return GOOPDATEXML_E_STRTOUINT;
+    }
     return S_OK;
   }
 
-  HRESULT ReadCohortAttributes(IXMLDOMNode* node, response::App* app) {
-    ASSERT1(node);
-    ASSERT1(app);
+  // Reads the text inside the element, which must not contain elements.
+  HRESULT ReadStringValue(CString* value) const {
+    ASSERT1(value);
 
-    if (HasAttribute(node, xml::attribute::kCohort)) {
-      HRESULT hr = ReadStringAttribute(node,
-                                       xml::attribute::kCohort,
-                                       &app->cohort);
-      if (FAILED(hr)) {
-        return hr;
-      }
+    if (has_child_elements_) {
+      return E_INVALIDARG;
     }
-
-    if (HasAttribute(node, xml::attribute::kCohortHint)) {
-      HRESULT hr = ReadStringAttribute(node,
-                                       xml::attribute::kCohortHint,
-                                       &app->cohort_hint);
-      if (FAILED(hr)) {
-        return hr;
-      }
-    }
-
-    if (HasAttribute(node, xml::attribute::kCohortName)) {
-      HRESULT hr = ReadStringAttribute(node,
-                                       xml::attribute::kCohortName,
-                                       &app->cohort_name);
-      if (FAILED(hr)) {
-        return hr;
-      }
+    if (text_.empty()) {
+      return E_FAIL;
     }
-
+    *value = Utf8ToCString(text_);
     return S_OK;
   }
-};
-
-
-// Parses 'updatecheck'.
-class UpdateCheckElementHandler : public ElementHandler {
- public:
-  static ElementHandler* Create() { return new UpdateCheckElementHandler; }
 
  private:
-  virtual HRESULT Parse(IXMLDOMNode* node, response::Response* response) {
-    response::UpdateCheck& update_check = response->apps.back().update_check;
-
-    ReadStringAttribute(node,
-                        xml::attribute::kTTToken,
-                        &update_check.tt_token);
+  const XmlPullParser::Attribute* FindAttribute(const TCHAR* name) const {
+    ASSERT1(name);
 
-    ReadStringAttribute(node,
-                        xml::attribute::kErrorUrl,
-                        &update_check.error_url);
-
-    return ReadStringAttribute(node,
-                               xml::attribute::kStatus,
-                               &update_check.status);
+    for (size_t i = 0; i != num_attributes_; ++i) {
+      if (EqualsAscii(attributes_[i].name, name)) {
+        return &attributes_[i];
+      }
+    }
+    return NULL;
   }
-};
 
+  const XmlPullParser::Attribute* const attributes_;
+  const size_t num_attributes_;
+  const std::string& text_;
+  const bool has_child_elements_;
 
-// Parses 'urls'.
-class UrlsElementHandler : public ElementHandler {
- public:
-  static ElementHandler* Create() { return new UrlsElementHandler; }
+  DISALLOW_COPY_AND_ASSIGN(Element);
 };
 
+// Parses an element and stores its values in the response.
+typedef HRESULT (*ElementHandler)(const Element& element,
+                                  response::Response* response);
 
-// Parses 'url'.
-class UrlElementHandler : public ElementHandler {
- public:
-  static ElementHandler* Create() { return new UrlElementHandler; }
+struct ElementHandlerEntry {
+  const TCHAR* name;
+  ElementHandler handler;
 
- private:
-  virtual HRESULT Parse(IXMLDOMNode* node, response::Response* response) {
-    CString url;
-    HRESULT hr = ReadStringAttribute(node, xml::attribute::kCodebase, &url);
-    if (FAILED(hr)) {
-      return hr;
-    }
-
-    response::UpdateCheck& update_check = response->apps.back().update_check;
-    update_check.urls.push_back(url);
+  // True if the element belongs to the last 'app' parsed.
+  bool is_app_child;
 
-    return S_OK;
-  }
+  // True if the handler needs the text inside the element, in which case the
+  // handler runs once the end of the element is parsed.
+  bool has_value;
 };
 
-
-// Parses 'manifest'.
-class ManifestElementHandler : public ElementHandler {
- public:
-  static ElementHandler* Create() { return new ManifestElementHandler; }
-
- private:
-  virtual HRESULT Parse(IXMLDOMNode* node, response::Response* response) {
-    InstallManifest& install_manifest =
-        response->apps.back().update_check.install_manifest;
-    ReadStringAttribute(node,
-                        xml::attribute::kVersion,
-                        &install_manifest.version);
-    return S_OK;
+// Parses 'response'.
+HRESULT HandleResponse(const Element& element, response::Response* response) {
+  HRESULT hr = element.ReadStringAttribute(xml::attribute::kProtocol,
+                                           &response->protocol);
+  if (FAILED(hr)) {
+    return hr;
+  }
+  hr = VerifyProtocolCompatibility(response->protocol, xml::value::kVersion3);
+  if (FAILED(hr)) {
+    return hr;
   }
-};
-
-
-// Parses 'packages'.
-class PackagesElementHandler : public ElementHandler {
- public:
-  static ElementHandler* Create() { return new PackagesElementHandler; }
-};
-
-
 
-// Parses 'package'.
-class PackageElementHandler : public ElementHandler {
- public:
-  static ElementHandler* Create() { return new PackageElementHandler; }
+  return S_OK;
+}
 
- private:
-  virtual HRESULT Parse(IXMLDOMNode* node, response::Response* response) {
-    InstallPackage install_package;
+HRESULT ReadCohortAttributes(const Element& element, response::App* app) {
+  ASSERT1(app);
 
-    HRESULT hr = ReadStringAttribute(node,
-                                     xml::attribute::kName,
-                                     &install_package.name);
+  if (element.HasAttribute(xml::attribute::kCohort)) {
+    HRESULT hr = element.ReadStringAttribute(xml::attribute::kCohort,
+                                             &app->cohort);
     if (FAILED(hr)) {
       return hr;
     }
+  }
 
-    install_package.is_required = true;
-    hr = ReadBooleanAttribute(node,
-                              xml::attribute::kRequired,
-                              &install_package.is_required);
+  if (element.HasAttribute(xml::attribute::kCohortHint)) {
+    HRESULT hr = element.ReadStringAttribute(xml::attribute::kCohortHint,
+                                             &app->cohort_hint);
     if (FAILED(hr)) {
       return hr;
     }
+  }
 
-    hr = ReadIntAttribute(node, xml::attribute::kSize, &install_package.size);
+  if (element.HasAttribute(xml::attribute::kCohortName)) {
+    HRESULT hr = element.ReadStringAttribute(xml::attribute::kCohortName,
+                                             &app->cohort_name);
     if (FAILED(hr)) {
       return hr;
     }
-
-    hr = ReadStringAttribute(node,
-                             xml::attribute::kHashSha256,
-                             &install_package.hash_sha256);
-    HRESULT hr2 = ReadStringAttribute(node,
-                                      xml::attribute::kHash,
-                                      &install_package.hash_sha1);
-    if (FAILED(hr) && FAILED(hr2)) {
-      return hr;
-    }
-
-    InstallManifest& install_manifest =
-        response->apps.back().update_check.install_manifest;
-    install_manifest.packages.push_back(install_package);
-
-    return S_OK;
   }
-};
 
-// Parses 'actions'.
-class ActionsElementHandler : public ElementHandler {
- public:
-  static ElementHandler* Create() { return new ActionsElementHandler; }
-};
+  return S_OK;
+}
 
+// Parses 'app'.
+HRESULT HandleApp(const Element& element, response::Response* response) {
+  response::App app;
 
-// Parses 'action'.
-class ActionElementHandler : public ElementHandler {
- public:
-  static ElementHandler* Create() { return new ActionElementHandler; }
+  HRESULT hr = element.ReadStringAttribute(xml::attribute::kAppId,
+                                           &app.appid);
+  if (FAILED(hr)) {
+    return hr;
+  }
 
- private:
-  virtual HRESULT Parse(IXMLDOMNode* node, response::Response* response) {
-    InstallAction install_action;
+  hr = element.ReadStringAttribute(xml::attribute::kStatus, &app.status);
+  if (FAILED(hr)) {
+    return hr;
+  }
 
-    CString event;
-    HRESULT hr = ReadStringAttribute(node, xml::attribute::kEvent, &event);
+  // At present, the server may omit the following optional attributes if the
+  // contents would be empty strings.  Guard these reads appropriately.
+  // TODO(omaha3): If we adapt the server to send an empty string for these
+  // attributes, we can remove these checks.
+  if (element.HasAttribute(xml::attribute::kExperiments)) {
+    hr = element.ReadStringAttribute(xml::attribute::kExperiments,
+                                     &app.experiments);
     if (FAILED(hr)) {
       return hr;
     }
-    hr = ConvertStringToInstallEvent(event, &install_action.install_event);
-    if (FAILED(hr)) {
-      return hr;
-    }
-
-    ReadStringAttribute(node,
-                        xml::attribute::kRun,
-                        &install_action.program_to_run);
-    ReadStringAttribute(node,
-                        xml::attribute::kArguments,
-                        &install_action.program_arguments);
-
-    ReadStringAttribute(node,
-                        xml::attribute::kSuccessUrl,
-                        &install_action.success_url);
-
-    ReadBooleanAttribute(node,
-                         xml::attribute::kTerminateAllBrowsers,
-                         &install_action.terminate_all_browsers);
-
-    CString success_action;
-    ReadStringAttribute(node,
-                        xml::attribute::kSuccessAction,
-                        &success_action);
-    ConvertStringToSuccessfulInstallAction(success_action,
-                                           &install_action.success_action);
-
-    InstallManifest& install_manifest =
-        response->apps.back().update_check.install_manifest;
-    install_manifest.install_actions.push_back(install_action);
+  }
 
-    return S_OK;
+  hr = ReadCohortAttributes(element, &app);
+  if (FAILED(hr)) {
+    return hr;
   }
-};
 
+  response->apps.push_back(app);
+  return S_OK;
+}
 
-// Parses 'data'.
-class DataElementHandler : public ElementHandler {
- public:
-  static ElementHandler* Create() { return new DataElementHandler; }
+// Parses 'updatecheck'.
+HRESULT HandleUpdateCheck(const Element& element,
+                          response::Response* response) {
+  response::UpdateCheck& update_check = response->apps.back().update_check;
 
- private:
-  virtual HRESULT Parse(IXMLDOMNode* node, response::Response* response) {
-    response->apps.back().data.push_back(response::Data());
-    response::Data& data = response->apps.back().data.back();
+  element.ReadStringAttribute(xml::attribute::kTTToken,
+                              &update_check.tt_token);
 
-    HRESULT hr = ReadStringAttribute(node,
-                                     xml::attribute::kStatus,
-                                     &data.status);
-    if (FAILED(hr)) {
-      return hr;
-    }
+  element.ReadStringAttribute(xml::attribute::kErrorUrl,
+                              &update_check.error_url);
 
-    CString& data_name = data.name;
-    hr = ReadStringAttribute(node, xml::attribute::kName, &data_name);
-    if (FAILED(hr)) {
-      return hr;
-    }
+  return element.ReadStringAttribute(xml::attribute::kStatus,
+                                     &update_check.status);
+}
 
-    if (data_name == xml::value::kInstallData) {
-      hr = ReadStringAttribute(node,
-                               xml::attribute::kIndex,
-                               &data.install_data_index);
-      if (FAILED(hr)) {
-        return hr;
-      }
-      if (data.status == xml::response::kStatusOkValue) {
-        return ReadStringValue(node, &data.install_data);
-      }
-      return S_OK;
-    } else if (data_name == xml::value::kUntrusted) {
-      return S_OK;
-    }
+// Parses 'urls', 'packages', and 'actions', which only contain elements.
+HRESULT HandleContainer(const Element& element, response::Response* response) {
+  UNREFERENCED_PARAMETER(element);
+  UNREFERENCED_PARAMETER(response);
+  return S_OK;
+}
 
-    ASSERT(false, (data_name));
-    return E_UNEXPECTED;
+// Parses 'url'.
+HRESULT HandleUrl(const Element& element, response::Response* response) {
+  CString url;
+  HRESULT hr = element.ReadStringAttribute(xml::attribute::kCodebase, &url);
+  if (FAILED(hr)) {
+    return hr;
   }
-};
 
-// Parses 'ping'.
-class PingElementHandler : public ElementHandler {
- public:
-  static ElementHandler* Create() { return new PingElementHandler; }
+  response::UpdateCheck& update_check = response->apps.back().update_check;
+  update_check.urls.push_back(url);
 
- private:
-  virtual HRESULT Parse(IXMLDOMNode* node, response::Response* response) {
-    response::Ping& ping = response->apps.back().ping;
-    ReadStringAttribute(node, xml::attribute::kStatus, &ping.status);
-    ASSERT1(ping.status == xml::response::kStatusOkValue);
-    return S_OK;
-  }
-};
+  return S_OK;
+}
 
-// Parses 'event'.
-class EventElementHandler : public ElementHandler {
- public:
-  static ElementHandler* Create() { return new EventElementHandler; }
+// Parses 'manifest'.
+HRESULT HandleManifest(const Element& element, response::Response* response) {
+  InstallManifest& install_manifest =
+      response->apps.back().update_check.install_manifest;
+  element.ReadStringAttribute(xml::attribute::kVersion,
+                              &install_manifest.version);
+  return S_OK;
+}
 
- private:
-  virtual HRESULT Parse(IXMLDOMNode* node, response::Response* response) {
-    response::Event event;
-    ReadStringAttribute(node, xml::attribute::kStatus, &event.status);
-    ASSERT1(event.status == xml::response::kStatusOkValue);
-    response::App& app = response->apps.back();
-    app.events.push_back(event);
-    return S_OK;
-  }
-};
+// Parses the optional attributes of the differential package of 'package'.
+// The differential package is only used if all of them are present and
+// valid. Otherwise, it is ignored and the full package is downloaded.
+void ReadDifferentialPackage(const Element& element,
+                             InstallPackage* install_package) {
+  ASSERT1(install_package);
+
+  CString name_diff;
+  if (FAILED(element.ReadStringAttribute(xml::attribute::kNameDiff,
+                                         &name_diff))) {
+    return;
+  }
+
+  uint64 size_diff = 0;
+  CString hash_diff_sha256;
+  CString base_hash_sha256;
+  if (name_diff.IsEmpty() ||
+      FAILED(element.ReadUint64Attribute(xml::attribute::kSizeDiff,
+                                         &size_diff)) ||
+      FAILED(element.ReadStringAttribute(xml::attribute::kHashDiffSha256,
+                                         &hash_diff_sha256)) ||
+      FAILED(element.ReadStringAttribute(xml::attribute::kBaseHashSha256,
+                                         &base_hash_sha256)) ||
+      hash_diff_sha256.IsEmpty() ||
+      base_hash_sha256.IsEmpty()) {
+    CORE_LOG(LW, (_T("[invalid differential package ignored][%s]"),
+                  name_diff));
+    return;
+  }
+
+  install_package->name_diff = name_diff;
+  install_package->size_diff = size_diff;
+  install_package->hash_diff_sha256 = hash_diff_sha256;
+  install_package->base_hash_sha256 = base_hash_sha256;
+}
 
-// Parses 'daystart'.
-class DayStartElementHandler : public ElementHandler {
- public:
-  static ElementHandler* Create() { return new DayStartElementHandler; }
+// Parses 'package'.
+HRESULT HandlePackage(const Element& element, response::Response* response) {
+  InstallPackage install_package;
 
- private:
-  virtual HRESULT Parse(IXMLDOMNode* node, response::Response* response) {
-    ReadIntAttribute(node,
-                     xml::attribute::kElapsedSeconds,
-                     &response->day_start.elapsed_seconds);
-
-    HRESULT hr = ReadIntAttribute(node,
-                                  xml::attribute::kElapsedDays,
-                                  &response->day_start.elapsed_days);
-    if (FAILED(hr)) {
-      CORE_LOG(LW, (_T("[DayStartElementHandler][hr=%#x]"), hr));
-      return hr;
-    }
-    ASSERT1(response->day_start.elapsed_days >= kMinDaysSinceDatum);
-    ASSERT1(response->day_start.elapsed_days <= kMaxDaysSinceDatum);
-    return S_OK;
+  HRESULT hr = element.ReadStringAttribute(xml::attribute::kName,
+                                           &install_package.name);
+  if (FAILED(hr)) {
+    return hr;
   }
-};
 
-// Parses 'systemrequirements'.
-class SystemRequirementsElementHandler : public ElementHandler {
- public:
-  static ElementHandler* Create() {
-    return new SystemRequirementsElementHandler;
+  install_package.is_required = true;
+  hr = element.ReadBooleanAttribute(xml::attribute::kRequired,
+                                    &install_package.is_required);
+  if (FAILED(hr)) {
+    return hr;
   }
 
- private:
-  virtual HRESULT Parse(IXMLDOMNode* node, response::Response* response) {
-    response::SystemRequirements& sys_req = response->sys_req;
-
-    HRESULT hr = ReadStringAttribute(node,
-                                     xml::attribute::kPlatform,
-                                     &sys_req.platform);
-    if (FAILED(hr)) {
-      return hr;
-    }
-
-    hr = ReadStringAttribute(node,
-                             xml::attribute::kArch,
-                             &sys_req.arch);
-    if (FAILED(hr)) {
-      return hr;
-    }
-
-    return ReadStringAttribute(node,
-                               xml::attribute::kMinOSVersion,
-                               &sys_req.min_os_version);
+  hr = element.ReadUint64Attribute(xml::attribute::kSize,
+                                   &install_package.size);
+  if (FAILED(hr)) {
+    return hr;
   }
-};
-
-namespace v2 {
-
-namespace element {
-
-const TCHAR* const kGUpdate = _T("gupdate");
-
-}  // namespace element
-
-namespace attributev2 {
-
-// Some v2 offline manifests were incorrectly authored as 'Version' with a
-// capital 'V'.
-const TCHAR* const kVersionProperCased = _T("Version");
 
-}  // namespace attributev2
+  hr = element.ReadStringAttribute(xml::attribute::kHashSha256,
+                                   &install_package.hash_sha256);
+  HRESULT hr2 = element.ReadStringAttribute(xml::attribute::kHash,
+                                            &install_package.hash_sha1);
+  if (FAILED(hr) && FAILED(hr2)) {
+    return hr;
+  }
 
-namespace value {
+  ReadDifferentialPackage(element, &install_package);
 
-const TCHAR* const kVersion2 = _T("2.0");
+  InstallManifest& install_manifest =
+      response->apps.back().update_check.install_manifest;
+  install_manifest.packages.push_back(install_package);
 
-}  // namespace value
+  return S_OK;
+}
 
-// Parses Omaha v2 'gupdate'.
-class GUpdateElementHandler : public ElementHandler {
- public:
-  static ElementHandler* Create() { return new GUpdateElementHandler; }
+// Parses 'action'.
+HRESULT HandleAction(const Element& element, response::Response* response) {
+  InstallAction install_action;
 
- private:
-  virtual HRESULT Parse(IXMLDOMNode* node, response::Response* response) {
-    HRESULT hr = ReadStringAttribute(node,
-                                     xml::attribute::kProtocol,
-                                     &response->protocol);
-    if (FAILED(hr)) {
-      return hr;
-    }
-    return VerifyProtocolCompatibility(response->protocol,
-                                       value::kVersion2);
+  CString event;
+  HRESULT hr = element.ReadStringAttribute(xml::attribute::kEvent, &event);
+  if (FAILED(hr)) {
+    return hr;
+  }
+  hr = ConvertStringToInstallEvent(event, &install_action.install_event);
+  if (FAILED(hr)) {
+    return hr;
   }
-};
 
-// Parses Omaha v2 'updatecheck'.
-class UpdateCheckElementHandler : public ElementHandler {
- public:
-  static ElementHandler* Create() { return new UpdateCheckElementHandler; }
+  element.ReadStringAttribute(xml::attribute::kRun,
+                              &install_action.program_to_run);
+  element.ReadStringAttribute(xml::attribute::kArguments,
+                              &install_action.program_arguments);
 
- private:
-  virtual HRESULT Parse(IXMLDOMNode* node, response::Response* response) {
-    response::UpdateCheck& update_check = response->apps.back().update_check;
+  element.ReadStringAttribute(xml::attribute::kSuccessUrl,
+                              &install_action.success_url);
 
-    HRESULT hr = ReadStringAttribute(node,
-                                     xml::attribute::kStatus,
-                                     &update_check.status);
-    if (FAILED(hr)) {
-      return hr;
-    }
+  element.ReadBooleanAttribute(xml::attribute::kTerminateAllBrowsers,
+                               &install_action.terminate_all_browsers);
 
-    if (update_check.status.CompareNoCase(xml::response::kStatusOkValue)) {
-      return S_OK;
-    }
+  CString success_action;
+  element.ReadStringAttribute(xml::attribute::kSuccessAction,
+                              &success_action);
+  ConvertStringToSuccessfulInstallAction(success_action,
+                                         &install_action.success_action);
 
-    InstallManifest& install_manifest = update_check.install_manifest;
-    if (FAILED(ReadStringAttribute(node,
-                                   xml::attribute::kVersion,
-                                   &install_manifest.version))) {
-      ReadStringAttribute(node,
-                          v2::attributev2::kVersionProperCased,
-                          &install_manifest.version);
-    }
+  InstallManifest& install_manifest =
+      response->apps.back().update_check.install_manifest;
+  install_manifest.install_actions.push_back(install_action);
 
-    CString url;
-    hr = ReadStringAttribute(node, xml::attribute::kCodebase, &url);
-    if (FAILED(hr)) {
-      return hr;
-    }
+  return S_OK;
+}
 
-    int start_file_name_idx = url.ReverseFind(_T('/'));
-    if (start_file_name_idx <= 0) {
-      return GOOPDATEDOWNLOAD_E_INVALID_PATH;
-    }
-    CString base_url = url.Left(start_file_name_idx + 1);
-    update_check.urls.push_back(base_url);
+// Parses 'data'.
+HRESULT HandleData(const Element& element, response::Response* response) {
+  response->apps.back().data.push_back(response::Data());
+  response::Data& data = response->apps.back().data.back();
 
-    CString package_name = url.Right(url.GetLength() - start_file_name_idx - 1);
-    if (package_name.IsEmpty()) {
-      return GOOPDATEDOWNLOAD_E_FILE_NAME_EMPTY;
-    }
+  HRESULT hr = element.ReadStringAttribute(xml::attribute::kStatus,
+                                           &data.status);
+  if (FAILED(hr)) {
+    return hr;
+  }
 
-    InstallPackage install_package;
-    install_package.name = package_name;
-    install_package.is_required = true;
-    hr = ReadIntAttribute(node, xml::attribute::kSize, &install_package.size);
-    if (FAILED(hr)) {
-      return hr;
-    }
-    hr = ReadStringAttribute(node,
-                             xml::attribute::kHash,
-                             &install_package.hash_sha1);
+  CString& data_name = data.name;
+  hr = element.ReadStringAttribute(xml::attribute::kName, &data_name);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  if (data_name == xml::value::kInstallData) {
+    hr = element.ReadStringAttribute(xml::attribute::kIndex,
+                                     &data.install_data_index);
     if (FAILED(hr)) {
       return hr;
     }
-
-    install_manifest.packages.push_back(install_package);
-
-    InstallAction install_action;
-    install_action.install_event = InstallAction::kInstall;
-    install_action.program_to_run = package_name;
-    ReadStringAttribute(node,
-                        xml::attribute::kArguments,
-                        &install_action.program_arguments);
-
-    install_manifest.install_actions.push_back(install_action);
-
-    InstallAction post_install_action;
-    if (SUCCEEDED(ParsePostInstallActions(node, &post_install_action))) {
-      install_manifest.install_actions.push_back(post_install_action);
+    if (data.status == xml::response::kStatusOkValue) {
+      return element.ReadStringValue(&data.install_data);
     }
-
     return S_OK;
-  }
-
-  HRESULT ParsePostInstallActions(IXMLDOMNode* node,
-                                  InstallAction* post_install_action) {
-    InstallAction install_action;
-    CString success_action;
-    if (FAILED(ReadStringAttribute(node,
-                                   xml::attribute::kSuccessAction,
-                                   &success_action)) &&
-        FAILED(ReadStringAttribute(node,
-                                   xml::attribute::kSuccessUrl,
-                                   &install_action.success_url)) &&
-        FAILED(ReadBooleanAttribute(node,
-                                    xml::attribute::kTerminateAllBrowsers,
-                                    &install_action.terminate_all_browsers))) {
-      return HRESULT_FROM_WIN32(ERROR_NOT_FOUND);
-    }
-
-    install_action.install_event = InstallAction::kPostInstall;
-    ReadStringAttribute(node, xml::attribute::kSuccessAction, &success_action);
-    ConvertStringToSuccessfulInstallAction(success_action,
-                                           &install_action.success_action);
-    ReadStringAttribute(node,
-                        xml::attribute::kSuccessUrl,
-                        &install_action.success_url);
-    ReadBooleanAttribute(node,
-                         xml::attribute::kTerminateAllBrowsers,
-                         &install_action.terminate_all_browsers);
-    *post_install_action = install_action;
+  } else if (data_name == xml::value::kUntrusted) {
     return S_OK;
   }
-};
-
-}  // namespace v2
-
-XmlParser::XmlParser() {}
-
-void XmlParser::InitializeElementHandlers() {
-  const Tuple<const TCHAR*, ElementHandler* (*)()> tuples[] = {
-    {xml::element::kAction, &ActionElementHandler::Create},
-    {xml::element::kActions, &ActionsElementHandler::Create},
-    {xml::element::kApp, &AppElementHandler::Create},
-    {xml::element::kData, &DataElementHandler::Create},
-    {xml::element::kDayStart, &DayStartElementHandler::Create},
-    {xml::element::kSystemRequirements,
-        &SystemRequirementsElementHandler::Create},
-    {xml::element::kEvent, &EventElementHandler::Create},
-    {xml::element::kManifest, &ManifestElementHandler::Create},
-    {xml::element::kPackage, &PackageElementHandler::Create},
-    {xml::element::kPackages, &PackagesElementHandler::Create},
-    {xml::element::kPing, &PingElementHandler::Create},
-    {xml::element::kResponse, &ResponseElementHandler::Create},
-    {xml::element::kUpdateCheck, &UpdateCheckElementHandler::Create},
-    {xml::element::kUrl, &UrlElementHandler::Create},
-    {xml::element::kUrls, &UrlsElementHandler::Create},
-  };
 
-  for (size_t i = 0; i != arraysize(tuples); ++i) {
-    VERIFY1(element_handler_factory_.Register(tuples[i].first,
-                                              tuples[i].second));
-  }
+  CORE_LOG(LE, (_T("[HandleData][unknown data name][%s]"), data_name));
+  return GOOPDATEXML_E_PARSE_ERROR;
 }
 
-// The AppElementHandler and the DataElementHandler are shared, because the
-// format is identical between Omaha v2 and Omaha v3. We should make copies of
-// the shared classes if these elements diverge between v2 and v3. The worst
-// case scenario is that we break v2 compatibility if we do not do a
-// copy-on-write, which might be acceptable.
-void XmlParser::InitializeLegacyElementHandlers() {
-  const Tuple<const TCHAR*, ElementHandler* (*)()> tuples[] = {
-    {xml::element::kApp, &AppElementHandler::Create},
-    {xml::element::kData, &DataElementHandler::Create},
-    {v2::element::kGUpdate, &v2::GUpdateElementHandler::Create},
-    {xml::element::kUpdateCheck, &v2::UpdateCheckElementHandler::Create},
-  };
-
-  for (size_t i = 0; i != arraysize(tuples); ++i) {
-    VERIFY1(element_handler_factory_.Register(tuples[i].first,
-                                              tuples[i].second));
+// Parses 'ping'.
+HRESULT HandlePing(const Element& element, response::Response* response) {
+  response::Ping& ping = response->apps.back().ping;
+  element.ReadStringAttribute(xml::attribute::kStatus, &ping.status);
+  if (ping.status != xml::response::kStatusOkValue) {
+    CORE_LOG(LW, (_T("[HandlePing][unexpected status][%s]"), ping.status));
   }
+  return S_OK;
 }
 
-HRESULT XmlParser::SerializeRequest(const UpdateRequest& update_request,
-                                    CString* buffer) {
-  ASSERT1(buffer);
+// Parses 'event'.
+HRESULT HandleEvent(const Element& element, response::Response* response) {
+  response::Event event;
+  element.ReadStringAttribute(xml::attribute::kStatus, &event.status);
+  if (event.status != xml::response::kStatusOkValue) {
+    CORE_LOG(LW, (_T("[HandleEvent][unexpected status][%s]"), event.status));
+  }
+  response::App& app = response->apps.back();
+  app.events.push_back(event);
+  return S_OK;
+}
 
-  XmlParser xml_parser;
+// Parses 'daystart'.
+HRESULT HandleDayStart(const Element& element, response::Response* response) {
+  element.ReadIntAttribute(xml::attribute::kElapsedSeconds,
+                           &response->day_start.elapsed_seconds);
 
-  HRESULT hr = xml_parser.BuildDom(update_request.request());
+  HRESULT hr = element.ReadIntAttribute(xml::attribute::kElapsedDays,
+                                        &response->day_start.elapsed_days);
   if (FAILED(hr)) {
+    CORE_LOG(LW, (_T("[HandleDayStart][hr=%#x]"), hr));
     return hr;
   }
-
-  hr = xml_parser.GetXml(buffer);
-  if (FAILED(hr)) {
-    return hr;
+  if (response->day_start.elapsed_days < kMinDaysSinceDatum ||
+      response->day_start.elapsed_days > kMaxDaysSinceDatum) {
+    CORE_LOG(LE, (_T("[HandleDayStart][elapsed days out of range][%d]"),
+                  response->day_start.elapsed_days));
+    return GOOPDATEXML_E_PARSE_ERROR;
   }
-
   return S_OK;
 }
 
-HRESULT XmlParser::BuildDom(const request::Request& request) {
-  CORE_LOG(L3, (_T("[XmlParser::BuildDom]")));
-  HRESULT hr = CoCreateSafeDOMDocument(&document_);
+// Parses 'systemrequirements'.
+HRESULT HandleSystemRequirements(const Element& element,
+                                 response::Response* response) {
+  response::SystemRequirements& sys_req = response->sys_req;
+
+  HRESULT hr = element.ReadStringAttribute(xml::attribute::kPlatform,
+                                           &sys_req.platform);
   if (FAILED(hr)) {
     return hr;
   }
 
-  request_ = &request;
-
-  hr = BuildRequestElement();
+  hr = element.ReadStringAttribute(xml::attribute::kArch, &sys_req.arch);
   if (FAILED(hr)) {
     return hr;
   }
 
-  return S_OK;
+  return element.ReadStringAttribute(xml::attribute::kMinOSVersion,
+                                     &sys_req.min_os_version);
 }
 
-// Extract the string out of the DOM, and add the initial processing
-// instruction. The xml property of the document converts to the document from
-// its original encoding to Unicode. As a result, the xml directive and the
-// desired encoding must be explicitely set here.
-HRESULT XmlParser::GetXml(CString* buffer) {
-  CORE_LOG(L3, (_T("[XmlParser::GetXml]")));
+namespace v2 {
 
-  ASSERT1(buffer);
+namespace element {
 
-  CComBSTR xml_body;
-  HRESULT hr = document_->get_xml(&xml_body);
-  if (FAILED(hr)) {
-    return hr;
-  }
+const TCHAR* const kGUpdate = _T("gupdate");
 
-  *buffer = kXmlDirective;
-  *buffer += xml_body;
+}  // namespace element
 
-  // The xml string contains a CR LF pair at the end.
-  buffer->TrimRight(_T("\r\n"));
+namespace attributev2 {
 
-  return S_OK;
-}
+// Some v2 offline manifests were incorrectly authored as 'Version' with a
+// capital 'V'.
+const TCHAR* const kVersionProperCased = _T("Version");
 
+}  // namespace attributev2
 
-HRESULT XmlParser::BuildRequestElement() {
-  CORE_LOG(L3, (_T("[XmlParser::BuildRequestElement]")));
+namespace value {
+
+const TCHAR* const kVersion2 = _T("2.0");
+
+}  // namespace value
 
-  CComPtr<IXMLDOMNode> element;
-  HRESULT hr = CreateElementNode(xml::element::kRequest, _T(""), &element);
+// Parses Omaha v2 'gupdate'.
+HRESULT HandleGUpdate(const Element& element, response::Response* response) {
+  HRESULT hr = element.ReadStringAttribute(xml::attribute::kProtocol,
+                                           &response->protocol);
   if (FAILED(hr)) {
     return hr;
   }
+  return VerifyProtocolCompatibility(response->protocol, value::kVersion2);
+}
 
-  ASSERT1(request_);
+HRESULT ParsePostInstallActions(const Element& element,
+                                InstallAction* post_install_action) {
+  InstallAction install_action;
+  CString success_action;
+  if (FAILED(element.ReadStringAttribute(xml::attribute::kSuccessAction,
+                                         &success_action)) &&
+      FAILED(element.ReadStringAttribute(xml::attribute::kSuccessUrl,
+                                         &install_action.success_url)) &&
+      FAILED(element.ReadBooleanAttribute(
+          xml::attribute::kTerminateAllBrowsers,
+          &install_action.terminate_all_browsers))) {
+    return HRESULT_FROM_WIN32(ERROR_NOT_FOUND);
+  }
+
+  install_action.install_event = InstallAction::kPostInstall;
+  element.ReadStringAttribute(xml::attribute::kSuccessAction,
+                              &success_action);
+  ConvertStringToSuccessfulInstallAction(success_action,
+                                         &install_action.success_action);
+  element.ReadStringAttribute(xml::attribute::kSuccessUrl,
+                              &install_action.success_url);
+  element.ReadBooleanAttribute(xml::attribute::kTerminateAllBrowsers,
+                               &install_action.terminate_all_browsers);
+  *post_install_action = install_action;
+  return S_OK;
+}
 
-  // Add attributes to the top element:
-  // * protocol - protocol version
-  // * version - Omaha (goopdate.dll) version
-  // * shell_version - Omaha shell (GoogleUpdate.exe) version
-  // * ismachine - is machine Omaha
-  // * installsource - install source
-  // * originurl - origin url, primarily set by Update3Web plugins
-  // * testsource - test source
-  // * requestid - unique request ID
-  // * periodoverridesec - override value for update check frequency
-  // * dedup - the algorithm used to dedup users
-  // * dlpref - the GPO settings for download url preference
+// Parses Omaha v2 'updatecheck'.
+HRESULT HandleUpdateCheck(const Element& element,
+                          response::Response* response) {
+  response::UpdateCheck& update_check = response->apps.back().update_check;
 
-  hr = AddXMLAttributeNode(element,
-                           kXmlNamespace,
-                           xml::attribute::kProtocol,
-                           request_->protocol_version);
+  HRESULT hr = element.ReadStringAttribute(xml::attribute::kStatus,
+                                           &update_check.status);
   if (FAILED(hr)) {
     return hr;
   }
 
-  hr = AddXMLAttributeNode(element,
-                           kXmlNamespace,
-                           xml::attribute::kUpdater,
-                           xml::value::kUpdater);
-  if (FAILED(hr)) {
-    return hr;
+  if (update_check.status.CompareNoCase(xml::response::kStatusOkValue)) {
+    return S_OK;
   }
 
+  InstallManifest& install_manifest = update_check.install_manifest;
+  if (FAILED(element.ReadStringAttribute(xml::attribute::kVersion,
+                                         &install_manifest.version))) {
+    element.ReadStringAttribute(v2::attributev2::kVersionProperCased,
+                                &install_manifest.version);
+  }
 
-  hr = AddXMLAttributeNode(element,
-                           kXmlNamespace,
-                           xml::attribute::kUpdaterVersion,
-                           request_->omaha_version);
+  CString url;
+  hr = element.ReadStringAttribute(xml::attribute::kCodebase, &url);
   if (FAILED(hr)) {
     return hr;
   }
 
-  hr = AddXMLAttributeNode(element,
-                           kXmlNamespace,
-                           xml::attribute::kShellVersion,
-                           request_->omaha_shell_version);
-  if (FAILED(hr)) {
-    return hr;
+  int start_file_name_idx = url.ReverseFind(_T('/'));
+  if (start_file_name_idx <= 0) {
+    return GOOPDATEDOWNLOAD_E_INVALID_PATH;
+  }
+  CString base_url = url.Left(start_file_name_idx + 1);
+  update_check.urls.push_back(base_url);
+
+  CString package_name = url.Right(url.GetLength() - start_file_name_idx - 1);
+  if (package_name.IsEmpty()) {
+    return GOOPDATEDOWNLOAD_E_FILE_NAME_EMPTY;
   }
 
-  hr = AddXMLAttributeNode(element,
-                           kXmlNamespace,
-                           xml::attribute::kIsMachine,
-                           request_->is_machine ? _T("1") : _T("0"));
+  InstallPackage install_package;
+  install_package.name = package_name;
+  install_package.is_required = true;
+  hr = element.ReadUint64Attribute(xml::attribute::kSize,
+                                   &install_package.size);
   if (FAILED(hr)) {
     return hr;
   }
-
-  hr = AddXMLAttributeNode(element,
-                           kXmlNamespace,
-                           xml::attribute::kSessionId,
-                           request_->session_id);
+  hr = element.ReadStringAttribute(xml::attribute::kHash,
+                                   &install_package.hash_sha1);
   if (FAILED(hr)) {
     return hr;
   }
 
-  if (!request_->uid.IsEmpty()) {
-    hr = AddXMLAttributeNode(element,
-                             kXmlNamespace,
-                             xml::attribute::kUserId,
-                             request_->uid);
-    if (FAILED(hr)) {
-      return hr;
-    }
-  }
+  install_manifest.packages.push_back(install_package);
 
-  if (!request_->install_source.IsEmpty()) {
-    hr = AddXMLAttributeNode(element,
-                             kXmlNamespace,
-                             xml::attribute::kInstallSource,
-                             request_->install_source);
-    if (FAILED(hr)) {
-      return hr;
-    }
-  }
+  InstallAction install_action;
+  install_action.install_event = InstallAction::kInstall;
+  install_action.program_to_run = package_name;
+  element.ReadStringAttribute(xml::attribute::kArguments,
+                              &install_action.program_arguments);
 
-  if (!request_->origin_url.IsEmpty()) {
-    hr = AddXMLAttributeNode(element,
-                             kXmlNamespace,
-                             xml::attribute::kOriginURL,
-                             request_->origin_url);
-    if (FAILED(hr)) {
-      return hr;
-    }
-  }
+  install_manifest.install_actions.push_back(install_action);
 
-  if (!request_->test_source.IsEmpty()) {
-    hr = AddXMLAttributeNode(element,
-                             kXmlNamespace,
-                             xml::attribute::kTestSource,
-                             request_->test_source);
-    if (FAILED(hr)) {
-      return hr;
-    }
+  InstallAction post_install_action;
+  if (SUCCEEDED(ParsePostInstallActions(element, &post_install_action))) {
+    install_manifest.install_actions.push_back(post_install_action);
   }
 
-  if (!request_->request_id.IsEmpty()) {
-    hr = AddXMLAttributeNode(element,
-                             kXmlNamespace,
-                             xml::attribute::kRequestId,
-                             request_->request_id);
-    if (FAILED(hr)) {
-      return hr;
-    }
-  }
+  return S_OK;
+}
 
-  if (request_->check_period_sec != -1) {
-    hr = AddXMLAttributeNode(element,
-                             kXmlNamespace,
-                             xml::attribute::kPeriodOverrideSec,
-                             itostr(request_->check_period_sec));
-    if (FAILED(hr)) {
-      return hr;
-    }
-  }
+}  // namespace v2
 
-  hr = AddXMLAttributeNode(element,
-                           kXmlNamespace,
-                           xml::attribute::kDedup,
-                           xml::value::kClientRegulated);
-  if (FAILED(hr)) {
-    return hr;
-  }
+// Returns the handler for the element |name| or NULL if the element is not
+// understood. The tables replace the element handler factory, which allocated
+// a handler object for each element of the document.
+const ElementHandlerEntry* FindElementHandler(const std::string& name,
+                                              bool is_legacy) {
+  static const ElementHandlerEntry kHandlers[] = {
+    {xml::element::kAction, &HandleAction, true, false},
+    {xml::element::kActions, &HandleContainer, false, false},
+    {xml::element::kApp, &HandleApp, false, false},
+    {xml::element::kData, &HandleData, true, true},
+    {xml::element::kDayStart, &HandleDayStart, false, false},
+    {xml::element::kSystemRequirements, &HandleSystemRequirements,
+        false, false},
+    {xml::element::kEvent, &HandleEvent, true, false},
+    {xml::element::kManifest, &HandleManifest, true, false},
+    {xml::element::kPackage, &HandlePackage, true, false},
+    {xml::element::kPackages, &HandleContainer, false, false},
+    {xml::element::kPing, &HandlePing, true, false},
+    {xml::element::kResponse, &HandleResponse, false, false},
+    {xml::element::kUpdateCheck, &HandleUpdateCheck, true, false},
+    {xml::element::kUrl, &HandleUrl, true, false},
+    {xml::element::kUrls, &HandleContainer, false, false},
+  };
 
-  if (request_->dlpref == kDownloadPreferenceCacheable) {
-    hr = AddXMLAttributeNode(element,
-                             kXmlNamespace,
-                             xml::attribute::kDlPref,
-                             xml::value::kCacheable);
-    if (FAILED(hr)) {
-      return hr;
+  // The 'app' and the 'data' handlers are shared, because the format is
+  // identical between Omaha v2 and Omaha v3. We should make copies of the
+  // shared handlers if these elements diverge between v2 and v3. The worst
+  // case scenario is that we break v2 compatibility if we do not do a
+  // copy-on-write, which might be acceptable.
+  static const ElementHandlerEntry kLegacyHandlers[] = {
+    {xml::element::kApp, &HandleApp, false, false},
+    {xml::element::kData, &HandleData, true, true},
+    {v2::element::kGUpdate, &v2::HandleGUpdate, false, false},
+    {xml::element::kUpdateCheck, &v2::HandleUpdateCheck, true, false},
+  };
+
+  const ElementHandlerEntry* handlers = is_legacy ? kLegacyHandlers :
+                                                    kHandlers;
+  const size_t num_handlers = is_legacy ? arraysize(kLegacyHandlers) :
+                                          arraysize(kHandlers);
+  for (size_t i = 0; i != num_handlers; ++i) {
+    if (EqualsAscii(name, handlers[i].name)) {
+      return &handlers[i];
     }
   }
+  return NULL;
+}
 
-  hr = AddXMLAttributeNode(element,
-                           kXmlNamespace,
-                           xml::attribute::kDomainJoined,
-                           request_->domain_joined ? _T("1") : _T("0"));
-  if (FAILED(hr)) {
-    return hr;
+HRESULT RunElementHandler(const ElementHandlerEntry& entry,
+                          const Element& element,
+                          response::Response* response) {
+  // Elements such as 'updatecheck' must be inside an 'app'.
+  if (entry.is_app_child && response->apps.empty()) {
+    CORE_LOG(LE, (_T("[element outside of app][%s]"), entry.name));
+    return GOOPDATEXML_E_PARSE_ERROR;
   }
+  return entry.handler(element, response);
+}
 
-  hr = BuildHwElement(element);
-  if (FAILED(hr)) {
-    return hr;
+// Reads the response with a pull parser. Each element understood is handled
+// as soon as its start tag is parsed, except for the elements which have a
+// value, which are handled at their end tag. The document is not built in
+// memory.
+HRESULT ReadResponse(const uint8* data,
+                     size_t size,
+                     response::Response* response) {
+  ASSERT1(response);
+
+  XmlPullParser parser(data, size);
+
+  XmlPullParser::Token token = parser.Next();
+  if (token != XmlPullParser::kStartElement) {
+    CORE_LOG(LE, (_T("[ReadResponse][parse error][%Iu]"),
+                  parser.error_offset()));
+    return GOOPDATEXML_E_PARSE_ERROR;
   }
 
-  hr = BuildOsElement(element);
-  if (FAILED(hr)) {
-    return hr;
-  }
+  bool is_legacy = false;
+  if (EqualsAscii(parser.name(), v2::element::kGUpdate)) {
+    is_legacy = true;
+  } else if (!EqualsAscii(parser.name(), xml::element::kResponse)) {
+    return GOOPDATEXML_E_RESPONSENODE;
+  }
+
+  // The element whose handler waits for the end tag, its attributes, and its
+  // text. The value of such an element cannot be read if it has elements
+  // inside.
+  const ElementHandlerEntry* pending_entry = NULL;
+  int pending_depth = 0;
+  std::vector<XmlPullParser::Attribute> pending_attributes;
+  std::string pending_text;
+  bool pending_has_child_elements = false;
+
+  for (; token != XmlPullParser::kEndDocument; token = parser.Next()) {
+    switch (token) {
+      case XmlPullParser::kStartElement: {
+        CORE_LOG(L4, (_T("[element name][%S]"), parser.name().c_str()));
+
+        if (pending_entry) {
+          pending_has_child_elements = true;
+        }
+
+        const ElementHandlerEntry* entry = FindElementHandler(parser.name(),
+                                                              is_legacy);
+        if (!entry) {
+          // Ignore elements not understood.
+          CORE_LOG(LW, (_T("[ReadResponse: don't know how to handle %S]"),
+                        parser.name().c_str()));
+          break;
+        }
+
+        if (entry->has_value && !pending_entry) {
+          pending_entry = entry;
+          pending_depth = parser.depth();
+          pending_attributes.assign(
+              parser.attributes(),
+              parser.attributes() + parser.num_attributes());
+          pending_text.clear();
+          pending_has_child_elements = false;
+          break;
+        }
+
+        static const std::string kNoText;
+        const Element element(parser.attributes(),
+                              parser.num_attributes(),
+                              kNoText,
+                              false);
+        HRESULT hr = RunElementHandler(*entry, element, response);
+        if (FAILED(hr)) {
+          return hr;
+        }
+        break;
+      }
 
-  // Add the app element sequence to the request.
-  hr = BuildAppElement(element);
-  if (FAILED(hr)) {
-    return hr;
+      case XmlPullParser::kText:
+        if (pending_entry && parser.depth() == pending_depth) {
+          pending_text += parser.text();
+        }
+        break;
+
+      case XmlPullParser::kEndElement:
+        if (pending_entry && parser.depth() == pending_depth - 1) {
+          const Element element(
+              pending_attributes.empty() ? NULL : &pending_attributes.front(),
+              pending_attributes.size(),
+              pending_text,
+              pending_has_child_elements);
+          HRESULT hr = RunElementHandler(*pending_entry, element, response);
+          if (FAILED(hr)) {
+            return hr;
+          }
+          pending_entry = NULL;
+        }
+        break;
+
+      case XmlPullParser::kError:
+        CORE_LOG(LE, (_T("[ReadResponse][parse error][%Iu]"),
+                      parser.error_offset()));
+        return GOOPDATEXML_E_PARSE_ERROR;
+
+      default:
+        ASSERT1(false);
+        return E_UNEXPECTED;
+    }
   }
 
-  // Add the request node to the document root.
-  CComPtr<IXMLDOMElement> element_node;
-  hr = element->QueryInterface(&element_node);
-  if (FAILED(hr)) {
-    return hr;
-  }
+  return S_OK;
+}
+
+}  // namespace
+
+XmlParser::XmlParser(XmlWriter* writer, const request::Request* request)
+    : writer_(writer),
+      request_(request) {
+  ASSERT1(writer);
+  ASSERT1(request);
+}
+
+HRESULT XmlParser::SerializeRequest(const UpdateRequest& update_request,
+                                    CString* buffer) {
+  ASSERT1(buffer);
 
-  hr = document_->putref_documentElement(element_node);
+  CStringA utf8_buffer;
+  HRESULT hr = SerializeRequest(update_request, &utf8_buffer);
   if (FAILED(hr)) {
     return hr;
   }
 
+  *buffer = Utf8ToWideChar(utf8_buffer, utf8_buffer.GetLength());
   return S_OK;
 }
 
-HRESULT XmlParser::BuildHwElement(IXMLDOMNode* parent_node) {
-  CORE_LOG(L3, (_T("[XmlParser::BuildHwElement]")));
+HRESULT XmlParser::SerializeRequest(const UpdateRequest& update_request,
+                                    CStringA* utf8_buffer) {
+  CORE_LOG(L3, (_T("[XmlParser::SerializeRequest]")));
+  ASSERT1(utf8_buffer);
 
-  ASSERT1(parent_node);
-  ASSERT1(request_);
+  // Truncating keeps the memory of the buffer for the next request.
+  utf8_buffer->Truncate(0);
 
-  CComPtr<IXMLDOMNode> element;
-  HRESULT hr = CreateElementNode(xml::element::kHw, _T(""), &element);
-  if (FAILED(hr)) {
-    return hr;
-  }
+  XmlWriter writer(utf8_buffer);
+  writer.WriteXmlDeclaration();
 
-  hr = AddXMLAttributeNode(element,
-                           kXmlNamespace,
-                           xml::attribute::kPhysMemory,
-                           itostr(request_->hw.physmemory));
+  XmlParser xml_parser(&writer, &update_request.request());
+  HRESULT hr = xml_parser.BuildRequestElement();
   if (FAILED(hr)) {
+    utf8_buffer->Truncate(0);
     return hr;
   }
 
-  hr = AddXMLAttributeNode(element,
-                           kXmlNamespace,
-                           xml::attribute::kSse,
-                           request_->hw.has_sse ? _T("1") : _T("0"));
-  if (FAILED(hr)) {
-    return hr;
-  }
+  ASSERT1(!writer.depth());
+  return S_OK;
+}
 
-  hr = AddXMLAttributeNode(element,
-                           kXmlNamespace,
-                           xml::attribute::kSse2,
-                           request_->hw.has_sse2 ? _T("1") : _T("0"));
-  if (FAILED(hr)) {
-    return hr;
-  }
+HRESULT XmlParser::BuildRequestElement() {
+  CORE_LOG(L3, (_T("[XmlParser::BuildRequestElement]")));
 
-  hr = AddXMLAttributeNode(element,
-                           kXmlNamespace,
-                           xml::attribute::kSse3,
-                           request_->hw.has_sse3 ? _T("1") : _T("0"));
-  if (FAILED(hr)) {
-    return hr;
+  // Add attributes to the top element:
+  // * protocol - protocol version
+  // * version - Omaha (goopdate.dll) version
+  // * shell_version - Omaha shell (GoogleUpdate.exe) version
+  // * ismachine - is machine Omaha
+  // * installsource - install source
+  // * originurl - origin url, primarily set by Update3Web plugins
+  // * testsource - test source
+  // * requestid - unique request ID
+  // * periodoverridesec - override value for update check frequency
+  // * dedup - the algorithm used to dedup users
+  // * dlpref - the GPO settings for download url preference
+
+  writer_->StartElement(xml::element::kRequest);
+  writer_->AddAttribute(xml::attribute::kProtocol, request_->protocol_version);
+  writer_->AddAttribute(xml::attribute::kUpdater, xml::value::kUpdater);
+  writer_->AddAttribute(xml::attribute::kUpdaterVersion,
+                        request_->omaha_version);
+  writer_->AddAttribute(xml::attribute::kShellVersion,
+                        request_->omaha_shell_version);
+  writer_->AddAttribute(xml::attribute::kIsMachine,
+                        request_->is_machine ? _T("1") : _T("0"));
+  writer_->AddAttribute(xml::attribute::kSessionId, request_->session_id);
+
+  if (!request_->uid.IsEmpty()) {
+    writer_->AddAttribute(xml::attribute::kUserId, request_->uid);
   }
 
-  hr = AddXMLAttributeNode(element,
-                           kXmlNamespace,
-                           xml::attribute::kSsse3,
-                           request_->hw.has_ssse3 ? _T("1") : _T("0"));
-  if (FAILED(hr)) {
-    return hr;
+  if (!request_->install_source.IsEmpty()) {
+    writer_->AddAttribute(xml::attribute::kInstallSource,
+                          request_->install_source);
   }
 
-  hr = AddXMLAttributeNode(element,
-                           kXmlNamespace,
-                           xml::attribute::kSse41,
-                           request_->hw.has_sse41 ? _T("1") : _T("0"));
-  if (FAILED(hr)) {
-    return hr;
+  if (!request_->origin_url.IsEmpty()) {
+    writer_->AddAttribute(xml::attribute::kOriginURL, request_->origin_url);
   }
 
-  hr = AddXMLAttributeNode(element,
-                           kXmlNamespace,
-                           xml::attribute::kSse42,
-                           request_->hw.has_sse42 ? _T("1") : _T("0"));
-  if (FAILED(hr)) {
-    return hr;
+  if (!request_->test_source.IsEmpty()) {
+    writer_->AddAttribute(xml::attribute::kTestSource, request_->test_source);
   }
 
-  hr = AddXMLAttributeNode(element,
-                           kXmlNamespace,
-                           xml::attribute::kAvx,
-                           request_->hw.has_avx ? _T("1") : _T("0"));
-  if (FAILED(hr)) {
-    return hr;
+  if (!request_->request_id.IsEmpty()) {
+    writer_->AddAttribute(xml::attribute::kRequestId, request_->request_id);
   }
 
-  hr = parent_node->appendChild(element, NULL);
-  if (FAILED(hr)) {
-    return hr;
+  if (request_->check_period_sec != -1) {
+    writer_->AddAttribute(xml::attribute::kPeriodOverrideSec,
+                          request_->check_period_sec);
   }
 
-  return S_OK;
-}
+  writer_->AddAttribute(xml::attribute::kDedup, xml::value::kClientRegulated);
 
-HRESULT XmlParser::BuildOsElement(IXMLDOMNode* parent_node) {
-  CORE_LOG(L3, (_T("[XmlParser::BuildOsElement]")));
+  if (request_->dlpref == kDownloadPreferenceCacheable) {
+    writer_->AddAttribute(xml::attribute::kDlPref, xml::value::kCacheable);
+  }
 
-  ASSERT1(parent_node);
-  ASSERT1(request_);
+  writer_->AddAttribute(xml::attribute::kDomainJoined,
+                        request_->domain_joined ? _T("1") : _T("0"));
 
-  CComPtr<IXMLDOMNode> element;
-  HRESULT hr = CreateElementNode(xml::element::kOs, _T(""), &element);
-  if (FAILED(hr)) {
-    return hr;
-  }
+  BuildHwElement();
+  BuildOsElement();
 
-  hr = AddXMLAttributeNode(element,
-                           kXmlNamespace,
-                           xml::attribute::kPlatform,
-                           request_->os.platform);
+  // Add the app element sequence to the request.
+  HRESULT hr = BuildAppElement();
   if (FAILED(hr)) {
     return hr;
   }
 
-  hr = AddXMLAttributeNode(element,
-                           kXmlNamespace,
-                           xml::attribute::kVersion,
-                           request_->os.version);
-  if (FAILED(hr)) {
-    return hr;
-  }
+  writer_->EndElement();
+  return S_OK;
+}
 
-  hr = AddXMLAttributeNode(element,
-                           kXmlNamespace,
-                           xml::attribute::kServicePack,
-                           request_->os.service_pack);
-  if (FAILED(hr)) {
-    return hr;
-  }
+void XmlParser::BuildHwElement() {
+  CORE_LOG(L3, (_T("[XmlParser::BuildHwElement]")));
 
-  hr = AddXMLAttributeNode(element,
-                           kXmlNamespace,
-                           xml::attribute::kArch,
-                           request_->os.arch);
-  if (FAILED(hr)) {
-    return hr;
-  }
+  writer_->StartElement(xml::element::kHw);
+  writer_->AddAttribute(xml::attribute::kPhysMemory, request_->hw.physmemory);
+  writer_->AddAttribute(xml::attribute::kSse,
+                        request_->hw.has_sse ? _T("1") : _T("0"));
+  writer_->AddAttribute(xml::attribute::kSse2,
+                        request_->hw.has_sse2 ? _T("1") : _T("0"));
+  writer_->AddAttribute(xml::attribute::kSse3,
+                        request_->hw.has_sse3 ? _T("1") : _T("0"));
+  writer_->AddAttribute(xml::attribute::kSsse3,
+                        request_->hw.has_ssse3 ? _T("1") : _T("0"));
+  writer_->AddAttribute(xml::attribute::kSse41,
+                        request_->hw.has_sse41 ? _T("1") : _T("0"));
+  writer_->AddAttribute(xml::attribute::kSse42,
+                        request_->hw.has_sse42 ? _T("1") : _T("0"));
+  writer_->AddAttribute(xml::attribute::kAvx,
+                        request_->hw.has_avx ? _T("1") : _T("0"));
+  writer_->EndElement();
+}
 
-  hr = parent_node->appendChild(element, NULL);
-  if (FAILED(hr)) {
-    return hr;
-  }
+void XmlParser::BuildOsElement() {
+  CORE_LOG(L3, (_T("[XmlParser::BuildOsElement]")));
 
-  return S_OK;
+  writer_->StartElement(xml::element::kOs);
+  writer_->AddAttribute(xml::attribute::kPlatform, request_->os.platform);
+  writer_->AddAttribute(xml::attribute::kVersion, request_->os.version);
+  writer_->AddAttribute(xml::attribute::kServicePack,
+                        request_->os.service_pack);
+  writer_->AddAttribute(xml::attribute::kArch, request_->os.arch);
+  writer_->EndElement();
 }
 
-// Create and add request's to the requests node.
-HRESULT XmlParser::BuildAppElement(IXMLDOMNode* parent_node) {
+// Writes the app elements of the request.
+HRESULT XmlParser::BuildAppElement() {
   CORE_LOG(L3, (_T("[XmlParser::BuildAppElement]")));
 
-  ASSERT1(parent_node);
-  ASSERT1(request_);
-
   for (size_t i = 0; i < request_->apps.size(); ++i) {
     const request::App& app = request_->apps[i];
 
-    CComPtr<IXMLDOMNode> element;
-    HRESULT hr = CreateElementNode(xml::element::kApp, _T(""), &element);
-    if (FAILED(hr)) {
-      return hr;
-    }
+    writer_->StartElement(xml::element::kApp);
 
     ASSERT1(IsGuid(app.app_id));
-    hr = AddXMLAttributeNode(element,
-                             kXmlNamespace,
-                             xml::attribute::kAppId,
-                             app.app_id);
-    if (FAILED(hr)) {
-      return hr;
-    }
-
-    hr = AddXMLAttributeNode(element,
-                             kXmlNamespace,
-                             xml::attribute::kVersion,
-                             app.version);
-    if (FAILED(hr)) {
-      return hr;
-    }
-
-    hr = AddXMLAttributeNode(element,
-                             kXmlNamespace,
-                             xml::attribute::kNextVersion,
-                             app.next_version);
-    if (FAILED(hr)) {
-      return hr;
-    }
+    writer_->AddAttribute(xml::attribute::kAppId, app.app_id);
+    writer_->AddAttribute(xml::attribute::kVersion, app.version);
+    writer_->AddAttribute(xml::attribute::kNextVersion, app.next_version);
 
-    hr = AddAppDefinedAttributes(app, element);
-    if (FAILED(hr)) {
-      return hr;
-    }
+    AddAppDefinedAttributes(app);
 
     if (!app.ap.IsEmpty()) {
-      hr = AddXMLAttributeNode(element,
-                               kXmlNamespace,
-                               xml::attribute::kAdditionalParameters,
-                               app.ap);
-      if (FAILED(hr)) {
-        return hr;
-      }
-    }
-
-    hr = AddXMLAttributeNode(element,
-                             kXmlNamespace,
-                             xml::attribute::kLang,
-                             app.lang);
-    if (FAILED(hr)) {
-      return hr;
-    }
-
-    hr = AddXMLAttributeNode(element,
-                             kXmlNamespace,
-                             xml::attribute::kBrandCode,
-                             app.brand_code);
-    if (FAILED(hr)) {
-      return hr;
+      writer_->AddAttribute(xml::attribute::kAdditionalParameters, app.ap);
     }
 
-    hr = AddXMLAttributeNode(element,
-                             kXmlNamespace,
-                             xml::attribute::kClientId,
-                             app.client_id);
-    if (FAILED(hr)) {
-      return hr;
-    }
+    writer_->AddAttribute(xml::attribute::kLang, app.lang);
+    writer_->AddAttribute(xml::attribute::kBrandCode, app.brand_code);
+    writer_->AddAttribute(xml::attribute::kClientId, app.client_id);
 
     // TODO(omaha3): Determine whether or not the server is able to accept an
     // empty string here.  If so, remove this IsEmpty() check, and always emit.
     if (!app.experiments.IsEmpty()) {
-      hr = AddXMLAttributeNode(element,
-                               kXmlNamespace,
-                               xml::attribute::kExperiments,
-                               app.experiments);
-      if (FAILED(hr)) {
-        return hr;
-      }
+      writer_->AddAttribute(xml::attribute::kExperiments, app.experiments);
     }
 
     // 0 seconds indicates unknown install time. A new install uses -1 days.
@@ -1298,13 +1125,8 @@ HRESULT XmlParser::BuildAppElement(IXMLDOMNode* parent_node) {
       const int installed_full_days =
           static_cast<int>(app.install_time_diff_sec) / kSecondsPerDay;
       ASSERT1(installed_full_days >= 0 || installed_full_days == -1);
-      hr = AddXMLAttributeNode(element,
-                               kXmlNamespace,
-                               xml::attribute::kInstalledAgeDays,
-                               itostr(installed_full_days));
-      if (FAILED(hr)) {
-        return hr;
-      }
+      writer_->AddAttribute(xml::attribute::kInstalledAgeDays,
+                            installed_full_days);
     }
 
     // Three possible categories for value of DayOfInstall:
@@ -1315,244 +1137,103 @@ HRESULT XmlParser::BuildAppElement(IXMLDOMNode* parent_node) {
     if (app.day_of_install != 0) {
       ASSERT1(app.day_of_install >= kMinDaysSinceDatum ||
               app.day_of_install == -1);
-      hr = AddXMLAttributeNode(element,
-                               kXmlNamespace,
-                               xml::attribute::kInstallDate,
-                               itostr(app.day_of_install));
-      if (FAILED(hr)) {
-        return hr;
-      }
+      writer_->AddAttribute(xml::attribute::kInstallDate, app.day_of_install);
     }
 
     if (!app.iid.IsEmpty() && app.iid != GuidToString(GUID_NULL)) {
-      hr = AddXMLAttributeNode(element,
-                               kXmlNamespace,
-                               xml::attribute::kInstallationId,
-                               app.iid);
-      if (FAILED(hr)) {
-        return hr;
-      }
-    }
-
-    hr = AddCohortAttributes(app, element);
-    if (FAILED(hr)) {
-      return hr;
+      writer_->AddAttribute(xml::attribute::kInstallationId, app.iid);
     }
 
-    hr = BuildUpdateCheckElement(app, element);
-    if (FAILED(hr)) {
-      return hr;
-    }
+    AddCohortAttributes(app);
 
-    hr = BuildPingRequestElement(app, element);
-    if (FAILED(hr)) {
-      return hr;
-    }
+    BuildUpdateCheckElement(app);
+    BuildPingRequestElement(app);
 
-    hr = BuildDataElement(app, element);
+    HRESULT hr = BuildDataElement(app);
     if (FAILED(hr)) {
       return hr;
     }
 
-    hr = BuildDidRunElement(app, element);
-    if (FAILED(hr)) {
-      return hr;
-    }
+    BuildDidRunElement(app);
 
-    hr = parent_node->appendChild(element, NULL);
-    if (FAILED(hr)) {
-      return hr;
-    }
+    writer_->EndElement();
   }
 
   return S_OK;
 }
 
-HRESULT XmlParser::AddAppDefinedAttributes(const request::App& app,
-                                           IXMLDOMNode* element) {
-  CORE_LOG(L3, (_T("[XmlParser::AddAppDefinedAttributes]")));
-
-  if (app.app_defined_attributes.empty()) {
-    return S_OK;
-  }
-
+void XmlParser::AddAppDefinedAttributes(const request::App& app) {
   for (size_t i = 0; i < app.app_defined_attributes.size(); ++i) {
     const CString& name(app.app_defined_attributes[i].first);
     const CString& value(app.app_defined_attributes[i].second);
 
     ASSERT1(String_StartsWith(name, xml::attribute::kAppDefinedPrefix, false));
 
-    HRESULT hr = AddXMLAttributeNode(element, kXmlNamespace, name, value);
-    if (FAILED(hr)) {
-      return hr;
-    }
+    writer_->AddAttribute(name, value);
   }
-
-  return S_OK;
 }
 
-HRESULT XmlParser::AddCohortAttributes(const request::App& app,
-                                       IXMLDOMNode* element) {
-  CORE_LOG(L3, (_T("[XmlParser::AddCohortAttributes]")));
-
+void XmlParser::AddCohortAttributes(const request::App& app) {
   if (!app.cohort.IsEmpty()) {
-    HRESULT hr = AddXMLAttributeNode(element,
-                                     kXmlNamespace,
-                                     xml::attribute::kCohort,
-                                     app.cohort);
-    if (FAILED(hr)) {
-      return hr;
-    }
+    writer_->AddAttribute(xml::attribute::kCohort, app.cohort);
   }
 
   if (!app.cohort_hint.IsEmpty()) {
-    HRESULT hr = AddXMLAttributeNode(element,
-                                     kXmlNamespace,
-                                     xml::attribute::kCohortHint,
-                                     app.cohort_hint);
-    if (FAILED(hr)) {
-      return hr;
-    }
+    writer_->AddAttribute(xml::attribute::kCohortHint, app.cohort_hint);
   }
 
   if (!app.cohort_name.IsEmpty()) {
-    HRESULT hr = AddXMLAttributeNode(element,
-                                     kXmlNamespace,
-                                     xml::attribute::kCohortName,
-                                     app.cohort_name);
-    if (FAILED(hr)) {
-      return hr;
-    }
+    writer_->AddAttribute(xml::attribute::kCohortName, app.cohort_name);
   }
-
-  return S_OK;
 }
 
-HRESULT XmlParser::BuildUpdateCheckElement(const request::App& app,
-                                           IXMLDOMNode* parent_node) {
-  CORE_LOG(L3, (_T("[XmlParser::BuildUpdateCheckElement]")));
-  ASSERT1(parent_node);
-
-  // Create a DOM element only if the update check member is valid.
+void XmlParser::BuildUpdateCheckElement(const request::App& app) {
+  // Write an element only if the update check member is valid.
   if (!app.update_check.is_valid) {
-    return S_OK;
+    return;
   }
 
-  CComPtr<IXMLDOMNode> element;
-  HRESULT hr = CreateElementNode(xml::element::kUpdateCheck, _T(""), &element);
-  if (FAILED(hr)) {
-    return hr;
-  }
+  writer_->StartElement(xml::element::kUpdateCheck);
 
   if (app.update_check.is_update_disabled) {
-    hr = AddXMLAttributeNode(element,
-                             kXmlNamespace,
-                             xml::attribute::kUpdateDisabled,
-                             xml::value::kTrue);
-    if (FAILED(hr)) {
-      return hr;
-    }
+    writer_->AddAttribute(xml::attribute::kUpdateDisabled, xml::value::kTrue);
   }
 
   if (!app.update_check.tt_token.IsEmpty()) {
-    hr = AddXMLAttributeNode(element,
-                             kXmlNamespace,
-                             xml::attribute::kTTToken,
-                             app.update_check.tt_token);
-    if (FAILED(hr)) {
-      return hr;
-    }
+    writer_->AddAttribute(xml::attribute::kTTToken, app.update_check.tt_token);
   }
 
   if (!app.update_check.target_version_prefix.IsEmpty()) {
     // RollbackToTargetVersion only applies if the TargetVersionPrefix is set.
     if (app.update_check.is_rollback_allowed) {
-      hr = AddXMLAttributeNode(element,
-                               kXmlNamespace,
-                               xml::attribute::kRollbackAllowed,
-                               xml::value::kTrue);
-      if (FAILED(hr)) {
-        return hr;
-      }
-    }
-
-    hr = AddXMLAttributeNode(element,
-                             kXmlNamespace,
-                             xml::attribute::kTargetVersionPrefix,
-                             app.update_check.target_version_prefix);
-    if (FAILED(hr)) {
-      return hr;
+      writer_->AddAttribute(xml::attribute::kRollbackAllowed,
+                            xml::value::kTrue);
     }
-  }
 
-  hr = parent_node->appendChild(element, NULL);
-  if (FAILED(hr)) {
-    return hr;
+    writer_->AddAttribute(xml::attribute::kTargetVersionPrefix,
+                          app.update_check.target_version_prefix);
   }
 
-  return S_OK;
+  writer_->EndElement();
 }
 
 // Ping elements are called "event" elements for legacy reasons.
-HRESULT XmlParser::BuildPingRequestElement(const request::App& app,
-                                           IXMLDOMNode* parent_node) {
-  CORE_LOG(L3, (_T("[XmlParser::BuildPingRequestElement]")));
-  ASSERT1(parent_node);
-
-  // Create a DOM element only if there is are ping_events.
-  if (app.ping_events.empty()) {
-    return S_OK;
-  }
-
+void XmlParser::BuildPingRequestElement(const request::App& app) {
   PingEventVector::const_iterator it;
   for (it = app.ping_events.begin(); it != app.ping_events.end(); ++it) {
     const PingEventPtr ping_event = *it;
-    CComPtr<IXMLDOMNode> element;
-    HRESULT hr = CreateElementNode(xml::element::kEvent, _T(""), &element);
-    if (FAILED(hr)) {
-      return hr;
-    }
-
-    hr = ping_event->ToXml(element);
-    if (FAILED(hr)) {
-      return hr;
-    }
-
-    hr = parent_node->appendChild(element, NULL);
-    if (FAILED(hr)) {
-      return hr;
-    }
+    writer_->StartElement(xml::element::kEvent);
+    ping_event->ToXml(writer_);
+    writer_->EndElement();
   }
-
-  return S_OK;
 }
 
-HRESULT XmlParser::BuildDataElement(const request::App& app,
-                                    IXMLDOMNode* parent_node) {
-  CORE_LOG(L3, (_T("[XmlParser::BuildDataElement]")));
-  ASSERT1(parent_node);
-
-  // Create a DOM element only if there is a data object.
-  if (app.data.empty()) {
-    return S_OK;
-  }
-
+HRESULT XmlParser::BuildDataElement(const request::App& app) {
   for (size_t i = 0; i != app.data.size(); ++i) {
-    CComPtr<IXMLDOMNode> element;
-    HRESULT hr = CreateElementNode(xml::element::kData, _T(""), &element);
-    if (FAILED(hr)) {
-      return hr;
-    }
-
     const xml::request::Data& data = app.data[i];
 
-    hr = AddXMLAttributeNode(element,
-                             kXmlNamespace,
-                             xml::attribute::kName,
-                             data.name);
-    if (FAILED(hr)) {
-      return hr;
-    }
+    writer_->StartElement(xml::element::kData);
+    writer_->AddAttribute(xml::attribute::kName, data.name);
 
     const CString& install_data_index = data.install_data_index;
     const CString& untrusted_data     = data.untrusted_data;
@@ -1563,35 +1244,21 @@ HRESULT XmlParser::BuildDataElement(const request::App& app,
     using xml::value::kUntrusted;
 
     if (data.name == kInstall && !install_data_index.IsEmpty()) {
-      hr = AddXMLAttributeNode(element,
-                               kXmlNamespace,
-                               xml::attribute::kIndex,
-                               data.install_data_index);
+      writer_->AddAttribute(xml::attribute::kIndex, install_data_index);
     } else if (data.name == kUntrusted && !untrusted_data.IsEmpty()) {
-      hr = element->put_text(CComBSTR(untrusted_data));
+      writer_->AddText(untrusted_data);
     } else {
       ASSERT1(false);
-      hr = E_UNEXPECTED;
-    }
-
-    if (FAILED(hr)) {
-      return hr;
+      return E_UNEXPECTED;
     }
 
-    hr = parent_node->appendChild(element, NULL);
-    if (FAILED(hr)) {
-      return hr;
-    }
+    writer_->EndElement();
   }
 
   return S_OK;
 }
 
-HRESULT XmlParser::BuildDidRunElement(const request::App& app,
-                                      IXMLDOMNode* parent_node) {
-  CORE_LOG(L3, (_T("[XmlParser::BuildDidRunElement]")));
-  ASSERT1(parent_node);
-
+void XmlParser::BuildDidRunElement(const request::App& app) {
   const bool was_active = app.ping.active == ACTIVE_RUN;
   const bool need_active = app.ping.active != ACTIVE_UNKNOWN;
   const bool has_sent_a_today = app.ping.days_since_last_active_ping == 0;
@@ -1601,130 +1268,62 @@ HRESULT XmlParser::BuildDidRunElement(const request::App& app,
   const bool need_rd = app.ping.day_of_last_roll_call != 0;
   const bool has_freshness = !app.ping.ping_freshness.IsEmpty();
 
-  // Create a DOM element only if the didrun object has actual state.
+  // Write an element only if the didrun object has actual state.
   if (!need_active && !need_a && !need_r && !need_ad && !need_rd &&
       !has_freshness) {
-    return S_OK;
+    return;
   }
 
   ASSERT1(app.update_check.is_valid);
 
-  CComPtr<IXMLDOMNode> element;
-  HRESULT hr = CreateElementNode(xml::element::kPing, _T(""), &element);
-  if (FAILED(hr)) {
-    return hr;
-  }
+  writer_->StartElement(xml::element::kPing);
 
   // TODO(omaha): Remove "active" attribute after transition.
   if (need_active) {
-    const TCHAR* active_str(was_active ? _T("1") : _T("0"));
-    hr = AddXMLAttributeNode(element,
-                             kXmlNamespace,
-                             xml::attribute::kActive,
-                             active_str);
-    if (FAILED(hr)) {
-      return hr;
-    }
+    writer_->AddAttribute(xml::attribute::kActive,
+                          was_active ? _T("1") : _T("0"));
   }
 
   if (need_a) {
-    hr = AddXMLAttributeNode(element,
-                             kXmlNamespace,
-                             xml::attribute::kDaysSinceLastActivePing,
-                             itostr(app.ping.days_since_last_active_ping));
-    if (FAILED(hr)) {
-      return hr;
-    }
+    writer_->AddAttribute(xml::attribute::kDaysSinceLastActivePing,
+                          app.ping.days_since_last_active_ping);
   }
 
   if (need_r) {
-    hr = AddXMLAttributeNode(element,
-                             kXmlNamespace,
-                             xml::attribute::kDaysSinceLastRollCall,
-                             itostr(app.ping.days_since_last_roll_call));
-    if (FAILED(hr)) {
-      return hr;
-    }
+    writer_->AddAttribute(xml::attribute::kDaysSinceLastRollCall,
+                          app.ping.days_since_last_roll_call);
   }
 
   if (need_ad) {
-    hr = AddXMLAttributeNode(element,
-                             kXmlNamespace,
-                             xml::attribute::kDayOfLastActivity,
-                             itostr(app.ping.day_of_last_activity));
-    if (FAILED(hr)) {
-      return hr;
-    }
+    writer_->AddAttribute(xml::attribute::kDayOfLastActivity,
+                          app.ping.day_of_last_activity);
   }
 
   if (need_rd) {
-    hr = AddXMLAttributeNode(element,
-                             kXmlNamespace,
-                             xml::attribute::kDayOfLastRollCall,
-                             itostr(app.ping.day_of_last_roll_call));
-    if (FAILED(hr)) {
-      return hr;
-    }
+    writer_->AddAttribute(xml::attribute::kDayOfLastRollCall,
+                          app.ping.day_of_last_roll_call);
   }
 
   if (has_freshness) {
-    hr = AddXMLAttributeNode(element,
-                             kXmlNamespace,
-                             xml::attribute::kPingFreshness,
-                             app.ping.ping_freshness);
-    if (FAILED(hr)) {
-      return hr;
-    }
-  }
-
-
-  hr = parent_node->appendChild(element, NULL);
-  if (FAILED(hr)) {
-    return hr;
+    writer_->AddAttribute(xml::attribute::kPingFreshness,
+                          app.ping.ping_freshness);
   }
 
-  return S_OK;
-}
-
-HRESULT XmlParser::CreateElementNode(const TCHAR* name,
-                                     const TCHAR* value,
-                                     IXMLDOMNode** element) {
-  ASSERT1(name);
-  ASSERT1(value);
-  ASSERT1(element);
-
-  // When there is a namespace, the element names get o: prepended to avoid a
-  // size explosion where the namespace uri gets automatically added to every
-  // element by msxml.
-  CString namespace_qualified_name;
-  SafeCStringFormat(&namespace_qualified_name,
-                    kXmlNamespace ? _T("o:%s") : _T("%s"),
-                    name);
-  ASSERT1(document_);
-  HRESULT hr = CreateXMLNode(document_,
-                             NODE_ELEMENT,
-                             namespace_qualified_name,
-                             kXmlNamespace,
-                             value,
-                             element);
-  return hr;
+  writer_->EndElement();
 }
 
-
 HRESULT XmlParser::DeserializeResponse(const std::vector<uint8>& buffer,
                                        UpdateResponse* update_response) {
   ASSERT1(update_response);
 
-  XmlParser xml_parser;
-  HRESULT hr = LoadXMLFromRawData(buffer, false, &xml_parser.document_);
-  if (FAILED(hr)) {
-    return hr;
+  HISTOGRAM_TIME_SCOPE(metric_xml_parser_deserialize_response_ms);
+
+  if (buffer.empty()) {
+    return E_INVALIDARG;
   }
 
   response::Response response;
-  xml_parser.response_ = &response;
-
-  hr = xml_parser.Parse();
+  HRESULT hr = ReadResponse(&buffer.front(), buffer.size(), &response);
   if (FAILED(hr)) {
     return hr;
   }
@@ -1733,107 +1332,6 @@ HRESULT XmlParser::DeserializeResponse(const std::vector<uint8>& buffer,
   return S_OK;
 }
 
-HRESULT XmlParser::Parse() {
-  CORE_LOG(L3, (_T("[XmlParser::Parse]")));
-  ASSERT1(response_);
-
-  CComPtr<IXMLDOMElement> root_node;
-  HRESULT hr = document_->get_documentElement(&root_node);
-  if (FAILED(hr)) {
-    return hr;
-  }
-  if (!root_node) {
-    return GOOPDATEXML_E_PARSE_ERROR;
-  }
-
-  CComBSTR root_name;
-  hr = root_node->get_baseName(&root_name);
-  if (FAILED(hr)) {
-    return hr;
-  }
-
-  if (root_name == xml::element::kResponse) {
-    InitializeElementHandlers();
-    return TraverseDOM(root_node);
-  }
-
-  if (root_name == v2::element::kGUpdate) {
-    InitializeLegacyElementHandlers();
-    return TraverseDOM(root_node);
-  }
-
-  return GOOPDATEXML_E_RESPONSENODE;
-}
-
-HRESULT XmlParser::TraverseDOM(IXMLDOMNode* node) {
-  CORE_LOG(L5, (_T("[XmlParser::TraverseDOM]")));
-  ASSERT1(node);
-
-  HRESULT hr = VisitElement(node);
-  if (FAILED(hr)) {
-    return hr;
-  }
-
-  CComPtr<IXMLDOMNodeList> children_list;
-  hr = node->get_childNodes(&children_list);
-  if (FAILED(hr)) {
-    return hr;
-  }
-
-  long num_children = 0;   // NOLINT
-  hr = children_list->get_length(&num_children);
-  if (FAILED(hr)) {
-    return hr;
-  }
-
-  for (int i = 0; i < num_children; ++i) {
-    CComPtr<IXMLDOMNode> child_node;
-    hr = children_list->get_item(i, &child_node);
-    if (FAILED(hr)) {
-      return hr;
-    }
-
-    DOMNodeType type = NODE_INVALID;
-    hr = child_node->get_nodeType(&type);
-    if (FAILED(hr)) {
-      return hr;
-    }
-
-    ASSERT1(type == NODE_TEXT || type == NODE_ELEMENT || type == NODE_COMMENT);
-
-    if (type == NODE_ELEMENT) {
-      hr = TraverseDOM(child_node);
-      if (FAILED(hr)) {
-        return hr;
-      }
-    }
-  }
-
-  return S_OK;
-}
-
-HRESULT XmlParser::VisitElement(IXMLDOMNode* node) {
-  XMLFQName node_name;
-  HRESULT hr = GetXMLFQName(node, &node_name);
-  if (FAILED(hr)) {
-    CORE_LOG(LE, (_T("[GetXMLFQName failed][0x%x]"), hr));
-    return hr;
-  }
-
-  CORE_LOG(L4, (_T("[element name][%s:%s]"), node_name.uri, node_name.base));
-
-  // Ignore elements not understood.
-  std::unique_ptr<ElementHandler> element_handler;
-  element_handler.reset(element_handler_factory_.CreateObject(node_name.base));
-  if (element_handler.get()) {
-    return element_handler->Handle(node, response_);
-  } else {
-    CORE_LOG(LW, (_T("[VisitElement: don't know how to handle %s:%s]"),
-                  node_name.uri, node_name.base));
-  }
-  return S_OK;
-}
-
 }  // namespace xml
 
 }  // namespace omaha
@@ -27,7 +27,6 @@
 #include <map>
 #include <vector>
 #include "base/basictypes.h"
-#include "base/object_factory.h"
 #include "omaha/common/const_goopdate.h"
 #include "omaha/common/update_request.h"
 #include "omaha/common/update_response.h"
@@ -36,7 +35,7 @@ namespace omaha {
 
 namespace xml {
 
-class ElementHandler;
+class XmlWriter;
 
 CString ConvertProcessorArchitectureToString(DWORD processor_architecture);
 
@@ -45,7 +44,8 @@ CString ConvertProcessorArchitectureToString(DWORD processor_architecture);
 // parser and dealing with stale and dirty data.
 class XmlParser {
  public:
-  // Parses the update response buffer and fills in the UpdateResponse.
+  // Parses the update response buffer and fills in the UpdateResponse. The
+  // buffer is read with a streaming UTF-8 parser, without MSXML.
   // The UpdateResponse object is not modified in case of errors and it can
   // be safely reused for subsequent parsing attempts.
   // TODO(omaha): since the xml docs are strings we could use a CString as
@@ -57,80 +57,52 @@ class XmlParser {
   static HRESULT SerializeRequest(const UpdateRequest& update_request,
                                   CString* buffer);
 
- private:
-  typedef Factory<ElementHandler, CString> ElementHandlerFactory;
-
-  XmlParser();
-  void InitializeElementHandlers();
-  void InitializeLegacyElementHandlers();
+  // Generates the update request as UTF-8, without converting it from
+  // Unicode. The request replaces the contents of |utf8_buffer|, whose memory
+  // is reused.
+  static HRESULT SerializeRequest(const UpdateRequest& update_request,
+                                  CStringA* utf8_buffer);
 
-  // Builds an XML object model corresponding to an xml request.
-  HRESULT BuildDom(const request::Request& request);
+ private:
+  XmlParser(XmlWriter* writer, const request::Request* request);
 
-  // Builds the 'request' element.
+  // Writes the 'request' element.
   HRESULT BuildRequestElement();
 
-  // Creates the 'hw' element.
-  HRESULT BuildHwElement(IXMLDOMNode* parent_node);
+  // Writes the 'hw' element.
+  void BuildHwElement();
 
-  // Creates the 'os' element.
-  HRESULT BuildOsElement(IXMLDOMNode* parent_node);
+  // Writes the 'os' element.
+  void BuildOsElement();
 
-  // Creates the 'app' element. This is usually a sequence of elements.
-  HRESULT BuildAppElement(IXMLDOMNode* parent_node);
+  // Writes the 'app' elements.
+  HRESULT BuildAppElement();
 
   // Adds attributes under the 'app' element corresponding to values with a '_'
   // prefix under the ClientState/ClientStateMedium key.
-  HRESULT AddAppDefinedAttributes(const request::App& app,
-                                  IXMLDOMNode* parent_node);
+  void AddAppDefinedAttributes(const request::App& app);
 
   // Adds cohort attributes under the 'app' element corresponding to values
   // under the ClientState/{AppID}/Cohort key.
-  HRESULT AddCohortAttributes(const request::App& app, IXMLDOMNode* element);
-
-  // Creates the 'updatecheck' element for an application.
-  HRESULT BuildUpdateCheckElement(const request::App& app,
-                                  IXMLDOMNode* parent_node);
-
-  // Creates Ping aka 'event' elements for an application.
-  HRESULT BuildPingRequestElement(const request::App& app,
-                                  IXMLDOMNode* parent_node);
+  void AddCohortAttributes(const request::App& app);
 
-  // Creates the 'data' element for an application.
-  HRESULT BuildDataElement(const request::App& app,
-                           IXMLDOMNode* parent_node);
+  // Writes the 'updatecheck' element for an application.
+  void BuildUpdateCheckElement(const request::App& app);
 
-  // Creates the 'didrun' aka 'active' aka 'ping' element for an application.
-  HRESULT BuildDidRunElement(const request::App& app,
-                             IXMLDOMNode* parent_node);
+  // Writes Ping aka 'event' elements for an application.
+  void BuildPingRequestElement(const request::App& app);
 
-  // Serializes the DOM into a string.
-  HRESULT GetXml(CString* buffer);
+  // Writes the 'data' elements for an application.
+  HRESULT BuildDataElement(const request::App& app);
 
-  // Creates an element in the Update2 xml namespace.
-  HRESULT CreateElementNode(const TCHAR* name,
-                            const TCHAR* value,
-                            IXMLDOMNode** element);
+  // Writes the 'didrun' aka 'active' aka 'ping' element for an application.
+  void BuildDidRunElement(const request::App& app);
 
-  // Starts parsing of the xml document.
-  HRESULT Parse();
-
-  // Does a DFS traversal of the dom.
-  HRESULT TraverseDOM(IXMLDOMNode* node);
-
-  // Handles a single node during traversal.
-  HRESULT VisitElement(IXMLDOMNode* node);
-
-  // The current xml document.
-  CComPtr<IXMLDOMDocument> document_;
+  // Receives the markup of the request. Not owned by this class.
+  XmlWriter* const writer_;
 
   // The xml request being serialized. Not owned by this class.
-  const request::Request* request_;
-
-  // The xml response being deserialized. Not owned by this class.
-  response::Response* response_;
-
-  ElementHandlerFactory element_handler_factory_;
+  const request::Request* const request_;
 
   DISALLOW_COPY_AND_ASSIGN(XmlParser);
 };
@@ -17,11 +17,18 @@
 
 #include <memory>
 #include <windows.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <iostream>
+#include <string>
 #include "base/utils.h"
 
 #include "omaha/base/error.h"
+#include "omaha/base/highres_timer-win32.h"
 #include "omaha/base/reg_key.h"
+#include "omaha/base/xml_utils.h"
 #include "omaha/common/const_group_policy.h"
+#include "omaha/common/ping_event.h"
 #include "omaha/goopdate/update_response_utils.h"
 #include "omaha/testing/unit_test.h"
 
@@ -56,6 +63,42 @@ class XmlParserTest : public ::testing::TestWithParam<bool> {
   request::Request& get_xml_request(UpdateRequest* update_request) {
     return update_request->request_;
   }
+
+  static std::vector<uint8> ToBuffer(const std::string& str) {
+    return std::vector<uint8>(str.begin(), str.end());
+  }
+
+  // Returns a response for |num_apps| applications, each with a full update.
+  static std::string MakeLargeResponse(int num_apps) {
+    std::string response(
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+        "<response protocol=\"3.0\" server=\"prod\">"
+        "<daystart elapsed_seconds=\"8400\" elapsed_days=\"3255\"/>");
+    for (int i = 0; i != num_apps; ++i) {
+      CStringA appid;
+      appid.Format("{8A69D345-D564-463C-AFF1-%012d}", i);
+      response += "<app appid=\"" + std::string(appid) + "\" status=\"ok\" "
+          "cohort=\"1:1:\" cohortname=\"Stable\">"
+          "<updatecheck status=\"ok\"><urls>"
+          "<url codebase=\"http://dl.google.com/edgedl/release2/chrome/\"/>"
+          "<url codebase=\"https://dl.google.com/edgedl/release2/chrome/\"/>"
+          "</urls><manifest version=\"52.0.2743.116\"><packages>"
+          "<package hash_sha256=\"d5e06b4436c5e33f2de88298b890f47815fc657b6"
+          "3b3050d2217c55a5d0730b0\" hash=\"NT/6ilbSjWgbVqHZ0rT1vTg1coE=\" "
+          "name=\"52.0.2743.116_chrome_installer.exe\" required=\"true\" "
+          "size=\"47395768\"/></packages><actions>"
+          "<action arguments=\"--verbose-logging --do-not-launch-chrome\" "
+          "event=\"install\" run=\"52.0.2743.116_chrome_installer.exe\"/>"
+          "<action event=\"postinstall\" version=\"52.0.2743.116\" "
+          "onsuccess=\"exitsilentlyonlaunchcmd\"/>"
+          "</actions></manifest></updatecheck>"
+          "<data index=\"verboselogging\" name=\"install\" status=\"ok\">"
+          "{&quot;distribution&quot;: {&quot;verbose_logging&quot;: true}}"
+          "</data><ping status=\"ok\"/></app>";
+    }
+    response += "</response>";
+    return response;
+  }
 };
 
 // Creates a machine update request and serializes it.
@@ -284,7 +327,7 @@ TEST_F(XmlParserTest, Parse) {
     const InstallPackage& install_package(install_manifest.packages[0]);
     EXPECT_STREQ(_T("chrome_installer.exe"), install_package.name);
     EXPECT_TRUE(install_package.is_required);
-    EXPECT_EQ(9614320, install_package.size);
+    EXPECT_EQ(9614320ULL, install_package.size);
     EXPECT_STREQ(_T("NT/6ilbSjWgbVqHZ0rT1vTg1coE="), install_package.hash_sha1);
     EXPECT_STREQ(
         _T("d5e06b4436c5e33f2de88298b890f47815fc657b63b3050d2217c55a5d0730b0"),
@@ -360,7 +403,7 @@ TEST_F(XmlParserTest, Parse_InvalidDataStatusError) {
   const InstallPackage& install_package(install_manifest.packages[0]);
   EXPECT_STREQ(_T("chrome_installer.exe"), install_package.name);
   EXPECT_FALSE(install_package.is_required);
-  EXPECT_EQ(9614320, install_package.size);
+  EXPECT_EQ(9614320ULL, install_package.size);
   EXPECT_STREQ(_T("NT/6ilbSjWgbVqHZ0rT1vTg1coE="), install_package.hash_sha1);
   EXPECT_STREQ(
       _T("d5e06b4436c5e33f2de88298b890f47815fc657b63b3050d2217c55a5d0730b0"),
@@ -393,6 +436,295 @@ TEST_F(XmlParserTest, Parse_InvalidDataStatusError) {
             update_response_utils::ValidateUntrustedData(app.data));
 }
 
+// Package sizes do not fit in 32 bits for packages larger than 4GB.
+TEST_F(XmlParserTest, Parse_LargePackageSize) {
+  CStringA buffer_string = "<?xml version=\"1.0\" encoding=\"UTF-8\"?><response protocol=\"3.0\"><app appid=\"{8A69D345-D564-463C-AFF1-A69D9E530F96}\" status=\"ok\"><updatecheck status=\"ok\"><urls><url codebase=\"http://cache.pack.google.com/edgedl/chrome/install/172.37/\"/></urls><manifest version=\"2.0.172.37\"><packages><package hash_sha256=\"d5e06b4436c5e33f2de88298b890f47815fc657b63b3050d2217c55a5d0730b0\" name=\"chrome_installer.exe\" required=\"true\" size=\"5368709120\"/></packages></manifest></updatecheck></app></response>";  // NOLINT
+  std::vector<uint8> buffer(buffer_string.GetLength());
+  memcpy(&buffer.front(), buffer_string, buffer.size());
+
+  std::unique_ptr<UpdateResponse> update_response(UpdateResponse::Create());
+  EXPECT_HRESULT_SUCCEEDED(XmlParser::DeserializeResponse(
+      buffer,
+      update_response.get()));
+  const response::Response& xml_response(update_response->response());
+  ASSERT_EQ(1, xml_response.apps.size());
+
+  const InstallManifest& install_manifest(
+      xml_response.apps[0].update_check.install_manifest);
+  ASSERT_EQ(1, install_manifest.packages.size());
+  EXPECT_EQ(5368709120ULL, install_manifest.packages[0].size);
+}
+
+// Negative package sizes are rejected.
+TEST_F(XmlParserTest, Parse_NegativePackageSize) {
+  CStringA buffer_string = "<?xml version=\"1.0\" encoding=\"UTF-8\"?><response protocol=\"3.0\"><app appid=\"{8A69D345-D564-463C-AFF1-A69D9E530F96}\" status=\"ok\"><updatecheck status=\"ok\"><urls><url codebase=\"http://cache.pack.google.com/edgedl/chrome/install/172.37/\"/></urls><manifest version=\"2.0.172.37\"><packages><package hash_sha256=\"d5e06b4436c5e33f2de88298b890f47815fc657b63b3050d2217c55a5d0730b0\" name=\"chrome_installer.exe\" required=\"true\" size=\"-1\"/></packages></manifest></updatecheck></app></response>";  // NOLINT
+  std::vector<uint8> buffer(buffer_string.GetLength());
+  memcpy(&buffer.front(), buffer_string, buffer.size());
+
+  std::unique_ptr<UpdateResponse> update_response(UpdateResponse::Create());
+  EXPECT_HRESULT_FAILED(XmlParser::DeserializeResponse(
+      buffer,
+      update_response.get()));
+}
+
+// The differential package is parsed along with the full package.
+TEST_F(XmlParserTest, Parse_DifferentialPackage) {
+  CStringA buffer_string = "<?xml version=\"1.0\" encoding=\"UTF-8\"?><response protocol=\"3.0\"><app appid=\"{8A69D345-D564-463C-AFF1-A69D9E530F96}\" status=\"ok\"><updatecheck status=\"ok\"><urls><url codebase=\"http://cache.pack.google.com/edgedl/chrome/install/172.37/\"/></urls><manifest version=\"2.0.172.37\"><packages><package hash_sha256=\"d5e06b4436c5e33f2de88298b890f47815fc657b63b3050d2217c55a5d0730b0\" name=\"chrome_installer.exe\" required=\"true\" size=\"9614320\" namediff=\"chrome_installer_diff.exe\" sizediff=\"123456\" hashdiff_sha256=\"0bd4e2ac5a4d2e1d7a3d9b4c8cc22d3ea0e0c16c3a5f0f4c3df8c2b26a2ba6e1\" basehash_sha256=\"8e38b8c5ad8af7d5f8b9c0e2d5f2a4cb6b56ddc3e4e2e1a9a8a2a7ba8f0d4f5e\"/></packages></manifest></updatecheck></app></response>";  // NOLINT
+  std::vector<uint8> buffer(buffer_string.GetLength());
+  memcpy(&buffer.front(), buffer_string, buffer.size());
+
+  std::unique_ptr<UpdateResponse> update_response(UpdateResponse::Create());
+  EXPECT_HRESULT_SUCCEEDED(XmlParser::DeserializeResponse(
+      buffer,
+      update_response.get()));
+  const response::Response& xml_response(update_response->response());
+  ASSERT_EQ(1, xml_response.apps.size());
+
+  const InstallManifest& install_manifest(
+      xml_response.apps[0].update_check.install_manifest);
+  ASSERT_EQ(1, install_manifest.packages.size());
+  const InstallPackage& install_package(install_manifest.packages[0]);
+  EXPECT_STREQ(_T("chrome_installer.exe"), install_package.name);
+  EXPECT_EQ(9614320, install_package.size);
+  EXPECT_STREQ(_T("chrome_installer_diff.exe"), install_package.name_diff);
+  EXPECT_EQ(123456, install_package.size_diff);
+  EXPECT_STREQ(
+      _T("0bd4e2ac5a4d2e1d7a3d9b4c8cc22d3ea0e0c16c3a5f0f4c3df8c2b26a2ba6e1"),
+      install_package.hash_diff_sha256);
+  EXPECT_STREQ(
+      _T("8e38b8c5ad8af7d5f8b9c0e2d5f2a4cb6b56ddc3e4e2e1a9a8a2a7ba8f0d4f5e"),
+      install_package.base_hash_sha256);
+}
+
+// A differential package without the hash of its base is ignored, and the
+// full package is still parsed.
+TEST_F(XmlParserTest, Parse_IncompleteDifferentialPackage) {
+  CStringA buffer_string = "<?xml version=\"1.0\" encoding=\"UTF-8\"?><response protocol=\"3.0\"><app appid=\"{8A69D345-D564-463C-AFF1-A69D9E530F96}\" status=\"ok\"><updatecheck status=\"ok\"><urls><url codebase=\"http://cache.pack.google.com/edgedl/chrome/install/172.37/\"/></urls><manifest version=\"2.0.172.37\"><packages><package hash_sha256=\"d5e06b4436c5e33f2de88298b890f47815fc657b63b3050d2217c55a5d0730b0\" name=\"chrome_installer.exe\" required=\"true\" size=\"9614320\" namediff=\"chrome_installer_diff.exe\" sizediff=\"123456\" hashdiff_sha256=\"0bd4e2ac5a4d2e1d7a3d9b4c8cc22d3ea0e0c16c3a5f0f4c3df8c2b26a2ba6e1\"/></packages></manifest></updatecheck></app></response>";  // NOLINT
+  std::vector<uint8> buffer(buffer_string.GetLength());
+  memcpy(&buffer.front(), buffer_string, buffer.size());
+
+  std::unique_ptr<UpdateResponse> update_response(UpdateResponse::Create());
+  EXPECT_HRESULT_SUCCEEDED(XmlParser::DeserializeResponse(
+      buffer,
+      update_response.get()));
+  const response::Response& xml_response(update_response->response());
+  ASSERT_EQ(1, xml_response.apps.size());
+
+  const InstallManifest& install_manifest(
+      xml_response.apps[0].update_check.install_manifest);
+  ASSERT_EQ(1, install_manifest.packages.size());
+  EXPECT_STREQ(_T("chrome_installer.exe"), install_manifest.packages[0].name);
+  EXPECT_TRUE(install_manifest.packages[0].name_diff.IsEmpty());
+  EXPECT_EQ(0, install_manifest.packages[0].size_diff);
+  EXPECT_TRUE(install_manifest.packages[0].hash_diff_sha256.IsEmpty());
+}
+
+// A differential package with a malformed size is ignored, and the full
+// package is still parsed.
+TEST_F(XmlParserTest, Parse_MalformedDifferentialPackageSize) {
+  CStringA buffer_string = "<?xml version=\"1.0\" encoding=\"UTF-8\"?><response protocol=\"3.0\"><app appid=\"{8A69D345-D564-463C-AFF1-A69D9E530F96}\" status=\"ok\"><updatecheck status=\"ok\"><urls><url codebase=\"http://cache.pack.google.com/edgedl/chrome/install/172.37/\"/></urls><manifest version=\"2.0.172.37\"><packages><package hash_sha256=\"d5e06b4436c5e33f2de88298b890f47815fc657b63b3050d2217c55a5d0730b0\" name=\"chrome_installer.exe\" required=\"true\" size=\"9614320\" namediff=\"chrome_installer_diff.exe\" sizediff=\"12x456\" hashdiff_sha256=\"0bd4e2ac5a4d2e1d7a3d9b4c8cc22d3ea0e0c16c3a5f0f4c3df8c2b26a2ba6e1\" basehash_sha256=\"8e38b8c5ad8af7d5f8b9c0e2d5f2a4cb6b56ddc3e4e2e1a9a8a2a7ba8f0d4f5e\"/></packages></manifest></updatecheck></app></response>";  // NOLINT
+  std::vector<uint8> buffer(buffer_string.GetLength());
+  memcpy(&buffer.front(), buffer_string, buffer.size());
+
+  std::unique_ptr<UpdateResponse> update_response(UpdateResponse::Create());
+  EXPECT_HRESULT_SUCCEEDED(XmlParser::DeserializeResponse(
+      buffer,
+      update_response.get()));
+  const response::Response& xml_response(update_response->response());
+  ASSERT_EQ(1, xml_response.apps.size());
+
+  const InstallManifest& install_manifest(
+      xml_response.apps[0].update_check.install_manifest);
+  ASSERT_EQ(1, install_manifest.packages.size());
+  EXPECT_STREQ(_T("chrome_installer.exe"), install_manifest.packages[0].name);
+  EXPECT_EQ(9614320, install_manifest.packages[0].size);
+  EXPECT_TRUE(install_manifest.packages[0].name_diff.IsEmpty());
+  EXPECT_EQ(0, install_manifest.packages[0].size_diff);
+}
+
+// Elements which belong to an application are rejected outside of one.
+TEST_F(XmlParserTest, Parse_ElementOutsideApp) {
+  const std::string buffer_string = "<?xml version=\"1.0\" encoding=\"UTF-8\"?><response protocol=\"3.0\"><updatecheck status=\"ok\"/></response>";  // NOLINT
+
+  std::unique_ptr<UpdateResponse> update_response(UpdateResponse::Create());
+  EXPECT_EQ(GOOPDATEXML_E_PARSE_ERROR, XmlParser::DeserializeResponse(
+      ToBuffer(buffer_string),
+      update_response.get()));
+}
+
+// The values which the parser does not expect from the server are rejected
+// rather than asserted, since the server controls them.
+TEST_F(XmlParserTest, Parse_UnexpectedValues) {
+  const char* const kResponses[] = {
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?><response protocol=\"3.0\"><app appid=\"{8A69D345-D564-463C-AFF1-A69D9E530F96}\" status=\"ok\"><data name=\"unknown\" status=\"ok\"/></app></response>",  // NOLINT
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?><response protocol=\"3.0\"><daystart elapsed_seconds=\"8400\" elapsed_days=\"12\"/></response>",  // NOLINT
+  };
+
+  for (size_t i = 0; i != arraysize(kResponses); ++i) {
+    std::unique_ptr<UpdateResponse> update_response(UpdateResponse::Create());
+    EXPECT_EQ(GOOPDATEXML_E_PARSE_ERROR, XmlParser::DeserializeResponse(
+        ToBuffer(kResponses[i]),
+        update_response.get())) << i;
+  }
+}
+
+// The status of a ping or event acknowledgement is not checked, so that it
+// does not fail the update check of the apps in the response.
+TEST_F(XmlParserTest, Parse_UnexpectedAcknowledgementStatus) {
+  const char* const kResponses[] = {
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?><response protocol=\"3.0\"><app appid=\"{8A69D345-D564-463C-AFF1-A69D9E530F96}\" status=\"ok\"><ping status=\"error\"/></app></response>",  // NOLINT
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?><response protocol=\"3.0\"><app appid=\"{8A69D345-D564-463C-AFF1-A69D9E530F96}\" status=\"ok\"><event status=\"error\"/></app></response>",  // NOLINT
+  };
+
+  for (size_t i = 0; i != arraysize(kResponses); ++i) {
+    std::unique_ptr<UpdateResponse> update_response(UpdateResponse::Create());
+    EXPECT_HRESULT_SUCCEEDED(XmlParser::DeserializeResponse(
+        ToBuffer(kResponses[i]),
+        update_response.get())) << i;
+    EXPECT_EQ(1, update_response->response().apps.size()) << i;
+  }
+}
+
+// Unknown success actions fall back to the default action, so that new
+// actions do not break older clients.
+TEST_F(XmlParserTest, Parse_UnknownSuccessAction) {
+  const std::string buffer_string = "<?xml version=\"1.0\" encoding=\"UTF-8\"?><response protocol=\"3.0\"><app appid=\"{8A69D345-D564-463C-AFF1-A69D9E530F96}\" status=\"ok\"><updatecheck status=\"ok\"><urls><url codebase=\"http://cache.pack.google.com/edgedl/chrome/install/172.37/\"/></urls><manifest version=\"2.0.172.37\"><packages><package hash_sha256=\"d5e06b4436c5e33f2de88298b890f47815fc657b63b3050d2217c55a5d0730b0\" name=\"chrome_installer.exe\" required=\"true\" size=\"9614320\"/></packages><actions><action event=\"postinstall\" onsuccess=\"somenewaction\"/></actions></manifest></updatecheck></app></response>";  // NOLINT
+
+  std::unique_ptr<UpdateResponse> update_response(UpdateResponse::Create());
+  ASSERT_HRESULT_SUCCEEDED(XmlParser::DeserializeResponse(
+      ToBuffer(buffer_string),
+      update_response.get()));
+
+  const response::Response& xml_response(update_response->response());
+  ASSERT_EQ(1, xml_response.apps.size());
+  const InstallManifest& install_manifest(
+      xml_response.apps[0].update_check.install_manifest);
+  ASSERT_EQ(1, install_manifest.install_actions.size());
+  EXPECT_EQ(SUCCESS_ACTION_DEFAULT,
+            install_manifest.install_actions[0].success_action);
+}
+
+TEST_F(XmlParserTest, Parse_UnknownRootElement) {
+  const std::string buffer_string = "<?xml version=\"1.0\" encoding=\"UTF-8\"?><request protocol=\"3.0\"><app appid=\"{8A69D345-D564-463C-AFF1-A69D9E530F96}\" status=\"ok\"/></request>";  // NOLINT
+
+  std::unique_ptr<UpdateResponse> update_response(UpdateResponse::Create());
+  EXPECT_EQ(GOOPDATEXML_E_RESPONSENODE, XmlParser::DeserializeResponse(
+      ToBuffer(buffer_string),
+      update_response.get()));
+}
+
+// The v2 elements are read when the root element is 'gupdate', including the
+// namespace prefixes and the references.
+TEST_F(XmlParserTest, Parse_V2) {
+  const std::string buffer_string = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\r\n<g:gupdate xmlns:g=\"http://www.google.com/update2/response\" protocol=\"2.0\"><g:app appid=\"{CDABE316-39CD-43BA-8440-6D1E0547AEE6}\" status=\"ok\"><g:updatecheck Version=\"1.2.3.4\" arguments=\"--a=&quot;b c&quot; &amp;\" codebase=\"http://dl.google.com/foo/install/1.2.3.4/foo_installer.exe\" hash=\"abcdef\" size=\"80896\" status=\"ok\" onsuccess=\"exitsilently\"/></g:app></g:gupdate>";  // NOLINT
+
+  std::unique_ptr<UpdateResponse> update_response(UpdateResponse::Create());
+  ASSERT_HRESULT_SUCCEEDED(XmlParser::DeserializeResponse(
+      ToBuffer(buffer_string),
+      update_response.get()));
+
+  const response::Response& xml_response(update_response->response());
+  EXPECT_STREQ(_T("2.0"), xml_response.protocol);
+  ASSERT_EQ(1, xml_response.apps.size());
+
+  const response::UpdateCheck& update_check(xml_response.apps[0].update_check);
+  EXPECT_STREQ(_T("ok"), update_check.status);
+  ASSERT_EQ(1, update_check.urls.size());
+  EXPECT_STREQ(_T("http://dl.google.com/foo/install/1.2.3.4/"),
+               update_check.urls[0]);
+
+  const InstallManifest& install_manifest(update_check.install_manifest);
+  EXPECT_STREQ(_T("1.2.3.4"), install_manifest.version);
+  ASSERT_EQ(1, install_manifest.packages.size());
+  EXPECT_STREQ(_T("foo_installer.exe"), install_manifest.packages[0].name);
+  EXPECT_EQ(80896ULL, install_manifest.packages[0].size);
+  EXPECT_STREQ(_T("abcdef"), install_manifest.packages[0].hash_sha1);
+
+  ASSERT_EQ(2, install_manifest.install_actions.size());
+  EXPECT_EQ(InstallAction::kInstall,
+            install_manifest.install_actions[0].install_event);
+  EXPECT_STREQ(_T("--a=\"b c\" &"),
+               install_manifest.install_actions[0].program_arguments);
+  EXPECT_EQ(InstallAction::kPostInstall,
+            install_manifest.install_actions[1].install_event);
+  EXPECT_EQ(SUCCESS_ACTION_EXIT_SILENTLY,
+            install_manifest.install_actions[1].success_action);
+}
+
+// Non-ASCII attribute values are converted from UTF-8.
+TEST_F(XmlParserTest, Parse_Utf8) {
+  const std::string buffer_string = "\xef\xbb\xbf<?xml version=\"1.0\" encoding=\"UTF-8\"?><response protocol=\"3.0\"><app appid=\"{8A69D345-D564-463C-AFF1-A69D9E530F96}\" status=\"ok\" cohortname=\"Caf\xc3\xa9 &#x20AC;\"/></response>";  // NOLINT
+
+  std::unique_ptr<UpdateResponse> update_response(UpdateResponse::Create());
+  ASSERT_HRESULT_SUCCEEDED(XmlParser::DeserializeResponse(
+      ToBuffer(buffer_string),
+      update_response.get()));
+
+  const response::Response& xml_response(update_response->response());
+  ASSERT_EQ(1, xml_response.apps.size());
+  EXPECT_STREQ(L"Caf\x00e9 \x20ac", xml_response.apps[0].cohort_name);
+}
+
+// Truncated responses are rejected and leave the UpdateResponse unchanged.
+// Corrupted responses are either read or rejected.
+TEST_F(XmlParserTest, Parse_Fuzz) {
+  const std::string buffer_string(MakeLargeResponse(2));
+
+  for (size_t i = 1; i != buffer_string.size(); ++i) {
+    std::unique_ptr<UpdateResponse> update_response(UpdateResponse::Create());
+    EXPECT_HRESULT_FAILED(XmlParser::DeserializeResponse(
+        ToBuffer(buffer_string.substr(0, i)),
+        update_response.get())) << i;
+    EXPECT_TRUE(update_response->response().apps.empty());
+  }
+
+  srand(1);
+  for (int i = 0; i != 5000; ++i) {
+    std::vector<uint8> buffer(ToBuffer(buffer_string));
+    const int num_changes = 1 + rand() % 4;
+    for (int j = 0; j != num_changes; ++j) {
+      buffer[rand() % buffer.size()] = static_cast<uint8>(rand());
+    }
+
+    std::unique_ptr<UpdateResponse> update_response(UpdateResponse::Create());
+    XmlParser::DeserializeResponse(buffer, update_response.get());
+  }
+}
+
+// Reports how fast large responses are read, next to the time MSXML takes to
+// only load the same response into a DOM.
+TEST_F(XmlParserTest, DISABLED_ParseThroughput) {
+  const int kNumApps[] = { 100, 1000, 10000 };
+  for (size_t i = 0; i != arraysize(kNumApps); ++i) {
+    const std::vector<uint8> buffer(ToBuffer(MakeLargeResponse(kNumApps[i])));
+    const int kIterations = std::max(1, 10000 / kNumApps[i]);
+
+    HighresTimer timer;
+    for (int j = 0; j != kIterations; ++j) {
+      std::unique_ptr<UpdateResponse> update_response(
+          UpdateResponse::Create());
+      ASSERT_HRESULT_SUCCEEDED(XmlParser::DeserializeResponse(
+          buffer,
+          update_response.get()));
+      ASSERT_EQ(kNumApps[i], update_response->response().apps.size());
+    }
+    const ULONGLONG parse_ms = std::max<ULONGLONG>(timer.GetElapsedMs(), 1);
+
+    timer.Start();
+    for (int j = 0; j != kIterations; ++j) {
+      CComPtr<IXMLDOMDocument> document;
+      ASSERT_HRESULT_SUCCEEDED(LoadXMLFromRawData(buffer, false, &document));
+    }
+    const ULONGLONG dom_ms = std::max<ULONGLONG>(timer.GetElapsedMs(), 1);
+
+    const ULONGLONG kb = buffer.size() * kIterations / 1024;
+    std::cout << kNumApps[i] << " apps, " << buffer.size() << " bytes: "
+              << "pull parser " << kb * 1000 / parse_ms / 1024 << " MB/s, "
+              << "MSXML load only " << kb * 1000 / dom_ms / 1024 << " MB/s"
+              << std::endl;
+  }
+}
+
 TEST_F(XmlParserTest, Serialize_WithInvalidXmlCharacters) {
   std::unique_ptr<UpdateRequest> update_request(
       UpdateRequest::Create(false, _T("sid"), _T("is"), _T("http://foo/\"")));
@@ -440,6 +772,137 @@ TEST_F(XmlParserTest, Serialize_WithInvalidXmlCharacters) {
   EXPECT_STREQ(expected_buffer, actual_buffer);
 }
 
+// The UTF-8 request is the conversion of the Unicode request, and the
+// attributes of the events are written in order.
+TEST_F(XmlParserTest, Serialize_Utf8) {
+  std::unique_ptr<UpdateRequest> update_request(
+      UpdateRequest::Create(false, _T("sid"), _T("is"), _T("")));
+
+  request::Request& xml_request = get_xml_request(update_request.get());
+
+  xml_request.omaha_version = _T("1.3.99.0");
+  xml_request.omaha_shell_version = _T("1.2.1.1");
+  xml_request.test_source = _T("dev");
+  xml_request.request_id = _T("{387E2718-B39C-4458-98CC-24B5293C8385}");
+  xml_request.domain_joined = false;
+  xml_request.hw.physmemory = 16;
+  xml_request.hw.has_sse = true;
+  xml_request.hw.has_sse2 = true;
+  xml_request.hw.has_sse3 = true;
+  xml_request.hw.has_ssse3 = true;
+  xml_request.hw.has_sse41 = true;
+  xml_request.hw.has_sse42 = true;
+  xml_request.hw.has_avx = true;
+  xml_request.os.platform = _T("win");
+  xml_request.os.version = _T("10.0");
+  xml_request.os.service_pack = _T("");
+  xml_request.os.arch = _T("x64");
+  xml_request.check_period_sec = -1;
+  xml_request.uid.Empty();
+
+  request::Data data;
+  data.name = _T("untrusted");
+  data.untrusted_data = _T("caf\x00e9=<\x4e2d\x6587>&\xd83d\xde00");
+
+  request::App app;
+  app.app_id = _T("{8A69D345-D564-463C-AFF1-A69D9E530F96}");
+  app.lang = _T("fr");
+  app.brand_code = _T("\x00c9T\x00c9");
+  app.iid = GuidToString(GUID_NULL);  // Prevents assert.
+  app.ping_events.push_back(PingEventPtr(
+      new PingEvent(PingEvent::EVENT_UPDATE_COMPLETE,
+                    PingEvent::EVENT_RESULT_ERROR,
+                    -2147418113,
+                    10,
+                    1,
+                    20,
+                    30,
+                    5000000000ULL,
+                    6000000000ULL,
+                    40)));
+  app.data.push_back(data);
+  xml_request.apps.push_back(app);
+
+  const char kExpectedBuffer[] = "<?xml version=\"1.0\" encoding=\"UTF-8\"?><request protocol=\"3.0\" updater=\"Omaha\" updaterversion=\"1.3.99.0\" shell_version=\"1.2.1.1\" ismachine=\"0\" sessionid=\"sid\" installsource=\"is\" testsource=\"dev\" requestid=\"{387E2718-B39C-4458-98CC-24B5293C8385}\" dedup=\"cr\" domainjoined=\"0\"><hw physmemory=\"16\" sse=\"1\" sse2=\"1\" sse3=\"1\" ssse3=\"1\" sse41=\"1\" sse42=\"1\" avx=\"1\"/><os platform=\"win\" version=\"10.0\" sp=\"\" arch=\"x64\"/><app appid=\"{8A69D345-D564-463C-AFF1-A69D9E530F96}\" version=\"\" nextversion=\"\" lang=\"fr\" brand=\"\xc3\x89T\xc3\x89\" client=\"\"><event eventtype=\"3\" eventresult=\"0\" errorcode=\"-2147418113\" extracode1=\"10\" source_url_index=\"1\" update_check_time_ms=\"20\" download_time_ms=\"30\" downloaded=\"5000000000\" total=\"6000000000\" install_time_ms=\"40\"/><data name=\"untrusted\">caf\xc3\xa9=&lt;\xe4\xb8\xad\xe6\x96\x87&gt;&amp;\xf0\x9f\x98\x80</data></app></request>";  // NOLINT
+
+  CStringA utf8_buffer;
+  EXPECT_HRESULT_SUCCEEDED(XmlParser::SerializeRequest(*update_request,
+                                                       &utf8_buffer));
+  EXPECT_STREQ(kExpectedBuffer, utf8_buffer);
+
+  CString buffer;
+  EXPECT_HRESULT_SUCCEEDED(XmlParser::SerializeRequest(*update_request,
+                                                       &buffer));
+  EXPECT_STREQ(kExpectedBuffer, WideToUtf8(buffer));
+
+  // The buffer is overwritten when it is reused.
+  EXPECT_HRESULT_SUCCEEDED(update_request->Serialize(&utf8_buffer));
+  EXPECT_STREQ(kExpectedBuffer, utf8_buffer);
+}
+
+// Reports how fast requests for many applications are serialized to UTF-8,
+// next to the time MSXML takes to only serialize the same request from a DOM
+// and convert it to UTF-8.
+TEST_F(XmlParserTest, DISABLED_SerializeThroughput) {
+  const int kNumApps[] = { 50, 100, 500 };
+  for (size_t i = 0; i != arraysize(kNumApps); ++i) {
+    std::unique_ptr<UpdateRequest> update_request(
+        UpdateRequest::Create(true, _T("sid"), _T("is"), _T("")));
+    request::Request& xml_request = get_xml_request(update_request.get());
+    xml_request.omaha_version = _T("1.3.99.0");
+    xml_request.os.platform = _T("win");
+    xml_request.os.version = _T("10.0");
+    for (int j = 0; j != kNumApps[i]; ++j) {
+      request::App app;
+      app.app_id.Format(_T("{8A69D345-D564-463C-AFF1-%012d}"), j);
+      app.version = _T("52.0.2743.116");
+      app.lang = _T("en");
+      app.brand_code = _T("GGLS");
+      app.ap = _T("x64-stable-multi-chrome");
+      app.iid = GuidToString(GUID_NULL);  // Prevents assert.
+      app.cohort = _T("1:1:");
+      app.cohort_name = _T("Stable");
+      app.update_check.is_valid = true;
+      app.ping_events.push_back(PingEventPtr(
+          new PingEvent(PingEvent::EVENT_UPDATE_COMPLETE,
+                        PingEvent::EVENT_RESULT_SUCCESS,
+                        0,
+                        0)));
+      app.ping.active = ACTIVE_RUN;
+      app.ping.days_since_last_active_ping = 1;
+      app.ping.days_since_last_roll_call = 1;
+      app.ping.ping_freshness = _T("{d0d8cb57-ca4a-4e82-8196-84f47c0ca085}");
+      xml_request.apps.push_back(app);
+    }
+    const int kIterations = std::max(1, 10000 / kNumApps[i]);
+
+    CStringA utf8_buffer;
+    HighresTimer timer;
+    for (int j = 0; j != kIterations; ++j) {
+      ASSERT_HRESULT_SUCCEEDED(update_request->Serialize(&utf8_buffer));
+    }
+    const ULONGLONG writer_ms = std::max<ULONGLONG>(timer.GetElapsedMs(), 1);
+
+    std::vector<uint8> raw_request(utf8_buffer.GetLength());
+    memcpy(&raw_request.front(), utf8_buffer.GetString(), raw_request.size());
+    CComPtr<IXMLDOMDocument> document;
+    ASSERT_HRESULT_SUCCEEDED(LoadXMLFromRawData(raw_request, false, &document));
+
+    timer.Start();
+    for (int j = 0; j != kIterations; ++j) {
+      CComBSTR xml;
+      ASSERT_HRESULT_SUCCEEDED(document->get_xml(&xml));
+      ASSERT_FALSE(WideToUtf8(CString(xml)).IsEmpty());
+    }
+    const ULONGLONG dom_ms = std::max<ULONGLONG>(timer.GetElapsedMs(), 1);
+
+    std::cout << kNumApps[i] << " apps, " << utf8_buffer.GetLength()
+              << " bytes: writer " << kIterations * 1000 / writer_ms
+              << " requests/s, MSXML serialize only "
+              << kIterations * 1000 / dom_ms << " requests/s" << std::endl;
+  }
+}
+
 TEST_F(XmlParserTest, HwAttributes) {
   std::unique_ptr<UpdateRequest> update_request(
       UpdateRequest::Create(false, _T(""), _T("is"), _T("")));
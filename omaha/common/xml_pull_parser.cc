@@ -0,0 +1,624 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/common/xml_pull_parser.h"
+
+#include <string.h>
+
+namespace omaha {
+
+namespace xml {
+
+namespace {
+
+// Bounds the work done for each element, since the attribute names of an
+// element are compared with each other to find duplicates.
+const size_t kMaxAttributes = 256;
+
+// The longest reference the parser accepts, without the '&' and the ';'.
+const size_t kMaxReferenceLength = 16;
+
+bool IsWhitespace(uint8 c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+// Any byte of a multibyte UTF-8 sequence is accepted in names. The sequences
+// themselves are validated with the rest of the document.
+bool IsNameStartChar(uint8 c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         c == '_' || c == ':' || c >= 0x80;
+}
+
+bool IsNameChar(uint8 c) {
+  return IsNameStartChar(c) || (c >= '0' && c <= '9') || c == '-' || c == '.';
+}
+
+bool IsXmlChar(uint32 code_point) {
+  return code_point == 0x9 || code_point == 0xa || code_point == 0xd ||
+         (code_point >= 0x20 && code_point <= 0xd7ff) ||
+         (code_point >= 0xe000 && code_point <= 0xfffd) ||
+         (code_point >= 0x10000 && code_point <= 0x10ffff);
+}
+
+// Returns true if |data| is well-formed UTF-8 and only contains characters
+// allowed in XML documents.
+bool IsValidDocumentText(const uint8* data, size_t size) {
+  size_t i = 0;
+  while (i < size) {
+    const uint8 c = data[i];
+    if (c < 0x80) {
+      if (c < 0x20 && !IsWhitespace(c)) {
+        return false;
+      }
+      ++i;
+      continue;
+    }
+
+    size_t length = 0;
+    uint32 code_point = 0;
+    uint32 min_code_point = 0;
+    if ((c & 0xe0) == 0xc0) {
+      length = 2;
+      code_point = c & 0x1f;
+      min_code_point = 0x80;
+    } else if ((c & 0xf0) == 0xe0) {
+      length = 3;
+      code_point = c & 0x0f;
+      min_code_point = 0x800;
+    } else if ((c & 0xf8) == 0xf0) {
+      length = 4;
+      code_point = c & 0x07;
+      min_code_point = 0x10000;
+    } else {
+      return false;
+    }
+
+    if (size - i < length) {
+      return false;
+    }
+    for (size_t j = 1; j != length; ++j) {
+      if ((data[i + j] & 0xc0) != 0x80) {
+        return false;
+      }
+      code_point = (code_point << 6) | (data[i + j] & 0x3f);
+    }
+
+    // Overlong sequences encode a character with more bytes than needed.
+    if (code_point < min_code_point || !IsXmlChar(code_point)) {
+      return false;
+    }
+    i += length;
+  }
+  return true;
+}
+
+void AppendUtf8(uint32 code_point, std::string* out) {
+  if (code_point < 0x80) {
+    *out += static_cast<char>(code_point);
+  } else if (code_point < 0x800) {
+    *out += static_cast<char>(0xc0 | (code_point >> 6));
+    *out += static_cast<char>(0x80 | (code_point & 0x3f));
+  } else if (code_point < 0x10000) {
+    *out += static_cast<char>(0xe0 | (code_point >> 12));
+    *out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3f));
+    *out += static_cast<char>(0x80 | (code_point & 0x3f));
+  } else {
+    *out += static_cast<char>(0xf0 | (code_point >> 18));
+    *out += static_cast<char>(0x80 | ((code_point >> 12) & 0x3f));
+    *out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3f));
+    *out += static_cast<char>(0x80 | (code_point & 0x3f));
+  }
+}
+
+// Appends [begin, end) to |out|, replacing CR LF pairs and lone CRs with LF.
+void AppendNormalizingLineBreaks(const uint8* begin,
+                                 const uint8* end,
+                                 std::string* out) {
+  while (begin != end) {
+    const uint8* cr = static_cast<const uint8*>(
+        memchr(begin, '\r', end - begin));
+    if (!cr) {
+      out->append(reinterpret_cast<const char*>(begin), end - begin);
+      return;
+    }
+    out->append(reinterpret_cast<const char*>(begin), cr - begin);
+    *out += '\n';
+    begin = cr + 1;
+    if (begin != end && *begin == '\n') {
+      ++begin;
+    }
+  }
+}
+
+bool EqualsAsciiNoCase(const std::string& str, const char* ascii) {
+  const size_t length = strlen(ascii);
+  if (str.size() != length) {
+    return false;
+  }
+  for (size_t i = 0; i != length; ++i) {
+    char c = str[i];
+    if (c >= 'A' && c <= 'Z') {
+      c = static_cast<char>(c - 'A' + 'a');
+    }
+    if (c != ascii[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void StripPrefix(std::string* name) {
+  const size_t colon = name->rfind(':');
+  if (colon != std::string::npos) {
+    name->erase(0, colon + 1);
+  }
+}
+
+}  // namespace
+
+XmlPullParser::XmlPullParser(const uint8* data, size_t size)
+    : data_(data),
+      size_(data ? size : 0),
+      pos_(0),
+      token_(kText),
+      is_prologue_parsed_(false),
+      has_root_(false),
+      is_end_element_pending_(false),
+      error_offset_(0),
+      num_attributes_(0) {
+}
+
+XmlPullParser::Token XmlPullParser::Next() {
+  if (token_ == kEndDocument || token_ == kError) {
+    return token_;
+  }
+
+  if (!is_prologue_parsed_) {
+    is_prologue_parsed_ = true;
+    if (!ParsePrologue()) {
+      return Fail();
+    }
+  }
+
+  num_attributes_ = 0;
+  if (is_end_element_pending_) {
+    is_end_element_pending_ = false;
+    PopElement();
+    token_ = kEndElement;
+    return token_;
+  }
+
+  text_.clear();
+  for (;;) {
+    if (pos_ == size_) {
+      if (!has_root_ || depth()) {
+        return Fail();
+      }
+      token_ = kEndDocument;
+      return token_;
+    }
+
+    if (data_[pos_] != '<') {
+      if (!ParseCharacterData()) {
+        return Fail();
+      }
+      continue;
+    }
+
+    if (StartsWith("<![CDATA[")) {
+      if (!ParseCData()) {
+        return Fail();
+      }
+      continue;
+    }
+
+    if (StartsWith("<!--") || StartsWith("<?")) {
+      if (!SkipMarkup()) {
+        return Fail();
+      }
+      continue;
+    }
+
+    // The text before a tag is reported before the tag is parsed.
+    if (!text_.empty()) {
+      token_ = kText;
+      return token_;
+    }
+
+    if (StartsWith("</")) {
+      if (!ParseEndElement()) {
+        return Fail();
+      }
+      token_ = kEndElement;
+      return token_;
+    }
+
+    // Document type declarations are not supported.
+    if (StartsWith("<!") || !ParseStartElement()) {
+      return Fail();
+    }
+    token_ = kStartElement;
+    return token_;
+  }
+}
+
+const XmlPullParser::Attribute* XmlPullParser::FindAttribute(
+    const char* name) const {
+  for (size_t i = 0; i != num_attributes_; ++i) {
+    if (attributes_[i].name == name) {
+      return &attributes_[i];
+    }
+  }
+  return NULL;
+}
+
+XmlPullParser::Token XmlPullParser::Fail() {
+  token_ = kError;
+  error_offset_ = pos_;
+  return token_;
+}
+
+bool XmlPullParser::ParsePrologue() {
+  // Skips the UTF-8 byte order mark.
+  if (StartsWith("\xef\xbb\xbf")) {
+    pos_ += 3;
+  }
+
+  if (!IsValidDocumentText(data_ + pos_, size_ - pos_)) {
+    return false;
+  }
+
+  if (StartsWith("<?xml") && pos_ + 5 < size_ &&
+      IsWhitespace(data_[pos_ + 5])) {
+    return ParseXmlDeclaration();
+  }
+  return true;
+}
+
+bool XmlPullParser::ParseXmlDeclaration() {
+  pos_ += 5;
+
+  std::string name;
+  std::string value;
+  for (;;) {
+    SkipWhitespace();
+    if (StartsWith("?>")) {
+      pos_ += 2;
+      return true;
+    }
+    if (!ParseName(&name)) {
+      return false;
+    }
+    SkipWhitespace();
+    if (pos_ == size_ || data_[pos_] != '=') {
+      return false;
+    }
+    ++pos_;
+    SkipWhitespace();
+    if (!ParseAttributeValue(&value)) {
+      return false;
+    }
+
+    // The parser only reads UTF-8, of which ASCII is a subset.
+    if (name == "encoding" &&
+        !EqualsAsciiNoCase(value, "utf-8") &&
+        !EqualsAsciiNoCase(value, "us-ascii")) {
+      return false;
+    }
+  }
+}
+
+bool XmlPullParser::ParseName(std::string* name) {
+  if (pos_ == size_ || !IsNameStartChar(data_[pos_])) {
+    return false;
+  }
+  const size_t start = pos_;
+  while (pos_ < size_ && IsNameChar(data_[pos_])) {
+    ++pos_;
+  }
+  name->assign(reinterpret_cast<const char*>(data_ + start), pos_ - start);
+  return true;
+}
+
+bool XmlPullParser::ParseStartElement() {
+  // A document has a single root element.
+  if (has_root_ && !depth()) {
+    return false;
+  }
+
+  ++pos_;
+  if (!ParseName(&name_)) {
+    return false;
+  }
+  open_elements_.push_back(open_names_.size());
+  open_names_ += name_;
+  has_root_ = true;
+
+  for (;;) {
+    const bool has_whitespace = SkipWhitespace();
+    if (pos_ == size_) {
+      return false;
+    }
+    if (data_[pos_] == '>') {
+      ++pos_;
+      break;
+    }
+    if (StartsWith("/>")) {
+      pos_ += 2;
+      is_end_element_pending_ = true;
+      break;
+    }
+    if (!has_whitespace || num_attributes_ == kMaxAttributes) {
+      return false;
+    }
+
+    if (num_attributes_ == attributes_.size()) {
+      attributes_.push_back(Attribute());
+    }
+    Attribute& attribute = attributes_[num_attributes_];
+    if (!ParseName(&attribute.name)) {
+      return false;
+    }
+    SkipWhitespace();
+    if (pos_ == size_ || data_[pos_] != '=') {
+      return false;
+    }
+    ++pos_;
+    SkipWhitespace();
+    if (!ParseAttributeValue(&attribute.value)) {
+      return false;
+    }
+
+    for (size_t i = 0; i != num_attributes_; ++i) {
+      if (attributes_[i].name == attribute.name) {
+        return false;
+      }
+    }
+    ++num_attributes_;
+  }
+
+  StripPrefix(&name_);
+  return true;
+}
+
+bool XmlPullParser::ParseEndElement() {
+  pos_ += 2;
+  if (!ParseName(&name_)) {
+    return false;
+  }
+  SkipWhitespace();
+  if (pos_ == size_ || data_[pos_] != '>') {
+    return false;
+  }
+  ++pos_;
+
+  if (!depth() ||
+      open_names_.compare(open_elements_.back(), std::string::npos, name_)) {
+    return false;
+  }
+  PopElement();
+  StripPrefix(&name_);
+  return true;
+}
+
+bool XmlPullParser::ParseAttributeValue(std::string* value) {
+  if (pos_ == size_ || (data_[pos_] != '"' && data_[pos_] != '\'')) {
+    return false;
+  }
+  const uint8 quote = data_[pos_++];
+
+  value->clear();
+  for (;;) {
+    const size_t start = pos_;
+    while (pos_ < size_ && data_[pos_] != quote && data_[pos_] != '&' &&
+           data_[pos_] != '<' && !IsWhitespace(data_[pos_])) {
+      ++pos_;
+    }
+    value->append(reinterpret_cast<const char*>(data_ + start), pos_ - start);
+
+    if (pos_ == size_ || data_[pos_] == '<') {
+      return false;
+    }
+    if (data_[pos_] == quote) {
+      ++pos_;
+      return true;
+    }
+    if (data_[pos_] == '&') {
+      if (!ParseReference(value)) {
+        return false;
+      }
+      continue;
+    }
+
+    // Each whitespace character is replaced with a space, and so is each
+    // CR LF pair.
+    if (data_[pos_] == '\r' && pos_ + 1 < size_ && data_[pos_ + 1] == '\n') {
+      ++pos_;
+    }
+    ++pos_;
+    *value += ' ';
+  }
+}
+
+bool XmlPullParser::ParseReference(std::string* out) {
+  const size_t start = pos_ + 1;
+  size_t end = start;
+  while (end < size_ && end - start <= kMaxReferenceLength &&
+         data_[end] != ';') {
+    ++end;
+  }
+  if (end == size_ || data_[end] != ';' || end == start) {
+    return false;
+  }
+
+  const char* reference = reinterpret_cast<const char*>(data_ + start);
+  const size_t length = end - start;
+  pos_ = end + 1;
+
+  if (reference[0] != '#') {
+    struct {
+      const char* name;
+      char value;
+    } const kEntities[] = {
+      { "lt",   '<' },
+      { "gt",   '>' },
+      { "amp",  '&' },
+      { "quot", '"' },
+      { "apos", '\'' },
+    };
+    for (size_t i = 0; i != arraysize(kEntities); ++i) {
+      if (strlen(kEntities[i].name) == length &&
+          !memcmp(kEntities[i].name, reference, length)) {
+        *out += kEntities[i].value;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  const bool is_hex = length > 1 && reference[1] == 'x';
+  const size_t first_digit = is_hex ? 2 : 1;
+  if (first_digit == length) {
+    return false;
+  }
+
+  uint32 code_point = 0;
+  for (size_t i = first_digit; i != length; ++i) {
+    const char c = reference[i];
+    uint32 digit = 0;
+    if (c >= '0' && c <= '9') {
+      digit = c - '0';
+    } else if (is_hex && c >= 'a' && c <= 'f') {
+      digit = c - 'a' + 10;
+    } else if (is_hex && c >= 'A' && c <= 'F') {
+      digit = c - 'A' + 10;
+    } else {
+      return false;
+    }
+    code_point = code_point * (is_hex ? 16 : 10) + digit;
+    if (code_point > 0x10ffff) {
+      return false;
+    }
+  }
+
+  if (!IsXmlChar(code_point)) {
+    return false;
+  }
+  AppendUtf8(code_point, out);
+  return true;
+}
+
+bool XmlPullParser::ParseCharacterData() {
+  // Only whitespace is allowed outside the root element. It is not reported.
+  if (!depth()) {
+    while (pos_ < size_ && data_[pos_] != '<') {
+      if (!IsWhitespace(data_[pos_])) {
+        return false;
+      }
+      ++pos_;
+    }
+    return true;
+  }
+
+  while (pos_ < size_ && data_[pos_] != '<') {
+    const size_t start = pos_;
+    while (pos_ < size_ && data_[pos_] != '<' && data_[pos_] != '&') {
+      // "]]>" is only allowed at the end of a CDATA section.
+      if (data_[pos_] == '>' && pos_ - start >= 2 &&
+          data_[pos_ - 1] == ']' && data_[pos_ - 2] == ']') {
+        return false;
+      }
+      ++pos_;
+    }
+    AppendNormalizingLineBreaks(data_ + start, data_ + pos_, &text_);
+
+    if (pos_ < size_ && data_[pos_] == '&' && !ParseReference(&text_)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool XmlPullParser::ParseCData() {
+  if (!depth()) {
+    return false;
+  }
+
+  const size_t start = pos_ + 9;
+  const size_t end = Find("]]>", start);
+  if (end == std::string::npos) {
+    return false;
+  }
+  AppendNormalizingLineBreaks(data_ + start, data_ + end, &text_);
+  pos_ = end + 3;
+  return true;
+}
+
+bool XmlPullParser::SkipMarkup() {
+  // "--" is only allowed at the end of a comment.
+  if (StartsWith("<!--")) {
+    const size_t end = Find("--", pos_ + 4);
+    if (end == std::string::npos || size_ - end < 3 || data_[end + 2] != '>') {
+      return false;
+    }
+    pos_ = end + 3;
+    return true;
+  }
+
+  // The XML declaration is only allowed at the start of the document.
+  pos_ += 2;
+  std::string target;
+  if (!ParseName(&target) || EqualsAsciiNoCase(target, "xml")) {
+    return false;
+  }
+  const size_t end = Find("?>", pos_);
+  if (end == std::string::npos) {
+    return false;
+  }
+  pos_ = end + 2;
+  return true;
+}
+
+void XmlPullParser::PopElement() {
+  open_names_.resize(open_elements_.back());
+  open_elements_.pop_back();
+}
+
+size_t XmlPullParser::Find(const char* pattern, size_t from) const {
+  const size_t length = strlen(pattern);
+  for (size_t i = from; i < size_ && size_ - i >= length; ++i) {
+    if (!memcmp(data_ + i, pattern, length)) {
+      return i;
+    }
+  }
+  return std::string::npos;
+}
+
+bool XmlPullParser::SkipWhitespace() {
+  const size_t start = pos_;
+  while (pos_ < size_ && IsWhitespace(data_[pos_])) {
+    ++pos_;
+  }
+  return pos_ != start;
+}
+
+bool XmlPullParser::StartsWith(const char* prefix) const {
+  const size_t length = strlen(prefix);
+  return size_ - pos_ >= length && !memcmp(data_ + pos_, prefix, length);
+}
+
+}  // namespace xml
+
+}  // namespace omaha
@@ -0,0 +1,133 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// Defines a streaming pull parser for the UTF-8 documents the update server
+// sends. The parser does not depend on COM or MSXML: it walks the buffer once
+// and reports the elements and the text as it finds them, without building a
+// tree. It is non-validating and rejects document type declarations, the same
+// way the safe DOM document does.
+//
+// Any input, including truncated or corrupted input, either parses or makes
+// Next() return kError, which makes the parser safe to fuzz.
+
+#ifndef OMAHA_COMMON_XML_PULL_PARSER_H_
+#define OMAHA_COMMON_XML_PULL_PARSER_H_
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include "base/basictypes.h"
+
+namespace omaha {
+
+namespace xml {
+
+class XmlPullParser {
+ public:
+  enum Token {
+    kStartElement,
+    kEndElement,
+    kText,
+    kEndDocument,
+    kError,
+  };
+
+  struct Attribute {
+    std::string name;   // The qualified name, as written in the document.
+    std::string value;  // The value, with the references resolved.
+  };
+
+  // The parser does not copy |data|, which must outlive the parser.
+  XmlPullParser(const uint8* data, size_t size);
+
+  // Advances to the next token. An empty element such as <a/> is reported as
+  // a start element followed by an end element. Adjacent character data and
+  // CDATA sections are reported as a single text token. Comments and
+  // processing instructions are skipped. Once the end of the document or an
+  // error is reached, the same token is returned again.
+  Token Next();
+
+  // The local name, without the namespace prefix, of the current start or end
+  // element.
+  const std::string& name() const { return name_; }
+
+  // The attributes of the current start element.
+  const Attribute* attributes() const {
+    return num_attributes_ ? &attributes_.front() : NULL;
+  }
+  size_t num_attributes() const { return num_attributes_; }
+
+  // Returns the attribute of the current start element with the given
+  // qualified name, or NULL if the element does not have that attribute.
+  const Attribute* FindAttribute(const char* name) const;
+
+  // The content of the current text token, with the references resolved and
+  // the line breaks normalized to '\n'.
+  const std::string& text() const { return text_; }
+
+  // The number of elements open, including the current start element.
+  int depth() const { return static_cast<int>(open_elements_.size()); }
+
+  // The offset in the input where the parser found an error.
+  size_t error_offset() const { return error_offset_; }
+
+ private:
+  Token Fail();
+  bool ParsePrologue();
+  bool ParseXmlDeclaration();
+  bool ParseName(std::string* name);
+  bool ParseStartElement();
+  bool ParseEndElement();
+  bool ParseAttributeValue(std::string* value);
+  bool ParseReference(std::string* out);
+  bool ParseCharacterData();
+  bool ParseCData();
+  bool SkipMarkup();
+  void PopElement();
+  size_t Find(const char* pattern, size_t from) const;
+  bool SkipWhitespace();
+  bool StartsWith(const char* prefix) const;
+
+  const uint8* const data_;
+  const size_t size_;
+  size_t pos_;
+
+  Token token_;
+  bool is_prologue_parsed_;
+  bool has_root_;
+  bool is_end_element_pending_;
+  size_t error_offset_;
+
+  std::string name_;
+  std::string text_;
+
+  // The attributes are reused from one element to the next to avoid
+  // allocating strings for each element.
+  std::vector<Attribute> attributes_;
+  size_t num_attributes_;
+
+  // The qualified names of the open elements are stored end to end in
+  // |open_names_|. |open_elements_| has the offset where each name starts.
+  std::string open_names_;
+  std::vector<size_t> open_elements_;
+
+  DISALLOW_COPY_AND_ASSIGN(XmlPullParser);
+};
+
+}  // namespace xml
+
+}  // namespace omaha
+
+#endif  // OMAHA_COMMON_XML_PULL_PARSER_H_
@@ -0,0 +1,280 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/common/xml_pull_parser.h"
+
+#include <stdlib.h>
+#include <string>
+#include "omaha/testing/unit_test.h"
+
+namespace omaha {
+
+namespace xml {
+
+namespace {
+
+// Returns the tokens of |document| as a string, for instance "<a b=c>T[d]</a>"
+// for "<a b='c'>d</a>". Errors are reported as "!".
+std::string Tokenize(const std::string& document) {
+  XmlPullParser parser(reinterpret_cast<const uint8*>(document.data()),
+                       document.size());
+  std::string tokens;
+  for (;;) {
+    switch (parser.Next()) {
+      case XmlPullParser::kStartElement:
+        tokens += "<" + parser.name();
+        for (size_t i = 0; i != parser.num_attributes(); ++i) {
+          tokens += " " + parser.attributes()[i].name +
+                    "=" + parser.attributes()[i].value;
+        }
+        tokens += ">";
+        break;
+      case XmlPullParser::kEndElement:
+        tokens += "</" + parser.name() + ">";
+        break;
+      case XmlPullParser::kText:
+        tokens += "T[" + parser.text() + "]";
+        break;
+      case XmlPullParser::kEndDocument:
+        return tokens;
+      case XmlPullParser::kError:
+        return tokens + "!";
+    }
+  }
+}
+
+// Parses |document| to the end and returns the last token.
+XmlPullParser::Token ParseAll(const std::string& document) {
+  XmlPullParser parser(reinterpret_cast<const uint8*>(document.data()),
+                       document.size());
+  XmlPullParser::Token token = XmlPullParser::kError;
+  do {
+    token = parser.Next();
+  } while (token != XmlPullParser::kEndDocument &&
+           token != XmlPullParser::kError);
+  return token;
+}
+
+const char kResponse[] =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+    "<response protocol=\"3.0\">"
+    "<daystart elapsed_seconds=\"8400\" elapsed_days=\"3255\"/>"
+    "<app appid=\"{8A69D345-D564-463C-AFF1-A69D9E530F96}\" status=\"ok\">"
+    "<updatecheck status=\"ok\"><urls>"
+    "<url codebase=\"http://dl.google.com/edgedl/chrome/install/\"/>"
+    "</urls></updatecheck>"
+    "<data index=\"verbose\" name=\"install\" status=\"ok\">"
+    "{&quot;a&quot;: 1}</data>"
+    "</app></response>";
+
+}  // namespace
+
+TEST(XmlPullParserTest, Elements) {
+  EXPECT_EQ("<a b=c d=e><f></f>T[g]</a>",
+            Tokenize("<a b='c' d=\"e\"><f/>g</a>"));
+  EXPECT_EQ("<a></a>", Tokenize("<a ></a >"));
+  EXPECT_EQ("<a b=c></a>", Tokenize("<a\n b = 'c'\n/>"));
+}
+
+TEST(XmlPullParserTest, Depth) {
+  const std::string document("<a><b/></a>");
+  XmlPullParser parser(reinterpret_cast<const uint8*>(document.data()),
+                       document.size());
+  EXPECT_EQ(0, parser.depth());
+  EXPECT_EQ(XmlPullParser::kStartElement, parser.Next());
+  EXPECT_EQ(1, parser.depth());
+  EXPECT_EQ(XmlPullParser::kStartElement, parser.Next());
+  EXPECT_EQ(2, parser.depth());
+  EXPECT_EQ(XmlPullParser::kEndElement, parser.Next());
+  EXPECT_EQ(1, parser.depth());
+  EXPECT_EQ(XmlPullParser::kEndElement, parser.Next());
+  EXPECT_EQ(0, parser.depth());
+  EXPECT_EQ(XmlPullParser::kEndDocument, parser.Next());
+  EXPECT_EQ(XmlPullParser::kEndDocument, parser.Next());
+}
+
+TEST(XmlPullParserTest, FindAttribute) {
+  const std::string document("<a b='1' c:d='2'/>");
+  XmlPullParser parser(reinterpret_cast<const uint8*>(document.data()),
+                       document.size());
+  ASSERT_EQ(XmlPullParser::kStartElement, parser.Next());
+  ASSERT_TRUE(parser.FindAttribute("b") != NULL);
+  EXPECT_EQ("1", parser.FindAttribute("b")->value);
+  ASSERT_TRUE(parser.FindAttribute("c:d") != NULL);
+  EXPECT_EQ("2", parser.FindAttribute("c:d")->value);
+  EXPECT_TRUE(parser.FindAttribute("d") == NULL);
+  EXPECT_TRUE(parser.FindAttribute("e") == NULL);
+
+  // The attributes belong to the start element only.
+  ASSERT_EQ(XmlPullParser::kEndElement, parser.Next());
+  EXPECT_TRUE(parser.FindAttribute("b") == NULL);
+}
+
+TEST(XmlPullParserTest, NamespacePrefixes) {
+  EXPECT_EQ("<response xmlns:o=u><app></app></response>",
+            Tokenize("<o:response xmlns:o='u'><o:app/></o:response>"));
+
+  // The end tag must match the qualified name of the start tag.
+  EXPECT_EQ("<response>!", Tokenize("<o:response></response>"));
+}
+
+TEST(XmlPullParserTest, References) {
+  EXPECT_EQ("<a b=<>&\"'>T[<>&\"']</a>",
+            Tokenize("<a b='&lt;&gt;&amp;&quot;&apos;'>"
+                     "&lt;&gt;&amp;&quot;&apos;</a>"));
+  EXPECT_EQ("<a>T[AB\xc3\xa9\xe2\x82\xac]</a>",
+            Tokenize("<a>&#65;&#x42;&#233;&#x20AC;</a>"));
+
+  EXPECT_EQ("<a>!", Tokenize("<a>&nbsp;</a>"));
+  EXPECT_EQ("<a>!", Tokenize("<a>&amp</a>"));
+  EXPECT_EQ("<a>!", Tokenize("<a>&;</a>"));
+  EXPECT_EQ("<a>!", Tokenize("<a>&#;</a>"));
+  EXPECT_EQ("<a>!", Tokenize("<a>&#x;</a>"));
+  EXPECT_EQ("<a>!", Tokenize("<a>&#0;</a>"));
+  EXPECT_EQ("<a>!", Tokenize("<a>&#xD800;</a>"));
+  EXPECT_EQ("<a>!", Tokenize("<a>&#x110000;</a>"));
+  EXPECT_EQ("<a>!", Tokenize("<a>&#99999999999999;</a>"));
+  EXPECT_EQ("!", Tokenize("<a b='&bogus;'/>"));
+}
+
+TEST(XmlPullParserTest, Whitespace) {
+  // Line breaks are normalized in text and whitespace is normalized in
+  // attribute values. Whitespace outside the root element is not reported.
+  EXPECT_EQ("<a b=1 2  3>T[\n x\n\n]</a>",
+            Tokenize("\r\n <a b='1\t2\r\n\n3'>\r\n x\r\r</a>\n"));
+}
+
+TEST(XmlPullParserTest, CDataCommentsAndProcessingInstructions) {
+  EXPECT_EQ("<a>T[x<y>&amp;z]</a>",
+            Tokenize("<a>x<![CDATA[<y>&amp;]]><!-- <b/> -->z<?pi ?></a>"));
+  EXPECT_EQ("<a></a>", Tokenize("<!-- c --><?pi data?><a/><!-- c -->"));
+  EXPECT_EQ("<a>!", Tokenize("<a><![CDATA[x</a>"));
+  EXPECT_EQ("<a>!", Tokenize("<a><!-- x</a>"));
+  EXPECT_EQ("!", Tokenize("<![CDATA[x]]><a/>"));
+
+  // "]]>" is not allowed in text, nor "--" in comments.
+  EXPECT_EQ("<a>T[]] >]]>]</a>", Tokenize("<a>]] >]]&gt;</a>"));
+  EXPECT_EQ("<a>!", Tokenize("<a>x]]>y</a>"));
+  EXPECT_EQ("<a>T[xz]</a>", Tokenize("<a>x<!-- - y- -->z</a>"));
+  EXPECT_EQ("<a>!", Tokenize("<a><!-- x -- y --></a>"));
+  EXPECT_EQ("<a>!", Tokenize("<a><!-- x ---></a>"));
+  EXPECT_EQ("!", Tokenize("<!-- x -- y --><a/>"));
+}
+
+TEST(XmlPullParserTest, Prologue) {
+  EXPECT_EQ("<a></a>", Tokenize("\xef\xbb\xbf<?xml version='1.0'?><a/>"));
+  EXPECT_EQ("<a></a>",
+            Tokenize("<?xml version=\"1.0\" encoding=\"utf-8\"?>\n<a/>"));
+  EXPECT_EQ("<a></a>",
+            Tokenize("<?xml version='1.0' encoding='US-ASCII'?><a/>"));
+
+  // Only UTF-8 documents are read.
+  EXPECT_EQ("!", Tokenize("<?xml version='1.0' encoding='UTF-16'?><a/>"));
+  EXPECT_EQ("!", Tokenize(std::string("\xff\xfe<\0a\0/\0>\0", 10)));
+
+  // The declaration must come first.
+  EXPECT_EQ("!", Tokenize(" <?xml version='1.0'?><a/>"));
+  EXPECT_EQ("<a>!", Tokenize("<a><?xml version='1.0'?></a>"));
+}
+
+TEST(XmlPullParserTest, DocumentTypeDeclarationsAreRejected) {
+  EXPECT_EQ("!", Tokenize("<!DOCTYPE a><a/>"));
+  EXPECT_EQ("!", Tokenize("<!DOCTYPE a [<!ENTITY e 'x'>]><a>&e;</a>"));
+}
+
+TEST(XmlPullParserTest, MalformedDocuments) {
+  EXPECT_EQ("!", Tokenize(""));
+  EXPECT_EQ("!", Tokenize("   "));
+  EXPECT_EQ("!", Tokenize("text"));
+  EXPECT_EQ("!", Tokenize("text<a/>"));
+  EXPECT_EQ("<a></a>!", Tokenize("<a/>text"));
+  EXPECT_EQ("<a></a>!", Tokenize("<a/><b/>"));
+  EXPECT_EQ("<a><b>!", Tokenize("<a><b></a></b>"));
+  EXPECT_EQ("<a>!", Tokenize("<a></b>"));
+  EXPECT_EQ("<a>!", Tokenize("<a>x"));
+  EXPECT_EQ("!", Tokenize("<a"));
+  EXPECT_EQ("!", Tokenize("< a/>"));
+  EXPECT_EQ("!", Tokenize("<1a/>"));
+  EXPECT_EQ("!", Tokenize("<a b/>"));
+  EXPECT_EQ("!", Tokenize("<a b=c/>"));
+  EXPECT_EQ("!", Tokenize("<a b='c/>"));
+  EXPECT_EQ("!", Tokenize("<a b='<'/>"));
+  EXPECT_EQ("!", Tokenize("<a b='1'c='2'/>"));
+  EXPECT_EQ("!", Tokenize("<a b='1' b='2'/>"));
+  EXPECT_EQ("<a></a>!", Tokenize("<a/></a>"));
+}
+
+TEST(XmlPullParserTest, InvalidCharacters) {
+  // Overlong encoding, truncated sequence, surrogate, and control character.
+  EXPECT_EQ("!", Tokenize("<a>\xc0\xaf</a>"));
+  EXPECT_EQ("!", Tokenize("<a>\xe2\x82</a>"));
+  EXPECT_EQ("!", Tokenize("<a>\xed\xa0\x80</a>"));
+  EXPECT_EQ("!", Tokenize(std::string("<a>\0</a>", 8)));
+  EXPECT_EQ("!", Tokenize("<a>\x01</a>"));
+
+  EXPECT_EQ("<a b=\xc3\xa9>T[\xf0\x9f\x98\x80]</a>",
+            Tokenize("<a b='\xc3\xa9'>\xf0\x9f\x98\x80</a>"));
+}
+
+TEST(XmlPullParserTest, NullInput) {
+  XmlPullParser parser(NULL, 10);
+  EXPECT_EQ(XmlPullParser::kError, parser.Next());
+  EXPECT_EQ(XmlPullParser::kError, parser.Next());
+}
+
+TEST(XmlPullParserTest, Response) {
+  EXPECT_EQ("<response protocol=3.0>"
+            "<daystart elapsed_seconds=8400 elapsed_days=3255></daystart>"
+            "<app appid={8A69D345-D564-463C-AFF1-A69D9E530F96} status=ok>"
+            "<updatecheck status=ok><urls>"
+            "<url codebase=http://dl.google.com/edgedl/chrome/install/></url>"
+            "</urls></updatecheck>"
+            "<data index=verbose name=install status=ok>"
+            "T[{\"a\": 1}]</data>"
+            "</app></response>",
+            Tokenize(kResponse));
+}
+
+// Every prefix of a document is malformed, and parsing it must stop with an
+// error rather than read past its end.
+TEST(XmlPullParserTest, Fuzz_Truncated) {
+  const std::string document(kResponse);
+  for (size_t i = 0; i != document.size(); ++i) {
+    // Copying the prefix lets memory checkers catch reads past its end.
+    const std::string prefix(document, 0, i);
+    EXPECT_EQ(XmlPullParser::kError, ParseAll(prefix)) << i;
+  }
+  EXPECT_EQ(XmlPullParser::kEndDocument, ParseAll(document));
+}
+
+// Random corruptions of a document must either parse or fail.
+TEST(XmlPullParserTest, Fuzz_Corrupted) {
+  const std::string document(kResponse);
+  srand(1);
+  for (int i = 0; i != 20000; ++i) {
+    std::string corrupted(document);
+    const int num_changes = 1 + rand() % 4;
+    for (int j = 0; j != num_changes; ++j) {
+      corrupted[rand() % corrupted.size()] = static_cast<char>(rand());
+    }
+    const XmlPullParser::Token token = ParseAll(corrupted);
+    EXPECT_TRUE(token == XmlPullParser::kEndDocument ||
+                token == XmlPullParser::kError);
+  }
+}
+
+}  // namespace xml
+
+}  // namespace omaha
@@ -0,0 +1,233 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/common/xml_writer.h"
+
+#include <limits.h>
+#include <tchar.h>
+#include "omaha/base/debug.h"
+#include "omaha/common/xml_const.h"
+
+namespace omaha {
+
+namespace xml {
+
+namespace {
+
+// A UTF-16 code unit takes at most three bytes once converted to UTF-8, and a
+// surrogate pair takes four. The longest reference is "&quot;".
+const int kMaxBytesPerCodeUnit = 6;
+
+// Lone surrogates are replaced by U+FFFD, as WideCharToMultiByte does.
+const uint32 kReplacementCharacter = 0xFFFD;
+
+bool IsHighSurrogate(uint32 c) {
+  return c >= 0xD800 && c <= 0xDBFF;
+}
+
+bool IsLowSurrogate(uint32 c) {
+  return c >= 0xDC00 && c <= 0xDFFF;
+}
+
+// Returns the reference replacing |c|, or NULL if |c| is written as is.
+// The apostrophe is not escaped since the attribute values are delimited by
+// quotes.
+const char* GetReference(uint32 c, bool is_attribute) {
+  switch (c) {
+    case '&':
+      return "&amp;";
+    case '<':
+      return "&lt;";
+    case '>':
+      return "&gt;";
+    case '"':
+      return is_attribute ? "&quot;" : NULL;
+    default:
+      return NULL;
+  }
+}
+
+}  // namespace
+
+XmlWriter::XmlWriter(CStringA* buffer)
+    : buffer_(buffer),
+      is_start_tag_open_(false) {
+  ASSERT1(buffer);
+}
+
+void XmlWriter::WriteXmlDeclaration() {
+  ASSERT1(buffer_->IsEmpty());
+  Append(kXmlDirective, false, false);
+}
+
+void XmlWriter::StartElement(const TCHAR* name) {
+  ASSERT1(name && *name);
+
+  CloseStartTag();
+  buffer_->AppendChar('<');
+  Append(name, false, false);
+  open_elements_.push_back(name);
+  is_start_tag_open_ = true;
+}
+
+void XmlWriter::AddAttribute(const TCHAR* name, const TCHAR* value) {
+  ASSERT1(name && *name);
+  ASSERT1(value);
+  ASSERT1(is_start_tag_open_);
+
+  buffer_->AppendChar(' ');
+  Append(name, false, false);
+  buffer_->Append("=\"", 2);
+  Append(value, true, true);
+  buffer_->AppendChar('"');
+}
+
+void XmlWriter::AddAttribute(const TCHAR* name, int value) {
+  AddAttribute(name, static_cast<int64>(value));
+}
+
+void XmlWriter::AddAttribute(const TCHAR* name, uint32 value) {
+  AddDecimalAttribute(name, false, value);
+}
+
+void XmlWriter::AddAttribute(const TCHAR* name, int64 value) {
+  // The magnitude is computed with unsigned arithmetic so that the smallest
+  // value does not overflow.
+  const bool is_negative = value < 0;
+  const uint64 magnitude = is_negative ? 0 - static_cast<uint64>(value) :
+                                         static_cast<uint64>(value);
+  AddDecimalAttribute(name, is_negative, magnitude);
+}
+
+void XmlWriter::AddAttribute(const TCHAR* name, uint64 value) {
+  AddDecimalAttribute(name, false, value);
+}
+
+void XmlWriter::AddText(const TCHAR* text) {
+  ASSERT1(text);
+  ASSERT1(!open_elements_.empty());
+
+  // Empty text leaves the element empty, the same way it leaves a DOM
+  // element without a text node.
+  if (!*text) {
+    return;
+  }
+
+  CloseStartTag();
+  Append(text, true, false);
+}
+
+void XmlWriter::EndElement() {
+  ASSERT1(!open_elements_.empty());
+
+  if (is_start_tag_open_) {
+    buffer_->Append("/>", 2);
+    is_start_tag_open_ = false;
+  } else {
+    buffer_->Append("</", 2);
+    Append(open_elements_.back(), false, false);
+    buffer_->AppendChar('>');
+  }
+  open_elements_.pop_back();
+}
+
+void XmlWriter::CloseStartTag() {
+  if (is_start_tag_open_) {
+    buffer_->AppendChar('>');
+    is_start_tag_open_ = false;
+  }
+}
+
+void XmlWriter::AddDecimalAttribute(const TCHAR* name,
+                                    bool is_negative,
+                                    uint64 value) {
+  // Enough for the 20 digits of the largest value, the sign and the
+  // terminating character.
+  TCHAR digits[22] = {0};
+  TCHAR* first = digits + arraysize(digits) - 1;
+  do {
+    *--first = static_cast<TCHAR>(_T('0') + value % 10);
+    value /= 10;
+  } while (value);
+  if (is_negative) {
+    *--first = _T('-');
+  }
+
+  AddAttribute(name, first);
+}
+
+void XmlWriter::Append(const TCHAR* text, bool escape, bool is_attribute) {
+  ASSERT1(text);
+
+  const size_t length = _tcslen(text);
+  if (!length) {
+    return;
+  }
+
+  // The buffer is grown once for the longest possible output, then written
+  // in place.
+  const int old_length = buffer_->GetLength();
+  ASSERT1(length <= static_cast<size_t>((INT_MAX - old_length) /
+                                        kMaxBytesPerCodeUnit));
+  char* const begin = buffer_->GetBuffer(
+      old_length + static_cast<int>(length) * kMaxBytesPerCodeUnit);
+  char* out = begin + old_length;
+
+  for (size_t i = 0; i != length; ++i) {
+    uint32 c = static_cast<uint32>(text[i]);
+
+    if (c < 0x80) {
+      const char* reference = escape ? GetReference(c, is_attribute) : NULL;
+      if (reference) {
+        while (*reference) {
+          *out++ = *reference++;
+        }
+      } else {
+        *out++ = static_cast<char>(c);
+      }
+      continue;
+    }
+
+    if (c < 0x800) {
+      *out++ = static_cast<char>(0xC0 | (c >> 6));
+      *out++ = static_cast<char>(0x80 | (c & 0x3F));
+      continue;
+    }
+
+    if (IsHighSurrogate(c) && i + 1 != length &&
+        IsLowSurrogate(static_cast<uint32>(text[i + 1]))) {
+      c = 0x10000 + ((c - 0xD800) << 10) +
+          (static_cast<uint32>(text[++i]) - 0xDC00);
+      *out++ = static_cast<char>(0xF0 | (c >> 18));
+      *out++ = static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+      *out++ = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+      *out++ = static_cast<char>(0x80 | (c & 0x3F));
+      continue;
+    }
+
+    if (IsHighSurrogate(c) || IsLowSurrogate(c)) {
+      c = kReplacementCharacter;
+    }
+    *out++ = static_cast<char>(0xE0 | (c >> 12));
+    *out++ = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+    *out++ = static_cast<char>(0x80 | (c & 0x3F));
+  }
+
+  buffer_->ReleaseBufferSetLength(static_cast<int>(out - begin));
+}
+
+}  // namespace xml
+
+}  // namespace omaha
@@ -0,0 +1,85 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// Defines a streaming writer for the UTF-8 requests sent to the update server.
+// The writer appends the markup to a byte buffer as the elements are written,
+// without building a document object model. Its output is the same as the
+// output of the MSXML document the requests used to be built with: elements
+// without content are closed with "/>", and the attribute values and the text
+// are escaped the same way.
+
+#ifndef OMAHA_COMMON_XML_WRITER_H_
+#define OMAHA_COMMON_XML_WRITER_H_
+
+#include <atlstr.h>
+#include <vector>
+#include "base/basictypes.h"
+
+namespace omaha {
+
+namespace xml {
+
+class XmlWriter {
+ public:
+  // The writer appends to |buffer|, which must outlive the writer. Callers
+  // writing many requests can reuse the same buffer and its allocation by
+  // truncating it between requests.
+  explicit XmlWriter(CStringA* buffer);
+
+  // Appends the XML declaration of a UTF-8 document.
+  void WriteXmlDeclaration();
+
+  // Starts an element. The writer does not copy |name|, which must remain
+  // valid until the element is ended.
+  void StartElement(const TCHAR* name);
+
+  // Adds an attribute to the element just started. Attributes can only be
+  // added before the content of the element is written.
+  void AddAttribute(const TCHAR* name, const TCHAR* value);
+  void AddAttribute(const TCHAR* name, int value);
+  void AddAttribute(const TCHAR* name, uint32 value);
+  void AddAttribute(const TCHAR* name, int64 value);
+  void AddAttribute(const TCHAR* name, uint64 value);
+
+  // Appends text to the content of the current element.
+  void AddText(const TCHAR* text);
+
+  // Ends the current element.
+  void EndElement();
+
+  // The number of elements started and not yet ended.
+  size_t depth() const { return open_elements_.size(); }
+
+ private:
+  void CloseStartTag();
+  void AddDecimalAttribute(const TCHAR* name, bool is_negative, uint64 value);
+
+  // Appends |text| converted to UTF-8. The markup characters are replaced by
+  // references when |escape| is true, along with the quotes if |is_attribute|
+  // is true.
+  void Append(const TCHAR* text, bool escape, bool is_attribute);
+
+  CStringA* const buffer_;
+  std::vector<const TCHAR*> open_elements_;
+  bool is_start_tag_open_;
+
+  DISALLOW_COPY_AND_ASSIGN(XmlWriter);
+};
+
+}  // namespace xml
+
+}  // namespace omaha
+
+#endif  // OMAHA_COMMON_XML_WRITER_H_
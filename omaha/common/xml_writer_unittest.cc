@@ -0,0 +1,157 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/common/xml_writer.h"
+
+#include "omaha/base/string.h"
+#include "omaha/testing/unit_test.h"
+
+namespace omaha {
+
+namespace xml {
+
+TEST(XmlWriterTest, EmptyElements) {
+  CStringA buffer;
+  XmlWriter writer(&buffer);
+  writer.StartElement(_T("request"));
+  writer.AddAttribute(_T("protocol"), _T("3.0"));
+  writer.StartElement(_T("hw"));
+  writer.EndElement();
+  writer.StartElement(_T("app"));
+  writer.AddAttribute(_T("version"), _T(""));
+  writer.StartElement(_T("updatecheck"));
+  writer.EndElement();
+  writer.EndElement();
+  writer.EndElement();
+
+  EXPECT_EQ(0U, writer.depth());
+  EXPECT_STREQ("<request protocol=\"3.0\"><hw/><app version=\"\">"
+               "<updatecheck/></app></request>",
+               buffer);
+}
+
+TEST(XmlWriterTest, XmlDeclaration) {
+  CStringA buffer;
+  XmlWriter writer(&buffer);
+  writer.WriteXmlDeclaration();
+  writer.StartElement(_T("request"));
+  writer.EndElement();
+
+  EXPECT_STREQ("<?xml version=\"1.0\" encoding=\"UTF-8\"?><request/>", buffer);
+}
+
+// The quotes are only escaped in attribute values, and the apostrophes are
+// never escaped.
+TEST(XmlWriterTest, Escaping) {
+  CStringA buffer;
+  XmlWriter writer(&buffer);
+  writer.StartElement(_T("data"));
+  writer.AddAttribute(_T("name"), _T("\"<xml>a</xml>='&'\""));
+  writer.AddText(_T("{\"a\": \"<b>&'\"}"));
+  writer.EndElement();
+
+  EXPECT_STREQ("<data name=\"&quot;&lt;xml&gt;a&lt;/xml&gt;='&amp;'&quot;\">"
+               "{\"a\": \"&lt;b&gt;&amp;'\"}</data>",
+               buffer);
+}
+
+TEST(XmlWriterTest, EmptyText) {
+  CStringA buffer;
+  XmlWriter writer(&buffer);
+  writer.StartElement(_T("data"));
+  writer.AddText(_T(""));
+  writer.EndElement();
+
+  EXPECT_STREQ("<data/>", buffer);
+}
+
+TEST(XmlWriterTest, NumericAttributes) {
+  CStringA buffer;
+  XmlWriter writer(&buffer);
+  writer.StartElement(_T("event"));
+  writer.AddAttribute(_T("a"), 0);
+  writer.AddAttribute(_T("b"), -1);
+  writer.AddAttribute(_T("c"), static_cast<int>(0x80000000));
+  writer.AddAttribute(_T("d"), static_cast<uint32>(0xFFFFFFFF));
+  writer.AddAttribute(_T("e"), static_cast<int64>(-9223372036854775807LL - 1));
+  writer.AddAttribute(_T("f"), static_cast<uint64>(18446744073709551615ULL));
+  writer.AddAttribute(_T("g"), true);
+  writer.EndElement();
+
+  EXPECT_STREQ("<event a=\"0\" b=\"-1\" c=\"-2147483648\" d=\"4294967295\" "
+               "e=\"-9223372036854775808\" f=\"18446744073709551615\" "
+               "g=\"1\"/>",
+               buffer);
+}
+
+// The output is the same as the conversion of the Unicode string, including
+// for the surrogate pairs.
+TEST(XmlWriterTest, Utf8) {
+  const TCHAR kValue[] = _T("caf\x00e9 \x4e2d\x6587 \xd83d\xde00 \x05d0");
+
+  CStringA buffer;
+  XmlWriter writer(&buffer);
+  writer.StartElement(_T("app"));
+  writer.AddAttribute(_T("lang"), kValue);
+  writer.AddText(kValue);
+  writer.EndElement();
+
+  const CStringA expected_value(WideToUtf8(kValue));
+  EXPECT_STREQ("caf\xc3\xa9 \xe4\xb8\xad\xe6\x96\x87 \xf0\x9f\x98\x80 \xd7\x90",
+               expected_value);
+  EXPECT_STREQ("<app lang=\"" + expected_value + "\">" + expected_value +
+               "</app>",
+               buffer);
+}
+
+TEST(XmlWriterTest, LoneSurrogates) {
+  CStringA buffer;
+  XmlWriter writer(&buffer);
+  writer.StartElement(_T("a"));
+  writer.AddAttribute(_T("b"), _T("x\xd83dy\xde00"));
+  writer.EndElement();
+
+  EXPECT_STREQ("<a b=\"x\xef\xbf\xbdy\xef\xbf\xbd\"/>", buffer);
+}
+
+TEST(XmlWriterTest, AppendsToBuffer) {
+  CStringA buffer("<?xml?>");
+  XmlWriter writer(&buffer);
+  writer.StartElement(_T("a"));
+  writer.AddText(_T("text"));
+  writer.EndElement();
+
+  EXPECT_STREQ("<?xml?><a>text</a>", buffer);
+}
+
+TEST(XmlWriterTest, LargeDocument) {
+  CStringA buffer;
+  XmlWriter writer(&buffer);
+  writer.StartElement(_T("request"));
+  for (int i = 0; i != 10000; ++i) {
+    writer.StartElement(_T("app"));
+    writer.AddAttribute(_T("index"), i);
+    writer.EndElement();
+  }
+  writer.EndElement();
+
+  EXPECT_EQ(0, buffer.Find("<request><app index=\"0\"/><app index=\"1\"/>"));
+  EXPECT_EQ(buffer.GetLength() - 29,
+            buffer.Find("<app index=\"9999\"/></request>"));
+}
+
+}  // namespace xml
+
+}  // namespace omaha
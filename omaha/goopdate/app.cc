@@ -307,14 +307,66 @@ STDMETHODIMP App::put_usageStatsEnable(UINT usage_stats_enable) {
   return S_OK;
 }
 
-// TODO(omaha3): Replace decisions based on state() with calls to AppState.
-// In this case, there should be a GetCurrentState() method on AppState.
+// Clients poll the current state while the worker threads update the model.
+// A poller which finds the model lock held by another thread does not wait
+// for it: it returns the state computed by the last poll which got the lock.
+// That state can be as old as that poll, and it does not reflect the changes
+// made since, including the update the other thread is making. Only the first
+// poll of an app waits for the lock.
 STDMETHODIMP App::get_currentState(IDispatch** current_state) {
-  __mutexScope(model()->lock());
-
   CORE_LOG(L6, (_T("[App::get_currentState][0x%p]"), this));
   ASSERT1(current_state);
 
+  std::shared_ptr<const CurrentStateSnapshot> snapshot;
+  if (!model()->TryLock()) {
+    snapshot = std::atomic_load(&current_state_snapshot_);
+    if (!snapshot) {
+      model()->lock().Lock();
+    }
+  }
+
+  if (!snapshot) {
+    HRESULT hr = UpdateCurrentStateSnapshot(&snapshot);
+    model()->lock().Unlock();
+    if (FAILED(hr)) {
+      return hr;
+    }
+  }
+
+  CComObject<CurrentAppState>* state_object = NULL;
+  HRESULT hr = CurrentAppState::Create(
+      snapshot->state,
+      snapshot->available_version,
+      snapshot->bytes_downloaded,
+      snapshot->total_bytes_to_download,
+      snapshot->download_time_remaining_ms,
+      snapshot->next_download_retry_time,
+      snapshot->install_progress_percentage,
+      snapshot->install_time_remaining_ms,
+      snapshot->is_canceled,
+      snapshot->error_code,
+      snapshot->extra_code1,
+      snapshot->completion_message,
+      snapshot->installer_result_code,
+      snapshot->installer_result_extra_code1,
+      snapshot->post_install_launch_command_line,
+      snapshot->post_install_url,
+      snapshot->post_install_action,
+      &state_object);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  return state_object->QueryInterface(current_state);
+}
+
+// TODO(omaha3): Replace decisions based on state() with calls to AppState.
+// In this case, there should be a GetCurrentState() method on AppState.
+HRESULT App::UpdateCurrentStateSnapshot(
+    std::shared_ptr<const CurrentStateSnapshot>* snapshot) {
+  ASSERT1(model()->IsLockedByCaller());
+  ASSERT1(snapshot);
+
   ULONGLONG bytes_downloaded = 0;
   ULONGLONG total_bytes_to_download = 0;
   ULONGLONG next_download_retry_time = 0;
@@ -405,30 +457,30 @@ STDMETHODIMP App::get_currentState(IDispatch** current_state) {
     return hr;
   }
 
-  CComObject<CurrentAppState>* state_object = NULL;
-  hr = CurrentAppState::Create(state(),
-                               next_version()->version(),
-                               bytes_downloaded,
-                               total_bytes_to_download,
-                               download_time_remaining_ms,
-                               next_download_retry_time,
-                               install_progress_percentage,
-                               install_time_remaining_ms,
-                               is_canceled_,
-                               error_context_.error_code,
-                               error_context_.extra_code1,
-                               completion_message_,
-                               installer_result_code_,
-                               installer_result_extra_code1_,
-                               post_install_launch_command_line_,
-                               post_install_url_,
-                               post_install_action_,
-                               &state_object);
-  if (FAILED(hr)) {
-    return hr;
-  }
-
-  return state_object->QueryInterface(current_state);
+  std::shared_ptr<CurrentStateSnapshot> new_snapshot(
+      new CurrentStateSnapshot);
+  new_snapshot->state = state();
+  new_snapshot->available_version = next_version()->version();
+  new_snapshot->bytes_downloaded = bytes_downloaded;
+  new_snapshot->total_bytes_to_download = total_bytes_to_download;
+  new_snapshot->download_time_remaining_ms = download_time_remaining_ms;
+  new_snapshot->next_download_retry_time = next_download_retry_time;
+  new_snapshot->install_progress_percentage = install_progress_percentage;
+  new_snapshot->install_time_remaining_ms = install_time_remaining_ms;
+  new_snapshot->is_canceled = is_canceled_;
+  new_snapshot->error_code = error_context_.error_code;
+  new_snapshot->extra_code1 = error_context_.extra_code1;
+  new_snapshot->completion_message = completion_message_;
+  new_snapshot->installer_result_code = installer_result_code_;
+  new_snapshot->installer_result_extra_code1 = installer_result_extra_code1_;
+  new_snapshot->post_install_launch_command_line =
+      post_install_launch_command_line_;
+  new_snapshot->post_install_url = post_install_url_;
+  new_snapshot->post_install_action = post_install_action_;
+
+  *snapshot = new_snapshot;
+  std::atomic_store(&current_state_snapshot_, *snapshot);
+  return S_OK;
 }
 
 STDMETHODIMP App::get_untrustedData(BSTR* data) {
@@ -1137,6 +1189,8 @@ void App::ChangeState(fsm::AppState* app_state) {
   if (ping_event.get()) {
     AddPingEvent(ping_event);
   }
+
+  app_bundle_->NotifyStateChange();
 }
 
 void App::SetError(const ErrorContext& error_context, const CString& message) {
@@ -1430,8 +1484,9 @@ STDMETHODIMP AppWrapper::put_usageStatsEnable(UINT usage_stats_enable) {
   return wrapped_obj()->put_usageStatsEnable(usage_stats_enable);
 }
 
+// The app takes the model lock itself, so that pollers do not wait for the
+// threads updating the model.
 STDMETHODIMP AppWrapper::get_currentState(IDispatch** current_state_disp) {
-  __mutexScope(model()->lock());
   return wrapped_obj()->get_currentState(current_state_disp);
 }
 
@@ -395,6 +395,48 @@ class App : public ModelObject {
   // Sets the app state for unit testing.
   friend void SetAppStateForUnitTest(App* app, fsm::AppState* state);
 
+  // The values returned by get_currentState.
+  struct CurrentStateSnapshot {
+    CurrentStateSnapshot()
+        : state(STATE_INIT),
+          bytes_downloaded(0),
+          total_bytes_to_download(0),
+          download_time_remaining_ms(0),
+          next_download_retry_time(0),
+          install_progress_percentage(0),
+          install_time_remaining_ms(0),
+          is_canceled(false),
+          error_code(S_OK),
+          extra_code1(0),
+          installer_result_code(0),
+          installer_result_extra_code1(0),
+          post_install_action(POST_INSTALL_ACTION_DEFAULT) {}
+
+    LONG state;
+    CString available_version;
+    ULONGLONG bytes_downloaded;
+    ULONGLONG total_bytes_to_download;
+    LONG download_time_remaining_ms;
+    ULONGLONG next_download_retry_time;
+    LONG install_progress_percentage;
+    LONG install_time_remaining_ms;
+    bool is_canceled;
+    LONG error_code;
+    LONG extra_code1;
+    CString completion_message;
+    LONG installer_result_code;
+    LONG installer_result_extra_code1;
+    CString post_install_launch_command_line;
+    CString post_install_url;
+    PostInstallAction post_install_action;
+  };
+
+  // Computes the current state of the app and publishes it for the pollers
+  // which find the model lock held by another thread. Must be called with
+  // the model lock held.
+  HRESULT UpdateCurrentStateSnapshot(
+      std::shared_ptr<const CurrentStateSnapshot>* snapshot);
+
   HRESULT GetDownloadProgress(uint64* bytes_downloaded,
                               uint64* bytes_total,
                               LONG* time_remaining_ms,
@@ -516,6 +558,10 @@ class App : public ModelObject {
   // signature verification can be omitted.
   bool can_skip_signature_verification_;
 
+  // The current state computed by the last poller which held the model lock.
+  // It is only accessed with std::atomic_load and std::atomic_store.
+  std::shared_ptr<const CurrentStateSnapshot> current_state_snapshot_;
+
   DISALLOW_COPY_AND_ASSIGN(App);
 };
 
@@ -34,6 +34,7 @@
 #include "omaha/goopdate/app_manager.h"
 #include "omaha/goopdate/goopdate.h"
 #include "omaha/goopdate/model.h"
+#include "omaha/goopdate/progress_notifier.h"
 #include "omaha/goopdate/update_request_utils.h"
 
 namespace omaha {
@@ -53,9 +54,15 @@ AppBundle::AppBundle(bool is_machine, Model* model)
       priority_(INSTALL_PRIORITY_HIGH),
       parent_hwnd_(NULL),
       user_work_item_(NULL),
+      cancellation_token_(std::make_shared<CancellationToken>()),
+      is_busy_(false),
       display_language_(lang::GetDefaultLanguage(is_machine)) {
   CORE_LOG(L3, (_T("[AppBundle::AppBundle][0x%p]"), this));
   app_bundle_state_.reset(new fsm::AppBundleStateInit);
+  ASSERT1(!app_bundle_state_->IsBusy());
+
+  reset(stop_event_, ::CreateEvent(NULL, true, false, NULL));
+  ASSERT1(valid(stop_event_));
 
   VERIFY1(SUCCEEDED(GetGuid(&request_id_)));
 }
@@ -108,6 +115,14 @@ void AppBundle::set_user_work_item(UserWorkItem* user_work_item) {
   user_work_item_ = user_work_item;
 }
 
+std::shared_ptr<const CancellationToken> AppBundle::cancellation_token() const {
+  return cancellation_token_;
+}
+
+HANDLE AppBundle::stop_event() const {
+  return get(stop_event_);
+}
+
 HANDLE AppBundle::impersonation_token() const {
   __mutexScope(model()->lock());
   return alt_impersonation_token_.GetHandle() ?
@@ -227,6 +242,35 @@ HRESULT AppBundle::BuildAndPersistPing() {
   return ping->PersistPing();
 }
 
+void AppBundle::NotifyStateChange() {
+  ProgressNotifier* progress_notifier = GetProgressNotifier();
+  if (progress_notifier) {
+    progress_notifier->NotifyStateChange();
+  }
+}
+
+void AppBundle::NotifyProgress() {
+  ProgressNotifier* progress_notifier = GetProgressNotifier();
+  if (progress_notifier) {
+    progress_notifier->NotifyProgress();
+  }
+}
+
+// The client can only be notified once it has set the session id, which is
+// set before the bundle is initialized.
+ProgressNotifier* AppBundle::GetProgressNotifier() {
+  ASSERT1(model()->IsLockedByCaller());
+
+  if (session_id_.IsEmpty()) {
+    return NULL;
+  }
+
+  if (!progress_notifier_.get()) {
+    progress_notifier_.reset(new ProgressNotifier(is_machine_, session_id_));
+  }
+  return progress_notifier_.get();
+}
+
 HRESULT AppBundle::SendPingEventsAsync() {
   CORE_LOG(L3, (_T("[AppBundle::SendPingEventsAsync]")));
 
@@ -660,6 +704,8 @@ STDMETHODIMP AppBundle::stop() {
 
   __mutexScope(model()->lock());
 
+  cancellation_token_->Cancel();
+  VERIFY1(::SetEvent(get(stop_event_)));
   return app_bundle_state_->Stop(this);
 }
 
@@ -683,9 +729,11 @@ STDMETHODIMP AppBundle::isBusy(VARIANT_BOOL* is_busy) {
   CORE_LOG(L3, (_T("[AppBundle::isBusy][0x%p]"), this));
   ASSERT1(is_busy);
 
-  __mutexScope(model()->lock());
-
-  *is_busy = IsBusy() ? VARIANT_TRUE : VARIANT_FALSE;
+  // Clients poll this method while the bundle is being processed. The value
+  // is read without the model lock, which is held for long periods by the
+  // threads processing the bundle.
+  *is_busy = ::InterlockedCompareExchange(&is_busy_, 0, 0) ? VARIANT_TRUE :
+                                                            VARIANT_FALSE;
   return S_OK;
 }
 
@@ -769,6 +817,7 @@ void AppBundle::ChangeState(fsm::AppBundleState* app_bundle_state) {
   ASSERT1(model()->IsLockedByCaller());
 
   app_bundle_state_.reset(app_bundle_state);
+  ::InterlockedExchange(&is_busy_, app_bundle_state_->IsBusy());
 }
 
 
@@ -974,7 +1023,6 @@ STDMETHODIMP AppBundleWrapper::resume() {
 }
 
 STDMETHODIMP AppBundleWrapper::isBusy(VARIANT_BOOL* is_busy) {
-  __mutexScope(model()->lock());
   return wrapped_obj()->isBusy(is_busy);
 }
 
@@ -29,6 +29,7 @@
 #include "goopdate/omaha3_idl.h"
 #include "omaha/base/constants.h"
 #include "omaha/base/debug.h"
+#include "omaha/base/executor.h"
 #include "omaha/base/scope_guard.h"
 #include "omaha/base/synchronized.h"
 #include "omaha/common/ping.h"
@@ -45,6 +46,7 @@ namespace omaha {
 
 class App;
 class Model;
+class ProgressNotifier;
 class WebServicesClientInterface;
 class UserWorkItem;
 
@@ -138,6 +140,14 @@ class AppBundle
 
   void set_user_work_item(UserWorkItem* user_work_item);
 
+  // The token is cancelled when the bundle is stopped. The work items queued
+  // for the bundle carry it, so that they can be cancelled before they start.
+  std::shared_ptr<const CancellationToken> cancellation_token() const;
+
+  // Signaled when the bundle is stopped, for the blocking calls which wait on
+  // something else than the network requests of the bundle.
+  HANDLE stop_event() const;
+
   const CString& install_source() const { return install_source_; }
 
   const CString& origin_url() const { return origin_url_; }
@@ -179,6 +189,11 @@ class AppBundle
   // in the registry.
   HRESULT BuildAndPersistPing();
 
+  // Notifies the client processing the bundle that an app has changed state
+  // or has made progress. Must be called with the model lock held.
+  void NotifyStateChange();
+  void NotifyProgress();
+
  private:
   // Sets the state for unit testing.
   friend void SetAppBundleStateForUnitTest(AppBundle* app_bundle,
@@ -201,6 +216,10 @@ class AppBundle
 
   bool is_pending_non_blocking_call() const;
 
+  // Returns the notifier for the client, or NULL if the client can't be
+  // notified.
+  ProgressNotifier* GetProgressNotifier();
+
   CString display_name_;
   CString install_source_;
   CString origin_url_;
@@ -236,6 +255,11 @@ class AppBundle
   // for debugging. The object is not owned by this class.
   UserWorkItem* user_work_item_;
 
+  const std::shared_ptr<CancellationToken> cancellation_token_;
+
+  // Manual reset event. Never reset once the bundle is stopped.
+  scoped_event stop_event_;
+
   std::unique_ptr<WebServicesClientInterface> update_check_client_;
 
   // The apps in the bundle. Do not add to it directly; use AddApp() instead.
@@ -248,6 +272,14 @@ class AppBundle
 
   std::unique_ptr<fsm::AppBundleState> app_bundle_state_;
 
+  // Notifies the client of the changes. Created when the first change is
+  // notified, once the client has set the session id.
+  std::unique_ptr<ProgressNotifier> progress_notifier_;
+
+  // Whether |app_bundle_state_| is busy. Updated when the state changes, so
+  // that isBusy() can be polled without waiting for the model lock.
+  volatile LONG is_busy_;
+
   // Impersonation and primary tokens set by the client. Typically only
   // set by the gupdatem service. The gupdatem service exposes a narrow
   // interface to medium integrity clients. When a medium integrity client calls
@@ -20,7 +20,6 @@
 #include "omaha/base/debug.h"
 #include "omaha/base/error.h"
 #include "omaha/base/logging.h"
-#include "omaha/common/app_registry_utils.h"
 #include "omaha/common/config_manager.h"
 #include "omaha/common/goopdate_utils.h"
 #include "omaha/common/web_services_client.h"
@@ -28,6 +27,7 @@
 #include "omaha/goopdate/app_bundle_state_paused.h"
 #include "omaha/goopdate/app_bundle_state_stopped.h"
 #include "omaha/goopdate/app_manager.h"
+#include "omaha/goopdate/app_registry_snapshot.h"
 #include "omaha/goopdate/model.h"
 #include "omaha/third_party/smartany/scoped_any.h"
 
@@ -138,7 +138,7 @@ HRESULT AppBundleStateInitialized::CreateInstalledApp(AppBundle* app_bundle,
              app_id, hr));
   }
 
-  hr = AddInstalledApp(app_bundle, app_id, app);
+  hr = AddInstalledApp(app_bundle, app_id, NULL, app);
   if (FAILED(hr)) {
     return hr;
   }
@@ -172,22 +172,28 @@ HRESULT AppBundleStateInitialized::CreateAllInstalledApps(
     CORE_LOG(LW, (_T("[RunAllRegistrationUpdateHooks failed][0x%x]"), hr));
   }
 
-  AppIdVector registered_app_ids;
-  hr = app_manager.GetRegisteredApps(&registered_app_ids);
+  // The registry state of all the apps is loaded at once instead of being
+  // read app by app.
+  AppRegistrySnapshot snapshot(app_bundle->is_machine());
+  hr = app_manager.LoadRegistrySnapshot(&snapshot);
   if (FAILED(hr)) {
-    CORE_LOG(LE, (_T("[GetRegisteredApps failed][0x%08x]"), hr));
+    CORE_LOG(LE, (_T("[LoadRegistrySnapshot failed][0x%08x]"), hr));
     return hr;
   }
 
+  AppIdVector registered_app_ids;
+  snapshot.GetRegisteredApps(&registered_app_ids);
+
   for (size_t i = 0; i != registered_app_ids.size(); ++i) {
     const CString& app_id = registered_app_ids[i];
+    const AppRegistryRecord* record = snapshot.GetApp(app_id);
+    ASSERT1(record);
 
-    ASSERT(RegKey::HasKey(app_registry_utils::GetAppClientStateKey(
-                              app_bundle->is_machine(), app_id)),
+    ASSERT(record->has_client_state_key(),
            (_T("[Clients key without matching ClientState][%s]"), app_id));
 
     App* app = NULL;
-    hr = AddInstalledApp(app_bundle, app_id, &app);
+    hr = AddInstalledApp(app_bundle, app_id, record, &app);
     if (FAILED(hr)) {
       CORE_LOG(LW, (_T("[AddInstalledApp failed processing app][%s]"), app_id));
     }
@@ -272,9 +278,11 @@ HRESULT AppBundleStateInitialized::DownloadPackage(
 
 // App is created with is_update=true because using an installed app's
 // information, including a non-zero version, is an update.
-HRESULT AppBundleStateInitialized::AddInstalledApp(AppBundle* app_bundle,
-                                                   const CString& app_id,
-                                                   App** app) {
+HRESULT AppBundleStateInitialized::AddInstalledApp(
+    AppBundle* app_bundle,
+    const CString& app_id,
+    const AppRegistryRecord* record,
+    App** app) {
   ASSERT1(app_bundle);
   ASSERT1(app);
   ASSERT1(app_bundle->model()->IsLockedByCaller());
@@ -319,7 +327,9 @@ HRESULT AppBundleStateInitialized::AddInstalledApp(AppBundle* app_bundle,
 
   local_app->set_external_updater_event(release(external_updater_event));
 
-  hr = AppManager::Instance()->ReadAppPersistentData(local_app.get());
+  hr = record ?
+      AppManager::Instance()->ReadAppPersistentData(local_app.get(), *record) :
+      AppManager::Instance()->ReadAppPersistentData(local_app.get());
   if (FAILED(hr)) {
     CORE_LOG(LE, (_T("[ReadAppPersistentData failed][0x%x][%s]"), hr, app_id));
     return hr;
@@ -21,6 +21,8 @@
 
 namespace omaha {
 
+class AppRegistryRecord;
+
 namespace fsm {
 
 class AppBundleStateInitialized : public AppBundleState {
@@ -50,8 +52,10 @@ class AppBundleStateInitialized : public AppBundleState {
                                   const CString& package_name);
 
  private:
+  // Reads the app from |record| if it is not NULL, or from the registry.
   HRESULT AddInstalledApp(AppBundle* app_bundle,
                           const CString& appId,
+                          const AppRegistryRecord* record,
                           App** app);
 
   // Adds an app to app_bundle's apps_. Takes ownership of app when successful.
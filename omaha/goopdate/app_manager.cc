@@ -15,6 +15,7 @@
 
 #include "omaha/goopdate/app_manager.h"
 
+#include <climits>
 #include <cstdlib>
 #include <algorithm>
 #include <functional>
@@ -32,6 +33,7 @@
 #include "omaha/common/config_manager.h"
 #include "omaha/common/const_goopdate.h"
 #include "omaha/common/oem_install_utils.h"
+#include "omaha/goopdate/app_registry_snapshot.h"
 #include "omaha/goopdate/application_usage_data.h"
 #include "omaha/goopdate/model.h"
 #include "omaha/goopdate/server_resource.h"
@@ -265,6 +267,16 @@ HRESULT AppManager::RunRegistrationUpdateHook(const CString& app_id) const {
 }
 
 
+// Vulnerable to a race condition with installers. To prevent this, acquire
+// GetRegistryStableStateLock().
+HRESULT AppManager::LoadRegistrySnapshot(AppRegistrySnapshot* snapshot) const {
+  ASSERT1(snapshot);
+  ASSERT1(snapshot->is_machine() == is_machine_);
+
+  __mutexScope(registry_access_lock_);
+  return snapshot->Load(RegKeyRegistrySource());
+}
+
 // Vulnerable to a race condition with installers. To prevent this, hold
 // GetRegistryStableStateLock() while calling this function and related
 // functions, such as ReadAppPersistentData().
@@ -383,89 +395,66 @@ HRESULT AppManager::CreateClientStateKey(const GUID& app_guid,
 }
 
 HRESULT AppManager::ReadAppDefinedAttributes(
-    const CString& app_id, std::vector<StringPair>* attributes) const {
-  ASSERT1(!app_id.IsEmpty());
+    const AppRegistryRecord& record,
+    std::vector<StringPair>* attributes) const {
   ASSERT1(attributes);
   ASSERT1(attributes->empty());
 
-  CString base_key_name(
-    is_machine_ ?
-    ConfigManager::Instance()->machine_registry_client_state_medium() :
-    ConfigManager::Instance()->registry_client_state(is_machine_));
-
-  RegKey app_id_key;
-  CString app_id_key_name = AppendRegKeyPath(base_key_name, app_id);
-  HRESULT hr = app_id_key.Open(app_id_key_name, KEY_READ);
-  if (FAILED(hr)) {
-    if (hr == HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND)) {
-      hr = S_FALSE;
-    }
-    return hr;
+  if (is_machine_ ? !record.has_client_state_medium_key() :
+                    !record.has_client_state_key()) {
+    return S_FALSE;
   }
 
-  hr = ReadAppDefinedAttributeValues(&app_id_key, attributes);
+  const RegistryKeySnapshot& app_id_key(
+      is_machine_ ? record.client_state_medium_key() :
+                    record.client_state_key());
+
+  HRESULT hr = ReadAppDefinedAttributeValues(app_id_key, attributes);
   if (FAILED(hr)) {
     return hr;
   }
 
-  return ReadAppDefinedAttributeSubkeys(&app_id_key, attributes);
+  return ReadAppDefinedAttributeSubkeys(app_id_key, attributes);
 }
 
 HRESULT AppManager::ReadAppDefinedAttributeValues(
-    RegKey* app_id_key, std::vector<StringPair>* attributes) const {
-  ASSERT1(app_id_key);
+    const RegistryKeySnapshot& app_id_key,
+    std::vector<StringPair>* attributes) const {
   ASSERT1(attributes);
 
-  const int num_attributes = app_id_key->GetValueCount();
-
-  for (int i = 0; i < num_attributes; ++i) {
-    CString attribute_name;
-    DWORD type(REG_SZ);
+  const RegistryKeySnapshot::Values& values = app_id_key.values();
 
-    HRESULT hr = app_id_key->GetValueNameAt(i, &attribute_name, &type);
+  for (size_t i = 0; i < values.size(); ++i) {
+    CString attribute_name(values[i].name);
     attribute_name.MakeLower();
-    if (FAILED(hr)) {
-      OPT_LOG(LE, (_T("[ReadAppDefinedAttributeValues][Failed read Attribute]")
-                   _T("[%s][%#x]"), attribute_name, hr));
-      continue;
-    }
 
     if (!String_StartsWith(attribute_name, kRegValueAppDefinedPrefix, false)) {
       continue;
     }
 
-    if (type != REG_SZ) {
+    if (values[i].type != REG_SZ) {
       OPT_LOG(LE, (_T("[ReadAppDefinedAttributeValues][Type needs to be")
-                   _T(" REG_SZ[%s][%#x]"), attribute_name, type));
-      continue;
-    }
-
-    CString attribute_value;
-    hr = app_id_key->GetValue(attribute_name, &attribute_value);
-    if (FAILED(hr)) {
+                   _T(" REG_SZ[%s][%#x]"), attribute_name, values[i].type));
       continue;
     }
 
-    attributes->push_back(std::make_pair(attribute_name, attribute_value));
+    attributes->push_back(std::make_pair(attribute_name, values[i].string));
   }
 
   return S_OK;
 }
 
 HRESULT AppManager::ReadAppDefinedAttributeSubkeys(
-    RegKey* app_id_key, std::vector<StringPair>* attributes) const {
-  ASSERT1(app_id_key);
+    const RegistryKeySnapshot& app_id_key,
+    std::vector<StringPair>* attributes) const {
   ASSERT1(attributes);
 
-  const int num_subkeys = app_id_key->GetSubkeyCount();
+  const RegistryKeySnapshot::Subkeys& subkeys = app_id_key.subkeys();
 
-  for (int i = 0; i < num_subkeys; ++i) {
-    CString attribute_subkey_name;
-    HRESULT hr = app_id_key->GetSubkeyNameAt(i, &attribute_subkey_name);
+  for (size_t i = 0; i < subkeys.size(); ++i) {
+    const RegistryKeySnapshot& attribute_subkey = *subkeys[i];
+    CString attribute_subkey_name(attribute_subkey.name());
     attribute_subkey_name.MakeLower();
-    if (FAILED(hr)) {
-      continue;
-    }
 
     if (!String_StartsWith(attribute_subkey_name,
                            kRegValueAppDefinedPrefix,
@@ -473,17 +462,9 @@ HRESULT AppManager::ReadAppDefinedAttributeSubkeys(
       continue;
     }
 
-
-    RegKey attribute_subkey;
-    hr = attribute_subkey.Open(app_id_key->Key(),
-                               attribute_subkey_name,
-                               KEY_READ);
-    if (FAILED(hr)) {
-      continue;
-    }
-
     CString value;
-    hr = attribute_subkey.GetValue(kRegValueAppDefinedAggregate, &value);
+    HRESULT hr = attribute_subkey.GetValue(kRegValueAppDefinedAggregate,
+                                           &value);
     if (FAILED(hr)) {
       continue;
     }
@@ -494,30 +475,17 @@ HRESULT AppManager::ReadAppDefinedAttributeSubkeys(
       continue;
     }
 
-    const int num_values = attribute_subkey.GetValueCount();
+    const RegistryKeySnapshot::Values& values = attribute_subkey.values();
     DWORD attribute_sum = 0;
 
-    for (int j = 0; j < num_values; ++j) {
-      CString value_name;
-      DWORD type(REG_DWORD);
-      hr = attribute_subkey.GetValueNameAt(j, &value_name, &type);
-      if (FAILED(hr)) {
-        continue;
-      }
-
-      if (type != REG_DWORD) {
+    for (size_t j = 0; j < values.size(); ++j) {
+      if (values[j].type != REG_DWORD) {
         OPT_LOG(LE, (_T("[ReadAppDefinedAttributeSubkeys][Type needs to be")
-                     _T(" DWORD[%s]"), value_name));
+                     _T(" DWORD[%s]"), values[j].name));
         continue;
       }
 
-      DWORD val = 0;
-      hr = attribute_subkey.GetValue(value_name, &val);
-      if (FAILED(hr)) {
-        continue;
-      }
-
-      attribute_sum += val;
+      attribute_sum += static_cast<DWORD>(values[j].number);
     }
 
 
@@ -562,31 +530,39 @@ HRESULT AppManager::ReadAppDefinedAttributeSubkeys(
 // Note: If the application is uninstalled, the Clients key may not exist.
 HRESULT AppManager::ReadAppPersistentData(App* app) {
   ASSERT1(app);
+  ASSERT1(app->model()->IsLockedByCaller());
+
+  __mutexScope(registry_access_lock_);
+
+  AppRegistrySnapshot snapshot(is_machine_);
+  VERIFY1(SUCCEEDED(snapshot.LoadApp(RegKeyRegistrySource(),
+                                     app->app_guid_string())));
+  return ReadAppPersistentData(app, *snapshot.GetApp(app->app_guid_string()));
+}
+
+HRESULT AppManager::ReadAppPersistentData(App* app,
+                                          const AppRegistryRecord& record) {
+  ASSERT1(app);
 
-  const GUID& app_guid = app->app_guid();
   const CString& app_guid_string = app->app_guid_string();
 
   CORE_LOG(L2, (_T("[AppManager::ReadAppPersistentData][%s]"),
                 app_guid_string));
 
   ASSERT1(app->model()->IsLockedByCaller());
+  ASSERT1(!record.app_id().CompareNoCase(app_guid_string));
 
   __mutexScope(registry_access_lock_);
 
-  const bool is_eula_accepted =
-      app_registry_utils::IsAppEulaAccepted(is_machine_,
-                                            app_guid_string,
-                                            false);
+  const bool is_eula_accepted = IsAppEulaAccepted(record);
   app->is_eula_accepted_ = is_eula_accepted ? TRISTATE_TRUE : TRISTATE_FALSE;
 
-  bool client_key_exists = false;
-  RegKey client_key;
-  HRESULT hr = OpenClientKey(app_guid, &client_key);
-  if (SUCCEEDED(hr)) {
-    client_key_exists = true;
+  const bool client_key_exists = record.has_clients_key();
+  if (client_key_exists) {
+    const RegistryKeySnapshot& client_key = record.clients_key();
 
     CString version;
-    hr = client_key.GetValue(kRegValueProductVersion, &version);
+    HRESULT hr = client_key.GetValue(kRegValueProductVersion, &version);
     CORE_LOG(L3, (_T("[AppManager::ReadAppPersistentData]")
                   _T("[%s][version=%s]"), app_guid_string, version));
     if (FAILED(hr)) {
@@ -623,7 +599,7 @@ HRESULT AppManager::ReadAppPersistentData(App* app) {
   app->set_day_of_last_roll_call(-1);
 
   // The following do not rely on client_state_key, so check them before
-  // possibly returning if OpenClientStateKey fails.
+  // possibly returning if the ClientState key does not exist.
 
   // Reads the did run value.
   ApplicationUsageData app_usage(is_machine_, vista_util::IsVistaOrLater());
@@ -637,9 +613,7 @@ HRESULT AppManager::ReadAppPersistentData(App* app) {
   // that the results when ClientState does not exist are desirable. See the
   // comments near that function and above set_days_since_last_active_ping call.
 
-  RegKey client_state_key;
-  hr = OpenClientStateKey(app_guid, KEY_READ, &client_state_key);
-  if (FAILED(hr)) {
+  if (!record.has_client_state_key()) {
     // It is possible that the client state key has not yet been populated.
     // In this case just return the information that we have gathered thus far.
     // However if both keys do not exist, then we are doing something wrong.
@@ -647,22 +621,23 @@ HRESULT AppManager::ReadAppPersistentData(App* app) {
     if (client_key_exists) {
       return S_OK;
     } else {
-      return hr;
+      return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
     }
   }
+  const RegistryKeySnapshot& client_state_key = record.client_state_key();
 
   // Read language from ClientState key if it was not found in the Clients key.
   if (app->language().IsEmpty()) {
     client_state_key.GetValue(kRegValueLanguage, &app->language_);
   }
 
-  VERIFY1(SUCCEEDED(ReadAppDefinedAttributes(GuidToString(app_guid),
+  VERIFY1(SUCCEEDED(ReadAppDefinedAttributes(record,
                                              &app->app_defined_attributes_)));
 
   client_state_key.GetValue(kRegValueAdditionalParams, &app->ap_);
   client_state_key.GetValue(kRegValueTTToken, &app->tt_token_);
 
-  ReadCohort(app_guid, &app->cohort_);
+  ReadCohort(record, &app->cohort_);
 
   CString iid;
   client_state_key.GetValue(kRegValueInstallationId, &iid);
@@ -693,13 +668,12 @@ HRESULT AppManager::ReadAppPersistentData(App* app) {
     app->set_days_since_last_roll_call(days_since_last_roll_call);
   }
 
-  app->install_time_diff_sec_ = GetInstallTimeDiffSec(app_guid);
+  app->install_time_diff_sec_ = GetInstallTimeDiffSec(record);
   // Generally GetInstallTimeDiffSec() shouldn't return kInitialInstallTimeDiff
   // here. The only exception is in the unexpected case when ClientState exists
   // without a pv.
   ASSERT1((app->install_time_diff_sec_ != kInitialInstallTimeDiff) ||
-          !RegKey::HasValue(GetClientStateKeyName(app_guid),
-                            kRegValueProductVersion));
+          !client_state_key.HasValue(kRegValueProductVersion));
 
   // For apps installed before day_of_install is implemented, skip sending
   // day_of_last* one more time (hence resets the values to 0). Once client
@@ -724,7 +698,7 @@ HRESULT AppManager::ReadAppPersistentData(App* app) {
     app->set_day_of_last_roll_call(day_of_last_roll_call);
   }
 
-  app->day_of_install_ = GetDayOfInstall(app_guid);
+  app->day_of_install_ = GetDayOfInstall(record);
 
   CString ping_freshness;
   if (SUCCEEDED(client_state_key.GetValue(kRegValuePingFreshness,
@@ -1172,12 +1146,19 @@ HRESULT AppManager::WriteDownloadProgress(const App& app,
   CORE_LOG(L2, (_T("[AppManager::WriteDownloadProgress][%s]"),
                 app.app_guid_string()));
 
-  if (bytes_total <= 0) {
+  if (bytes_total == 0) {
     return E_INVALIDARG;
   }
 
-  int download_progress_percentage =
-      static_cast<int>(100ULL * bytes_downloaded / bytes_total);
+  // Multiplying by 100 first keeps the precision of small totals, but would
+  // overflow for counts close to the limit of uint64.
+  uint64 download_progress_percentage = 100;
+  if (bytes_downloaded < bytes_total) {
+    download_progress_percentage =
+        bytes_downloaded <= ULLONG_MAX / 100 ?
+        100 * bytes_downloaded / bytes_total :
+        bytes_downloaded / (bytes_total / 100);
+  }
 
   const CString current_state_key_name(
       GetCurrentStateKeyName(app.app_guid_string()));
@@ -1280,14 +1261,33 @@ HRESULT AppManager::DeleteCohortKey(const GUID& app_guid) const {
                                              GuidToString(app_guid));
 }
 
-HRESULT AppManager::ReadCohort(const GUID& app_guid, Cohort * cohort) const {
-  CORE_LOG(L3, (_T("[AppManager::ReadCohort][%s]"), GuidToString(app_guid)));
+// Same as app_registry_utils::ReadCohort(), from the cohort subkey of the
+// app's ClientState key.
+HRESULT AppManager::ReadCohort(const AppRegistryRecord& record,
+                               Cohort* cohort) const {
+  CORE_LOG(L3, (_T("[AppManager::ReadCohort][%s]"), record.app_id()));
 
   ASSERT1(cohort);
 
-  return app_registry_utils::ReadCohort(is_machine_,
-                                        GuidToString(app_guid),
-                                        cohort);
+  const RegistryKeySnapshot* cohort_key =
+      record.client_state_key().GetSubkey(kRegSubkeyCohort);
+  if (!cohort_key) {
+    return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+  }
+
+  HRESULT hr = cohort_key->GetValue(NULL, &cohort->cohort);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  // Optional values.
+  cohort_key->GetValue(kRegValueCohortHint, &cohort->hint);
+  cohort_key->GetValue(kRegValueCohortName, &cohort->name);
+
+  CORE_LOG(L3, (_T("[AppManager::ReadCohort][%s][%s][%s]"), cohort->cohort,
+                                                            cohort->hint,
+                                                            cohort->name));
+  return S_OK;
 }
 
 HRESULT AppManager::WriteCohort(const App& app) const {
@@ -1365,29 +1365,40 @@ void AppManager::UpdateUpdateAvailableStats(const GUID& app_guid) const {
   }
 }
 
-// Returns 0 for any values that are not found.
 void AppManager::ReadUpdateAvailableStats(
     const GUID& app_guid,
     DWORD* update_responses,
     DWORD64* time_since_first_response_ms) {
+  __mutexScope(registry_access_lock_);
+
+  const CString app_id(GuidToString(app_guid));
+  AppRegistrySnapshot snapshot(is_machine_);
+  VERIFY1(SUCCEEDED(snapshot.LoadApp(RegKeyRegistrySource(), app_id)));
+  ReadUpdateAvailableStats(*snapshot.GetApp(app_id),
+                           update_responses,
+                           time_since_first_response_ms);
+}
+
+// Returns 0 for any values that are not found.
+void AppManager::ReadUpdateAvailableStats(
+    const AppRegistryRecord& record,
+    DWORD* update_responses,
+    DWORD64* time_since_first_response_ms) const {
   ASSERT1(update_responses);
   ASSERT1(time_since_first_response_ms);
   *update_responses = 0;
   *time_since_first_response_ms = 0;
 
-  __mutexScope(registry_access_lock_);
-
-  RegKey state_key;
-  HRESULT hr = OpenClientStateKey(app_guid, KEY_READ, &state_key);
-  if (FAILED(hr)) {
+  if (!record.has_client_state_key()) {
     CORE_LOG(LW, (_T("[App ClientState key does not exist][%s]"),
-                  GuidToString(app_guid)));
+                  record.app_id()));
     return;
   }
+  const RegistryKeySnapshot& state_key = record.client_state_key();
 
   DWORD update_responses_in_reg(0);
-  hr = state_key.GetValue(kRegValueUpdateAvailableCount,
-                          &update_responses_in_reg);
+  HRESULT hr = state_key.GetValue(kRegValueUpdateAvailableCount,
+                                  &update_responses_in_reg);
   if (SUCCEEDED(hr)) {
     *update_responses = update_responses_in_reg;
   }
@@ -1431,6 +1442,66 @@ uint32 AppManager::GetDayOfInstall(const GUID& app_guid) const {
   return kUnknownDayOfInstall;
 }
 
+uint32 AppManager::GetInstallTimeDiffSec(
+    const AppRegistryRecord& record) const {
+  if (!record.IsRegistered() && !record.IsUninstalled()) {
+    return kInitialInstallTimeDiff;
+  }
+
+  DWORD install_time(0);
+  if (FAILED(record.client_state_key().GetValue(kRegValueInstallTimeSec,
+                                                &install_time))) {
+    return 0;
+  }
+
+  return app_registry_utils::GetInstallTimeDiffSec(install_time);
+}
+
+uint32 AppManager::GetDayOfInstall(const AppRegistryRecord& record) const {
+  if (!record.IsRegistered() && !record.IsUninstalled()) {
+    return kInitialDayOfInstall;
+  }
+
+  DWORD day_of_install(0);
+  if (SUCCEEDED(record.client_state_key().GetValue(kRegValueDayOfInstall,
+                                                   &day_of_install)) &&
+      day_of_install != static_cast<DWORD>(-1)) {
+    return app_registry_utils::TruncateDayOfInstall(day_of_install);
+  }
+
+  // No DayOfInstall is present. This app is probably installed before
+  // DayOfInstall was implemented. Do not send DayOfInstall in this case.
+  return kUnknownDayOfInstall;
+}
+
+// Same as app_registry_utils::IsAppEulaAccepted() without explicit acceptance,
+// including copying the acceptance from ClientStateMedium to ClientState.
+bool AppManager::IsAppEulaAccepted(const AppRegistryRecord& record) const {
+  DWORD eula_accepted = 0;
+  if (FAILED(record.client_state_key().GetValue(kRegValueEulaAccepted,
+                                                &eula_accepted)) ||
+      0 != eula_accepted) {
+    return true;
+  }
+
+  if (!is_machine_) {
+    return false;
+  }
+
+  eula_accepted = 0;
+  if (FAILED(record.client_state_medium_key().GetValue(kRegValueEulaAccepted,
+                                                       &eula_accepted)) ||
+      0 == eula_accepted) {
+    return false;
+  }
+
+  VERIFY1(SUCCEEDED(RegKey::SetValue(
+      app_registry_utils::GetAppClientStateKey(is_machine_, record.app_id()),
+      kRegValueEulaAccepted,
+      eula_accepted)));
+  return true;
+}
+
 // Clear the Installation ID if at least one of the conditions is true:
 // 1) DidRun==yes. First run is the last time we want to use the Installation
 //    ID. So delete Installation ID if it is present.
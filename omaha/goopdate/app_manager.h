@@ -27,7 +27,10 @@
 namespace omaha {
 
 class App;
+class AppRegistryRecord;
+class AppRegistrySnapshot;
 struct Cohort;
+class RegistryKeySnapshot;
 class RegKey;
 
 typedef std::vector<CString> AppIdVector;
@@ -72,9 +75,16 @@ class AppManager {
   static HRESULT ReadAppVersionNoLock(bool is_machine, const GUID& app_guid,
                                       CString* version);
 
+  bool is_machine() const { return is_machine_; }
+
   bool IsAppRegistered(const GUID& app_guid) const;
   bool IsAppUninstalled(const GUID& app_guid) const;
 
+  // Loads the registry state of all the apps into |snapshot|, which must be
+  // empty, with one enumeration of each of the Clients, ClientState and
+  // ClientStateMedium trees.
+  HRESULT LoadRegistrySnapshot(AppRegistrySnapshot* snapshot) const;
+
   // Adds all registered products to bundle.
   HRESULT GetRegisteredApps(AppIdVector* app_ids) const;
 
@@ -98,6 +108,11 @@ class AppManager {
   // Populates the app object with the persisted state stored in the registry.
   HRESULT ReadAppPersistentData(App* app);
 
+  // Populates the app object from the app's record in a registry snapshot
+  // instead of reading the registry. The result is the same as the overload
+  // above if the registry did not change since the snapshot was loaded.
+  HRESULT ReadAppPersistentData(App* app, const AppRegistryRecord& record);
+
   // Populates the app object with the install time diff based on the install
   // time stored in the registry.
   // If the app is registered or has pv value, app's install time diff will be
@@ -178,6 +193,9 @@ class AppManager {
   void ReadUpdateAvailableStats(const GUID& app_guid,
                                 DWORD* update_responses,
                                 DWORD64* time_since_first_response_ms);
+  void ReadUpdateAvailableStats(const AppRegistryRecord& record,
+                                DWORD* update_responses,
+                                DWORD64* time_since_first_response_ms) const;
 
   // Removes the ClientState and ClientStateMedium keys for the application.
   HRESULT RemoveClientState(const GUID& app_guid);
@@ -235,20 +253,23 @@ class AppManager {
   // Reads name/value pairs that have a '_' prefix under the
   // ClientState/ClientStateMedium key.
   HRESULT ReadAppDefinedAttributes(
-      const CString& app_id, std::vector<StringPair>* attributes) const;
+      const AppRegistryRecord& record,
+      std::vector<StringPair>* attributes) const;
   HRESULT ReadAppDefinedAttributeValues(
-      RegKey* app_id_key, std::vector<StringPair>* attributes) const;
+      const RegistryKeySnapshot& app_id_key,
+      std::vector<StringPair>* attributes) const;
   // Aggregates are '_' prefixed subkeys that store values that need to be
   // aggregated. The only aggregate supported at the moment is "sum".
   HRESULT ReadAppDefinedAttributeSubkeys(
-      RegKey* app_id_key, std::vector<StringPair>* attributes) const;
+      const RegistryKeySnapshot& app_id_key,
+      std::vector<StringPair>* attributes) const;
 
   // Write the TT Token with what the server returned.
   HRESULT SetTTToken(const App& app) const;
 
   CString GetCohortKeyName(const GUID& app_guid) const;
   HRESULT DeleteCohortKey(const GUID& app_guid) const;
-  HRESULT ReadCohort(const GUID& app_guid, Cohort* cohort) const;
+  HRESULT ReadCohort(const AppRegistryRecord& record, Cohort* cohort) const;
   HRESULT WriteCohort(const App& app) const;
 
   // Stores information about the update available event for the app.
@@ -257,6 +278,14 @@ class AppManager {
 
   HRESULT ClearInstallationId(const App& app) const;
 
+  // Same as the public functions, from the app's record in a snapshot.
+  uint32 GetInstallTimeDiffSec(const AppRegistryRecord& record) const;
+  uint32 GetDayOfInstall(const AppRegistryRecord& record) const;
+
+  // Returns whether the EULA is accepted, implicitly or explicitly. Copies the
+  // acceptance from ClientStateMedium to ClientState, which is the only write.
+  bool IsAppEulaAccepted(const AppRegistryRecord& record) const;
+
   // Writes the elapsed days since datum and day start time when last active
   // ping/roll call happened to registry. Updates the ping freshness.
   void SetLastPingTimeMetrics(const App& app,
@@ -30,6 +30,7 @@
 #include "omaha/common/app_registry_utils.h"
 #include "omaha/common/config_manager.h"
 #include "omaha/common/const_goopdate.h"
+#include "omaha/goopdate/app_registry_snapshot.h"
 #include "omaha/goopdate/app_unittest_base.h"
 #include "omaha/goopdate/worker.h"
 #include "omaha/setup/setup_google_update.h"
@@ -519,22 +520,33 @@ class AppManagerTestBase : public AppTestBaseWithRegistryOverride {
   }
 
   void WriteDownloadProgressTest() {
+    WriteDownloadProgressTest(10, 100, 10);
+  }
+
+  // Packages can be larger than 4GB.
+  void WriteDownloadProgressLargeTest() {
+    const uint64 kFiveGB = 5ULL * 1024 * 1024 * 1024;
+    WriteDownloadProgressTest(kFiveGB / 4 * 3, kFiveGB, 75);
+    WriteDownloadProgressTest(kFiveGB, kFiveGB, 100);
+    WriteDownloadProgressTest(ULLONG_MAX / 2, ULLONG_MAX, 49);
+  }
+
+  void WriteDownloadProgressTest(
+      uint64 expected_bytes_downloaded,
+      uint64 expected_bytes_total,
+      LONG expected_download_progress_percentage) {
     app_->iid_ =
         StringToGuid(_T("{64333341-CA93-490d-9FB7-7FC5728721F4}"));
     EXPECT_SUCCEEDED(
         app_manager_->ResetCurrentStateKey(app_->app_guid_string()));
 
-    const uint64 expected_bytes_downloaded = 10;
-    const uint64 expected_bytes_total = 100;
     const LONG expected_download_time_remaining_ms = 300;
-    LONG expected_download_progress_percentage =
-        static_cast<LONG>(100ULL *
-                          expected_bytes_downloaded / expected_bytes_total);
 
-    app_manager_->WriteDownloadProgress(*app_,
-                                        expected_bytes_downloaded,
-                                        expected_bytes_total,
-                                        expected_download_time_remaining_ms);
+    EXPECT_SUCCEEDED(app_manager_->WriteDownloadProgress(
+        *app_,
+        expected_bytes_downloaded,
+        expected_bytes_total,
+        expected_download_time_remaining_ms));
 
     RegKey current_state_key;
     ASSERT_SUCCEEDED(current_state_key.Open(
@@ -1899,6 +1911,40 @@ TEST_F(AppManagerReadAppPersistentDataMachineTest, AppExists) {
   ValidateExpectedValues(*expected_app, *app_);
 }
 
+TEST_F(AppManagerReadAppPersistentDataUserTest, AppExists_FromSnapshot) {
+  App* expected_app = CreateAppForRegistryPopulation(kGuid1);
+  PopulateExpectedApp1(expected_app);
+  CreateAppRegistryState(*expected_app, is_machine_, _T("1.0.0.0"), true);
+
+  AppRegistrySnapshot snapshot(is_machine_);
+  EXPECT_SUCCEEDED(app_manager_->LoadRegistrySnapshot(&snapshot));
+  const AppRegistryRecord* record = snapshot.GetApp(kGuid1);
+  ASSERT_TRUE(record);
+
+  __mutexScope(app_->model()->lock());
+  EXPECT_SUCCEEDED(app_manager_->ReadAppPersistentData(app_, *record));
+
+  EXPECT_SUCCEEDED(expected_app->put_isEulaAccepted(VARIANT_TRUE));
+  ValidateExpectedValues(*expected_app, *app_);
+}
+
+TEST_F(AppManagerReadAppPersistentDataMachineTest, AppExists_FromSnapshot) {
+  App* expected_app = CreateAppForRegistryPopulation(kGuid1);
+  PopulateExpectedApp1(expected_app);
+  CreateAppRegistryState(*expected_app, is_machine_, _T("1.0.0.0"), true);
+
+  AppRegistrySnapshot snapshot(is_machine_);
+  EXPECT_SUCCEEDED(app_manager_->LoadRegistrySnapshot(&snapshot));
+  const AppRegistryRecord* record = snapshot.GetApp(kGuid1);
+  ASSERT_TRUE(record);
+
+  __mutexScope(app_->model()->lock());
+  EXPECT_SUCCEEDED(app_manager_->ReadAppPersistentData(app_, *record));
+
+  EXPECT_SUCCEEDED(expected_app->put_isEulaAccepted(VARIANT_TRUE));
+  ValidateExpectedValues(*expected_app, *app_);
+}
+
 TEST_F(AppManagerReadAppPersistentDataUserTest, AppExists_NoDisplayName) {
   App* expected_app = CreateAppForRegistryPopulation(kGuid1);
   PopulateExpectedApp1(expected_app);
@@ -2469,6 +2515,10 @@ TEST_F(AppManagerUserTest, WriteDownloadProgress) {
   WriteDownloadProgressTest();
 }
 
+TEST_F(AppManagerUserTest, WriteDownloadProgress_Large) {
+  WriteDownloadProgressLargeTest();
+}
+
 TEST_F(AppManagerUserTest, WriteInstallProgress) {
   WriteInstallProgressTest();
 }
@@ -0,0 +1,578 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+
+#include "omaha/goopdate/app_registry_snapshot.h"
+
+#include "omaha/base/debug.h"
+#include "omaha/base/error.h"
+#include "omaha/base/logging.h"
+#include "omaha/base/reg_key.h"
+#include "omaha/base/utils.h"
+#include "omaha/common/config_manager.h"
+#include "omaha/common/const_goopdate.h"
+
+namespace omaha {
+
+namespace {
+
+// The Clients tree is read down to the values of the apps. The ClientState
+// trees are read down to the subkeys of the apps, which contain the cohort
+// and the app-defined aggregates.
+const int kClientsDepth = 1;
+const int kClientStateDepth = 2;
+
+const HRESULT kValueNotFound = HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+const HRESULT kValueTypeMismatch = HRESULT_FROM_WIN32(ERROR_DATATYPE_MISMATCH);
+
+// Expands the environment variables the same way SHQueryValueEx does when it
+// reads a REG_EXPAND_SZ value.
+CString ExpandString(const CString& value) {
+  const DWORD size = ::ExpandEnvironmentStrings(value, NULL, 0);
+  if (!size) {
+    return value;
+  }
+
+  CString expanded;
+  const DWORD length =
+      ::ExpandEnvironmentStrings(value, expanded.GetBuffer(size), size);
+  expanded.ReleaseBuffer();
+  return length && length <= size ? expanded : value;
+}
+
+// Reads the values and the subkeys of |key|. The sizes of the buffers are
+// queried once, then the values are read with their data.
+HRESULT ReadRegKey(RegKey* key,
+                   const CString& key_name,
+                   int depth,
+                   std::shared_ptr<const RegistryKeySnapshot>* snapshot) {
+  ASSERT1(key);
+  ASSERT1(snapshot);
+
+  DWORD num_subkeys = 0;
+  DWORD max_subkey_name_length = 0;
+  DWORD num_values = 0;
+  DWORD max_value_name_length = 0;
+  DWORD max_data_size = 0;
+  LONG res = ::RegQueryInfoKey(key->Key(),
+                               NULL,
+                               NULL,
+                               NULL,
+                               &num_subkeys,
+                               &max_subkey_name_length,
+                               NULL,
+                               &num_values,
+                               &max_value_name_length,
+                               &max_data_size,
+                               NULL,
+                               NULL);
+  if (res != ERROR_SUCCESS) {
+    return HRESULT_FROM_WIN32(res);
+  }
+
+  std::shared_ptr<RegistryKeySnapshot> result(
+      new RegistryKeySnapshot(key_name));
+
+  // Two more characters terminate strings stored without their terminating
+  // character.
+  std::vector<TCHAR> value_name(max_value_name_length + 1);
+  std::vector<byte> data(max_data_size + 2 * sizeof(TCHAR));
+  for (DWORD i = 0; i != num_values; ++i) {
+    DWORD value_name_length = static_cast<DWORD>(value_name.size());
+    DWORD type = REG_NONE;
+    DWORD data_size = max_data_size;
+    res = ::RegEnumValue(key->Key(),
+                         i,
+                         &value_name.front(),
+                         &value_name_length,
+                         NULL,
+                         &type,
+                         &data.front(),
+                         &data_size);
+    if (res == ERROR_NO_MORE_ITEMS) {
+      break;
+    }
+    if (res != ERROR_SUCCESS) {
+      // The value may have grown since the key was queried.
+      CORE_LOG(LW, (_T("[RegEnumValue failed][%s][%u][%d]"),
+                    key_name, i, res));
+      continue;
+    }
+
+    const CString name(&value_name.front(), value_name_length);
+    switch (type) {
+      case REG_SZ:
+      case REG_EXPAND_SZ: {
+        ::ZeroMemory(&data.front() + data_size, 2 * sizeof(TCHAR));
+        const CString value(reinterpret_cast<const TCHAR*>(&data.front()));
+        result->SetValue(name, type == REG_SZ ? value : ExpandString(value));
+        break;
+      }
+      case REG_DWORD:
+        if (data_size == sizeof(DWORD)) {
+          result->SetValue(name,
+                           *reinterpret_cast<const DWORD*>(&data.front()));
+        }
+        break;
+      case REG_QWORD:
+        if (data_size == sizeof(DWORD64)) {
+          result->SetValue(name,
+                           *reinterpret_cast<const DWORD64*>(&data.front()));
+        }
+        break;
+      default:
+        break;
+    }
+  }
+
+  if (depth > 0) {
+    std::vector<TCHAR> subkey_name(max_subkey_name_length + 1);
+    for (DWORD i = 0; i != num_subkeys; ++i) {
+      DWORD subkey_name_length = static_cast<DWORD>(subkey_name.size());
+      res = ::RegEnumKeyEx(key->Key(),
+                           i,
+                           &subkey_name.front(),
+                           &subkey_name_length,
+                           NULL,
+                           NULL,
+                           NULL,
+                           NULL);
+      if (res == ERROR_NO_MORE_ITEMS) {
+        break;
+      }
+      if (res != ERROR_SUCCESS) {
+        CORE_LOG(LW, (_T("[RegEnumKeyEx failed][%s][%u][%d]"),
+                      key_name, i, res));
+        continue;
+      }
+
+      const CString name(&subkey_name.front(), subkey_name_length);
+      RegKey subkey;
+      if (FAILED(subkey.Open(key->Key(), name, KEY_READ))) {
+        // The subkey may have been deleted since it was enumerated.
+        continue;
+      }
+
+      std::shared_ptr<const RegistryKeySnapshot> subkey_snapshot;
+      if (SUCCEEDED(ReadRegKey(&subkey, name, depth - 1, &subkey_snapshot))) {
+        result->AddSubkey(subkey_snapshot);
+      }
+    }
+  }
+
+  *snapshot = result;
+  return S_OK;
+}
+
+// Returns the last component of |key_name|.
+CString GetLeafName(const CString& key_name) {
+  return key_name.Mid(key_name.ReverseFind(_T('\\')) + 1);
+}
+
+}  // namespace
+
+bool RegistryKeySnapshot::HasValue(const TCHAR* name) const {
+  return !!FindValue(name);
+}
+
+HRESULT RegistryKeySnapshot::GetValue(const TCHAR* name,
+                                      CString* value) const {
+  ASSERT1(value);
+
+  const Value* found = FindValue(name);
+  if (!found) {
+    return kValueNotFound;
+  }
+  if (found->type != REG_SZ && found->type != REG_EXPAND_SZ) {
+    return kValueTypeMismatch;
+  }
+
+  *value = found->string;
+  return S_OK;
+}
+
+HRESULT RegistryKeySnapshot::GetValue(const TCHAR* name, DWORD* value) const {
+  ASSERT1(value);
+
+  const Value* found = FindValue(name);
+  if (!found) {
+    return kValueNotFound;
+  }
+  if (found->type != REG_DWORD) {
+    return kValueTypeMismatch;
+  }
+
+  *value = static_cast<DWORD>(found->number);
+  return S_OK;
+}
+
+HRESULT RegistryKeySnapshot::GetValue(const TCHAR* name,
+                                      DWORD64* value) const {
+  ASSERT1(value);
+
+  const Value* found = FindValue(name);
+  if (!found) {
+    return kValueNotFound;
+  }
+  if (found->type != REG_QWORD) {
+    return kValueTypeMismatch;
+  }
+
+  *value = found->number;
+  return S_OK;
+}
+
+const RegistryKeySnapshot* RegistryKeySnapshot::GetSubkey(
+    const TCHAR* name) const {
+  ASSERT1(name);
+
+  for (size_t i = 0; i != subkeys_.size(); ++i) {
+    if (!subkeys_[i]->name().CompareNoCase(name)) {
+      return subkeys_[i].get();
+    }
+  }
+  return NULL;
+}
+
+void RegistryKeySnapshot::SetValue(const TCHAR* name, const CString& value) {
+  Value* added = AddValue(name);
+  added->type = REG_SZ;
+  added->string = value;
+}
+
+void RegistryKeySnapshot::SetValue(const TCHAR* name, DWORD value) {
+  Value* added = AddValue(name);
+  added->type = REG_DWORD;
+  added->number = value;
+}
+
+void RegistryKeySnapshot::SetValue(const TCHAR* name, DWORD64 value) {
+  Value* added = AddValue(name);
+  added->type = REG_QWORD;
+  added->number = value;
+}
+
+void RegistryKeySnapshot::AddSubkey(
+    std::shared_ptr<const RegistryKeySnapshot> subkey) {
+  ASSERT1(subkey);
+  ASSERT1(!GetSubkey(subkey->name()));
+  subkeys_.push_back(subkey);
+}
+
+// A NULL name is the default value, the same as for RegKey.
+const RegistryKeySnapshot::Value* RegistryKeySnapshot::FindValue(
+    const TCHAR* name) const {
+  const TCHAR* const value_name = name ? name : _T("");
+  for (size_t i = 0; i != values_.size(); ++i) {
+    if (!values_[i].name.CompareNoCase(value_name)) {
+      return &values_[i];
+    }
+  }
+  return NULL;
+}
+
+RegistryKeySnapshot::Value* RegistryKeySnapshot::AddValue(const TCHAR* name) {
+  const Value* existing_value = FindValue(name);
+  if (existing_value) {
+    Value* value = &values_[existing_value - &values_.front()];
+    value->string.Empty();
+    value->number = 0;
+    return value;
+  }
+
+  values_.push_back(Value());
+  values_.back().name = name ? name : _T("");
+  return &values_.back();
+}
+
+HRESULT RegKeyRegistrySource::ReadKey(
+    const CString& full_key_name,
+    int depth,
+    std::shared_ptr<const RegistryKeySnapshot>* key) const {
+  ASSERT1(depth >= 0);
+  ASSERT1(key);
+
+  RegKey reg_key;
+  HRESULT hr = reg_key.Open(full_key_name, KEY_READ);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  return ReadRegKey(&reg_key, GetLeafName(full_key_name), depth, key);
+}
+
+InMemoryRegistrySource::InMemoryRegistrySource() : root_(CString()) {
+}
+
+void InMemoryRegistrySource::CreateKey(const CString& full_key_name) {
+  CreateKeyPath(full_key_name);
+}
+
+void InMemoryRegistrySource::SetValue(const CString& full_key_name,
+                                      const TCHAR* name,
+                                      const CString& value) {
+  CreateKeyPath(full_key_name)->values.SetValue(name, value);
+}
+
+void InMemoryRegistrySource::SetValue(const CString& full_key_name,
+                                      const TCHAR* name,
+                                      DWORD value) {
+  CreateKeyPath(full_key_name)->values.SetValue(name, value);
+}
+
+void InMemoryRegistrySource::SetValue(const CString& full_key_name,
+                                      const TCHAR* name,
+                                      DWORD64 value) {
+  CreateKeyPath(full_key_name)->values.SetValue(name, value);
+}
+
+HRESULT InMemoryRegistrySource::ReadKey(
+    const CString& full_key_name,
+    int depth,
+    std::shared_ptr<const RegistryKeySnapshot>* key) const {
+  ASSERT1(depth >= 0);
+  ASSERT1(key);
+
+  const Key* found = FindKey(full_key_name);
+  if (!found) {
+    return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+  }
+
+  *key = CopyKey(*found, depth);
+  return S_OK;
+}
+
+InMemoryRegistrySource::Key* InMemoryRegistrySource::CreateKeyPath(
+    const CString& full_key_name) {
+  Key* key = &root_;
+  int position = 0;
+  for (CString name = full_key_name.Tokenize(_T("\\"), position);
+       position != -1;
+       name = full_key_name.Tokenize(_T("\\"), position)) {
+    CString lowercase_name(name);
+    lowercase_name.MakeLower();
+    std::unique_ptr<Key>& subkey = key->subkeys[lowercase_name];
+    if (!subkey) {
+      subkey.reset(new Key(name));
+    }
+    key = subkey.get();
+  }
+  return key;
+}
+
+const InMemoryRegistrySource::Key* InMemoryRegistrySource::FindKey(
+    const CString& full_key_name) const {
+  const Key* key = &root_;
+  int position = 0;
+  for (CString name = full_key_name.Tokenize(_T("\\"), position);
+       position != -1;
+       name = full_key_name.Tokenize(_T("\\"), position)) {
+    name.MakeLower();
+    auto it = key->subkeys.find(name);
+    if (it == key->subkeys.end()) {
+      return NULL;
+    }
+    key = it->second.get();
+  }
+  return key;
+}
+
+std::shared_ptr<const RegistryKeySnapshot> InMemoryRegistrySource::CopyKey(
+    const Key& key,
+    int depth) {
+  std::shared_ptr<RegistryKeySnapshot> copy(
+      new RegistryKeySnapshot(key.values.name()));
+
+  const RegistryKeySnapshot::Values& values = key.values.values();
+  for (size_t i = 0; i != values.size(); ++i) {
+    if (values[i].type == REG_SZ) {
+      copy->SetValue(values[i].name, values[i].string);
+    } else if (values[i].type == REG_DWORD) {
+      copy->SetValue(values[i].name, static_cast<DWORD>(values[i].number));
+    } else {
+      ASSERT1(values[i].type == REG_QWORD);
+      copy->SetValue(values[i].name, values[i].number);
+    }
+  }
+
+  if (depth > 0) {
+    for (auto it = key.subkeys.begin(); it != key.subkeys.end(); ++it) {
+      copy->AddSubkey(CopyKey(*it->second, depth - 1));
+    }
+  }
+
+  return copy;
+}
+
+AppRegistryRecord::AppRegistryRecord(const CString& app_id)
+    : app_id_(app_id) {
+}
+
+const RegistryKeySnapshot& AppRegistryRecord::clients_key() const {
+  static const RegistryKeySnapshot kEmptyKey((CString()));
+  return clients_key_ ? *clients_key_ : kEmptyKey;
+}
+
+const RegistryKeySnapshot& AppRegistryRecord::client_state_key() const {
+  static const RegistryKeySnapshot kEmptyKey((CString()));
+  return client_state_key_ ? *client_state_key_ : kEmptyKey;
+}
+
+const RegistryKeySnapshot& AppRegistryRecord::client_state_medium_key() const {
+  static const RegistryKeySnapshot kEmptyKey((CString()));
+  return client_state_medium_key_ ? *client_state_medium_key_ : kEmptyKey;
+}
+
+bool AppRegistryRecord::IsUninstalled() const {
+  return !has_clients_key() &&
+         client_state_key().HasValue(kRegValueProductVersion);
+}
+
+AppRegistrySnapshot::AppRegistrySnapshot(bool is_machine)
+    : is_machine_(is_machine) {
+}
+
+HRESULT AppRegistrySnapshot::Load(const RegistrySource& source) {
+  ASSERT1(apps_.empty());
+
+  const ConfigManager& config_manager = *ConfigManager::Instance();
+
+  std::shared_ptr<const RegistryKeySnapshot> clients;
+  HRESULT hr = source.ReadKey(config_manager.registry_clients(is_machine_),
+                              kClientsDepth,
+                              &clients);
+  if (FAILED(hr)) {
+    CORE_LOG(LE, (_T("[AppRegistrySnapshot::Load][Clients][0x%08x]"), hr));
+    return hr;
+  }
+
+  for (size_t i = 0; i != clients->subkeys().size(); ++i) {
+    const std::shared_ptr<const RegistryKeySnapshot>& key =
+        clients->subkeys()[i];
+    GetOrAddApp(key->name())->clients_key_ = key;
+  }
+
+  // The ClientState key may not exist yet, in which case no app is
+  // uninstalled.
+  std::shared_ptr<const RegistryKeySnapshot> client_state;
+  if (SUCCEEDED(source.ReadKey(
+          config_manager.registry_client_state(is_machine_),
+          kClientStateDepth,
+          &client_state))) {
+    for (size_t i = 0; i != client_state->subkeys().size(); ++i) {
+      const std::shared_ptr<const RegistryKeySnapshot>& key =
+          client_state->subkeys()[i];
+      GetOrAddApp(key->name())->client_state_key_ = key;
+      client_state_app_ids_.push_back(key->name());
+    }
+  }
+
+  std::shared_ptr<const RegistryKeySnapshot> client_state_medium;
+  if (is_machine_ &&
+      SUCCEEDED(source.ReadKey(
+          config_manager.machine_registry_client_state_medium(),
+          kClientStateDepth,
+          &client_state_medium))) {
+    for (size_t i = 0; i != client_state_medium->subkeys().size(); ++i) {
+      const std::shared_ptr<const RegistryKeySnapshot>& key =
+          client_state_medium->subkeys()[i];
+      GetOrAddApp(key->name())->client_state_medium_key_ = key;
+    }
+  }
+
+  CORE_LOG(L3, (_T("[AppRegistrySnapshot::Load][%Iu apps]"), apps_.size()));
+  return S_OK;
+}
+
+HRESULT AppRegistrySnapshot::LoadApp(const RegistrySource& source,
+                                     const CString& app_id) {
+  ASSERT1(!app_id.IsEmpty());
+  ASSERT1(!GetApp(app_id));
+
+  const ConfigManager& config_manager = *ConfigManager::Instance();
+  AppRegistryRecord* app = GetOrAddApp(app_id);
+
+  // Missing keys are expected, for instance before the app is installed.
+  source.ReadKey(
+      AppendRegKeyPath(config_manager.registry_clients(is_machine_), app_id),
+      kClientsDepth - 1,
+      &app->clients_key_);
+
+  if (SUCCEEDED(source.ReadKey(
+          AppendRegKeyPath(config_manager.registry_client_state(is_machine_),
+                           app_id),
+          kClientStateDepth - 1,
+          &app->client_state_key_))) {
+    client_state_app_ids_.push_back(app_id);
+  }
+
+  if (is_machine_) {
+    source.ReadKey(
+        AppendRegKeyPath(config_manager.machine_registry_client_state_medium(),
+                         app_id),
+        kClientStateDepth - 1,
+        &app->client_state_medium_key_);
+  }
+
+  return S_OK;
+}
+
+const AppRegistryRecord* AppRegistrySnapshot::GetApp(
+    const CString& app_id) const {
+  CString lowercase_app_id(app_id);
+  lowercase_app_id.MakeLower();
+
+  auto it = app_indexes_.find(lowercase_app_id);
+  return it == app_indexes_.end() ? NULL : apps_[it->second].get();
+}
+
+void AppRegistrySnapshot::GetRegisteredApps(
+    std::vector<CString>* app_ids) const {
+  ASSERT1(app_ids);
+
+  for (size_t i = 0; i != apps_.size(); ++i) {
+    if (apps_[i]->IsRegistered()) {
+      app_ids->push_back(apps_[i]->app_id());
+    }
+  }
+}
+
+void AppRegistrySnapshot::GetUninstalledApps(
+    std::vector<CString>* app_ids) const {
+  ASSERT1(app_ids);
+
+  for (size_t i = 0; i != client_state_app_ids_.size(); ++i) {
+    if (GetApp(client_state_app_ids_[i])->IsUninstalled()) {
+      app_ids->push_back(client_state_app_ids_[i]);
+    }
+  }
+}
+
+AppRegistryRecord* AppRegistrySnapshot::GetOrAddApp(const CString& app_id) {
+  CString lowercase_app_id(app_id);
+  lowercase_app_id.MakeLower();
+
+  auto it = app_indexes_.find(lowercase_app_id);
+  if (it != app_indexes_.end()) {
+    return apps_[it->second].get();
+  }
+
+  app_indexes_[lowercase_app_id] = apps_.size();
+  apps_.push_back(std::unique_ptr<AppRegistryRecord>(
+      new AppRegistryRecord(app_id)));
+  return apps_.back().get();
+}
+
+}  // namespace omaha
@@ -0,0 +1,254 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+//
+// Loads the registry state of the apps in a few bulk reads. The Clients,
+// ClientState and ClientStateMedium trees are each enumerated once, and each
+// app gets an immutable record of its keys, which is then used to populate the
+// App objects and the update requests instead of reading the registry value
+// by value.
+//
+// The registry is read through a RegistrySource, which has an in-memory
+// implementation for the tests and the benchmarks. The in-memory source
+// keeps the tests off the real registry; it does not make the snapshot
+// portable, since the records use CString and the Windows registry types.
+
+#ifndef OMAHA_GOOPDATE_APP_REGISTRY_SNAPSHOT_H_
+#define OMAHA_GOOPDATE_APP_REGISTRY_SNAPSHOT_H_
+
+#include <windows.h>
+#include <atlstr.h>
+#include <map>
+#include <memory>
+#include <vector>
+#include "base/basictypes.h"
+
+namespace omaha {
+
+// The values and the subkeys of a registry key. The value and subkey names
+// are case-insensitive, the same as in the registry. The default value is
+// named "".
+class RegistryKeySnapshot {
+ public:
+  struct Value {
+    Value() : type(REG_NONE), number(0) {}
+
+    CString name;
+    DWORD type;
+
+    // Valid if |type| is REG_SZ or REG_EXPAND_SZ.
+    CString string;
+
+    // Valid if |type| is REG_DWORD or REG_QWORD.
+    DWORD64 number;
+  };
+
+  typedef std::vector<Value> Values;
+  typedef std::vector<std::shared_ptr<const RegistryKeySnapshot>> Subkeys;
+
+  explicit RegistryKeySnapshot(const CString& name) : name_(name) {}
+
+  const CString& name() const { return name_; }
+
+  // The values and the subkeys are in the order they were added in.
+  const Values& values() const { return values_; }
+  const Subkeys& subkeys() const { return subkeys_; }
+
+  bool HasValue(const TCHAR* name) const;
+
+  // The getters return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND) if the value
+  // does not exist and HRESULT_FROM_WIN32(ERROR_DATATYPE_MISMATCH) if it has
+  // another type.
+  HRESULT GetValue(const TCHAR* name, CString* value) const;
+  HRESULT GetValue(const TCHAR* name, DWORD* value) const;
+  HRESULT GetValue(const TCHAR* name, DWORD64* value) const;
+
+  // Returns NULL if the subkey does not exist.
+  const RegistryKeySnapshot* GetSubkey(const TCHAR* name) const;
+
+  // Only called while the snapshot is built. Setting a value replaces the
+  // existing value with the same name.
+  void SetValue(const TCHAR* name, const CString& value);
+  void SetValue(const TCHAR* name, DWORD value);
+  void SetValue(const TCHAR* name, DWORD64 value);
+  void AddSubkey(std::shared_ptr<const RegistryKeySnapshot> subkey);
+
+ private:
+  const Value* FindValue(const TCHAR* name) const;
+  Value* AddValue(const TCHAR* name);
+
+  const CString name_;
+  Values values_;
+  Subkeys subkeys_;
+
+  DISALLOW_COPY_AND_ASSIGN(RegistryKeySnapshot);
+};
+
+// Reads registry keys into snapshots.
+class RegistrySource {
+ public:
+  virtual ~RegistrySource() {}
+
+  // Reads the key |full_key_name|, including the HKEY root, and the subkeys
+  // up to |depth| levels below it. Returns
+  // HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND) if the key does not exist.
+  virtual HRESULT ReadKey(
+      const CString& full_key_name,
+      int depth,
+      std::shared_ptr<const RegistryKeySnapshot>* key) const = 0;
+};
+
+// Reads the registry. Each key is read with one enumeration of its values and
+// one enumeration of its subkeys. Values of other types than strings, DWORDs
+// and QWORDs are skipped.
+class RegKeyRegistrySource : public RegistrySource {
+ public:
+  RegKeyRegistrySource() {}
+
+  virtual HRESULT ReadKey(
+      const CString& full_key_name,
+      int depth,
+      std::shared_ptr<const RegistryKeySnapshot>* key) const;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(RegKeyRegistrySource);
+};
+
+// Reads the keys from memory. The keys are created by setting their values
+// or by CreateKey. The key names are case-insensitive.
+class InMemoryRegistrySource : public RegistrySource {
+ public:
+  InMemoryRegistrySource();
+
+  void CreateKey(const CString& full_key_name);
+  void SetValue(const CString& full_key_name,
+                const TCHAR* name,
+                const CString& value);
+  void SetValue(const CString& full_key_name, const TCHAR* name, DWORD value);
+  void SetValue(const CString& full_key_name,
+                const TCHAR* name,
+                DWORD64 value);
+
+  virtual HRESULT ReadKey(
+      const CString& full_key_name,
+      int depth,
+      std::shared_ptr<const RegistryKeySnapshot>* key) const;
+
+ private:
+  struct Key {
+    explicit Key(const CString& key_name) : values(key_name) {}
+
+    RegistryKeySnapshot values;
+
+    // Keyed by the lowercase names of the subkeys.
+    std::map<CString, std::unique_ptr<Key>> subkeys;
+  };
+
+  Key* CreateKeyPath(const CString& full_key_name);
+  const Key* FindKey(const CString& full_key_name) const;
+  static std::shared_ptr<const RegistryKeySnapshot> CopyKey(const Key& key,
+                                                            int depth);
+
+  Key root_;
+
+  DISALLOW_COPY_AND_ASSIGN(InMemoryRegistrySource);
+};
+
+// The registry keys of one app. A key which does not exist is empty.
+class AppRegistryRecord {
+ public:
+  explicit AppRegistryRecord(const CString& app_id);
+
+  const CString& app_id() const { return app_id_; }
+
+  bool has_clients_key() const { return !!clients_key_; }
+  bool has_client_state_key() const { return !!client_state_key_; }
+  bool has_client_state_medium_key() const {
+    return !!client_state_medium_key_;
+  }
+
+  // The Clients key and its values.
+  const RegistryKeySnapshot& clients_key() const;
+
+  // The ClientState key, its values and its subkeys, such as the cohort.
+  const RegistryKeySnapshot& client_state_key() const;
+
+  // The ClientStateMedium key, its values and its subkeys. Only read for
+  // machine apps.
+  const RegistryKeySnapshot& client_state_medium_key() const;
+
+  // Same as AppManager::IsAppRegistered().
+  bool IsRegistered() const { return has_clients_key(); }
+
+  // Same as AppManager::IsAppUninstalled().
+  bool IsUninstalled() const;
+
+ private:
+  const CString app_id_;
+  std::shared_ptr<const RegistryKeySnapshot> clients_key_;
+  std::shared_ptr<const RegistryKeySnapshot> client_state_key_;
+  std::shared_ptr<const RegistryKeySnapshot> client_state_medium_key_;
+
+  friend class AppRegistrySnapshot;
+
+  DISALLOW_COPY_AND_ASSIGN(AppRegistryRecord);
+};
+
+// The records of the apps of a machine or of a user, which do not change once
+// loaded. Whether the snapshot is consistent with the installers is up to the
+// caller, the same as for the AppManager reads.
+class AppRegistrySnapshot {
+ public:
+  explicit AppRegistrySnapshot(bool is_machine);
+
+  // Loads the records of all the apps which have a Clients, a ClientState or
+  // a ClientStateMedium key. The snapshot must be empty.
+  HRESULT Load(const RegistrySource& source);
+
+  // Loads the record of |app_id| only. Succeeds even if the app has no keys.
+  HRESULT LoadApp(const RegistrySource& source, const CString& app_id);
+
+  bool is_machine() const { return is_machine_; }
+
+  // Returns NULL if there is no record for the app.
+  const AppRegistryRecord* GetApp(const CString& app_id) const;
+
+  // Returns the apps with a Clients key, in the order of the Clients subkeys.
+  void GetRegisteredApps(std::vector<CString>* app_ids) const;
+
+  // Returns the uninstalled apps, in the order of the ClientState subkeys.
+  void GetUninstalledApps(std::vector<CString>* app_ids) const;
+
+ private:
+  AppRegistryRecord* GetOrAddApp(const CString& app_id);
+
+  const bool is_machine_;
+
+  // The records, in the order the apps were found in the Clients tree and
+  // then in the ClientState and ClientStateMedium trees.
+  std::vector<std::unique_ptr<AppRegistryRecord>> apps_;
+
+  // Indexes of |apps_|, keyed by the lowercase app ids.
+  std::map<CString, size_t> app_indexes_;
+
+  // The ClientState subkeys, in the order they were enumerated.
+  std::vector<CString> client_state_app_ids_;
+
+  DISALLOW_COPY_AND_ASSIGN(AppRegistrySnapshot);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_GOOPDATE_APP_REGISTRY_SNAPSHOT_H_
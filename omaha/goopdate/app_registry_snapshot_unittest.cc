@@ -0,0 +1,532 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+
+#include "omaha/goopdate/app_registry_snapshot.h"
+
+#include <iostream>
+#include <vector>
+#include "omaha/base/error.h"
+#include "omaha/base/highres_timer-win32.h"
+#include "omaha/base/reg_key.h"
+#include "omaha/base/string.h"
+#include "omaha/base/utils.h"
+#include "omaha/common/config_manager.h"
+#include "omaha/common/const_goopdate.h"
+#include "omaha/testing/unit_test.h"
+
+namespace omaha {
+
+namespace {
+
+const TCHAR* const kApp1 = _T("{21CD0965-0B0E-47cf-B421-2D191C16C0E2}");
+const TCHAR* const kApp2 = _T("{4A8B3C2D-1E0F-4A5B-9C8D-7E6F5A4B3C2D}");
+const TCHAR* const kApp3 = _T("{9F8E7D6C-5B4A-4392-8170-6F5E4D3C2B1A}");
+
+const HRESULT kKeyNotFound = HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+
+// Counts the keys read through the source it wraps.
+class CountingRegistrySource : public RegistrySource {
+ public:
+  explicit CountingRegistrySource(const RegistrySource* source)
+      : source_(source),
+        num_reads_(0) {}
+
+  virtual HRESULT ReadKey(
+      const CString& full_key_name,
+      int depth,
+      std::shared_ptr<const RegistryKeySnapshot>* key) const {
+    ++num_reads_;
+    return source_->ReadKey(full_key_name, depth, key);
+  }
+
+  int num_reads() const { return num_reads_; }
+
+ private:
+  const RegistrySource* source_;
+  mutable int num_reads_;
+
+  DISALLOW_COPY_AND_ASSIGN(CountingRegistrySource);
+};
+
+CString GetClientsKeyName(bool is_machine, const CString& app_id) {
+  return AppendRegKeyPath(ConfigManager::Instance()->registry_clients(
+                              is_machine),
+                          app_id);
+}
+
+CString GetClientStateKeyName(bool is_machine, const CString& app_id) {
+  return AppendRegKeyPath(ConfigManager::Instance()->registry_client_state(
+                              is_machine),
+                          app_id);
+}
+
+CString GetClientStateMediumKeyName(const CString& app_id) {
+  return AppendRegKeyPath(
+      ConfigManager::Instance()->machine_registry_client_state_medium(),
+      app_id);
+}
+
+CString MakeAppId(int index) {
+  CString app_id;
+  app_id.Format(_T("{%08X-0000-4000-8000-000000000000}"), index);
+  return app_id;
+}
+
+// Registers |num_apps| apps with the values AppManager reads.
+void PopulateApps(bool is_machine,
+                  int num_apps,
+                  InMemoryRegistrySource* source) {
+  for (int i = 0; i != num_apps; ++i) {
+    const CString app_id(MakeAppId(i));
+    const CString clients_key_name(GetClientsKeyName(is_machine, app_id));
+    source->SetValue(clients_key_name, kRegValueProductVersion,
+                     CString(_T("1.2.3.4")));
+    source->SetValue(clients_key_name, kRegValueLanguage, CString(_T("en")));
+    source->SetValue(clients_key_name, kRegValueAppName, CString(_T("App")));
+
+    const CString client_state_key_name(
+        GetClientStateKeyName(is_machine, app_id));
+    source->SetValue(client_state_key_name, kRegValueProductVersion,
+                     CString(_T("1.2.3.4")));
+    source->SetValue(client_state_key_name, kRegValueAdditionalParams,
+                     CString(_T("ap")));
+    source->SetValue(client_state_key_name, kRegValueBrandCode,
+                     CString(_T("GOOG")));
+    source->SetValue(client_state_key_name, kRegValueInstallTimeSec,
+                     static_cast<DWORD>(1000000 + i));
+    source->SetValue(client_state_key_name, kRegValueDayOfInstall,
+                     static_cast<DWORD>(4000 + i));
+    source->SetValue(client_state_key_name, kRegValueUpdateAvailableSince,
+                     static_cast<DWORD64>(i));
+    source->SetValue(AppendRegKeyPath(client_state_key_name,
+                                      kRegSubkeyCohort),
+                     NULL,
+                     CString(_T("cohort")));
+
+    if (is_machine) {
+      source->SetValue(GetClientStateMediumKeyName(app_id),
+                       kRegValueEulaAccepted,
+                       static_cast<DWORD>(1));
+    }
+  }
+}
+
+}  // namespace
+
+TEST(RegistryKeySnapshotTest, Values) {
+  RegistryKeySnapshot key(_T("Key"));
+  key.SetValue(_T("String"), CString(_T("value")));
+  key.SetValue(_T("Dword"), static_cast<DWORD>(0xFFFFFFFF));
+  key.SetValue(_T("Qword"), static_cast<DWORD64>(0x123456789ULL));
+  key.SetValue(NULL, CString(_T("default")));
+
+  EXPECT_STREQ(_T("Key"), key.name());
+  EXPECT_EQ(4, key.values().size());
+  EXPECT_TRUE(key.HasValue(_T("string")));
+  EXPECT_TRUE(key.HasValue(_T("")));
+  EXPECT_FALSE(key.HasValue(_T("missing")));
+
+  CString string_value;
+  EXPECT_SUCCEEDED(key.GetValue(_T("STRING"), &string_value));
+  EXPECT_STREQ(_T("value"), string_value);
+  EXPECT_SUCCEEDED(key.GetValue(NULL, &string_value));
+  EXPECT_STREQ(_T("default"), string_value);
+
+  DWORD dword_value = 0;
+  EXPECT_SUCCEEDED(key.GetValue(_T("Dword"), &dword_value));
+  EXPECT_EQ(0xFFFFFFFF, dword_value);
+
+  DWORD64 qword_value = 0;
+  EXPECT_SUCCEEDED(key.GetValue(_T("Qword"), &qword_value));
+  EXPECT_EQ(0x123456789ULL, qword_value);
+
+  // The values keep their type.
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_DATATYPE_MISMATCH),
+            key.GetValue(_T("Dword"), &string_value));
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_DATATYPE_MISMATCH),
+            key.GetValue(_T("Dword"), &qword_value));
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_DATATYPE_MISMATCH),
+            key.GetValue(_T("String"), &dword_value));
+  EXPECT_EQ(kKeyNotFound, key.GetValue(_T("missing"), &dword_value));
+
+  // Setting a value replaces it, even with another type.
+  key.SetValue(_T("string"), static_cast<DWORD>(5));
+  EXPECT_EQ(4, key.values().size());
+  EXPECT_SUCCEEDED(key.GetValue(_T("String"), &dword_value));
+  EXPECT_EQ(5, dword_value);
+  EXPECT_STREQ(_T("String"), key.values()[0].name);
+}
+
+TEST(InMemoryRegistrySourceTest, ReadKey) {
+  InMemoryRegistrySource source;
+  source.SetValue(_T("HKCU\\Software\\Key"), _T("a"), static_cast<DWORD>(1));
+  source.SetValue(_T("HKCU\\Software\\Key\\Sub"), _T("b"),
+                  static_cast<DWORD>(2));
+  source.SetValue(_T("HKCU\\Software\\Key\\Sub\\SubSub"), _T("c"),
+                  static_cast<DWORD>(3));
+  source.CreateKey(_T("HKCU\\Software\\Key\\Empty"));
+
+  std::shared_ptr<const RegistryKeySnapshot> key;
+  EXPECT_SUCCEEDED(source.ReadKey(_T("HKCU\\software\\KEY\\"), 1, &key));
+  ASSERT_TRUE(key);
+  EXPECT_STREQ(_T("Key"), key->name());
+  EXPECT_TRUE(key->HasValue(_T("a")));
+  ASSERT_EQ(2, key->subkeys().size());
+
+  const RegistryKeySnapshot* subkey = key->GetSubkey(_T("sub"));
+  ASSERT_TRUE(subkey);
+  EXPECT_TRUE(subkey->HasValue(_T("b")));
+  EXPECT_TRUE(subkey->subkeys().empty());
+
+  subkey = key->GetSubkey(_T("Empty"));
+  ASSERT_TRUE(subkey);
+  EXPECT_TRUE(subkey->values().empty());
+
+  EXPECT_SUCCEEDED(source.ReadKey(_T("HKCU\\Software\\Key"), 2, &key));
+  EXPECT_TRUE(key->GetSubkey(_T("Sub"))->GetSubkey(_T("SubSub")));
+
+  EXPECT_SUCCEEDED(source.ReadKey(_T("HKCU\\Software\\Key"), 0, &key));
+  EXPECT_TRUE(key->subkeys().empty());
+
+  EXPECT_EQ(kKeyNotFound,
+            source.ReadKey(_T("HKCU\\Software\\Missing"), 0, &key));
+}
+
+TEST(AppRegistrySnapshotTest, Load_User) {
+  InMemoryRegistrySource source;
+  PopulateApps(false, 1, &source);
+
+  // The app is registered and has a ClientState key.
+  const CString app0(MakeAppId(0));
+
+  // The app is uninstalled: it has a pv in ClientState but no Clients key.
+  source.SetValue(GetClientStateKeyName(false, kApp1),
+                  kRegValueProductVersion,
+                  CString(_T("2.0")));
+
+  // The ClientState key was created before the installer ran.
+  source.SetValue(GetClientStateKeyName(false, kApp2),
+                  kRegValueAdditionalParams,
+                  CString(_T("ap")));
+
+  // The app is registered but has no ClientState key.
+  source.SetValue(GetClientsKeyName(false, kApp3),
+                  kRegValueProductVersion,
+                  CString(_T("3.0")));
+
+  AppRegistrySnapshot snapshot(false);
+  EXPECT_SUCCEEDED(snapshot.Load(source));
+
+  std::vector<CString> app_ids;
+  snapshot.GetRegisteredApps(&app_ids);
+  ASSERT_EQ(2, app_ids.size());
+  EXPECT_STREQ(app0, app_ids[0]);
+  EXPECT_STREQ(kApp3, app_ids[1]);
+
+  app_ids.clear();
+  snapshot.GetUninstalledApps(&app_ids);
+  ASSERT_EQ(1, app_ids.size());
+  EXPECT_STREQ(kApp1, app_ids[0]);
+
+  const AppRegistryRecord* record = snapshot.GetApp(app0);
+  ASSERT_TRUE(record);
+  EXPECT_TRUE(record->IsRegistered());
+  EXPECT_FALSE(record->IsUninstalled());
+  EXPECT_TRUE(record->has_client_state_key());
+  EXPECT_FALSE(record->has_client_state_medium_key());
+
+  CString value;
+  EXPECT_SUCCEEDED(record->clients_key().GetValue(kRegValueLanguage, &value));
+  EXPECT_STREQ(_T("en"), value);
+  EXPECT_SUCCEEDED(record->client_state_key().GetValue(kRegValueBrandCode,
+                                                       &value));
+  EXPECT_STREQ(_T("GOOG"), value);
+
+  const RegistryKeySnapshot* cohort_key =
+      record->client_state_key().GetSubkey(kRegSubkeyCohort);
+  ASSERT_TRUE(cohort_key);
+  EXPECT_SUCCEEDED(cohort_key->GetValue(NULL, &value));
+  EXPECT_STREQ(_T("cohort"), value);
+
+  // The app ids are case-insensitive.
+  CString lowercase_app_id(kApp1);
+  lowercase_app_id.MakeLower();
+  record = snapshot.GetApp(lowercase_app_id);
+  ASSERT_TRUE(record);
+  EXPECT_STREQ(kApp1, record->app_id());
+  EXPECT_FALSE(record->IsRegistered());
+  EXPECT_TRUE(record->IsUninstalled());
+  EXPECT_FALSE(record->has_clients_key());
+  EXPECT_TRUE(record->clients_key().values().empty());
+
+  record = snapshot.GetApp(kApp2);
+  ASSERT_TRUE(record);
+  EXPECT_FALSE(record->IsRegistered());
+  EXPECT_FALSE(record->IsUninstalled());
+
+  record = snapshot.GetApp(kApp3);
+  ASSERT_TRUE(record);
+  EXPECT_TRUE(record->IsRegistered());
+  EXPECT_FALSE(record->has_client_state_key());
+
+  EXPECT_FALSE(snapshot.GetApp(MakeAppId(1)));
+}
+
+TEST(AppRegistrySnapshotTest, Load_Machine) {
+  InMemoryRegistrySource source;
+  PopulateApps(true, 2, &source);
+
+  // The user apps are not loaded.
+  source.SetValue(GetClientsKeyName(false, kApp1),
+                  kRegValueProductVersion,
+                  CString(_T("1.0")));
+
+  AppRegistrySnapshot snapshot(true);
+  EXPECT_SUCCEEDED(snapshot.Load(source));
+
+  std::vector<CString> app_ids;
+  snapshot.GetRegisteredApps(&app_ids);
+  EXPECT_EQ(2, app_ids.size());
+  EXPECT_FALSE(snapshot.GetApp(kApp1));
+
+  const AppRegistryRecord* record = snapshot.GetApp(MakeAppId(1));
+  ASSERT_TRUE(record);
+  ASSERT_TRUE(record->has_client_state_medium_key());
+  DWORD eula_accepted = 0;
+  EXPECT_SUCCEEDED(record->client_state_medium_key().GetValue(
+      kRegValueEulaAccepted, &eula_accepted));
+  EXPECT_EQ(1, eula_accepted);
+}
+
+TEST(AppRegistrySnapshotTest, Load_NoClientsKey) {
+  InMemoryRegistrySource source;
+
+  AppRegistrySnapshot snapshot(false);
+  EXPECT_EQ(kKeyNotFound, snapshot.Load(source));
+}
+
+TEST(AppRegistrySnapshotTest, LoadApp) {
+  InMemoryRegistrySource source;
+  PopulateApps(true, 3, &source);
+
+  AppRegistrySnapshot snapshot(true);
+  EXPECT_SUCCEEDED(snapshot.LoadApp(source, MakeAppId(1)));
+  EXPECT_SUCCEEDED(snapshot.LoadApp(source, kApp1));
+
+  EXPECT_FALSE(snapshot.GetApp(MakeAppId(0)));
+
+  const AppRegistryRecord* record = snapshot.GetApp(MakeAppId(1));
+  ASSERT_TRUE(record);
+  EXPECT_TRUE(record->IsRegistered());
+  EXPECT_TRUE(record->has_client_state_medium_key());
+  EXPECT_TRUE(record->client_state_key().GetSubkey(kRegSubkeyCohort));
+
+  // The app has no keys.
+  record = snapshot.GetApp(kApp1);
+  ASSERT_TRUE(record);
+  EXPECT_FALSE(record->has_clients_key());
+  EXPECT_FALSE(record->has_client_state_key());
+  EXPECT_FALSE(record->has_client_state_medium_key());
+}
+
+// Loading the apps one at a time reads three keys per app. The bulk load
+// reads three keys in all.
+TEST(AppRegistrySnapshotTest, Benchmark_InMemory) {
+  const int kNumApps = 40;
+  const int kNumIterations = 100;
+
+  InMemoryRegistrySource source;
+  PopulateApps(true, kNumApps, &source);
+  const double ticks_per_ms = HighresTimer::GetTimerFrequency() / 1000.0;
+
+  CountingRegistrySource per_app_source(&source);
+  HighresTimer per_app_timer;
+  for (int i = 0; i != kNumIterations; ++i) {
+    AppRegistrySnapshot snapshot(true);
+    for (int j = 0; j != kNumApps; ++j) {
+      EXPECT_SUCCEEDED(snapshot.LoadApp(per_app_source, MakeAppId(j)));
+    }
+  }
+  const double per_app_ms =
+      per_app_timer.GetElapsedTicks() / ticks_per_ms / kNumIterations;
+
+  CountingRegistrySource bulk_source(&source);
+  HighresTimer bulk_timer;
+  for (int i = 0; i != kNumIterations; ++i) {
+    AppRegistrySnapshot snapshot(true);
+    EXPECT_SUCCEEDED(snapshot.Load(bulk_source));
+  }
+  const double bulk_ms =
+      bulk_timer.GetElapsedTicks() / ticks_per_ms / kNumIterations;
+
+  EXPECT_EQ(3 * kNumApps * kNumIterations, per_app_source.num_reads());
+  EXPECT_EQ(3 * kNumIterations, bulk_source.num_reads());
+
+  std::cout << "\t" << kNumApps << " apps in memory: per app "
+            << per_app_ms << " ms, bulk " << bulk_ms << " ms" << std::endl;
+}
+
+class RegKeyRegistrySourceTest : public RegistryProtectedTest {
+};
+
+TEST_F(RegKeyRegistrySourceTest, ReadKey) {
+  const TCHAR kKeyName[] = _T("HKCU\\Software\\Key");
+  const CString subkey_name(AppendRegKeyPath(kKeyName, _T("Sub")));
+
+  EXPECT_SUCCEEDED(RegKey::SetValue(kKeyName, _T("String"), _T("value")));
+  EXPECT_SUCCEEDED(RegKey::SetValue(kKeyName, _T("Empty"), _T("")));
+  EXPECT_SUCCEEDED(RegKey::SetValue(kKeyName, NULL, _T("default")));
+  EXPECT_SUCCEEDED(RegKey::SetValue(kKeyName, _T("Dword"),
+                                    static_cast<DWORD>(7)));
+  EXPECT_SUCCEEDED(RegKey::SetValue(kKeyName, _T("Qword"),
+                                    static_cast<DWORD64>(0x123456789ULL)));
+  EXPECT_SUCCEEDED(RegKey::SetValueExpandSZ(kKeyName, _T("Expand"),
+                                            _T("%SystemRoot%")));
+  const byte kBinary[] = {1, 2, 3};
+  EXPECT_SUCCEEDED(RegKey::SetValue(kKeyName, _T("Binary"),
+                                    kBinary, sizeof(kBinary)));
+  EXPECT_SUCCEEDED(RegKey::SetValue(subkey_name, _T("Sub"),
+                                    static_cast<DWORD>(1)));
+  EXPECT_SUCCEEDED(RegKey::CreateKey(AppendRegKeyPath(subkey_name,
+                                                      _T("SubSub"))));
+
+  RegKeyRegistrySource source;
+  std::shared_ptr<const RegistryKeySnapshot> key;
+  EXPECT_SUCCEEDED(source.ReadKey(kKeyName, 1, &key));
+  ASSERT_TRUE(key);
+  EXPECT_STREQ(_T("Key"), key->name());
+
+  // The binary value is skipped.
+  EXPECT_EQ(6, key->values().size());
+  EXPECT_FALSE(key->HasValue(_T("Binary")));
+
+  // The values are the same as the values RegKey reads.
+  CString expected_string;
+  CString actual_string;
+  const TCHAR* const kStringValues[] = {_T("String"), _T("Empty"), NULL,
+                                        _T("Expand")};
+  for (size_t i = 0; i != arraysize(kStringValues); ++i) {
+    EXPECT_SUCCEEDED(RegKey::GetValue(kKeyName, kStringValues[i],
+                                      &expected_string));
+    EXPECT_SUCCEEDED(key->GetValue(kStringValues[i], &actual_string));
+    EXPECT_STREQ(expected_string, actual_string);
+  }
+  EXPECT_STRNE(_T("%SystemRoot%"), actual_string);
+
+  DWORD dword_value = 0;
+  EXPECT_SUCCEEDED(key->GetValue(_T("Dword"), &dword_value));
+  EXPECT_EQ(7, dword_value);
+
+  DWORD64 qword_value = 0;
+  EXPECT_SUCCEEDED(key->GetValue(_T("Qword"), &qword_value));
+  EXPECT_EQ(0x123456789ULL, qword_value);
+
+  ASSERT_EQ(1, key->subkeys().size());
+  const RegistryKeySnapshot* subkey = key->GetSubkey(_T("Sub"));
+  ASSERT_TRUE(subkey);
+  EXPECT_TRUE(subkey->HasValue(_T("Sub")));
+  EXPECT_TRUE(subkey->subkeys().empty());
+
+  EXPECT_EQ(kKeyNotFound,
+            source.ReadKey(_T("HKCU\\Software\\Missing"), 0, &key));
+}
+
+// Same as Benchmark_InMemory, with the registry.
+TEST_F(RegKeyRegistrySourceTest, Benchmark) {
+  const int kNumApps = 40;
+  const int kNumIterations = 10;
+
+  InMemoryRegistrySource in_memory_source;
+  PopulateApps(true, kNumApps, &in_memory_source);
+
+  // Copies the apps to the registry.
+  std::shared_ptr<const RegistryKeySnapshot> key;
+  for (int i = 0; i != kNumApps; ++i) {
+    const CString app_id(MakeAppId(i));
+    const CString key_names[] = {
+      GetClientsKeyName(true, app_id),
+      GetClientStateKeyName(true, app_id),
+      GetClientStateMediumKeyName(app_id),
+    };
+    for (size_t j = 0; j != arraysize(key_names); ++j) {
+      ASSERT_SUCCEEDED(in_memory_source.ReadKey(key_names[j], 0, &key));
+      for (size_t k = 0; k != key->values().size(); ++k) {
+        const RegistryKeySnapshot::Value& value = key->values()[k];
+        if (value.type == REG_SZ) {
+          EXPECT_SUCCEEDED(RegKey::SetValue(key_names[j], value.name,
+                                            value.string));
+        } else if (value.type == REG_DWORD) {
+          EXPECT_SUCCEEDED(RegKey::SetValue(
+              key_names[j], value.name, static_cast<DWORD>(value.number)));
+        } else {
+          EXPECT_SUCCEEDED(RegKey::SetValue(key_names[j], value.name,
+                                            value.number));
+        }
+      }
+    }
+    EXPECT_SUCCEEDED(RegKey::SetValue(
+        AppendRegKeyPath(GetClientStateKeyName(true, app_id),
+                         kRegSubkeyCohort),
+        NULL,
+        _T("cohort")));
+  }
+
+  RegKeyRegistrySource source;
+  const double ticks_per_ms = HighresTimer::GetTimerFrequency() / 1000.0;
+
+  HighresTimer per_app_timer;
+  for (int i = 0; i != kNumIterations; ++i) {
+    AppRegistrySnapshot snapshot(true);
+    for (int j = 0; j != kNumApps; ++j) {
+      EXPECT_SUCCEEDED(snapshot.LoadApp(source, MakeAppId(j)));
+    }
+  }
+  const double per_app_ms =
+      per_app_timer.GetElapsedTicks() / ticks_per_ms / kNumIterations;
+
+  HighresTimer bulk_timer;
+  for (int i = 0; i != kNumIterations; ++i) {
+    AppRegistrySnapshot snapshot(true);
+    EXPECT_SUCCEEDED(snapshot.Load(source));
+  }
+  const double bulk_ms =
+      bulk_timer.GetElapsedTicks() / ticks_per_ms / kNumIterations;
+
+  // The bulk load reads the same values.
+  AppRegistrySnapshot snapshot(true);
+  EXPECT_SUCCEEDED(snapshot.Load(source));
+  std::vector<CString> app_ids;
+  snapshot.GetRegisteredApps(&app_ids);
+  EXPECT_EQ(kNumApps, app_ids.size());
+  for (int i = 0; i != kNumApps; ++i) {
+    const AppRegistryRecord* record = snapshot.GetApp(MakeAppId(i));
+    ASSERT_TRUE(record);
+    EXPECT_EQ(4, record->clients_key().values().size() +
+                 record->client_state_medium_key().values().size());
+    EXPECT_EQ(6, record->client_state_key().values().size());
+
+    DWORD install_time = 0;
+    EXPECT_SUCCEEDED(record->client_state_key().GetValue(
+        kRegValueInstallTimeSec, &install_time));
+    EXPECT_EQ(1000000 + i, install_time);
+    EXPECT_TRUE(record->client_state_key().GetSubkey(kRegSubkeyCohort));
+  }
+
+  std::cout << "\t" << kNumApps << " apps in the registry: per app "
+            << per_app_ms << " ms, bulk " << bulk_ms << " ms" << std::endl;
+}
+
+}  // namespace omaha
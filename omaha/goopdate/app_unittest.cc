@@ -15,7 +15,9 @@
 
 #include <atlbase.h>
 #include <atlcom.h>
+#include <vector>
 #include "omaha/base/error.h"
+#include "omaha/base/synchronized.h"
 #include "omaha/base/time.h"
 #include "omaha/common/const_goopdate.h"
 #include "omaha/common/const_group_policy.h"
@@ -917,6 +919,72 @@ TEST_F(AppInstallTest, InstallProgress_InvalidInstallerProgress) {
   EXPECT_EQ(100, local_percentage);
 }
 
+namespace {
+
+struct CurrentStatePoll {
+  CurrentStatePoll() : app(NULL), hr(E_FAIL), state_value(STATE_INIT) {}
+
+  App* app;
+  HRESULT hr;
+  LONG state_value;
+};
+
+DWORD WINAPI PollCurrentState(void* param) {
+  CurrentStatePoll* poll = static_cast<CurrentStatePoll*>(param);
+
+  CComPtr<IDispatch> current_state;
+  poll->hr = poll->app->get_currentState(&current_state);
+  if (SUCCEEDED(poll->hr)) {
+    CComPtr<ICurrentState> icurrent_state;
+    poll->hr = current_state.QueryInterface(&icurrent_state);
+    if (SUCCEEDED(poll->hr)) {
+      poll->hr = icurrent_state->get_stateValue(&poll->state_value);
+    }
+  }
+  return 0;
+}
+
+}  // namespace
+
+// A client polls the state of the app while a worker thread holds the model
+// lock. The poll does not wait for the lock and returns the state of the last
+// poll which held the lock. Once the lock is released, the next poll returns
+// the current state.
+TEST_F(AppInstallTest, CurrentState_PollWhileModelIsLocked) {
+  SetAppStateForUnitTest(app_, new fsm::AppStateWaitingToCheckForUpdate);
+
+  // Only the first poll waits for the model lock.
+  CurrentStatePoll first_poll;
+  first_poll.app = app_;
+  PollCurrentState(&first_poll);
+  EXPECT_SUCCEEDED(first_poll.hr);
+  EXPECT_EQ(STATE_WAITING_TO_CHECK_FOR_UPDATE, first_poll.state_value);
+
+  // The model lock is reentrant, therefore the poll runs on another thread.
+  // The timeout only keeps the test from hanging if the poll waits.
+  const DWORD kMaxPollTimeMs = 10000;
+  CurrentStatePoll locked_poll;
+  locked_poll.app = app_;
+  __mutexBlock(model_->lock()) {
+    SetAppStateForUnitTest(app_, new fsm::AppStateCheckingForUpdate);
+
+    scoped_handle thread(::CreateThread(NULL, 0, &PollCurrentState,
+                                        &locked_poll, 0, NULL));
+    ASSERT_TRUE(thread);
+    EXPECT_EQ(WAIT_OBJECT_0,
+              ::WaitForSingleObject(get(thread), kMaxPollTimeMs));
+  }
+
+  EXPECT_SUCCEEDED(locked_poll.hr);
+  EXPECT_EQ(STATE_WAITING_TO_CHECK_FOR_UPDATE, locked_poll.state_value);
+
+  CurrentStatePoll unlocked_poll;
+  unlocked_poll.app = app_;
+  PollCurrentState(&unlocked_poll);
+  EXPECT_SUCCEEDED(unlocked_poll.hr);
+  EXPECT_EQ(STATE_CHECKING_FOR_UPDATE, unlocked_poll.state_value);
+}
+
 // Tests the interface for accessing experiments labels.
 TEST_F(AppInstallTest, ExperimentLabels) {
   // Create a bundle of one app, set an experiment label for that app, and
@@ -84,7 +84,7 @@ size_t AppVersion::GetNumberOfPackages() const {
 }
 
 HRESULT AppVersion::AddPackage(const CString& filename,
-                               uint32 size,
+                               uint64 size,
                                const CString& hash) {
   if (hash.IsEmpty()) {
     return E_INVALIDARG;
@@ -62,7 +62,7 @@ class AppVersion : public ModelObject {
   const Package* GetPackage(size_t index) const;
 
   // Adds a package to this app version.
-  HRESULT AddPackage(const CString& filename, uint32 size,
+  HRESULT AddPackage(const CString& filename, uint64 size,
                      const CString& expected_hash);
 
   // Returns the list of download servers to use in order of preference.
@@ -0,0 +1,483 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/goopdate/differential_patch.h"
+
+#include <string.h>
+#include <algorithm>
+#include "omaha/base/debug.h"
+#include "omaha/base/error.h"
+#include "omaha/base/logging.h"
+#include "omaha/base/signatures.h"
+#include "omaha/third_party/smartany/scoped_any.h"
+
+namespace omaha {
+
+namespace {
+
+const uint8 kPatchMagic[] = { 'O', 'M', 'D', 'P' };
+const uint8 kPatchFormatVersion = 1;
+
+enum PatchCommand {
+  kPatchCommandEnd = 0x00,
+  kPatchCommandCopy = 0x01,
+  kPatchCommandInsert = 0x02,
+};
+
+// The size of each of the buffers the files are streamed through.
+const size_t kPatchBufferSize = 64 * 1024;
+
+// A 64-bit value takes at most 10 bytes once encoded as a varint.
+const int kMaxVarintBytes = 10;
+
+// Reads the patch sequentially through a fixed-size buffer.
+class PatchReader {
+ public:
+  explicit PatchReader(HANDLE file)
+      : file_(file),
+        buffer_(kPatchBufferSize),
+        pos_(0),
+        end_(0) {
+    ASSERT1(file);
+  }
+
+  // Reads |length| bytes. Fails if the patch ends first.
+  HRESULT Read(void* data, size_t length) {
+    uint8* out = static_cast<uint8*>(data);
+    while (length) {
+      if (pos_ == end_) {
+        HRESULT hr = Fill();
+        if (FAILED(hr)) {
+          return hr;
+        }
+        if (pos_ == end_) {
+          return GOOPDATEDOWNLOAD_E_INVALID_PATCH;
+        }
+      }
+
+      const size_t bytes_to_copy = std::min(length, end_ - pos_);
+      memcpy(out, &buffer_[pos_], bytes_to_copy);
+      pos_ += bytes_to_copy;
+      out += bytes_to_copy;
+      length -= bytes_to_copy;
+    }
+    return S_OK;
+  }
+
+  HRESULT ReadVarint(uint64* value) {
+    ASSERT1(value);
+
+    *value = 0;
+    for (int i = 0; i != kMaxVarintBytes; ++i) {
+      uint8 encoded_byte = 0;
+      HRESULT hr = Read(&encoded_byte, 1);
+      if (FAILED(hr)) {
+        return hr;
+      }
+
+      // The last byte only holds the most significant bit of the value.
+      const uint64 bits = encoded_byte & 0x7f;
+      if (i == kMaxVarintBytes - 1 && bits > 1) {
+        return GOOPDATEDOWNLOAD_E_INVALID_PATCH;
+      }
+      *value |= bits << (7 * i);
+
+      if (!(encoded_byte & 0x80)) {
+        return S_OK;
+      }
+    }
+    return GOOPDATEDOWNLOAD_E_INVALID_PATCH;
+  }
+
+  // Sets |is_at_end| to true if the whole patch has been read.
+  HRESULT IsAtEnd(bool* is_at_end) {
+    ASSERT1(is_at_end);
+
+    if (pos_ == end_) {
+      HRESULT hr = Fill();
+      if (FAILED(hr)) {
+        return hr;
+      }
+    }
+    *is_at_end = pos_ == end_;
+    return S_OK;
+  }
+
+ private:
+  HRESULT Fill() {
+    DWORD bytes_read = 0;
+    if (!::ReadFile(file_,
+                    &buffer_[0],
+                    static_cast<DWORD>(buffer_.size()),
+                    &bytes_read,
+                    NULL)) {
+      return HRESULTFromLastError();
+    }
+    pos_ = 0;
+    end_ = bytes_read;
+    return S_OK;
+  }
+
+  const HANDLE file_;
+  std::vector<uint8> buffer_;
+  size_t pos_;
+  size_t end_;
+
+  DISALLOW_COPY_AND_ASSIGN(PatchReader);
+};
+
+// Writes the output through a fixed-size buffer and hashes it.
+class OutputWriter {
+ public:
+  explicit OutputWriter(HANDLE file)
+      : file_(file),
+        buffer_(kPatchBufferSize),
+        pos_(0) {
+    ASSERT1(file);
+  }
+
+  HRESULT Write(const void* data, size_t length) {
+    hash_.Update(data, length);
+
+    const uint8* in = static_cast<const uint8*>(data);
+    while (length) {
+      const size_t bytes_to_copy = std::min(length, buffer_.size() - pos_);
+      memcpy(&buffer_[pos_], in, bytes_to_copy);
+      pos_ += bytes_to_copy;
+      in += bytes_to_copy;
+      length -= bytes_to_copy;
+
+      if (pos_ == buffer_.size()) {
+        HRESULT hr = Flush();
+        if (FAILED(hr)) {
+          return hr;
+        }
+      }
+    }
+    return S_OK;
+  }
+
+  HRESULT Flush() {
+    if (!pos_) {
+      return S_OK;
+    }
+
+    DWORD bytes_written = 0;
+    if (!::WriteFile(file_,
+                     &buffer_[0],
+                     static_cast<DWORD>(pos_),
+                     &bytes_written,
+                     NULL)) {
+      return HRESULTFromLastError();
+    }
+    if (bytes_written != pos_) {
+      return HRESULT_FROM_WIN32(ERROR_WRITE_FAULT);
+    }
+    pos_ = 0;
+    return S_OK;
+  }
+
+  // The number of bytes written so far, including the buffered bytes.
+  uint64 length() const { return hash_.length(); }
+
+  void Finalize(std::vector<uint8>* digest) {
+    hash_.Finalize(digest);
+  }
+
+ private:
+  const HANDLE file_;
+  std::vector<uint8> buffer_;
+  size_t pos_;
+  StreamingHash hash_;
+
+  DISALLOW_COPY_AND_ASSIGN(OutputWriter);
+};
+
+// Copies |length| bytes of |base| starting at |offset| to |output|.
+HRESULT CopyFromBase(HANDLE base,
+                     uint64 offset,
+                     uint64 length,
+                     std::vector<uint8>* chunk,
+                     OutputWriter* output) {
+  ASSERT1(chunk);
+  ASSERT1(output);
+
+  LARGE_INTEGER start_pos = {0};
+  start_pos.QuadPart = static_cast<LONGLONG>(offset);
+  if (!::SetFilePointerEx(base, start_pos, NULL, FILE_BEGIN)) {
+    return HRESULTFromLastError();
+  }
+
+  while (length) {
+    const DWORD bytes_to_read = static_cast<DWORD>(
+        std::min(length, static_cast<uint64>(chunk->size())));
+    DWORD bytes_read = 0;
+    if (!::ReadFile(base, &chunk->front(), bytes_to_read, &bytes_read, NULL)) {
+      return HRESULTFromLastError();
+    }
+    if (bytes_read != bytes_to_read) {
+      return HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
+    }
+
+    HRESULT hr = output->Write(&chunk->front(), bytes_read);
+    if (FAILED(hr)) {
+      return hr;
+    }
+    length -= bytes_read;
+  }
+
+  return S_OK;
+}
+
+// Copies the |length| bytes which follow an insert command to |output|.
+HRESULT InsertFromPatch(PatchReader* patch,
+                        uint64 length,
+                        std::vector<uint8>* chunk,
+                        OutputWriter* output) {
+  ASSERT1(patch);
+  ASSERT1(chunk);
+  ASSERT1(output);
+
+  while (length) {
+    const size_t bytes_to_copy = static_cast<size_t>(
+        std::min(length, static_cast<uint64>(chunk->size())));
+    HRESULT hr = patch->Read(&chunk->front(), bytes_to_copy);
+    if (FAILED(hr)) {
+      return hr;
+    }
+    hr = output->Write(&chunk->front(), bytes_to_copy);
+    if (FAILED(hr)) {
+      return hr;
+    }
+    length -= bytes_to_copy;
+  }
+
+  return S_OK;
+}
+
+// Computes the offset of a copy from the end of the previous copy and the
+// zigzag encoded |offset_delta|. The offset must be inside the base.
+bool ComputeCopyOffset(uint64 previous_copy_end,
+                       uint64 offset_delta,
+                       uint64 base_size,
+                       uint64* offset) {
+  ASSERT1(previous_copy_end <= base_size);
+  ASSERT1(offset);
+
+  // The odd values encode the negative deltas, starting at -1.
+  if (offset_delta & 1) {
+    const uint64 distance = (offset_delta >> 1) + 1;
+    if (distance > previous_copy_end) {
+      return false;
+    }
+    *offset = previous_copy_end - distance;
+  } else {
+    const uint64 distance = offset_delta >> 1;
+    if (distance > base_size - previous_copy_end) {
+      return false;
+    }
+    *offset = previous_copy_end + distance;
+  }
+  return true;
+}
+
+HRESULT ApplyPatch(HANDLE base,
+                   PatchReader* patch,
+                   uint64 expected_output_size,
+                   OutputWriter* output) {
+  ASSERT1(patch);
+  ASSERT1(output);
+
+  uint8 magic[arraysize(kPatchMagic)] = {0};
+  uint8 format_version = 0;
+  HRESULT hr = patch->Read(magic, sizeof(magic));
+  if (SUCCEEDED(hr)) {
+    hr = patch->Read(&format_version, 1);
+  }
+  if (FAILED(hr)) {
+    return hr;
+  }
+  if (memcmp(magic, kPatchMagic, sizeof(magic)) ||
+      format_version != kPatchFormatVersion) {
+    CORE_LOG(LE, (_T("[unsupported patch format][%u]"), format_version));
+    return GOOPDATEDOWNLOAD_E_INVALID_PATCH;
+  }
+
+  uint64 base_size = 0;
+  uint64 output_size = 0;
+  hr = patch->ReadVarint(&base_size);
+  if (SUCCEEDED(hr)) {
+    hr = patch->ReadVarint(&output_size);
+  }
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  LARGE_INTEGER actual_base_size = {0};
+  if (!::GetFileSizeEx(base, &actual_base_size)) {
+    return HRESULTFromLastError();
+  }
+  if (static_cast<uint64>(actual_base_size.QuadPart) != base_size) {
+    CORE_LOG(LE, (_T("[patch base size mismatch][%I64u][%I64d]"),
+                  base_size, actual_base_size.QuadPart));
+    return GOOPDATEDOWNLOAD_E_INVALID_PATCH;
+  }
+  if (expected_output_size && output_size != expected_output_size) {
+    CORE_LOG(LE, (_T("[patch output size mismatch][%I64u][%I64u]"),
+                  output_size, expected_output_size));
+    return GOOPDATEDOWNLOAD_E_INVALID_PATCH;
+  }
+
+  std::vector<uint8> chunk(kPatchBufferSize);
+  uint64 previous_copy_end = 0;
+  for (;;) {
+    uint8 command = 0;
+    hr = patch->Read(&command, 1);
+    if (FAILED(hr)) {
+      return hr;
+    }
+
+    if (command == kPatchCommandEnd) {
+      break;
+    }
+
+    uint64 offset_delta = 0;
+    if (command == kPatchCommandCopy) {
+      hr = patch->ReadVarint(&offset_delta);
+      if (FAILED(hr)) {
+        return hr;
+      }
+    } else if (command != kPatchCommandInsert) {
+      CORE_LOG(LE, (_T("[unknown patch command][%u]"), command));
+      return GOOPDATEDOWNLOAD_E_INVALID_PATCH;
+    }
+
+    uint64 length = 0;
+    hr = patch->ReadVarint(&length);
+    if (FAILED(hr)) {
+      return hr;
+    }
+    if (length > output_size - output->length()) {
+      CORE_LOG(LE, (_T("[patch output too large]")));
+      return GOOPDATEDOWNLOAD_E_INVALID_PATCH;
+    }
+
+    if (command == kPatchCommandInsert) {
+      hr = InsertFromPatch(patch, length, &chunk, output);
+      if (FAILED(hr)) {
+        return hr;
+      }
+      continue;
+    }
+
+    uint64 offset = 0;
+    if (!ComputeCopyOffset(previous_copy_end,
+                           offset_delta,
+                           base_size,
+                           &offset) ||
+        length > base_size - offset) {
+      CORE_LOG(LE, (_T("[patch copy out of the base]")));
+      return GOOPDATEDOWNLOAD_E_INVALID_PATCH;
+    }
+    hr = CopyFromBase(base, offset, length, &chunk, output);
+    if (FAILED(hr)) {
+      return hr;
+    }
+    previous_copy_end = offset + length;
+  }
+
+  bool is_at_end = false;
+  hr = patch->IsAtEnd(&is_at_end);
+  if (FAILED(hr)) {
+    return hr;
+  }
+  if (!is_at_end || output->length() != output_size) {
+    CORE_LOG(LE, (_T("[patch does not end with its output][%I64u][%I64u]"),
+                  output->length(), output_size));
+    return GOOPDATEDOWNLOAD_E_INVALID_PATCH;
+  }
+
+  return output->Flush();
+}
+
+}  // namespace
+
+HRESULT ApplyDifferentialPatch(const CString& base_file,
+                               const CString& patch_file,
+                               const CString& output_file,
+                               uint64 expected_output_size,
+                               std::vector<uint8>* output_digest) {
+  CORE_LOG(L3, (_T("[ApplyDifferentialPatch][base '%s'][patch '%s']"),
+                base_file, patch_file));
+  ASSERT1(output_digest);
+
+  scoped_hfile base(::CreateFile(base_file,
+                                 GENERIC_READ,
+                                 FILE_SHARE_READ,
+                                 NULL,
+                                 OPEN_EXISTING,
+                                 FILE_FLAG_RANDOM_ACCESS,
+                                 NULL));
+  if (!base) {
+    HRESULT hr = HRESULTFromLastError();
+    CORE_LOG(LE, (_T("[failed to open patch base][0x%08x]"), hr));
+    return hr;
+  }
+
+  scoped_hfile patch(::CreateFile(patch_file,
+                                  GENERIC_READ,
+                                  FILE_SHARE_READ,
+                                  NULL,
+                                  OPEN_EXISTING,
+                                  FILE_FLAG_SEQUENTIAL_SCAN,
+                                  NULL));
+  if (!patch) {
+    HRESULT hr = HRESULTFromLastError();
+    CORE_LOG(LE, (_T("[failed to open patch][0x%08x]"), hr));
+    return hr;
+  }
+
+  scoped_hfile output(::CreateFile(output_file,
+                                   GENERIC_WRITE,
+                                   0,
+                                   NULL,
+                                   CREATE_ALWAYS,
+                                   FILE_FLAG_SEQUENTIAL_SCAN,
+                                   NULL));
+  if (!output) {
+    HRESULT hr = HRESULTFromLastError();
+    CORE_LOG(LE, (_T("[failed to create patch output][0x%08x]"), hr));
+    return hr;
+  }
+
+  PatchReader patch_reader(get(patch));
+  OutputWriter output_writer(get(output));
+  HRESULT hr = ApplyPatch(get(base),
+                          &patch_reader,
+                          expected_output_size,
+                          &output_writer);
+  reset(output);
+  if (FAILED(hr)) {
+    CORE_LOG(LE, (_T("[ApplyPatch failed][0x%08x]"), hr));
+    VERIFY1(::DeleteFile(output_file));
+    return hr;
+  }
+
+  output_writer.Finalize(output_digest);
+  CORE_LOG(L3, (_T("[patch applied][%I64u bytes]"), output_writer.length()));
+  return S_OK;
+}
+
+}  // namespace omaha
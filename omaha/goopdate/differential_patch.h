@@ -0,0 +1,59 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// Applies the differential packages offered by the update server. A
+// differential package reconstructs the package of a new version from the
+// package of the installed version, which is read from the package cache.
+//
+// The format of a differential package is:
+//   "OMDP" | format version (1 byte) | base size | output size | commands
+// followed by the commands, each starting with a command byte:
+//   0x00: end of the patch. No data may follow.
+//   0x01: copy | offset delta | length
+//         Copies |length| bytes of the base, starting at the end of the
+//         previous copy plus |offset delta|, which may be negative.
+//   0x02: insert | length | |length| bytes
+//         Writes the bytes which follow the command.
+// The sizes, the offset deltas and the lengths are encoded as LEB128 varints.
+// The offset deltas are zigzag encoded first.
+
+#ifndef OMAHA_GOOPDATE_DIFFERENTIAL_PATCH_H_
+#define OMAHA_GOOPDATE_DIFFERENTIAL_PATCH_H_
+
+#include <windows.h>
+#include <atlstr.h>
+#include <vector>
+#include "base/basictypes.h"
+
+namespace omaha {
+
+// Applies |patch_file| to |base_file| and writes the result to |output_file|,
+// which is replaced if it exists. The files are streamed through fixed-size
+// buffers, so the memory used does not depend on the size of the files. The
+// SHA-256 digest of the output is computed while the output is written and is
+// returned in |output_digest|. If |expected_output_size| is not zero, patches
+// producing an output of a different size are rejected before anything is
+// written. Returns GOOPDATEDOWNLOAD_E_INVALID_PATCH if the patch is malformed
+// or if it does not apply to |base_file|. The output file is deleted if the
+// patch can't be applied.
+HRESULT ApplyDifferentialPatch(const CString& base_file,
+                               const CString& patch_file,
+                               const CString& output_file,
+                               uint64 expected_output_size,
+                               std::vector<uint8>* output_digest);
+
+}  // namespace omaha
+
+#endif  // OMAHA_GOOPDATE_DIFFERENTIAL_PATCH_H_
@@ -0,0 +1,325 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include <string.h>
+#include <vector>
+
+#include "omaha/base/error.h"
+#include "omaha/base/file.h"
+#include "omaha/base/path.h"
+#include "omaha/base/signatures.h"
+#include "omaha/base/utils.h"
+#include "omaha/goopdate/differential_patch.h"
+#include "omaha/testing/unit_test.h"
+#include "omaha/third_party/smartany/scoped_any.h"
+
+namespace omaha {
+
+namespace {
+
+void AppendVarint(uint64 value, std::vector<uint8>* patch) {
+  do {
+    uint8 encoded_byte = static_cast<uint8>(value & 0x7f);
+    value >>= 7;
+    if (value) {
+      encoded_byte |= 0x80;
+    }
+    patch->push_back(encoded_byte);
+  } while (value);
+}
+
+void AppendHeader(uint64 base_size,
+                  uint64 output_size,
+                  std::vector<uint8>* patch) {
+  const char kHeader[] = "OMDP\x01";
+  patch->insert(patch->end(), kHeader, kHeader + 5);
+  AppendVarint(base_size, patch);
+  AppendVarint(output_size, patch);
+}
+
+void AppendCopy(int64 offset_delta, uint64 length, std::vector<uint8>* patch) {
+  patch->push_back(0x01);
+  AppendVarint(offset_delta < 0 ?
+                   ((static_cast<uint64>(-(offset_delta + 1))) << 1) | 1 :
+                   static_cast<uint64>(offset_delta) << 1,
+               patch);
+  AppendVarint(length, patch);
+}
+
+void AppendInsert(const std::vector<uint8>& data, std::vector<uint8>* patch) {
+  patch->push_back(0x02);
+  AppendVarint(data.size(), patch);
+  patch->insert(patch->end(), data.begin(), data.end());
+}
+
+void AppendEnd(std::vector<uint8>* patch) {
+  patch->push_back(0x00);
+}
+
+std::vector<uint8> MakeData(size_t size, uint8 seed) {
+  std::vector<uint8> data(size);
+  uint32 state = seed;
+  for (size_t i = 0; i != size; ++i) {
+    state = state * 1103515245 + 12345;
+    data[i] = static_cast<uint8>(state >> 16);
+  }
+  return data;
+}
+
+}  // namespace
+
+class DifferentialPatchTest : public testing::Test {
+ protected:
+  DifferentialPatchTest() : temp_dir_(GetUniqueTempDirectoryName()) {}
+
+  virtual void SetUp() {
+    ASSERT_HRESULT_SUCCEEDED(CreateDir(temp_dir_, NULL));
+    base_file_ = ConcatenatePath(temp_dir_, _T("base.bin"));
+    patch_file_ = ConcatenatePath(temp_dir_, _T("patch.bin"));
+    output_file_ = ConcatenatePath(temp_dir_, _T("output.bin"));
+  }
+
+  virtual void TearDown() {
+    EXPECT_HRESULT_SUCCEEDED(DeleteDirectory(temp_dir_));
+  }
+
+  static void WriteBytes(const CString& filename,
+                         const std::vector<uint8>& data) {
+    scoped_hfile file(::CreateFile(filename,
+                                   GENERIC_WRITE,
+                                   0,
+                                   NULL,
+                                   CREATE_ALWAYS,
+                                   FILE_ATTRIBUTE_NORMAL,
+                                   NULL));
+    ASSERT_TRUE(file);
+    DWORD bytes_written = 0;
+    ASSERT_TRUE(::WriteFile(get(file),
+                            data.empty() ? NULL : &data.front(),
+                            static_cast<DWORD>(data.size()),
+                            &bytes_written,
+                            NULL));
+    ASSERT_EQ(data.size(), bytes_written);
+  }
+
+  HRESULT Apply(const std::vector<uint8>& base,
+                const std::vector<uint8>& patch,
+                uint64 expected_output_size,
+                std::vector<uint8>* output_digest) {
+    WriteBytes(base_file_, base);
+    WriteBytes(patch_file_, patch);
+    return ApplyDifferentialPatch(base_file_,
+                                  patch_file_,
+                                  output_file_,
+                                  expected_output_size,
+                                  output_digest);
+  }
+
+  // Applies |patch| and checks that the output and its digest are |expected|.
+  void ExpectOutput(const std::vector<uint8>& base,
+                    const std::vector<uint8>& patch,
+                    const std::vector<uint8>& expected) {
+    std::vector<uint8> digest;
+    ASSERT_HRESULT_SUCCEEDED(Apply(base, patch, expected.size(), &digest));
+
+    ASSERT_TRUE(File::Exists(output_file_));
+    if (!expected.empty()) {
+      std::vector<byte> output;
+      ASSERT_HRESULT_SUCCEEDED(ReadEntireFile(output_file_, 0, &output));
+      ASSERT_EQ(expected.size(), output.size());
+      EXPECT_EQ(0, memcmp(&expected.front(), &output.front(), output.size()));
+    }
+
+    std::vector<CString> files(1, output_file_);
+    std::vector<std::vector<byte>> expected_digests;
+    ASSERT_HRESULT_SUCCEEDED(ComputeFileDigestsSha256(files,
+                                                      &expected_digests));
+    EXPECT_TRUE(expected_digests[0] == digest);
+  }
+
+  void ExpectInvalid(const std::vector<uint8>& base,
+                     const std::vector<uint8>& patch) {
+    std::vector<uint8> digest;
+    EXPECT_EQ(GOOPDATEDOWNLOAD_E_INVALID_PATCH,
+              Apply(base, patch, 0, &digest));
+    EXPECT_FALSE(File::Exists(output_file_));
+  }
+
+  const CString temp_dir_;
+  CString base_file_;
+  CString patch_file_;
+  CString output_file_;
+};
+
+TEST_F(DifferentialPatchTest, Empty) {
+  std::vector<uint8> patch;
+  AppendHeader(0, 0, &patch);
+  AppendEnd(&patch);
+
+  ExpectOutput(std::vector<uint8>(), patch, std::vector<uint8>());
+}
+
+TEST_F(DifferentialPatchTest, CopyAndInsert) {
+  const std::vector<uint8> base(MakeData(1000, 1));
+  const std::vector<uint8> inserted(MakeData(100, 2));
+
+  // The output is base[500, 700) + inserted + base[100, 300) + base[300, 310).
+  std::vector<uint8> expected(base.begin() + 500, base.begin() + 700);
+  expected.insert(expected.end(), inserted.begin(), inserted.end());
+  expected.insert(expected.end(), base.begin() + 100, base.begin() + 310);
+
+  std::vector<uint8> patch;
+  AppendHeader(base.size(), expected.size(), &patch);
+  AppendCopy(500, 200, &patch);
+  AppendInsert(inserted, &patch);
+  AppendCopy(-600, 200, &patch);
+  AppendCopy(0, 10, &patch);
+  AppendEnd(&patch);
+
+  ExpectOutput(base, patch, expected);
+}
+
+// The files are larger than the buffers they are streamed through.
+TEST_F(DifferentialPatchTest, LargeFiles) {
+  const std::vector<uint8> base(MakeData(1024 * 1024 + 17, 3));
+  const std::vector<uint8> inserted(MakeData(200 * 1024 + 3, 4));
+
+  std::vector<uint8> expected(inserted);
+  expected.insert(expected.end(), base.begin() + 1, base.end());
+  expected.insert(expected.end(), base.begin(), base.begin() + 1);
+
+  std::vector<uint8> patch;
+  AppendHeader(base.size(), expected.size(), &patch);
+  AppendInsert(inserted, &patch);
+  AppendCopy(1, base.size() - 1, &patch);
+  AppendCopy(-static_cast<int64>(base.size()), 1, &patch);
+  AppendEnd(&patch);
+
+  ExpectOutput(base, patch, expected);
+}
+
+TEST_F(DifferentialPatchTest, InvalidHeader) {
+  const std::vector<uint8> base(MakeData(10, 5));
+
+  std::vector<uint8> patch;
+  AppendHeader(base.size(), 10, &patch);
+  AppendCopy(0, 10, &patch);
+  AppendEnd(&patch);
+
+  std::vector<uint8> invalid_magic(patch);
+  invalid_magic[0] = 'X';
+  ExpectInvalid(base, invalid_magic);
+
+  std::vector<uint8> invalid_version(patch);
+  invalid_version[4] = 2;
+  ExpectInvalid(base, invalid_version);
+
+  ExpectInvalid(base, std::vector<uint8>(patch.begin(), patch.begin() + 3));
+}
+
+TEST_F(DifferentialPatchTest, BaseSizeMismatch) {
+  const std::vector<uint8> base(MakeData(10, 6));
+
+  std::vector<uint8> patch;
+  AppendHeader(base.size() + 1, 10, &patch);
+  AppendCopy(0, 10, &patch);
+  AppendEnd(&patch);
+
+  ExpectInvalid(base, patch);
+}
+
+TEST_F(DifferentialPatchTest, ExpectedOutputSizeMismatch) {
+  const std::vector<uint8> base(MakeData(10, 7));
+
+  std::vector<uint8> patch;
+  AppendHeader(base.size(), 10, &patch);
+  AppendCopy(0, 10, &patch);
+  AppendEnd(&patch);
+
+  std::vector<uint8> digest;
+  EXPECT_EQ(GOOPDATEDOWNLOAD_E_INVALID_PATCH, Apply(base, patch, 11, &digest));
+  EXPECT_FALSE(File::Exists(output_file_));
+}
+
+TEST_F(DifferentialPatchTest, CopyOutOfBase) {
+  const std::vector<uint8> base(MakeData(10, 8));
+
+  std::vector<uint8> past_end;
+  AppendHeader(base.size(), 2, &past_end);
+  AppendCopy(9, 2, &past_end);
+  AppendEnd(&past_end);
+  ExpectInvalid(base, past_end);
+
+  std::vector<uint8> before_start;
+  AppendHeader(base.size(), 4, &before_start);
+  AppendCopy(2, 2, &before_start);
+  AppendCopy(-5, 2, &before_start);
+  AppendEnd(&before_start);
+  ExpectInvalid(base, before_start);
+}
+
+TEST_F(DifferentialPatchTest, OutputSizeMismatch) {
+  const std::vector<uint8> base(MakeData(10, 9));
+
+  std::vector<uint8> too_long;
+  AppendHeader(base.size(), 5, &too_long);
+  AppendCopy(0, 6, &too_long);
+  AppendEnd(&too_long);
+  ExpectInvalid(base, too_long);
+
+  std::vector<uint8> too_short;
+  AppendHeader(base.size(), 5, &too_short);
+  AppendCopy(0, 4, &too_short);
+  AppendEnd(&too_short);
+  ExpectInvalid(base, too_short);
+}
+
+TEST_F(DifferentialPatchTest, MalformedCommands) {
+  const std::vector<uint8> base(MakeData(10, 10));
+
+  std::vector<uint8> unknown_command;
+  AppendHeader(base.size(), 0, &unknown_command);
+  unknown_command.push_back(0x03);
+  ExpectInvalid(base, unknown_command);
+
+  std::vector<uint8> truncated_insert;
+  AppendHeader(base.size(), 4, &truncated_insert);
+  truncated_insert.push_back(0x02);
+  AppendVarint(4, &truncated_insert);
+  truncated_insert.push_back('a');
+  ExpectInvalid(base, truncated_insert);
+
+  std::vector<uint8> missing_end;
+  AppendHeader(base.size(), 2, &missing_end);
+  AppendCopy(0, 2, &missing_end);
+  ExpectInvalid(base, missing_end);
+
+  std::vector<uint8> trailing_data;
+  AppendHeader(base.size(), 2, &trailing_data);
+  AppendCopy(0, 2, &trailing_data);
+  AppendEnd(&trailing_data);
+  trailing_data.push_back(0x00);
+  ExpectInvalid(base, trailing_data);
+
+  // The varint has more than 64 bits.
+  std::vector<uint8> overlong_varint;
+  AppendHeader(base.size(), 2, &overlong_varint);
+  overlong_varint.push_back(0x01);
+  overlong_varint.insert(overlong_varint.end(), 9, 0xff);
+  overlong_varint.push_back(0x02);
+  ExpectInvalid(base, overlong_varint);
+}
+
+}  // namespace omaha
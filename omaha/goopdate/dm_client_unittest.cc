@@ -45,6 +45,7 @@ using ::testing::_;
 using ::testing::AllArgs;
 using ::testing::HasSubstr;
 using ::testing::Return;
+using ::testing::SetArgPointee;
 
 // An adapter for Google Mock's HasSubstr matcher that operates on a CString
 // argument.
@@ -382,6 +383,7 @@ class MockHttpRequest : public HttpRequestInterface {
   MOCK_METHOD0(Pause, HRESULT());
   MOCK_METHOD0(Resume, HRESULT());
   MOCK_CONST_METHOD0(GetResponse, std::vector<uint8>());
+  MOCK_METHOD1(TakeResponse, void(std::vector<uint8>* response));
   MOCK_CONST_METHOD0(GetHttpStatusCode, int());
   MOCK_CONST_METHOD3(QueryHeadersString,
                      HRESULT(uint32 info_level,
@@ -396,12 +398,14 @@ class MockHttpRequest : public HttpRequestInterface {
   MOCK_METHOD1(set_proxy_configuration, void(const ProxyConfig& proxy_config));
   MOCK_METHOD1(set_filename, void(const CString& filename));
   MOCK_METHOD1(set_low_priority, void(bool low_priority));
+  MOCK_METHOD1(set_num_segments, void(int num_segments));
   MOCK_METHOD1(set_callback, void(NetworkRequestCallback* callback));
   MOCK_METHOD1(set_additional_headers, void(const CString& additional_headers));
   MOCK_CONST_METHOD0(user_agent, CString());
   MOCK_METHOD1(set_user_agent, void(const CString& user_agent));
   MOCK_METHOD1(set_proxy_auth_config, void(const ProxyAuthConfig& config));
   MOCK_CONST_METHOD1(download_metrics, bool(DownloadMetrics* download_metrics));
+  MOCK_CONST_METHOD1(response_digest, bool(std::vector<uint8>* digest));
 };
 
 }  // namespace
@@ -428,6 +432,8 @@ class DmClientRequestTest : public ::testing::Test {
     std::vector<uint8> response;
     ASSERT_NO_FATAL_FAILURE(MakeSuccessResponseBody(response_data, &response));
     ON_CALL(**request, GetResponse()).WillByDefault(Return(response));
+    ON_CALL(**request, TakeResponse(_))
+        .WillByDefault(SetArgPointee<0>(response));
   }
 
   // Populates |request| with a mock HttpRequest that behaves as if the server
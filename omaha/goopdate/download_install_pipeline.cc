@@ -0,0 +1,190 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/goopdate/download_install_pipeline.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "omaha/base/debug.h"
+#include "omaha/base/logging.h"
+#include "omaha/goopdate/app.h"
+#include "omaha/goopdate/app_bundle.h"
+#include "omaha/goopdate/download_manager.h"
+#include "omaha/goopdate/install_manager.h"
+#include "omaha/goopdate/worker_utils.h"
+
+namespace omaha {
+
+DownloadInstallPipeline::DownloadInstallPipeline(
+    DownloadManagerInterface* download_manager,
+    InstallManagerInterface* install_manager,
+    int max_concurrent_downloads)
+    : download_manager_(download_manager),
+      install_manager_(install_manager),
+      max_concurrent_downloads_(max_concurrent_downloads),
+      app_bundle_(NULL),
+      next_app_to_download_(0) {
+  ASSERT1(download_manager);
+  ASSERT1(install_manager);
+  ASSERT1(max_concurrent_downloads >= 0);
+}
+
+DownloadInstallPipeline::~DownloadInstallPipeline() {
+  ASSERT1(download_threads_.empty());
+}
+
+void DownloadInstallPipeline::Run(AppBundle* app_bundle) {
+  ASSERT1(app_bundle);
+  ASSERT1(!app_bundle_);
+
+  app_bundle_ = app_bundle;
+
+  const size_t num_apps = app_bundle_->GetNumberOfApps();
+  CORE_LOG(L3, (_T("[DownloadInstallPipeline::Run][%Iu apps][%d threads]"),
+                num_apps, max_concurrent_downloads_));
+
+  next_app_to_download_ = 0;
+  download_complete_.clear();
+  for (size_t i = 0; i != num_apps; ++i) {
+    download_complete_.push_back(std::make_unique<Gate>());
+  }
+
+  StartDownloadThreads();
+
+  for (size_t i = 0; i != num_apps; ++i) {
+    App* app = app_bundle_->GetApp(i);
+
+    // Download the app on this thread if none of the download threads has
+    // claimed it yet. Otherwise, wait for the download thread to finish.
+    if (ClaimApp(i)) {
+      DownloadApp(i);
+    } else {
+      VERIFY1(download_complete_[i]->Wait(INFINITE));
+    }
+
+    ASSERT1(app->state() == STATE_READY_TO_INSTALL ||    // Downloaded above.
+            app->state() == STATE_WAITING_TO_INSTALL ||  // Downloaded earlier.
+            app->state() == STATE_NO_UPDATE ||
+            app->state() == STATE_ERROR);
+
+    app->QueueInstall();
+
+    // This is a blocking call on the app installer.
+    CallAsSelfAndImpersonate1(
+        app,
+        &App::Install,
+        install_manager_);
+
+    ASSERT1(app->state() == STATE_INSTALL_COMPLETE ||
+            app->state() == STATE_NO_UPDATE ||
+            app->state() == STATE_ERROR);
+  }
+
+  StopDownloadThreads();
+
+  download_complete_.clear();
+  app_bundle_ = NULL;
+}
+
+bool DownloadInstallPipeline::ClaimNextApp(size_t* index) {
+  ASSERT1(index);
+
+  __mutexScope(lock_);
+  if (next_app_to_download_ >= download_complete_.size()) {
+    return false;
+  }
+
+  *index = next_app_to_download_++;
+  return true;
+}
+
+bool DownloadInstallPipeline::ClaimApp(size_t index) {
+  __mutexScope(lock_);
+
+  // The calling thread installs the apps in order so all apps before |index|
+  // have already been claimed.
+  ASSERT1(next_app_to_download_ >= index);
+  if (next_app_to_download_ != index) {
+    return false;
+  }
+
+  ++next_app_to_download_;
+  return true;
+}
+
+void DownloadInstallPipeline::DownloadApp(size_t index) {
+  App* app = app_bundle_->GetApp(index);
+
+  ASSERT1(app->state() == STATE_WAITING_TO_DOWNLOAD ||
+          app->state() == STATE_WAITING_TO_INSTALL ||
+          app->state() == STATE_NO_UPDATE ||
+          app->state() == STATE_ERROR);
+
+  // Download the app if it has not already been downloaded.
+  // This is a blocking call on the network.
+  app->Download(download_manager_);
+
+  VERIFY1(download_complete_[index]->Open());
+}
+
+void DownloadInstallPipeline::DownloadApps() {
+  // Once the bundle is stopped, the apps are not downloaded ahead anymore. The
+  // calling thread goes through the cancelled apps instead.
+  const std::shared_ptr<const CancellationToken> cancellation_token(
+      app_bundle_->cancellation_token());
+  size_t index = 0;
+  while (!cancellation_token->IsCancelled() && ClaimNextApp(&index)) {
+    CORE_LOG(L3, (_T("[DownloadInstallPipeline][downloading ahead][%Iu]"),
+                  index));
+    DownloadApp(index);
+  }
+}
+
+void DownloadInstallPipeline::StartDownloadThreads() {
+  ASSERT1(download_threads_.empty());
+
+  // There is no point in having more download threads than apps to download
+  // ahead of the first install.
+  const size_t num_apps = download_complete_.size();
+  const size_t num_threads = num_apps > 1 ?
+      std::min(static_cast<size_t>(max_concurrent_downloads_), num_apps - 1) :
+      0;
+
+  for (size_t i = 0; i != num_threads; ++i) {
+    // If a thread can't impersonate the user of the bundle, it does not claim
+    // any apps and the calling thread downloads them instead.
+    auto download_thread = std::make_unique<worker_utils::DownloadThread>(
+        app_bundle_->impersonation_token(),
+        [this]() { DownloadApps(); });
+    if (!download_thread->Start()) {
+      CORE_LOG(LW, (_T("[DownloadThread::Start failed][%u]"),
+                    ::GetLastError()));
+      break;
+    }
+    download_threads_.push_back(std::move(download_thread));
+  }
+}
+
+void DownloadInstallPipeline::StopDownloadThreads() {
+  // All apps have been claimed at this point, therefore the threads are
+  // exiting on their own.
+  for (size_t i = 0; i != download_threads_.size(); ++i) {
+    download_threads_[i]->Join();
+  }
+  download_threads_.clear();
+}
+
+}  // namespace omaha
@@ -0,0 +1,108 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+// Runs the download and the install phases of a bundle as a two-stage
+// pipeline. A bounded set of download threads downloads the apps ahead of the
+// app being installed, while the calling thread installs the apps in bundle
+// order as soon as each one of them is ready. The network is therefore busy
+// while installers run and installers run as soon as their payloads are ready.
+//
+// The pipeline does not introduce new app states. Apps downloaded ahead of
+// the install sit in STATE_READY_TO_INSTALL until the calling thread queues
+// them for install, which moves them to STATE_WAITING_TO_INSTALL. Cancellation
+// is handled by the app state machine: Worker::Stop cancels the downloads in
+// progress and moves the apps to STATE_ERROR, which makes the remaining
+// Download and Install calls no-ops.
+
+#ifndef OMAHA_GOOPDATE_DOWNLOAD_INSTALL_PIPELINE_H_
+#define OMAHA_GOOPDATE_DOWNLOAD_INSTALL_PIPELINE_H_
+
+#include <windows.h>
+#include <memory>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "omaha/base/synchronized.h"
+
+namespace omaha {
+
+class App;
+class AppBundle;
+class DownloadManagerInterface;
+class InstallManagerInterface;
+
+namespace worker_utils {
+class DownloadThread;
+}  // namespace worker_utils
+
+class DownloadInstallPipeline {
+ public:
+  // |max_concurrent_downloads| is the number of threads which download apps
+  // ahead of the install. When it is zero, each app is downloaded and then
+  // installed on the calling thread before the next app is processed.
+  DownloadInstallPipeline(DownloadManagerInterface* download_manager,
+                          InstallManagerInterface* install_manager,
+                          int max_concurrent_downloads);
+  ~DownloadInstallPipeline();
+
+  // Downloads and installs all apps in the bundle. This is a blocking call,
+  // which returns after every app has been installed or has failed. The caller
+  // must be impersonating the bundle user, if the bundle has an impersonation
+  // token. The download threads impersonate the same token.
+  void Run(AppBundle* app_bundle);
+
+ private:
+  // Claims the next app to download. Returns false when all apps have been
+  // claimed. The apps are claimed in bundle order.
+  bool ClaimNextApp(size_t* index);
+
+  // Claims the app at |index| if no download thread has claimed it yet.
+  bool ClaimApp(size_t index);
+
+  // Downloads the app at |index| and signals the install stage.
+  void DownloadApp(size_t index);
+
+  // Called on the download threads.
+  void DownloadApps();
+
+  void StartDownloadThreads();
+  void StopDownloadThreads();
+
+  DownloadManagerInterface* download_manager_;
+  InstallManagerInterface* install_manager_;
+  const int max_concurrent_downloads_;
+
+  // The bundle being processed by Run. Not owned by this object.
+  AppBundle* app_bundle_;
+
+  // Protects |next_app_to_download_|.
+  LLock lock_;
+
+  // Index of the first app in the bundle which has not been claimed for
+  // download by any thread.
+  size_t next_app_to_download_;
+
+  // One gate per app, opened when the app has been downloaded.
+  std::vector<std::unique_ptr<Gate>> download_complete_;
+
+  std::vector<std::unique_ptr<worker_utils::DownloadThread>>
+      download_threads_;
+
+  DISALLOW_COPY_AND_ASSIGN(DownloadInstallPipeline);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_GOOPDATE_DOWNLOAD_INSTALL_PIPELINE_H_
@@ -23,9 +23,11 @@
 
 #include "omaha/goopdate/download_manager.h"
 
+#include <objbase.h>
 #include <shlwapi.h>
 
 #include <algorithm>
+#include <memory>
 #include <vector>
 
 #include "omaha/base/debug.h"
@@ -34,13 +36,16 @@
 #include "omaha/base/logging.h"
 #include "omaha/base/path.h"
 #include "omaha/base/scoped_impersonation.h"
+#include "omaha/base/signatures.h"
 #include "omaha/base/safe_format.h"
 #include "omaha/base/string.h"
 #include "omaha/base/synchronized.h"
+#include "omaha/base/thread.h"
 #include "omaha/base/user_rights.h"
 #include "omaha/base/utils.h"
 #include "omaha/common/config_manager.h"
 #include "omaha/common/const_goopdate.h"
+#include "omaha/goopdate/differential_patch.h"
 #include "omaha/goopdate/model.h"
 #include "omaha/goopdate/package_cache.h"
 #include "omaha/goopdate/server_resource.h"
@@ -52,11 +57,17 @@
 #include "omaha/net/network_request.h"
 #include "omaha/net/net_utils.h"
 #include "omaha/net/simple_request.h"
+#include "omaha/third_party/smartany/scoped_any.h"
 
 namespace omaha {
 
 namespace {
 
+// The number of connections used to download a package in the foreground,
+// when the server accepts range requests. Background downloads use a single
+// connection to leave the bandwidth to the user.
+const int kNumForegroundDownloadSegments = 4;
+
 // Creates and initializes an instance of the NetworkRequest for the
 // DownloadManager to use. Defines the fallback chain: BITS, WinHttp.
 HRESULT CreateNetworkRequest(NetworkRequest** network_request_ptr) {
@@ -98,10 +109,8 @@ HRESULT ValidateSize(const CString& file_path, uint64 expected_size) {
   CORE_LOG(L3, (_T("[ValidateSize][%s][%lld]"), file_path, expected_size));
   ASSERT1(File::Exists(file_path));
   ASSERT1(expected_size != 0);
-  ASSERT(expected_size <= UINT_MAX,
-         (_T("TODO(omaha): Add uint64 support to GetFileSizeUnopen().")));
 
-  uint32 file_size(0);
+  uint64 file_size(0);
   HRESULT hr = File::GetFileSizeUnopen(file_path, &file_size);
   ASSERT1(SUCCEEDED(hr));
   if (FAILED(hr)) {
@@ -139,6 +148,104 @@ void AddDownloadMetricsPingEvents(
 
 }  // namespace
 
+// Downloads the packages of an app using all network requests of the download
+// state. The calling thread uses the first network request and each one of the
+// other network requests is used by a thread created for the duration of the
+// download. The threads claim the packages in order. Once a package has failed
+// no more packages are claimed, the same way the serial download stops at the
+// first package which fails.
+class DownloadManager::ConcurrentPackageDownload {
+ public:
+  ConcurrentPackageDownload(DownloadManager* download_manager,
+                            State* state,
+                            std::vector<PackageResult>* results)
+      : download_manager_(download_manager),
+        state_(state),
+        results_(results),
+        next_package_(0),
+        has_failed_(false) {
+    ASSERT1(download_manager);
+    ASSERT1(state);
+    ASSERT1(results);
+  }
+
+  void Run() {
+    const size_t num_network_requests = state_->num_network_requests();
+    ASSERT1(num_network_requests > 1);
+
+    // The packages are downloaded as the user of the bundle. If a thread
+    // can't impersonate, it does not claim any packages and the other threads
+    // download them instead.
+    HANDLE impersonation_token =
+        state_->app()->app_bundle()->impersonation_token();
+    std::vector<std::unique_ptr<worker_utils::DownloadThread>> threads;
+    for (size_t i = 1; i != num_network_requests; ++i) {
+      std::unique_ptr<worker_utils::DownloadThread> thread(
+          new worker_utils::DownloadThread(
+              impersonation_token,
+              [this, i]() { DownloadPackages(i); }));
+      if (!thread->Start()) {
+        CORE_LOG(LW, (_T("[DownloadThread::Start failed][%u]"),
+                      ::GetLastError()));
+        break;
+      }
+      threads.push_back(std::move(thread));
+    }
+
+    DownloadPackages(0);
+
+    for (size_t i = 0; i != threads.size(); ++i) {
+      threads[i]->Join();
+    }
+  }
+
+ private:
+  bool ClaimNextPackage(size_t* index) {
+    ASSERT1(index);
+
+    __mutexScope(lock_);
+    if (has_failed_ || next_package_ >= results_->size()) {
+      return false;
+    }
+
+    *index = next_package_++;
+    return true;
+  }
+
+  void DownloadPackages(size_t slot) {
+    AppVersion* app_version = state_->app()->working_version();
+
+    size_t index = 0;
+    while (ClaimNextPackage(&index)) {
+      PackageResult result;
+      result.hr = download_manager_->DoDownloadPackage(
+          app_version->GetPackage(index),
+          state_,
+          slot,
+          &result.extra_code1,
+          &result.source_url_index);
+      result.is_done = true;
+
+      __mutexScope(lock_);
+      (*results_)[index] = result;
+      if (FAILED(result.hr)) {
+        has_failed_ = true;
+      }
+    }
+  }
+
+  DownloadManager* download_manager_;
+  State* state_;
+
+  // Protects the members below.
+  LLock lock_;
+  std::vector<PackageResult>* results_;
+  size_t next_package_;
+  bool has_failed_;
+
+  DISALLOW_COPY_AND_ASSIGN(ConcurrentPackageDownload);
+};
+
 DownloadManager::DownloadManager(bool is_machine)
     : lock_(NULL), is_machine_(false) {
   CORE_LOG(L3, (_T("[DownloadManager::DownloadManager]")));
@@ -251,8 +358,14 @@ HRESULT DownloadManager::DownloadApp(App* app) {
   AppVersion* app_version = app->working_version();
   const size_t num_packages = app_version->GetNumberOfPackages();
 
+  // Each package downloaded at the same time needs its own network request.
+  const size_t num_network_requests = std::max(static_cast<size_t>(1), std::min(
+      static_cast<size_t>(
+          ConfigManager::Instance()->GetPackageDownloadConcurrency()),
+      num_packages));
+
   State* state = NULL;
-  HRESULT hr = CreateStateForApp(app, &state);
+  HRESULT hr = CreateStateForApp(app, num_network_requests, &state);
   if (FAILED(hr)) {
     CORE_LOG(LE, (_T("[CreateStateForApp failed][0x%08x]"), hr));
     return hr;
@@ -260,26 +373,51 @@ HRESULT DownloadManager::DownloadApp(App* app) {
 
   app->Downloading();
 
-  CString message;
-  hr = S_OK;
+  // Progress is reported by each package through its own network request
+  // callback and App::GetDownloadProgress aggregates the progress of all
+  // packages of the app.
+  std::vector<PackageResult> results(num_packages);
+  if (num_network_requests > 1) {
+    ConcurrentPackageDownload download(this, state, &results);
+    download.Run();
+  } else {
+    DownloadPackages(state, &results);
+  }
 
+  // Report the error of the first package which failed, in package order.
+  hr = S_OK;
+  int extra_code1 = 0;
+  CString message;
   for (size_t i = 0; i < num_packages; ++i) {
-    Package* package(app_version->GetPackage(i));
-    hr = DoDownloadPackage(package, state);
-    if (FAILED(hr)) {
+    if (results[i].is_done && FAILED(results[i].hr)) {
+      hr = results[i].hr;
+      extra_code1 = results[i].extra_code1;
       CORE_LOG(LE, (_T("[DoDownloadPackage failed][%s][%s][0x%08x][%Iu]"),
-                    app->display_name(), package->filename(), hr, i));
-      message = GetMessageForError(ErrorContext(hr, error_extra_code1()),
+                    app->display_name(), app_version->GetPackage(i)->filename(),
+                    hr, i));
+      message = GetMessageForError(ErrorContext(hr, extra_code1),
                                    app->app_bundle()->display_language());
       break;
     }
   }
 
+  // The download time and the source url are reported once per app. The
+  // source url is the one of the first package downloaded, in package order.
+  if (state->is_download_started()) {
+    app->SetCurrentTimeAs(App::TIME_DOWNLOAD_COMPLETE);
+  }
+  for (size_t i = 0; i < num_packages; ++i) {
+    if (results[i].source_url_index >= 0) {
+      app->set_source_url_index(results[i].source_url_index);
+      break;
+    }
+  }
+
   if (SUCCEEDED(hr)) {
     app->DownloadComplete();
     app->MarkReadyToInstall();
   } else {
-    app->Error(ErrorContext(hr, error_extra_code1()), message);
+    app->Error(ErrorContext(hr, extra_code1), message);
   }
 
   if (SUCCEEDED(hr)) {
@@ -326,12 +464,40 @@ bool DownloadManager::IsPackageAvailable(const Package* package) const {
   return package_cache()->IsCached(key, package->expected_hash());
 }
 
+void DownloadManager::DownloadPackages(State* state,
+                                       std::vector<PackageResult>* results) {
+  ASSERT1(state);
+  ASSERT1(results);
+
+  AppVersion* app_version = state->app()->working_version();
+  for (size_t i = 0; i < results->size(); ++i) {
+    PackageResult& result = (*results)[i];
+    result.hr = DoDownloadPackage(app_version->GetPackage(i),
+                                  state,
+                                  0,
+                                  &result.extra_code1,
+                                  &result.source_url_index);
+    result.is_done = true;
+    if (FAILED(result.hr)) {
+      break;
+    }
+  }
+}
+
 // Attempts a package download by trying the fallback urls. It does not
 // retry the download if the file validation fails.
 // Assumes the packages are not created or destroyed while method is running.
-HRESULT DownloadManager::DoDownloadPackage(Package* package, State* state) {
+HRESULT DownloadManager::DoDownloadPackage(Package* package,
+                                           State* state,
+                                           size_t slot,
+                                           int* extra_code1,
+                                           int* source_url_index) {
   ASSERT1(package);
   ASSERT1(state);
+  ASSERT1(extra_code1);
+  ASSERT1(source_url_index);
+
+  *source_url_index = -1;
 
   App* app = package->app_version()->app();
   const CString app_id(app->app_guid_string());
@@ -379,7 +545,7 @@ HRESULT DownloadManager::DoDownloadPackage(Package* package, State* state) {
       return hr;
     }
 
-    NetworkRequest* network_request = state->network_request();
+    NetworkRequest* network_request = state->network_request(slot);
 
     network_request->set_callback(package);
 
@@ -387,8 +553,32 @@ HRESULT DownloadManager::DoDownloadPackage(Package* package, State* state) {
         package->app_version()->download_base_urls());
 
     hr = E_FAIL;
-    app->SetCurrentTimeAs(App::TIME_DOWNLOAD_START);
-    for (size_t i = 0; i != download_base_urls.size(); ++i) {
+    uint64 bytes_downloaded = 0;
+    if (state->OnPackageDownloadStarted()) {
+      app->SetCurrentTimeAs(App::TIME_DOWNLOAD_START);
+    }
+
+    // The full package is downloaded if the package can't be reconstructed
+    // from the differential package.
+    if (app->is_update() && package->has_differential_package()) {
+      hr = DoDownloadDifferentialPackage(package,
+                                         unique_filename_path,
+                                         network_request,
+                                         extra_code1,
+                                         source_url_index,
+                                         &bytes_downloaded);
+      if (hr == GOOPDATE_E_CANCELLED) {
+        VERIFY1(SUCCEEDED(network_request->Close()));
+        DeleteBeforeOrAfterReboot(unique_filename_path);
+        return hr;
+      }
+      if (FAILED(hr)) {
+        CORE_LOG(LW, (_T("[differential update failed][0x%08x]"), hr));
+        *extra_code1 = 0;
+      }
+    }
+
+    for (size_t i = 0; FAILED(hr) && i != download_base_urls.size(); ++i) {
       CString url;
       DWORD url_length(INTERNET_MAX_URL_LENGTH);
       hr = ::UrlCombine(download_base_urls[i],
@@ -402,25 +592,31 @@ HRESULT DownloadManager::DoDownloadPackage(Package* package, State* state) {
 
       ASSERT1(static_cast<DWORD>(url.GetLength()) == url_length);
 
-      hr = DoDownloadPackageFromUrl(url, unique_filename_path, package, state);
+      hr = DoDownloadPackageFromUrl(url,
+                                    unique_filename_path,
+                                    package,
+                                    network_request,
+                                    extra_code1);
       AddDownloadMetricsPingEvents(network_request->download_metrics(), app);
       if (SUCCEEDED(hr)) {
-        app->set_source_url_index(static_cast<int>(i));
+        *source_url_index = static_cast<int>(i);
+        bytes_downloaded += package->expected_size();
         break;
       }
     }
 
     VERIFY1(SUCCEEDED(network_request->Close()));
     DeleteBeforeOrAfterReboot(unique_filename_path);
-    app->SetCurrentTimeAs(App::TIME_DOWNLOAD_COMPLETE);
 
     if (FAILED(hr)) {
       CORE_LOG(LE, (_T("[download failed from all urls][0x%08x]"), hr));
       return hr;
     }
 
-    // Assumes that downloaded bytes equal to the expected package size.
-    app->UpdateNumBytesDownloaded(package->expected_size());
+    // Assumes that the downloaded bytes of the full package equal its expected
+    // size. A differential package counts for its own size, as well as a full
+    // package downloaded after the differential package failed to apply.
+    app->UpdateNumBytesDownloaded(bytes_downloaded);
   } else {
     OPT_LOG(L3, (_T("[package is cached]")));
 
@@ -439,7 +635,8 @@ HRESULT DownloadManager::DoDownloadPackage(Package* package, State* state) {
 HRESULT DownloadManager::DoDownloadPackageFromUrl(const CString& url,
                                                   const CString& filename,
                                                   Package* package,
-                                                  State* state) {
+                                                  NetworkRequest* network_request,
+                                                  int* extra_code1) {
   OPT_LOG(L3, (_T("[starting download][from '%s'][to '%s']"), url, filename));
 
   // Downloading a file is a blocking call. It assumes the model is not
@@ -447,8 +644,6 @@ HRESULT DownloadManager::DoDownloadPackageFromUrl(const CString& url,
   // to access the model until the file download is complete.
   ASSERT1(!package->model()->IsLockedByCaller());
 
-  NetworkRequest* network_request = state->network_request();
-
   HRESULT hr = network_request->DownloadFile(url, filename);
   if (FAILED(hr)) {
     OPT_LOG(LE, (_T("[DownloadFile failed][%#x]"), hr));
@@ -462,11 +657,17 @@ HRESULT DownloadManager::DoDownloadPackageFromUrl(const CString& url,
   }
 
   // A file has been successfully downloaded from current url. Validate the file
-  // and cache it.
-  hr = CallAsSelfAndImpersonate2(this,
-                                 &DownloadManager::CachePackage,
-                                 static_cast<const Package*>(package),
-                                 static_cast<const CString*>(&filename));
+  // and cache it. If the network request hashed the file while downloading it,
+  // the file is not read again to validate it.
+  std::vector<uint8> digest;
+  network_request->response_digest(&digest);
+  hr = CallAsSelfAndImpersonate4(
+      this,
+      &DownloadManager::DoCachePackage,
+      static_cast<const Package*>(package),
+      static_cast<const CString*>(&filename),
+      static_cast<const std::vector<uint8>*>(&digest),
+      extra_code1);
   if (FAILED(hr)) {
     OPT_LOG(LE, (_T("[DownloadManager::CachePackage failed][%#x]"), hr));
   }
@@ -474,6 +675,165 @@ HRESULT DownloadManager::DoDownloadPackageFromUrl(const CString& url,
   return hr;
 }
 
+HRESULT DownloadManager::DoDownloadDifferentialPackage(
+    Package* package,
+    const CString& filename,
+    NetworkRequest* network_request,
+    int* extra_code1,
+    int* source_url_index,
+    uint64* bytes_downloaded) {
+  ASSERT1(package);
+  ASSERT1(network_request);
+  ASSERT1(extra_code1);
+  ASSERT1(source_url_index);
+  ASSERT1(bytes_downloaded);
+
+  App* app = package->app_version()->app();
+  const CString app_id(app->app_guid_string());
+  const CString base_version(app->current_version()->version());
+  const CString base_hash(package->differential_base_hash());
+
+  OPT_LOG(L3, (_T("[DownloadManager::DoDownloadDifferentialPackage][%s][%s]"),
+               package->differential_filename(), base_version));
+  ++metric_worker_download_differential_total;
+
+  CString base_package_name;
+  HRESULT hr = base_version.IsEmpty() ?
+      HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND) :
+      package_cache()->FindPackageByHash(app_id,
+                                         base_version,
+                                         base_hash,
+                                         &base_package_name);
+  if (FAILED(hr)) {
+    CORE_LOG(L3, (_T("[base package is not cached][0x%08x]"), hr));
+    return GOOPDATEDOWNLOAD_E_PATCH_BASE_NOT_FOUND;
+  }
+
+  CString base_filename;
+  CString differential_filename;
+  hr = BuildUniqueFileName(base_package_name, &base_filename);
+  if (SUCCEEDED(hr)) {
+    hr = BuildUniqueFileName(package->differential_filename(),
+                             &differential_filename);
+  }
+  if (FAILED(hr)) {
+    CORE_LOG(LE, (_T("[BuildUniqueFileName failed][0x%08x]"), hr));
+    return hr;
+  }
+
+  // The cached package is hard linked or cloned when possible, instead of
+  // being copied. The patch only reads it.
+  const PackageCache::Key base_key(app_id, base_version, base_package_name);
+  hr = package_cache()->Get(base_key, base_filename, base_hash);
+  if (FAILED(hr)) {
+    CORE_LOG(LE, (_T("[failed to get base package][0x%08x]"), hr));
+    return GOOPDATEDOWNLOAD_E_PATCH_BASE_NOT_FOUND;
+  }
+
+  hr = DownloadDifferentialPackage(package,
+                                   differential_filename,
+                                   network_request,
+                                   source_url_index,
+                                   bytes_downloaded);
+
+  std::vector<uint8> digest;
+  if (SUCCEEDED(hr)) {
+    hr = ApplyDifferentialPatch(base_filename,
+                                differential_filename,
+                                filename,
+                                package->expected_size(),
+                                &digest);
+  }
+
+  DeleteBeforeOrAfterReboot(differential_filename);
+  DeleteBeforeOrAfterReboot(base_filename);
+
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  // The package is verified against its expected hash when it is cached.
+  hr = CallAsSelfAndImpersonate4(
+      this,
+      &DownloadManager::DoCachePackage,
+      static_cast<const Package*>(package),
+      static_cast<const CString*>(&filename),
+      static_cast<const std::vector<uint8>*>(&digest),
+      extra_code1);
+  if (FAILED(hr)) {
+    OPT_LOG(LE, (_T("[failed to cache reconstructed package][%#x]"), hr));
+    return hr;
+  }
+
+  ++metric_worker_download_differential_succeeded;
+  return S_OK;
+}
+
+HRESULT DownloadManager::DownloadDifferentialPackage(
+    Package* package,
+    const CString& filename,
+    NetworkRequest* network_request,
+    int* source_url_index,
+    uint64* bytes_downloaded) {
+  ASSERT1(package);
+  ASSERT1(network_request);
+  ASSERT1(source_url_index);
+  ASSERT1(bytes_downloaded);
+  ASSERT1(!package->model()->IsLockedByCaller());
+
+  App* app = package->app_version()->app();
+  const CString differential_hash(package->differential_hash());
+  const std::vector<CString> download_base_urls(
+      package->app_version()->download_base_urls());
+
+  HRESULT hr = E_FAIL;
+  for (size_t i = 0; i != download_base_urls.size(); ++i) {
+    CString url;
+    DWORD url_length(INTERNET_MAX_URL_LENGTH);
+    hr = ::UrlCombine(download_base_urls[i],
+                      package->differential_filename(),
+                      CStrBuf(url, INTERNET_MAX_URL_LENGTH),
+                      &url_length,
+                      0);
+    if (FAILED(hr)) {
+      continue;
+    }
+
+    OPT_LOG(L3, (_T("[starting differential download][from '%s']"), url));
+    hr = network_request->DownloadFile(url, filename);
+    AddDownloadMetricsPingEvents(network_request->download_metrics(), app);
+    if (hr == GOOPDATE_E_CANCELLED) {
+      return hr;
+    }
+    if (FAILED(hr)) {
+      OPT_LOG(LE, (_T("[DownloadFile failed][%#x]"), hr));
+      continue;
+    }
+
+    uint64 file_size = 0;
+    if (SUCCEEDED(File::GetFileSizeUnopen(filename, &file_size))) {
+      *bytes_downloaded += file_size;
+    }
+
+    std::vector<uint8> digest;
+    network_request->response_digest(&digest);
+    if (digest.empty()) {
+      hr = VerifyFileHashSha256(std::vector<CString>(1, filename),
+                                differential_hash);
+    } else {
+      hr = VerifyDigestSha256(digest, differential_hash);
+    }
+    if (FAILED(hr)) {
+      OPT_LOG(LE, (_T("[differential package hash mismatch][%#x]"), hr));
+      continue;
+    }
+
+    *source_url_index = static_cast<int>(i);
+    return S_OK;
+  }
+
+  return hr;
+}
 
 void DownloadManager::Cancel(App* app) {
   CORE_LOG(L3, (_T("[DownloadManager::Cancel][0x%p]"), app));
@@ -483,7 +843,7 @@ void DownloadManager::Cancel(App* app) {
 
   for (size_t i = 0; i != download_state_.size(); ++i) {
     if (app == download_state_[i]->app()) {
-      VERIFY1(SUCCEEDED(download_state_[i]->CancelNetworkRequest()));
+      VERIFY1(SUCCEEDED(download_state_[i]->CancelNetworkRequests()));
     }
   }
 }
@@ -494,7 +854,7 @@ void DownloadManager::CancelAll() {
   __mutexScope(lock());
 
   for (size_t i = 0; i != download_state_.size(); ++i) {
-    VERIFY1(SUCCEEDED(download_state_[i]->CancelNetworkRequest()));
+    VERIFY1(SUCCEEDED(download_state_[i]->CancelNetworkRequests()));
   }
 }
 
@@ -510,8 +870,23 @@ HRESULT DownloadManager::PurgeAppLowerVersions(const CString& app_id,
 
 HRESULT DownloadManager::CachePackage(const Package* package,
                                       const CString* filename_path) {
+  int extra_code1 = 0;
+  const std::vector<uint8> digest;
+  HRESULT hr = DoCachePackage(package, filename_path, &digest, &extra_code1);
+  if (hr == GOOPDATEDOWNLOAD_E_CACHING_FAILED) {
+    set_error_extra_code1(extra_code1);
+  }
+  return hr;
+}
+
+HRESULT DownloadManager::DoCachePackage(const Package* package,
+                                        const CString* filename_path,
+                                        const std::vector<uint8>* digest,
+                                        int* extra_code1) {
   ASSERT1(package);
   ASSERT1(filename_path);
+  ASSERT1(digest);
+  ASSERT1(extra_code1);
 
   const CString app_id(package->app_version()->app()->app_guid_string());
   const CString version(package->app_version()->version());
@@ -519,10 +894,10 @@ HRESULT DownloadManager::CachePackage(const Package* package,
   PackageCache::Key key(app_id, version, package_name);
 
   HRESULT hr = package_cache()->Put(
-      key, *filename_path, package->expected_hash());
+      key, *filename_path, package->expected_hash(), *digest);
   if (hr != SIGS_E_INVALID_SIGNATURE) {
     if (FAILED(hr)) {
-      set_error_extra_code1(static_cast<int>(hr));
+      *extra_code1 = static_cast<int>(hr);
       return GOOPDATEDOWNLOAD_E_CACHING_FAILED;
     }
     return hr;
@@ -563,28 +938,39 @@ HRESULT DownloadManager::BuildUniqueFileName(const CString& filename,
          GOOPDATEDOWNLOAD_E_UNIQUE_FILE_PATH_EMPTY : S_OK;
 }
 
-HRESULT DownloadManager::CreateStateForApp(App* app, State** state) {
+HRESULT DownloadManager::CreateStateForApp(App* app,
+                                           size_t num_network_requests,
+                                           State** state) {
   ASSERT1(app);
+  ASSERT1(num_network_requests > 0);
   ASSERT1(state);
 
   *state = NULL;
 
-  NetworkRequest* network_request = NULL;
-  HRESULT hr = CreateNetworkRequest(&network_request);
-  if (FAILED(hr)) {
-    return hr;
-  }
-
-  ASSERT1(network_request);
-
   const bool use_background_priority =
                   (app->app_bundle()->priority() < INSTALL_PRIORITY_HIGH);
-  network_request->set_low_priority(use_background_priority);
 
-  network_request->set_proxy_auth_config(
-      app->app_bundle()->GetProxyAuthConfig());
+  std::vector<std::unique_ptr<NetworkRequest>> network_requests;
+  for (size_t i = 0; i != num_network_requests; ++i) {
+    NetworkRequest* network_request = NULL;
+    HRESULT hr = CreateNetworkRequest(&network_request);
+    if (FAILED(hr)) {
+      return hr;
+    }
+
+    ASSERT1(network_request);
+    network_requests.push_back(
+        std::unique_ptr<NetworkRequest>(network_request));
 
-  std::unique_ptr<State> state_ptr(new State(app, network_request));
+    network_request->set_low_priority(use_background_priority);
+    network_request->set_num_segments(
+        use_background_priority ? 1 : kNumForegroundDownloadSegments);
+
+    network_request->set_proxy_auth_config(
+        app->app_bundle()->GetProxyAuthConfig());
+  }
+
+  std::unique_ptr<State> state_ptr(new State(app, &network_requests));
 
   __mutexBlock(lock()) {
     download_state_.push_back(state_ptr.release());
@@ -613,24 +999,54 @@ HRESULT DownloadManager::DeleteStateForApp(App* app) {
   return E_UNEXPECTED;
 }
 
-DownloadManager::State::State(App* app, NetworkRequest* network_request)
-    : app_(app), network_request_(network_request) {
+DownloadManager::State::State(
+    App* app,
+    std::vector<std::unique_ptr<NetworkRequest>>* network_requests)
+    : app_(app),
+      is_download_started_(false) {
   ASSERT1(app);
-  ASSERT1(network_request);
+  ASSERT1(network_requests);
+  ASSERT1(!network_requests->empty());
+
+  network_requests_.swap(*network_requests);
 }
 
 DownloadManager::State::~State() {
 }
 
-NetworkRequest* DownloadManager::State::network_request() const {
+size_t DownloadManager::State::num_network_requests() const {
+  return network_requests_.size();
+}
+
+NetworkRequest* DownloadManager::State::network_request(size_t index) const {
+  ASSERT1(index < network_requests_.size());
   ASSERT1(ConfigManager::Instance()->CanUseNetwork(
                                          app_->app_bundle()->is_machine()));
 
-  return network_request_.get();
+  return network_requests_[index].get();
+}
+
+HRESULT DownloadManager::State::CancelNetworkRequests() {
+  HRESULT hr = S_OK;
+  for (size_t i = 0; i != network_requests_.size(); ++i) {
+    HRESULT cancel_hr = network_requests_[i]->Cancel();
+    if (FAILED(cancel_hr)) {
+      hr = cancel_hr;
+    }
+  }
+  return hr;
+}
+
+bool DownloadManager::State::OnPackageDownloadStarted() {
+  __mutexScope(lock_);
+  const bool is_first_package = !is_download_started_;
+  is_download_started_ = true;
+  return is_first_package;
 }
 
-HRESULT DownloadManager::State::CancelNetworkRequest() {
-  return network_request_->Cancel();
+bool DownloadManager::State::is_download_started() const {
+  __mutexScope(lock_);
+  return is_download_started_;
 }
 
 }  // namespace omaha
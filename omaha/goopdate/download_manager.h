@@ -22,6 +22,7 @@
 #include <vector>
 
 #include "base/basictypes.h"
+#include "omaha/base/synchronized.h"
 
 namespace omaha {
 
@@ -69,7 +70,10 @@ class DownloadManager : public DownloadManagerInterface {
   // This is a blocking call. All errors are reported through the return value.
   // Callers may use GetMessageForError() to convert this error value to an
   // error message. Progress is reported via the NetworkRequestCallback
-  // method on the Package objects.
+  // method on the Package objects. The packages of the app are downloaded
+  // concurrently, up to ConfigManager::GetPackageDownloadConcurrency() at a
+  // time. If more than one package fails, the error of the first failed
+  // package in package order is returned.
   virtual HRESULT DownloadApp(App* app);
 
   // Retrieves a package from the cache, if the package is locally available.
@@ -94,39 +98,115 @@ class DownloadManager : public DownloadManagerInterface {
                                     const CString& language);
 
  private:
-  // Maintains per-app download state.
+  // Maintains per-app download state. An app which downloads its packages
+  // concurrently has one network request for each concurrent download.
   class State {
    public:
-    State(App* app, NetworkRequest* network_request);
+    State(App* app,
+          std::vector<std::unique_ptr<NetworkRequest>>* network_requests);
     ~State();
 
     App* app() const { return app_; }
 
-    NetworkRequest* network_request() const;
+    size_t num_network_requests() const;
+    NetworkRequest* network_request(size_t index) const;
 
-    HRESULT CancelNetworkRequest();
+    HRESULT CancelNetworkRequests();
+
+    // Records that a package of the app has started downloading. Returns true
+    // for the first package only, so that the app-level download start time
+    // is set once even when the packages are downloaded concurrently.
+    bool OnPackageDownloadStarted();
+    bool is_download_started() const;
 
    private:
     // Not owned by this object.
     App* app_;
 
-    std::unique_ptr<NetworkRequest> network_request_;
+    std::vector<std::unique_ptr<NetworkRequest>> network_requests_;
+
+    LLock lock_;
+    bool is_download_started_;
 
     DISALLOW_COPY_AND_ASSIGN(State);
   };
 
+  // The outcome of downloading one package. The error and the extra code are
+  // kept per package so that the error reported for the app is attributed to
+  // the correct package even when the packages are downloaded concurrently.
+  struct PackageResult {
+    PackageResult()
+        : hr(S_OK), extra_code1(0), source_url_index(-1), is_done(false) {}
+
+    HRESULT hr;
+    int extra_code1;
+
+    // The index of the download base url the package was downloaded from, or
+    // -1 if the package was not downloaded.
+    int source_url_index;
+    bool is_done;
+  };
+
+  // Downloads the packages of an app on a set of threads, one for each
+  // network request of the download state.
+  class ConcurrentPackageDownload;
+
   // Creates a download state corresponding to the app. The state object is
   // owned by the download manager. A pointer to the state object is returned
-  // to the caller.
-  HRESULT CreateStateForApp(App* app, State** state);
+  // to the caller. The state has |num_network_requests| network requests.
+  HRESULT CreateStateForApp(App* app,
+                            size_t num_network_requests,
+                            State** state);
 
   HRESULT DeleteStateForApp(App* app);
 
-  HRESULT DoDownloadPackage(Package* package, State* state);
+  // Downloads the packages of the app one after the other, and stops at the
+  // first package which fails.
+  void DownloadPackages(State* state, std::vector<PackageResult>* results);
+
+  // Downloads |package| using the network request in |slot| of |state|.
+  // Returns the index of the download base url used in |source_url_index|.
+  HRESULT DoDownloadPackage(Package* package,
+                            State* state,
+                            size_t slot,
+                            int* extra_code1,
+                            int* source_url_index);
   HRESULT DoDownloadPackageFromUrl(const CString& url,
                                    const CString& filename,
                                    Package* package,
-                                   State* state);
+                                   NetworkRequest* network_request,
+                                   int* extra_code1);
+
+  // Reconstructs |package| from its differential package and the cached
+  // package of the installed version of the app. The differential package is
+  // downloaded and applied to a copy of the cached package, and the result is
+  // written to |filename|, then verified and cached. Fails if the package
+  // can't be reconstructed, in which case the full package is downloaded,
+  // unless the download has been cancelled. The bytes received are added to
+  // |bytes_downloaded|.
+  HRESULT DoDownloadDifferentialPackage(Package* package,
+                                        const CString& filename,
+                                        NetworkRequest* network_request,
+                                        int* extra_code1,
+                                        int* source_url_index,
+                                        uint64* bytes_downloaded);
+
+  // Downloads the differential package of |package| to |filename| and
+  // verifies its hash. Adds the size of each differential package received
+  // to |bytes_downloaded|.
+  HRESULT DownloadDifferentialPackage(Package* package,
+                                      const CString& filename,
+                                      NetworkRequest* network_request,
+                                      int* source_url_index,
+                                      uint64* bytes_downloaded);
+
+  // Validates and caches a package. |digest| is the digest of the file, if
+  // the digest was computed during the download, or empty otherwise. On
+  // caching errors, |extra_code1| receives the underlying error.
+  HRESULT DoCachePackage(const Package* package,
+                         const CString* filename_path,
+                         const std::vector<uint8>* digest,
+                         int* extra_code1);
 
   bool is_machine() const;
 
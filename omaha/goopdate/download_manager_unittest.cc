@@ -19,10 +19,13 @@
 #include <windows.h>
 
 #include "omaha/base/app_util.h"
+#include "omaha/base/constants.h"
 #include "omaha/base/error.h"
 #include "omaha/base/file.h"
 #include "omaha/base/path.h"
+#include "omaha/base/reg_key.h"
 #include "omaha/base/safe_format.h"
+#include "omaha/base/scope_guard.h"
 #include "omaha/base/signatures.h"
 #include "omaha/base/thread_pool.h"
 #include "omaha/base/timer.h"
@@ -34,6 +37,7 @@
 #include "omaha/goopdate/app_state_waiting_to_download.h"
 #include "omaha/goopdate/app_unittest_base.h"
 #include "omaha/goopdate/download_manager.h"
+#include "omaha/goopdate/worker_metrics.h"
 #include "omaha/testing/unit_test.h"
 #include "omaha/third_party/smartany/scoped_any.h"
 
@@ -69,6 +73,15 @@ class DownloadAppWorkItem : public UserWorkItem {
   DISALLOW_COPY_AND_ASSIGN(DownloadAppWorkItem);
 };
 
+void DeletePackageDownloadConcurrency() {
+  RegKey::DeleteValue(MACHINE_REG_UPDATE_DEV,
+                      kRegValuePackageDownloadConcurrency);
+}
+
+void DeleteAppGuid1ClientsKey() {
+  RegKey::DeleteKey(AppendRegKeyPath(USER_REG_CLIENTS, kAppGuid1));
+}
+
 }  // namespace
 
 class DownloadManagerTest : public AppTestBase {
@@ -196,6 +209,10 @@ TEST_F(DownloadManagerUserTest, DownloadApp_MultiplePackagesInOneApp) {
   EXPECT_TRUE(download_manager_->IsPackageAvailable(package));
   EXPECT_LT(0, app->GetDownloadTimeMs());
 
+  // The download time and the source url are set once for the app, although
+  // the packages are downloaded concurrently.
+  EXPECT_EQ(0, app->source_url_index());
+
   // Sanity check the pings, including the two download metrics pings.
   CString actual_pings;
   const PingEventVector& pings(app->ping_events());
@@ -225,6 +242,67 @@ TEST_F(DownloadManagerUserTest, DownloadApp_MultiplePackagesInOneApp) {
       _T("eventtype=1, eventresult=1, errorcode=0, extracode1=0; ")));
 }
 
+// Downloads the packages of one app concurrently. The second package fails
+// validation and its error is reported for the app.
+TEST_F(DownloadManagerUserTest,
+       DownloadApp_MultiplePackagesInOneApp_ConcurrentFailure) {
+  EXPECT_SUCCEEDED(RegKey::SetValue(MACHINE_REG_UPDATE_DEV,
+                                    kRegValuePackageDownloadConcurrency,
+                                    static_cast<DWORD>(2)));
+  ON_SCOPE_EXIT(DeletePackageDownloadConcurrency);
+
+  App* app = NULL;
+  ASSERT_SUCCEEDED(app_bundle_->createApp(CComBSTR(kAppGuid1), &app));
+  EXPECT_SUCCEEDED(app->put_displayName(CComBSTR(_T("App1"))));
+  EXPECT_SUCCEEDED(app->put_isEulaAccepted(VARIANT_TRUE));  // Allow download.
+
+  // One app, two packages. The hash of the second package is wrong.
+  CStringA buffer_string =
+
+  "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+  "<response protocol=\"3.0\">"
+    "<app appid=\"{0B35E146-D9CB-4145-8A91-43FDCAEBCD1E}\" status=\"ok\">"
+      "<updatecheck status=\"ok\">"
+        "<urls>"
+          "<url codebase=\"http://dl.google.com/update2/\"/>"
+        "</urls>"
+        "<manifest version=\"1.0\">"
+          "<packages>"
+            "<package "
+              "hash_sha256=\"e5a00aa9991ac8a5ee3109844d84a55583bd20572ad3ffcd42792f3c36b183ad\" "  // NOLINT
+              "name=\"UpdateData.bin\" "
+              "required=\"true\" "
+              "size=\"2048\"/>"
+            "<package "
+              "hash_sha256=\"e5a00aa9991ac8a5ee3109844d84a55583bd20572ad3ffcd42792f3c36b183ad\" "  // NOLINT
+              "name=\"UpdateData1.bin\" "
+              "required=\"true\" "
+              "size=\"2048\"/>"
+          "</packages>"
+        "</manifest>"
+      "</updatecheck>"
+    "</app>"
+  "</response>";
+
+  EXPECT_HRESULT_SUCCEEDED(LoadBundleFromXml(app_bundle_.get(), buffer_string));
+  SetAppStateWaitingToDownload(app);
+
+  EXPECT_EQ(SIGS_E_INVALID_SIGNATURE, download_manager_->DownloadApp(app));
+  EXPECT_EQ(STATE_ERROR, app->state());
+  EXPECT_EQ(SIGS_E_INVALID_SIGNATURE, app->error_code());
+  EXPECT_EQ(0, app->error_context().extra_code1);
+
+  const Package* package = app->next_version()->GetPackage(0);
+  ASSERT_TRUE(package);
+  EXPECT_EQ(2048, package->bytes_downloaded());
+  EXPECT_TRUE(download_manager_->IsPackageAvailable(package));
+
+  package = app->next_version()->GetPackage(1);
+  ASSERT_TRUE(package);
+  EXPECT_EQ(2048, package->bytes_downloaded());
+  EXPECT_FALSE(download_manager_->IsPackageAvailable(package));
+}
+
 // Downloads multiple apps serially.
 TEST_F(DownloadManagerUserTest, DownloadApp_MultipleApps) {
   App* app = NULL;
@@ -1026,6 +1104,72 @@ TEST_F(DownloadManagerUserTest, DownloadApp_BaseUrlFallback) {
   EXPECT_TRUE(download_manager_->IsPackageAvailable(package));
 }
 
+// The update has a differential package but the package of the installed
+// version is not in the cache. The full package is downloaded instead, and
+// only its bytes are reported as downloaded.
+TEST_F(DownloadManagerUserTest, DownloadApp_DifferentialFallbackToFull) {
+  EXPECT_SUCCEEDED(RegKey::SetValue(
+      AppendRegKeyPath(USER_REG_CLIENTS, kAppGuid1),
+      kRegValueProductVersion,
+      _T("0.9")));
+  ON_SCOPE_EXIT(DeleteAppGuid1ClientsKey);
+
+  App* app = NULL;
+  ASSERT_SUCCEEDED(app_bundle_->createInstalledApp(CComBSTR(kAppGuid1), &app));
+  EXPECT_SUCCEEDED(app->put_isEulaAccepted(VARIANT_TRUE));  // Allow download.
+  ASSERT_TRUE(app->is_update());
+
+  CStringA buffer_string =
+
+  "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+  "<response protocol=\"3.0\">"
+    "<app appid=\"{0B35E146-D9CB-4145-8A91-43FDCAEBCD1E}\" status=\"ok\">"
+      "<updatecheck status=\"ok\">"
+        "<urls>"
+          "<url codebase=\"http://dl.google.com/update2/\"/>"
+        "</urls>"
+        "<manifest version=\"1.0\">"
+          "<packages>"
+            "<package "
+              "hash_sha256=\"e5a00aa9991ac8a5ee3109844d84a55583bd20572ad3ffcd42792f3c36b183ad\" "  // NOLINT
+              "name=\"UpdateData.bin\" "
+              "required=\"true\" "
+              "size=\"2048\" "
+              "namediff=\"UpdateData_from_0.9.diff\" "
+              "sizediff=\"100\" "
+              "hashdiff_sha256=\"0bd4e2ac5a4d2e1d7a3d9b4c8cc22d3ea0e0c16c3a5f0f4c3df8c2b26a2ba6e1\" "  // NOLINT
+              "basehash_sha256=\"8e38b8c5ad8af7d5f8b9c0e2d5f2a4cb6b56ddc3e4e2e1a9a8a2a7ba8f0d4f5e\"/>"  // NOLINT
+          "</packages>"
+        "</manifest>"
+      "</updatecheck>"
+    "</app>"
+  "</response>";
+
+  EXPECT_HRESULT_SUCCEEDED(LoadBundleFromXml(app_bundle_.get(), buffer_string));
+  SetAppStateWaitingToDownload(app);
+
+  const int64 differential_total =
+      metric_worker_download_differential_total.value();
+  const int64 differential_succeeded =
+      metric_worker_download_differential_succeeded.value();
+
+  EXPECT_SUCCEEDED(download_manager_->DownloadApp(app));
+
+  EXPECT_EQ(differential_total + 1,
+            metric_worker_download_differential_total.value());
+  EXPECT_EQ(differential_succeeded,
+            metric_worker_download_differential_succeeded.value());
+
+  const Package* package = app->next_version()->GetPackage(0);
+  ASSERT_TRUE(package);
+  EXPECT_TRUE(package->has_differential_package());
+  EXPECT_STREQ(kUpdateBinHashSha256, package->expected_hash());
+  EXPECT_TRUE(download_manager_->IsPackageAvailable(package));
+  EXPECT_EQ(2048, app->num_bytes_downloaded());
+  EXPECT_EQ(0, app->source_url_index());
+  EXPECT_EQ(STATE_READY_TO_INSTALL, app->state());
+}
+
 TEST_F(DownloadManagerUserTest, DownloadApp_FallbackToNextUrlIfCachingFails) {
   App* app = NULL;
   ASSERT_SUCCEEDED(app_bundle_->createApp(CComBSTR(kAppGuid1), &app));
@@ -43,6 +43,8 @@
 #include "omaha/goopdate/goopdate.h"
 
 #include <atlstr.h>
+#include <algorithm>
+#include <atomic>
 #include <new>
 #include <utility>
 
@@ -51,6 +53,7 @@
 #include "omaha/base/crash_if_specific_error.h"
 #include "omaha/base/debug.h"
 #include "omaha/base/error.h"
+#include "omaha/base/executor_thread_pool.h"
 #include "omaha/base/file.h"
 #include "omaha/base/logging.h"
 #include "omaha/base/omaha_version.h"
@@ -58,6 +61,7 @@
 #include "omaha/base/reg_key.h"
 #include "omaha/base/safe_format.h"
 #include "omaha/base/system_info.h"
+#include "omaha/base/thread_pool.h"
 #include "omaha/base/utils.h"
 #include "omaha/base/vistautil.h"
 #include "omaha/client/client_utils.h"
@@ -196,6 +200,68 @@ void LogErrorWithHResult(int event_id,
 
 #endif  // defined(HAS_DEVICE_MANAGEMENT)
 
+// Records the events of the executor as goopdate metrics.
+class ExecutorMetricsObserver : public ExecutorObserver {
+ public:
+  ExecutorMetricsObserver() : max_queue_depth_(0) {}
+
+  virtual void OnTaskQueued(ExecutorPriority priority, size_t queue_depth) {
+    UNREFERENCED_PARAMETER(priority);
+    ++metric_goopdate_executor_tasks_queued;
+
+    size_t max_queue_depth = max_queue_depth_;
+    while (queue_depth > max_queue_depth) {
+      if (max_queue_depth_.compare_exchange_weak(max_queue_depth,
+                                                 queue_depth)) {
+        metric_goopdate_executor_max_queue_depth =
+            static_cast<int64>(queue_depth);
+        break;
+      }
+    }
+  }
+
+  virtual void OnTaskRejected(ExecutorPriority priority) {
+    UNREFERENCED_PARAMETER(priority);
+    ++metric_goopdate_executor_tasks_rejected;
+  }
+
+  virtual void OnTaskStarted(ExecutorPriority priority,
+                             int64 queue_latency_us,
+                             bool is_stolen) {
+    if (is_stolen) {
+      ++metric_goopdate_executor_tasks_stolen;
+    }
+
+    const int64 queue_latency_ms = queue_latency_us / 1000;
+    if (priority == EXECUTOR_PRIORITY_INTERACTIVE) {
+      metric_goopdate_executor_interactive_queue_latency_ms.AddSample(
+          queue_latency_ms);
+    } else {
+      metric_goopdate_executor_background_queue_latency_ms.AddSample(
+          queue_latency_ms);
+    }
+  }
+
+  virtual void OnTaskCancelled(ExecutorPriority priority) {
+    UNREFERENCED_PARAMETER(priority);
+    ++metric_goopdate_executor_tasks_cancelled;
+  }
+
+ private:
+  std::atomic<size_t> max_queue_depth_;
+
+  DISALLOW_COPY_AND_ASSIGN(ExecutorMetricsObserver);
+};
+
+// Returns true if the work items run on the executor instead of the Windows
+// thread pool.
+bool UseExecutorThreadPool() {
+  DWORD use_executor = 0;
+  return SUCCEEDED(RegKey::GetValue(MACHINE_REG_UPDATE_DEV,
+                                    kRegValueUseExecutorThreadPool,
+                                    &use_executor)) && use_executor;
+}
+
 }  // namespace
 
 namespace detail {
@@ -234,6 +300,10 @@ class GoopdateImpl {
   bool IsMachineProcess();
 
   bool ShouldCheckShutdownEvent(CommandLineMode mode);
+
+  // Returns true for the long-lived modes which query the group policies
+  // during update checks and must see the policy changes.
+  bool ShouldMonitorGroupPolicies(CommandLineMode mode);
   bool IsShutdownEventSet();
 
   HRESULT LoadResourceDllIfNecessary(CommandLineMode mode,
@@ -330,7 +400,10 @@ class GoopdateImpl {
   CString user_default_language_id_;
 
   std::unique_ptr<OmahaExceptionHandler> exception_handler_;
+  // Outlives the thread pools. Only one of the thread pools is created.
+  ExecutorMetricsObserver executor_metrics_observer_;
   std::unique_ptr<ThreadPool> thread_pool_;
+  std::unique_ptr<ExecutorThreadPool> executor_thread_pool_;
 
   Goopdate* goopdate_;
 
@@ -378,10 +451,33 @@ GoopdateImpl::GoopdateImpl(Goopdate* goopdate, bool is_local_system)
   }
 
   static const int kThreadPoolShutdownDelayMs = 60000;
-  thread_pool_.reset(new ThreadPool);
-  HRESULT hr = thread_pool_->Initialize(kThreadPoolShutdownDelayMs);
-  if (FAILED(hr)) {
-    CORE_LOG(LE, (_T("[thread_pool_->Initialize failed][0x%08x]"), hr));
+  if (UseExecutorThreadPool()) {
+    // The work items block on the network and on the installers, so there
+    // are more threads than processors. The number of threads is fixed, see
+    // kRegValueUseExecutorThreadPool.
+    static const int kExecutorMinThreads = 8;
+    static const size_t kExecutorMaxQueuedWorkItems = 1000;
+    SYSTEM_INFO system_info = {};
+    ::GetSystemInfo(&system_info);
+    const int num_threads =
+        std::max(kExecutorMinThreads,
+                 2 * static_cast<int>(system_info.dwNumberOfProcessors));
+
+    executor_thread_pool_.reset(new ExecutorThreadPool);
+    HRESULT hr = executor_thread_pool_->Initialize(num_threads,
+                                                   kExecutorMaxQueuedWorkItems,
+                                                   kThreadPoolShutdownDelayMs,
+                                                   &executor_metrics_observer_);
+    if (FAILED(hr)) {
+      CORE_LOG(LE, (_T("[executor_thread_pool_->Initialize failed][0x%08x]"),
+                    hr));
+    }
+  } else {
+    thread_pool_.reset(new ThreadPool);
+    HRESULT hr = thread_pool_->Initialize(kThreadPoolShutdownDelayMs);
+    if (FAILED(hr)) {
+      CORE_LOG(LE, (_T("[thread_pool_->Initialize failed][0x%08x]"), hr));
+    }
   }
 }
 
@@ -393,6 +489,7 @@ GoopdateImpl::~GoopdateImpl() {
   Stop();
 
   thread_pool_.reset();
+  executor_thread_pool_.reset();
 
 #if defined(HAS_DEVICE_MANAGEMENT)
   DmStorage::DeleteInstance();
@@ -424,6 +521,12 @@ HRESULT GoopdateImpl::QueueUserWorkItem(std::unique_ptr<UserWorkItem> work_item,
                                         uint32 flags) {
   CORE_LOG(L3, (_T("[GoopdateImpl::QueueUserWorkItem]")));
   ASSERT1(work_item);
+  if (executor_thread_pool_) {
+    return executor_thread_pool_->QueueUserWorkItem(std::move(work_item),
+                                                    coinit_flags,
+                                                    flags);
+  }
+
   ASSERT1(thread_pool_.get());
   return thread_pool_->QueueUserWorkItem(std::move(work_item),
                                          coinit_flags,
@@ -431,7 +534,12 @@ HRESULT GoopdateImpl::QueueUserWorkItem(std::unique_ptr<UserWorkItem> work_item,
 }
 
 void GoopdateImpl::Stop() {
-  thread_pool_->Stop();    // Waits a little for any remaining jobs to complete.
+  // Waits a little for any remaining jobs to complete.
+  if (executor_thread_pool_) {
+    executor_thread_pool_->Stop();
+  } else {
+    thread_pool_->Stop();
+  }
 }
 
 // Assumes the resources are loaded and members are initialized.
@@ -724,6 +832,17 @@ HRESULT GoopdateImpl::InitializeGoopdateAndLoadResources() {
     return hr;
   }
 
+  // Update checks query the group policies many times. In the long-lived
+  // modes, the policies are read again only when they change. The other
+  // modes read the policies on each query, which avoids starting a monitor
+  // thread in processes which exit shortly.
+  if (ShouldMonitorGroupPolicies(args_.mode)) {
+    hr = ConfigManager::Instance()->StartGroupPolicyMonitoring();
+    if (FAILED(hr)) {
+      OPT_LOG(LW, (_T("[StartGroupPolicyMonitoring failed][%#x]"), hr));
+    }
+  }
+
 #if defined(HAS_DEVICE_MANAGEMENT)
 
   CachedOmahaPolicy dm_policy;
@@ -1019,6 +1138,20 @@ bool GoopdateImpl::ShouldCheckShutdownEvent(CommandLineMode mode) {
   }
 }
 
+bool GoopdateImpl::ShouldMonitorGroupPolicies(CommandLineMode mode) {
+  switch (mode) {
+    case COMMANDLINE_MODE_CORE:
+    case COMMANDLINE_MODE_SERVICE:
+    case COMMANDLINE_MODE_MEDIUM_SERVICE:
+    case COMMANDLINE_MODE_COMSERVER:
+    case COMMANDLINE_MODE_ONDEMAND:
+      return true;
+
+    default:
+      return false;
+  }
+}
+
 bool GoopdateImpl::IsShutdownEventSet() {
   NamedObjectAttributes attr;
   GetNamedObjectAttributes(kShutdownEvent, is_machine_, &attr);
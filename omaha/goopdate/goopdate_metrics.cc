@@ -47,6 +47,14 @@ DEFINE_METRIC_count(cr_callback_status_other);
 
 DEFINE_METRIC_count(load_resource_dll_failed);
 
+DEFINE_METRIC_count(goopdate_executor_tasks_queued);
+DEFINE_METRIC_count(goopdate_executor_tasks_rejected);
+DEFINE_METRIC_count(goopdate_executor_tasks_stolen);
+DEFINE_METRIC_count(goopdate_executor_tasks_cancelled);
+DEFINE_METRIC_integer(goopdate_executor_max_queue_depth);
+DEFINE_METRIC_histogram(goopdate_executor_interactive_queue_latency_ms);
+DEFINE_METRIC_histogram(goopdate_executor_background_queue_latency_ms);
+
 DEFINE_METRIC_count(goopdate_constructor);
 DEFINE_METRIC_count(goopdate_destructor);
 DEFINE_METRIC_count(goopdate_main);
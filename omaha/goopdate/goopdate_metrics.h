@@ -72,6 +72,19 @@ DECLARE_METRIC_count(cr_callback_status_other);
 // DLL. Does not include modes that do not need the DLL.
 DECLARE_METRIC_count(load_resource_dll_failed);
 
+// Work items run by the executor thread pool, when it replaces the Windows
+// thread pool. The work items are rejected when the queue is full, and they
+// are cancelled when their bundle is stopped before they start.
+DECLARE_METRIC_count(goopdate_executor_tasks_queued);
+DECLARE_METRIC_count(goopdate_executor_tasks_rejected);
+DECLARE_METRIC_count(goopdate_executor_tasks_stolen);
+DECLARE_METRIC_count(goopdate_executor_tasks_cancelled);
+// Highest number of work items waiting to run.
+DECLARE_METRIC_integer(goopdate_executor_max_queue_depth);
+// Distribution of the time (ms) the work items wait before they run.
+DECLARE_METRIC_histogram(goopdate_executor_interactive_queue_latency_ms);
+DECLARE_METRIC_histogram(goopdate_executor_background_queue_latency_ms);
+
 DECLARE_METRIC_count(goopdate_constructor);
 DECLARE_METRIC_count(goopdate_destructor);
 DECLARE_METRIC_count(goopdate_main);
@@ -46,6 +46,10 @@ class Model {
 
   const Lockable& lock() const { return lock_; }
 
+  // Acquires the model lock if it is not held by another thread. Returns
+  // true if the lock was acquired, in which case the caller must unlock it.
+  bool TryLock() const { return lock_.Lock(0); }
+
   // Returns true if the model lock is held by the calling thread.
   bool IsLockedByCaller() const {
     return ::GetCurrentThreadId() == lock_.GetOwner();
@@ -90,7 +94,8 @@ class Model {
  private:
   using AppBundleWeakPtr = std::weak_ptr<AppBundle>;
 
-  // Serializes access to the model objects. Consider replacing with SWMR lock.
+  // Serializes access to the model objects. The state polled by the clients
+  // is also published outside of the lock, see App::get_currentState.
   LLock lock_;
 
   std::vector<AppBundleWeakPtr> app_bundles_;
@@ -56,7 +56,7 @@ void CheckResponse(const xml::response::Response& xml_response,
   const xml::InstallPackage& install_package(install_manifest.packages[0]);
   EXPECT_STREQ(_T("foo_installer.exe"), install_package.name);
   EXPECT_TRUE(install_package.is_required);
-  EXPECT_EQ(12345678, install_package.size);
+  EXPECT_EQ(12345678ULL, install_package.size);
   EXPECT_STREQ(_T("abcdef"), install_package.hash_sha1);
   if (CString(expected_protocol_version) == _T("2.0")) {
     EXPECT_TRUE(install_package.hash_sha256.IsEmpty());
@@ -179,19 +179,22 @@ class ATL_NO_VTABLE OnDemand
     // Create a thread pool work item for deferred execution of the on demand
     // check. The thread pool owns this call back object. The thread owns the
     // impersonation and primary tokens.
+    // A user is waiting for the on-demand check, so it runs ahead of the
+    // background work.
     using Callback = StaticThreadPoolCallBack1<internal::OnDemandParameters>;
-    hr = Goopdate::Instance().QueueUserWorkItem(
-        std::make_unique<Callback>(
-            &OnDemand::DoOnDemandInternal,
-            internal::OnDemandParameters(
-                guid,
-                job_observer_git.Detach(),
-                is_update_check_only,
-                session_id_,
-                dup_impersonation_token.GetHandle(),
-                dup_primary_token.GetHandle())),
-        COINIT_APARTMENTTHREADED,
-        WT_EXECUTELONGFUNCTION);
+    auto callback = std::make_unique<Callback>(
+        &OnDemand::DoOnDemandInternal,
+        internal::OnDemandParameters(
+            guid,
+            job_observer_git.Detach(),
+            is_update_check_only,
+            session_id_,
+            dup_impersonation_token.GetHandle(),
+            dup_primary_token.GetHandle()));
+    callback->set_priority(EXECUTOR_PRIORITY_INTERACTIVE);
+    hr = Goopdate::Instance().QueueUserWorkItem(std::move(callback),
+                                                COINIT_APARTMENTTHREADED,
+                                                WT_EXECUTELONGFUNCTION);
     if (FAILED(hr)) {
       CORE_LOG(LE, (_T("[QueueUserWorkItem failed][0x%x]"), hr));
       return hr;
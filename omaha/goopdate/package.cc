@@ -15,6 +15,9 @@
 
 #include "omaha/goopdate/package.h"
 
+#include <algorithm>
+#include <climits>
+
 #include "omaha/base/debug.h"
 #include "omaha/base/logging.h"
 #include "omaha/base/synchronized.h"
@@ -28,6 +31,7 @@ Package::Package(AppVersion* app_version)
     : ModelObject(app_version->model()),
       app_version_(app_version),
       expected_size_(0),
+      differential_size_(0),
       bytes_downloaded_(0),
       bytes_total_(0),
       next_download_retry_time_(0),
@@ -67,10 +71,8 @@ STDMETHODIMP Package::get_filename(BSTR* filename_as_bstr) const {
 }
 
 // status_text can be NULL.
-// TODO(omaha): Change bytes and bytes_total to uint64. Any logging will
-// need to use %llu.
-void Package::OnProgress(int bytes,
-                         int bytes_total,
+void Package::OnProgress(uint64 bytes,
+                         uint64 bytes_total,
                          int status,
                          const TCHAR* status_text) {
   __mutexScope(model()->lock());
@@ -80,8 +82,8 @@ void Package::OnProgress(int bytes,
   ASSERT1(status == WINHTTP_CALLBACK_STATUS_READ_COMPLETE ||
           status == WINHTTP_CALLBACK_STATUS_CONNECTING_TO_SERVER);
 
-  CORE_LOG(L5, (_T("[Package::OnProgress][bytes %d][bytes_total %d][status %d]")
-                _T("[status_text '%s']"),
+  CORE_LOG(L5, (_T("[Package::OnProgress][bytes %I64u][bytes_total %I64u]")
+                _T("[status %d][status_text '%s']"),
                 bytes, bytes_total, status, status_text));
 
   // TODO(omaha): What do we do if the following condition - bytes_total
@@ -97,13 +99,16 @@ void Package::OnProgress(int bytes,
   // successive calls?
 
   // ASSERT1(bytes_total == 0 ||
-  //         bytes_total == static_cast<int>(expected_size_));
+  //         bytes_total == expected_size_);
   ASSERT1(bytes <= bytes_total);
 
   bytes_downloaded_ = bytes;
   bytes_total_ = bytes_total;
 
-  progress_sampler_.AddSampleWithCurrentTimeStamp(bytes_downloaded_);
+  progress_sampler_.AddSampleWithCurrentTimeStamp(
+      static_cast<int64>(bytes_downloaded_));
+
+  app_version()->app()->app_bundle()->NotifyProgress();
 }
 
 void Package::OnRequestBegin() {
@@ -151,6 +156,47 @@ CString Package::expected_hash() const {
   return expected_hash_;
 }
 
+void Package::SetDifferentialFileInfo(const CString& filename,
+                                      uint64 size,
+                                      const CString& hash,
+                                      const CString& base_hash) {
+  __mutexScope(model()->lock());
+
+  ASSERT1(!filename.IsEmpty());
+  ASSERT1(!hash.IsEmpty());
+  ASSERT1(!base_hash.IsEmpty());
+
+  differential_filename_ = filename;
+  differential_size_ = size;
+  differential_hash_ = hash;
+  differential_base_hash_ = base_hash;
+}
+
+bool Package::has_differential_package() const {
+  __mutexScope(model()->lock());
+  return !differential_filename_.IsEmpty();
+}
+
+CString Package::differential_filename() const {
+  __mutexScope(model()->lock());
+  return differential_filename_;
+}
+
+uint64 Package::differential_size() const {
+  __mutexScope(model()->lock());
+  return differential_size_;
+}
+
+CString Package::differential_hash() const {
+  __mutexScope(model()->lock());
+  return differential_hash_;
+}
+
+CString Package::differential_base_hash() const {
+  __mutexScope(model()->lock());
+  return differential_base_hash_;
+}
+
 uint64 Package::bytes_downloaded() const {
   __mutexScope(model()->lock());
   return bytes_downloaded_;
@@ -175,14 +221,17 @@ LONG Package::GetEstimatedRemainingDownloadTimeMs() const {
   }
 
   LONG time_remaining_ms = kUnknownRemainingTime;
-  int average_speed = progress_sampler_.GetAverageProgressPerMs();
-  if (average_speed == ProgressSampler<int>::kUnknownProgressPerMs) {
+  const int64 average_speed = progress_sampler_.GetAverageProgressPerMs();
+  if (average_speed == ProgressSampler<int64>::kUnknownProgressPerMs) {
     return kUnknownRemainingTime;
   }
 
   if (bytes_total_ >= bytes_downloaded_ && average_speed > 0) {
+    const uint64 remaining_ms =
+        CeilingDivide(bytes_total_ - bytes_downloaded_,
+                      static_cast<uint64>(average_speed));
     time_remaining_ms = static_cast<LONG>(
-        CeilingDivide(bytes_total_ - bytes_downloaded_, average_speed));
+        std::min(remaining_ms, static_cast<uint64>(LONG_MAX)));
   }
 
   return time_remaining_ms;
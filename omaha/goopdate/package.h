@@ -52,8 +52,8 @@ class Package
   STDMETHOD(get_filename)(BSTR* filename) const;
 
   // NetworkRequestCallback.
-  virtual void OnProgress(int bytes,
-                          int bytes_total,
+  virtual void OnProgress(uint64 bytes,
+                          uint64 bytes_total,
                           int status,
                           const TCHAR* status_text);
   virtual void OnRequestBegin();
@@ -68,6 +68,20 @@ class Package
   // Returns expected file hashes.
   CString expected_hash() const;
 
+  // Sets the differential package, which reconstructs this package from the
+  // package of the installed version whose SHA-256 hash is |base_hash|.
+  void SetDifferentialFileInfo(const CString& filename,
+                               uint64 size,
+                               const CString& hash,
+                               const CString& base_hash);
+
+  // Returns true if the server offered a differential package.
+  bool has_differential_package() const;
+  CString differential_filename() const;
+  uint64 differential_size() const;
+  CString differential_hash() const;
+  CString differential_base_hash() const;
+
   uint64 bytes_downloaded() const;
 
   time64 next_download_retry_time() const;
@@ -86,11 +100,18 @@ class Package
   uint64 expected_size_;
   CString expected_hash_;
 
-  int bytes_downloaded_;
-  int bytes_total_;
+  // The differential package. The file name is empty if there is none.
+  CString differential_filename_;
+  uint64 differential_size_;
+  CString differential_hash_;
+  CString differential_base_hash_;
+
+  uint64 bytes_downloaded_;
+  uint64 bytes_total_;
   time64 next_download_retry_time_;
 
-  ProgressSampler<int> progress_sampler_;
+  // The sampler is signed since it reports an unknown speed as -1.
+  ProgressSampler<int64> progress_sampler_;
 
   // True if the package is being downloaded.
   // TODO(omaha): implement this.
@@ -15,7 +15,9 @@
 
 #include "omaha/goopdate/package_cache.h"
 
+#include <errno.h>
 #include <shlwapi.h>
+#include <winioctl.h>
 #include <algorithm>
 #include <vector>
 
@@ -34,6 +36,44 @@
 
 namespace omaha {
 
+namespace {
+
+// The file in the cache root which persists the verified digest index. The
+// file does not collide with the cache entries, which are directories named
+// after the app ids.
+const TCHAR* const kVerifiedDigestIndexFileName = _T("digests.idx");
+
+// The first line of the index file identifies the format of the file.
+const char* const kVerifiedDigestIndexHeader = "VerifiedDigestIndex 1";
+
+const uint32 kMaxVerifiedDigestIndexFileSize = 1024 * 1024;  // 1MB.
+
+const int kNumVerifiedDigestIndexFields = 6;
+
+// Buffer size used to copy files to the cache.
+const size_t kCopyBufferSize = 128 * 1024;
+
+uint64 FileTimeToUint64(const FILETIME& file_time) {
+  ULARGE_INTEGER result = {0};
+  result.LowPart = file_time.dwLowDateTime;
+  result.HighPart = file_time.dwHighDateTime;
+  return result.QuadPart;
+}
+
+bool ParseUint64(const CString& str, uint64* value) {
+  ASSERT1(value);
+  if (str.IsEmpty()) {
+    return false;
+  }
+
+  TCHAR* end = NULL;
+  errno = 0;
+  *value = _tcstoui64(str, &end, 10);
+  return errno == 0 && end && *end == _T('\0');
+}
+
+}  // namespace
+
 namespace internal {
 
 bool PackageSortByTimePredicate(const PackageInfo& package1,
@@ -141,6 +181,377 @@ void SortPackageInfoByTime(std::vector<PackageInfo>* packages_info) {
             PackageSortByTimePredicate);
 }
 
+HRESULT GetFileIdentity(const CString& file_name, FileIdentity* identity) {
+  ASSERT1(identity);
+
+  // Opening the file for reading its attributes does not read its contents.
+  scoped_hfile file(::CreateFile(file_name,
+                                 FILE_READ_ATTRIBUTES,
+                                 FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                 NULL,
+                                 OPEN_EXISTING,
+                                 FILE_ATTRIBUTE_NORMAL,
+                                 NULL));
+  if (!file) {
+    return HRESULTFromLastError();
+  }
+
+  BY_HANDLE_FILE_INFORMATION file_info = {0};
+  if (!::GetFileInformationByHandle(get(file), &file_info)) {
+    return HRESULTFromLastError();
+  }
+
+  ULARGE_INTEGER file_size = {0};
+  file_size.LowPart = file_info.nFileSizeLow;
+  file_size.HighPart = file_info.nFileSizeHigh;
+
+  ULARGE_INTEGER file_index = {0};
+  file_index.LowPart = file_info.nFileIndexLow;
+  file_index.HighPart = file_info.nFileIndexHigh;
+
+  identity->file_size = file_size.QuadPart;
+  identity->last_write_time = FileTimeToUint64(file_info.ftLastWriteTime);
+  identity->volume_serial_number = file_info.dwVolumeSerialNumber;
+  identity->file_index = file_index.QuadPart;
+  return S_OK;
+}
+
+HRESULT CreateHardLinkToFile(const CString& existing_file,
+                             const CString& link_file) {
+  if (!::CreateHardLink(link_file, existing_file, NULL)) {
+    return HRESULTFromLastError();
+  }
+
+  return S_OK;
+}
+
+HRESULT CopyFileAndComputeDigest(const CString& source_file,
+                                 const CString& destination_file,
+                                 std::vector<uint8>* digest) {
+  ASSERT1(digest);
+
+  scoped_hfile source(::CreateFile(source_file,
+                                   GENERIC_READ,
+                                   FILE_SHARE_READ,
+                                   NULL,
+                                   OPEN_EXISTING,
+                                   FILE_FLAG_SEQUENTIAL_SCAN,
+                                   NULL));
+  if (!source) {
+    return HRESULTFromLastError();
+  }
+
+  scoped_hfile destination(::CreateFile(destination_file,
+                                        GENERIC_WRITE,
+                                        0,
+                                        NULL,
+                                        CREATE_ALWAYS,
+                                        FILE_ATTRIBUTE_NORMAL,
+                                        NULL));
+  if (!destination) {
+    return HRESULTFromLastError();
+  }
+
+  StreamingHash hash;
+  std::vector<uint8> buffer(kCopyBufferSize);
+  for (;;) {
+    DWORD bytes_read = 0;
+    if (!::ReadFile(get(source),
+                    &buffer[0],
+                    static_cast<DWORD>(buffer.size()),
+                    &bytes_read,
+                    NULL)) {
+      return HRESULTFromLastError();
+    }
+    if (!bytes_read) {
+      break;
+    }
+
+    // The digest is computed over the bytes which are written, not over the
+    // bytes of the source file, which may change after they are read.
+    hash.Update(&buffer[0], bytes_read);
+
+    DWORD bytes_written = 0;
+    if (!::WriteFile(get(destination),
+                     &buffer[0],
+                     bytes_read,
+                     &bytes_written,
+                     NULL)) {
+      return HRESULTFromLastError();
+    }
+    if (bytes_written != bytes_read) {
+      return HRESULT_FROM_WIN32(ERROR_WRITE_FAULT);
+    }
+  }
+
+  hash.Finalize(digest);
+  return S_OK;
+}
+
+HRESULT CloneFile(const CString& source_file,
+                  const CString& destination_file) {
+  scoped_hfile source(::CreateFile(source_file,
+                                   GENERIC_READ,
+                                   FILE_SHARE_READ,
+                                   NULL,
+                                   OPEN_EXISTING,
+                                   FILE_ATTRIBUTE_NORMAL,
+                                   NULL));
+  if (!source) {
+    return HRESULTFromLastError();
+  }
+
+  DWORD file_system_flags = 0;
+  if (!::GetVolumeInformationByHandleW(get(source), NULL, 0, NULL, NULL,
+                                       &file_system_flags, NULL, 0)) {
+    return HRESULTFromLastError();
+  }
+  if (!(file_system_flags & FILE_SUPPORTS_BLOCK_REFCOUNTING)) {
+    return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+  }
+
+  FILE_STANDARD_INFO standard_info = {0};
+  if (!::GetFileInformationByHandleEx(get(source),
+                                      FileStandardInfo,
+                                      &standard_info,
+                                      sizeof(standard_info))) {
+    return HRESULTFromLastError();
+  }
+
+  // The cloned regions must be aligned on clusters.
+  FSCTL_GET_INTEGRITY_INFORMATION_BUFFER integrity = {0};
+  DWORD bytes_returned = 0;
+  if (!::DeviceIoControl(get(source),
+                         FSCTL_GET_INTEGRITY_INFORMATION,
+                         NULL,
+                         0,
+                         &integrity,
+                         sizeof(integrity),
+                         &bytes_returned,
+                         NULL)) {
+    return HRESULTFromLastError();
+  }
+  const uint64 cluster_size = integrity.ClusterSizeInBytes;
+  if (!cluster_size) {
+    return E_UNEXPECTED;
+  }
+
+  scoped_hfile destination(::CreateFile(destination_file,
+                                        GENERIC_READ | GENERIC_WRITE | DELETE,
+                                        0,
+                                        NULL,
+                                        CREATE_NEW,
+                                        FILE_ATTRIBUTE_NORMAL,
+                                        NULL));
+  if (!destination) {
+    return HRESULTFromLastError();
+  }
+
+  // Deletes the destination file when it is closed, unless cloning succeeds.
+  FILE_DISPOSITION_INFO disposition = {TRUE};
+  if (!::SetFileInformationByHandle(get(destination),
+                                    FileDispositionInfo,
+                                    &disposition,
+                                    sizeof(disposition))) {
+    return HRESULTFromLastError();
+  }
+
+  // The destination must have the same integrity settings as the source and
+  // its size must be set before cloning.
+  FSCTL_SET_INTEGRITY_INFORMATION_BUFFER set_integrity = {
+    integrity.ChecksumAlgorithm, integrity.Reserved, integrity.Flags
+  };
+  if (!::DeviceIoControl(get(destination),
+                         FSCTL_SET_INTEGRITY_INFORMATION,
+                         &set_integrity,
+                         sizeof(set_integrity),
+                         NULL,
+                         0,
+                         NULL,
+                         NULL)) {
+    return HRESULTFromLastError();
+  }
+
+  FILE_END_OF_FILE_INFO end_of_file = {0};
+  end_of_file.EndOfFile = standard_info.EndOfFile;
+  if (!::SetFileInformationByHandle(get(destination),
+                                    FileEndOfFileInfo,
+                                    &end_of_file,
+                                    sizeof(end_of_file))) {
+    return HRESULTFromLastError();
+  }
+
+  // Each call clones less than 4GB. The last region is rounded up to a
+  // cluster, which is allowed since the region ends at the end of the file.
+  const uint64 kMaxCloneSize = 1024 * 1024 * 1024;  // 1GB.
+  const uint64 file_size = static_cast<uint64>(
+      standard_info.EndOfFile.QuadPart);
+  const uint64 clone_size =
+      (file_size + cluster_size - 1) / cluster_size * cluster_size;
+  for (uint64 offset = 0; offset < clone_size; offset += kMaxCloneSize) {
+    DUPLICATE_EXTENTS_DATA extents = {0};
+    extents.FileHandle = get(source);
+    extents.SourceFileOffset.QuadPart = static_cast<LONGLONG>(offset);
+    extents.TargetFileOffset.QuadPart = static_cast<LONGLONG>(offset);
+    extents.ByteCount.QuadPart = static_cast<LONGLONG>(
+        std::min(kMaxCloneSize, clone_size - offset));
+    if (!::DeviceIoControl(get(destination),
+                           FSCTL_DUPLICATE_EXTENTS_TO_FILE,
+                           &extents,
+                           sizeof(extents),
+                           NULL,
+                           0,
+                           &bytes_returned,
+                           NULL)) {
+      return HRESULTFromLastError();
+    }
+  }
+
+  disposition.DeleteFile = FALSE;
+  if (!::SetFileInformationByHandle(get(destination),
+                                    FileDispositionInfo,
+                                    &disposition,
+                                    sizeof(disposition))) {
+    return HRESULTFromLastError();
+  }
+
+  return S_OK;
+}
+
+void VerifiedDigestIndex::Load(const CString& index_file) {
+  index_file_ = index_file;
+  entries_.clear();
+
+  std::vector<byte> buffer;
+  HRESULT hr = ReadEntireFileShareMode(index_file,
+                                       kMaxVerifiedDigestIndexFileSize,
+                                       FILE_SHARE_READ,
+                                       &buffer);
+  if (FAILED(hr)) {
+    CORE_LOG(L3, (_T("[VerifiedDigestIndex::Load][no index][0x%x]"), hr));
+    return;
+  }
+
+  const CString contents(buffer.empty() ? CString() :
+      Utf8ToWideChar(reinterpret_cast<const char*>(&buffer.front()),
+                     static_cast<uint32>(buffer.size())));
+
+  int pos = 0;
+  CString line = contents.Tokenize(_T("\n"), pos);
+  if (line != CString(kVerifiedDigestIndexHeader)) {
+    CORE_LOG(LW, (_T("[VerifiedDigestIndex::Load][unknown format]")));
+    return;
+  }
+
+  for (line = contents.Tokenize(_T("\n"), pos);
+       pos != -1;
+       line = contents.Tokenize(_T("\n"), pos)) {
+    // Each line contains: file name, size, last write time, volume serial
+    // number, file index, and hash, separated by tabs.
+    std::vector<CString> fields;
+    int field_pos = 0;
+    for (CString field = line.Tokenize(_T("\t"), field_pos);
+         field_pos != -1;
+         field = line.Tokenize(_T("\t"), field_pos)) {
+      fields.push_back(field);
+    }
+
+    uint64 volume_serial_number = 0;
+    Entry entry;
+    if (fields.size() != kNumVerifiedDigestIndexFields ||
+        !ParseUint64(fields[1], &entry.identity.file_size) ||
+        !ParseUint64(fields[2], &entry.identity.last_write_time) ||
+        !ParseUint64(fields[3], &volume_serial_number) ||
+        volume_serial_number > UINT_MAX ||
+        !ParseUint64(fields[4], &entry.identity.file_index) ||
+        fields[5].IsEmpty()) {
+      CORE_LOG(LW, (_T("[VerifiedDigestIndex::Load][bad entry][%s]"), line));
+      continue;
+    }
+
+    entry.identity.volume_serial_number =
+        static_cast<uint32>(volume_serial_number);
+    entry.hash = fields[5];
+
+    CString key(fields[0]);
+    MakeLowerCString(key);
+    entries_[key] = entry;
+  }
+
+  CORE_LOG(L3, (_T("[VerifiedDigestIndex::Load][%Iu entries]"),
+                entries_.size()));
+}
+
+HRESULT VerifiedDigestIndex::Save() const {
+  ASSERT1(!index_file_.IsEmpty());
+
+  CString contents(kVerifiedDigestIndexHeader);
+  contents += _T("\n");
+  for (EntryMap::const_iterator it = entries_.begin();
+       it != entries_.end();
+       ++it) {
+    const FileIdentity& identity = it->second.identity;
+    SafeCStringAppendFormat(&contents, _T("%s\t%I64u\t%I64u\t%u\t%I64u\t%s\n"),
+                            it->first,
+                            identity.file_size,
+                            identity.last_write_time,
+                            identity.volume_serial_number,
+                            identity.file_index,
+                            it->second.hash);
+  }
+
+  std::vector<byte> buffer;
+  WideToUtf8Vector(contents, &buffer);
+  HRESULT hr = WriteEntireFile(index_file_, buffer);
+  if (FAILED(hr)) {
+    CORE_LOG(LW, (_T("[VerifiedDigestIndex::Save failed][0x%x]"), hr));
+  }
+  return hr;
+}
+
+bool VerifiedDigestIndex::IsVerified(const CString& file_name,
+                                     const FileIdentity& identity,
+                                     const CString& hash) const {
+  CString key(file_name);
+  MakeLowerCString(key);
+
+  EntryMap::const_iterator it = entries_.find(key);
+  return it != entries_.end() &&
+         it->second.identity == identity &&
+         it->second.hash.CompareNoCase(hash) == 0;
+}
+
+void VerifiedDigestIndex::Add(const CString& file_name,
+                              const FileIdentity& identity,
+                              const CString& hash) {
+  ASSERT1(!hash.IsEmpty());
+
+  CString key(file_name);
+  MakeLowerCString(key);
+
+  Entry entry;
+  entry.identity = identity;
+  entry.hash = hash;
+  entries_[key] = entry;
+}
+
+void VerifiedDigestIndex::Remove(const CString& path) {
+  CString key(path);
+  MakeLowerCString(key);
+  const CString dir_prefix(String_EndsWith(key, _T("\\"), false) ?
+                           key : key + _T("\\"));
+
+  EntryMap::iterator it = entries_.begin();
+  while (it != entries_.end()) {
+    if (it->first == key ||
+        String_StartsWith(it->first, dir_prefix, false)) {
+      it = entries_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
 }  // namespace internal
 
 PackageCache::PackageCache() {
@@ -171,6 +582,9 @@ HRESULT PackageCache::Initialize(const CString& cache_root) {
 
   cache_root_ = cache_root;
 
+  digest_index_.Load(ConcatenatePath(cache_root_,
+                                     kVerifiedDigestIndexFileName));
+
   return S_OK;
 }
 
@@ -186,12 +600,72 @@ bool PackageCache::IsCached(const Key& key, const CString& hash) const {
     return false;
   }
 
-  return File::Exists(filename) && SUCCEEDED(VerifyHash(filename, hash));
+  return File::Exists(filename) &&
+         SUCCEEDED(VerifyCachedFileHash(filename, hash));
+}
+
+HRESULT PackageCache::FindPackageByHash(const CString& app_id,
+                                        const CString& version,
+                                        const CString& hash,
+                                        CString* package_name) const {
+  CORE_LOG(L3, (_T("[PackageCache::FindPackageByHash][%s][%s][hash %s]"),
+                app_id, version, hash));
+  ASSERT1(package_name);
+
+  __mutexScope(cache_lock_);
+
+  if (app_id.IsEmpty() || hash.IsEmpty()) {
+    return E_INVALIDARG;
+  }
+
+  // The key provides the default version when the version is empty.
+  const Key version_key(app_id, version, CString());
+  const CString version_dir(ConcatenatePath(
+      ConcatenatePath(cache_root_, version_key.app_id()),
+      version_key.version()));
+
+  std::vector<internal::PackageInfo> packages_info;
+  HRESULT hr = internal::FindVersionPackagesInfo(version_dir, &packages_info);
+  if (FAILED(hr)) {
+    return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+  }
+
+  // The packages whose hash has already been verified are looked up first,
+  // so that most lookups do not read any file.
+  for (size_t i = 0; i != packages_info.size(); ++i) {
+    const CString& filename = packages_info[i].file_name;
+    internal::FileIdentity identity;
+    if (SUCCEEDED(internal::GetFileIdentity(filename, &identity)) &&
+        digest_index_.IsVerified(filename, identity, hash)) {
+      *package_name = GetFileFromPath(filename);
+      return S_OK;
+    }
+  }
+
+  // The files which do not match are not removed from the digest index,
+  // since they may still match their own hash.
+  for (size_t i = 0; i != packages_info.size(); ++i) {
+    const CString& filename = packages_info[i].file_name;
+    if (SUCCEEDED(VerifyHash(filename, hash))) {
+      AddVerifiedDigest(filename, hash);
+      *package_name = GetFileFromPath(filename);
+      return S_OK;
+    }
+  }
+
+  return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
 }
 
 HRESULT PackageCache::Put(const Key& key,
                           const CString& source_file,
                           const CString& hash) {
+  return Put(key, source_file, hash, std::vector<uint8>());
+}
+
+HRESULT PackageCache::Put(const Key& key,
+                          const CString& source_file,
+                          const CString& hash,
+                          const std::vector<uint8>& source_digest) {
   ++metric_worker_package_cache_put_total;
   CORE_LOG(L3, (_T("[PackageCache::Put][key '%s'][source_file '%s'][hash %s]"),
                 key.ToString(), source_file, hash));
@@ -217,19 +691,37 @@ HRESULT PackageCache::Put(const Key& key,
     return hr;
   }
 
+  // A file whose digest is known to be wrong is not copied to the cache.
+  if (!source_digest.empty()) {
+    hr = VerifyDigestSha256(source_digest, hash);
+    if (FAILED(hr)) {
+      CORE_LOG(LE, (_T("[digest mismatch for file '%s'][expected hash %s]"),
+                    source_file, hash));
+      return hr;
+    }
+  }
+
   // TODO(omaha): consider not overwriting the file if the file is
   // in the cache and it is valid.
 
-  // When not impersonated, File::Copy resets the ownership of the destination
-  // file and it inherits ACEs from the new parent directory.
-  hr = File::Copy(source_file, destination_file, true);
+  // The source file may be written to by a user other than the caller, for
+  // instance when it has been downloaded while impersonating the user. The
+  // digest of the source file is therefore not trusted: the bytes are hashed
+  // as they are written to the cache, and it is the digest of the cached
+  // file which is verified. When not impersonated, the destination file is
+  // owned by the caller and it inherits ACEs from its parent directory.
+  std::vector<uint8> destination_digest;
+  hr = internal::CopyFileAndComputeDigest(source_file,
+                                          destination_file,
+                                          &destination_digest);
   if (FAILED(hr)) {
     CORE_LOG(LE, (_T("[failed to copy file to cache][0x%08x][%s]"),
                   hr, destination_file));
+    ::DeleteFile(destination_file);
     return hr;
   }
 
-  hr = VerifyHash(destination_file, hash);
+  hr = VerifyDigestSha256(destination_digest, hash);
   if (FAILED(hr)) {
     CORE_LOG(LE,
         (_T("[failed to verify hash for file '%s'][expected hash %s]"),
@@ -238,6 +730,8 @@ HRESULT PackageCache::Put(const Key& key,
     return hr;
   }
 
+  AddVerifiedDigest(destination_file, hash);
+
   ++metric_worker_package_cache_put_succeeded;
   return S_OK;
 }
@@ -266,14 +760,77 @@ HRESULT PackageCache::Get(const Key& key,
     return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
   }
 
-  hr = VerifyHash(source_file, hash);
+  hr = VerifyCachedFileHash(source_file, hash);
   if (FAILED(hr)) {
     CORE_LOG(LE, (_T("[failed to verify hash for file '%s'][expected hash %s]"),
         source_file, hash));
     return hr;
   }
 
-  return File::Copy(source_file, destination_file, true);
+  MaterializationStrategy strategy = MATERIALIZE_NONE;
+  hr = Materialize(source_file, destination_file, &strategy);
+  if (FAILED(hr)) {
+    CORE_LOG(LE, (_T("[failed to materialize file '%s'][0x%08x]"),
+                  destination_file, hr));
+    return hr;
+  }
+
+  switch (strategy) {
+    case MATERIALIZE_HARD_LINK:
+      ++metric_worker_package_cache_get_hard_link;
+      break;
+    case MATERIALIZE_CLONE:
+      ++metric_worker_package_cache_get_clone;
+      break;
+    case MATERIALIZE_COPY:
+      ++metric_worker_package_cache_get_copy;
+      break;
+    default:
+      ASSERT1(false);
+      break;
+  }
+
+  return S_OK;
+}
+
+HRESULT PackageCache::Materialize(const CString& source_file,
+                                  const CString& destination_file,
+                                  MaterializationStrategy* strategy) {
+  ASSERT1(strategy);
+
+  *strategy = MATERIALIZE_NONE;
+
+  // Hard links and clones can't replace an existing file.
+  if (File::Exists(destination_file)) {
+    HRESULT hr = File::Remove(destination_file);
+    if (FAILED(hr)) {
+      CORE_LOG(LE, (_T("[failed to remove '%s'][0x%08x]"),
+                    destination_file, hr));
+      return hr;
+    }
+  }
+
+  HRESULT hr = internal::CreateHardLinkToFile(source_file, destination_file);
+  if (SUCCEEDED(hr)) {
+    *strategy = MATERIALIZE_HARD_LINK;
+    return S_OK;
+  }
+  CORE_LOG(L3, (_T("[CreateHardLinkToFile failed][0x%08x]"), hr));
+
+  hr = internal::CloneFile(source_file, destination_file);
+  if (SUCCEEDED(hr)) {
+    *strategy = MATERIALIZE_CLONE;
+    return S_OK;
+  }
+  CORE_LOG(L3, (_T("[CloneFile failed][0x%08x]"), hr));
+
+  hr = File::Copy(source_file, destination_file, true);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  *strategy = MATERIALIZE_COPY;
+  return S_OK;
 }
 
 HRESULT PackageCache::Purge(const Key& key) {
@@ -342,6 +899,7 @@ HRESULT PackageCache::PurgeAppLowerVersions(const CString& app_id,
     }
 
     CString version_dir = ConcatenatePath(app_id_path, find_data.cFileName);
+    RemoveVerifiedDigests(version_dir);
     hr = DeleteBeforeOrAfterReboot(version_dir);
     CORE_LOG(L3, (_T("[Purge version][%s][0x%x]"), version_dir, hr));
   } while (::FindNextFile(get(hfind), &find_data));
@@ -354,7 +912,8 @@ HRESULT PackageCache::PurgeAll() {
 
   __mutexScope(cache_lock_);
 
-  // Deletes the cache root including all the cache entries.
+  // Deletes the cache root including all the cache entries and the verified
+  // digest index.
   HRESULT hr = Delete(_T(""), _T(""), _T(""));
   if (FAILED(hr)) {
     return hr;
@@ -415,6 +974,7 @@ HRESULT PackageCache::PurgeOldPackagesIfNecessary() const {
   }
 
   for (; it != packages_info.end(); ++it) {
+    RemoveVerifiedDigests(it->file_name);
     hr = DeleteBeforeOrAfterReboot(it->file_name);
   }
 
@@ -431,6 +991,7 @@ HRESULT PackageCache::Delete(const CString& app_id,
     return hr;
   }
 
+  RemoveVerifiedDigests(filename);
   return DeleteBeforeOrAfterReboot(filename);
 }
 
@@ -445,7 +1006,20 @@ CString PackageCache::cache_root() const {
 
 uint64 PackageCache::Size() const {
   uint64 result(0);
-  return SUCCEEDED(GetDirectorySize(cache_root_, &result)) ? result : 0;
+  if (FAILED(GetDirectorySize(cache_root_, &result))) {
+    return 0;
+  }
+
+  // The verified digest index is not a package.
+  internal::FileIdentity index_identity;
+  if (SUCCEEDED(internal::GetFileIdentity(
+          ConcatenatePath(cache_root_, kVerifiedDigestIndexFileName),
+          &index_identity))) {
+    ASSERT1(result >= index_identity.file_size);
+    result -= index_identity.file_size;
+  }
+
+  return result;
 }
 
 HRESULT PackageCache::BuildCacheFileNameForKey(const Key& key,
@@ -479,10 +1053,54 @@ HRESULT PackageCache::BuildCacheFileName(const CString& app_id,
   return S_OK;
 }
 
+HRESULT PackageCache::VerifyCachedFileHash(const CString& filename,
+                                           const CString& hash) const {
+  ASSERT1(cache_lock_.GetOwner() == ::GetCurrentThreadId());
+
+  internal::FileIdentity identity;
+  HRESULT hr = internal::GetFileIdentity(filename, &identity);
+  if (SUCCEEDED(hr) && digest_index_.IsVerified(filename, identity, hash)) {
+    CORE_LOG(L3, (_T("[PackageCache::VerifyCachedFileHash][verified][%s]"),
+                  filename));
+    return S_OK;
+  }
+
+  hr = VerifyHash(filename, hash);
+  if (FAILED(hr)) {
+    RemoveVerifiedDigests(filename);
+    return hr;
+  }
+
+  AddVerifiedDigest(filename, hash);
+  return S_OK;
+}
+
+void PackageCache::AddVerifiedDigest(const CString& filename,
+                                     const CString& hash) const {
+  internal::FileIdentity identity;
+  HRESULT hr = internal::GetFileIdentity(filename, &identity);
+  if (FAILED(hr)) {
+    CORE_LOG(LW, (_T("[GetFileIdentity failed][%s][0x%x]"), filename, hr));
+    return;
+  }
+
+  digest_index_.Add(filename, identity, hash);
+  digest_index_.Save();
+}
+
+void PackageCache::RemoveVerifiedDigests(const CString& path) const {
+  const size_t size = digest_index_.size();
+  digest_index_.Remove(path);
+  if (digest_index_.size() != size) {
+    digest_index_.Save();
+  }
+}
+
 HRESULT PackageCache::VerifyHash(const CString& filename,
                                  const CString& expected_hash) {
   CORE_LOG(L3, (_T("[PackageCache::VerifyHash][%s][%s]"),
            filename, expected_hash));
+  HISTOGRAM_TIME_SCOPE(metric_worker_package_cache_verify_hash_ms);
   HighresTimer verification_timer;
 
   std::vector<CString> files;
@@ -22,6 +22,7 @@
 #include "base/basictypes.h"
 #include "base/synchronized.h"
 #include "omaha/base/safe_format.h"
+#include "omaha/goopdate/package_cache_internal.h"
 
 namespace omaha {
 
@@ -67,12 +68,30 @@ class PackageCache {
               const CString& source_file,
               const CString& hash);
 
+  // Same as Put above, when the SHA-256 digest of |source_file| is already
+  // known, for instance because it has been computed while the file was being
+  // downloaded. A file whose digest does not match |hash| is not copied. The
+  // digest of the cached file is verified in all cases. An empty
+  // |source_digest| means that the digest is not known.
+  HRESULT Put(const Key& key,
+              const CString& source_file,
+              const CString& hash,
+              const std::vector<uint8>& source_digest);
+
   HRESULT Get(const Key& key,
               const CString& destination_file,
               const CString& hash) const;
 
   bool IsCached(const Key& key, const CString& hash) const;
 
+  // Finds the cached package of |app_id| and |version| whose hash is |hash|,
+  // for instance the package a differential package is applied to. Returns
+  // the name of the package in |package_name|.
+  HRESULT FindPackageByHash(const CString& app_id,
+                            const CString& version,
+                            const CString& hash,
+                            CString* package_name) const;
+
   HRESULT Purge(const Key& key);
 
   HRESULT PurgeVersion(const CString& app_id, const CString& version);
@@ -89,7 +108,7 @@ class PackageCache {
   // purging oldest ones.
   HRESULT PurgeOldPackagesIfNecessary() const;
 
-  // Returns the total size of all files in the cache. Returns 0 if the size
+  // Returns the total size of all packages in the cache. Returns 0 if the size
   // cannot be determined or the cache is empty.
   uint64 Size() const;
 
@@ -98,6 +117,14 @@ class PackageCache {
   static HRESULT VerifyHash(const CString& filename,
                             const CString& expected_hash);
 
+  // Defines how Get makes a cached package available at its destination.
+  enum MaterializationStrategy {
+    MATERIALIZE_NONE,
+    MATERIALIZE_HARD_LINK,
+    MATERIALIZE_CLONE,
+    MATERIALIZE_COPY,
+  };
+
  private:
   friend class PackageCacheTest;
 
@@ -118,6 +145,27 @@ class PackageCache {
   // are considered as expired and should be purged.
   FILETIME GetCacheExpirationTime() const;
 
+  // Verifies the hash of a file in the cache. The file is only read if it has
+  // changed since its hash was last verified.
+  HRESULT VerifyCachedFileHash(const CString& filename,
+                               const CString& hash) const;
+
+  // Records that the hash of a file in the cache has been verified.
+  void AddVerifiedDigest(const CString& filename, const CString& hash) const;
+
+  // Removes the verified digests of the file or directory |path|.
+  void RemoveVerifiedDigests(const CString& path) const;
+
+  // Makes the cached |source_file| available as |destination_file|, which is
+  // replaced if it exists. Hard links and clones take constant time and no
+  // extra disk space. They are attempted first and a copy of the file is made
+  // only if both fail. A hard link shares the file with the cache: if the
+  // linked file is written to, the cache detects the change the next time the
+  // file is verified.
+  static HRESULT Materialize(const CString& source_file,
+                             const CString& destination_file,
+                             MaterializationStrategy* strategy);
+
   // The cache duration, specified as a count of days.  (This is converted to
   // an absolute time by GetCacheExpirationTime().)
   int cache_time_limit_days_;
@@ -128,6 +176,10 @@ class PackageCache {
 
   CString cache_root_;
 
+  // The files in the cache whose hash has been verified. It is updated by
+  // lookups too, therefore it is mutable.
+  mutable internal::VerifiedDigestIndex digest_index_;
+
   LLock cache_lock_;
 
   DISALLOW_COPY_AND_ASSIGN(PackageCache);
@@ -18,6 +18,7 @@
 
 #include <windows.h>
 #include <atlstr.h>
+#include <map>
 #include <vector>
 #include "base/basictypes.h"
 #include "base/synchronized.h"
@@ -77,6 +78,92 @@ HRESULT FindDirectoryPackagesInfo(const CString& dir_path,
 
 void SortPackageInfoByTime(std::vector<PackageInfo>* packages_info);
 
+// Identifies a file and its contents without reading the file. The identity
+// changes when the file is written to or replaced by another file.
+struct FileIdentity {
+  FileIdentity()
+      : file_size(0),
+        last_write_time(0),
+        volume_serial_number(0),
+        file_index(0) {}
+
+  bool operator==(const FileIdentity& other) const {
+    return file_size == other.file_size &&
+           last_write_time == other.last_write_time &&
+           volume_serial_number == other.volume_serial_number &&
+           file_index == other.file_index;
+  }
+
+  uint64 file_size;
+  uint64 last_write_time;
+  uint32 volume_serial_number;
+  uint64 file_index;
+};
+
+HRESULT GetFileIdentity(const CString& file_name, FileIdentity* identity);
+
+// Creates |link_file| as a hard link to |existing_file|. Both files must be on
+// the same volume.
+HRESULT CreateHardLinkToFile(const CString& existing_file,
+                             const CString& link_file);
+
+// Copies |source_file| to |destination_file| and computes the SHA-256 digest
+// of the bytes written to |destination_file|.
+HRESULT CopyFileAndComputeDigest(const CString& source_file,
+                                 const CString& destination_file,
+                                 std::vector<uint8>* digest);
+
+// Creates |destination_file| as a copy-on-write clone of |source_file|, if the
+// file system supports block cloning, such as ReFS. Both files must be on the
+// same volume. No data is copied until one of the files is written to.
+HRESULT CloneFile(const CString& source_file, const CString& destination_file);
+
+// Records the files in the package cache whose SHA-256 hash has been verified,
+// along with the identity the files had when they were verified. As long as
+// the identity of a file does not change, the file does not have to be read
+// again to verify its hash. The index is persisted as a UTF-8 text file.
+class VerifiedDigestIndex {
+ public:
+  VerifiedDigestIndex() {}
+
+  // Loads the index from |index_file|, which is also where Save writes the
+  // index to. The index is empty if the file does not exist or if it can't be
+  // parsed. Malformed entries are ignored.
+  void Load(const CString& index_file);
+
+  HRESULT Save() const;
+
+  // Returns true if the file has been verified against |hash| and it has not
+  // changed since.
+  bool IsVerified(const CString& file_name,
+                  const FileIdentity& identity,
+                  const CString& hash) const;
+
+  void Add(const CString& file_name,
+           const FileIdentity& identity,
+           const CString& hash);
+
+  // Removes the entry of the file |path| or the entries of all files under the
+  // directory |path|.
+  void Remove(const CString& path);
+
+  size_t size() const { return entries_.size(); }
+
+ private:
+  struct Entry {
+    FileIdentity identity;
+    CString hash;
+  };
+
+  // The entries are keyed by the lower case file name.
+  typedef std::map<CString, Entry> EntryMap;
+
+  CString index_file_;
+  EntryMap entries_;
+
+  DISALLOW_COPY_AND_ASSIGN(VerifiedDigestIndex);
+};
+
 }  // namespace internal
 
 }  // namespace omaha
@@ -13,14 +13,21 @@
 // limitations under the License.
 // ========================================================================
 
+#include <iostream>
+#include <string>
+#include <vector>
+
 #include "omaha/base/app_util.h"
 #include "omaha/base/error.h"
 #include "omaha/base/file.h"
+#include "omaha/base/highres_timer-win32.h"
 #include "omaha/base/path.h"
 #include "omaha/base/safe_format.h"
+#include "omaha/base/signatures.h"
 #include "omaha/base/string.h"
 #include "omaha/base/utils.h"
 #include "omaha/goopdate/package_cache.h"
+#include "omaha/goopdate/worker_metrics.h"
 #include "omaha/testing/unit_test.h"
 
 namespace omaha {
@@ -108,6 +115,21 @@ class PackageCacheTest : public testing::TestWithParam<bool> {
     package_cache_.cache_time_limit_days_ = limit_days;
   }
 
+  size_t NumVerifiedDigests() const {
+    return package_cache_.digest_index_.size();
+  }
+
+  void ClearVerifiedDigests() {
+    package_cache_.digest_index_.Remove(package_cache_.cache_root_);
+  }
+
+  static HRESULT Materialize(
+      const CString& source_file,
+      const CString& destination_file,
+      PackageCache::MaterializationStrategy* strategy) {
+    return PackageCache::Materialize(source_file, destination_file, strategy);
+  }
+
   const CString cache_root_;
   CString source_file1_;
   CString hash_file1_;
@@ -246,6 +268,89 @@ TEST_F(PackageCacheTest, PutBadHashTest) {
   EXPECT_FALSE(package_cache_.IsCached(key1, hash_file1_));
 }
 
+// Caches a file whose digest is known, as if the digest had been computed
+// while the file was downloaded.
+TEST_F(PackageCacheTest, PutWithDigestTest) {
+  Key key1(_T("app1"), _T("ver1"), _T("package1"));
+
+  std::vector<CString> files;
+  files.push_back(source_file1_);
+  std::vector<byte> digest;
+  CryptoHash crypto;
+  EXPECT_SUCCEEDED(crypto.Compute(files, 0, &digest));
+
+  EXPECT_SUCCEEDED(package_cache_.Put(key1, source_file1_, hash_file1_,
+                                      digest));
+  EXPECT_TRUE(package_cache_.IsCached(key1, hash_file1_));
+
+  // The digest does not match the expected hash, therefore the file is not
+  // copied to the cache.
+  Key key2(_T("app2"), _T("ver2"), _T("package2"));
+  EXPECT_EQ(SIGS_E_INVALID_SIGNATURE,
+            package_cache_.Put(key2, source_file1_, hash_file2_, digest));
+  EXPECT_FALSE(package_cache_.IsCached(key2, hash_file1_));
+
+  CString cached_file;
+  EXPECT_SUCCEEDED(BuildCacheFileNameForKey(key2, &cached_file));
+  EXPECT_FALSE(File::Exists(cached_file));
+}
+
+// The source file has changed since its digest was computed, as if it had
+// been replaced after it was downloaded. The digest of the cached file is
+// verified, therefore the file is not cached.
+TEST_F(PackageCacheTest, PutWithDigestSourceChangedTest) {
+  Key key1(_T("app1"), _T("ver1"), _T("package1"));
+
+  std::vector<CString> files;
+  files.push_back(source_file1_);
+  std::vector<byte> digest;
+  CryptoHash crypto;
+  EXPECT_SUCCEEDED(crypto.Compute(files, 0, &digest));
+
+  EXPECT_EQ(SIGS_E_INVALID_SIGNATURE,
+            package_cache_.Put(key1, source_file2_, hash_file1_, digest));
+  EXPECT_FALSE(package_cache_.IsCached(key1, hash_file1_));
+
+  CString cached_file;
+  EXPECT_SUCCEEDED(BuildCacheFileNameForKey(key1, &cached_file));
+  EXPECT_FALSE(File::Exists(cached_file));
+}
+
+TEST_F(PackageCacheTest, FindPackageByHash) {
+  Key key1(_T("app1"), _T("ver1"), _T("package1"));
+  Key key2(_T("app1"), _T("ver1"), _T("package2"));
+  EXPECT_SUCCEEDED(package_cache_.Put(key1, source_file1_, hash_file1_));
+  EXPECT_SUCCEEDED(package_cache_.Put(key2, source_file2_, hash_file2_));
+
+  CString package_name;
+  EXPECT_SUCCEEDED(package_cache_.FindPackageByHash(
+      _T("app1"), _T("ver1"), hash_file2_, &package_name));
+  EXPECT_STREQ(_T("package2"), package_name);
+
+  EXPECT_SUCCEEDED(package_cache_.FindPackageByHash(
+      _T("app1"), _T("ver1"), hash_file1_, &package_name));
+  EXPECT_STREQ(_T("package1"), package_name);
+
+  // Verifying the packages which do not match does not remove their
+  // verified digests.
+  const size_t num_verified_digests = NumVerifiedDigests();
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND),
+            package_cache_.FindPackageByHash(
+                _T("app1"), _T("ver1"), kFile2Sha256Hash + CString(_T("0")),
+                &package_name));
+  EXPECT_EQ(num_verified_digests, NumVerifiedDigests());
+
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND),
+            package_cache_.FindPackageByHash(
+                _T("app1"), _T("ver2"), hash_file1_, &package_name));
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND),
+            package_cache_.FindPackageByHash(
+                _T("app2"), _T("ver1"), hash_file1_, &package_name));
+  EXPECT_EQ(E_INVALIDARG,
+            package_cache_.FindPackageByHash(
+                _T(""), _T("ver1"), hash_file1_, &package_name));
+}
+
 // The key must include the app id, version, and package name for Put and Get
 // operations. If the version is not provided, "0.0.0.0" is used internally.
 TEST_F(PackageCacheTest, BadKeyTest) {
@@ -521,5 +626,182 @@ TEST_F(PackageCacheTest, VerifyHash) {
             PackageCache::VerifyHash(source_file1_, hash_file2_));
 }
 
-}  // namespace omaha
+TEST_F(PackageCacheTest, VerifiedDigestIndex) {
+  Key key1(_T("app1"), _T("ver1"), _T("package1"));
+  Key key2(_T("app2"), _T("ver2"), _T("package2"));
+
+  EXPECT_EQ(0, NumVerifiedDigests());
+  EXPECT_SUCCEEDED(package_cache_.Put(key1, source_file1_, hash_file1_));
+  EXPECT_SUCCEEDED(package_cache_.Put(key2, source_file2_, hash_file2_));
+  EXPECT_EQ(2, NumVerifiedDigests());
+
+  // A cache initialized from the same root shares the verified digests.
+  PackageCache package_cache;
+  EXPECT_SUCCEEDED(package_cache.Initialize(cache_root_));
+  EXPECT_TRUE(package_cache.IsCached(key1, hash_file1_));
+  EXPECT_FALSE(package_cache.IsCached(key1, hash_file2_));
 
+  // The index does not count towards the size of the cache.
+  EXPECT_EQ(size_file1_ + size_file2_, package_cache_.Size());
+
+  // Replacing a cached file invalidates its verified digest.
+  CString cached_file1;
+  EXPECT_SUCCEEDED(BuildCacheFileNameForKey(key1, &cached_file1));
+  EXPECT_SUCCEEDED(File::Copy(source_file2_, cached_file1, true));
+  EXPECT_FALSE(package_cache_.IsCached(key1, hash_file1_));
+  EXPECT_EQ(1, NumVerifiedDigests());
+
+  // Purging removes the verified digests of the purged files.
+  EXPECT_SUCCEEDED(package_cache_.Purge(key2));
+  EXPECT_EQ(0, NumVerifiedDigests());
+}
+
+// The destination file is in the temporary directory, which is on the same
+// volume as the cache, therefore Get creates a hard link.
+TEST_F(PackageCacheTest, Get_HardLink) {
+  Key key1(_T("app1"), _T("ver1"), _T("package1"));
+  EXPECT_SUCCEEDED(package_cache_.Put(key1, source_file1_, hash_file1_));
+
+  CString cached_file;
+  EXPECT_SUCCEEDED(BuildCacheFileNameForKey(key1, &cached_file));
+
+  const CString destination_file = GetTempFilename(_T("ut_"));
+  EXPECT_FALSE(destination_file.IsEmpty());
+
+  const int hard_link_count = metric_worker_package_cache_get_hard_link.value();
+  EXPECT_SUCCEEDED(package_cache_.Get(key1, destination_file, hash_file1_));
+  EXPECT_EQ(hard_link_count + 1,
+            metric_worker_package_cache_get_hard_link.value());
+
+  internal::FileIdentity cached_identity;
+  internal::FileIdentity destination_identity;
+  EXPECT_SUCCEEDED(internal::GetFileIdentity(cached_file, &cached_identity));
+  EXPECT_SUCCEEDED(internal::GetFileIdentity(destination_file,
+                                             &destination_identity));
+  EXPECT_TRUE(cached_identity == destination_identity);
+
+  // Deleting the destination file does not affect the cache.
+  EXPECT_TRUE(::DeleteFile(destination_file));
+  EXPECT_TRUE(package_cache_.IsCached(key1, hash_file1_));
+}
+
+TEST_F(PackageCacheTest, Materialize) {
+  const CString destination_file = GetTempFilename(_T("ut_"));
+  EXPECT_FALSE(destination_file.IsEmpty());
+
+  // The destination file is replaced if it exists.
+  EXPECT_SUCCEEDED(File::Copy(source_file2_, destination_file, true));
+
+  PackageCache::MaterializationStrategy strategy =
+      PackageCache::MATERIALIZE_NONE;
+  EXPECT_SUCCEEDED(Materialize(source_file1_, destination_file, &strategy));
+  EXPECT_NE(PackageCache::MATERIALIZE_NONE, strategy);
+  EXPECT_SUCCEEDED(PackageCache::VerifyHash(destination_file, hash_file1_));
+
+  EXPECT_TRUE(::DeleteFile(destination_file));
+}
+
+TEST(VerifiedDigestIndexTest, SaveAndLoad) {
+  const CString index_file(GetTempFilename(_T("idx")));
+  ASSERT_FALSE(index_file.IsEmpty());
+
+  internal::FileIdentity identity;
+  identity.file_size = 870400;
+  identity.last_write_time = 0x01d5a3b3c4d5e6f7;
+  identity.volume_serial_number = 0xfeedf00d;
+  identity.file_index = 0x0001000000001234;
+
+  internal::VerifiedDigestIndex index;
+  index.Load(index_file);
+  EXPECT_EQ(0, index.size());
+
+  index.Add(_T("C:\\Cache\\App1\\1.0\\Package1"), identity, kFile1Sha256Hash);
+  index.Add(_T("C:\\Cache\\App1\\2.0\\Package1"), identity, kFile2Sha256Hash);
+  index.Add(_T("C:\\Cache\\App10\\1.0\\Package1"), identity, kFile2Sha256Hash);
+  EXPECT_SUCCEEDED(index.Save());
+
+  internal::VerifiedDigestIndex loaded_index;
+  loaded_index.Load(index_file);
+  EXPECT_EQ(3, loaded_index.size());
+  EXPECT_TRUE(loaded_index.IsVerified(
+      _T("c:\\cache\\app1\\1.0\\package1"), identity, kFile1Sha256Hash));
+  EXPECT_FALSE(loaded_index.IsVerified(
+      _T("C:\\Cache\\App1\\1.0\\Package1"), identity, kFile2Sha256Hash));
+
+  internal::FileIdentity changed_identity(identity);
+  ++changed_identity.last_write_time;
+  EXPECT_FALSE(loaded_index.IsVerified(
+      _T("C:\\Cache\\App1\\1.0\\Package1"), changed_identity,
+      kFile1Sha256Hash));
+
+  // Removing a directory only removes the entries in that directory.
+  loaded_index.Remove(_T("C:\\Cache\\App1"));
+  EXPECT_EQ(1, loaded_index.size());
+  EXPECT_TRUE(loaded_index.IsVerified(
+      _T("C:\\Cache\\App10\\1.0\\Package1"), identity, kFile2Sha256Hash));
+
+  // Malformed index files are ignored.
+  std::vector<byte> garbage(16, 'x');
+  EXPECT_SUCCEEDED(WriteEntireFile(index_file, garbage));
+  loaded_index.Load(index_file);
+  EXPECT_EQ(0, loaded_index.size());
+
+  EXPECT_SUCCEEDED(File::Remove(index_file));
+}
+
+// Compares the latency of IsCached when the hash of a 500MB package is
+// verified by reading the package with the latency when the verified digest
+// index is used. The test writes a 500MB file, therefore it only runs when
+// the disabled tests run.
+TEST_F(PackageCacheTest, DISABLED_IsCachedLatency) {
+  const size_t kChunkSize = 1024 * 1024;
+  const int kNumChunks = 500;
+
+  const CString source_file(GetTempFilename(_T("pkg")));
+  ASSERT_FALSE(source_file.IsEmpty());
+
+  // Writes the package and computes its hash.
+  StreamingHash hash;
+  std::vector<byte> chunk(kChunkSize);
+  {
+    File file;
+    ASSERT_SUCCEEDED(file.Open(source_file, true, false));
+    for (int i = 0; i != kNumChunks; ++i) {
+      for (size_t j = 0; j != chunk.size(); ++j) {
+        chunk[j] = static_cast<byte>(i + j);
+      }
+      uint32 bytes_written = 0;
+      ASSERT_SUCCEEDED(file.Write(&chunk.front(),
+                                  static_cast<uint32>(chunk.size()),
+                                  &bytes_written));
+      hash.Update(&chunk.front(), chunk.size());
+    }
+    EXPECT_SUCCEEDED(file.Close());
+  }
+
+  std::vector<byte> digest;
+  hash.Finalize(&digest);
+  std::string hex_digest;
+  b2a_hex(&digest.front(), &hex_digest, digest.size());
+  const CString expected_hash(hex_digest.c_str());
+
+  Key key(_T("app1"), _T("ver1"), _T("package1"));
+  EXPECT_SUCCEEDED(package_cache_.Put(key, source_file, expected_hash, digest));
+
+  ClearVerifiedDigests();
+  HighresTimer cold_timer;
+  EXPECT_TRUE(package_cache_.IsCached(key, expected_hash));
+  const ULONGLONG cold_ms = cold_timer.GetElapsedMs();
+
+  HighresTimer warm_timer;
+  EXPECT_TRUE(package_cache_.IsCached(key, expected_hash));
+  const ULONGLONG warm_ms = warm_timer.GetElapsedMs();
+
+  std::wcout << _T("IsCached latency for a 500MB package: cold ") << cold_ms
+             << _T(" ms, warm ") << warm_ms << _T(" ms.") << std::endl;
+  EXPECT_LT(warm_ms, cold_ms);
+
+  EXPECT_SUCCEEDED(File::Remove(source_file));
+}
+
+}  // namespace omaha
@@ -16,8 +16,8 @@
 #include "omaha/goopdate/ping_event_cancel.h"
 #include "omaha/base/safe_format.h"
 #include "omaha/base/string.h"
-#include "omaha/base/xml_utils.h"
 #include "omaha/common/xml_const.h"
+#include "omaha/common/xml_writer.h"
 
 namespace omaha {
 
@@ -36,49 +36,21 @@ PingEventCancel::PingEventCancel(Types type,
       time_since_download_start_ms_(time_since_download_start_ms) {
 }
 
-HRESULT PingEventCancel::ToXml(IXMLDOMNode* parent_node) const {
-  HRESULT hr = PingEvent::ToXml(parent_node);
-  if (FAILED(hr)) {
-    return hr;
-  }
+void PingEventCancel::ToXml(xml::XmlWriter* writer) const {
+  PingEvent::ToXml(writer);
 
-  hr = AddXMLAttributeNode(parent_node,
-                           xml::kXmlNamespace,
-                           xml::attribute::kIsBundled,
-                           itostr(is_bundled_));
-  if (FAILED(hr)) {
-    return hr;
-  }
-
-  hr = AddXMLAttributeNode(parent_node,
-                           xml::kXmlNamespace,
-                           xml::attribute::kStateCancelled,
-                           itostr(state_when_cancelled_));
-  if (FAILED(hr)) {
-    return hr;
-  }
+  writer->AddAttribute(xml::attribute::kIsBundled, is_bundled_);
+  writer->AddAttribute(xml::attribute::kStateCancelled, state_when_cancelled_);
 
   if (time_since_update_available_ms_ >= 0) {
-    hr = AddXMLAttributeNode(parent_node,
-                             xml::kXmlNamespace,
-                             xml::attribute::kTimeSinceUpdateAvailable,
-                             itostr(time_since_update_available_ms_));
-    if (FAILED(hr)) {
-      return hr;
-    }
+    writer->AddAttribute(xml::attribute::kTimeSinceUpdateAvailable,
+                         time_since_update_available_ms_);
   }
 
   if (time_since_download_start_ms_ >= 0) {
-    hr = AddXMLAttributeNode(parent_node,
-                             xml::kXmlNamespace,
-                             xml::attribute::kTimeSinceDownloadStart,
-                             itostr(time_since_download_start_ms_));
-    if (FAILED(hr)) {
-      return hr;
-    }
+    writer->AddAttribute(xml::attribute::kTimeSinceDownloadStart,
+                         time_since_download_start_ms_);
   }
-
-  return S_OK;
 }
 
 CString PingEventCancel::ToString() const {
@@ -35,7 +35,7 @@ class PingEventCancel : public PingEvent {
                   int time_since_download_start_ms);
   virtual ~PingEventCancel() {}
 
-  virtual HRESULT ToXml(IXMLDOMNode* parent_node) const;
+  virtual void ToXml(xml::XmlWriter* writer) const;
   virtual CString ToString() const;
 
  private:
@@ -0,0 +1,102 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+
+#include "omaha/goopdate/progress_notifier.h"
+
+#include "omaha/base/const_object_names.h"
+#include "omaha/base/debug.h"
+#include "omaha/base/logging.h"
+#include "omaha/base/utils.h"
+#include "omaha/goopdate/worker_metrics.h"
+
+namespace omaha {
+
+ProgressNotifier::ProgressNotifier(bool is_machine, const CString& session_id)
+    : is_machine_(is_machine),
+      session_id_(session_id),
+      has_tried_open_event_(false),
+      last_open_event_ms_(0),
+      has_notified_(false),
+      last_notification_ms_(0) {
+  ASSERT1(!session_id.IsEmpty());
+}
+
+ProgressNotifier::~ProgressNotifier() {
+}
+
+CString ProgressNotifier::GetEventName(const CString& session_id) {
+  ASSERT1(!session_id.IsEmpty());
+  return kBundleProgressEventPrefix + session_id;
+}
+
+void ProgressNotifier::NotifyStateChange() {
+  Notify(::GetTickCount());
+}
+
+void ProgressNotifier::NotifyProgress() {
+  // The tick count differences are correct when the tick count wraps around.
+  const DWORD now_ms = ::GetTickCount();
+  if (has_notified_ &&
+      now_ms - last_notification_ms_ < kMinProgressIntervalMs) {
+    ++metric_worker_progress_notifications_suppressed;
+    return;
+  }
+
+  Notify(now_ms);
+}
+
+void ProgressNotifier::Notify(DWORD now_ms) {
+  if (!OpenClientEvent(now_ms)) {
+    return;
+  }
+
+  if (!::SetEvent(get(client_event_))) {
+    CORE_LOG(LW, (_T("[ProgressNotifier][SetEvent failed][%u]"),
+                  ::GetLastError()));
+    return;
+  }
+
+  has_notified_ = true;
+  last_notification_ms_ = now_ms;
+  ++metric_worker_progress_notifications_sent;
+}
+
+bool ProgressNotifier::OpenClientEvent(DWORD now_ms) {
+  if (valid(client_event_)) {
+    return true;
+  }
+
+  if (has_tried_open_event_ &&
+      now_ms - last_open_event_ms_ < kOpenEventRetryIntervalMs) {
+    return false;
+  }
+  has_tried_open_event_ = true;
+  last_open_event_ms_ = now_ms;
+
+  NamedObjectAttributes attr;
+  GetNamedObjectAttributes(GetEventName(session_id_), is_machine_, &attr);
+  reset(client_event_, ::OpenEvent(EVENT_MODIFY_STATE, false, attr.name));
+  if (!client_event_) {
+    CORE_LOG(L3, (_T("[ProgressNotifier][no client event][%s][%u]"),
+                  attr.name, ::GetLastError()));
+    return false;
+  }
+
+  CORE_LOG(L3, (_T("[ProgressNotifier][opened client event][%s]"), attr.name));
+  return true;
+}
+
+}  // namespace omaha
@@ -0,0 +1,87 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+//
+// Notifies the client processing a bundle that the state of its apps has
+// changed, so that the client does not have to poll the state of every app
+// over COM.
+//
+// The client creates a named auto-reset event, whose name is derived from the
+// session id of the bundle, before it starts processing the bundle. The
+// notifier sets the event when an app changes state or makes progress. The
+// event is a doorbell: the changes which happen before the client handles a
+// notification are coalesced, and the client reads the state of the apps once
+// for all of them. Progress notifications are also rate limited. Clients which
+// do not create the event are not notified and keep polling.
+
+#ifndef OMAHA_GOOPDATE_PROGRESS_NOTIFIER_H_
+#define OMAHA_GOOPDATE_PROGRESS_NOTIFIER_H_
+
+#include <windows.h>
+#include <atlstr.h>
+#include "base/basictypes.h"
+#include "omaha/third_party/smartany/scoped_any.h"
+
+namespace omaha {
+
+// Calls to the notifier must be serialized by the caller. The AppBundle calls
+// it with the model lock held.
+class ProgressNotifier {
+ public:
+  // Minimum time between two progress notifications. The state changes are
+  // always notified.
+  static const DWORD kMinProgressIntervalMs = 250;
+
+  // Minimum time between two attempts to open the event of the client.
+  static const DWORD kOpenEventRetryIntervalMs = 1000;
+
+  ProgressNotifier(bool is_machine, const CString& session_id);
+  ~ProgressNotifier();
+
+  // Notifies the client that an app has changed state.
+  void NotifyStateChange();
+
+  // Notifies the client that an app has made progress, unless the client has
+  // been notified less than kMinProgressIntervalMs ago. The progress which is
+  // not notified is read by the client at the next notification.
+  void NotifyProgress();
+
+  // Returns the name of the event for the bundle with |session_id|, without
+  // the decoration added by GetNamedObjectAttributes.
+  static CString GetEventName(const CString& session_id);
+
+ private:
+  void Notify(DWORD now_ms);
+
+  // Opens the event of the client if it is not already open. The event is not
+  // opened again until kOpenEventRetryIntervalMs after a failed attempt.
+  bool OpenClientEvent(DWORD now_ms);
+
+  const bool is_machine_;
+  const CString session_id_;
+
+  scoped_event client_event_;
+  bool has_tried_open_event_;
+  DWORD last_open_event_ms_;
+
+  bool has_notified_;
+  DWORD last_notification_ms_;
+
+  DISALLOW_COPY_AND_ASSIGN(ProgressNotifier);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_GOOPDATE_PROGRESS_NOTIFIER_H_
@@ -0,0 +1,238 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+
+#include <winhttp.h>
+#include <iostream>
+#include "omaha/base/highres_timer-win32.h"
+#include "omaha/base/utils.h"
+#include "omaha/goopdate/app_bundle_state_init.h"
+#include "omaha/goopdate/app_state_download_complete.h"
+#include "omaha/goopdate/app_state_downloading.h"
+#include "omaha/goopdate/app_unittest_base.h"
+#include "omaha/goopdate/progress_notifier.h"
+#include "omaha/goopdate/worker_metrics.h"
+#include "omaha/testing/unit_test.h"
+
+namespace omaha {
+
+namespace {
+
+const TCHAR* const kSessionId = _T("{7A9CE5C2-4B0E-4DE9-8C54-21A2B8A3E9B6}");
+const TCHAR* const kAppId = _T("{3BBA5C73-A1D5-4C1D-8C8B-3D5F8D8C0E41}");
+
+// Creates the event the client listens to, the same way the client does.
+HANDLE CreateClientEvent(bool is_machine, const CString& session_id) {
+  NamedObjectAttributes attr;
+  GetNamedObjectAttributes(ProgressNotifier::GetEventName(session_id),
+                           is_machine,
+                           &attr);
+  return ::CreateEvent(&attr.sa, false, false, attr.name);
+}
+
+bool IsSignaled(HANDLE event) {
+  return ::WaitForSingleObject(event, 0) == WAIT_OBJECT_0;
+}
+
+}  // namespace
+
+TEST(ProgressNotifierTest, NoClient) {
+  ProgressNotifier notifier(false, kSessionId);
+  notifier.NotifyStateChange();
+  notifier.NotifyProgress();
+
+  // The client created after the first attempt to open its event is only
+  // notified once the retry interval has elapsed.
+  scoped_event client_event(CreateClientEvent(false, kSessionId));
+  ASSERT_TRUE(client_event);
+  notifier.NotifyStateChange();
+  EXPECT_FALSE(IsSignaled(get(client_event)));
+
+  ::Sleep(ProgressNotifier::kOpenEventRetryIntervalMs + 100);
+  notifier.NotifyStateChange();
+  EXPECT_TRUE(IsSignaled(get(client_event)));
+}
+
+// The notifications the client has not handled yet are coalesced.
+TEST(ProgressNotifierTest, StateChanges) {
+  scoped_event client_event(CreateClientEvent(false, kSessionId));
+  ASSERT_TRUE(client_event);
+
+  ProgressNotifier notifier(false, kSessionId);
+  notifier.NotifyStateChange();
+  notifier.NotifyStateChange();
+  EXPECT_TRUE(IsSignaled(get(client_event)));
+  EXPECT_FALSE(IsSignaled(get(client_event)));
+
+  notifier.NotifyStateChange();
+  EXPECT_TRUE(IsSignaled(get(client_event)));
+}
+
+TEST(ProgressNotifierTest, ProgressIsRateLimited) {
+  scoped_event client_event(CreateClientEvent(false, kSessionId));
+  ASSERT_TRUE(client_event);
+
+  const int suppressed_count =
+      metric_worker_progress_notifications_suppressed.value();
+
+  ProgressNotifier notifier(false, kSessionId);
+  notifier.NotifyProgress();
+  EXPECT_TRUE(IsSignaled(get(client_event)));
+
+  notifier.NotifyProgress();
+  EXPECT_FALSE(IsSignaled(get(client_event)));
+  EXPECT_EQ(suppressed_count + 1,
+            metric_worker_progress_notifications_suppressed.value());
+
+  // The state changes are not rate limited.
+  notifier.NotifyStateChange();
+  EXPECT_TRUE(IsSignaled(get(client_event)));
+
+  ::Sleep(ProgressNotifier::kMinProgressIntervalMs + 50);
+  notifier.NotifyProgress();
+  EXPECT_TRUE(IsSignaled(get(client_event)));
+}
+
+namespace {
+
+// A client reading the state of an app, either every kPollingPeriodMs or when
+// the server notifies it. Each read takes the model lock once.
+struct Client {
+  static const DWORD kPollingPeriodMs = 100;
+  static const DWORD kFallbackPollingPeriodMs = 1000;
+
+  Client() : app(NULL), progress_event(NULL), stop(NULL), num_reads(0) {}
+
+  App* app;
+  HANDLE progress_event;  // NULL if the client polls.
+  volatile LONG* stop;
+  int num_reads;
+};
+
+DWORD WINAPI RunClient(void* param) {
+  Client* client = static_cast<Client*>(param);
+
+  while (!::InterlockedCompareExchange(client->stop, 0, 0)) {
+    if (client->progress_event) {
+      ::WaitForSingleObject(client->progress_event,
+                            Client::kFallbackPollingPeriodMs);
+    } else {
+      ::Sleep(Client::kPollingPeriodMs);
+    }
+
+    CComPtr<IDispatch> current_state;
+    EXPECT_SUCCEEDED(client->app->get_currentState(&current_state));
+    ++client->num_reads;
+  }
+
+  return 0;
+}
+
+}  // namespace
+
+class ProgressNotifierAppTest : public AppTestBaseWithRegistryOverride {
+ protected:
+  ProgressNotifierAppTest()
+      : AppTestBaseWithRegistryOverride(false, false),
+        app_(NULL) {}
+
+  // The session id can only be set before the bundle is initialized.
+  virtual void SetUp() {
+    AppTestBaseWithRegistryOverride::SetUp();
+
+    SetAppBundleStateForUnitTest(app_bundle_.get(),
+                                 new fsm::AppBundleStateInit);
+    EXPECT_SUCCEEDED(app_bundle_->put_sessionId(CComBSTR(kSessionId)));
+    SetAppBundleStateForUnitTest(app_bundle_.get(),
+                                 new fsm::AppBundleStateInitialized);
+
+    EXPECT_SUCCEEDED(app_bundle_->createApp(CComBSTR(kAppId), &app_));
+    ASSERT_TRUE(app_);
+  }
+
+  App* app_;
+};
+
+// Simulates the download of a package while a polling client and a notified
+// client read the state of the app, and reports how many times per second
+// each of them reads it.
+TEST_F(ProgressNotifierAppTest, NotifiedClientReadsLessOften) {
+  const uint64 kPackageSize = 1000000;
+  const int kNumProgressUpdates = 200;
+  const DWORD kProgressUpdatePeriodMs = 10;
+
+  scoped_event client_event(CreateClientEvent(false, kSessionId));
+  ASSERT_TRUE(client_event);
+
+  Package* package = NULL;
+  __mutexBlock(model_->lock()) {
+    AppVersion* app_version = app_->next_version();
+    ASSERT_SUCCEEDED(app_version->AddPackage(_T("package.exe"),
+                                             kPackageSize,
+                                             _T("hash")));
+    package = app_version->GetPackage(0);
+  }
+  ASSERT_TRUE(package);
+
+  volatile LONG stop = 0;
+  Client polling_client;
+  polling_client.app = app_;
+  polling_client.stop = &stop;
+  Client notified_client;
+  notified_client.app = app_;
+  notified_client.progress_event = get(client_event);
+  notified_client.stop = &stop;
+
+  HighresTimer timer;
+  scoped_handle polling_thread(
+      ::CreateThread(NULL, 0, &RunClient, &polling_client, 0, NULL));
+  ASSERT_TRUE(polling_thread);
+  scoped_handle notified_thread(
+      ::CreateThread(NULL, 0, &RunClient, &notified_client, 0, NULL));
+  ASSERT_TRUE(notified_thread);
+
+  __mutexBlock(model_->lock()) {
+    SetAppStateForUnitTest(app_, new fsm::AppStateDownloading);
+  }
+  for (int i = 1; i <= kNumProgressUpdates; ++i) {
+    package->OnProgress(kPackageSize * i / kNumProgressUpdates,
+                        kPackageSize,
+                        WINHTTP_CALLBACK_STATUS_READ_COMPLETE,
+                        NULL);
+    ::Sleep(kProgressUpdatePeriodMs);
+  }
+  __mutexBlock(model_->lock()) {
+    SetAppStateForUnitTest(app_, new fsm::AppStateDownloadComplete);
+  }
+  ::Sleep(Client::kPollingPeriodMs);
+
+  ::InterlockedExchange(&stop, 1);
+  VERIFY1(::SetEvent(get(client_event)));
+  EXPECT_EQ(WAIT_OBJECT_0,
+            ::WaitForSingleObject(get(polling_thread), INFINITE));
+  EXPECT_EQ(WAIT_OBJECT_0,
+            ::WaitForSingleObject(get(notified_thread), INFINITE));
+
+  const double elapsed_s = timer.GetElapsedMs() / 1000.0;
+  std::cout << "Model lock acquisitions per second: polling "
+            << polling_client.num_reads / elapsed_s << ", notified "
+            << notified_client.num_reads / elapsed_s << std::endl;
+
+  // The notified client reads the state at least once per state change.
+  EXPECT_GE(notified_client.num_reads, 2);
+  EXPECT_LT(notified_client.num_reads, polling_client.num_reads);
+}
+
+}  // namespace omaha
@@ -0,0 +1,199 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/goopdate/update_check_coalescer.h"
+
+#include "omaha/base/debug.h"
+#include "omaha/base/error.h"
+#include "omaha/base/logging.h"
+#include "omaha/base/safe_format.h"
+#include "omaha/base/utils.h"
+#include "omaha/common/update_request.h"
+#include "omaha/common/update_response.h"
+#include "omaha/common/web_services_client.h"
+
+namespace omaha {
+
+namespace {
+
+// Returns the serialized request without the session and request ids, which
+// are unique to each bundle and each request. The install source is kept in
+// the request, so it is part of the key like |is_foreground|.
+HRESULT GetRequestKey(const xml::UpdateRequest& update_request,
+                      bool is_foreground,
+                      CString* key) {
+  ASSERT1(key);
+
+  CString request_buffer;
+  HRESULT hr = update_request.Serialize(&request_buffer);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  const xml::request::Request& request = update_request.request();
+  if (!request.session_id.IsEmpty()) {
+    request_buffer.Replace(request.session_id, _T(""));
+  }
+  if (!request.request_id.IsEmpty()) {
+    request_buffer.Replace(request.request_id, _T(""));
+  }
+
+  SafeCStringFormat(key, _T("%d|%s"), is_foreground, request_buffer);
+  return S_OK;
+}
+
+}  // namespace
+
+struct UpdateCheckCoalescer::Flight {
+  Flight() : is_complete(false), hr(E_PENDING), completion_time(0) {}
+
+  // Opened when the flight is complete. The members below do not change
+  // once the gate is open.
+  Gate complete;
+
+  bool is_complete;
+  HRESULT hr;
+  std::unique_ptr<xml::UpdateResponse> update_response;
+  DWORD completion_time;
+};
+
+UpdateCheckCoalescer::UpdateCheckCoalescer(int freshness_ms)
+    : freshness_ms_(freshness_ms) {
+  ASSERT1(freshness_ms_ >= 0);
+}
+
+UpdateCheckCoalescer::~UpdateCheckCoalescer() {
+  __mutexScope(lock_);
+  for (Flights::const_iterator it = flights_.begin();
+       it != flights_.end();
+       ++it) {
+    ASSERT1(it->second->is_complete);
+  }
+}
+
+HRESULT UpdateCheckCoalescer::Send(WebServicesClientInterface* client,
+                                   HANDLE cancel_event,
+                                   bool is_foreground,
+                                   const xml::UpdateRequest* update_request,
+                                   xml::UpdateResponse* update_response,
+                                   bool* is_shared) {
+  ASSERT1(client);
+  ASSERT1(cancel_event);
+  ASSERT1(update_request);
+  ASSERT1(update_response);
+  ASSERT1(is_shared);
+
+  *is_shared = false;
+
+  CString key;
+  HRESULT hr = GetRequestKey(*update_request, is_foreground, &key);
+  if (FAILED(hr)) {
+    CORE_LOG(LW, (_T("[GetRequestKey failed][0x%08x]"), hr));
+    return client->Send(is_foreground, update_request, update_response);
+  }
+
+  std::shared_ptr<Flight> flight;
+  bool is_leader = false;
+  __mutexBlock(lock_) {
+    RemoveExpiredFlights();
+
+    Flights::const_iterator it = flights_.find(key);
+    if (it != flights_.end()) {
+      flight = it->second;
+    } else {
+      flight = std::make_shared<Flight>();
+      flights_[key] = flight;
+      is_leader = true;
+    }
+  }
+
+  if (is_leader) {
+    hr = client->Send(is_foreground, update_request, update_response);
+    CompleteFlight(key, flight, hr, *update_response);
+    return hr;
+  }
+
+  CORE_LOG(L3, (_T("[UpdateCheckCoalescer::Send][waiting for shared request]")
+                _T("[%s]"), update_request->app_ids()));
+  const HANDLE handles[] = {flight->complete, cancel_event};
+  const DWORD result = ::WaitForMultipleObjects(arraysize(handles),
+                                                handles,
+                                                false,
+                                                INFINITE);
+  if (result == WAIT_OBJECT_0 + 1) {
+    CORE_LOG(L3, (_T("[UpdateCheckCoalescer::Send][cancelled]")));
+    *is_shared = true;
+    return GOOPDATE_E_CANCELLED;
+  }
+  ASSERT1(result == WAIT_OBJECT_0);
+
+  if (FAILED(flight->hr)) {
+    CORE_LOG(L3, (_T("[Shared request failed][0x%08x][sending own request]"),
+                  flight->hr));
+    return client->Send(is_foreground, update_request, update_response);
+  }
+
+  ASSERT1(flight->update_response);
+  update_response->CopyFrom(*flight->update_response);
+  *is_shared = true;
+  return S_OK;
+}
+
+void UpdateCheckCoalescer::CompleteFlight(
+    const CString& key,
+    std::shared_ptr<Flight> flight,
+    HRESULT hr,
+    const xml::UpdateResponse& update_response) {
+  ASSERT1(flight);
+
+  if (SUCCEEDED(hr)) {
+    flight->update_response.reset(xml::UpdateResponse::Create());
+    flight->update_response->CopyFrom(update_response);
+  }
+
+  __mutexBlock(lock_) {
+    flight->hr = hr;
+    flight->completion_time = ::GetTickCount();
+    flight->is_complete = true;
+
+    // The failed requests are not shared with the callers arriving from now
+    // on, and neither are the responses if they can't be reused.
+    if (FAILED(hr) || !freshness_ms_) {
+      Flights::iterator it = flights_.find(key);
+      if (it != flights_.end() && it->second == flight) {
+        flights_.erase(it);
+      }
+    }
+  }
+
+  VERIFY1(flight->complete.Open());
+}
+
+void UpdateCheckCoalescer::RemoveExpiredFlights() {
+  ASSERT1(lock_.GetOwner() == ::GetCurrentThreadId());
+
+  Flights::iterator it = flights_.begin();
+  while (it != flights_.end()) {
+    const Flight& flight = *it->second;
+    if (flight.is_complete &&
+        TimeHasElapsed(flight.completion_time, freshness_ms_)) {
+      it = flights_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+}  // namespace omaha
@@ -0,0 +1,106 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+//
+// Shares one update check among the bundles which check for updates of the
+// same apps at the same time, for instance two on-demand checks for the same
+// app started by different clients. The first bundle sends its
+// request and the bundles sending an identical request meanwhile wait for its
+// response. The response is also reused for a short time by the bundles which
+// send an identical request after it is received.
+//
+// Two requests are identical when they only differ by their session and
+// request ids. Their ping data being identical too, the server has already
+// counted the pings of a shared request. The install source of the request
+// and whether the check runs in the foreground are part of the comparison, so
+// the on-demand checks and the scheduled checks never share a request, and
+// the server sees the actual source of each check. Only the successful
+// responses are shared: when the shared request fails, each waiting bundle
+// sends its own request, since the failure may be specific to the sender, for
+// instance to its proxy credentials. The shared request is not cancelled when
+// a waiting bundle is stopped, only the wait of that bundle is.
+
+#ifndef OMAHA_GOOPDATE_UPDATE_CHECK_COALESCER_H_
+#define OMAHA_GOOPDATE_UPDATE_CHECK_COALESCER_H_
+
+#include <windows.h>
+#include <atlstr.h>
+#include <map>
+#include <memory>
+
+#include "base/basictypes.h"
+#include "omaha/base/synchronized.h"
+
+namespace omaha {
+
+namespace xml {
+
+class UpdateRequest;
+class UpdateResponse;
+
+}  // namespace xml
+
+class WebServicesClientInterface;
+
+class UpdateCheckCoalescer {
+ public:
+  // The responses are reused for |freshness_ms| after they are received. Zero
+  // means that only the requests in flight are shared.
+  explicit UpdateCheckCoalescer(int freshness_ms);
+  ~UpdateCheckCoalescer();
+
+  // Sends |update_request| with |client| and returns the response in
+  // |update_response|, or copies the response of an identical request, in
+  // which case |*is_shared| is true. This is a blocking call on the network.
+  // Waiting for an identical request stops when |cancel_event| is signaled,
+  // in which case GOOPDATE_E_CANCELLED is returned and |*is_shared| is true
+  // too, since no request was sent. The request sent with |client| is
+  // cancelled with the client.
+  HRESULT Send(WebServicesClientInterface* client,
+               HANDLE cancel_event,
+               bool is_foreground,
+               const xml::UpdateRequest* update_request,
+               xml::UpdateResponse* update_response,
+               bool* is_shared);
+
+ private:
+  struct Flight;
+  typedef std::map<CString, std::shared_ptr<Flight>> Flights;
+
+  // Records the result of |flight| and releases the callers waiting for it.
+  void CompleteFlight(const CString& key,
+                      std::shared_ptr<Flight> flight,
+                      HRESULT hr,
+                      const xml::UpdateResponse& update_response);
+
+  // Removes the flights whose responses can't be reused anymore. Must be
+  // called with |lock_| held.
+  void RemoveExpiredFlights();
+
+  const int freshness_ms_;
+
+  // Protects |flights_| and the completion state of the flights.
+  LLock lock_;
+
+  // The requests in flight and the requests received less than
+  // |freshness_ms_| ago, by request key.
+  Flights flights_;
+
+  DISALLOW_COPY_AND_ASSIGN(UpdateCheckCoalescer);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_GOOPDATE_UPDATE_CHECK_COALESCER_H_
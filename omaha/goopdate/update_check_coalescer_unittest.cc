@@ -0,0 +1,419 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/goopdate/update_check_coalescer.h"
+
+#include <memory>
+#include <vector>
+
+#include "omaha/base/error.h"
+#include "omaha/base/synchronized.h"
+#include "omaha/base/utils.h"
+#include "omaha/common/const_goopdate.h"
+#include "omaha/common/update_request.h"
+#include "omaha/common/update_response.h"
+#include "omaha/common/web_services_client.h"
+#include "omaha/testing/unit_test.h"
+#include "omaha/third_party/smartany/scoped_any.h"
+
+namespace omaha {
+
+using ::testing::_;
+using ::testing::Return;
+
+namespace {
+
+const TCHAR* const kAppId1 = _T("{104844D6-7DDA-460B-89F0-FBF8AFDD0A67}");
+const TCHAR* const kAppId2 = _T("{8A69D345-D564-463C-AFF1-A69D9E530F96}");
+
+const int kFreshnessMs = 60000;
+
+const HRESULT kSendError = HRESULT_FROM_WIN32(ERROR_TIMEOUT);
+
+// The elapsed days set in the responses to tell them apart.
+const int kElapsedDays = kMinDaysSinceDatum + 123;
+
+class MockWebServicesClient : public WebServicesClientInterface {
+ public:
+  MOCK_METHOD3(Send,
+      HRESULT(bool is_foreground,
+              const xml::UpdateRequest* update_request,
+              xml::UpdateResponse* update_response));
+  MOCK_METHOD3(SendString,
+      HRESULT(bool is_foreground,
+              const CString* request_string,
+              xml::UpdateResponse* update_response));
+  MOCK_METHOD0(Cancel,
+      void());
+  MOCK_METHOD1(set_proxy_auth_config,
+      void(const ProxyAuthConfig& config));
+  MOCK_CONST_METHOD0(is_http_success,
+      bool());
+  MOCK_CONST_METHOD0(http_status_code,
+      int());
+  MOCK_CONST_METHOD0(http_trace,
+      CString());
+  MOCK_CONST_METHOD0(http_used_ssl,
+      bool());
+  MOCK_CONST_METHOD0(http_ssl_result,
+      HRESULT());
+  MOCK_CONST_METHOD0(http_xdaystart_header_value,
+      int());
+  MOCK_CONST_METHOD0(http_xdaynum_header_value,
+      int());
+  MOCK_CONST_METHOD0(retry_after_sec,
+      int());
+};
+
+// Waits for |gate| to open, then returns a response with |elapsed_days|.
+ACTION_P2(SendResponse, gate, elapsed_days) {
+  UNREFERENCED_ACTION_PARAMETERS;
+  if (gate) {
+    EXPECT_TRUE(gate->Wait(INFINITE));
+  }
+
+  xml::response::Response response;
+  response.day_start.elapsed_days = elapsed_days;
+  SetResponseForUnitTest(arg2, response);
+  return S_OK;
+}
+
+// Waits for |gate| to open, then fails.
+ACTION_P(FailToSend, gate) {
+  UNREFERENCED_ACTION_PARAMETERS;
+  if (gate) {
+    EXPECT_TRUE(gate->Wait(INFINITE));
+  }
+  return kSendError;
+}
+
+// Each request has its own session and request ids, as the requests of
+// different bundles do.
+xml::UpdateRequest* CreateUpdateRequest(const TCHAR* app_id) {
+  CString session_id;
+  EXPECT_SUCCEEDED(GetGuid(&session_id));
+  xml::UpdateRequest* update_request = xml::UpdateRequest::Create(
+      false, session_id, _T("ondemand"), CString());
+
+  xml::request::App app;
+  app.app_id = app_id;
+  app.version = _T("1.2.3.4");
+  update_request->AddApp(app);
+  return update_request;
+}
+
+// The update check of one bundle.
+struct BundleUpdateCheck {
+  explicit BundleUpdateCheck(const TCHAR* app_id)
+      : coalescer(NULL),
+        update_request(CreateUpdateRequest(app_id)),
+        update_response(xml::UpdateResponse::Create()),
+        hr(E_PENDING),
+        is_shared(false) {
+    reset(cancel_event, ::CreateEvent(NULL, true, false, NULL));
+  }
+
+  HRESULT Send() {
+    return coalescer->Send(&client,
+                           get(cancel_event),
+                           true,
+                           update_request.get(),
+                           update_response.get(),
+                           &is_shared);
+  }
+
+  UpdateCheckCoalescer* coalescer;
+  MockWebServicesClient client;
+  scoped_event cancel_event;
+  std::unique_ptr<xml::UpdateRequest> update_request;
+  std::unique_ptr<xml::UpdateResponse> update_response;
+  HRESULT hr;
+  bool is_shared;
+};
+
+DWORD WINAPI SendUpdateCheck(void* param) {
+  BundleUpdateCheck* update_check = static_cast<BundleUpdateCheck*>(param);
+  update_check->hr = update_check->Send();
+  return 0;
+}
+
+// Holds the first request long enough for the other bundles to wait for it.
+DWORD WINAPI OpenGateAfterDelay(void* param) {
+  ::Sleep(200);
+  EXPECT_TRUE(static_cast<Gate*>(param)->Open());
+  return 0;
+}
+
+// Sends the update checks on one thread each and waits for all of them.
+void SendConcurrently(
+    const std::vector<std::unique_ptr<BundleUpdateCheck>>& update_checks) {
+  std::vector<HANDLE> threads;
+  for (size_t i = 0; i != update_checks.size(); ++i) {
+    HANDLE thread = ::CreateThread(NULL,
+                                   0,
+                                   &SendUpdateCheck,
+                                   update_checks[i].get(),
+                                   0,
+                                   NULL);
+    ASSERT_TRUE(thread);
+    threads.push_back(thread);
+  }
+
+  ASSERT_LE(threads.size(), static_cast<size_t>(MAXIMUM_WAIT_OBJECTS));
+  EXPECT_EQ(WAIT_OBJECT_0,
+            ::WaitForMultipleObjects(static_cast<DWORD>(threads.size()),
+                                     &threads.front(),
+                                     true,
+                                     INFINITE));
+  for (size_t i = 0; i != threads.size(); ++i) {
+    EXPECT_TRUE(::CloseHandle(threads[i]));
+  }
+}
+
+}  // namespace
+
+// 50 bundles check for updates of the same app at the same time. Only one of
+// them sends a request, and all of them get its response.
+TEST(UpdateCheckCoalescerTest, ConcurrentBundles) {
+  const int kNumBundles = 50;
+
+  UpdateCheckCoalescer coalescer(kFreshnessMs);
+  Gate release_response;
+
+  std::vector<std::unique_ptr<BundleUpdateCheck>> update_checks;
+  for (int i = 0; i != kNumBundles; ++i) {
+    update_checks.push_back(std::make_unique<BundleUpdateCheck>(kAppId1));
+    update_checks.back()->coalescer = &coalescer;
+    EXPECT_CALL(update_checks.back()->client, Send(true, _, _))
+        .Times(::testing::AtMost(1))
+        .WillOnce(SendResponse(&release_response, kElapsedDays));
+  }
+
+  // The bundles arriving after the response get the fresh response.
+  HANDLE thread = ::CreateThread(NULL,
+                                 0,
+                                 &OpenGateAfterDelay,
+                                 &release_response,
+                                 0,
+                                 NULL);
+  ASSERT_TRUE(thread);
+  SendConcurrently(update_checks);
+  EXPECT_EQ(WAIT_OBJECT_0, ::WaitForSingleObject(thread, INFINITE));
+  EXPECT_TRUE(::CloseHandle(thread));
+
+  int num_shared = 0;
+  for (int i = 0; i != kNumBundles; ++i) {
+    const BundleUpdateCheck& update_check = *update_checks[i];
+    EXPECT_SUCCEEDED(update_check.hr);
+    EXPECT_EQ(kElapsedDays,
+              update_check.update_response->GetElapsedDaysSinceDatum());
+    if (update_check.is_shared) {
+      ++num_shared;
+    }
+  }
+  EXPECT_EQ(kNumBundles - 1, num_shared);
+}
+
+TEST(UpdateCheckCoalescerTest, FreshResponse) {
+  UpdateCheckCoalescer coalescer(kFreshnessMs);
+
+  BundleUpdateCheck first(kAppId1);
+  first.coalescer = &coalescer;
+  EXPECT_CALL(first.client, Send(true, _, _))
+      .WillOnce(SendResponse(static_cast<Gate*>(NULL), kElapsedDays));
+  EXPECT_SUCCEEDED(first.Send());
+  EXPECT_FALSE(first.is_shared);
+
+  BundleUpdateCheck second(kAppId1);
+  second.coalescer = &coalescer;
+  EXPECT_CALL(second.client, Send(_, _, _)).Times(0);
+  EXPECT_SUCCEEDED(second.Send());
+  EXPECT_TRUE(second.is_shared);
+  EXPECT_EQ(kElapsedDays, second.update_response->GetElapsedDaysSinceDatum());
+}
+
+TEST(UpdateCheckCoalescerTest, NoFreshnessWindow) {
+  UpdateCheckCoalescer coalescer(0);
+
+  for (int i = 0; i != 2; ++i) {
+    BundleUpdateCheck update_check(kAppId1);
+    update_check.coalescer = &coalescer;
+    EXPECT_CALL(update_check.client, Send(true, _, _))
+        .WillOnce(SendResponse(static_cast<Gate*>(NULL), kElapsedDays + i));
+    EXPECT_SUCCEEDED(update_check.Send());
+    EXPECT_FALSE(update_check.is_shared);
+    EXPECT_EQ(kElapsedDays + i,
+              update_check.update_response->GetElapsedDaysSinceDatum());
+  }
+}
+
+TEST(UpdateCheckCoalescerTest, DifferentRequests) {
+  UpdateCheckCoalescer coalescer(kFreshnessMs);
+
+  BundleUpdateCheck app1(kAppId1);
+  app1.coalescer = &coalescer;
+  EXPECT_CALL(app1.client, Send(true, _, _))
+      .WillOnce(SendResponse(static_cast<Gate*>(NULL), kElapsedDays));
+  EXPECT_SUCCEEDED(app1.Send());
+
+  BundleUpdateCheck app2(kAppId2);
+  app2.coalescer = &coalescer;
+  EXPECT_CALL(app2.client, Send(true, _, _))
+      .WillOnce(SendResponse(static_cast<Gate*>(NULL), kElapsedDays + 1));
+  EXPECT_SUCCEEDED(app2.Send());
+  EXPECT_FALSE(app2.is_shared);
+  EXPECT_EQ(kElapsedDays + 1, app2.update_response->GetElapsedDaysSinceDatum());
+
+  // The background checks do not share the foreground ones.
+  BundleUpdateCheck background(kAppId1);
+  EXPECT_CALL(background.client, Send(false, _, _))
+      .WillOnce(SendResponse(static_cast<Gate*>(NULL), kElapsedDays + 2));
+  bool is_shared = true;
+  EXPECT_SUCCEEDED(coalescer.Send(&background.client,
+                                  get(background.cancel_event),
+                                  false,
+                                  background.update_request.get(),
+                                  background.update_response.get(),
+                                  &is_shared));
+  EXPECT_FALSE(is_shared);
+  EXPECT_EQ(kElapsedDays + 2,
+            background.update_response->GetElapsedDaysSinceDatum());
+}
+
+TEST(UpdateCheckCoalescerTest, FailedRequestIsNotReused) {
+  UpdateCheckCoalescer coalescer(kFreshnessMs);
+
+  BundleUpdateCheck first(kAppId1);
+  first.coalescer = &coalescer;
+  EXPECT_CALL(first.client, Send(true, _, _))
+      .WillOnce(FailToSend(static_cast<Gate*>(NULL)));
+  EXPECT_EQ(kSendError, first.Send());
+
+  BundleUpdateCheck second(kAppId1);
+  second.coalescer = &coalescer;
+  EXPECT_CALL(second.client, Send(true, _, _))
+      .WillOnce(SendResponse(static_cast<Gate*>(NULL), kElapsedDays));
+  EXPECT_SUCCEEDED(second.Send());
+  EXPECT_FALSE(second.is_shared);
+}
+
+// When the shared request fails, the waiting bundles send their own request.
+TEST(UpdateCheckCoalescerTest, FailedConcurrentRequest) {
+  const int kNumBundles = 10;
+
+  UpdateCheckCoalescer coalescer(kFreshnessMs);
+  Gate release_response;
+
+  // Whichever bundle sends first fails. The others succeed.
+  std::vector<std::unique_ptr<BundleUpdateCheck>> update_checks;
+  LLock lock;
+  bool has_failed = false;
+  for (int i = 0; i != kNumBundles; ++i) {
+    update_checks.push_back(std::make_unique<BundleUpdateCheck>(kAppId1));
+    update_checks.back()->coalescer = &coalescer;
+    EXPECT_CALL(update_checks.back()->client, Send(true, _, _))
+        .Times(::testing::AtMost(1))
+        .WillOnce(::testing::Invoke(
+            [&](bool, const xml::UpdateRequest*,
+                xml::UpdateResponse* update_response) -> HRESULT {
+              bool is_first = false;
+              __mutexBlock(lock) {
+                is_first = !has_failed;
+                has_failed = true;
+              }
+              if (is_first) {
+                EXPECT_TRUE(release_response.Wait(INFINITE));
+                return kSendError;
+              }
+
+              xml::response::Response response;
+              response.day_start.elapsed_days = kElapsedDays;
+              SetResponseForUnitTest(update_response, response);
+              return S_OK;
+            }));
+  }
+
+  HANDLE thread = ::CreateThread(NULL,
+                                 0,
+                                 &OpenGateAfterDelay,
+                                 &release_response,
+                                 0,
+                                 NULL);
+  ASSERT_TRUE(thread);
+  SendConcurrently(update_checks);
+  EXPECT_EQ(WAIT_OBJECT_0, ::WaitForSingleObject(thread, INFINITE));
+  EXPECT_TRUE(::CloseHandle(thread));
+
+  int num_failed = 0;
+  for (int i = 0; i != kNumBundles; ++i) {
+    if (FAILED(update_checks[i]->hr)) {
+      ++num_failed;
+      EXPECT_EQ(kSendError,
+                update_checks[i]->hr);
+    } else {
+      EXPECT_EQ(kElapsedDays,
+                update_checks[i]->update_response->GetElapsedDaysSinceDatum());
+    }
+  }
+  EXPECT_EQ(1, num_failed);
+}
+
+// A bundle stopped while it waits for the request of another bundle returns
+// without waiting for the response and without sending its own request.
+TEST(UpdateCheckCoalescerTest, CancelWaitingBundle) {
+  UpdateCheckCoalescer coalescer(kFreshnessMs);
+  Gate release_response;
+
+  BundleUpdateCheck leader(kAppId1);
+  leader.coalescer = &coalescer;
+  EXPECT_CALL(leader.client, Send(true, _, _))
+      .WillOnce(SendResponse(&release_response, kElapsedDays));
+  HANDLE leader_thread = ::CreateThread(NULL,
+                                        0,
+                                        &SendUpdateCheck,
+                                        &leader,
+                                        0,
+                                        NULL);
+  ASSERT_TRUE(leader_thread);
+
+  // Lets the leader register its request before the follower arrives.
+  ::Sleep(100);
+
+  BundleUpdateCheck follower(kAppId1);
+  follower.coalescer = &coalescer;
+  EXPECT_CALL(follower.client, Send(_, _, _)).Times(0);
+  HANDLE follower_thread = ::CreateThread(NULL,
+                                          0,
+                                          &SendUpdateCheck,
+                                          &follower,
+                                          0,
+                                          NULL);
+  ASSERT_TRUE(follower_thread);
+
+  EXPECT_TRUE(::SetEvent(get(follower.cancel_event)));
+  EXPECT_EQ(WAIT_OBJECT_0, ::WaitForSingleObject(follower_thread, 10000));
+  EXPECT_EQ(GOOPDATE_E_CANCELLED, follower.hr);
+  EXPECT_TRUE(follower.is_shared);
+
+  EXPECT_TRUE(release_response.Open());
+  EXPECT_EQ(WAIT_OBJECT_0, ::WaitForSingleObject(leader_thread, INFINITE));
+  EXPECT_SUCCEEDED(leader.hr);
+  EXPECT_FALSE(leader.is_shared);
+
+  EXPECT_TRUE(::CloseHandle(follower_thread));
+  EXPECT_TRUE(::CloseHandle(leader_thread));
+}
+
+}  // namespace omaha
@@ -46,6 +46,8 @@
 #include "omaha/common/update_response.h"
 #include "omaha/common/web_services_client.h"
 #include "omaha/goopdate/app_manager.h"
+#include "omaha/goopdate/app_registry_snapshot.h"
+#include "omaha/goopdate/download_install_pipeline.h"
 #include "omaha/goopdate/download_manager.h"
 #include "omaha/goopdate/goopdate.h"
 #include "omaha/goopdate/install_manager.h"
@@ -53,6 +55,7 @@
 #include "omaha/goopdate/offline_utils.h"
 #include "omaha/goopdate/server_resource.h"
 #include "omaha/goopdate/string_formatter.h"
+#include "omaha/goopdate/update_check_coalescer.h"
 #include "omaha/goopdate/update_request_utils.h"
 #include "omaha/goopdate/update_response_utils.h"
 #include "omaha/goopdate/worker_metrics.h"
@@ -60,16 +63,79 @@
 
 namespace omaha {
 
+namespace {
+
+// How long a response is reused for the identical update checks which follow
+// it.
+const int kUpdateCheckFreshnessMs = 10 * kMsPerSec;
+
+// Cancels the apps of |app_bundle| and completes the asynchronous call of the
+// bundle, in place of a call which did not run because the bundle was stopped
+// first. Worker::Stop has usually cancelled the apps already.
+void CompleteCancelledCall(AppBundle* app_bundle) {
+  ASSERT1(app_bundle);
+  CORE_LOG(L3, (_T("[CompleteCancelledCall][0x%p]"), app_bundle));
+
+  for (size_t i = 0; i != app_bundle->GetNumberOfApps(); ++i) {
+    app_bundle->GetApp(i)->Cancel();
+  }
+
+  app_bundle->CompleteAsyncCall();
+}
+
+// A deferred call for a bundle. The work items of the update bundles run
+// behind the work which a user is waiting for. The work items carry the
+// cancellation token of the bundle: if the bundle is stopped before the call
+// starts, the call does not run and the asynchronous call of the bundle is
+// completed instead.
+template <typename Callback>
+class BundleCallback : public Callback {
+ public:
+  template <typename... Args>
+  explicit BundleCallback(AppBundle* app_bundle, Args... args)
+      : Callback(args...),
+        app_bundle_(app_bundle) {
+    ASSERT1(app_bundle_);
+
+    this->set_priority(app_bundle_->is_auto_update() ?
+                           EXECUTOR_PRIORITY_BACKGROUND :
+                           EXECUTOR_PRIORITY_INTERACTIVE);
+    this->set_cancellation_token(app_bundle_->cancellation_token());
+  }
+
+ private:
+  void DoCancel() override {
+    CompleteCancelledCall(app_bundle_);
+  }
+
+  // The call holds a reference to the bundle.
+  AppBundle* const app_bundle_;
+
+  DISALLOW_COPY_AND_ASSIGN(BundleCallback);
+};
+
+}  // namespace
+
 namespace internal {
 
 void RecordUpdateAvailableUsageStats() {
   AppManager& app_manager = *AppManager::Instance();
 
+  AppRegistrySnapshot snapshot(app_manager.is_machine());
+  HRESULT hr = app_manager.LoadRegistrySnapshot(&snapshot);
+  if (FAILED(hr)) {
+    return;
+  }
+
   DWORD update_responses(0);
   DWORD64 time_since_first_response_ms(0);
-  app_manager.ReadUpdateAvailableStats(kGoopdateGuid,
-                                       &update_responses,
-                                       &time_since_first_response_ms);
+  const AppRegistryRecord* goopdate_record =
+      snapshot.GetApp(GuidToString(kGoopdateGuid));
+  if (goopdate_record) {
+    app_manager.ReadUpdateAvailableStats(*goopdate_record,
+                                         &update_responses,
+                                         &time_since_first_response_ms);
+  }
   if (update_responses) {
     metric_worker_self_update_responses = update_responses;
   }
@@ -79,10 +145,7 @@ void RecordUpdateAvailableUsageStats() {
   }
 
   AppIdVector registered_app_ids;
-  HRESULT hr = app_manager.GetRegisteredApps(&registered_app_ids);
-  if (FAILED(hr)) {
-    return;
-  }
+  snapshot.GetRegisteredApps(&registered_app_ids);
 
   // These store information about the app with the most update responses.
   GUID max_responses_app(GUID_NULL);
@@ -102,9 +165,7 @@ void RecordUpdateAvailableUsageStats() {
       continue;
     }
 
-    update_responses = 0;
-    time_since_first_response_ms = 0;
-    app_manager.ReadUpdateAvailableStats(app_guid,
+    app_manager.ReadUpdateAvailableStats(*snapshot.GetApp(app_id),
                                          &update_responses,
                                          &time_since_first_response_ms);
 
@@ -242,6 +303,8 @@ Worker::Worker()
   reactor_.reset(new Reactor);
   shutdown_handler_.reset(new ShutdownHandler);
   model_.reset(new Model(this));
+  update_check_coalescer_.reset(
+      new UpdateCheckCoalescer(kUpdateCheckFreshnessMs));
 }
 
 Worker::~Worker() {
@@ -557,6 +620,12 @@ void Worker::Download(std::shared_ptr<AppBundle> app_bundle) {
   const size_t num_apps = app_bundle->GetNumberOfApps();
 
   for (size_t i = 0; i != num_apps; ++i) {
+    // The apps left have been cancelled by Stop().
+    if (app_bundle->cancellation_token()->IsCancelled()) {
+      CORE_LOG(L3, (_T("[Worker::Download][bundle stopped]")));
+      break;
+    }
+
     App* app = app_bundle->GetApp(i);
 
     ASSERT1(app->state() == STATE_WAITING_TO_DOWNLOAD ||
@@ -630,37 +699,13 @@ void Worker::DownloadAndInstallHelper(AppBundle* app_bundle) {
     return;
   }
 
-  const size_t num_apps = app_bundle->GetNumberOfApps();
-
-  for (size_t i = 0; i != num_apps; ++i) {
-    App* app = app_bundle->GetApp(i);
-
-    ASSERT1(app->state() == STATE_WAITING_TO_DOWNLOAD ||
-            app->state() == STATE_WAITING_TO_INSTALL ||
-            app->state() == STATE_NO_UPDATE ||
-            app->state() == STATE_ERROR);
-
-    // Download the app if it has not already been downloaded.
-    // This is a blocking call on the network.
-    app->Download(download_manager_.get());
-
-    ASSERT1(app->state() == STATE_READY_TO_INSTALL ||    // Downloaded above.
-            app->state() == STATE_WAITING_TO_INSTALL ||  // Downloaded earlier.
-            app->state() == STATE_NO_UPDATE ||
-            app->state() == STATE_ERROR);
-
-    app->QueueInstall();
-
-    // This is a blocking call on the app installer.
-    CallAsSelfAndImpersonate1(
-        app,
-        &App::Install,
-        install_manager_.get());
-
-    ASSERT1(app->state() == STATE_INSTALL_COMPLETE ||
-            app->state() == STATE_NO_UPDATE ||
-            app->state() == STATE_ERROR);
-  }
+  // Apps are downloaded ahead of the app being installed, and installed in
+  // bundle order as soon as they are ready.
+  DownloadInstallPipeline pipeline(
+      download_manager_.get(),
+      install_manager_.get(),
+      ConfigManager::Instance()->GetBundleDownloadConcurrency());
+  pipeline.Run(app_bundle);
 
   WriteEventLog(EVENTLOG_INFORMATION_TYPE,
                 kUpdateEventId,
@@ -940,6 +985,11 @@ HRESULT Worker::DoUpdateCheck(AppBundle* app_bundle,
     return S_OK;
   }
 
+  if (app_bundle->cancellation_token()->IsCancelled()) {
+    CORE_LOG(L3, (_T("[DoUpdateCheck][bundle stopped]")));
+    return GOOPDATE_E_CANCELLED;
+  }
+
   if (app_bundle->is_offline_install()) {
     return offline_utils::ParseOfflineManifest(
         app_bundle->GetApp(0)->app_guid_string(), app_bundle->offline_dir(),
@@ -959,17 +1009,32 @@ HRESULT Worker::DoUpdateCheck(AppBundle* app_bundle,
 
   HighresTimer update_check_timer;
 
-  // This is a blocking call on the network.
+  // This is a blocking call on the network, unless an identical update check
+  // is in flight or has just completed.
   const bool is_foreground = app_bundle->priority() == INSTALL_PRIORITY_HIGH;
-  HRESULT hr = app_bundle->update_check_client()->Send(is_foreground,
-                                                       update_request,
-                                                       update_response);
-
-  CORE_LOG(L3, (_T("[Update check HTTP trace][%s]"),
-      app_bundle->update_check_client()->http_trace()));
+  bool is_shared = false;
+  HRESULT hr = update_check_coalescer_->Send(
+      app_bundle->update_check_client(),
+      app_bundle->stop_event(),
+      is_foreground,
+      update_request,
+      update_response,
+      &is_shared);
+
+  if (is_shared) {
+    CORE_LOG(L3, (_T("[Update check response shared][0x%08x]"), hr));
+  } else {
+    CORE_LOG(L3, (_T("[Update check HTTP trace][%s]"),
+        app_bundle->update_check_client()->http_trace()));
+  }
 
+  // The latency of the shared responses is not the latency of an update
+  // check, so only the update checks sent by this bundle are sampled.
   if (FAILED(hr)) {
-    metric_updatecheck_failed_ms.AddSample(update_check_timer.GetElapsedMs());
+    if (!is_shared) {
+      metric_updatecheck_failed_ms.AddSample(
+          update_check_timer.GetElapsedMs());
+    }
 
     CORE_LOG(LE, (_T("[Send failed][0x%08x]"), hr));
     worker_utils::AddHttpRequestDataToEventLog(
@@ -986,7 +1051,12 @@ HRESULT Worker::DoUpdateCheck(AppBundle* app_bundle,
     return hr;
   }
 
-  metric_updatecheck_succeeded_ms.AddSample(update_check_timer.GetElapsedMs());
+  if (is_shared) {
+    ++metric_worker_update_check_shared;
+  } else {
+    metric_updatecheck_succeeded_ms.AddSample(
+        update_check_timer.GetElapsedMs());
+  }
 
   if (is_update) {
     ++metric_worker_update_check_succeeded;
@@ -1048,8 +1118,10 @@ HRESULT Worker::QueueDeferredFunctionCall0(
   ASSERT1(app_bundle.get());
   ASSERT1(deferred_function);
 
-  using Callback = ThreadPoolCallBack1<Worker, std::shared_ptr<AppBundle>>;
-  auto callback = std::make_unique<Callback>(this,
+  using Callback =
+      BundleCallback<ThreadPoolCallBack1<Worker, std::shared_ptr<AppBundle>>>;
+  auto callback = std::make_unique<Callback>(app_bundle.get(),
+                                             this,
                                              deferred_function,
                                              app_bundle);
   UserWorkItem* user_work_item = callback.get();
@@ -1076,8 +1148,10 @@ HRESULT Worker::QueueDeferredFunctionCall1(
   ASSERT1(app_bundle.get());
   ASSERT1(deferred_function);
 
-  using Callback = ThreadPoolCallBack2<Worker, std::shared_ptr<AppBundle>, P1>;
-  auto callback = std::make_unique<Callback>(this,
+  using Callback = BundleCallback<
+      ThreadPoolCallBack2<Worker, std::shared_ptr<AppBundle>, P1>>;
+  auto callback = std::make_unique<Callback>(app_bundle.get(),
+                                             this,
                                              deferred_function,
                                              app_bundle,
                                              p1);
@@ -41,6 +41,7 @@ class InstallManagerInterface;
 class Model;
 class Package;
 class Reactor;
+class UpdateCheckCoalescer;
 
 // Limited subset of Worker interface that the Model needs.
 class WorkerModelInterface {
@@ -187,6 +188,7 @@ class Worker : public WorkerModelInterface, public ShutdownCallback {
   std::unique_ptr<Model>           model_;
   std::unique_ptr<DownloadManagerInterface> download_manager_;
   std::unique_ptr<InstallManagerInterface> install_manager_;
+  std::unique_ptr<UpdateCheckCoalescer> update_check_coalescer_;
 
   CMessageLoop message_loop_;
 
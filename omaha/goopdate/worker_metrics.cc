@@ -22,9 +22,18 @@ DEFINE_METRIC_count(worker_download_total);
 DEFINE_METRIC_count(worker_download_succeeded);
 
 DEFINE_METRIC_count(worker_download_skipped_bits_machine);
+DEFINE_METRIC_count(worker_download_differential_total);
+DEFINE_METRIC_count(worker_download_differential_succeeded);
+
+DEFINE_METRIC_count(worker_progress_notifications_sent);
+DEFINE_METRIC_count(worker_progress_notifications_suppressed);
 
 DEFINE_METRIC_count(worker_package_cache_put_total);
 DEFINE_METRIC_count(worker_package_cache_put_succeeded);
+DEFINE_METRIC_count(worker_package_cache_get_hard_link);
+DEFINE_METRIC_count(worker_package_cache_get_clone);
+DEFINE_METRIC_count(worker_package_cache_get_copy);
+DEFINE_METRIC_histogram(worker_package_cache_verify_hash_ms);
 
 DEFINE_METRIC_count(worker_install_execute_total);
 DEFINE_METRIC_count(worker_install_execute_msi_total);
@@ -53,6 +62,7 @@ DEFINE_METRIC_count(worker_silent_update_running_on_batteries);
 
 DEFINE_METRIC_count(worker_update_check_total);
 DEFINE_METRIC_count(worker_update_check_succeeded);
+DEFINE_METRIC_count(worker_update_check_shared);
 
 DEFINE_METRIC_integer(worker_apps_not_updated_eula);
 DEFINE_METRIC_integer(worker_apps_not_updated_group_policy);
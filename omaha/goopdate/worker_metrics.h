@@ -30,12 +30,30 @@ DECLARE_METRIC_count(worker_download_succeeded);
 // How many times the download manager skipped BITS due to machine install.
 DECLARE_METRIC_count(worker_download_skipped_bits_machine);
 
+// How many times the download manager attempted to reconstruct a package from
+// a differential package, and how many times it succeeded. The full package
+// is downloaded when the differential package can't be used.
+DECLARE_METRIC_count(worker_download_differential_total);
+DECLARE_METRIC_count(worker_download_differential_succeeded);
+
+// Number of progress notifications sent to the clients, and number of
+// progress notifications dropped by the rate limit.
+DECLARE_METRIC_count(worker_progress_notifications_sent);
+DECLARE_METRIC_count(worker_progress_notifications_suppressed);
+
 // How many times the package cache attempted to put the temporary file
 // to the cache directory.
 DECLARE_METRIC_count(worker_package_cache_put_total);
 // How many times the package cache successfully copied the temporary file
 // to the cache directory.
 DECLARE_METRIC_count(worker_package_cache_put_succeeded);
+// How many times the package cache made a package available to the installer
+// by hard linking, by cloning, and by copying the cached file, respectively.
+DECLARE_METRIC_count(worker_package_cache_get_hard_link);
+DECLARE_METRIC_count(worker_package_cache_get_clone);
+DECLARE_METRIC_count(worker_package_cache_get_copy);
+// Distribution of the time (ms) spent verifying the hash of a package.
+DECLARE_METRIC_histogram(worker_package_cache_verify_hash_ms);
 
 // How many times ExecuteAndWaitForInstaller was called.
 DECLARE_METRIC_count(worker_install_execute_total);
@@ -87,6 +105,9 @@ DECLARE_METRIC_count(worker_silent_update_running_on_batteries);
 DECLARE_METRIC_count(worker_update_check_total);
 // How many times an update check succeeded. Does not include installs.
 DECLARE_METRIC_count(worker_update_check_succeeded);
+// How many update checks and installs used the response of an identical
+// update check instead of sending their own request.
+DECLARE_METRIC_count(worker_update_check_shared);
 
 // Number of apps for which update checks skipped because EULA is not accepted.
 DECLARE_METRIC_integer(worker_apps_not_updated_eula);
@@ -20,6 +20,10 @@
 
 #include "omaha/base/app_util.h"
 #include "omaha/base/const_addresses.h"
+#include "omaha/base/error.h"
+#include "omaha/base/highres_timer-win32.h"
+#include "omaha/base/reg_key.h"
+#include "omaha/base/utils.h"
 #include "omaha/common/config_manager.h"
 #include "omaha/common/update_response.h"
 #include "omaha/common/web_services_client.h"
@@ -27,6 +31,7 @@
 #include "omaha/goopdate/app_manager.h"
 #include "omaha/goopdate/app_state_ready_to_install.h"
 #include "omaha/goopdate/app_state_update_available.h"
+#include "omaha/goopdate/download_install_pipeline.h"
 #include "omaha/goopdate/download_manager.h"
 #include "omaha/goopdate/goopdate.h"
 #include "omaha/goopdate/install_manager.h"
@@ -41,6 +46,8 @@ namespace omaha {
 
 using ::testing::_;
 using ::testing::AnyNumber;
+using ::testing::DoAll;
+using ::testing::InvokeWithoutArgs;
 using ::testing::Return;
 
 namespace {
@@ -207,6 +214,30 @@ ACTION(SimulateInstallAppStateTransition) {
   arg0->ReportInstallerComplete(result_info);
 }
 
+// Simulates a download or an install which takes |delay_ms| to complete.
+ACTION_P(SimulateSlowDownloadAppStateTransition, delay_ms) {
+  UNREFERENCED_ACTION_PARAMETERS;
+  arg0->Downloading();
+  ::Sleep(delay_ms);
+  arg0->DownloadComplete();
+  arg0->MarkReadyToInstall();
+  return 0;
+}
+
+ACTION_P(SimulateSlowInstallAppStateTransition, delay_ms) {
+  UNREFERENCED_ACTION_PARAMETERS;
+  arg0->Installing();
+  ::Sleep(delay_ms);
+
+  AppManager& app_manager = *AppManager::Instance();
+  __mutexScope(app_manager.GetRegistryStableStateLock());
+
+  InstallerResultInfo result_info;
+  result_info.type = INSTALLER_RESULT_SUCCESS;
+  result_info.text = _T("success");
+  arg0->ReportInstallerComplete(result_info);
+}
+
 void WaitForAppToEnterState(const App& app,
                             CurrentState expected_state,
                             int timeout_sec) {
@@ -267,6 +298,28 @@ class WorkerTest : public testing::Test {
     app_bundle->update_check_client_.reset(web_services_client);
   }
 
+  // Unlike WaitForBundleToBeReady, works for the stopped bundles too, which
+  // are not busy while their asynchronous call completes.
+  static void WaitForAsyncCallToComplete(const AppBundle& app_bundle,
+                                         int timeout_sec) {
+    const int kPeriodMs = 50;
+    const int max_tries = timeout_sec * 1000 / kPeriodMs;
+    for (int tries = 0; tries < max_tries; ++tries) {
+      if (!app_bundle.is_pending_non_blocking_call()) {
+        return;
+      }
+      ::Sleep(kPeriodMs);
+    }
+    ADD_FAILURE() << _T("Timed out waiting for the asynchronous call.");
+  }
+
+  // Returns the registry key where the pings of the bundle are persisted.
+  static CString GetPersistedPingRegPath(const AppBundle& app_bundle) {
+    return AppendRegKeyPath(USER_REG_UPDATE,
+                            _T("PersistedPings"),
+                            app_bundle.request_id_);
+  }
+
   void SetWorkerDownloadManager(DownloadManagerInterface* download_manager) {
     ASSERT_TRUE(download_manager);
     worker_->download_manager_.reset(download_manager);
@@ -487,15 +540,22 @@ TEST_F(WorkerMockedManagersTest, DownloadAndInstallAsync_NotAlreadyDownloaded) {
   EXPECT_CALL(*mock_install_manager_, install_working_dir())
       .WillRepeatedly(Return(app_util::GetTempDir()));
 
+  // The download of app2 may run ahead of the install of app1 but each app
+  // must be downloaded before it is installed and the apps must be installed
+  // in order.
   {
-    ::testing::InSequence dummy;
+    ::testing::Sequence app1_sequence, app2_sequence, install_sequence;
     EXPECT_CALL(*mock_download_manager_, DownloadApp(app1_))
+        .InSequence(app1_sequence)
         .WillOnce(SimulateDownloadAppStateTransition());
-    EXPECT_CALL(*mock_install_manager_, InstallApp(app1_, _))
-        .WillOnce(SimulateInstallAppStateTransition());
     EXPECT_CALL(*mock_download_manager_, DownloadApp(app2_))
+        .InSequence(app2_sequence)
         .WillOnce(SimulateDownloadAppStateTransition());
+    EXPECT_CALL(*mock_install_manager_, InstallApp(app1_, _))
+        .InSequence(app1_sequence, install_sequence)
+        .WillOnce(SimulateInstallAppStateTransition());
     EXPECT_CALL(*mock_install_manager_, InstallApp(app2_, _))
+        .InSequence(app2_sequence, install_sequence)
         .WillOnce(SimulateInstallAppStateTransition());
   }
 
@@ -597,6 +657,283 @@ TEST_F(WorkerMockedManagersTest, UpdateAllAppsAsync) {
   EXPECT_EQ(STATE_ERROR, app2_->state());
 }
 
+// The bundle is stopped before its update check runs. Whether the work item
+// is cancelled before it starts or the update check sees the bundle stopped,
+// no request is sent and the apps are cancelled.
+TEST_F(WorkerMockedManagersTest, CheckForUpdateAsync_Stop) {
+  EXPECT_CALL(*mock_web_services_client_, Send(_, _, _))
+      .Times(0);
+  EXPECT_CALL(*mock_web_services_client_, Cancel())
+      .Times(1);
+  ON_CALL(*mock_web_services_client_, http_trace())
+      .WillByDefault(Return(_T("")));
+  EXPECT_CALL(*mock_web_services_client_, http_trace())
+      .Times(AnyNumber());
+  EXPECT_CALL(*mock_web_services_client_, retry_after_sec())
+      .Times(AnyNumber());
+
+  // The work item can't go past the model lock until the bundle is stopped.
+  __mutexBlock(worker_->model()->lock()) {
+    EXPECT_SUCCEEDED(worker_->CheckForUpdateAsync(app_bundle_.get()));
+    SetAppBundleStateForUnitTest(app_bundle_.get(),
+                                 new fsm::AppBundleStateBusy);
+    EXPECT_SUCCEEDED(app_bundle_->stop());
+  }
+
+  WaitForAsyncCallToComplete(*app_bundle_, 5);
+  EXPECT_EQ(STATE_ERROR, app1_->state());
+  EXPECT_EQ(STATE_ERROR, app2_->state());
+  EXPECT_EQ(GOOPDATE_E_CANCELLED, app1_->error_code());
+  EXPECT_EQ(GOOPDATE_E_CANCELLED, app2_->error_code());
+}
+
+// A second bundle checking for updates of the same apps shortly after the
+// first one gets the response of the first check instead of sending its own
+// request. The apps of the second bundle still go through the post update
+// check and the bundle persists its pings.
+TEST_F(WorkerMockedManagersTest, CheckForUpdateAsync_SharedResponse) {
+  EXPECT_CALL(*mock_web_services_client_, Send(_, _, _))
+      .Times(1).WillOnce(WebServiceClientSend());
+  ON_CALL(*mock_web_services_client_, http_trace())
+      .WillByDefault(Return(_T("")));
+  EXPECT_CALL(*mock_web_services_client_, http_trace())
+      .Times(AnyNumber());
+  EXPECT_CALL(*mock_web_services_client_, retry_after_sec())
+      .Times(1);
+
+  std::shared_ptr<AppBundle> app_bundle2(
+      worker_->model()->CreateAppBundle(is_machine_));
+  ASSERT_TRUE(app_bundle2.get());
+  EXPECT_SUCCEEDED(app_bundle2->put_displayName(CComBSTR(_T("My Bundle"))));
+  EXPECT_SUCCEEDED(app_bundle2->put_displayLanguage(CComBSTR(_T("en"))));
+  EXPECT_SUCCEEDED(app_bundle2->initialize());
+
+  App* app2_1 = NULL;
+  App* app2_2 = NULL;
+  EXPECT_SUCCEEDED(app_bundle2->createApp(CComBSTR(kGuid1), &app2_1));
+  EXPECT_SUCCEEDED(app_bundle2->createApp(CComBSTR(kGuid2), &app2_2));
+  EXPECT_SUCCEEDED(app2_1->put_isEulaAccepted(VARIANT_TRUE));
+  EXPECT_SUCCEEDED(app2_2->put_isEulaAccepted(VARIANT_TRUE));
+
+  // The second bundle does not send anything.
+  MockWebServicesClient* mock_web_services_client2 =
+      new testing::StrictMock<MockWebServicesClient>;
+  SetUpdateCheckClient(app_bundle2.get(), mock_web_services_client2);
+  EXPECT_CALL(*mock_web_services_client2, retry_after_sec())
+      .Times(1);
+
+  __mutexBlock(worker_->model()->lock()) {
+    EXPECT_SUCCEEDED(worker_->CheckForUpdateAsync(app_bundle_.get()));
+    SetAppBundleStateForUnitTest(app_bundle_.get(),
+                                 new fsm::AppBundleStateBusy);
+  }
+  WaitForBundleToBeReady(*app_bundle_, 5);
+  EXPECT_EQ(STATE_ERROR, app1_->state());
+  EXPECT_EQ(STATE_ERROR, app2_->state());
+
+  const int64 shared_update_checks = metric_worker_update_check_shared.value();
+  const uint32 update_check_samples = metric_updatecheck_succeeded_ms.count();
+  const CString persisted_ping_reg_path(GetPersistedPingRegPath(*app_bundle2));
+  EXPECT_FALSE(RegKey::HasKey(persisted_ping_reg_path));
+
+  __mutexBlock(worker_->model()->lock()) {
+    EXPECT_SUCCEEDED(worker_->CheckForUpdateAsync(app_bundle2.get()));
+
+    EXPECT_EQ(STATE_WAITING_TO_CHECK_FOR_UPDATE, app2_1->state());
+    EXPECT_EQ(STATE_WAITING_TO_CHECK_FOR_UPDATE, app2_2->state());
+
+    SetAppBundleStateForUnitTest(app_bundle2.get(),
+                                 new fsm::AppBundleStateBusy);
+    EXPECT_TRUE(app_bundle2->IsBusy());
+  }
+
+  WaitForBundleToBeReady(*app_bundle2, 5);
+  EXPECT_FALSE(app_bundle2->IsBusy());
+  EXPECT_EQ(shared_update_checks + 1,
+            metric_worker_update_check_shared.value());
+
+  // The latency of the shared response is not sampled.
+  EXPECT_EQ(update_check_samples, metric_updatecheck_succeeded_ms.count());
+
+  // Same outcome as the first bundle, which sent the request.
+  EXPECT_EQ(STATE_ERROR, app2_1->state());
+  EXPECT_EQ(STATE_ERROR, app2_2->state());
+  EXPECT_FALSE(app2_1->ping_events().empty());
+  EXPECT_FALSE(app2_2->ping_events().empty());
+  EXPECT_TRUE(RegKey::HasKey(persisted_ping_reg_path));
+
+  app_bundle2.reset();
+}
+
+// Measures the end-to-end latency of a bundle of five apps, where each
+// download and each install takes 200 ms, with and without downloading ahead.
+class DownloadInstallPipelineTest
+    : public WorkerMockedManagersTest,
+      public ::testing::WithParamInterface<int> {
+ protected:
+  static const int kDownloadTimeMs = 200;
+  static const int kInstallTimeMs = 200;
+
+  virtual void SetUp() {
+    WorkerMockedManagersTest::SetUp();
+
+    const TCHAR* const kMoreApps[] = { kApp1, kApp2, kApp3 };
+    for (size_t i = 0; i != arraysize(kMoreApps); ++i) {
+      App* app = NULL;
+      EXPECT_SUCCEEDED(app_bundle_->createApp(CComBSTR(kMoreApps[i]), &app));
+      EXPECT_SUCCEEDED(app->put_isEulaAccepted(VARIANT_TRUE));
+    }
+
+    EXPECT_CALL(*mock_install_manager_, install_working_dir())
+        .WillRepeatedly(Return(app_util::GetTempDir()));
+
+    __mutexBlock(worker_->model()->lock()) {
+      for (size_t i = 0; i != app_bundle_->GetNumberOfApps(); ++i) {
+        App* app = app_bundle_->GetApp(i);
+        SetAppStateUpdateAvailable(app);
+        app->QueueDownloadOrInstall();
+        EXPECT_EQ(STATE_WAITING_TO_DOWNLOAD, app->state());
+      }
+    }
+  }
+
+  // Each app must be downloaded before it is installed and the apps must be
+  // installed in bundle order.
+  void ExpectDownloadAndInstallInOrder() {
+    ::testing::Sequence install_sequence;
+    for (size_t i = 0; i != app_bundle_->GetNumberOfApps(); ++i) {
+      App* app = app_bundle_->GetApp(i);
+
+      ::testing::Sequence app_sequence;
+      EXPECT_CALL(*mock_download_manager_, DownloadApp(app))
+          .InSequence(app_sequence)
+          .WillOnce(SimulateSlowDownloadAppStateTransition(kDownloadTimeMs));
+      EXPECT_CALL(*mock_install_manager_, InstallApp(app, _))
+          .InSequence(app_sequence, install_sequence)
+          .WillOnce(SimulateSlowInstallAppStateTransition(kInstallTimeMs));
+    }
+  }
+
+  int max_concurrent_downloads() const { return GetParam(); }
+};
+
+INSTANTIATE_TEST_CASE_P(MaxConcurrentDownloads,
+                        DownloadInstallPipelineTest,
+                        ::testing::Values(0, 1, 2, 4));
+
+TEST_P(DownloadInstallPipelineTest, BundleLatency) {
+  const size_t num_apps = app_bundle_->GetNumberOfApps();
+  ASSERT_EQ(5, num_apps);
+
+  ExpectDownloadAndInstallInOrder();
+
+  HighresTimer timer;
+  DownloadInstallPipeline pipeline(mock_download_manager_,
+                                   mock_install_manager_,
+                                   max_concurrent_downloads());
+  pipeline.Run(app_bundle_.get());
+  const int bundle_latency_ms = static_cast<int>(timer.GetElapsedMs());
+
+  for (size_t i = 0; i != num_apps; ++i) {
+    EXPECT_EQ(STATE_INSTALL_COMPLETE, app_bundle_->GetApp(i)->state());
+  }
+
+  // The latency depends on the scheduling of the test threads, therefore it
+  // is reported and not checked. DownloadsRunAheadOfInstall checks the
+  // overlap of the downloads and the installs.
+  std::wcout << _T("\tBundle latency with ") << max_concurrent_downloads()
+             << _T(" download threads: ") << bundle_latency_ms << _T(" ms")
+             << std::endl;
+}
+
+// The install of the first app blocks until the download of the second app
+// has started. With download threads, the second app is downloaded while the
+// first app is installed. Without, it is downloaded after the install.
+TEST_P(DownloadInstallPipelineTest, DownloadsRunAheadOfInstall) {
+  const size_t num_apps = app_bundle_->GetNumberOfApps();
+  ASSERT_LE(2, num_apps);
+
+  App* app1 = app_bundle_->GetApp(0);
+  App* app2 = app_bundle_->GetApp(1);
+
+  scoped_event app2_download_started(::CreateEvent(NULL, true, false, NULL));
+  ASSERT_TRUE(app2_download_started);
+
+  // Only waits long enough for a missing overlap not to hang the test.
+  const int kMaxOverlapWaitMs = 10000;
+  const int max_overlap_wait_ms =
+      max_concurrent_downloads() ? kMaxOverlapWaitMs : 0;
+  bool is_overlapped = false;
+
+  ::testing::Sequence install_sequence;
+  for (size_t i = 0; i != num_apps; ++i) {
+    App* app = app_bundle_->GetApp(i);
+
+    ::testing::Sequence app_sequence;
+    if (app == app2) {
+      EXPECT_CALL(*mock_download_manager_, DownloadApp(app))
+          .InSequence(app_sequence)
+          .WillOnce(DoAll(
+              InvokeWithoutArgs([&app2_download_started]() {
+                VERIFY1(::SetEvent(get(app2_download_started)));
+              }),
+              SimulateDownloadAppStateTransition()));
+    } else {
+      EXPECT_CALL(*mock_download_manager_, DownloadApp(app))
+          .InSequence(app_sequence)
+          .WillOnce(SimulateDownloadAppStateTransition());
+    }
+
+    if (app == app1) {
+      EXPECT_CALL(*mock_install_manager_, InstallApp(app, _))
+          .InSequence(app_sequence, install_sequence)
+          .WillOnce(DoAll(
+              InvokeWithoutArgs([&]() {
+                is_overlapped =
+                    ::WaitForSingleObject(get(app2_download_started),
+                                          max_overlap_wait_ms) ==
+                    WAIT_OBJECT_0;
+              }),
+              SimulateInstallAppStateTransition()));
+    } else {
+      EXPECT_CALL(*mock_install_manager_, InstallApp(app, _))
+          .InSequence(app_sequence, install_sequence)
+          .WillOnce(SimulateInstallAppStateTransition());
+    }
+  }
+
+  DownloadInstallPipeline pipeline(mock_download_manager_,
+                                   mock_install_manager_,
+                                   max_concurrent_downloads());
+  pipeline.Run(app_bundle_.get());
+
+  for (size_t i = 0; i != num_apps; ++i) {
+    EXPECT_EQ(STATE_INSTALL_COMPLETE, app_bundle_->GetApp(i)->state());
+  }
+
+  EXPECT_EQ(max_concurrent_downloads() != 0, is_overlapped);
+}
+
+TEST_P(DownloadInstallPipelineTest, CanceledBeforeRun) {
+  __mutexBlock(worker_->model()->lock()) {
+    for (size_t i = 0; i != app_bundle_->GetNumberOfApps(); ++i) {
+      app_bundle_->GetApp(i)->Cancel();
+    }
+  }
+
+  EXPECT_CALL(*mock_download_manager_, DownloadApp(_)).Times(0);
+  EXPECT_CALL(*mock_install_manager_, InstallApp(_, _)).Times(0);
+
+  DownloadInstallPipeline pipeline(mock_download_manager_,
+                                   mock_install_manager_,
+                                   max_concurrent_downloads());
+  pipeline.Run(app_bundle_.get());
+
+  for (size_t i = 0; i != app_bundle_->GetNumberOfApps(); ++i) {
+    EXPECT_EQ(STATE_ERROR, app_bundle_->GetApp(i)->state());
+  }
+}
+
 // TODO(omaha): Add tests for app already in error state, app failing download
 // or install, all apps failed or failing, etc.
 
@@ -14,18 +14,21 @@
 // ========================================================================
 
 #include "omaha/goopdate/worker_utils.h"
+#include <objbase.h>
 #include "omaha/base/constants.h"
 #include "omaha/base/debug.h"
 #include "omaha/base/error.h"
 #include "omaha/base/file.h"
 #include "omaha/base/logging.h"
 #include "omaha/base/safe_format.h"
+#include "omaha/base/scoped_impersonation.h"
 #include "omaha/base/signatures.h"
 #include "omaha/common/const_goopdate.h"
 #include "omaha/common/event_logger.h"
 #include "omaha/goopdate/server_resource.h"
 #include "omaha/goopdate/string_formatter.h"
 #include "omaha/net/network_request.h"
+#include "omaha/third_party/smartany/scoped_any.h"
 
 namespace omaha {
 
@@ -107,6 +110,39 @@ bool GetInstallActionForEvent(
   return false;
 }
 
+DownloadThread::DownloadThread(HANDLE impersonation_token,
+                               const std::function<void()>& download)
+    : impersonation_token_(impersonation_token),
+      download_(download) {
+  ASSERT1(download);
+}
+
+bool DownloadThread::Start() {
+  return thread_.Start(this);
+}
+
+void DownloadThread::Join() {
+  VERIFY1(thread_.WaitTillExit(INFINITE));
+}
+
+void DownloadThread::Run() {
+  scoped_co_init init_com_apt(COINIT_MULTITHREADED);
+  HRESULT hr = init_com_apt.hresult();
+  if (FAILED(hr)) {
+    CORE_LOG(LE, (_T("[DownloadThread][init COM failed][0x%08x]"), hr));
+    return;
+  }
+
+  scoped_impersonation impersonate_user(impersonation_token_);
+  hr = impersonate_user.result();
+  if (FAILED(hr)) {
+    CORE_LOG(LE, (_T("[DownloadThread][impersonation failed][0x%08x]"), hr));
+    return;
+  }
+
+  download_();
+}
+
 }  // namespace worker_utils
 
 }  // namespace omaha
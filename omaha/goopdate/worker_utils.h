@@ -18,7 +18,10 @@
 
 #include <windows.h>
 #include <atlstr.h>
+#include <functional>
 #include <vector>
+#include "base/basictypes.h"
+#include "omaha/base/thread.h"
 #include "omaha/common/install_manifest.h"
 
 namespace omaha {
@@ -46,6 +49,29 @@ bool GetInstallActionForEvent(
     xml::InstallAction::InstallEvent install_event,
     const xml::InstallAction** action);
 
+// A thread which downloads on behalf of the user of a bundle. Impersonation
+// is per thread, therefore the thread impersonates |impersonation_token|
+// before it calls |download|. It also initializes COM, which BITS needs. If
+// either one fails, |download| is not called, and the caller downloads on its
+// own thread instead.
+class DownloadThread : public Runnable {
+ public:
+  DownloadThread(HANDLE impersonation_token,
+                 const std::function<void()>& download);
+
+  bool Start();
+  void Join();
+
+ private:
+  virtual void Run();
+
+  const HANDLE impersonation_token_;
+  const std::function<void()> download_;
+  Thread thread_;
+
+  DISALLOW_COPY_AND_ASSIGN(DownloadThread);
+};
+
 }  // namespace worker_utils
 
 }  // namespace omaha
@@ -40,7 +40,8 @@ def BuildMetaInstaller(
     installers_sources_path='$MAIN_DIR/installers',
     lzma_path='$THIRD_PARTY/lzma/files/lzma.exe',
     resmerge_path='$MAIN_DIR/tools/resmerge.exe',
-    bcj2_path='$OBJ_ROOT/mi_exe_stub/x86_encoder/bcj2.exe'):
+    bcj2_path='$OBJ_ROOT/mi_exe_stub/x86_encoder/bcj2.exe',
+    package_payload_path=None):
   """Build a meta-installer.
 
     Builds a full meta-installer, which is a meta-installer containing a full
@@ -66,6 +67,9 @@ def BuildMetaInstaller(
     lzma_path: path to lzma.exe
     resmerge_path: path to resmerge.exe
     bcj2_path: path to bcj2.exe
+    package_payload_path: path to package_payload.exe. When set, the payload
+        is compressed to LZMA2 on several threads by package_payload.exe
+        instead of by bcj2.exe and lzma.exe.
 
   Returns:
     Target nodes.
@@ -98,26 +102,34 @@ def BuildMetaInstaller(
   if additional_payload_contents_dependencies:
     env.Depends(tarball_output, additional_payload_contents_dependencies)
 
-  # Preprocess the tarball to increase compressibility
-  bcj_filename = '%spayload%s.tar.bcj' % (prefix, suffix)
-  # TODO(omaha): Add the bcj2 path as an optional parameter.
-  bcj_output = env.Command(
-      target=bcj_filename,
-      source=tarball_output,
-      action='%s "$SOURCES" "$TARGET"' % bcj2_path,
-  )
-  env.Depends(bcj_output, bcj2_path)
-
-  # Compress the tarball
-  lzma_env = env.Clone()
-  lzma_env.Append(
-      LZMAFLAGS=[],
-  )
-  lzma_output = lzma_env.Command(
-      target=payload_filename,
-      source=bcj_output,
-      action='%s e $SOURCES $TARGET $LZMAFLAGS' % lzma_path,
-  )
+  if package_payload_path:
+    # Preprocess and compress the tarball in one step.
+    lzma_output = env.Command(
+        target=payload_filename,
+        source=tarball_output,
+        action='%s "$SOURCES" "$TARGET"' % package_payload_path,
+    )
+    env.Depends(lzma_output, package_payload_path)
+  else:
+    # Preprocess the tarball to increase compressibility
+    bcj_filename = '%spayload%s.tar.bcj' % (prefix, suffix)
+    bcj_output = env.Command(
+        target=bcj_filename,
+        source=tarball_output,
+        action='%s "$SOURCES" "$TARGET"' % bcj2_path,
+    )
+    env.Depends(bcj_output, bcj2_path)
+
+    # Compress the tarball
+    lzma_env = env.Clone()
+    lzma_env.Append(
+        LZMAFLAGS=[],
+    )
+    lzma_output = lzma_env.Command(
+        target=payload_filename,
+        source=bcj_output,
+        action='%s e $SOURCES $TARGET $LZMAFLAGS' % lzma_path,
+    )
 
   # Construct the resource generation script
   manifest_path = installers_sources_path + '/installers.manifest'
@@ -0,0 +1,284 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/mi_exe_stub/bcj2_decoder.h"
+
+#include <string.h>
+#include <algorithm>
+
+namespace omaha {
+
+namespace {
+
+const int kNumTopBits = 24;
+const uint32 kTopValue = static_cast<uint32>(1) << kNumTopBits;
+const int kNumBitModelTotalBits = 11;
+const uint32 kBitModelTotal = 1 << kNumBitModelTotalBits;
+const int kNumMoveBits = 5;
+
+// The range coder stream starts with five bytes of initial code.
+const size_t kRangeCoderInitSize = 5;
+
+bool IsJcc(uint8 byte0, uint8 byte1) {
+  return (byte0 == 0x0F && (byte1 & 0xF0) == 0x80);
+}
+
+bool IsJ(uint8 byte0, uint8 byte1) {
+  return ((byte1 & 0xFE) == 0xE8 || IsJcc(byte0, byte1));
+}
+
+}  // namespace
+
+Bcj2Decoder::Bcj2Decoder(OutputCallback callback, void* callback_context)
+    : callback_(callback),
+      callback_context_(callback_context),
+      header_size_(0),
+      output_size_(0),
+      main_size_(0),
+      side_streams_size_(0),
+      side_streams_received_(0),
+      call_(NULL),
+      call_end_(NULL),
+      jump_(NULL),
+      jump_end_(NULL),
+      range_(NULL),
+      range_end_(NULL),
+      main_received_(0),
+      output_position_(0),
+      previous_byte_(0),
+      range_size_(0),
+      code_(0),
+      output_buffer_size_(0),
+      failed_(false) {
+  _ASSERTE(callback);
+  for (int i = 0; i != kNumProbs; ++i) {
+    probs_[i] = kBitModelTotal >> 1;
+  }
+}
+
+Bcj2Decoder::~Bcj2Decoder() {}
+
+bool Bcj2Decoder::Write(const uint8* data, size_t size) {
+  if (failed_) {
+    return false;
+  }
+
+  while (size) {
+    if (header_size_ < kHeaderSize) {
+      const size_t count = std::min(size, kHeaderSize - header_size_);
+      memcpy(header_ + header_size_, data, count);
+      header_size_ += count;
+      data += count;
+      size -= count;
+      if (header_size_ == kHeaderSize && !ParseHeader()) {
+        failed_ = true;
+        return false;
+      }
+    } else if (side_streams_received_ < side_streams_size_) {
+      const size_t count =
+          std::min(size, side_streams_size_ - side_streams_received_);
+      memcpy(side_streams_.get() + side_streams_received_, data, count);
+      side_streams_received_ += count;
+      data += count;
+      size -= count;
+      if (side_streams_received_ == side_streams_size_) {
+        InitRangeDecoder();
+      }
+    } else {
+      if (!DecodeMainStream(data, size)) {
+        failed_ = true;
+        return false;
+      }
+      break;
+    }
+  }
+
+  return true;
+}
+
+bool Bcj2Decoder::Finish() {
+  if (failed_ || !FlushOutput()) {
+    failed_ = true;
+    return false;
+  }
+
+  return header_size_ == kHeaderSize &&
+         side_streams_received_ == side_streams_size_ &&
+         main_received_ == main_size_ &&
+         output_position_ == output_size_;
+}
+
+bool Bcj2Decoder::ParseHeader() {
+  uint64 values[5] = {};
+  for (size_t i = 0; i != arraysize(values); ++i) {
+    for (size_t j = 0; j != sizeof(uint64); ++j) {  // NOLINT
+      values[i] |= static_cast<uint64>(header_[i * sizeof(uint64) + j]) <<
+                   (8 * j);
+    }
+  }
+
+  output_size_ = values[0];
+  main_size_ = values[1];
+  const uint64 call_size = values[2];
+  const uint64 jump_size = values[3];
+  const uint64 range_size = values[4];
+
+  // The side streams are kept in memory, so they must fit in a size_t.
+  const uint64 kMaxSize = static_cast<size_t>(-1);
+  if (range_size < kRangeCoderInitSize ||
+      call_size > kMaxSize ||
+      jump_size > kMaxSize - call_size ||
+      range_size > kMaxSize - call_size - jump_size) {
+    return false;
+  }
+
+  side_streams_size_ = static_cast<size_t>(call_size + jump_size + range_size);
+  side_streams_.reset(new uint8[side_streams_size_]);
+  if (!side_streams_.get()) {
+    return false;
+  }
+
+  call_ = side_streams_.get();
+  call_end_ = call_ + static_cast<size_t>(call_size);
+  jump_ = call_end_;
+  jump_end_ = jump_ + static_cast<size_t>(jump_size);
+  range_ = jump_end_;
+  range_end_ = range_ + static_cast<size_t>(range_size);
+  return true;
+}
+
+void Bcj2Decoder::InitRangeDecoder() {
+  _ASSERTE(static_cast<size_t>(range_end_ - range_) >= kRangeCoderInitSize);
+
+  code_ = 0;
+  range_size_ = 0xFFFFFFFF;
+  for (size_t i = 0; i != kRangeCoderInitSize; ++i) {
+    code_ = (code_ << 8) | *range_++;
+  }
+}
+
+bool Bcj2Decoder::DecodeBit(uint16* prob, bool* bit) {
+  _ASSERTE(prob);
+  _ASSERTE(bit);
+
+  const uint32 probability = *prob;
+  const uint32 bound = (range_size_ >> kNumBitModelTotalBits) * probability;
+  if (code_ < bound) {
+    range_size_ = bound;
+    *prob = static_cast<uint16>(
+        probability + ((kBitModelTotal - probability) >> kNumMoveBits));
+    *bit = false;
+  } else {
+    range_size_ -= bound;
+    code_ -= bound;
+    *prob = static_cast<uint16>(probability - (probability >> kNumMoveBits));
+    *bit = true;
+  }
+
+  if (range_size_ < kTopValue) {
+    if (range_ == range_end_) {
+      return false;
+    }
+    range_size_ <<= 8;
+    code_ = (code_ << 8) | *range_++;
+  }
+  return true;
+}
+
+bool Bcj2Decoder::DecodeMainStream(const uint8* data, size_t size) {
+  for (size_t i = 0; i != size; ++i) {
+    if (main_received_ == main_size_ || output_position_ == output_size_) {
+      return false;
+    }
+    ++main_received_;
+
+    const uint8 byte = data[i];
+    if (!Output(byte)) {
+      return false;
+    }
+
+    if (!IsJ(previous_byte_, byte)) {
+      previous_byte_ = byte;
+      continue;
+    }
+
+    // Like Bcj2_Decode, the bit of an opcode ending the output is not read.
+    if (output_position_ == output_size_) {
+      continue;
+    }
+
+    uint16* prob = byte == 0xE8 ? &probs_[previous_byte_] :
+                   byte == 0xE9 ? &probs_[256] :
+                                  &probs_[257];
+    bool is_converted = false;
+    if (!DecodeBit(prob, &is_converted)) {
+      return false;
+    }
+    if (!is_converted) {
+      previous_byte_ = byte;
+      continue;
+    }
+
+    const uint8** stream = byte == 0xE8 ? &call_ : &jump_;
+    const uint8* stream_end = byte == 0xE8 ? call_end_ : jump_end_;
+    if (stream_end - *stream < 4) {
+      return false;
+    }
+    const uint8* v = *stream;
+    *stream += 4;
+
+    // The absolute target is stored big-endian and the relative target is
+    // written little-endian. The positions wrap around at 4GB, the same way
+    // they do in the encoder.
+    const uint32 dest = ((static_cast<uint32>(v[0]) << 24) |
+                         (static_cast<uint32>(v[1]) << 16) |
+                         (static_cast<uint32>(v[2]) << 8) |
+                         static_cast<uint32>(v[3])) -
+                        (static_cast<uint32>(output_position_) + 4);
+    for (int shift = 0; shift < 32; shift += 8) {
+      if (output_position_ == output_size_) {
+        return false;
+      }
+      if (!Output(static_cast<uint8>(dest >> shift))) {
+        return false;
+      }
+    }
+    previous_byte_ = static_cast<uint8>(dest >> 24);
+  }
+
+  return true;
+}
+
+bool Bcj2Decoder::Output(uint8 byte) {
+  if (output_buffer_size_ == kOutputBufferSize && !FlushOutput()) {
+    return false;
+  }
+
+  output_buffer_[output_buffer_size_++] = byte;
+  ++output_position_;
+  return true;
+}
+
+bool Bcj2Decoder::FlushOutput() {
+  if (!output_buffer_size_) {
+    return true;
+  }
+
+  const size_t size = output_buffer_size_;
+  output_buffer_size_ = 0;
+  return callback_(callback_context_, output_buffer_, size);
+}
+
+}  // namespace omaha
@@ -0,0 +1,104 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// Streaming decoder for the BCJ2 payload written by x86_encoder/bcj2.exe.
+// The decoding is the same as Bcj2_Decode in the LZMA SDK, except that the
+// main stream is consumed as it arrives and the output is handed out in small
+// chunks. Only the call, jump, and range coder streams are kept in memory.
+
+#ifndef OMAHA_MI_EXE_STUB_BCJ2_DECODER_H_
+#define OMAHA_MI_EXE_STUB_BCJ2_DECODER_H_
+
+#include <windows.h>
+#include <memory>
+
+#pragma warning(push)
+// C4310: cast truncates constant value
+#pragma warning(disable : 4310)
+#include "base/basictypes.h"
+#pragma warning(pop)
+
+namespace omaha {
+
+class Bcj2Decoder {
+ public:
+  // Receives the decoded data. Returns false to abort the decoding.
+  typedef bool (*OutputCallback)(void* context, const uint8* data, size_t size);
+
+  Bcj2Decoder(OutputCallback callback, void* callback_context);
+  ~Bcj2Decoder();
+
+  // Decodes the next |size| bytes of the payload. Returns false if the payload
+  // is not valid or if the callback failed.
+  bool Write(const uint8* data, size_t size);
+
+  // Flushes the remaining output. Returns true if the entire payload has been
+  // decoded.
+  bool Finish();
+
+ private:
+  // The payload header is made of five 64-bit little-endian integers: the
+  // size of the output and the sizes of the main, call, jump, and range coder
+  // streams. The header is followed by the call, jump, and range coder streams
+  // and the payload ends with the main stream.
+  static const size_t kHeaderSize = 5 * sizeof(uint64);  // NOLINT
+  static const size_t kOutputBufferSize = 64 * 1024;
+  static const int kNumProbs = 256 + 2;
+
+  bool ParseHeader();
+  void InitRangeDecoder();
+  bool DecodeMainStream(const uint8* data, size_t size);
+  bool DecodeBit(uint16* prob, bool* bit);
+  bool Output(uint8 byte);
+  bool FlushOutput();
+
+  OutputCallback callback_;
+  void* callback_context_;
+
+  uint8 header_[kHeaderSize];
+  size_t header_size_;
+
+  uint64 output_size_;
+  uint64 main_size_;
+
+  // The call, jump, and range coder streams, back to back.
+  std::unique_ptr<uint8[]> side_streams_;
+  size_t side_streams_size_;
+  size_t side_streams_received_;
+  const uint8* call_;
+  const uint8* call_end_;
+  const uint8* jump_;
+  const uint8* jump_end_;
+  const uint8* range_;
+  const uint8* range_end_;
+
+  uint64 main_received_;
+  uint64 output_position_;
+  uint8 previous_byte_;
+  uint32 range_size_;
+  uint32 code_;
+  uint16 probs_[kNumProbs];
+
+  uint8 output_buffer_[kOutputBufferSize];
+  size_t output_buffer_size_;
+
+  bool failed_;
+
+  DISALLOW_COPY_AND_ASSIGN(Bcj2Decoder);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_MI_EXE_STUB_BCJ2_DECODER_H_
@@ -60,12 +60,9 @@
 #include "omaha/common/const_cmd_line.h"
 #include "omaha/mi_exe_stub/process.h"
 #include "omaha/mi_exe_stub/mi.grh"
+#include "omaha/mi_exe_stub/payload_decoder.h"
 #include "omaha/mi_exe_stub/tar.h"
 #include "omaha/third_party/smartany/scoped_any.h"
-extern "C" {
-#include "third_party/lzma/files/C/Bcj2.h"
-#include "third_party/lzma/files/C/LzmaDec.h"
-}
 
 namespace omaha  {
 
@@ -173,15 +170,11 @@ class MetaInstaller {
     if (CreateUniqueTempDirectory() != 0) {
       return -1;
     }
-    scoped_hfile tarball_file(ExtractTarballToTempLocation());
-    if (!valid(tarball_file)) {
-      return -1;
-    }
 
     // Extract files from the archive and run the first EXE we find in it.
-    Tar tar(temp_dir_, get(tarball_file), true);
+    Tar tar(temp_dir_, true);
     tar.SetCallback(TarFileCallback, this);
-    if (!tar.ExtractToDir()) {
+    if (!ExtractPayload(&tar)) {
       return -1;
     }
 
@@ -361,7 +354,6 @@ class MetaInstaller {
       return false;
     }
 
-    temp_root_dir_ = static_cast<const CString&>(google_update_temp_dir);
     return true;
   }
 
@@ -375,12 +367,7 @@ class MetaInstaller {
       return false;
     }
 
-    if (!CreateTempSubdirectory(user_tmp_dir)) {
-      return false;
-    }
-
-    temp_root_dir_ = user_tmp_dir;
-    return true;
+    return CreateTempSubdirectory(user_tmp_dir);
   }
 
   // Creates a temp directory to hold the embedded setup files. First attempts
@@ -390,46 +377,29 @@ class MetaInstaller {
     return CreateProgramFilesTempDir() || CreateUserTempDir() ? 0 : -1;
   }
 
-  HANDLE ExtractTarballToTempLocation() {
-    HANDLE tarball_file = INVALID_HANDLE_VALUE;
-    TCHAR tarball_filename[MAX_PATH] = {0};
-    if (::GetTempFileName(temp_root_dir_,
-                          _T("GUT"),
-                          0,  // form a unique filename
-                          tarball_filename)) {
-      files_to_delete_.Add(tarball_filename);
-      HRSRC res_info = ::FindResource(NULL,
-                                      MAKEINTRESOURCE(IDR_PAYLOAD),
-                                      _T("B"));
-      if (NULL != res_info) {
-        HGLOBAL resource = ::LoadResource(NULL, res_info);
-        if (NULL != resource) {
-          LPVOID resource_pointer = ::LockResource(resource);
-          if (NULL != resource_pointer) {
-            tarball_file = ::CreateFile(tarball_filename,
-                                        GENERIC_READ | GENERIC_WRITE,
-                                        0,
-                                        NULL,
-                                        OPEN_ALWAYS,
-                                        0,
-                                        NULL);
-            if (INVALID_HANDLE_VALUE != tarball_file) {
-              LARGE_INTEGER file_position = {};
-              if (0 != DecompressBufferToFile(
-                      static_cast<const uint8*>(resource_pointer),
-                      ::SizeofResource(NULL, res_info),
-                      tarball_file) ||
-                  !::SetFilePointerEx(tarball_file, file_position, NULL,
-                                      FILE_BEGIN)) {
-                ::CloseHandle(tarball_file);
-                tarball_file = INVALID_HANDLE_VALUE;
-              }
-            }
-          }
-        }
-      }
+  // Decodes the payload resource and extracts the files in the tarball as
+  // the data is decoded. The tarball itself is never written to disk.
+  bool ExtractPayload(Tar* tar) {
+    HRSRC res_info = ::FindResource(NULL,
+                                    MAKEINTRESOURCE(IDR_PAYLOAD),
+                                    _T("B"));
+    if (NULL == res_info) {
+      return false;
+    }
+    HGLOBAL resource = ::LoadResource(NULL, res_info);
+    if (NULL == resource) {
+      return false;
     }
-    return tarball_file;
+    LPVOID resource_pointer = ::LockResource(resource);
+    if (NULL == resource_pointer) {
+      return false;
+    }
+
+    return DecodePayload(static_cast<const uint8*>(resource_pointer),
+                         ::SizeofResource(NULL, res_info),
+                         TarWriteCallback,
+                         tar) &&
+           tar->IsDone();
   }
 
   bool CopyMetainstallerToTempLocation() {
@@ -497,102 +467,9 @@ class MetaInstaller {
     mi->HandleTarFile(filename);
   }
 
-  // TODO(omaha): reimplement the relevant files in the LZMA SDK to optimize
-  // for size. We'll have to release the modifications (LZMA SDK is CDDL/CDL),
-  // which shouldn't be a problem.
-  static void* MyAlloc(void* p, size_t size) {
-    UNREFERENCED_PARAMETER(p);
-    return new uint8[size];
-  }
-
-  static void MyFree(void* p, void* address) {
-    UNREFERENCED_PARAMETER(p);
-    delete[] address;
-  }
-
-  // Decompress the content of the memory buffer into the file
-  static int DecompressBufferToFile(const uint8* packed_buffer,
-                                    size_t packed_size,
-                                    HANDLE file) {
-    // need header and len minimally
-    if (packed_size < LZMA_PROPS_SIZE + 8) {
-      return -1;
-    }
-
-    // Note this code won't properly handle decoding large files, since uint32
-    // is used in several places to count size.
-    ISzAlloc allocators = { &MyAlloc, &MyFree };
-    CLzmaDec lzma_state;
-    LzmaDec_Construct(&lzma_state);
-    LzmaDec_Allocate(&lzma_state, packed_buffer, LZMA_PROPS_SIZE, &allocators);
-    LzmaDec_Init(&lzma_state);
-    packed_buffer += LZMA_PROPS_SIZE;
-    packed_size -= LZMA_PROPS_SIZE;
-
-    // TODO(omaha): make this independent of endianness.
-    uint64 unpacked_size_64 = *reinterpret_cast<const uint64*>(packed_buffer);
-    size_t unpacked_size = static_cast<size_t>(unpacked_size_64);
-    packed_buffer += sizeof(unpacked_size_64);
-    packed_size -= sizeof(unpacked_size_64);
-
-    std::unique_ptr<uint8[]> unpacked_buffer(new uint8[unpacked_size]);
-
-    ELzmaStatus status = static_cast<ELzmaStatus>(0);
-    SRes result = LzmaDec_DecodeToBuf(
-        &lzma_state,
-        unpacked_buffer.get(),
-        &unpacked_size,
-        packed_buffer,
-        &packed_size,
-        LZMA_FINISH_END,
-        &status);
-    LzmaDec_Free(&lzma_state, &allocators);
-    if (SZ_OK != result) {
-      return -1;
-    }
-
-#if 0
-    // Reverse BCJ coding.
-    uint32 x86_conversion_state;
-    x86_Convert_Init(x86_conversion_state);
-    x86_Convert(unpacked_buffer.get(), unpacked_size, 0, &x86_conversion_state,
-                0 /* decoding */);
-#else
-    // Reverse BCJ2 coding.
-    const uint8* p = unpacked_buffer.get();
-    uint32 original_size = *reinterpret_cast<const uint32*>(p);
-    p += sizeof(uint32);  // NOLINT
-    uint32 stream0_size = *reinterpret_cast<const uint32*>(p);
-    p += sizeof(uint32);  // NOLINT
-    uint32 stream1_size = *reinterpret_cast<const uint32*>(p);
-    p += sizeof(uint32);  // NOLINT
-    uint32 stream2_size = *reinterpret_cast<const uint32*>(p);
-    p += sizeof(uint32);  // NOLINT
-    uint32 stream3_size = *reinterpret_cast<const uint32*>(p);
-    p += sizeof(uint32);  // NOLINT
-
-    std::unique_ptr<uint8[]> output_buffer(new uint8[original_size]);
-    if (SZ_OK != Bcj2_Decode(p,
-                             stream0_size,
-                             p + stream0_size,
-                             stream1_size,
-                             p + stream0_size + stream1_size,
-                             stream2_size,
-                             p + stream0_size + stream1_size + stream2_size,
-                             stream3_size,
-                             output_buffer.get(), original_size)) {
-      return 1;
-    }
-#endif
-
-    DWORD written;
-    if (!::WriteFile(file, output_buffer.get(), original_size, &written,
-                     NULL) ||
-        written != original_size) {
-        return -1;
-    }
-
-    return 0;
+  static bool TarWriteCallback(void* context, const uint8* data, size_t size) {
+    Tar* tar = reinterpret_cast<Tar*>(context);
+    return tar->Write(data, size);
   }
 
   HINSTANCE instance_;
@@ -601,7 +478,6 @@ class MetaInstaller {
   DWORD exit_code_;
   CSimpleArray<CString> files_to_delete_;
   CString temp_dir_;
-  CString temp_root_dir_;
 };
 
 HRESULT CheckOSRequirements() {
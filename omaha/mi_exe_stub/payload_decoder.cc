@@ -0,0 +1,160 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/mi_exe_stub/payload_decoder.h"
+
+#include <memory>
+
+extern "C" {
+#include "third_party/lzma/files/C/Lzma2Dec.h"
+#include "third_party/lzma/files/C/LzmaDec.h"
+}
+
+namespace omaha {
+
+namespace {
+
+// TODO(omaha): reimplement the relevant files in the LZMA SDK to optimize
+// for size. We'll have to release the modifications (LZMA SDK is CDDL/CDL),
+// which shouldn't be a problem.
+void* MyAlloc(void* p, size_t size) {
+  UNREFERENCED_PARAMETER(p);
+  return new uint8[size];
+}
+
+void MyFree(void* p, void* address) {
+  UNREFERENCED_PARAMETER(p);
+  delete[] address;
+}
+
+// Decompresses the content of the memory buffer and writes it to the BCJ2
+// decoder as it is decoded, one dictionary window at a time.
+bool DecompressBuffer(const uint8* packed_buffer,
+                      size_t packed_size,
+                      Bcj2Decoder* decoder) {
+  const bool is_lzma2 = packed_size && *packed_buffer == kLzma2PayloadMarker;
+  const size_t props_size = is_lzma2 ? 2 : LZMA_PROPS_SIZE;
+
+  // need header and len minimally
+  if (packed_size < props_size + 8) {
+    return false;
+  }
+
+  // The LZMA2 decoder wraps an LZMA decoder, which owns the dictionary.
+  ISzAlloc allocators = { &MyAlloc, &MyFree };
+  CLzma2Dec lzma2_state;
+  Lzma2Dec_Construct(&lzma2_state);
+  CLzmaDec& lzma_state = lzma2_state.decoder;
+  const SRes allocate_result = is_lzma2 ?
+      Lzma2Dec_AllocateProbs(&lzma2_state, packed_buffer[1], &allocators) :
+      LzmaDec_AllocateProbs(&lzma_state,
+                            packed_buffer,
+                            LZMA_PROPS_SIZE,
+                            &allocators);
+  if (SZ_OK != allocate_result) {
+    return false;
+  }
+  packed_buffer += props_size;
+  packed_size -= props_size;
+
+  uint64 unpacked_size = 0;
+  for (size_t i = 0; i != sizeof(unpacked_size); ++i) {
+    unpacked_size |= static_cast<uint64>(packed_buffer[i]) << (8 * i);
+  }
+  packed_buffer += sizeof(unpacked_size);
+  packed_size -= sizeof(unpacked_size);
+
+  // The dictionary does not need to be larger than the output.
+  size_t dictionary_size = lzma_state.prop.dicSize;
+  if (dictionary_size > unpacked_size) {
+    dictionary_size = static_cast<size_t>(unpacked_size);
+  }
+  std::unique_ptr<uint8[]> dictionary(new uint8[dictionary_size]);
+  lzma_state.dic = dictionary.get();
+  lzma_state.dicBufSize = dictionary_size;
+  if (is_lzma2) {
+    Lzma2Dec_Init(&lzma2_state);
+  } else {
+    LzmaDec_Init(&lzma_state);
+  }
+
+  bool result = true;
+  uint64 remaining = unpacked_size;
+  while (remaining) {
+    if (lzma_state.dicPos == lzma_state.dicBufSize) {
+      lzma_state.dicPos = 0;
+    }
+
+    const SizeT dictionary_position = lzma_state.dicPos;
+    SizeT dictionary_limit = lzma_state.dicBufSize;
+    ELzmaFinishMode finish_mode = LZMA_FINISH_ANY;
+    if (dictionary_limit - dictionary_position >= remaining) {
+      dictionary_limit = dictionary_position + static_cast<SizeT>(remaining);
+      finish_mode = LZMA_FINISH_END;
+    }
+
+    SizeT processed = packed_size;
+    ELzmaStatus status = LZMA_STATUS_NOT_SPECIFIED;
+    const SRes decode_result = is_lzma2 ?
+        Lzma2Dec_DecodeToDic(&lzma2_state,
+                             dictionary_limit,
+                             packed_buffer,
+                             &processed,
+                             finish_mode,
+                             &status) :
+        LzmaDec_DecodeToDic(&lzma_state,
+                            dictionary_limit,
+                            packed_buffer,
+                            &processed,
+                            finish_mode,
+                            &status);
+    if (SZ_OK != decode_result) {
+      result = false;
+      break;
+    }
+    packed_buffer += processed;
+    packed_size -= processed;
+
+    const SizeT decoded = lzma_state.dicPos - dictionary_position;
+    if (!decoded && !processed) {
+      // The input is truncated.
+      result = false;
+      break;
+    }
+    remaining -= decoded;
+
+    if (decoded &&
+        !decoder->Write(lzma_state.dic + dictionary_position, decoded)) {
+      result = false;
+      break;
+    }
+  }
+
+  LzmaDec_FreeProbs(&lzma_state, &allocators);
+  return result;
+}
+
+}  // namespace
+
+bool DecodePayload(const uint8* payload,
+                   size_t payload_size,
+                   Bcj2Decoder::OutputCallback callback,
+                   void* callback_context) {
+  Bcj2Decoder decoder(callback, callback_context);
+  return DecompressBuffer(payload, payload_size, &decoder) &&
+         decoder.Finish();
+}
+
+}  // namespace omaha
@@ -0,0 +1,48 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// Decodes the metainstaller payload, which is the BCJ2-encoded tarball
+// compressed in one of two formats:
+// - the .lzma format written by lzma.exe, which starts with the five LZMA
+//   properties bytes and the 64-bit unpacked size.
+// - the LZMA2 format written by x86_encoder/package_payload.exe, which starts
+//   with kLzma2PayloadMarker, the LZMA2 properties byte, and the 64-bit
+//   unpacked size. The LZMA2 blocks are compressed in parallel.
+// The payload is decoded as a stream: the LZMA dictionary and the small BCJ2
+// streams are the only buffers, so the memory use does not grow with the size
+// of the tarball.
+
+#ifndef OMAHA_MI_EXE_STUB_PAYLOAD_DECODER_H_
+#define OMAHA_MI_EXE_STUB_PAYLOAD_DECODER_H_
+
+#include <windows.h>
+#include "omaha/mi_exe_stub/bcj2_decoder.h"
+
+namespace omaha {
+
+// The first byte of an LZMA2 payload. The first byte of the .lzma format
+// encodes the lc, lp, and pb parameters and is always smaller than 225.
+const uint8 kLzma2PayloadMarker = 0xFF;
+
+// Decodes |payload| and hands the decoded data to |callback| in chunks.
+// Returns true if the entire payload has been decoded.
+bool DecodePayload(const uint8* payload,
+                   size_t payload_size,
+                   Bcj2Decoder::OutputCallback callback,
+                   void* callback_context);
+
+}  // namespace omaha
+
+#endif  // OMAHA_MI_EXE_STUB_PAYLOAD_DECODER_H_
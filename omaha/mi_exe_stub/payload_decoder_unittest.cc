@@ -0,0 +1,509 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/mi_exe_stub/payload_decoder.h"
+
+#include <psapi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "omaha/base/app_util.h"
+#include "omaha/base/file.h"
+#include "omaha/base/highres_timer-win32.h"
+#include "omaha/base/utils.h"
+#include "omaha/mi_exe_stub/bcj2_decoder.h"
+#include "omaha/mi_exe_stub/tar.h"
+#include "omaha/mi_exe_stub/x86_encoder/bcj2_encoder.h"
+#include "omaha/testing/unit_test.h"
+extern "C" {
+#include "third_party/lzma/files/C/LzmaDec.h"
+#include "third_party/lzma/files/C/LzmaEnc.h"
+}
+
+namespace omaha {
+
+namespace {
+
+typedef std::vector<std::pair<std::string, std::string> > TarEntries;
+
+void* LzmaAlloc(void* p, size_t size) {
+  UNREFERENCED_PARAMETER(p);
+  return malloc(size);
+}
+
+void LzmaFree(void* p, void* address) {
+  UNREFERENCED_PARAMETER(p);
+  free(address);
+}
+
+ISzAlloc lzma_allocators = { &LzmaAlloc, &LzmaFree };
+
+std::string ReadModule() {
+  CString module_path = app_util::GetModulePath(NULL);
+  std::vector<byte> raw_file;
+  if (FAILED(ReadEntireFileShareMode(module_path, 0, FILE_SHARE_READ,
+                                     &raw_file)) ||
+      raw_file.empty()) {
+    return std::string();
+  }
+  return std::string(reinterpret_cast<char*>(&raw_file[0]), raw_file.size());
+}
+
+// Builds a USTAR archive the same way the tarfile module used by the build
+// does: one header block per file, the data padded to 512 bytes, and two zero
+// blocks at the end.
+std::string MakeTarball(const TarEntries& entries) {
+  std::string tarball;
+  for (size_t i = 0; i != entries.size(); ++i) {
+    USTARHeader header = {};
+    strncpy_s(header.name, entries[i].first.c_str(), _TRUNCATE);
+    strcpy_s(header.mode, "0000644");
+    strcpy_s(header.uid, "0000000");
+    strcpy_s(header.gid, "0000000");
+    sprintf_s(header.size, "%011I64o",
+              static_cast<uint64>(entries[i].second.size()));
+    strcpy_s(header.mtime, "00000000000");
+    header.typeflag = '0';
+    memcpy(header.magic, "ustar", 6);
+    memcpy(header.version, "00", 2);
+
+    memset(header.chksum, ' ', sizeof(header.chksum));
+    unsigned int checksum = 0;
+    const uint8* header_bytes = reinterpret_cast<const uint8*>(&header);
+    for (size_t j = 0; j != sizeof(header); ++j) {
+      checksum += header_bytes[j];
+    }
+    sprintf_s(header.chksum, "%06o", checksum);
+
+    tarball.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    tarball.append(entries[i].second);
+    tarball.append((512 - entries[i].second.size() % 512) % 512, '\0');
+  }
+  tarball.append(2 * 512, '\0');
+  return tarball;
+}
+
+// Compresses |input| into the .lzma format written by lzma.exe.
+std::string CompressPayload(const std::string& input, int level) {
+  CLzmaEncProps props;
+  LzmaEncProps_Init(&props);
+  props.level = level;
+  props.dictSize = 1 << 24;
+
+  size_t compressed_size = input.size() + input.size() / 2 + 64 * 1024;
+  std::string output(LZMA_PROPS_SIZE + 8 + compressed_size, '\0');
+  uint8* output_bytes = reinterpret_cast<uint8*>(&output[0]);
+  SizeT props_size = LZMA_PROPS_SIZE;
+  if (SZ_OK != LzmaEncode(output_bytes + LZMA_PROPS_SIZE + 8,
+                          &compressed_size,
+                          reinterpret_cast<const uint8*>(input.data()),
+                          input.size(),
+                          &props,
+                          output_bytes,
+                          &props_size,
+                          0,
+                          NULL,
+                          &lzma_allocators,
+                          &lzma_allocators)) {
+    return std::string();
+  }
+
+  const uint64 input_size = input.size();
+  for (size_t i = 0; i != sizeof(input_size); ++i) {
+    output_bytes[LZMA_PROPS_SIZE + i] = static_cast<uint8>(input_size >> 8 * i);
+  }
+  output.resize(LZMA_PROPS_SIZE + 8 + compressed_size);
+  return output;
+}
+
+bool AppendToString(void* context, const uint8* data, size_t size) {
+  reinterpret_cast<std::string*>(context)->append(
+      reinterpret_cast<const char*>(data), size);
+  return true;
+}
+
+bool Bcj2Decode(const std::string& payload,
+                size_t chunk_size,
+                std::string* output) {
+  Bcj2Decoder decoder(AppendToString, output);
+  const uint8* data = reinterpret_cast<const uint8*>(payload.data());
+  for (size_t i = 0; i < payload.size(); i += chunk_size) {
+    if (!decoder.Write(data + i, std::min(chunk_size, payload.size() - i))) {
+      return false;
+    }
+  }
+  return decoder.Finish();
+}
+
+bool WriteToTar(void* context, const uint8* data, size_t size) {
+  return reinterpret_cast<Tar*>(context)->Write(data, size);
+}
+
+}  // namespace
+
+TEST(Bcj2DecoderTest, EmptyPayload) {
+  std::string payload;
+  ASSERT_TRUE(Bcj2EncodePayload(std::string(), &payload));
+
+  std::string output;
+  EXPECT_TRUE(Bcj2Decode(payload, payload.size(), &output));
+  EXPECT_TRUE(output.empty());
+}
+
+// The victim program is the unit test itself.
+TEST(Bcj2DecoderTest, Reversible) {
+  const std::string input(ReadModule());
+  ASSERT_FALSE(input.empty());
+
+  std::string payload;
+  ASSERT_TRUE(Bcj2EncodePayload(input, &payload));
+
+  const size_t kChunkSizes[] = { 1, 3, 4096, payload.size() };
+  for (size_t i = 0; i != arraysize(kChunkSizes); ++i) {
+    std::string output;
+    EXPECT_TRUE(Bcj2Decode(payload, kChunkSizes[i], &output));
+    EXPECT_TRUE(input == output) << kChunkSizes[i];
+  }
+}
+
+TEST(Bcj2DecoderTest, TruncatedPayload) {
+  const std::string input(ReadModule());
+  ASSERT_FALSE(input.empty());
+
+  std::string payload;
+  ASSERT_TRUE(Bcj2EncodePayload(input, &payload));
+
+  std::string output;
+  EXPECT_FALSE(Bcj2Decode(payload.substr(0, payload.size() - 1), 4096,
+                          &output));
+  output.clear();
+  EXPECT_FALSE(Bcj2Decode(payload.substr(0, 20), 4096, &output));
+}
+
+TEST(Bcj2DecoderTest, CallbackFails) {
+  std::string payload;
+  ASSERT_TRUE(Bcj2EncodePayload(std::string(100, 'a'), &payload));
+
+  struct Failing {
+    static bool Output(void*, const uint8*, size_t) { return false; }
+  };
+  Bcj2Decoder decoder(Failing::Output, NULL);
+  EXPECT_TRUE(decoder.Write(reinterpret_cast<const uint8*>(payload.data()),
+                            payload.size()));
+  EXPECT_FALSE(decoder.Finish());
+}
+
+class PayloadDecoderTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    target_dir_ = GetTempFilenameAt(app_util::GetTempDir(), _T("mit"));
+    ASSERT_FALSE(target_dir_.IsEmpty());
+    ::DeleteFile(target_dir_);
+    ASSERT_HRESULT_SUCCEEDED(CreateDir(target_dir_, NULL));
+  }
+
+  virtual void TearDown() {
+    EXPECT_HRESULT_SUCCEEDED(DeleteDirectory(target_dir_));
+  }
+
+  static void TarFileCallback(void* context, const TCHAR* filename) {
+    reinterpret_cast<std::vector<CString>*>(context)->push_back(filename);
+  }
+
+  std::string ReadTargetFile(const TCHAR* name) {
+    CString path(target_dir_ + _T("\\") + name);
+    std::vector<byte> contents;
+    if (FAILED(ReadEntireFile(path, 0, &contents)) || contents.empty()) {
+      return std::string();
+    }
+    return std::string(reinterpret_cast<char*>(&contents[0]), contents.size());
+  }
+
+  CString target_dir_;
+};
+
+TEST_F(PayloadDecoderTest, Tar) {
+  TarEntries entries;
+  entries.push_back(std::make_pair("empty.txt", std::string()));
+  entries.push_back(std::make_pair("setup.exe", std::string(1000, 'x')));
+  entries.push_back(std::make_pair("block.dat", std::string(512, 'y')));
+  const std::string tarball(MakeTarball(entries));
+
+  std::vector<CString> files;
+  {
+    Tar tar(target_dir_, true);
+    tar.SetCallback(TarFileCallback, &files);
+    const uint8* data = reinterpret_cast<const uint8*>(tarball.data());
+    for (size_t i = 0; i < tarball.size(); i += 7) {
+      ASSERT_TRUE(tar.Write(data + i, std::min<size_t>(7, tarball.size() - i)));
+    }
+    EXPECT_TRUE(tar.IsDone());
+
+    ASSERT_EQ(3, files.size());
+    EXPECT_STREQ(target_dir_ + _T("\\empty.txt"), files[0]);
+    EXPECT_STREQ(target_dir_ + _T("\\setup.exe"), files[1]);
+    EXPECT_STREQ(target_dir_ + _T("\\block.dat"), files[2]);
+    EXPECT_TRUE(File::Exists(files[0]));
+    EXPECT_EQ(entries[1].second, ReadTargetFile(_T("setup.exe")));
+    EXPECT_EQ(entries[2].second, ReadTargetFile(_T("block.dat")));
+  }
+
+  // The files are deleted with the archive.
+  for (size_t i = 0; i != files.size(); ++i) {
+    EXPECT_FALSE(File::Exists(files[i]));
+  }
+}
+
+TEST_F(PayloadDecoderTest, Tar_NotAnArchive) {
+  const std::string data(1024, 'z');
+  Tar tar(target_dir_, true);
+  EXPECT_FALSE(tar.Write(reinterpret_cast<const uint8*>(data.data()),
+                         data.size()));
+  EXPECT_FALSE(tar.IsDone());
+}
+
+TEST_F(PayloadDecoderTest, DecodePayload) {
+  const std::string module(ReadModule());
+  ASSERT_FALSE(module.empty());
+
+  TarEntries entries;
+  entries.push_back(std::make_pair("setup.exe", module));
+  const std::string tarball(MakeTarball(entries));
+
+  std::string bcj2_payload;
+  ASSERT_TRUE(Bcj2EncodePayload(tarball, &bcj2_payload));
+  const std::string payload(CompressPayload(bcj2_payload, 5));
+  ASSERT_FALSE(payload.empty());
+
+  std::string output;
+  EXPECT_TRUE(DecodePayload(reinterpret_cast<const uint8*>(payload.data()),
+                            payload.size(),
+                            AppendToString,
+                            &output));
+  EXPECT_TRUE(tarball == output);
+
+  output.clear();
+  EXPECT_FALSE(DecodePayload(reinterpret_cast<const uint8*>(payload.data()),
+                             payload.size() / 2,
+                             AppendToString,
+                             &output));
+
+  std::vector<CString> files;
+  Tar tar(target_dir_, true);
+  tar.SetCallback(TarFileCallback, &files);
+  EXPECT_TRUE(DecodePayload(reinterpret_cast<const uint8*>(payload.data()),
+                            payload.size(),
+                            WriteToTar,
+                            &tar));
+  EXPECT_TRUE(tar.IsDone());
+  ASSERT_EQ(1, files.size());
+  EXPECT_TRUE(module == ReadTargetFile(_T("setup.exe")));
+}
+
+// Measures how long the metainstaller takes to extract a 150MB payload before
+// it can run the setup program, and how much the working set grows while
+// doing so. The "buffered" run reproduces the previous implementation, which
+// decoded the whole payload in memory and extracted it from a temporary file.
+class PayloadDecoderBenchmark : public PayloadDecoderTest {
+ protected:
+  PayloadDecoderBenchmark()
+      : tar_(NULL),
+        first_file_ms_(0),
+        peak_working_set_(0),
+        bytes_since_sample_(0) {}
+
+  void StartMeasurement() {
+    // Trim the working set so that the growth during the run is measured.
+    VERIFY1(::SetProcessWorkingSetSize(::GetCurrentProcess(),
+                                       static_cast<SIZE_T>(-1),
+                                       static_cast<SIZE_T>(-1)));
+    peak_working_set_ = 0;
+    baseline_working_set_ = GetWorkingSet();
+    first_file_ms_ = 0;
+    bytes_since_sample_ = 0;
+    timer_.Start();
+  }
+
+  void Report(const char* mode) {
+    SampleWorkingSet();
+    std::cout << mode << ": first file " << first_file_ms_ << " ms"
+              << ", time to first exec " << timer_.GetElapsedMs() << " ms"
+              << ", peak working set growth "
+              << (peak_working_set_ - baseline_working_set_) / (1024 * 1024)
+              << " MB" << std::endl;
+  }
+
+  static SIZE_T GetWorkingSet() {
+    PROCESS_MEMORY_COUNTERS counters = { sizeof(counters), 0 };
+    VERIFY1(::GetProcessMemoryInfo(::GetCurrentProcess(),
+                                   &counters,
+                                   sizeof(counters)));
+    return counters.WorkingSetSize;
+  }
+
+  void SampleWorkingSet() {
+    peak_working_set_ = std::max(peak_working_set_, GetWorkingSet());
+  }
+
+  static void FileExtracted(void* context, const TCHAR* filename) {
+    UNREFERENCED_PARAMETER(filename);
+    PayloadDecoderBenchmark* benchmark =
+        reinterpret_cast<PayloadDecoderBenchmark*>(context);
+    if (!benchmark->first_file_ms_) {
+      benchmark->first_file_ms_ = benchmark->timer_.GetElapsedMs();
+    }
+    benchmark->SampleWorkingSet();
+  }
+
+  static bool Write(void* context, const uint8* data, size_t size) {
+    const size_t kSampleInterval = 1024 * 1024;
+    PayloadDecoderBenchmark* benchmark =
+        reinterpret_cast<PayloadDecoderBenchmark*>(context);
+    benchmark->bytes_since_sample_ += size;
+    if (benchmark->bytes_since_sample_ >= kSampleInterval) {
+      benchmark->bytes_since_sample_ = 0;
+      benchmark->SampleWorkingSet();
+    }
+    return benchmark->tar_->Write(data, size);
+  }
+
+  Tar* tar_;
+  HighresTimer timer_;
+  ULONGLONG first_file_ms_;
+  SIZE_T baseline_working_set_;
+  SIZE_T peak_working_set_;
+  size_t bytes_since_sample_;
+};
+
+TEST_F(PayloadDecoderBenchmark, DISABLED_Extract150MB) {
+  const size_t kPayloadSize = 150 * 1024 * 1024;
+
+  std::string payload;
+  {
+    // The payload is made of x86 code: the setup program is the unit test
+    // itself and the data file is made of altered copies of it.
+    const std::string module(ReadModule());
+    ASSERT_FALSE(module.empty());
+
+    TarEntries entries;
+    entries.push_back(std::make_pair("setup.exe", module));
+    entries.push_back(std::make_pair("data.bin", std::string()));
+    std::string& data = entries[1].second;
+    data.reserve(kPayloadSize);
+    for (uint8 copy = 0; data.size() < kPayloadSize - module.size(); ++copy) {
+      const size_t offset = data.size();
+      const size_t remaining = kPayloadSize - module.size() - offset;
+      data.append(module, 0, std::min(module.size(), remaining));
+      for (size_t i = offset; i < data.size(); i += 64) {
+        data[i] ^= copy;
+      }
+    }
+
+    std::string bcj2_payload;
+    ASSERT_TRUE(Bcj2EncodePayload(MakeTarball(entries), &bcj2_payload));
+    payload = CompressPayload(bcj2_payload, 1);
+    ASSERT_FALSE(payload.empty());
+  }
+  const uint8* payload_data = reinterpret_cast<const uint8*>(payload.data());
+
+  {
+    Tar tar(target_dir_, true);
+    tar.SetCallback(FileExtracted, this);
+    tar_ = &tar;
+
+    StartMeasurement();
+    EXPECT_TRUE(DecodePayload(payload_data, payload.size(), Write, this));
+    EXPECT_TRUE(tar.IsDone());
+    Report("streaming");
+  }
+
+  {
+    Tar tar(target_dir_, true);
+    tar.SetCallback(FileExtracted, this);
+    tar_ = &tar;
+
+    StartMeasurement();
+
+    // Decode the LZMA stream and the BCJ2 payload into memory.
+    uint64 unpacked_size = 0;
+    for (size_t i = 0; i != sizeof(unpacked_size); ++i) {
+      unpacked_size |=
+          static_cast<uint64>(payload_data[LZMA_PROPS_SIZE + i]) << (8 * i);
+    }
+    SizeT output_size = static_cast<SizeT>(unpacked_size);
+    std::unique_ptr<uint8[]> unpacked(new uint8[output_size]);
+    SizeT input_size = payload.size() - LZMA_PROPS_SIZE - 8;
+    ELzmaStatus status = LZMA_STATUS_NOT_SPECIFIED;
+    ASSERT_EQ(SZ_OK, LzmaDecode(unpacked.get(),
+                                &output_size,
+                                payload_data + LZMA_PROPS_SIZE + 8,
+                                &input_size,
+                                payload_data,
+                                LZMA_PROPS_SIZE,
+                                LZMA_FINISH_END,
+                                &status,
+                                &lzma_allocators));
+    SampleWorkingSet();
+
+    std::string tarball;
+    {
+      Bcj2Decoder decoder(AppendToString, &tarball);
+      ASSERT_TRUE(decoder.Write(unpacked.get(), output_size));
+      ASSERT_TRUE(decoder.Finish());
+    }
+    SampleWorkingSet();
+    unpacked.reset();
+
+    // Write the tarball to a temporary file and extract it from there.
+    CString tarball_path(target_dir_ + _T("\\tarball.tar"));
+    {
+      File file;
+      ASSERT_HRESULT_SUCCEEDED(file.Open(tarball_path, true, false));
+      uint32 bytes_written = 0;
+      ASSERT_HRESULT_SUCCEEDED(file.Write(
+          reinterpret_cast<const uint8*>(tarball.data()),
+          static_cast<uint32>(tarball.size()),
+          &bytes_written));
+    }
+    tarball.clear();
+    tarball.shrink_to_fit();
+
+    {
+      File file;
+      ASSERT_HRESULT_SUCCEEDED(file.Open(tarball_path, false, false));
+      const uint32 kCopyBufferSize = 256 * 1024;
+      std::unique_ptr<uint8[]> copy_buffer(new uint8[kCopyBufferSize]);
+      uint32 bytes_read = 0;
+      do {
+        ASSERT_HRESULT_SUCCEEDED(file.Read(kCopyBufferSize,
+                                           copy_buffer.get(),
+                                           &bytes_read));
+        ASSERT_TRUE(Write(this, copy_buffer.get(), bytes_read));
+      } while (bytes_read && !tar.IsDone());
+    }
+    EXPECT_TRUE(tar.IsDone());
+    Report("buffered");
+
+    EXPECT_TRUE(::DeleteFile(tarball_path));
+  }
+}
+
+}  // namespace omaha
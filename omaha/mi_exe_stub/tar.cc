@@ -16,11 +16,9 @@
 
 #include "omaha/mi_exe_stub/tar.h"
 #include <windows.h>
-#pragma warning(push)
-// C4310: cast truncates constant value
-#pragma warning(disable : 4310)
-#include "base/basictypes.h"
-#pragma warning(pop)
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
 
 namespace omaha {
 
@@ -29,102 +27,138 @@ namespace {
 const char kUstarMagic[] = "ustar";
 const char kUstarDone[5] = { '\0', '\0', '\0', '\0', '\0' };
 
+const size_t kBlockSize = 512;
+
+// WriteFile writes at most DWORD_MAX bytes per call.
+const size_t kMaxWriteSize = 64 * 1024 * 1024;
+
 }  // namespace
 
-Tar::Tar(const CString& target_dir, HANDLE file_handle, bool delete_when_done)
+Tar::Tar(const CString& target_dir, bool delete_when_done)
     : target_directory_name_(target_dir),
-      file_handle_(file_handle),
       delete_when_done_(delete_when_done),
       callback_(NULL),
-      callback_context_(NULL) {}
+      callback_context_(NULL),
+      header_size_(0),
+      file_handle_(INVALID_HANDLE_VALUE),
+      file_remaining_(0),
+      padding_remaining_(0),
+      done_(false),
+      failed_(false) {}
 
 Tar::~Tar() {
+  if (file_handle_ != INVALID_HANDLE_VALUE) {
+    CloseHandle(file_handle_);
+  }
   for (int i = 0; i != files_to_delete_.GetSize(); ++i) {
     DeleteFile(files_to_delete_[i]);
   }
 }
 
-bool Tar::ExtractToDir() {
-  bool done = false;
-  do {
-    if (!ExtractOneFile(&done)) {
-      return false;
+bool Tar::Write(const uint8* data, size_t size) {
+  if (failed_) {
+    return false;
+  }
+
+  // The data after the end of the archive is padding.
+  while (size && !done_) {
+    if (file_remaining_) {
+      const DWORD bytes_to_handle = static_cast<DWORD>(std::min(
+          static_cast<uint64>(std::min(size, kMaxWriteSize)),
+          file_remaining_));
+      DWORD bytes_handled = 0;
+      if (!::WriteFile(file_handle_, data, bytes_to_handle, &bytes_handled,
+                       NULL) ||
+          bytes_handled != bytes_to_handle) {
+        failed_ = true;
+        return false;
+      }
+      data += bytes_to_handle;
+      size -= bytes_to_handle;
+      file_remaining_ -= bytes_to_handle;
+      if (!file_remaining_) {
+        CompleteFile();
+      }
+    } else if (padding_remaining_) {
+      const size_t bytes_to_skip = std::min(size, padding_remaining_);
+      data += bytes_to_skip;
+      size -= bytes_to_skip;
+      padding_remaining_ -= bytes_to_skip;
+    } else {
+      const size_t bytes_to_copy = std::min(size,
+                                            sizeof(header_) - header_size_);
+      memcpy(reinterpret_cast<uint8*>(&header_) + header_size_,
+             data,
+             bytes_to_copy);
+      data += bytes_to_copy;
+      size -= bytes_to_copy;
+      header_size_ += bytes_to_copy;
+      if (header_size_ == sizeof(header_)) {
+        header_size_ = 0;
+        if (!StartFile()) {
+          failed_ = true;
+          return false;
+        }
+      }
     }
-  } while (!done);
+  }
+
   return true;
 }
 
-bool Tar::ExtractOneFile(bool *done) {
-  USTARHeader header;
-  DWORD bytes_handled;
-  bool result = true;
-  BOOL file_result;
+bool Tar::StartFile() {
+  COMPILE_ASSERT(sizeof(USTARHeader) == kBlockSize, invalid_header_size);
 
-  file_result = ::ReadFile(file_handle_, &header, sizeof(USTARHeader),
-      &bytes_handled, NULL);
-  if (!file_result || bytes_handled != sizeof(USTARHeader)) {
-    return false;
-  }
-  if (0 == memcmp(header.magic, kUstarDone, arraysize(kUstarDone) - 1)) {
+  if (0 == memcmp(header_.magic, kUstarDone, arraysize(kUstarDone) - 1)) {
     // We're probably done, since we read the final block of all zeroes.
-    *done = true;
+    done_ = true;
     return true;
   }
-  if (0 != memcmp(header.magic, kUstarMagic, arraysize(kUstarMagic) - 1)) {
+  if (0 != memcmp(header_.magic, kUstarMagic, arraysize(kUstarMagic) - 1)) {
     return false;
   }
+
+  // The name is not terminated if it is exactly kNameSize characters long.
+  CStringA name(header_.name,
+                static_cast<int>(strnlen(header_.name, kNameSize)));
   CString new_filename(target_directory_name_);
   new_filename += "\\";
-  new_filename += header.name;
-  HANDLE new_file = ::CreateFile(new_filename, GENERIC_WRITE, 0, NULL,
+  new_filename += name;
+  file_handle_ = ::CreateFile(new_filename, GENERIC_WRITE, 0, NULL,
       CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY, NULL);
-  if (new_file == INVALID_HANDLE_VALUE) {
+  if (file_handle_ == INVALID_HANDLE_VALUE) {
     return false;
   }
+  file_name_ = new_filename;
+
+  // A partially written file is deleted too.
+  if (delete_when_done_) {
+    files_to_delete_.Add(file_name_);
+  }
+
   // We don't check for conversion errors because the input data is fixed at
   // build time, so it'll either always work or never work, and we won't ship
-  // one that never works.
-  DWORD tar_file_size = strtol(header.size, NULL, 8);  // NOLINT
-  DWORD next_offset = ::SetFilePointer(file_handle_, 0, NULL, FILE_CURRENT) +
-      tar_file_size + (512 - tar_file_size & 0x1ff);
-  while (tar_file_size > 0) {
-    const int kCopyBufferSize = 256 * 1024;
-    char copy_buffer[kCopyBufferSize];
-    DWORD bytes_to_handle = kCopyBufferSize;
-    if (bytes_to_handle > tar_file_size) {
-      bytes_to_handle = tar_file_size;
-    }
-    file_result = ::ReadFile(file_handle_, copy_buffer, bytes_to_handle,
-        &bytes_handled, NULL);
-    if (!file_result) {
-      result = false;
-      break;
-    } else {
-      file_result = ::WriteFile(new_file, copy_buffer, bytes_to_handle,
-          &bytes_handled, NULL);
-      if (!file_result) {
-        result = false;
-        break;
-      } else {
-        tar_file_size -= bytes_to_handle;
-      }
-    }
-  }
-  CloseHandle(new_file);
-  if (result) {
-    if (delete_when_done_) {
-      files_to_delete_.Add(new_filename);
-    }
-    if (callback_ != NULL) {
-      callback_(callback_context_, new_filename);
-    }
+  // one that never works. The size is parsed as a 64-bit integer, therefore
+  // files larger than 4GB are supported.
+  char size_field[sizeof(header_.size) + 1] = {};
+  memcpy(size_field, header_.size, sizeof(header_.size));
+  file_remaining_ = _strtoui64(size_field, NULL, 8);
+  padding_remaining_ =
+      static_cast<size_t>((kBlockSize - file_remaining_ % kBlockSize) %
+                          kBlockSize);
+  if (!file_remaining_) {
+    CompleteFile();
   }
+  return true;
+}
 
-  if (INVALID_SET_FILE_POINTER != next_offset) {
-    SetFilePointer(file_handle_, next_offset, NULL, FILE_BEGIN);
-  }
+void Tar::CompleteFile() {
+  CloseHandle(file_handle_);
+  file_handle_ = INVALID_HANDLE_VALUE;
 
-  return result;
+  if (callback_ != NULL) {
+    callback_(callback_context_, file_name_);
+  }
 }
 
 }  // namespace omaha
@@ -22,6 +22,12 @@
 #include <atlsimpcoll.h>
 #include <atlstr.h>
 
+#pragma warning(push)
+// C4310: cast truncates constant value
+#pragma warning(disable : 4310)
+#include "base/basictypes.h"
+#pragma warning(pop)
+
 namespace omaha {
 
 static const int kNameSize = 100;
@@ -47,10 +53,12 @@ typedef struct {
 } USTARHeader;
 
 // Supports untarring of files from a tar-format archive. Pretty minimal;
-// doesn't work with everything in the USTAR format.
+// doesn't work with everything in the USTAR format. The archive is written to
+// the object in chunks of any size and the files are written to the target
+// directory as their data arrives, so the archive itself is never stored.
 class Tar {
  public:
-  Tar(const CString& target_dir, HANDLE file_handle, bool delete_when_done);
+  Tar(const CString& target_dir, bool delete_when_done);
   ~Tar();
 
   typedef void (*TarFileCallback)(void* context, const TCHAR* filename);
@@ -60,19 +68,37 @@ class Tar {
     callback_context_ = callback_context;
   }
 
-  // Extracts all files in archive to directory specified in constructor.
-  // Directory must exist. Returns true if successful.
-  bool ExtractToDir();
+  // Extracts the files in the next |size| bytes of the archive to the
+  // directory specified in the constructor. Directory must exist. Returns
+  // false if the archive is not valid or if a file could not be written.
+  bool Write(const uint8* data, size_t size);
+
+  // Returns true if the end of the archive has been reached.
+  bool IsDone() const { return done_; }
 
  private:
+  // Called when the header of the next file has been received.
+  bool StartFile();
+
+  // Called when all the data of the current file has been written.
+  void CompleteFile();
+
   CString target_directory_name_;
-  HANDLE file_handle_;
   bool delete_when_done_;
   CSimpleArray<CString> files_to_delete_;
   TarFileCallback callback_;
   void* callback_context_;
 
-  bool ExtractOneFile(bool* done);
+  USTARHeader header_;
+  size_t header_size_;
+
+  HANDLE file_handle_;
+  CString file_name_;
+  uint64 file_remaining_;
+  size_t padding_remaining_;
+
+  bool done_;
+  bool failed_;
 };
 
 }  // namespace omaha
@@ -15,7 +15,7 @@
 //
 // BCJ encodes a file to increase its compressibility.
 
-#include <memory>
+#include <algorithm>
 #include <string>
 #include <windows.h>
 #include <intsafe.h>
@@ -44,86 +44,33 @@ int wmain(int argc, WCHAR* argv[], WCHAR* env[]) {
     return 3;
   }
 
-  DWORD file_size = static_cast<DWORD>(file_size_data.QuadPart);
-  std::unique_ptr<uint8[]> buffer(new uint8[file_size]);
-  DWORD bytes_read = 0;
-  if (!::ReadFile(get(file), buffer.get(), file_size, &bytes_read, NULL) ||
-      bytes_read != file_size) {
-    return 4;
-  }
-
-  std::string out1;
-  std::string out2;
-  std::string out3;
-  std::string out4;
-  if (!omaha::Bcj2Encode(std::string(reinterpret_cast<char*>(buffer.get()),
-                                     file_size),
-                         &out1, &out2, &out3, &out4)) {
-    return 5;
-  }
-
-  // The format of BCJ2 file is very primitive.
-  // Header is 5 32-bit ints, with the following information:
-  //   unpacked size
-  //   size of stream 1
-  //   size of stream 2
-  //   size of stream 3
-  //   size of stream 4
-  const size_t output_buffer_length = 5 * sizeof(uint32) +  // NOLINT
-      out1.size() + out2.size() + out3.size() + out4.size();
-  if (output_buffer_length > DWORD_MAX) {
+  const uint64 file_size = static_cast<uint64>(file_size_data.QuadPart);
+  if (file_size > std::string().max_size()) {
     return 13;
   }
 
-  size_t buffer_remaining = output_buffer_length;
-  std::unique_ptr<uint8[]> output_buffer(new uint8[output_buffer_length]);
-  uint8* p = output_buffer.get();
-  *reinterpret_cast<uint32*>(p) = bytes_read;
-  p += sizeof(uint32);                                                // NOLINT
-  buffer_remaining -= sizeof(uint32);                                 // NOLINT
-  *reinterpret_cast<uint32*>(p) = static_cast<uint32>(out1.size());
-  p += sizeof(uint32);                                                // NOLINT
-  buffer_remaining -= sizeof(uint32);                                 // NOLINT
-  *reinterpret_cast<uint32*>(p) = static_cast<uint32>(out2.size());
-  p += sizeof(uint32);                                                // NOLINT
-  buffer_remaining -= sizeof(uint32);                                 // NOLINT
-  *reinterpret_cast<uint32*>(p) = static_cast<uint32>(out3.size());
-  p += sizeof(uint32);                                                // NOLINT
-  buffer_remaining -= sizeof(uint32);                                 // NOLINT
-  *reinterpret_cast<uint32*>(p) = static_cast<uint32>(out4.size());
-  p += sizeof(uint32);                                                // NOLINT
-  buffer_remaining -= sizeof(uint32);                                 // NOLINT
-  if (!out1.empty()) {
-    if (0 != memcpy_s(p, buffer_remaining, &out1[0], out1.size())) {
-      return 9;
-    }
-    p += out1.size();
-    buffer_remaining -= out1.size();
-  }
-  if (!out2.empty()) {
-    if (0 != memcpy_s(p, buffer_remaining, &out2[0], out2.size())) {
-      return 10;
-    }
-    p += out2.size();
-    buffer_remaining -= out2.size();
-  }
-  if (!out3.empty()) {
-    if (0 != memcpy_s(p, buffer_remaining, &out3[0], out3.size())) {
-      return 11;
-    }
-    p += out3.size();
-    buffer_remaining -= out3.size();
-  }
-  if (!out4.empty()) {
-    if (0 != memcpy_s(p, buffer_remaining, &out4[0], out4.size())) {
-      return 12;
+  // ReadFile and WriteFile transfer at most DWORD_MAX bytes per call.
+  const size_t kMaxChunkSize = 64 * 1024 * 1024;
+
+  std::string input;
+  input.resize(static_cast<size_t>(file_size));
+  for (size_t offset = 0; offset < input.size();) {
+    const DWORD chunk_size = static_cast<DWORD>(
+        std::min(input.size() - offset, kMaxChunkSize));
+    DWORD bytes_read = 0;
+    if (!::ReadFile(get(file), &input[offset], chunk_size, &bytes_read,
+                    NULL) ||
+        bytes_read != chunk_size) {
+      return 4;
     }
-    p += out4.size();
-    buffer_remaining -= out4.size();
+    offset += bytes_read;
   }
-  if (p != output_buffer.get() + output_buffer_length ||
-      0 != buffer_remaining) {
-    return 8;
+
+  // The payload format is documented in bcj2_encoder.h. The sizes in the
+  // header are 64-bit, therefore the input is not limited to 4GB.
+  std::string output;
+  if (!omaha::Bcj2EncodePayload(input, &output)) {
+    return 5;
   }
 
   reset(file, ::CreateFile(argv[2], GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, 0,
@@ -132,12 +79,16 @@ int wmain(int argc, WCHAR* argv[], WCHAR* env[]) {
     return 6;
   }
 
-  DWORD bytes_written = 0;
-  if (!::WriteFile(get(file),
-                   output_buffer.get(),
-                   static_cast<DWORD>(output_buffer_length),
-                   &bytes_written, NULL)) {
-    return 7;
+  for (size_t offset = 0; offset < output.size();) {
+    const DWORD chunk_size = static_cast<DWORD>(
+        std::min(output.size() - offset, kMaxChunkSize));
+    DWORD bytes_written = 0;
+    if (!::WriteFile(get(file), &output[offset], chunk_size, &bytes_written,
+                     NULL) ||
+        bytes_written != chunk_size) {
+      return 7;
+    }
+    offset += bytes_written;
   }
 
   return 0;
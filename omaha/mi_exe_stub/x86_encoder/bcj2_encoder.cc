@@ -66,9 +66,6 @@
 
 #include "omaha/mi_exe_stub/x86_encoder/bcj2_encoder.h"
 
-#include "base/basictypes.h"
-#include "omaha/mi_exe_stub/x86_encoder/range_encoder.h"
-
 namespace omaha {
 
 namespace {
@@ -85,10 +82,117 @@ int GetIndex(uint8 byte0, uint8 byte1) {
   return ((byte1 == 0xE8) ? byte0 : ((byte1 == 0xE9) ? 256 : 257));
 }
 
+void AppendUint64(uint64 value, std::string* output) {
+  for (int i = 0; i < 64; i += 8) {
+    *output += static_cast<uint8>(value >> i);
+  }
+}
+
 }  // namespace
 
+Bcj2Encoder::Bcj2Encoder(uint64 input_size)
+    : input_size_(input_size),
+      window_position_(0),
+      range_encoder_(&misc_output_),
+      previous_byte_(0) {
+}
+
 // Conversions from signed char to uint8/unsigned char are preserving the
 // bit pattern, which is the desired behavior for this implementation.
+void Bcj2Encoder::Encode(const uint8* data,
+                         size_t size,
+                         std::string* main_output) {
+  window_.append(reinterpret_cast<const char*>(data), size);
+
+  // The main stream is made of the input minus the targets of the converted
+  // jumps, so it is appended one run at a time.
+  size_t position = 0;
+  size_t run_start = 0;
+  while (position + 5 <= window_.size()) {
+    uint8 byte = window_[position];
+
+    if (!IsJ(previous_byte_, byte)) {
+      position++;
+      previous_byte_ = byte;
+      continue;
+    }
+
+    uint8 next_byte = window_[position + 4];
+    uint32 src =
+      static_cast<uint8>(next_byte) << 24 |
+      static_cast<uint8>(window_[position + 3]) << 16 |
+      static_cast<uint8>(window_[position + 2]) << 8 |
+      static_cast<uint8>(window_[position + 1]);
+
+    // Like the LZMA SDK encoder, the target is computed modulo 4GB, which
+    // makes backward jumps convertible too.
+    uint32 dst = static_cast<uint32>(window_position_ + position) + src + 5;
+
+    uint32 index = GetIndex(previous_byte_, byte);
+    if (dst < input_size_) {
+      status_encoder_[index].Encode(1, &range_encoder_);
+      main_output->append(window_, run_start, position + 1 - run_start);
+      position += 5;
+      run_start = position;
+      std::string* s = (byte == 0xE8) ? &call_output_ : &jump_output_;
+      for (int i = 24; i >= 0; i -= 8) {
+        *s += static_cast<uint8>(dst >> i);
+      }
+      previous_byte_ = next_byte;
+    } else {
+      status_encoder_[index].Encode(0, &range_encoder_);
+      position++;
+      previous_byte_ = byte;
+    }
+  }
+
+  main_output->append(window_, run_start, position - run_start);
+  window_.erase(0, position);
+  window_position_ += position;
+}
+
+bool Bcj2Encoder::Finish(std::string* main_output) {
+  for (size_t position = 0; position < window_.size(); ++position) {
+    uint8 byte = window_[position];
+    *main_output += byte;
+
+    size_t index;
+    if (0xE8 == byte) {
+      index = previous_byte_;
+    } else if (0xE9 == byte) {
+      index = 256;
+    } else if (IsJcc(previous_byte_, byte)) {
+      index = 257;
+    } else {
+      previous_byte_ = byte;
+      continue;
+    }
+    status_encoder_[index].Encode(0, &range_encoder_);
+    previous_byte_ = byte;
+  }
+
+  window_position_ += window_.size();
+  window_.clear();
+  range_encoder_.Flush();
+  return window_position_ == input_size_;
+}
+
+std::string Bcj2Encoder::GetPayloadPrefix(uint64 main_size) const {
+  std::string prefix;
+  prefix.reserve(5 * sizeof(uint64) +  // NOLINT
+                 call_output_.size() + jump_output_.size() +
+                 misc_output_.size());
+  AppendUint64(input_size_, &prefix);
+  AppendUint64(main_size, &prefix);
+  AppendUint64(call_output_.size(), &prefix);
+  AppendUint64(jump_output_.size(), &prefix);
+  AppendUint64(misc_output_.size(), &prefix);
+  prefix.append(call_output_);
+  prefix.append(jump_output_);
+  prefix.append(misc_output_);
+  return prefix;
+}
+
 bool Bcj2Encode(const std::string& input,
                 std::string* main_output,
                 std::string* call_output,
@@ -98,73 +202,37 @@ bool Bcj2Encode(const std::string& input,
     return false;
   }
 
-  size_t input_position = 0;
-
-  static const int kNumberOfMoveBits = 5;
-  RangeEncoder range_encoder(misc_output);
-  RangeEncoderBit<kNumberOfMoveBits> status_encoder[256 + 2];
-
-  uint8 previous_byte = 0;
-
-  while (true) {
-    if (input.size() - input_position < 5) {
-      for (; input_position < input.size(); ++input_position) {
-        uint8 byte = input[input_position];
-        *main_output += byte;
-
-        size_t index;
-        if (0xE8 == byte) {
-          index = previous_byte;
-        } else if (0xE9 == byte) {
-          index = 256;
-        } else if (IsJcc(previous_byte, byte)) {
-          index = 257;
-        } else {
-          previous_byte = byte;
-          continue;
-        }
-        status_encoder[index].Encode(0, &range_encoder);
-        previous_byte = byte;
-      }
-
-      range_encoder.Flush();
-      return true;
-    }
+  Bcj2Encoder encoder(input.size());
+  encoder.Encode(reinterpret_cast<const uint8*>(input.data()),
+                 input.size(),
+                 main_output);
+  if (!encoder.Finish(main_output)) {
+    return false;
+  }
 
-    while (input_position <= input.size() - 5) {
-      uint8 byte = input[input_position];
-      *main_output += byte;
+  call_output->append(encoder.call_output());
+  jump_output->append(encoder.jump_output());
+  misc_output->append(encoder.misc_output());
+  return true;
+}
 
-      if (!IsJ(previous_byte, byte)) {
-        input_position++;
-        previous_byte = byte;
-        continue;
-      }
+bool Bcj2EncodePayload(const std::string& input, std::string* payload) {
+  if (!payload) {
+    return false;
+  }
 
-      uint8 next_byte = input[input_position + 4];
-      uint32 src =
-        static_cast<uint8>(next_byte) << 24 |
-        static_cast<uint8>(input[input_position + 3]) << 16 |
-        static_cast<uint8>(input[input_position + 2]) << 8 |
-        static_cast<uint8>(input[input_position + 1]);
-      size_t dst = input_position + src + 5;
-
-      uint32 index = GetIndex(previous_byte, byte);
-      if (dst < input.size()) {
-        status_encoder[index].Encode(1, &range_encoder);
-        input_position += 5;
-        std::string* s = (byte == 0xE8) ? call_output : jump_output;
-        for (int i = 24; i >= 0; i -= 8) {
-          *s += static_cast<uint8>(dst >> i);
-        }
-        previous_byte = next_byte;
-      } else {
-        status_encoder[index].Encode(0, &range_encoder);
-        input_position++;
-        previous_byte = byte;
-      }
-    }
+  Bcj2Encoder encoder(input.size());
+  std::string main_output;
+  encoder.Encode(reinterpret_cast<const uint8*>(input.data()),
+                 input.size(),
+                 &main_output);
+  if (!encoder.Finish(&main_output)) {
+    return false;
   }
+
+  *payload = encoder.GetPayloadPrefix(main_output.size());
+  payload->append(main_output);
+  return true;
 }
 
 }  // namespace omaha
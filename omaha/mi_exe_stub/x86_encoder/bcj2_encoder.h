@@ -21,10 +21,57 @@
 
 #include <string>
 
+#include "base/basictypes.h"
+#include "omaha/mi_exe_stub/x86_encoder/range_encoder.h"
+
 namespace omaha {
 
-// TODO(omaha): this is currently a single-shot interface. The entire buffer
-// to be encoded must be loaded in memory. It'd be nice to make work in chunks.
+// Encodes the input in chunks. Only the main stream is handed back as the
+// chunks are encoded: the call, jump, and misc streams are much smaller and
+// are available once the whole input has been encoded.
+class Bcj2Encoder {
+ public:
+  // |input_size| is the total size of the input, which determines the jumps
+  // that are converted.
+  explicit Bcj2Encoder(uint64 input_size);
+
+  // Encodes the next |size| bytes of the input and appends the main stream to
+  // |main_output|. Up to four bytes are held back until the next call, since
+  // a jump target spans five bytes.
+  void Encode(const uint8* data, size_t size, std::string* main_output);
+
+  // Encodes the bytes held back and flushes the misc stream. Returns false if
+  // the size of the input is not the size given to the constructor.
+  bool Finish(std::string* main_output);
+
+  // Returns the beginning of the BCJ2 payload written by Bcj2EncodePayload:
+  // the header and the call, jump, and misc streams. The main stream, which
+  // is |main_size| bytes long, follows it. Must be called after Finish.
+  std::string GetPayloadPrefix(uint64 main_size) const;
+
+  const std::string& call_output() const { return call_output_; }
+  const std::string& jump_output() const { return jump_output_; }
+  const std::string& misc_output() const { return misc_output_; }
+
+ private:
+  static const int kNumberOfMoveBits = 5;
+
+  const uint64 input_size_;
+
+  // The input not encoded yet and its offset in the input.
+  std::string window_;
+  uint64 window_position_;
+
+  std::string call_output_;
+  std::string jump_output_;
+  std::string misc_output_;
+  RangeEncoder range_encoder_;
+  RangeEncoderBit<kNumberOfMoveBits> status_encoder_[256 + 2];
+  uint8 previous_byte_;
+
+  DISALLOW_COPY_AND_ASSIGN(Bcj2Encoder);
+};
+
 // TODO(omaha): consider converting this interface to use std::vector. The
 // reason std::string is used is for the auto-resize convenience.
 // All input/output parameters from this function are *binary* strings.
@@ -36,6 +83,13 @@ bool Bcj2Encode(const std::string& input,
                 std::string* jump_output,
                 std::string* misc_output);
 
+// Encodes |input| into the BCJ2 payload format read by the metainstaller. The
+// payload starts with five little-endian 64-bit integers: the size of |input|
+// and the sizes of the main, call, jump, and misc streams. The call, jump, and
+// misc streams follow the header and the main stream comes last, so that the
+// decoder only needs to buffer the small streams.
+bool Bcj2EncodePayload(const std::string& input, std::string* payload);
+
 }  // namespace omaha
 
 #endif  // OMAHA_MI_EXE_STUB_X86_ENCODER_BCJ2_ENCODER_H_
@@ -14,6 +14,7 @@
 // ========================================================================
 
 #include "omaha/mi_exe_stub/x86_encoder/bcj2_encoder.h"
+#include <algorithm>
 #include <string>
 #include <vector>
 #include "omaha/base/app_util.h"
@@ -70,4 +71,45 @@ TEST(Bcj2EncoderTest, Reversible) {
   EXPECT_EQ(input, decoded_output);
 }
 
+// Test that encoding in chunks produces the same streams as encoding at once,
+// including when the chunks split the jump targets.
+TEST(Bcj2EncoderTest, Chunked) {
+  CString module_path = app_util::GetModulePath(NULL);
+  ASSERT_FALSE(module_path.IsEmpty());
+
+  std::vector<byte> raw_file;
+  ASSERT_HRESULT_SUCCEEDED(
+      ReadEntireFileShareMode(module_path, 0, FILE_SHARE_READ, &raw_file));
+
+  // Encoding one byte at a time is slow, so only the start of the file is
+  // used.
+  const std::string input(reinterpret_cast<char*>(&raw_file[0]),
+                          std::min<size_t>(raw_file.size(), 256 * 1024));
+  std::string expected_main;
+  std::string expected_call;
+  std::string expected_jump;
+  std::string expected_misc;
+  ASSERT_TRUE(Bcj2Encode(input, &expected_main, &expected_call,
+                         &expected_jump, &expected_misc));
+
+  const size_t kChunkSizes[] = { 1, 4, 5, 4096 };
+  for (size_t i = 0; i != arraysize(kChunkSizes); ++i) {
+    const size_t chunk_size = kChunkSizes[i];
+    const uint8* data = reinterpret_cast<const uint8*>(input.data());
+    std::string main_output;
+    Bcj2Encoder encoder(input.size());
+    for (size_t offset = 0; offset < input.size(); offset += chunk_size) {
+      encoder.Encode(data + offset,
+                     std::min(chunk_size, input.size() - offset),
+                     &main_output);
+    }
+    ASSERT_TRUE(encoder.Finish(&main_output));
+
+    EXPECT_TRUE(expected_main == main_output) << chunk_size;
+    EXPECT_TRUE(expected_call == encoder.call_output()) << chunk_size;
+    EXPECT_TRUE(expected_jump == encoder.jump_output()) << chunk_size;
+    EXPECT_TRUE(expected_misc == encoder.misc_output()) << chunk_size;
+  }
+}
+
 }  // namespace omaha
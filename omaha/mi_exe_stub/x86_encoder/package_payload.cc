@@ -0,0 +1,62 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// Packages the metainstaller tarball into the compressed payload. This
+// replaces running bcj2.exe and then lzma.exe on the tarball.
+//
+// Usage: package_payload <input> <output> [threads] [block size in MB]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <windows.h>
+#include <algorithm>
+
+#include "base/basictypes.h"
+#include "omaha/mi_exe_stub/x86_encoder/payload_packager.h"
+
+int wmain(int argc, WCHAR* argv[], WCHAR* env[]) {
+  UNREFERENCED_PARAMETER(env);
+
+  if (argc < 3) {
+    return 1;
+  }
+
+  // The blocks are compressed on all the processors by default. The payload
+  // is the same whatever the number of threads.
+  SYSTEM_INFO system_info = {};
+  ::GetSystemInfo(&system_info);
+  int num_threads = static_cast<int>(system_info.dwNumberOfProcessors);
+  if (argc > 3) {
+    num_threads = _wtoi(argv[3]);
+  }
+  num_threads = std::max(1, std::min(num_threads, 32));
+
+  size_t block_size = 0;
+  if (argc > 4) {
+    block_size = static_cast<size_t>(_wtoi(argv[4])) * 1024 * 1024;
+  }
+
+  const DWORD start_ms = ::GetTickCount();
+  HRESULT hr = omaha::PackagePayload(argv[1], argv[2], num_threads,
+                                     block_size);
+  if (FAILED(hr)) {
+    fwprintf(stderr, L"Failed to package %s: 0x%08x\n", argv[1], hr);
+    return 2;
+  }
+
+  wprintf(L"Packaged %s with %d threads in %u ms\n",
+          argv[1], num_threads, ::GetTickCount() - start_ms);
+  return 0;
+}
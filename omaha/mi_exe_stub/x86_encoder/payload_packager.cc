@@ -0,0 +1,290 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/mi_exe_stub/x86_encoder/payload_packager.h"
+
+#include <atlstr.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+
+#include "base/basictypes.h"
+#include "omaha/base/error.h"
+#include "omaha/mi_exe_stub/payload_decoder.h"
+#include "omaha/mi_exe_stub/x86_encoder/bcj2_encoder.h"
+#include "third_party/smartany/scoped_any.h"
+
+extern "C" {
+#include "third_party/lzma/files/C/Lzma2Enc.h"
+}
+
+namespace omaha {
+
+namespace {
+
+// The size of the chunks read from the input and of the reads and writes
+// done by the compressor. ReadFile and WriteFile transfer at most a DWORD.
+const DWORD kChunkSize = 4 * 1024 * 1024;
+
+// The defaults of lzma.exe, which build_metainstaller.py runs without flags:
+// level 5, whose dictionary is 16MB.
+const int kCompressionLevel = 5;
+const uint32 kDictionarySize = 1 << 24;
+
+// The default size of the input of each block. It does not depend on the
+// number of threads, so that the payload is the same on every build machine.
+const size_t kDefaultBlockSize = 2 * kDictionarySize;
+
+void* LzmaAlloc(void* p, size_t size) {
+  UNREFERENCED_PARAMETER(p);
+  return malloc(size);
+}
+
+void LzmaFree(void* p, void* address) {
+  UNREFERENCED_PARAMETER(p);
+  free(address);
+}
+
+HRESULT ReadChunk(HANDLE file, void* buffer, DWORD size, DWORD* bytes_read) {
+  if (!::ReadFile(file, buffer, size, bytes_read, NULL)) {
+    return HRESULTFromLastError();
+  }
+  return S_OK;
+}
+
+HRESULT WriteAll(HANDLE file, const void* buffer, size_t size) {
+  const uint8* data = static_cast<const uint8*>(buffer);
+  while (size) {
+    const DWORD chunk_size = static_cast<DWORD>(
+        std::min(size, static_cast<size_t>(kChunkSize)));
+    DWORD bytes_written = 0;
+    if (!::WriteFile(file, data, chunk_size, &bytes_written, NULL)) {
+      return HRESULTFromLastError();
+    }
+    if (bytes_written != chunk_size) {
+      return E_FAIL;
+    }
+    data += bytes_written;
+    size -= bytes_written;
+  }
+  return S_OK;
+}
+
+// Reads the BCJ2 payload for the compressor: the prefix held in memory,
+// followed by the main stream held in a temporary file. The compressor reads
+// from a single thread at a time.
+struct PayloadInStream {
+  ISeqInStream stream;  // Must be first: the SDK passes a pointer to it.
+  const std::string* prefix;
+  size_t prefix_position;
+  HANDLE main_file;
+  HRESULT hr;
+};
+
+SRes PayloadRead(void* p, void* buffer, size_t* size) {
+  PayloadInStream* in = static_cast<PayloadInStream*>(p);
+  if (in->prefix_position < in->prefix->size()) {
+    *size = std::min(*size, in->prefix->size() - in->prefix_position);
+    memcpy(buffer, in->prefix->data() + in->prefix_position, *size);
+    in->prefix_position += *size;
+    return SZ_OK;
+  }
+
+  DWORD bytes_read = 0;
+  const DWORD chunk_size = static_cast<DWORD>(
+      std::min(*size, static_cast<size_t>(kChunkSize)));
+  in->hr = ReadChunk(in->main_file, buffer, chunk_size, &bytes_read);
+  *size = bytes_read;
+  return SUCCEEDED(in->hr) ? SZ_OK : SZ_ERROR_READ;
+}
+
+struct PayloadOutStream {
+  ISeqOutStream stream;  // Must be first: the SDK passes a pointer to it.
+  HANDLE file;
+  HRESULT hr;
+};
+
+size_t PayloadWrite(void* p, const void* buffer, size_t size) {
+  PayloadOutStream* out = static_cast<PayloadOutStream*>(p);
+  out->hr = WriteAll(out->file, buffer, size);
+  return SUCCEEDED(out->hr) ? size : 0;
+}
+
+// Encodes |input| with BCJ2. The main stream is written to |main_file| as it
+// is encoded, since it is about as large as the input.
+HRESULT EncodeBcj2(HANDLE input,
+                   HANDLE main_file,
+                   std::string* prefix,
+                   uint64* main_size) {
+  LARGE_INTEGER input_size = {};
+  if (!::GetFileSizeEx(input, &input_size)) {
+    return HRESULTFromLastError();
+  }
+
+  Bcj2Encoder encoder(static_cast<uint64>(input_size.QuadPart));
+  std::string chunk(kChunkSize, '\0');
+  std::string main_output;
+  *main_size = 0;
+  for (;;) {
+    DWORD bytes_read = 0;
+    HRESULT hr = ReadChunk(input, &chunk[0], kChunkSize, &bytes_read);
+    if (FAILED(hr)) {
+      return hr;
+    }
+    if (!bytes_read) {
+      break;
+    }
+
+    main_output.clear();
+    encoder.Encode(reinterpret_cast<const uint8*>(chunk.data()),
+                   bytes_read,
+                   &main_output);
+    hr = WriteAll(main_file, main_output.data(), main_output.size());
+    if (FAILED(hr)) {
+      return hr;
+    }
+    *main_size += main_output.size();
+  }
+
+  main_output.clear();
+  if (!encoder.Finish(&main_output)) {
+    // The input changed while it was read.
+    return E_UNEXPECTED;
+  }
+  HRESULT hr = WriteAll(main_file, main_output.data(), main_output.size());
+  if (FAILED(hr)) {
+    return hr;
+  }
+  *main_size += main_output.size();
+
+  *prefix = encoder.GetPayloadPrefix(*main_size);
+  return S_OK;
+}
+
+}  // namespace
+
+HRESULT PackagePayload(const TCHAR* input_path,
+                       const TCHAR* output_path,
+                       int num_threads,
+                       size_t block_size) {
+  if (!input_path || !output_path || num_threads < 1) {
+    return E_INVALIDARG;
+  }
+
+  scoped_hfile input(::CreateFile(input_path, GENERIC_READ, FILE_SHARE_READ,
+                                  NULL, OPEN_EXISTING,
+                                  FILE_FLAG_SEQUENTIAL_SCAN, NULL));
+  if (!valid(input)) {
+    return HRESULTFromLastError();
+  }
+
+  CString main_path(output_path);
+  main_path += _T(".main");
+  scoped_hfile main_file(::CreateFile(
+      main_path, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+      FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, NULL));
+  if (!valid(main_file)) {
+    return HRESULTFromLastError();
+  }
+
+  std::string prefix;
+  uint64 main_size = 0;
+  HRESULT hr = EncodeBcj2(get(input), get(main_file), &prefix, &main_size);
+  if (FAILED(hr)) {
+    return hr;
+  }
+  reset(input);
+
+  LARGE_INTEGER zero = {};
+  if (!::SetFilePointerEx(get(main_file), zero, NULL, FILE_BEGIN)) {
+    return HRESULTFromLastError();
+  }
+
+  const uint64 unpacked_size = prefix.size() + main_size;
+
+  if (!block_size) {
+    block_size = kDefaultBlockSize;
+  }
+
+  // The SDK compresses the input as a single block when it has one block
+  // thread, so at least two are used to keep the blocks, and therefore the
+  // payload, the same whatever the number of threads.
+  const int num_block_threads = std::max(num_threads, 2);
+
+  ISzAlloc allocators = { &LzmaAlloc, &LzmaFree };
+  CLzma2EncHandle encoder = Lzma2Enc_Create(&allocators, &allocators);
+  if (!encoder) {
+    return E_OUTOFMEMORY;
+  }
+
+  CLzma2EncProps props;
+  Lzma2EncProps_Init(&props);
+  props.lzmaProps.level = kCompressionLevel;
+  props.lzmaProps.dictSize = kDictionarySize;
+  props.lzmaProps.numThreads = 1;
+  props.blockSize = block_size;
+  props.numBlockThreads = num_block_threads;
+  props.numTotalThreads = num_block_threads;
+
+  SRes result = Lzma2Enc_SetProps(encoder, &props);
+  if (SZ_OK != result) {
+    Lzma2Enc_Destroy(encoder);
+    return E_INVALIDARG;
+  }
+
+  scoped_hfile output(::CreateFile(output_path, GENERIC_WRITE, 0, NULL,
+                                   CREATE_ALWAYS, 0, NULL));
+  if (!valid(output)) {
+    hr = HRESULTFromLastError();
+    Lzma2Enc_Destroy(encoder);
+    return hr;
+  }
+
+  // The header is the marker, the LZMA2 properties, and the unpacked size.
+  std::string header;
+  header += static_cast<char>(kLzma2PayloadMarker);
+  header += static_cast<char>(Lzma2Enc_WriteProperties(encoder));
+  for (int i = 0; i < 64; i += 8) {
+    header += static_cast<char>(unpacked_size >> i);
+  }
+  hr = WriteAll(get(output), header.data(), header.size());
+  if (FAILED(hr)) {
+    Lzma2Enc_Destroy(encoder);
+    return hr;
+  }
+
+  PayloadInStream in_stream = { { &PayloadRead }, &prefix, 0, get(main_file),
+                                S_OK };
+  PayloadOutStream out_stream = { { &PayloadWrite }, get(output), S_OK };
+  result = Lzma2Enc_Encode(encoder, &out_stream.stream, &in_stream.stream,
+                           NULL);
+  Lzma2Enc_Destroy(encoder);
+
+  switch (result) {
+    case SZ_OK:
+      return S_OK;
+    case SZ_ERROR_MEM:
+      return E_OUTOFMEMORY;
+    case SZ_ERROR_READ:
+      return FAILED(in_stream.hr) ? in_stream.hr : E_FAIL;
+    case SZ_ERROR_WRITE:
+      return FAILED(out_stream.hr) ? out_stream.hr : E_FAIL;
+    default:
+      return E_FAIL;
+  }
+}
+
+}  // namespace omaha
@@ -0,0 +1,40 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// Builds the metainstaller payload from the tarball in one pass over each
+// file: the tarball is BCJ2-encoded in chunks, then the BCJ2 payload is
+// compressed to LZMA2 with the blocks compressed in parallel. The format is
+// documented in mi_exe_stub/payload_decoder.h.
+
+#ifndef OMAHA_MI_EXE_STUB_X86_ENCODER_PAYLOAD_PACKAGER_H_
+#define OMAHA_MI_EXE_STUB_X86_ENCODER_PAYLOAD_PACKAGER_H_
+
+#include <windows.h>
+
+namespace omaha {
+
+// Packages |input_path| into |output_path|. |num_threads| is the number of
+// blocks compressed at the same time, up to 32; it only changes how fast the
+// payload is built, not the payload. |block_size| is the size of the input of
+// each block, 0 for the default of 32MB. Smaller blocks compress in parallel
+// better but compress a little worse.
+HRESULT PackagePayload(const TCHAR* input_path,
+                       const TCHAR* output_path,
+                       int num_threads,
+                       size_t block_size);
+
+}  // namespace omaha
+
+#endif  // OMAHA_MI_EXE_STUB_X86_ENCODER_PAYLOAD_PACKAGER_H_
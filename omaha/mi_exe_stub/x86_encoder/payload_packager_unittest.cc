@@ -0,0 +1,209 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/mi_exe_stub/x86_encoder/payload_packager.h"
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "omaha/base/app_util.h"
+#include "omaha/base/file.h"
+#include "omaha/base/highres_timer-win32.h"
+#include "omaha/base/utils.h"
+#include "omaha/mi_exe_stub/payload_decoder.h"
+#include "omaha/testing/unit_test.h"
+
+namespace omaha {
+
+namespace {
+
+// Returns |size| bytes of x86 code: the unit test itself followed by altered
+// copies of it.
+std::string MakeInput(size_t size) {
+  CString module_path = app_util::GetModulePath(NULL);
+  std::vector<byte> raw_file;
+  if (FAILED(ReadEntireFileShareMode(module_path, 0, FILE_SHARE_READ,
+                                     &raw_file)) ||
+      raw_file.empty()) {
+    return std::string();
+  }
+
+  std::string input;
+  input.reserve(size);
+  for (uint8 copy = 0; input.size() < size; ++copy) {
+    const size_t offset = input.size();
+    input.append(reinterpret_cast<char*>(&raw_file[0]),
+                 std::min(raw_file.size(), size - offset));
+    for (size_t i = offset; i < input.size(); i += 64) {
+      input[i] ^= copy;
+    }
+  }
+  return input;
+}
+
+bool AppendToString(void* context, const uint8* data, size_t size) {
+  reinterpret_cast<std::string*>(context)->append(
+      reinterpret_cast<const char*>(data), size);
+  return true;
+}
+
+}  // namespace
+
+class PayloadPackagerTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    input_path_ = GetTempFilenameAt(app_util::GetTempDir(), _T("ppi"));
+    output_path_ = GetTempFilenameAt(app_util::GetTempDir(), _T("ppo"));
+    ASSERT_FALSE(input_path_.IsEmpty());
+    ASSERT_FALSE(output_path_.IsEmpty());
+  }
+
+  virtual void TearDown() {
+    ::DeleteFile(input_path_);
+    ::DeleteFile(output_path_);
+  }
+
+  void WriteInput(const std::string& input) {
+    File file;
+    ASSERT_HRESULT_SUCCEEDED(file.Open(input_path_, true, false));
+    uint32 bytes_written = 0;
+    ASSERT_HRESULT_SUCCEEDED(file.Write(
+        reinterpret_cast<const uint8*>(input.data()),
+        static_cast<uint32>(input.size()),
+        &bytes_written));
+  }
+
+  std::string ReadOutput() {
+    std::vector<byte> contents;
+    if (FAILED(ReadEntireFile(output_path_, 0, &contents)) ||
+        contents.empty()) {
+      return std::string();
+    }
+    return std::string(reinterpret_cast<char*>(&contents[0]), contents.size());
+  }
+
+  CString input_path_;
+  CString output_path_;
+};
+
+TEST_F(PayloadPackagerTest, InvalidArgs) {
+  EXPECT_EQ(E_INVALIDARG, PackagePayload(NULL, output_path_, 1, 0));
+  EXPECT_EQ(E_INVALIDARG, PackagePayload(input_path_, NULL, 1, 0));
+  EXPECT_EQ(E_INVALIDARG, PackagePayload(input_path_, output_path_, 0, 0));
+}
+
+TEST_F(PayloadPackagerTest, EmptyInput) {
+  WriteInput(std::string());
+  ASSERT_HRESULT_SUCCEEDED(PackagePayload(input_path_, output_path_, 2, 0));
+
+  const std::string payload(ReadOutput());
+  std::string output;
+  EXPECT_TRUE(DecodePayload(reinterpret_cast<const uint8*>(payload.data()),
+                            payload.size(),
+                            AppendToString,
+                            &output));
+  EXPECT_TRUE(output.empty());
+}
+
+// The payload decodes to the input whatever the number of threads, including
+// when the input is split in more blocks than there are threads.
+TEST_F(PayloadPackagerTest, RoundTrip) {
+  const std::string input(MakeInput(6 * 1024 * 1024 + 123));
+  ASSERT_FALSE(input.empty());
+  WriteInput(input);
+
+  const int kNumThreads[] = { 1, 2, 4 };
+  const size_t kBlockSizes[] = { 0, 1024 * 1024 };
+  for (size_t i = 0; i != arraysize(kNumThreads); ++i) {
+    for (size_t j = 0; j != arraysize(kBlockSizes); ++j) {
+      ASSERT_HRESULT_SUCCEEDED(PackagePayload(input_path_,
+                                              output_path_,
+                                              kNumThreads[i],
+                                              kBlockSizes[j]));
+
+      const std::string payload(ReadOutput());
+      ASSERT_FALSE(payload.empty());
+      EXPECT_EQ(kLzma2PayloadMarker, static_cast<uint8>(payload[0]));
+      EXPECT_GT(input.size(), payload.size());
+
+      std::string output;
+      EXPECT_TRUE(DecodePayload(reinterpret_cast<const uint8*>(payload.data()),
+                                payload.size(),
+                                AppendToString,
+                                &output)) << kNumThreads[i];
+      EXPECT_TRUE(input == output) << kNumThreads[i];
+    }
+  }
+
+  // The temporary file holding the main stream is gone.
+  EXPECT_FALSE(File::Exists(output_path_ + _T(".main")));
+}
+
+// The payload does not depend on the number of threads compressing it.
+TEST_F(PayloadPackagerTest, SamePayloadForAnyNumberOfThreads) {
+  WriteInput(MakeInput(3 * 1024 * 1024 + 45));
+
+  const size_t kBlockSizes[] = { 0, 1024 * 1024 };
+  for (size_t i = 0; i != arraysize(kBlockSizes); ++i) {
+    ASSERT_HRESULT_SUCCEEDED(PackagePayload(input_path_,
+                                            output_path_,
+                                            1,
+                                            kBlockSizes[i]));
+    const std::string expected_payload(ReadOutput());
+
+    const int kNumThreads[] = { 2, 3, 8 };
+    for (size_t j = 0; j != arraysize(kNumThreads); ++j) {
+      ASSERT_HRESULT_SUCCEEDED(PackagePayload(input_path_,
+                                              output_path_,
+                                              kNumThreads[j],
+                                              kBlockSizes[i]));
+      EXPECT_TRUE(expected_payload == ReadOutput()) << kNumThreads[j];
+    }
+  }
+}
+
+// Reports how fast a 150MB payload is packaged depending on the number of
+// threads compressing it.
+TEST_F(PayloadPackagerTest, DISABLED_Throughput150MB) {
+  const size_t kInputSize = 150 * 1024 * 1024;
+  {
+    const std::string input(MakeInput(kInputSize));
+    ASSERT_FALSE(input.empty());
+    WriteInput(input);
+  }
+
+  const int kNumThreads[] = { 1, 2, 4, 8 };
+  for (size_t i = 0; i != arraysize(kNumThreads); ++i) {
+    HighresTimer timer;
+    ASSERT_HRESULT_SUCCEEDED(PackagePayload(input_path_,
+                                            output_path_,
+                                            kNumThreads[i],
+                                            0));
+    const ULONGLONG elapsed_ms = std::max<ULONGLONG>(timer.GetElapsedMs(), 1);
+
+    File file;
+    ASSERT_HRESULT_SUCCEEDED(file.Open(output_path_, false, false));
+    uint32 output_size = 0;
+    ASSERT_HRESULT_SUCCEEDED(file.GetLength(&output_size));
+
+    std::cout << kNumThreads[i] << " threads: " << elapsed_ms << " ms, "
+              << (kInputSize / 1024 * 1000 / elapsed_ms) / 1024 << " MB/s, "
+              << "payload " << output_size << " bytes" << std::endl;
+  }
+}
+
+}  // namespace omaha
@@ -711,10 +711,12 @@ HRESULT BitsRequest::NotifyProgress() {
   }
 
   ASSERT1(progress.FilesTotal == 1);
-  ASSERT1(progress.BytesTransferred <= INT_MAX);
-  ASSERT1(progress.BytesTotal <= INT_MAX);
-  callback_->OnProgress(static_cast<int>(progress.BytesTransferred),
-                        static_cast<int>(progress.BytesTotal),
+
+  // BITS reports BG_SIZE_UNKNOWN until the size of the file is known.
+  const uint64 bytes_total =
+      progress.BytesTotal == BG_SIZE_UNKNOWN ? 0 : progress.BytesTotal;
+  callback_->OnProgress(progress.BytesTransferred,
+                        bytes_total,
                         WINHTTP_CALLBACK_STATUS_READ_COMPLETE,
                         NULL);
   return S_OK;
@@ -883,4 +885,10 @@ bool BitsRequest::download_metrics(DownloadMetrics* dm) const {
   }
 }
 
+// BITS writes the file, therefore the digest of the file is not known.
+bool BitsRequest::response_digest(std::vector<uint8>* digest) const {
+  UNREFERENCED_PARAMETER(digest);
+  return false;
+}
+
 }   // namespace omaha
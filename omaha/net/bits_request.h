@@ -60,6 +60,10 @@ class BitsRequest : public HttpRequestInterface {
     return std::vector<uint8>();
   }
 
+  virtual void TakeResponse(std::vector<uint8>* response) {
+    response->clear();
+  }
+
   // TODO(omaha): BITS provides access to headers on Windows Vista.
   virtual HRESULT QueryHeadersString(uint32 info_level,
                                      const TCHAR* name,
@@ -100,6 +104,11 @@ class BitsRequest : public HttpRequestInterface {
     low_priority_ = low_priority;
   }
 
+  // BITS manages its own connections.
+  virtual void set_num_segments(int num_segments) {
+    UNREFERENCED_PARAMETER(num_segments);
+  }
+
   virtual void set_callback(NetworkRequestCallback* callback) {
     callback_ = callback;
   }
@@ -120,6 +129,8 @@ class BitsRequest : public HttpRequestInterface {
 
   virtual bool download_metrics(DownloadMetrics* download_metrics) const;
 
+  virtual bool response_digest(std::vector<uint8>* digest) const;
+
   // Sets the minimum length of time that BITS waits after encountering a
   // transient error condition before trying to transfer the file.
   // The default value is 600 seconds.
@@ -109,8 +109,17 @@ HRESULT CupEcdsaRequestImpl::Resume() {
   return http_request_->Resume();
 }
 
+// The response body is moved out of the inner request by DoSend.
 std::vector<uint8> CupEcdsaRequestImpl::GetResponse() const {
-  return http_request_->GetResponse();
+  return cup_.get() ? cup_->response : std::vector<uint8>();
+}
+
+void CupEcdsaRequestImpl::TakeResponse(std::vector<uint8>* response) {
+  ASSERT1(response);
+  response->clear();
+  if (cup_.get()) {
+    response->swap(cup_->response);
+  }
 }
 
 HRESULT CupEcdsaRequestImpl::QueryHeadersString(uint32 info_level,
@@ -159,6 +168,10 @@ void CupEcdsaRequestImpl::set_low_priority(bool low_priority) {
   http_request_->set_low_priority(low_priority);
 }
 
+void CupEcdsaRequestImpl::set_num_segments(int num_segments) {
+  http_request_->set_num_segments(num_segments);
+}
+
 void CupEcdsaRequestImpl::set_callback(NetworkRequestCallback* callback) {
   http_request_->set_callback(callback);
 }
@@ -221,13 +234,16 @@ HRESULT CupEcdsaRequestImpl::DoSend() {
                BufferToPrintableString(request_buffer_,
                                        request_buffer_length_)));
   HRESULT hr = http_request_->Send();
+
+  // Save the response body, including the body of a failed request, which the
+  // caller may log.
+  http_request_->TakeResponse(&cup_->response);
   if (FAILED(hr)) {
     metric_cup_ecdsa_http_failure++;
     return hr;
   }
 
-  // Save the response body, and make sure we got an HTTP 200 or 206.
-  http_request_->GetResponse().swap(cup_->response);
+  // Make sure we got an HTTP 200 or 206.
   int status_code(http_request_->GetHttpStatusCode());
   if (status_code != HTTP_STATUS_OK &&
       status_code != HTTP_STATUS_PARTIAL_CONTENT) {
@@ -438,6 +454,10 @@ std::vector<uint8> CupEcdsaRequest::GetResponse() const {
   return impl_->GetResponse();
 }
 
+void CupEcdsaRequest::TakeResponse(std::vector<uint8>* response) {
+  impl_->TakeResponse(response);
+}
+
 int CupEcdsaRequest::GetHttpStatusCode() const {
   return impl_->GetHttpStatusCode();
 }
@@ -481,6 +501,10 @@ void CupEcdsaRequest::set_low_priority(bool low_priority) {
   impl_->set_low_priority(low_priority);
 }
 
+void CupEcdsaRequest::set_num_segments(int num_segments) {
+  impl_->set_num_segments(num_segments);
+}
+
 void CupEcdsaRequest::set_callback(NetworkRequestCallback* callback) {
   impl_->set_callback(callback);
 }
@@ -507,4 +531,9 @@ bool CupEcdsaRequest::download_metrics(DownloadMetrics* dm) const {
   return false;
 }
 
+bool CupEcdsaRequest::response_digest(std::vector<uint8>* digest) const {
+  UNREFERENCED_PARAMETER(digest);
+  return false;
+}
+
 }   // namespace omaha
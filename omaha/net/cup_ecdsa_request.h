@@ -56,6 +56,8 @@ class CupEcdsaRequest : public HttpRequestInterface {
 
   virtual std::vector<uint8> GetResponse() const;
 
+  virtual void TakeResponse(std::vector<uint8>* response);
+
   virtual HRESULT QueryHeadersString(uint32 info_level,
                                      const TCHAR* name,
                                      CString* value) const;
@@ -77,6 +79,7 @@ class CupEcdsaRequest : public HttpRequestInterface {
   virtual void set_filename(const CString& filename);
 
   virtual void set_low_priority(bool low_priority);
+  virtual void set_num_segments(int num_segments);
 
   virtual void set_callback(NetworkRequestCallback* callback);
 
@@ -90,6 +93,8 @@ class CupEcdsaRequest : public HttpRequestInterface {
 
   virtual bool download_metrics(DownloadMetrics* download_metrics) const;
 
+  virtual bool response_digest(std::vector<uint8>* digest) const;
+
  private:
   friend class CupEcdsaRequestTest;
 
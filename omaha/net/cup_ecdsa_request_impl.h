@@ -41,6 +41,7 @@ class CupEcdsaRequestImpl {
   HRESULT Pause();
   HRESULT Resume();
   std::vector<uint8> GetResponse() const;
+  void TakeResponse(std::vector<uint8>* response);
   HRESULT QueryHeadersString(uint32 info_level,
                                     const TCHAR* name,
                                     CString* value) const;
@@ -54,6 +55,7 @@ class CupEcdsaRequestImpl {
   void set_proxy_configuration(const ProxyConfig& proxy_config);
   void set_filename(const CString& filename);
   void set_low_priority(bool low_priority);
+  void set_num_segments(int num_segments);
   void set_callback(NetworkRequestCallback* callback);
   void set_additional_headers(const CString& additional_headers);
   CString user_agent() const;
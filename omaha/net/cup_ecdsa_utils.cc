@@ -16,6 +16,8 @@
 #include "omaha/net/cup_ecdsa_utils.h"
 
 #include <limits>
+#include <memory>
+#include <utility>
 #include <vector>
 #include "omaha/base/debug.h"
 #include "omaha/base/error.h"
@@ -23,11 +25,67 @@
 #include "omaha/base/security/p256.h"
 #include "omaha/base/security/p256_ecdsa.h"
 #include "omaha/base/security/sha256.h"
+#include "omaha/base/synchronized.h"
 
 namespace omaha {
 
 namespace internal {
 
+namespace {
+
+// Caches the multiples of the public keys which are compiled into the program.
+// Every CUP request decodes one of these keys, so the multiples are computed
+// once per process. There are only a handful of such keys, therefore the
+// cache is never purged.
+class PointTableCache {
+ public:
+  PointTableCache() {}
+
+  // Returns NULL if the point is not on the curve or the cache is full.
+  const p256_point_table* Get(const p256_int& x, const p256_int& y) {
+    __mutexScope(lock_);
+
+    for (size_t i = 0; i != entries_.size(); ++i) {
+      const Entry& entry = *entries_[i];
+      if (p256_cmp(&entry.x, &x) == 0 && p256_cmp(&entry.y, &y) == 0) {
+        return &entry.table;
+      }
+    }
+
+    if (entries_.size() >= kMaxEntries) {
+      return NULL;
+    }
+
+    std::unique_ptr<Entry> entry(new Entry);
+    entry->x = x;
+    entry->y = y;
+    if (!p256_point_table_init(&x, &y, &entry->table)) {
+      return NULL;
+    }
+
+    entries_.push_back(std::move(entry));
+    return &entries_.back()->table;
+  }
+
+ private:
+  struct Entry {
+    p256_int x;
+    p256_int y;
+    p256_point_table table;
+  };
+
+  static const size_t kMaxEntries = 8;
+
+  LLock lock_;
+  std::vector<std::unique_ptr<Entry>> entries_;
+
+  DISALLOW_COPY_AND_ASSIGN(PointTableCache);
+};
+
+PointTableCache point_table_cache;
+
+}  // namespace
+
 bool SafeSHA256Hash(const void* data, size_t len,
                     std::vector<uint8>* hash_out) {
   const size_t kMaxLen = static_cast<size_t>(std::numeric_limits<int>::max());
@@ -245,7 +303,7 @@ const uint8* EcdsaSignature::DecodeDerInt256(const uint8* buffer_begin,
   return int_data + int_data_len;
 }
 
-EcdsaPublicKey::EcdsaPublicKey() : version_(0) {
+EcdsaPublicKey::EcdsaPublicKey() : version_(0), point_table_(NULL) {
   p256_init(&gx_);
   p256_init(&gy_);
 }
@@ -277,6 +335,8 @@ void EcdsaPublicKey::DecodeFromBuffer(const uint8* encoded_pkey_in) {
   p256_from_bin(&encoded_pkey_in[2 + P256_NBYTES], &gy_);
 
   ASSERT1(p256_is_valid_point(&gx_, &gy_));
+
+  point_table_ = point_table_cache.Get(gx_, gy_);
 }
 
 // We expect |spki| to contain a DER-encoded SubjectPublicKeyInfo value holding
@@ -362,6 +422,8 @@ bool EcdsaPublicKey::DecodeSubjectPublicKeyInfo(
     return false;
   }
 
+  // The multiples are only cached for the keys compiled into the program.
+  point_table_ = NULL;
   p256_from_bin(&encoded_pkey_in[2], &gx_);
   p256_from_bin(&encoded_pkey_in[2 + P256_NBYTES], &gy_);
 
@@ -380,6 +442,12 @@ bool VerifyEcdsaSignature(const EcdsaPublicKey& public_key,
   p256_int digest_as_int;
   p256_from_bin(&digest.front(), &digest_as_int);
 
+  if (public_key.point_table()) {
+    return p256_ecdsa_verify_table(public_key.point_table(),
+                                   &digest_as_int,
+                                   signature.r(), signature.s()) != 0;
+  }
+
   return p256_ecdsa_verify(public_key.gx(), public_key.gy(),
                            &digest_as_int,
                            signature.r(), signature.s()) != 0;
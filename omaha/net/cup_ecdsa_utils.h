@@ -77,11 +77,18 @@ class EcdsaPublicKey {
   const p256_int* gx() const { return &gx_; }
   const p256_int* gy() const { return &gy_; }
 
+  // Returns the precomputed multiples of the key or NULL if there are none.
+  // The multiples are computed for the keys decoded by DecodeFromBuffer.
+  const p256_point_table* point_table() const { return point_table_; }
+
  private:
   uint8 version_;
   p256_int gx_;
   p256_int gy_;
 
+  // Not owned. The tables are cached for the lifetime of the process.
+  const p256_point_table* point_table_;
+
   DISALLOW_COPY_AND_ASSIGN(EcdsaPublicKey);
 };
 
@@ -497,6 +497,28 @@ TEST(EcdsaPublicKey, DecodeFromBuffer_ProdKey) {
   key.DecodeFromBuffer(kProdKey);
 }
 
+TEST(EcdsaPublicKey, DecodeFromBuffer_PointTableIsCached) {
+  uint8 kProdKey[] =
+#include "omaha/net/cup_ecdsa_pubkey.9.h"
+  ;   // NOLINT
+  uint8 kTestKey[] =
+#include "omaha/net/cup_ecdsa_pubkey.3.h"
+  ;   // NOLINT
+
+  EcdsaPublicKey prod_key1;
+  prod_key1.DecodeFromBuffer(kProdKey);
+  EXPECT_TRUE(prod_key1.point_table());
+
+  EcdsaPublicKey prod_key2;
+  prod_key2.DecodeFromBuffer(kProdKey);
+  EXPECT_EQ(prod_key1.point_table(), prod_key2.point_table());
+
+  EcdsaPublicKey test_key;
+  test_key.DecodeFromBuffer(kTestKey);
+  EXPECT_TRUE(test_key.point_table());
+  EXPECT_NE(prod_key1.point_table(), test_key.point_table());
+}
+
 TEST(EcdsaPublicKey, DecodeSubjectPublicKeyInfo_Valid) {
   EcdsaPublicKey key;
 
@@ -520,6 +542,7 @@ TEST(EcdsaPublicKey, DecodeSubjectPublicKeyInfo_Valid) {
 
   std::vector<uint8> spki(&kSPKI[0], &kSPKI[arraysize(kSPKI)]);
   EXPECT_TRUE(key.DecodeSubjectPublicKeyInfo(spki));
+  EXPECT_FALSE(key.point_table());
 }
 
 TEST(EcdsaPublicKey, DecodeSubjectPublicKeyInfo_InvalidSequenceLength) {
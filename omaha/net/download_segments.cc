@@ -0,0 +1,188 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/net/download_segments.h"
+
+#include <algorithm>
+
+#include "omaha/base/debug.h"
+#include "omaha/base/error.h"
+#include "omaha/base/logging.h"
+
+namespace omaha {
+
+DownloadSegments::DownloadSegments(HANDLE file,
+                                   uint64 file_size,
+                                   uint64 min_segment_size)
+    : file_(file),
+      file_size_(file_size),
+      min_segment_size_(std::max<uint64>(min_segment_size, 1)),
+      bytes_written_(0) {
+  ASSERT1(file_ && file_ != INVALID_HANDLE_VALUE);
+}
+
+DownloadSegments::~DownloadSegments() {
+}
+
+int DownloadSegments::Split(int max_segments) {
+  __mutexScope(lock_);
+  ASSERT1(segments_.empty());
+  ASSERT1(max_segments > 0);
+
+  const uint64 num_segments = std::max<uint64>(1,
+      std::min(static_cast<uint64>(max_segments),
+               file_size_ / min_segment_size_));
+  const uint64 segment_size = file_size_ / num_segments;
+  for (uint64 i = 0; i != num_segments; ++i) {
+    const uint64 end = i + 1 == num_segments ? file_size_ :
+                                               (i + 1) * segment_size;
+    segments_.push_back(Segment(i * segment_size, end));
+  }
+
+  NET_LOG(L3, (_T("[DownloadSegments::Split][%I64u bytes][%I64u segments]"),
+               file_size_, num_segments));
+  return static_cast<int>(num_segments);
+}
+
+void DownloadSegments::GetRange(int segment,
+                                uint64* first_byte,
+                                uint64* end) const {
+  ASSERT1(first_byte);
+  ASSERT1(end);
+
+  __mutexScope(lock_);
+  ASSERT1(0 <= segment && static_cast<size_t>(segment) < segments_.size());
+  *first_byte = segments_[segment].next;
+  *end = segments_[segment].end;
+}
+
+HRESULT DownloadSegments::Write(int segment,
+                                const void* data,
+                                size_t size,
+                                bool* is_complete) {
+  ASSERT1(data || !size);
+  ASSERT1(is_complete);
+
+  // The range written is reserved by moving the next byte of the segment past
+  // it, so that a segment taken over from this one starts after the range.
+  // The bytes are then written without the lock, at the offset of the range,
+  // so that the connections write at the same time.
+  uint64 offset = 0;
+  DWORD bytes_to_write = 0;
+  __mutexBlock(lock_) {
+    ASSERT1(0 <= segment && static_cast<size_t>(segment) < segments_.size());
+    Segment& current = segments_[segment];
+    ASSERT1(current.is_active);
+
+    offset = current.next;
+    bytes_to_write = static_cast<DWORD>(
+        std::min(static_cast<uint64>(size), current.end - current.next));
+    ASSERT1(bytes_to_write == size || current.next + bytes_to_write ==
+                                      current.end);
+    current.next += bytes_to_write;
+  }
+
+  HRESULT hr = S_OK;
+  if (bytes_to_write) {
+    OVERLAPPED overlapped = {};
+    overlapped.Offset = static_cast<DWORD>(offset);
+    overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+    DWORD bytes_written = 0;
+    if (!::WriteFile(file_, data, bytes_to_write, &bytes_written,
+                     &overlapped)) {
+      hr = HRESULTFromLastError();
+    } else if (bytes_written != bytes_to_write) {
+      hr = HRESULT_FROM_WIN32(ERROR_WRITE_FAULT);
+    }
+  }
+
+  __mutexScope(lock_);
+  Segment& current = segments_[segment];
+  if (FAILED(hr)) {
+    // The segment only shrinks from its end past the reserved range, so the
+    // range still belongs to the segment.
+    ASSERT1(current.next <= current.end);
+    current.next = offset;
+    return hr;
+  }
+
+  bytes_written_ += bytes_to_write;
+  *is_complete = current.next == current.end;
+  if (*is_complete) {
+    current.is_active = false;
+  }
+  return S_OK;
+}
+
+void DownloadSegments::Release(int segment) {
+  __mutexScope(lock_);
+  ASSERT1(0 <= segment && static_cast<size_t>(segment) < segments_.size());
+  segments_[segment].is_active = false;
+}
+
+bool DownloadSegments::Take(int* segment) {
+  ASSERT1(segment);
+
+  __mutexScope(lock_);
+
+  // The segments given up by failed connections come first, since nothing
+  // else downloads them.
+  size_t largest = segments_.size();
+  uint64 largest_bytes_left = 0;
+  for (size_t i = 0; i != segments_.size(); ++i) {
+    const uint64 bytes_left = segments_[i].end - segments_[i].next;
+    if (!bytes_left) {
+      continue;
+    }
+    if (!segments_[i].is_active) {
+      segments_[i].is_active = true;
+      *segment = static_cast<int>(i);
+      return true;
+    }
+    if (bytes_left > largest_bytes_left) {
+      largest = i;
+      largest_bytes_left = bytes_left;
+    }
+  }
+
+  // Splitting a segment costs a new request, which only pays off when both
+  // halves are large enough.
+  if (largest == segments_.size() ||
+      largest_bytes_left < 2 * min_segment_size_) {
+    return false;
+  }
+
+  Segment& victim = segments_[largest];
+  const uint64 middle = victim.next + largest_bytes_left / 2;
+  segments_.push_back(Segment(middle, victim.end));
+  victim.end = middle;
+
+  *segment = static_cast<int>(segments_.size() - 1);
+  NET_LOG(L3, (_T("[DownloadSegments::Take][%d takes over %I64u-%I64u]"),
+               *segment, middle, segments_.back().end));
+  return true;
+}
+
+uint64 DownloadSegments::bytes_written() const {
+  __mutexScope(lock_);
+  return bytes_written_;
+}
+
+bool DownloadSegments::IsComplete() const {
+  __mutexScope(lock_);
+  return !segments_.empty() && bytes_written_ == file_size_;
+}
+
+}  // namespace omaha
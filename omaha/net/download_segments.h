@@ -0,0 +1,100 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// DownloadSegments tracks the ranges of a file downloaded over several
+// connections at the same time. Each segment is a range of bytes written in
+// order by a single connection. A connection which has completed its segment
+// takes over a segment given up by a failed connection or, otherwise, the
+// second half of the segment with the most bytes left, so that the fast
+// connections help the slow ones until the end of the download.
+
+#ifndef OMAHA_NET_DOWNLOAD_SEGMENTS_H_
+#define OMAHA_NET_DOWNLOAD_SEGMENTS_H_
+
+#include <windows.h>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "omaha/base/synchronized.h"
+
+namespace omaha {
+
+class DownloadSegments {
+ public:
+  // |file| is written with positional writes and must be open for writing
+  // until the download is over. Segments are never split in parts smaller
+  // than |min_segment_size| bytes.
+  DownloadSegments(HANDLE file, uint64 file_size, uint64 min_segment_size);
+  ~DownloadSegments();
+
+  // Splits the file in up to |max_segments| segments of about the same size.
+  // Returns the number of segments, which are numbered from 0. Each segment
+  // is downloaded by one connection.
+  int Split(int max_segments);
+
+  // Gets the range [first_byte, end) of the bytes left in |segment|.
+  void GetRange(int segment, uint64* first_byte, uint64* end) const;
+
+  // Writes the bytes received for |segment| at the next position of the
+  // segment. The bytes past the end of the segment are dropped, since they
+  // belong to a segment which has been taken over by another connection.
+  // |is_complete| is set when the segment has no bytes left. The segments are
+  // written at the same time by their connections.
+  HRESULT Write(int segment,
+                const void* data,
+                size_t size,
+                bool* is_complete);
+
+  // Gives up |segment| when its connection fails, so that another connection
+  // can take it over.
+  void Release(int segment);
+
+  // Takes over a segment that has been given up or the second half of the
+  // largest segment in progress. Returns false when there is no segment left
+  // to take over.
+  bool Take(int* segment);
+
+  // Returns the number of bytes written so far.
+  uint64 bytes_written() const;
+
+  uint64 file_size() const { return file_size_; }
+
+  // Returns true when all the segments have been written.
+  bool IsComplete() const;
+
+ private:
+  struct Segment {
+    Segment(uint64 first_byte, uint64 end_byte)
+        : next(first_byte), end(end_byte), is_active(true) {}
+
+    uint64 next;
+    uint64 end;
+    bool is_active;
+  };
+
+  const HANDLE file_;
+  const uint64 file_size_;
+  const uint64 min_segment_size_;
+
+  mutable LLock lock_;
+  std::vector<Segment> segments_;
+  uint64 bytes_written_;
+
+  DISALLOW_COPY_AND_ASSIGN(DownloadSegments);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_NET_DOWNLOAD_SEGMENTS_H_
@@ -0,0 +1,234 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/net/download_segments.h"
+
+#include <vector>
+
+#include "omaha/base/app_util.h"
+#include "omaha/base/file.h"
+#include "omaha/base/utils.h"
+#include "omaha/testing/unit_test.h"
+#include "omaha/third_party/smartany/scoped_any.h"
+
+namespace omaha {
+
+namespace {
+
+const uint64 kMinSegmentSize = 100;
+
+}  // namespace
+
+class DownloadSegmentsTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    filename_ = GetTempFilenameAt(app_util::GetTempDir(), _T("dst"));
+    ASSERT_FALSE(filename_.IsEmpty());
+    reset(file_, ::CreateFile(filename_, GENERIC_READ | GENERIC_WRITE, 0,
+                              NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL,
+                              NULL));
+    ASSERT_TRUE(valid(file_));
+  }
+
+  virtual void TearDown() {
+    reset(file_);
+    ::DeleteFile(filename_);
+  }
+
+  // Writes what is left of |segment| in chunks of |size| bytes, until the
+  // segment is complete. Each byte is the low byte of its offset.
+  void WriteSegment(DownloadSegments* segments, int segment, size_t size) {
+    uint64 first_byte = 0;
+    uint64 end = 0;
+    segments->GetRange(segment, &first_byte, &end);
+    for (bool is_complete = false; !is_complete;) {
+      std::vector<uint8> data(size);
+      for (size_t i = 0; i != size; ++i) {
+        data[i] = static_cast<uint8>(first_byte + i);
+      }
+      ASSERT_HRESULT_SUCCEEDED(segments->Write(segment, &data.front(), size,
+                                               &is_complete));
+      first_byte += size;
+    }
+  }
+
+  // Checks that each byte of the file is the low byte of its offset.
+  void CheckFile(uint64 size) {
+    std::vector<byte> contents;
+    ASSERT_HRESULT_SUCCEEDED(ReadEntireFileShareMode(filename_, 0, 0,
+                                                     &contents));
+    ASSERT_EQ(size, contents.size());
+    for (size_t i = 0; i != contents.size(); ++i) {
+      ASSERT_EQ(static_cast<uint8>(i), contents[i]) << i;
+    }
+  }
+
+  CString filename_;
+  scoped_hfile file_;
+};
+
+TEST_F(DownloadSegmentsTest, Split) {
+  DownloadSegments segments(get(file_), 1000, kMinSegmentSize);
+  EXPECT_EQ(4, segments.Split(4));
+
+  uint64 first_byte = 0;
+  uint64 end = 0;
+  segments.GetRange(0, &first_byte, &end);
+  EXPECT_EQ(0ULL, first_byte);
+  EXPECT_EQ(250ULL, end);
+  segments.GetRange(3, &first_byte, &end);
+  EXPECT_EQ(750ULL, first_byte);
+  EXPECT_EQ(1000ULL, end);
+}
+
+// The segments are never smaller than the minimum size.
+TEST_F(DownloadSegmentsTest, Split_SmallFile) {
+  DownloadSegments small(get(file_), 250, kMinSegmentSize);
+  EXPECT_EQ(2, small.Split(8));
+
+  DownloadSegments tiny(get(file_), 10, kMinSegmentSize);
+  EXPECT_EQ(1, tiny.Split(8));
+}
+
+TEST_F(DownloadSegmentsTest, WriteOutOfOrder) {
+  DownloadSegments segments(get(file_), 1003, kMinSegmentSize);
+  ASSERT_EQ(3, segments.Split(3));
+
+  WriteSegment(&segments, 2, 7);
+  EXPECT_FALSE(segments.IsComplete());
+  WriteSegment(&segments, 0, 11);
+  WriteSegment(&segments, 1, 1);
+  EXPECT_TRUE(segments.IsComplete());
+  EXPECT_EQ(1003ULL, segments.bytes_written());
+
+  int segment = 0;
+  EXPECT_FALSE(segments.Take(&segment));
+
+  reset(file_);
+  CheckFile(1003);
+}
+
+// A connection done with its segment takes over the second half of the
+// largest segment left. The bytes past the new end of that segment are
+// dropped.
+TEST_F(DownloadSegmentsTest, Take_SplitsLargestSegment) {
+  DownloadSegments segments(get(file_), 1000, kMinSegmentSize);
+  ASSERT_EQ(2, segments.Split(2));
+
+  WriteSegment(&segments, 1, 100);
+
+  int segment = 0;
+  ASSERT_TRUE(segments.Take(&segment));
+  EXPECT_EQ(2, segment);
+
+  uint64 first_byte = 0;
+  uint64 end = 0;
+  segments.GetRange(0, &first_byte, &end);
+  EXPECT_EQ(0ULL, first_byte);
+  EXPECT_EQ(250ULL, end);
+  segments.GetRange(2, &first_byte, &end);
+  EXPECT_EQ(250ULL, first_byte);
+  EXPECT_EQ(500ULL, end);
+
+  // Segment 0 was requested up to byte 500: the extra bytes are dropped.
+  std::vector<uint8> data(500);
+  for (size_t i = 0; i != data.size(); ++i) {
+    data[i] = static_cast<uint8>(i);
+  }
+  bool is_complete = false;
+  EXPECT_HRESULT_SUCCEEDED(segments.Write(0, &data.front(), data.size(),
+                                          &is_complete));
+  EXPECT_TRUE(is_complete);
+  EXPECT_EQ(750ULL, segments.bytes_written());
+
+  WriteSegment(&segments, 2, 50);
+  EXPECT_TRUE(segments.IsComplete());
+
+  reset(file_);
+  CheckFile(1000);
+}
+
+// Segments smaller than twice the minimum size are not split.
+TEST_F(DownloadSegmentsTest, Take_SmallSegmentLeft) {
+  DownloadSegments segments(get(file_), 300, kMinSegmentSize);
+  ASSERT_EQ(1, segments.Split(1));
+
+  std::vector<uint8> data(101);
+  bool is_complete = false;
+  ASSERT_HRESULT_SUCCEEDED(segments.Write(0, &data.front(), data.size(),
+                                          &is_complete));
+  EXPECT_FALSE(is_complete);
+
+  int segment = 0;
+  EXPECT_FALSE(segments.Take(&segment));
+}
+
+// A segment given up by a failed connection is taken over first, from the
+// byte where the connection stopped.
+TEST_F(DownloadSegmentsTest, Take_ReleasedSegment) {
+  DownloadSegments segments(get(file_), 1000, kMinSegmentSize);
+  ASSERT_EQ(2, segments.Split(2));
+
+  std::vector<uint8> data(10);
+  for (size_t i = 0; i != data.size(); ++i) {
+    data[i] = static_cast<uint8>(500 + i);
+  }
+  bool is_complete = false;
+  ASSERT_HRESULT_SUCCEEDED(segments.Write(1, &data.front(), data.size(),
+                                          &is_complete));
+  segments.Release(1);
+
+  int segment = 0;
+  ASSERT_TRUE(segments.Take(&segment));
+  EXPECT_EQ(1, segment);
+
+  uint64 first_byte = 0;
+  uint64 end = 0;
+  segments.GetRange(1, &first_byte, &end);
+  EXPECT_EQ(510ULL, first_byte);
+  EXPECT_EQ(1000ULL, end);
+
+  WriteSegment(&segments, 1, 70);
+  WriteSegment(&segments, 0, 64);
+  EXPECT_TRUE(segments.IsComplete());
+
+  reset(file_);
+  CheckFile(1000);
+}
+
+// The bytes of a failed write are downloaded again.
+TEST_F(DownloadSegmentsTest, Write_Fails) {
+  reset(file_);
+  scoped_hfile read_only_file(::CreateFile(filename_, GENERIC_READ, 0, NULL,
+                                           OPEN_EXISTING,
+                                           FILE_ATTRIBUTE_NORMAL, NULL));
+  ASSERT_TRUE(valid(read_only_file));
+
+  DownloadSegments segments(get(read_only_file), 1000, kMinSegmentSize);
+  ASSERT_EQ(2, segments.Split(2));
+
+  std::vector<uint8> data(10);
+  bool is_complete = false;
+  EXPECT_FAILED(segments.Write(1, &data.front(), data.size(), &is_complete));
+  EXPECT_EQ(0ULL, segments.bytes_written());
+
+  uint64 first_byte = 0;
+  uint64 end = 0;
+  segments.GetRange(1, &first_byte, &end);
+  EXPECT_EQ(500ULL, first_byte);
+  EXPECT_EQ(1000ULL, end);
+}
+
+}  // namespace omaha
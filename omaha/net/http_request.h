@@ -52,8 +52,14 @@ class HttpRequestInterface {
 
   virtual HRESULT Resume() = 0;
 
+  // Returns a copy of the response body.
   virtual std::vector<uint8> GetResponse() const = 0;
 
+  // Moves the response body into |response|, which avoids copying large
+  // bodies when they are handed over to the caller. The request does not
+  // hold the response afterwards.
+  virtual void TakeResponse(std::vector<uint8>* response) = 0;
+
   virtual int GetHttpStatusCode() const = 0;
 
   virtual HRESULT QueryHeadersString(uint32 info_level,
@@ -78,6 +84,11 @@ class HttpRequestInterface {
 
   virtual void set_low_priority(bool low_priority) = 0;
 
+  // Sets the number of connections a download may use at the same time when
+  // the server supports range requests. Requests which do not support
+  // segmented downloads ignore this value.
+  virtual void set_num_segments(int num_segments) = 0;
+
   virtual void set_callback(NetworkRequestCallback* callback) = 0;
 
   virtual void set_additional_headers(const CString& additional_headers) = 0;
@@ -100,6 +111,13 @@ class HttpRequestInterface {
   // they are meaningful for download requests only. Download requests are the
   // requests where the response goes to a file.
   virtual bool download_metrics(DownloadMetrics* download_metrics) const = 0;
+
+  // Returns true if the SHA-256 digest of the response is available and
+  // copies it in the |digest| function parameter. The digest is computed while
+  // the response is written to the file, which saves reading the file again to
+  // verify it. The digest is available after the Send() call has returned
+  // successfully and only for download requests.
+  virtual bool response_digest(std::vector<uint8>* digest) const = 0;
 };
 
 }   // namespace omaha
@@ -0,0 +1,31 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+// Declares the usage metrics used by the network stack.
+
+#ifndef OMAHA_NET_NET_METRICS_H_
+#define OMAHA_NET_NET_METRICS_H_
+
+#include "omaha/statsreport/metrics.h"
+
+namespace omaha {
+
+// Distribution of the time (ms) spent in NetworkRequest::Send and its
+// variants, including the retries.
+DECLARE_METRIC_histogram(net_request_send_ms);
+
+}  // namespace omaha
+
+#endif  // OMAHA_NET_NET_METRICS_H_
@@ -101,6 +101,10 @@ std::vector<DownloadMetrics> NetworkRequest::download_metrics() const {
   return impl_->download_metrics();
 }
 
+bool NetworkRequest::response_digest(std::vector<uint8>* digest) const {
+  return impl_->response_digest(digest);
+}
+
 HRESULT NetworkRequest::QueryHeadersString(uint32 info_level,
                                            const TCHAR* name,
                                            CString* value) {
@@ -111,6 +115,10 @@ void NetworkRequest::set_low_priority(bool low_priority) {
   return impl_->set_low_priority(low_priority);
 }
 
+void NetworkRequest::set_num_segments(int num_segments) {
+  return impl_->set_num_segments(num_segments);
+}
+
 void NetworkRequest::set_proxy_configuration(
     const ProxyConfig* proxy_configuration) {
   return impl_->set_proxy_configuration(proxy_configuration);
@@ -53,7 +53,7 @@ class NetworkRequestCallback {
   //               is not available.
   // status - WinHttp status codes regarding the progress of the request.
   // status_text - Additional information, when available.
-  virtual void OnProgress(int bytes, int bytes_total,
+  virtual void OnProgress(uint64 bytes, uint64 bytes_total,
                           int status, const TCHAR* status_text) = 0;
 
   virtual void OnRequestRetryScheduled(time64 next_retry_time) = 0;
@@ -155,6 +155,10 @@ class NetworkRequest {
   // Returns the download metrics corresponding to a download request.
   std::vector<DownloadMetrics> download_metrics() const;
 
+  // Returns true if the SHA-256 digest of the file downloaded by the last
+  // DownloadFile call is available and copies it in |digest|.
+  bool response_digest(std::vector<uint8>* digest) const;
+
   void set_proxy_auth_config(const ProxyAuthConfig& proxy_auth_config);
 
   // Sets the number of retries for the request. The retry mechanism uses
@@ -180,6 +184,11 @@ class NetworkRequest {
   // prioritization of requests.
   void set_low_priority(bool low_priority);
 
+  // Sets the number of connections DownloadFile may use at the same time to
+  // download different ranges of the file. The default is 1. WinHTTP requests
+  // use several connections only if the server accepts range requests.
+  void set_num_segments(int num_segments);
+
   // Overrides detecting the network configuration and uses the configuration
   // specified. If parameter is NULL, it defaults to detecting the configuration
   // automatically.
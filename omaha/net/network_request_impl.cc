@@ -35,6 +35,7 @@
 #include "omaha/base/time.h"
 #include "omaha/base/user_info.h"
 #include "omaha/net/http_client.h"
+#include "omaha/net/net_metrics.h"
 #include "omaha/net/net_utils.h"
 #include "omaha/net/network_config.h"
 #include "omaha/third_party/smartany/scoped_any.h"
@@ -90,6 +91,7 @@ NetworkRequestImpl::NetworkRequestImpl(
         proxy_auth_config_(NULL, CString()),
         num_retries_(0),
         low_priority_(false),
+        num_segments_(1),
         initial_retry_delay_ms_(kDefaultTimeBetweenRetriesMs),
         retry_delay_jitter_ms_(kDefaultRetryTimeJitterMs),
         http_status_code_(0),
@@ -148,6 +150,7 @@ void NetworkRequestImpl::Reset() {
   last_hr_               = S_OK;
   last_http_status_code_ = 0;
   download_metrics_.clear();
+  response_digest_.clear();
 }
 
 HRESULT NetworkRequestImpl::Close() {
@@ -242,6 +245,8 @@ HRESULT NetworkRequestImpl::DoSendWithRetries() {
   ASSERT1(num_retries_ >= 0);
   ASSERT1(response_ || !filename_.IsEmpty());
 
+  HISTOGRAM_TIME_SCOPE(metric_net_request_send_ms);
+
   Reset();
 
   int http_status_code(0);
@@ -454,7 +459,7 @@ HRESULT NetworkRequestImpl::DoSendWithConfig(
       error_hr = hr;
       error_http_status_code = cur_http_request_->GetHttpStatusCode();
       error_response_headers = cur_http_request_->GetResponseHeaders();
-      cur_http_request_->GetResponse().swap(error_response);
+      error_response.swap(*response);
       first_error_from_http_request_saved = true;
     }
 
@@ -508,6 +513,10 @@ HRESULT NetworkRequestImpl::DoSendHttpRequest(
 
   ASSERT1(cur_http_request_);
 
+  // The response of a previous request must not be mistaken for the response
+  // of this one if the request does not complete.
+  response->clear();
+
   // Set common HttpRequestInterface properties.
   cur_http_request_->set_session_handle(network_session_.session_handle);
   cur_http_request_->set_request_buffer(request_buffer_,
@@ -515,6 +524,7 @@ HRESULT NetworkRequestImpl::DoSendHttpRequest(
   cur_http_request_->set_url(url_);
   cur_http_request_->set_filename(filename_);
   cur_http_request_->set_low_priority(low_priority_);
+  cur_http_request_->set_num_segments(num_segments_);
   cur_http_request_->set_callback(callback_);
   cur_http_request_->set_additional_headers(BuildPerRequestHeaders());
   cur_http_request_->set_proxy_configuration(*cur_proxy_config_);
@@ -543,6 +553,11 @@ HRESULT NetworkRequestImpl::DoSendHttpRequest(
     download_metrics_.push_back(download_metrics);
   }
 
+  response_digest_.clear();
+  if (SUCCEEDED(last_hr_)) {
+    cur_http_request_->response_digest(&response_digest_);
+  }
+
   if (last_hr_ == GOOPDATE_E_CANCELLED) {
     return last_hr_;
   }
@@ -551,7 +566,7 @@ HRESULT NetworkRequestImpl::DoSendHttpRequest(
 
   *http_status_code = cur_http_request_->GetHttpStatusCode();
   *response_headers = cur_http_request_->GetResponseHeaders();
-  cur_http_request_->GetResponse().swap(*response);
+  cur_http_request_->TakeResponse(response);
 
   CString retry_after_header;
   if (IsHttpsUrl(url_) &&
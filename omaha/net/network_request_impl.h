@@ -90,6 +90,8 @@ class NetworkRequestImpl {
 
   void set_low_priority(bool low_priority) { low_priority_ = low_priority; }
 
+  void set_num_segments(int num_segments) { num_segments_ = num_segments; }
+
   void set_proxy_configuration(const ProxyConfig* proxy_configuration) {
     if (proxy_configuration) {
       proxy_configuration_.reset(new ProxyConfig);
@@ -105,6 +107,11 @@ class NetworkRequestImpl {
     return download_metrics_;
   }
 
+  bool response_digest(std::vector<uint8>* digest) const {
+    *digest = response_digest_;
+    return !response_digest_.empty();
+  }
+
   // Detects the available proxy configurations and returns the chain of
   // configurations to be used.
   void DetectProxyConfiguration(
@@ -175,6 +182,7 @@ class NetworkRequestImpl {
   ProxyAuthConfig proxy_auth_config_;
   int      num_retries_;
   bool     low_priority_;
+  int      num_segments_;
   int      initial_retry_delay_ms_;
   int      retry_delay_jitter_ms_;
 
@@ -221,6 +229,10 @@ class NetworkRequestImpl {
 
   std::vector<DownloadMetrics> download_metrics_;
 
+  // The digest of the downloaded file, if the http request which downloaded
+  // the file has computed it.
+  std::vector<uint8> response_digest_;
+
   static const int kDefaultTimeBetweenRetriesMs      = 5000;    // 5 seconds.
   static const int kServerErrMinTimeBetweenRetriesMs = 20000;   // 20 seconds.
   static const int kMaxTimeBetweenRetriesMs          = 100000;  // 100 seconds.
@@ -84,10 +84,11 @@ class NetworkRequestTest
 
   virtual void TearDown() {}
 
-  virtual void OnProgress(int bytes, int bytes_total, int, const TCHAR*) {
+  virtual void OnProgress(uint64 bytes, uint64 bytes_total, int,
+                          const TCHAR*) {
     UNREFERENCED_PARAMETER(bytes);
     UNREFERENCED_PARAMETER(bytes_total);
-    NET_LOG(L3, (_T("[downloading %d of %d]"), bytes, bytes_total));
+    NET_LOG(L3, (_T("[downloading %I64u of %I64u]"), bytes, bytes_total));
   }
 
   virtual void OnRequestBegin() {
@@ -0,0 +1,63 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/net/receive_buffer_pool.h"
+
+#include "omaha/base/debug.h"
+
+namespace omaha {
+
+ReceiveBufferPool::ReceiveBufferPool() : num_allocations_(0) {
+  free_buffers_.reserve(kMaxFreeBuffers);
+}
+
+ReceiveBufferPool::~ReceiveBufferPool() {
+  for (size_t i = 0; i != free_buffers_.size(); ++i) {
+    delete[] free_buffers_[i];
+  }
+}
+
+ReceiveBufferPool& ReceiveBufferPool::Instance() {
+  static ReceiveBufferPool pool;
+  return pool;
+}
+
+uint8* ReceiveBufferPool::Acquire() {
+  __mutexBlock(lock_) {
+    if (!free_buffers_.empty()) {
+      uint8* buffer = free_buffers_.back();
+      free_buffers_.pop_back();
+      return buffer;
+    }
+  }
+
+  ::InterlockedIncrement(&num_allocations_);
+  return new uint8[kBufferSize];
+}
+
+void ReceiveBufferPool::Release(uint8* buffer) {
+  ASSERT1(buffer);
+
+  __mutexBlock(lock_) {
+    if (free_buffers_.size() < kMaxFreeBuffers) {
+      free_buffers_.push_back(buffer);
+      return;
+    }
+  }
+
+  delete[] buffer;
+}
+
+}  // namespace omaha
@@ -0,0 +1,85 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// ReceiveBufferPool hands out fixed-size buffers to read network responses
+// into. The buffers are kept when released, so that the receive loops of the
+// requests do not allocate a buffer for each read.
+
+#ifndef OMAHA_NET_RECEIVE_BUFFER_POOL_H_
+#define OMAHA_NET_RECEIVE_BUFFER_POOL_H_
+
+#include <windows.h>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "omaha/base/synchronized.h"
+
+namespace omaha {
+
+class ReceiveBufferPool {
+ public:
+  // The size of the buffers of the pool.
+  static const size_t kBufferSize = 64 * 1024;
+
+  // The number of released buffers kept for reuse. The buffers released when
+  // the pool holds that many buffers already are freed.
+  static const size_t kMaxFreeBuffers = 8;
+
+  ReceiveBufferPool();
+  ~ReceiveBufferPool();
+
+  // Returns the pool shared by the requests of the process.
+  static ReceiveBufferPool& Instance();
+
+  // Returns a buffer of kBufferSize bytes. The buffer must be given back with
+  // Release.
+  uint8* Acquire();
+  void Release(uint8* buffer);
+
+  // Returns the number of buffers the pool has allocated so far.
+  int num_allocations() const { return num_allocations_; }
+
+ private:
+  LLock lock_;
+  std::vector<uint8*> free_buffers_;
+  volatile LONG num_allocations_;
+
+  DISALLOW_COPY_AND_ASSIGN(ReceiveBufferPool);
+};
+
+// Holds a buffer of a ReceiveBufferPool for the lifetime of the object.
+class ScopedReceiveBuffer {
+ public:
+  explicit ScopedReceiveBuffer(ReceiveBufferPool* pool)
+      : pool_(pool),
+        buffer_(pool->Acquire()) {}
+
+  ~ScopedReceiveBuffer() {
+    pool_->Release(buffer_);
+  }
+
+  uint8* data() const { return buffer_; }
+  DWORD size() const { return ReceiveBufferPool::kBufferSize; }
+
+ private:
+  ReceiveBufferPool* pool_;
+  uint8* buffer_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedReceiveBuffer);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_NET_RECEIVE_BUFFER_POOL_H_
@@ -0,0 +1,93 @@
+// Copyright 2026 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/net/receive_buffer_pool.h"
+
+#include <vector>
+
+#include "omaha/testing/unit_test.h"
+
+namespace omaha {
+
+TEST(ReceiveBufferPoolTest, ReusesReleasedBuffers) {
+  ReceiveBufferPool pool;
+  EXPECT_EQ(0, pool.num_allocations());
+
+  uint8* buffer = pool.Acquire();
+  ASSERT_TRUE(buffer);
+  buffer[0] = 1;
+  buffer[ReceiveBufferPool::kBufferSize - 1] = 1;
+  pool.Release(buffer);
+  EXPECT_EQ(1, pool.num_allocations());
+
+  // Reading many responses one after the other allocates a single buffer.
+  for (int i = 0; i != 100; ++i) {
+    ScopedReceiveBuffer scoped_buffer(&pool);
+    EXPECT_EQ(buffer, scoped_buffer.data());
+    EXPECT_EQ(static_cast<DWORD>(ReceiveBufferPool::kBufferSize),
+              scoped_buffer.size());
+  }
+  EXPECT_EQ(1, pool.num_allocations());
+}
+
+TEST(ReceiveBufferPoolTest, ConcurrentBuffers) {
+  ReceiveBufferPool pool;
+
+  std::vector<uint8*> buffers;
+  for (int i = 0; i != 3; ++i) {
+    buffers.push_back(pool.Acquire());
+  }
+  EXPECT_EQ(3, pool.num_allocations());
+  EXPECT_NE(buffers[0], buffers[1]);
+  EXPECT_NE(buffers[1], buffers[2]);
+
+  for (size_t i = 0; i != buffers.size(); ++i) {
+    pool.Release(buffers[i]);
+  }
+
+  for (size_t i = 0; i != buffers.size(); ++i) {
+    buffers[i] = pool.Acquire();
+  }
+  EXPECT_EQ(3, pool.num_allocations());
+  for (size_t i = 0; i != buffers.size(); ++i) {
+    pool.Release(buffers[i]);
+  }
+}
+
+// The pool keeps at most kMaxFreeBuffers buffers once they are released.
+TEST(ReceiveBufferPoolTest, FreesExtraBuffers) {
+  ReceiveBufferPool pool;
+  const int kNumBuffers = ReceiveBufferPool::kMaxFreeBuffers + 2;
+
+  std::vector<uint8*> buffers;
+  for (int i = 0; i != kNumBuffers; ++i) {
+    buffers.push_back(pool.Acquire());
+  }
+  for (int i = 0; i != kNumBuffers; ++i) {
+    pool.Release(buffers[i]);
+  }
+  EXPECT_EQ(kNumBuffers, pool.num_allocations());
+
+  buffers.clear();
+  for (int i = 0; i != kNumBuffers; ++i) {
+    buffers.push_back(pool.Acquire());
+  }
+  EXPECT_EQ(kNumBuffers + 2, pool.num_allocations());
+  for (int i = 0; i != kNumBuffers; ++i) {
+    pool.Release(buffers[i]);
+  }
+}
+
+}  // namespace omaha
@@ -28,7 +28,10 @@
 
 #include "omaha/net/simple_request.h"
 #include <atlconv.h>
+#include <atlsecurity.h>
 #include <intsafe.h>
+#include <objbase.h>
+#include <algorithm>
 #include <climits>
 #include <memory>
 #include <vector>
@@ -39,16 +42,163 @@
 #include "omaha/base/logging.h"
 #include "omaha/base/safe_format.h"
 #include "omaha/base/scope_guard.h"
+#include "omaha/base/scoped_impersonation.h"
+#include "omaha/base/signatures.h"
 #include "omaha/base/string.h"
+#include "omaha/base/thread.h"
 #include "omaha/common/ping_event_download_metrics.h"
+#include "omaha/net/download_segments.h"
 #include "omaha/net/network_config.h"
 #include "omaha/net/network_request.h"
 #include "omaha/net/proxy_auth.h"
+#include "omaha/net/receive_buffer_pool.h"
 #include "omaha/net/winhttp_adapter.h"
 #include "omaha/third_party/smartany/scoped_any.h"
 
 namespace omaha {
 
+namespace {
+
+// Segmented downloads start only for files of at least two segments, and
+// segments are not split in parts smaller than this.
+const uint64 kMinSegmentSize = 1024 * 1024;
+
+// Bounds the number of connections of a download. Each connection beyond the
+// first one runs on a thread of its own.
+const int kMaxSegments = 8;
+
+// How often the progress of the other connections is reported while waiting
+// for them to complete.
+const DWORD kSegmentProgressIntervalMs = 200;
+
+// Responses received in memory are preallocated from the Content-Length
+// header up to this size. Larger responses grow as they are received, so that
+// a bogus header does not cause a large allocation.
+const uint64 kMaxPreallocatedResponseSize = 16 * 1024 * 1024;
+
+// Returns the number of bytes to read next into a receive buffer of
+// |buffer_size| bytes. At least one byte is read, which blocks until more
+// data is available or the response is complete.
+DWORD GetReadSize(DWORD bytes_available, DWORD buffer_size) {
+  return std::min(std::max(bytes_available, static_cast<DWORD>(1)),
+                  buffer_size);
+}
+
+// Gets the COINIT flags matching the apartment of the calling thread. Returns
+// false if COM is not initialized on the calling thread.
+bool GetComApartmentFlags(DWORD* co_init) {
+  ASSERT1(co_init);
+
+  APTTYPE type = APTTYPE_CURRENT;
+  APTTYPEQUALIFIER qualifier = APTTYPEQUALIFIER_NONE;
+  if (FAILED(::CoGetApartmentType(&type, &qualifier))) {
+    return false;
+  }
+  *co_init = type == APTTYPE_STA || type == APTTYPE_MAINSTA ?
+             COINIT_APARTMENTTHREADED : COINIT_MULTITHREADED;
+  return true;
+}
+
+}  // namespace
+
+class SimpleRequest::SegmentWorker : public Runnable {
+ public:
+  // The requests of the worker use the same session, url, and configuration
+  // as |parent|. Only the worker which runs on the thread of |parent| is
+  // given a |callback| to report progress. The thread of the worker runs as
+  // |impersonation_token|, which may be NULL, and initializes COM with
+  // |co_init| if |is_com_initialized| is true, like the thread of |parent|.
+  SegmentWorker(const SimpleRequest& parent,
+                DownloadSegments* segments,
+                NetworkRequestCallback* callback,
+                HANDLE impersonation_token,
+                bool is_com_initialized,
+                DWORD co_init)
+      : segments_(segments),
+        impersonation_token_(impersonation_token),
+        is_com_initialized_(is_com_initialized),
+        co_init_(co_init),
+        first_segment_(-1),
+        hr_(S_OK) {
+    ASSERT1(segments);
+    request_.set_session_handle(parent.session_handle_);
+    request_.set_url(parent.url_);
+    request_.set_proxy_configuration(parent.proxy_config_);
+    request_.set_additional_headers(parent.additional_headers_);
+    request_.set_user_agent(parent.user_agent_);
+    request_.set_proxy_auth_config(parent.proxy_auth_config_);
+    request_.set_low_priority(parent.low_priority_);
+    request_.set_callback(callback);
+    request_.range_validator_ = parent.range_validator_;
+  }
+
+  virtual ~SegmentWorker() {}
+
+  // Downloads |segment| and then the segments it takes over on a new thread.
+  bool Start(int segment) {
+    first_segment_ = segment;
+    return thread_.Start(this);
+  }
+
+  // Downloads |segment| and then the segments it takes over. A negative
+  // |segment| takes over a segment first.
+  HRESULT Download(int segment) {
+    if (segment < 0 && !segments_->Take(&segment)) {
+      return S_OK;
+    }
+
+    for (;;) {
+      request_.segments_ = segments_;
+      request_.segment_ = segment;
+      HRESULT hr = request_.Send();
+      if (FAILED(hr)) {
+        NET_LOG(LW, (_T("[SegmentWorker::Download failed][%d][0x%08x]"),
+                     segment, hr));
+        segments_->Release(segment);
+        return hr;
+      }
+      if (!segments_->Take(&segment)) {
+        return S_OK;
+      }
+    }
+  }
+
+  void Cancel() {
+    VERIFY1(SUCCEEDED(request_.Cancel()));
+  }
+
+  HANDLE thread_handle() const { return thread_.GetThreadHandle(); }
+
+  HRESULT hr() const { return hr_; }
+
+ private:
+  virtual void Run() {
+    if (!is_com_initialized_) {
+      DownloadImpersonated();
+      return;
+    }
+
+    scoped_co_init init_com_apt(co_init_);
+    DownloadImpersonated();
+  }
+
+  void DownloadImpersonated() {
+    scoped_impersonation impersonate_user(impersonation_token_);
+    hr_ = Download(first_segment_);
+  }
+
+  SimpleRequest request_;
+  DownloadSegments* segments_;
+  HANDLE impersonation_token_;  // Not owned by this class.
+  bool is_com_initialized_;
+  DWORD co_init_;
+  Thread thread_;
+  int first_segment_;
+  HRESULT hr_;
+
+  DISALLOW_COPY_AND_ASSIGN(SegmentWorker);
+};
+
 SimpleRequest::TransientRequestState::TransientRequestState()
     : port(0),
       is_https(false),
@@ -73,7 +223,11 @@ SimpleRequest::SimpleRequest()
       proxy_auth_config_(NULL, CString()),
       low_priority_(false),
       callback_(NULL),
-      download_completed_(false) {
+      download_completed_(false),
+      num_segments_(1),
+      is_segmentation_disabled_(false),
+      segments_(NULL),
+      segment_(0) {
   SafeCStringFormat(&user_agent_, _T("%s;winhttp"),
                     NetworkConfig::GetUserAgent());
 
@@ -140,6 +294,9 @@ HRESULT SimpleRequest::Cancel() {
   __mutexScope(lock_);
   is_canceled_ = true;
   CloseHandles();
+  for (size_t i = 0; i != segment_workers_.size(); ++i) {
+    segment_workers_[i]->Cancel();
+  }
 
   // Resume the downloading thread if it is blocked. It is still fine if the
   // event is set since the operation is like no-op in that case.
@@ -225,6 +382,12 @@ HRESULT SimpleRequest::Send() {
         return hr;
       }
 
+      // Cancel may have been called before the adapter above existed, in
+      // which case it had no handles to close.
+      if (is_canceled_) {
+        return GOOPDATE_E_CANCELLED;
+      }
+
       if (!IsPauseSupported() || request_state_ == NULL) {
         request_state_.reset(new TransientRequestState);
       } else {
@@ -235,6 +398,7 @@ HRESULT SimpleRequest::Send() {
         auto request_state = std::make_unique<TransientRequestState>();
         request_state->content_length = request_state_->content_length;
         request_state->current_bytes = request_state_->current_bytes;
+        request_state->response_hash.swap(request_state_->response_hash);
 
         request_state_.swap(request_state);
       }
@@ -346,11 +510,24 @@ HRESULT SimpleRequest::Connect() {
   CString additional_headers = additional_headers_;
 
   // If the target has been partially downloaded, send a range request to resume
-  // download, instead of starting from scratch again.
-  if (request_state_->current_bytes != 0 &&
+  // download, instead of starting from scratch again. The requests of a
+  // segmented download ask for the range of their segment.
+  if (segments_) {
+    uint64 first_byte = 0;
+    uint64 end = 0;
+    segments_->GetRange(segment_, &first_byte, &end);
+    ASSERT1(first_byte < end);
+    SafeCStringAppendFormat(&additional_headers,
+                            _T("Range: bytes=%I64u-%I64u\r\n"),
+                            first_byte, end - 1);
+    if (!range_validator_.IsEmpty()) {
+      SafeCStringAppendFormat(&additional_headers, _T("If-Range: %s\r\n"),
+                              range_validator_);
+    }
+  } else if (request_state_->current_bytes != 0 &&
       request_state_->current_bytes != request_state_->content_length) {
     ASSERT1(request_state_->current_bytes < request_state_->content_length);
-    SafeCStringAppendFormat(&additional_headers, _T("Range: bytes=%d-\r\n"),
+    SafeCStringAppendFormat(&additional_headers, _T("Range: bytes=%I64u-\r\n"),
                             request_state_->current_bytes);
   }
   if (!additional_headers.IsEmpty()) {
@@ -378,20 +555,28 @@ HRESULT SimpleRequest::OpenDestinationFile(HANDLE* file_handle) {
   DWORD create_disposition = request_state_->content_length == 0 ?
                              CREATE_ALWAYS : OPEN_ALWAYS;
 
-  scoped_hfile file(::CreateFile(filename_, GENERIC_WRITE, 0, NULL,
-                                 create_disposition, FILE_ATTRIBUTE_NORMAL,
-                                 NULL));
+  // The file is opened for reading too, in order to hash the part of the file
+  // which has been downloaded already when a download is resumed.
+  scoped_hfile file(::CreateFile(filename_, GENERIC_READ | GENERIC_WRITE, 0,
+                                 NULL, create_disposition,
+                                 FILE_ATTRIBUTE_NORMAL, NULL));
 
   if (!file) {
     return HRESULTFromLastError();
   }
 
+  if (!request_state_->response_hash.get()) {
+    request_state_->response_hash.reset(new StreamingHash);
+  }
+  StreamingHash* response_hash = request_state_->response_hash.get();
+  request_state_->response_digest.clear();
+
   if (request_state_->content_length != 0) {
-    DWORD raw_file_size = ::GetFileSize(get(file), NULL);
-    if (INVALID_FILE_SIZE == raw_file_size || raw_file_size > INT_MAX) {
-      return E_FAIL;
+    LARGE_INTEGER raw_file_size = {};
+    if (!::GetFileSizeEx(get(file), &raw_file_size)) {
+      return HRESULTFromLastError();
     }
-    int file_size = static_cast<int>(raw_file_size);
+    const uint64 file_size = static_cast<uint64>(raw_file_size.QuadPart);
 
     // Local file size should not be greater than remote file size and file
     // size must match the number of bytes we previously downloaded. If not,
@@ -402,16 +587,29 @@ HRESULT SimpleRequest::OpenDestinationFile(HANDLE* file_handle) {
     if (need_reset_file) {
       // Need to download from byte 0. Reopen the file with truncation.
       request_state_->current_bytes = 0;
-      reset(file, ::CreateFile(filename_, GENERIC_WRITE, 0, NULL,
-                               CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL));
+      response_hash->Reset();
+      reset(file, ::CreateFile(filename_, GENERIC_READ | GENERIC_WRITE, 0,
+                               NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL,
+                               NULL));
 
       if (!file) {
         return HRESULTFromLastError();
       }
     } else {
-      LARGE_INTEGER start_pos;
-      start_pos.LowPart = static_cast<DWORD>(request_state_->current_bytes);
-      start_pos.HighPart = 0;
+      // Only hash the bytes already in the file if the hash does not cover
+      // them yet, for instance, when the previous attempt failed before the
+      // last bytes written were hashed.
+      const uint64 current_bytes = request_state_->current_bytes;
+      if (response_hash->length() != current_bytes) {
+        response_hash->Reset();
+        HRESULT hr = response_hash->UpdateFromFile(get(file), current_bytes);
+        if (FAILED(hr)) {
+          return hr;
+        }
+      }
+
+      LARGE_INTEGER start_pos = {};
+      start_pos.QuadPart = static_cast<LONGLONG>(current_bytes);
       if (!::SetFilePointerEx(get(file), start_pos, NULL, FILE_BEGIN)) {
         return HRESULTFromLastError();
       }
@@ -419,6 +617,7 @@ HRESULT SimpleRequest::OpenDestinationFile(HANDLE* file_handle) {
   } else {
     // Always start from byte 0 if we don't know remote file size.
     request_state_->current_bytes = 0;
+    response_hash->Reset();
   }
 
   *file_handle = release(file);
@@ -590,6 +789,10 @@ HRESULT SimpleRequest::ReceiveData(HANDLE file_handle) {
 
   HRESULT hr = S_OK;
 
+  if (segments_) {
+    return ReceiveSegment();
+  }
+
   // In the case of a "204 No Content" response, WinHttp blocks when
   // querying or reading the available data. According to the RFC,
   // the 204 response must not include a message-body, and thus is always
@@ -601,11 +804,19 @@ HRESULT SimpleRequest::ReceiveData(HANDLE file_handle) {
     return S_OK;
   }
 
-  int content_length = 0;
-  winhttp_adapter_->QueryRequestHeadersInt(WINHTTP_QUERY_CONTENT_LENGTH,
-                                           WINHTTP_HEADER_NAME_BY_INDEX,
-                                           &content_length,
-                                           WINHTTP_NO_HEADER_INDEX);
+  // WINHTTP_QUERY_FLAG_NUMBER truncates the content length to 32 bits, so the
+  // header is parsed here instead.
+  uint64 content_length = 0;
+  CString content_length_string;
+  if (SUCCEEDED(winhttp_adapter_->QueryRequestHeadersString(
+          WINHTTP_QUERY_CONTENT_LENGTH,
+          WINHTTP_HEADER_NAME_BY_INDEX,
+          &content_length_string,
+          WINHTTP_NO_HEADER_INDEX)) &&
+      !String_StringToDecimalUint64Checked(content_length_string,
+                                           &content_length)) {
+    content_length = 0;
+  }
   if (request_state_->content_length == 0) {
     request_state_->content_length = content_length;
     request_state_->current_bytes = 0;
@@ -615,34 +826,44 @@ HRESULT SimpleRequest::ReceiveData(HANDLE file_handle) {
       request_state_->http_status_code == HTTP_STATUS_OK ||
       request_state_->http_status_code == HTTP_STATUS_PARTIAL_CONTENT;
 
-  std::vector<uint8> buffer;
+  if (IsSegmentedDownloadPossible()) {
+    return ReceiveDataInSegments(file_handle);
+  }
+
+  if (filename_.IsEmpty() &&
+      request_state_->content_length <= kMaxPreallocatedResponseSize) {
+    request_state_->response.reserve(
+        static_cast<size_t>(request_state_->content_length));
+  }
+
+  ScopedReceiveBuffer buffer(&ReceiveBufferPool::Instance());
+  DWORD bytes_available(0);
   do  {
-    DWORD bytes_available(0);
     winhttp_adapter_->QueryDataAvailable(&bytes_available);
-    buffer.resize(1 + bytes_available);
-    hr = winhttp_adapter_->ReadData(&buffer.front(),
-                                    static_cast<DWORD>(buffer.size()),
+    hr = winhttp_adapter_->ReadData(buffer.data(),
+                                    GetReadSize(bytes_available,
+                                                buffer.size()),
                                     &bytes_available);
     if (FAILED(hr)) {
       return hr;
     }
 
-    buffer.resize(bytes_available);
-    if (!buffer.empty()) {
+    if (bytes_available) {
       if (!filename_.IsEmpty()) {
         DWORD num_bytes(0);
         if (!::WriteFile(file_handle,
-                         reinterpret_cast<const char*>(&buffer.front()),
-                         static_cast<DWORD>(buffer.size()),
+                         buffer.data(),
+                         bytes_available,
                          &num_bytes,
                          NULL)) {
           return HRESULTFromLastError();
         }
-        ASSERT1(num_bytes == buffer.size());
+        ASSERT1(num_bytes == bytes_available);
+        request_state_->response_hash->Update(buffer.data(), bytes_available);
       } else {
         request_state_->response.insert(request_state_->response.end(),
-                                        buffer.begin(),
-                                        buffer.end());
+                                        buffer.data(),
+                                        buffer.data() + bytes_available);
       }
     }
 
@@ -661,24 +882,309 @@ HRESULT SimpleRequest::ReceiveData(HANDLE file_handle) {
                             WINHTTP_CALLBACK_STATUS_READ_COMPLETE,
                             NULL);
     }
-  } while (!buffer.empty());
+  } while (bytes_available);
 
-  NET_LOG(L3, (_T("[bytes downloaded %d]"), request_state_->current_bytes));
+  NET_LOG(L3, (_T("[bytes downloaded %I64u]"), request_state_->current_bytes));
+#ifdef DEBUG
   if (file_handle != INVALID_HANDLE_VALUE) {
     // All bytes must be written to the file in the file download case.
-    ASSERT1(::SetFilePointer(file_handle, 0, NULL, FILE_CURRENT) ==
-            static_cast<DWORD>(request_state_->current_bytes));
+    LARGE_INTEGER zero = {};
+    LARGE_INTEGER file_pos = {};
+    VERIFY1(::SetFilePointerEx(file_handle, zero, &file_pos, FILE_CURRENT));
+    ASSERT1(static_cast<uint64>(file_pos.QuadPart) ==
+            request_state_->current_bytes);
   }
+#endif
 
   if (request_state_->content_length &&
       request_state_->content_length != request_state_->current_bytes) {
     return HRESULT_FROM_WIN32(ERROR_WINHTTP_CONNECTION_ERROR);
   }
 
+  // Only the digest of a successful response is meaningful to the caller.
+  if (!filename_.IsEmpty() && is_http_success) {
+    request_state_->response_hash->Finalize(&request_state_->response_digest);
+  }
+
   download_completed_ = true;
   return hr;
 }
 
+bool SimpleRequest::IsSegmentedDownloadPossible() const {
+  if (filename_.IsEmpty() ||
+      num_segments_ <= 1 ||
+      is_segmentation_disabled_ ||
+      request_state_->http_status_code != HTTP_STATUS_OK ||
+      request_state_->current_bytes != 0 ||
+      request_state_->content_length < 2 * kMinSegmentSize) {
+    return false;
+  }
+
+  CString accept_ranges;
+  if (FAILED(winhttp_adapter_->QueryRequestHeadersString(
+          WINHTTP_QUERY_ACCEPT_RANGES,
+          WINHTTP_HEADER_NAME_BY_INDEX,
+          &accept_ranges,
+          WINHTTP_NO_HEADER_INDEX))) {
+    return false;
+  }
+  if (accept_ranges.Trim().CompareNoCase(_T("bytes")) != 0) {
+    return false;
+  }
+
+  // Without a validator, the segments could come from different versions of
+  // the file.
+  CString validator;
+  return GetRangeValidator(&validator);
+}
+
+bool SimpleRequest::GetRangeValidator(CString* validator) const {
+  ASSERT1(validator);
+
+  // Weak ETags can't be used in an If-Range header.
+  CString etag;
+  if (SUCCEEDED(winhttp_adapter_->QueryRequestHeadersString(
+          WINHTTP_QUERY_ETAG,
+          WINHTTP_HEADER_NAME_BY_INDEX,
+          &etag,
+          WINHTTP_NO_HEADER_INDEX)) &&
+      !etag.Trim().IsEmpty() &&
+      etag.Left(2) != _T("W/")) {
+    *validator = etag;
+    return true;
+  }
+
+  CString last_modified;
+  if (SUCCEEDED(winhttp_adapter_->QueryRequestHeadersString(
+          WINHTTP_QUERY_LAST_MODIFIED,
+          WINHTTP_HEADER_NAME_BY_INDEX,
+          &last_modified,
+          WINHTTP_NO_HEADER_INDEX)) &&
+      !last_modified.Trim().IsEmpty()) {
+    *validator = last_modified;
+    return true;
+  }
+
+  return false;
+}
+
+HRESULT SimpleRequest::ReceiveDataInSegments(HANDLE file_handle) {
+  ASSERT1(file_handle != INVALID_HANDLE_VALUE);
+  ASSERT1(!segments_);
+
+  const uint64 file_size = request_state_->content_length;
+
+  // Preallocating the file avoids extending it while the segments are
+  // written out of order.
+  LARGE_INTEGER end_pos = {};
+  end_pos.QuadPart = static_cast<LONGLONG>(file_size);
+  if (!::SetFilePointerEx(file_handle, end_pos, NULL, FILE_BEGIN) ||
+      !::SetEndOfFile(file_handle)) {
+    return HRESULTFromLastError();
+  }
+
+  VERIFY1(GetRangeValidator(&range_validator_));
+
+  // The other connections run as the same user and in the same kind of COM
+  // apartment as this connection, since the proxy detection and the proxy
+  // authentication depend on both. The workers are done with the token before
+  // it is closed.
+  CAccessToken thread_token;
+  thread_token.GetThreadToken(TOKEN_QUERY | TOKEN_DUPLICATE |
+                              TOKEN_IMPERSONATE);
+  DWORD co_init = COINIT_MULTITHREADED;
+  const bool is_com_initialized = GetComApartmentFlags(&co_init);
+
+  DownloadSegments segments(file_handle, file_size, kMinSegmentSize);
+  const int num_segments = segments.Split(std::min(num_segments_,
+                                                   kMaxSegments));
+  NET_LOG(L3, (_T("[SimpleRequest::ReceiveDataInSegments][%d segments]"),
+               num_segments));
+
+  // The other connections start first, while this connection downloads the
+  // first segment. Then this connection takes over the segments left, and
+  // reports the progress of all connections.
+  std::vector<HANDLE> threads;
+  SegmentWorker* worker = NULL;
+  __mutexBlock(lock_) {
+    if (is_canceled_) {
+      return GOOPDATE_E_CANCELLED;
+    }
+    for (int i = 1; i < num_segments; ++i) {
+      segment_workers_.push_back(std::make_unique<SegmentWorker>(
+          *this, &segments, nullptr, thread_token.GetHandle(),
+          is_com_initialized, co_init));
+      if (segment_workers_.back()->Start(i)) {
+        threads.push_back(segment_workers_.back()->thread_handle());
+      } else {
+        segments.Release(i);
+      }
+    }
+    segment_workers_.push_back(std::make_unique<SegmentWorker>(
+        *this, &segments, callback_, thread_token.GetHandle(),
+        is_com_initialized, co_init));
+    worker = segment_workers_.back().get();
+  }
+
+  segments_ = &segments;
+  segment_ = 0;
+  HRESULT hr = ReceiveSegment();
+  segments_ = NULL;
+  if (FAILED(hr)) {
+    NET_LOG(LW, (_T("[ReceiveSegment failed][0x%08x]"), hr));
+    segments.Release(0);
+  }
+
+  if (!is_canceled_) {
+    worker->Download(-1);
+  }
+
+  while (!threads.empty()) {
+    const DWORD result = ::WaitForMultipleObjects(
+        static_cast<DWORD>(threads.size()), &threads.front(), true,
+        kSegmentProgressIntervalMs);
+    if (result == WAIT_FAILED) {
+      // The threads use |segments| and the token, which live on this stack,
+      // so they are stopped and waited for one at a time.
+      NET_LOG(LE, (_T("[WaitForMultipleObjects failed][0x%08x]"),
+                   HRESULTFromLastError()));
+      __mutexBlock(lock_) {
+        for (size_t i = 0; i != segment_workers_.size(); ++i) {
+          segment_workers_[i]->Cancel();
+        }
+      }
+      for (size_t i = 0; i != threads.size(); ++i) {
+        VERIFY1(::WaitForSingleObject(threads[i], INFINITE) == WAIT_OBJECT_0);
+      }
+      break;
+    }
+    if (result != WAIT_TIMEOUT) {
+      break;
+    }
+    if (callback_) {
+      callback_->OnProgress(segments.bytes_written(),
+                            file_size,
+                            WINHTTP_CALLBACK_STATUS_READ_COMPLETE,
+                            NULL);
+    }
+  }
+
+  __mutexBlock(lock_) {
+    segment_workers_.clear();
+  }
+
+  if (is_canceled_) {
+    return GOOPDATE_E_CANCELLED;
+  }
+
+  if (!segments.IsComplete()) {
+    // The next attempt downloads the file over a single connection.
+    NET_LOG(LW, (_T("[segmented download failed][%I64u of %I64u bytes]"),
+                 segments.bytes_written(), file_size));
+    is_segmentation_disabled_ = true;
+    return HRESULT_FROM_WIN32(ERROR_WINHTTP_CONNECTION_ERROR);
+  }
+
+  request_state_->current_bytes = file_size;
+  StreamingHash* response_hash = request_state_->response_hash.get();
+  response_hash->Reset();
+  hr = response_hash->UpdateFromFile(file_handle, file_size);
+  if (FAILED(hr)) {
+    return hr;
+  }
+  response_hash->Finalize(&request_state_->response_digest);
+
+  if (callback_) {
+    callback_->OnProgress(file_size,
+                          file_size,
+                          WINHTTP_CALLBACK_STATUS_READ_COMPLETE,
+                          NULL);
+  }
+
+  download_completed_ = true;
+  return S_OK;
+}
+
+HRESULT SimpleRequest::ReceiveSegment() {
+  ASSERT1(segments_);
+
+  uint64 first_byte = 0;
+  uint64 end = 0;
+  segments_->GetRange(segment_, &first_byte, &end);
+
+  // A server which ignores the range sends the whole file, which is only
+  // usable for the first segment.
+  const int status_code = request_state_->http_status_code;
+  if (status_code == HTTP_STATUS_PARTIAL_CONTENT) {
+    CString content_range;
+    uint64 range_start = 0;
+    HRESULT hr = winhttp_adapter_->QueryRequestHeadersString(
+        WINHTTP_QUERY_CONTENT_RANGE,
+        WINHTTP_HEADER_NAME_BY_INDEX,
+        &content_range,
+        WINHTTP_NO_HEADER_INDEX);
+    if (FAILED(hr)) {
+      return hr;
+    }
+    const int start = content_range.Find(_T(' ')) + 1;
+    const int dash = content_range.Find(_T('-'), start);
+    if (!start || dash < 0 ||
+        !String_StringToDecimalUint64Checked(
+            content_range.Mid(start, dash - start), &range_start) ||
+        range_start != first_byte) {
+      NET_LOG(LE, (_T("[unexpected Content-Range][%s]"), content_range));
+      return HRESULT_FROM_WIN32(ERROR_WINHTTP_INVALID_SERVER_RESPONSE);
+    }
+  } else if (status_code != HTTP_STATUS_OK || first_byte != 0) {
+    return status_code == HTTP_STATUS_OK ?
+        HRESULT_FROM_WIN32(ERROR_WINHTTP_INVALID_SERVER_RESPONSE) :
+        HRESULTFromHttpStatusCode(status_code);
+  }
+
+  // A server which does not support If-Range sends the range of the current
+  // version of the file.
+  CString validator;
+  if (!range_validator_.IsEmpty() &&
+      (!GetRangeValidator(&validator) || validator != range_validator_)) {
+    NET_LOG(LE, (_T("[the file changed][%s][%s]"),
+                 range_validator_, validator));
+    return HRESULT_FROM_WIN32(ERROR_WINHTTP_INVALID_SERVER_RESPONSE);
+  }
+
+  ScopedReceiveBuffer buffer(&ReceiveBufferPool::Instance());
+  for (bool is_complete = false; !is_complete;) {
+    DWORD bytes_available(0);
+    winhttp_adapter_->QueryDataAvailable(&bytes_available);
+    HRESULT hr = winhttp_adapter_->ReadData(buffer.data(),
+                                            GetReadSize(bytes_available,
+                                                        buffer.size()),
+                                            &bytes_available);
+    if (FAILED(hr)) {
+      return hr;
+    }
+
+    // The response ended before the end of the segment.
+    if (!bytes_available) {
+      return HRESULT_FROM_WIN32(ERROR_WINHTTP_CONNECTION_ERROR);
+    }
+
+    hr = segments_->Write(segment_, buffer.data(), bytes_available,
+                          &is_complete);
+    if (FAILED(hr)) {
+      return hr;
+    }
+
+    if (callback_) {
+      callback_->OnProgress(segments_->bytes_written(),
+                            segments_->file_size(),
+                            WINHTTP_CALLBACK_STATUS_READ_COMPLETE,
+                            NULL);
+    }
+  }
+
+  return S_OK;
+}
+
 HRESULT SimpleRequest::PrepareRequest(HANDLE* file_handle) {
   // Read the remaining bytes of the body. If we have a file to save the
   // response into, create the file.
@@ -711,6 +1217,14 @@ std::vector<uint8> SimpleRequest::GetResponse() const {
                                 std::vector<uint8>();
 }
 
+void SimpleRequest::TakeResponse(std::vector<uint8>* response) {
+  ASSERT1(response);
+  response->clear();
+  if (request_state_.get()) {
+    response->swap(request_state_->response);
+  }
+}
+
 HRESULT SimpleRequest::QueryHeadersString(uint32 info_level,
                                           const TCHAR* name,
                                           CString* value) const {
@@ -861,8 +1375,10 @@ DownloadMetrics SimpleRequest::MakeDownloadMetrics(HRESULT hr) const {
   download_metrics.url = url_;
   download_metrics.downloader = DownloadMetrics::kWinHttp;
   download_metrics.error = error;
-  download_metrics.downloaded_bytes = request_state_->current_bytes;
-  download_metrics.total_bytes = request_state_->content_length;
+  download_metrics.downloaded_bytes =
+      static_cast<int64>(request_state_->current_bytes);
+  download_metrics.total_bytes =
+      static_cast<int64>(request_state_->content_length);
   download_metrics.download_time_ms =
       request_state_->request_end_ms - request_state_->request_begin_ms;
   return download_metrics;
@@ -878,4 +1394,14 @@ bool SimpleRequest::download_metrics(DownloadMetrics* dm) const {
   }
 }
 
+bool SimpleRequest::response_digest(std::vector<uint8>* digest) const {
+  ASSERT1(digest);
+  if (request_state_.get() && !request_state_->response_digest.empty()) {
+    *digest = request_state_->response_digest;
+    return true;
+  } else {
+    return false;
+  }
+}
+
 }  // namespace omaha
@@ -36,7 +36,9 @@
 
 namespace omaha {
 
+class DownloadSegments;
 class WinHttpAdapter;
+class StreamingHash;
 struct DownloadMetrics;
 
 class SimpleRequest : public HttpRequestInterface {
@@ -56,6 +58,8 @@ class SimpleRequest : public HttpRequestInterface {
 
   virtual std::vector<uint8> GetResponse() const;
 
+  virtual void TakeResponse(std::vector<uint8>* response);
+
   virtual int GetHttpStatusCode() const {
     return request_state_.get() ? request_state_->http_status_code : 0;
   }
@@ -90,6 +94,10 @@ class SimpleRequest : public HttpRequestInterface {
     low_priority_ = low_priority;
   }
 
+  virtual void set_num_segments(int num_segments) {
+    num_segments_ = num_segments;
+  }
+
   virtual void set_callback(NetworkRequestCallback* callback) {
     callback_ = callback;
   }
@@ -110,7 +118,12 @@ class SimpleRequest : public HttpRequestInterface {
 
   virtual bool download_metrics(DownloadMetrics* download_metrics) const;
 
+  virtual bool response_digest(std::vector<uint8>* digest) const;
+
  private:
+  // Downloads segments of the file over a connection of its own.
+  class SegmentWorker;
+
   HRESULT DoSend();
   HRESULT OpenDestinationFile(HANDLE* file_handle);
   HRESULT PrepareRequest(HANDLE* file_handle);
@@ -118,6 +131,21 @@ class SimpleRequest : public HttpRequestInterface {
   HRESULT SendRequest();
   HRESULT ReceiveData(HANDLE file_handle);
   HRESULT RequestData(HANDLE file_handle);
+
+  // Returns true if the response can be downloaded over several connections.
+  bool IsSegmentedDownloadPossible() const;
+
+  // Gets the strong ETag of the response or, if there is none, its
+  // Last-Modified date. Returns false if the response has neither.
+  bool GetRangeValidator(CString* validator) const;
+
+  // Downloads the file over num_segments_ connections, including the
+  // connection of the current response. The file is preallocated and each
+  // connection writes the range of the file it downloads.
+  HRESULT ReceiveDataInSegments(HANDLE file_handle);
+
+  // Receives the range of segment_ into segments_.
+  HRESULT ReceiveSegment();
   bool IsResumeNeeded() const;
   bool IsPauseSupported() const;
 
@@ -158,11 +186,18 @@ class SimpleRequest : public HttpRequestInterface {
     uint32 proxy_authentication_scheme;
     CString proxy;
     CString proxy_bypass;
-    int content_length;
-    int current_bytes;
+    uint64 content_length;
+    uint64 current_bytes;
     uint64 request_begin_ms;
     uint64 request_end_ms;
     std::unique_ptr<DownloadMetrics> download_metrics;
+
+    // Hashes the response as it is written to the file. The hash covers the
+    // first |current_bytes| of the file.
+    std::unique_ptr<StreamingHash> response_hash;
+
+    // The digest of the file, when the file has been completely downloaded.
+    std::vector<uint8> response_digest;
   };
 
   LLock lock_;
@@ -186,6 +221,26 @@ class SimpleRequest : public HttpRequestInterface {
   scoped_event event_resume_;
   bool download_completed_;
 
+  int num_segments_;
+
+  // Set when a segmented download fails, so that the next attempt uses a
+  // single connection.
+  bool is_segmentation_disabled_;
+
+  // The segment downloaded by this request, when the request is used by a
+  // SegmentWorker. segments_ is not owned.
+  DownloadSegments* segments_;
+  int segment_;
+
+  // The validator of the response the segments are downloaded from. It is
+  // sent in the If-Range header of the range requests and checked on each
+  // response, so that segments of different versions of the file are not
+  // mixed.
+  CString range_validator_;
+
+  // The workers of the current segmented download, guarded by lock_.
+  std::vector<std::unique_ptr<SegmentWorker>> segment_workers_;
+
   DISALLOW_COPY_AND_ASSIGN(SimpleRequest);
 };
 
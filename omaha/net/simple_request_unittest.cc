@@ -20,18 +20,29 @@
 
 #include <windows.h>
 #include <winhttp.h>
+#include <winioctl.h>
+#include <winsock2.h>
 #include <atlstr.h>
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
 #include "base/basictypes.h"
 #include "omaha/base/app_util.h"
 #include "omaha/base/const_addresses.h"
 #include "omaha/base/error.h"
+#include "omaha/base/file.h"
+#include "omaha/base/highres_timer-win32.h"
 #include "omaha/base/scope_guard.h"
 #include "omaha/base/string.h"
 #include "omaha/base/utils.h"
 #include "omaha/common/ping_event_download_metrics.h"
 #include "omaha/net/network_config.h"
+#include "omaha/net/network_request.h"
+#include "omaha/net/receive_buffer_pool.h"
 #include "omaha/net/simple_request.h"
 #include "omaha/testing/unit_test.h"
+#include "omaha/third_party/smartany/scoped_any.h"
 
 namespace omaha {
 
@@ -89,6 +100,361 @@ void PrintWpadFailureWarning() {
   std::wcout << _T("\tAborted; WPAD server is non-functional.") << std::endl;
 }
 
+// Creates a sparse file of |size| bytes. The file is all zeros except for a
+// few markers: at the start, across the 4GB boundary when the file is that
+// large, and at the end.
+HRESULT CreateSparseFile(const CString& filename, uint64 size) {
+  scoped_hfile file(::CreateFile(filename, GENERIC_READ | GENERIC_WRITE, 0,
+                                 NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL,
+                                 NULL));
+  if (!file) {
+    return HRESULTFromLastError();
+  }
+
+  DWORD bytes_returned = 0;
+  if (!::DeviceIoControl(get(file), FSCTL_SET_SPARSE, NULL, 0, NULL, 0,
+                         &bytes_returned, NULL)) {
+    return HRESULTFromLastError();
+  }
+
+  const char kMarker[] = "omaha";
+  const uint64 kMarkerSize = sizeof(kMarker);
+  const uint64 kFourGB = 4ULL * 1024 * 1024 * 1024;
+  std::vector<uint64> marker_offsets;
+  marker_offsets.push_back(0);
+  if (size > kFourGB + kMarkerSize) {
+    marker_offsets.push_back(kFourGB - kMarkerSize / 2);
+  }
+  marker_offsets.push_back(size - kMarkerSize);
+
+  for (size_t i = 0; i != marker_offsets.size(); ++i) {
+    LARGE_INTEGER offset = {};
+    offset.QuadPart = static_cast<LONGLONG>(marker_offsets[i]);
+    DWORD bytes_written = 0;
+    if (!::SetFilePointerEx(get(file), offset, NULL, FILE_BEGIN) ||
+        !::WriteFile(get(file), kMarker, sizeof(kMarker), &bytes_written,
+                     NULL)) {
+      return HRESULTFromLastError();
+    }
+  }
+
+  LARGE_INTEGER end = {};
+  end.QuadPart = static_cast<LONGLONG>(size);
+  if (!::SetFilePointerEx(get(file), end, NULL, FILE_BEGIN) ||
+      !::SetEndOfFile(get(file))) {
+    return HRESULTFromLastError();
+  }
+  return S_OK;
+}
+
+// Creates a file of |size| bytes where each byte depends on its offset, so
+// that bytes written at the wrong offset are detected.
+HRESULT CreatePatternFile(const CString& filename, uint64 size) {
+  scoped_hfile file(::CreateFile(filename, GENERIC_WRITE, 0, NULL,
+                                 CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL));
+  if (!file) {
+    return HRESULTFromLastError();
+  }
+
+  std::vector<uint8> chunk(64 * 1024);
+  for (uint64 offset = 0; offset < size; offset += chunk.size()) {
+    const size_t chunk_size = static_cast<size_t>(
+        std::min(static_cast<uint64>(chunk.size()), size - offset));
+    for (size_t i = 0; i != chunk_size; ++i) {
+      const uint64 position = offset + i;
+      chunk[i] = static_cast<uint8>(position ^ (position >> 8) ^
+                                    (position >> 16));
+    }
+    DWORD bytes_written = 0;
+    if (!::WriteFile(get(file), &chunk.front(),
+                     static_cast<DWORD>(chunk_size), &bytes_written, NULL)) {
+      return HRESULTFromLastError();
+    }
+  }
+  return S_OK;
+}
+
+// A minimal HTTP server listening on the loopback interface, which answers
+// every GET request with the content of a file. It honors "Range: bytes=N-"
+// and "Range: bytes=N-M" headers, so that downloads can be resumed or split
+// in segments, and the "If-Range" header. Each connection is served on a
+// thread of its own. A delay between the chunks of the response stands in for
+// the latency and the bandwidth of a connection to a remote server.
+class LocalHttpServer {
+ public:
+  explicit LocalHttpServer(const CString& filename)
+      : filename_(filename),
+        accept_ranges_(true),
+        is_etag_changing_(false),
+        chunk_delay_ms_(0),
+        num_requests_(0),
+        listen_socket_(INVALID_SOCKET),
+        port_(0) {
+    WSADATA wsa_data = {};
+    is_winsock_initialized_ = ::WSAStartup(MAKEWORD(2, 2), &wsa_data) == 0;
+  }
+
+  ~LocalHttpServer() {
+    if (listen_socket_ != INVALID_SOCKET) {
+      // Closing the socket makes accept fail, which ends the thread once the
+      // connections in progress have been served.
+      ::closesocket(listen_socket_);
+    }
+    if (thread_) {
+      ::WaitForSingleObject(get(thread_), INFINITE);
+    }
+    if (is_winsock_initialized_) {
+      ::WSACleanup();
+    }
+  }
+
+  // When false, the server ignores range requests and does not send the
+  // "Accept-Ranges" header. Must be called before Start.
+  void set_accept_ranges(bool accept_ranges) {
+    accept_ranges_ = accept_ranges;
+  }
+
+  // When true, each response has a different ETag, as if the file changed
+  // between the requests. Must be called before Start.
+  void set_is_etag_changing(bool is_etag_changing) {
+    is_etag_changing_ = is_etag_changing;
+  }
+
+  // Sets the delay before each chunk of 64KB of a response. Must be called
+  // before Start.
+  void set_chunk_delay_ms(DWORD chunk_delay_ms) {
+    chunk_delay_ms_ = chunk_delay_ms;
+  }
+
+  HRESULT Start() {
+    if (!is_winsock_initialized_) {
+      return E_FAIL;
+    }
+
+    listen_socket_ = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listen_socket_ == INVALID_SOCKET) {
+      return HRESULT_FROM_WIN32(::WSAGetLastError());
+    }
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = ::htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    int address_size = sizeof(address);
+    if (::bind(listen_socket_, reinterpret_cast<sockaddr*>(&address),
+               sizeof(address)) ||
+        ::getsockname(listen_socket_, reinterpret_cast<sockaddr*>(&address),
+                      &address_size) ||
+        ::listen(listen_socket_, SOMAXCONN)) {
+      return HRESULT_FROM_WIN32(::WSAGetLastError());
+    }
+    port_ = ::ntohs(address.sin_port);
+
+    reset(thread_, ::CreateThread(NULL, 0, ThreadProc, this, 0, NULL));
+    return thread_ ? S_OK : HRESULTFromLastError();
+  }
+
+  CString url() const {
+    CString url;
+    url.Format(_T("http://127.0.0.1:%d/file.bin"), port_);
+    return url;
+  }
+
+  // Returns the number of requests received so far.
+  int num_requests() const { return num_requests_; }
+
+ private:
+  struct Connection {
+    LocalHttpServer* server;
+    SOCKET socket;
+  };
+
+  static DWORD WINAPI ThreadProc(void* parameter) {
+    LocalHttpServer* server = static_cast<LocalHttpServer*>(parameter);
+    std::vector<HANDLE> connection_threads;
+    for (;;) {
+      SOCKET socket = ::accept(server->listen_socket_, NULL, NULL);
+      if (socket == INVALID_SOCKET) {
+        break;
+      }
+
+      Connection* connection = new Connection;
+      connection->server = server;
+      connection->socket = socket;
+      HANDLE connection_thread = ::CreateThread(NULL, 0, ConnectionThreadProc,
+                                                connection, 0, NULL);
+      if (connection_thread) {
+        connection_threads.push_back(connection_thread);
+      } else {
+        ConnectionThreadProc(connection);
+      }
+    }
+
+    for (size_t i = 0; i != connection_threads.size(); ++i) {
+      ::WaitForSingleObject(connection_threads[i], INFINITE);
+      ::CloseHandle(connection_threads[i]);
+    }
+    return 0;
+  }
+
+  static DWORD WINAPI ConnectionThreadProc(void* parameter) {
+    Connection* connection = static_cast<Connection*>(parameter);
+    connection->server->Serve(connection->socket);
+    ::closesocket(connection->socket);
+    delete connection;
+    return 0;
+  }
+
+  void Serve(SOCKET connection) {
+    std::string request;
+    char buffer[4096] = {};
+    while (request.find("\r\n\r\n") == std::string::npos) {
+      const int received = ::recv(connection, buffer, sizeof(buffer), 0);
+      if (received <= 0 || request.size() > 64 * 1024) {
+        return;
+      }
+      request.append(buffer, received);
+    }
+    const LONG request_number = ::InterlockedIncrement(&num_requests_);
+    CStringA etag("\"1\"");
+    if (is_etag_changing_) {
+      etag.Format("\"%d\"", request_number);
+    }
+
+    scoped_hfile file(::CreateFile(filename_, GENERIC_READ, FILE_SHARE_READ,
+                                   NULL, OPEN_EXISTING,
+                                   FILE_FLAG_SEQUENTIAL_SCAN, NULL));
+    LARGE_INTEGER file_size = {};
+    if (!file || !::GetFileSizeEx(get(file), &file_size)) {
+      SendAll(connection,
+              "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n"
+              "Connection: close\r\n\r\n");
+      return;
+    }
+    const uint64 size = static_cast<uint64>(file_size.QuadPart);
+
+    bool is_range = false;
+    uint64 start = 0;
+    uint64 end = size;
+    const char kRangeHeader[] = "\r\nRange: bytes=";
+    const size_t range_pos = request.find(kRangeHeader);
+    const char kIfRangeHeader[] = "\r\nIf-Range: ";
+    const size_t if_range_pos = request.find(kIfRangeHeader);
+    const bool is_range_valid = if_range_pos == std::string::npos ||
+        request.compare(if_range_pos + strlen(kIfRangeHeader),
+                        etag.GetLength(), etag) == 0;
+    if (accept_ranges_ && range_pos != std::string::npos && is_range_valid) {
+      char* range_end = NULL;
+      is_range = true;
+      start = _strtoui64(request.c_str() + range_pos + strlen(kRangeHeader),
+                         &range_end, 10);
+      if (*range_end == '-' && isdigit(range_end[1])) {
+        end = std::min(size, _strtoui64(range_end + 1, NULL, 10) + 1);
+      }
+    }
+
+    CStringA header;
+    if (is_range) {
+      header.Format("HTTP/1.1 206 Partial Content\r\n"
+                    "Content-Range: bytes %I64u-%I64u/%I64u\r\n",
+                    start, end - 1, size);
+    } else {
+      header = "HTTP/1.1 200 OK\r\n";
+    }
+    if (accept_ranges_) {
+      header += "Accept-Ranges: bytes\r\n";
+    }
+    header.AppendFormat("ETag: %s\r\n"
+                        "Content-Type: application/octet-stream\r\n"
+                        "Content-Length: %I64u\r\n"
+                        "Connection: close\r\n\r\n",
+                        etag.GetString(), end - start);
+    if (!SendAll(connection, std::string(header, header.GetLength()))) {
+      return;
+    }
+
+    LARGE_INTEGER offset = {};
+    offset.QuadPart = static_cast<LONGLONG>(start);
+    if (!::SetFilePointerEx(get(file), offset, NULL, FILE_BEGIN)) {
+      return;
+    }
+
+    std::string chunk(64 * 1024, '\0');
+    for (uint64 position = start; position < end;) {
+      const DWORD chunk_size = static_cast<DWORD>(
+          std::min(static_cast<uint64>(chunk.size()), end - position));
+      DWORD bytes_read = 0;
+      if (!::ReadFile(get(file), &chunk[0], chunk_size, &bytes_read, NULL) ||
+          !bytes_read) {
+        return;
+      }
+      if (chunk_delay_ms_) {
+        ::Sleep(chunk_delay_ms_);
+      }
+      if (!SendAll(connection, chunk.substr(0, bytes_read))) {
+        return;
+      }
+      position += bytes_read;
+    }
+  }
+
+  static bool SendAll(SOCKET connection, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+      const int result = ::send(connection, data.data() + sent,
+                                static_cast<int>(data.size() - sent), 0);
+      if (result <= 0) {
+        return false;
+      }
+      sent += result;
+    }
+    return true;
+  }
+
+  const CString filename_;
+  bool accept_ranges_;
+  bool is_etag_changing_;
+  DWORD chunk_delay_ms_;
+  volatile LONG num_requests_;
+  bool is_winsock_initialized_;
+  SOCKET listen_socket_;
+  int port_;
+  scoped_handle thread_;
+
+  DISALLOW_COPY_AND_ASSIGN(LocalHttpServer);
+};
+
+// Records the progress reported by a request.
+class ProgressRecorder : public NetworkRequestCallback {
+ public:
+  ProgressRecorder() : num_calls_(0), bytes_(0), bytes_total_(0) {}
+
+  virtual void OnRequestBegin() {}
+
+  virtual void OnProgress(uint64 bytes, uint64 bytes_total, int,
+                          const TCHAR*) {
+    // The progress never goes backwards within a request.
+    EXPECT_LE(bytes_, bytes);
+    EXPECT_LE(bytes, bytes_total);
+    ++num_calls_;
+    bytes_ = bytes;
+    bytes_total_ = bytes_total;
+  }
+
+  virtual void OnRequestRetryScheduled(time64) {}
+
+  int num_calls() const { return num_calls_; }
+  uint64 bytes() const { return bytes_; }
+  uint64 bytes_total() const { return bytes_total_; }
+
+ private:
+  int num_calls_;
+  uint64 bytes_;
+  uint64 bytes_total_;
+
+  DISALLOW_COPY_AND_ASSIGN(ProgressRecorder);
+};
+
 class SimpleRequestTest : public testing::Test {
  protected:
   SimpleRequestTest() {}
@@ -109,6 +475,17 @@ class SimpleRequestTest : public testing::Test {
 
   void SimpleGetRedirect(const CString& url, const ProxyConfig& config);
 
+  // Downloads a sparse file of |size| bytes from a LocalHttpServer.
+  void LocalDownloadSparseFile(uint64 size);
+
+  // Downloads |source_file| of |size| bytes from |server| over up to
+  // |num_segments| connections, then checks the file, the progress, and the
+  // download metrics. Returns the time the download took.
+  uint64 LocalDownloadFile(const LocalHttpServer& server,
+                           const CString& source_file,
+                           uint64 size,
+                           int num_segments);
+
   void PrepareRequest(const CString& url,
                       const ProxyConfig& config,
                       SimpleRequest* simple_request);
@@ -325,6 +702,60 @@ void SimpleRequestTest::SimpleGetRedirect(const CString& url,
               http_status == HTTP_STATUS_PARTIAL_CONTENT);
 }
 
+void SimpleRequestTest::LocalDownloadSparseFile(uint64 size) {
+  const CString source_file = GetTempFilenameAt(app_util::GetTempDir(),
+                                                _T("SRS"));
+  ASSERT_FALSE(source_file.IsEmpty());
+  ScopeGuard source_guard = MakeGuard(::DeleteFile, source_file);
+  ASSERT_HRESULT_SUCCEEDED(CreateSparseFile(source_file, size));
+
+  LocalHttpServer server(source_file);
+  ASSERT_HRESULT_SUCCEEDED(server.Start());
+  LocalDownloadFile(server, source_file, size, 1);
+  EXPECT_EQ(1, server.num_requests());
+}
+
+uint64 SimpleRequestTest::LocalDownloadFile(const LocalHttpServer& server,
+                                            const CString& source_file,
+                                            uint64 size,
+                                            int num_segments) {
+  const CString temp_file = GetTempFilenameAt(app_util::GetTempDir(),
+                                              _T("SRT"));
+  EXPECT_FALSE(temp_file.IsEmpty());
+  ScopeGuard temp_guard = MakeGuard(::DeleteFile, temp_file);
+
+  ProgressRecorder progress;
+  SimpleRequest simple_request;
+  PrepareRequest(server.url(), ProxyConfig(), &simple_request);
+  simple_request.set_filename(temp_file);
+  simple_request.set_callback(&progress);
+  simple_request.set_num_segments(num_segments);
+
+  HighresTimer timer;
+  EXPECT_HRESULT_SUCCEEDED(simple_request.Send());
+  const uint64 elapsed_ms = timer.GetElapsedMs();
+  EXPECT_EQ(HTTP_STATUS_OK, simple_request.GetHttpStatusCode());
+
+  EXPECT_LT(0, progress.num_calls());
+  EXPECT_EQ(size, progress.bytes());
+  EXPECT_EQ(size, progress.bytes_total());
+
+  DownloadMetrics dm;
+  EXPECT_TRUE(simple_request.download_metrics(&dm));
+  EXPECT_EQ(static_cast<int64>(size), dm.downloaded_bytes);
+  EXPECT_EQ(static_cast<int64>(size), dm.total_bytes);
+
+  uint64 downloaded_size = 0;
+  EXPECT_HRESULT_SUCCEEDED(File::GetFileSizeUnopen(temp_file,
+                                                   &downloaded_size));
+  EXPECT_EQ(size, downloaded_size);
+  EXPECT_TRUE(File::AreFilesIdentical(source_file, temp_file));
+
+  std::vector<uint8> digest;
+  EXPECT_TRUE(simple_request.response_digest(&digest));
+  return elapsed_ms;
+}
+
 //
 // http tests.
 //
@@ -536,5 +967,182 @@ TEST_F(SimpleRequestTest, HttpGet_Redirect) {
   SimpleGetRedirect(_T("http://www.chrome.com/"), ProxyConfig());
 }
 
+TEST_F(SimpleRequestTest, LocalDownload) {
+  if (IsTestRunByLocalSystem()) {
+    return;
+  }
+
+  LocalDownloadSparseFile(3 * 1024 * 1024 + 17);
+}
+
+// The sizes and the progress of files larger than 4GB do not fit in 32 bits.
+// The test writes 5GB to the temp directory, so it does not run by default.
+TEST_F(SimpleRequestTest, DISABLED_LocalDownloadLargerThan4GB) {
+  if (IsTestRunByLocalSystem()) {
+    return;
+  }
+
+  LocalDownloadSparseFile(5ULL * 1024 * 1024 * 1024);
+}
+
+// The file is downloaded over several connections, and the connections which
+// are done take over the segments of the others.
+TEST_F(SimpleRequestTest, LocalSegmentedDownload) {
+  if (IsTestRunByLocalSystem()) {
+    return;
+  }
+
+  const CString source_file = GetTempFilenameAt(app_util::GetTempDir(),
+                                                _T("SRS"));
+  ASSERT_FALSE(source_file.IsEmpty());
+  ScopeGuard source_guard = MakeGuard(::DeleteFile, source_file);
+  const uint64 kSize = 9 * 1024 * 1024 + 5;
+  ASSERT_HRESULT_SUCCEEDED(CreatePatternFile(source_file, kSize));
+
+  LocalHttpServer server(source_file);
+  server.set_chunk_delay_ms(1);
+  ASSERT_HRESULT_SUCCEEDED(server.Start());
+  LocalDownloadFile(server, source_file, kSize, 4);
+  EXPECT_LE(4, server.num_requests());
+}
+
+// A server which does not accept range requests serves the file over a single
+// connection.
+TEST_F(SimpleRequestTest, LocalSegmentedDownload_NoAcceptRanges) {
+  if (IsTestRunByLocalSystem()) {
+    return;
+  }
+
+  const CString source_file = GetTempFilenameAt(app_util::GetTempDir(),
+                                                _T("SRS"));
+  ASSERT_FALSE(source_file.IsEmpty());
+  ScopeGuard source_guard = MakeGuard(::DeleteFile, source_file);
+  const uint64 kSize = 9 * 1024 * 1024 + 5;
+  ASSERT_HRESULT_SUCCEEDED(CreatePatternFile(source_file, kSize));
+
+  LocalHttpServer server(source_file);
+  server.set_accept_ranges(false);
+  ASSERT_HRESULT_SUCCEEDED(server.Start());
+  LocalDownloadFile(server, source_file, kSize, 4);
+  EXPECT_EQ(1, server.num_requests());
+}
+
+// The segments of a file which changes between the requests are not mixed:
+// the segmented download fails, and the next attempt downloads the file over
+// a single connection.
+TEST_F(SimpleRequestTest, LocalSegmentedDownload_FileChanged) {
+  if (IsTestRunByLocalSystem()) {
+    return;
+  }
+
+  const CString source_file = GetTempFilenameAt(app_util::GetTempDir(),
+                                                _T("SRS"));
+  ASSERT_FALSE(source_file.IsEmpty());
+  ScopeGuard source_guard = MakeGuard(::DeleteFile, source_file);
+  const uint64 kSize = 9 * 1024 * 1024 + 5;
+  ASSERT_HRESULT_SUCCEEDED(CreatePatternFile(source_file, kSize));
+
+  LocalHttpServer server(source_file);
+  server.set_is_etag_changing(true);
+  ASSERT_HRESULT_SUCCEEDED(server.Start());
+
+  const CString temp_file = GetTempFilenameAt(app_util::GetTempDir(),
+                                              _T("SRT"));
+  ASSERT_FALSE(temp_file.IsEmpty());
+  ScopeGuard temp_guard = MakeGuard(::DeleteFile, temp_file);
+
+  SimpleRequest simple_request;
+  PrepareRequest(server.url(), ProxyConfig(), &simple_request);
+  simple_request.set_filename(temp_file);
+  simple_request.set_num_segments(4);
+
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_WINHTTP_CONNECTION_ERROR),
+            simple_request.Send());
+  EXPECT_LE(2, server.num_requests());
+
+  const int num_requests = server.num_requests();
+  EXPECT_HRESULT_SUCCEEDED(simple_request.Send());
+  EXPECT_EQ(num_requests + 1, server.num_requests());
+  EXPECT_TRUE(File::AreFilesIdentical(source_file, temp_file));
+}
+
+// Reports how much faster a file downloads over several connections when each
+// connection is slow. The delay of 10ms per 64KB limits each connection to
+// about 6MB/s.
+TEST_F(SimpleRequestTest, DISABLED_LocalSegmentedDownloadSpeedUp) {
+  if (IsTestRunByLocalSystem()) {
+    return;
+  }
+
+  const CString source_file = GetTempFilenameAt(app_util::GetTempDir(),
+                                                _T("SRS"));
+  ASSERT_FALSE(source_file.IsEmpty());
+  ScopeGuard source_guard = MakeGuard(::DeleteFile, source_file);
+  const uint64 kSize = 32 * 1024 * 1024;
+  ASSERT_HRESULT_SUCCEEDED(CreatePatternFile(source_file, kSize));
+
+  LocalHttpServer server(source_file);
+  server.set_chunk_delay_ms(10);
+  ASSERT_HRESULT_SUCCEEDED(server.Start());
+
+  const int kNumSegments[] = { 1, 2, 4, 8 };
+  uint64 single_ms = 0;
+  for (size_t i = 0; i != arraysize(kNumSegments); ++i) {
+    const uint64 elapsed_ms = std::max<uint64>(1,
+        LocalDownloadFile(server, source_file, kSize, kNumSegments[i]));
+    if (kNumSegments[i] == 1) {
+      single_ms = elapsed_ms;
+    }
+    std::cout << kNumSegments[i] << " segments: " << elapsed_ms << " ms, "
+              << "speed-up " << static_cast<double>(single_ms) / elapsed_ms
+              << std::endl;
+  }
+}
+
+// Responses received in memory are read through the shared receive buffers,
+// and the body is allocated once from the Content-Length header. Taking the
+// response out of the request does not copy it.
+TEST_F(SimpleRequestTest, LocalGet_AllocatesOnce) {
+  if (IsTestRunByLocalSystem()) {
+    return;
+  }
+
+  const CString source_file = GetTempFilenameAt(app_util::GetTempDir(),
+                                                _T("SRS"));
+  ASSERT_FALSE(source_file.IsEmpty());
+  ScopeGuard source_guard = MakeGuard(::DeleteFile, source_file);
+  const uint64 kSize = 1024 * 1024 + 3;
+  ASSERT_HRESULT_SUCCEEDED(CreatePatternFile(source_file, kSize));
+  std::vector<byte> expected_response;
+  ASSERT_HRESULT_SUCCEEDED(ReadEntireFile(source_file, 0, &expected_response));
+
+  LocalHttpServer server(source_file);
+  ASSERT_HRESULT_SUCCEEDED(server.Start());
+
+  ReceiveBufferPool& pool = ReceiveBufferPool::Instance();
+  int num_allocations = 0;
+  for (int i = 0; i != 3; ++i) {
+    SimpleRequest simple_request;
+    PrepareRequest(server.url(), ProxyConfig(), &simple_request);
+    ASSERT_HRESULT_SUCCEEDED(simple_request.Send());
+    EXPECT_EQ(HTTP_STATUS_OK, simple_request.GetHttpStatusCode());
+
+    std::vector<uint8> response;
+    simple_request.TakeResponse(&response);
+    EXPECT_EQ(kSize, response.size());
+    EXPECT_EQ(response.size(), response.capacity());
+    EXPECT_TRUE(expected_response == response);
+    EXPECT_TRUE(simple_request.GetResponse().empty());
+
+    // Only the first request may allocate a receive buffer.
+    if (i == 0) {
+      num_allocations = pool.num_allocations();
+      EXPECT_LE(1, num_allocations);
+    } else {
+      EXPECT_EQ(num_allocations, pool.num_allocations());
+    }
+  }
+}
+
 }  // namespace omaha
 
@@ -62,6 +62,7 @@ void MetricsAggregatorWin32::EndAggregation() {
   timing_key_.Close();
   integer_key_.Close();
   bool_key_.Close();
+  histogram_key_.Close();
 
   key_.Close();
 }
@@ -148,4 +149,28 @@ void MetricsAggregatorWin32::Aggregate(BoolMetric &metric) {  // NOLINT
                                       &value, sizeof(value));
 }
 
+void MetricsAggregatorWin32::Aggregate(HistogramMetric &metric) {  // NOLINT
+  // do as little as possible if no value
+  HistogramMetric::HistogramData value = metric.Reset();
+  if (0 == HistogramMetric::Count(value))
+    return;
+
+  if (!EnsureKey(kHistogramsKeyName, &histogram_key_))
+    return;
+
+  CString name(metric.name());
+  HistogramMetric::HistogramData reg_value;
+  if (!GetData(histogram_key_, name, &reg_value)) {
+    memcpy(&reg_value, &value, sizeof(value));
+  } else {
+    for (int i = 0; i < HistogramMetric::kNumBuckets; ++i)
+      reg_value.buckets[i] += value.buckets[i];
+    reg_value.sum += value.sum;
+  }
+
+  LONG err = histogram_key_.SetBinaryValue(name,
+                                           &reg_value,
+                                           sizeof(reg_value));
+}
+
 }  // namespace stats_report
@@ -48,6 +48,7 @@ protected:
   virtual void Aggregate(TimingMetric &metric);
   virtual void Aggregate(IntegerMetric &metric);
   virtual void Aggregate(BoolMetric &metric);
+  virtual void Aggregate(HistogramMetric &metric);
 private:
   enum {
     /// Max length of time we wait for the mutex on StartAggregation.
@@ -73,6 +74,7 @@ private:
   CRegKey timing_key_;
   CRegKey integer_key_;
   CRegKey bool_key_;
+  CRegKey histogram_key_;
   /// @}
 
   /// Specifies HKLM or HKCU, respectively.
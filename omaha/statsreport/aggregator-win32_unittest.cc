@@ -36,6 +36,8 @@ const wchar_t MetricsAggregatorWin32Test::kIntegersKeyName[] =
                                                       KEY_STRING L"\\Integers";
 const wchar_t MetricsAggregatorWin32Test::kBoolsKeyName[] =
                                                       KEY_STRING L"\\Booleans";
+const wchar_t MetricsAggregatorWin32Test::kHistogramsKeyName[] =
+                                                    KEY_STRING L"\\Histograms";
 
 
 #define EXPECT_REGVAL_EQ(value, key_name, value_name) do { \
@@ -71,6 +73,15 @@ TEST_F(MetricsAggregatorWin32Test, AggregateWin32) {
     int32 bool_true = 1, bool_false = 0;
     EXPECT_REGVAL_EQ(bool_true, kBoolsKeyName, L"b1");
     EXPECT_REGVAL_EQ(bool_false, kBoolsKeyName, L"b2");
+
+    HistogramMetric::HistogramData histogram1 = {};
+    histogram1.buckets[HistogramMetric::BucketIndex(5)] = 1;
+    histogram1.buckets[HistogramMetric::BucketIndex(1000)] = 1;
+    histogram1.sum = 1005;
+    HistogramMetric::HistogramData histogram2 = {};
+    histogram2.buckets[0] = 1;
+    EXPECT_REGVAL_EQ(histogram1, kHistogramsKeyName, L"h1");
+    EXPECT_REGVAL_EQ(histogram2, kHistogramsKeyName, L"h2");
   }
 
   AddStats();
@@ -93,5 +104,14 @@ TEST_F(MetricsAggregatorWin32Test, AggregateWin32) {
     int32 bool_true = 1, bool_false = 0;
     EXPECT_REGVAL_EQ(bool_true, kBoolsKeyName, L"b1");
     EXPECT_REGVAL_EQ(bool_false, kBoolsKeyName, L"b2");
+
+    HistogramMetric::HistogramData histogram1 = {};
+    histogram1.buckets[HistogramMetric::BucketIndex(5)] = 2;
+    histogram1.buckets[HistogramMetric::BucketIndex(1000)] = 2;
+    histogram1.sum = 2010;
+    HistogramMetric::HistogramData histogram2 = {};
+    histogram2.buckets[0] = 2;
+    EXPECT_REGVAL_EQ(histogram1, kHistogramsKeyName, L"h1");
+    EXPECT_REGVAL_EQ(histogram2, kHistogramsKeyName, L"h2");
   }
 }
@@ -48,6 +48,11 @@ public:
 
     b1_ = true;
     b2_ = false;
+
+    h1_.AddSample(5);
+    h1_.AddSample(1000);
+
+    h2_.AddSample(0);
   }
 
   static const wchar_t kAppName[];
@@ -56,6 +61,7 @@ public:
   static const wchar_t kTimingsKeyName[];
   static const wchar_t kIntegersKeyName[];
   static const wchar_t kBoolsKeyName[];
+  static const wchar_t kHistogramsKeyName[];
 };
 
 #endif  // OMAHA_STATSREPORT_AGGREGATOR_WIN32_UNITTEST_H__
@@ -41,6 +41,9 @@ bool MetricsAggregator::AggregateMetrics() {
      case kBoolType:
       Aggregate(metric->AsBool());
       break;
+     case kHistogramType:
+      Aggregate(metric->AsHistogram());
+      break;
      default:
       DCHECK(false && "Impossible metric type");
       break;
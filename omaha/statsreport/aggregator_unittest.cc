@@ -23,7 +23,8 @@ using namespace stats_report;
 class TestMetricsAggregator: public MetricsAggregator {
 public:
   TestMetricsAggregator(MetricCollection &coll) : MetricsAggregator(coll)
-      , aggregating_(false), counts_(0), timings_(0), integers_(0), bools_(0) {
+      , aggregating_(false), counts_(0), timings_(0), integers_(0), bools_(0),
+        histograms_(0) {
   }
 
   ~TestMetricsAggregator() {
@@ -34,6 +35,7 @@ public:
   int timings() const { return timings_; }
   int integers() const { return integers_; }
   int bools() const { return bools_; }
+  int histograms() const { return histograms_; }
 
 protected:
   virtual bool StartAggregation() {
@@ -42,6 +44,7 @@ protected:
     timings_ = 0;
     integers_ = 0;
     bools_ = 0;
+    histograms_ = 0;
 
     return true;
   }
@@ -73,6 +76,11 @@ protected:
     metric.Reset();
     ++bools_;
   }
+  virtual void Aggregate(HistogramMetric &metric) {
+    EXPECT_TRUE(aggregating());
+    metric.Reset();
+    ++histograms_;
+  }
 
 private:
   bool aggregating_;
@@ -80,6 +88,7 @@ private:
   int timings_;
   int integers_;
   int bools_;
+  int histograms_;
 };
 
 TEST_F(MetricsAggregatorTest, Aggregate) {
@@ -90,6 +99,7 @@ TEST_F(MetricsAggregatorTest, Aggregate) {
   EXPECT_EQ(0, agg.timings());
   EXPECT_EQ(0, agg.integers());
   EXPECT_EQ(0, agg.bools());
+  EXPECT_EQ(0, agg.histograms());
   EXPECT_TRUE(agg.AggregateMetrics());
   EXPECT_FALSE(agg.aggregating());
 
@@ -98,6 +108,7 @@ TEST_F(MetricsAggregatorTest, Aggregate) {
   EXPECT_TRUE(kNumTimings == agg.timings());
   EXPECT_TRUE(kNumIntegers == agg.integers());
   EXPECT_TRUE(kNumBools == agg.bools());
+  EXPECT_TRUE(kNumHistograms == agg.histograms());
 }
 
 class FailureTestMetricsAggregator: public TestMetricsAggregator {
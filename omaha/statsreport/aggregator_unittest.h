@@ -33,14 +33,17 @@ public:
     INIT_METRIC(Integer, i1),
     INIT_METRIC(Integer, i2),
     INIT_METRIC(Bool, b1),
-    INIT_METRIC(Bool, b2) {
+    INIT_METRIC(Bool, b2),
+    INIT_METRIC(Histogram, h1),
+    INIT_METRIC(Histogram, h2) {
   }
 
   enum {
     kNumCounts = 2,
     kNumTimings = 2,
     kNumIntegers = 2,
-    kNumBools = 2
+    kNumBools = 2,
+    kNumHistograms = 2
   };
 
   stats_report::MetricCollection coll_;
@@ -52,6 +55,8 @@ public:
   DECL_METRIC(Integer, i2);
   DECL_METRIC(Bool, b1);
   DECL_METRIC(Bool, b2);
+  DECL_METRIC(Histogram, h1);
+  DECL_METRIC(Histogram, h2);
 
 #undef INIT_METRIC
 #undef DECL_METRIC
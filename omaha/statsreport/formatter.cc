@@ -43,6 +43,25 @@ void Formatter::AddBoolean(const char *name, bool value) {
   output_ << "&" << name << ":b=" << (value ? "t" : "f");
 }
 
+// Formats as count;sum;p50;p95;p99 followed by the non-empty buckets as
+// ;minimum:count pairs.
+void Formatter::AddHistogram(const char *name,
+                             const HistogramMetric::HistogramData &value) {
+  output_ << "&" << name << ":h=" << HistogramMetric::Count(value) << ";"
+                                  << value.sum << ";"
+                                  << HistogramMetric::Percentile(value, 50)
+                                  << ";"
+                                  << HistogramMetric::Percentile(value, 95)
+                                  << ";"
+                                  << HistogramMetric::Percentile(value, 99);
+  for (int i = 0; i < HistogramMetric::kNumBuckets; ++i) {
+    if (value.buckets[i]) {
+      output_ << ";" << HistogramMetric::BucketMinimum(i) << ":"
+              << value.buckets[i];
+    }
+  }
+}
+
 void Formatter::AddMetric(MetricBase *metric) {
   switch (metric->type()) {
     case kCountType: {
@@ -73,6 +92,12 @@ void Formatter::AddMetric(MetricBase *metric) {
     }
     break;
 
+    case kHistogramType: {
+      HistogramMetric &histogram = metric->AsHistogram();
+      AddHistogram(histogram.name(), histogram.data());
+    }
+    break;
+
     default:
       DCHECK(false && "Impossible metric type");
   }
@@ -17,6 +17,7 @@
 #include "omaha/statsreport/formatter.h"
 
 using stats_report::Formatter;
+using stats_report::HistogramMetric;
 
 TEST(Formatter, Format) {
   Formatter formatter("test_application", 86400);
@@ -34,4 +35,19 @@ TEST(Formatter, Format) {
                "&boolean1:b=t"
                "&boolean2:b=f",
                formatter.output());
-}
\ No newline at end of file
+}
+
+TEST(Formatter, FormatHistogram) {
+  Formatter formatter("test_application", 86400);
+
+  HistogramMetric::HistogramData data = {};
+  data.buckets[HistogramMetric::BucketIndex(2)] = 18;
+  data.buckets[HistogramMetric::BucketIndex(100)] = 1;
+  data.buckets[HistogramMetric::BucketIndex(5000)] = 1;
+  data.sum = 5136;
+  formatter.AddHistogram("histogram1", data);
+
+  EXPECT_STREQ("test_application&86400"
+               "&histogram1:h=20;5136;2;111;5119;2:18;96:1;4096:1",
+               formatter.output());
+}
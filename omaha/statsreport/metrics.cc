@@ -16,6 +16,7 @@
 // Implements metrics and metrics collections
 #include "omaha/statsreport/metrics.h"
 #include <stdint.h>
+#include <algorithm>
 #include <limits>
 #include "omaha/base/synchronized.h"
 
@@ -30,7 +31,8 @@ MetricCollection &g_global_metrics =
 // C4073: initializers put in library initialization area.
 #pragma warning(disable : 4073)
 
-// Serialize all metric manipulation and access under this lock.
+// Serializes the readers of timing metrics, so that each reader merges the
+// cells of one generation only. Writers do not take this lock.
 //
 // Initializes g_lock before other global objects of user defined types.
 // It assumes the program is single threaded while executing CRT startup and
@@ -87,143 +89,371 @@ MetricBase::~MetricBase() {
   }
 }
 
+namespace {
+
+LONGLONG volatile *AsLongLong(volatile int64 *value) {
+  return reinterpret_cast<LONGLONG volatile *>(value);
+}
+
+// Reads a 64-bit cell atomically, which plain reads are not on x86.
+int64 LoadInt64(const volatile int64 *value) {
+#ifdef _WIN64
+  return *value;
+#else
+  return ::InterlockedCompareExchange64(
+      AsLongLong(const_cast<volatile int64 *>(value)), 0, 0);
+#endif
+}
+
+void StoreInt64(volatile int64 *value, int64 new_value) {
+  ::InterlockedExchange64(AsLongLong(value), new_value);
+}
+
+void AddInt64(volatile int64 *value, int64 addend) {
+  ::InterlockedExchangeAdd64(AsLongLong(value), addend);
+}
+
+void MinInt64(volatile int64 *value, int64 candidate) {
+  int64 current = LoadInt64(value);
+  while (candidate < current) {
+    const int64 previous = ::InterlockedCompareExchange64(AsLongLong(value),
+                                                          candidate,
+                                                          current);
+    if (previous == current)
+      break;
+    current = previous;
+  }
+}
+
+void MaxInt64(volatile int64 *value, int64 candidate) {
+  int64 current = LoadInt64(value);
+  while (candidate > current) {
+    const int64 previous = ::InterlockedCompareExchange64(AsLongLong(value),
+                                                          candidate,
+                                                          current);
+    if (previous == current)
+      break;
+    current = previous;
+  }
+}
+
+LONG volatile *AsLong(volatile int32 *value) {
+  return reinterpret_cast<LONG volatile *>(value);
+}
+
+}  // namespace
+
+int CurrentMetricCell() {
+  return static_cast<int>(::GetCurrentProcessorNumber() % kNumMetricCells);
+}
+
+ShardedInt64::ShardedInt64() {
+  for (int i = 0; i < kNumMetricCells; ++i)
+    cells_[i].value = 0;
+}
+
+void ShardedInt64::Add(int64 addend) {
+  AddInt64(&cells_[CurrentMetricCell()].value, addend);
+}
+
+int64 ShardedInt64::Sum() const {
+  int64 sum = 0;
+  for (int i = 0; i < kNumMetricCells; ++i)
+    sum += LoadInt64(&cells_[i].value);
+  return sum;
+}
+
+int64 ShardedInt64::Exchange(int64 value) {
+  // Each cell is swapped atomically, so an addend lands either before the
+  // swap, in the returned value, or after it, in the new value.
+  int64 previous = ::InterlockedExchange64(AsLongLong(&cells_[0].value),
+                                           value);
+  for (int i = 1; i < kNumMetricCells; ++i)
+    previous += ::InterlockedExchange64(AsLongLong(&cells_[i].value), 0);
+  return previous;
+}
+
 void IntegerMetricBase::Set(int64 value) {
-  ObjectLock lock(this);
-  value_ = value;
+  value_.Exchange(value);
 }
 
 int64 IntegerMetricBase::value() const {
-  ObjectLock lock(this);
-  int64 ret = value_;
-  return ret;
+  return value_.Sum();
 }
 
 void IntegerMetricBase::Increment() {
-  ObjectLock lock(this);
-  ++value_;
+  value_.Add(1);
 }
 
 void IntegerMetricBase::Decrement() {
-  ObjectLock lock(this);
-  --value_;
+  value_.Add(-1);
 }
 
 void IntegerMetricBase::Add(int64 value){
-  ObjectLock lock(this);
-  value_ += value;
+  value_.Add(value);
 }
 
 void IntegerMetricBase::Subtract(int64 value) {
-  ObjectLock lock(this);
-  if (value_ < value)
-    value_ = 0;
-  else
-    value_ -= value;
+  // Clamps at zero. The clamp is approximate when other threads modify the
+  // metric at the same time.
+  const int64 current = value_.Sum();
+  value_.Add(current < value ? -current : -value);
 }
 
 int64 CountMetric::Reset() {
-  ObjectLock lock(this);
-  int64 ret = value_;
-  value_ = 0;
-  return ret;
+  return value_.Exchange(0);
+}
+
+TimingMetric::TimingMetric(const char *name, const TimingData &value)
+    : MetricBase(name, kTimingType) {
+  Clear();
+  if (value.count) {
+    Cell &cell = cells_[0][0];
+    cell.count = static_cast<int32>(value.count);
+    cell.sum = value.sum;
+    cell.minimum = value.minimum;
+    cell.maximum = value.maximum;
+  }
 }
 
 TimingMetric::TimingData TimingMetric::Reset() {
   ObjectLock lock(this);
-  TimingData ret = data_;
-  Clear();
+
+  const int32 generation = generation_;
+  ::InterlockedExchange(AsLong(&generation_), generation ^ 1);
+
+  // The writers which picked the previous generation before the switch are
+  // about to finish. New writers pick the current generation.
+  for (int i = 0; i < kNumMetricCells; ++i) {
+    while (cells_[generation][i].writers != 0)
+      ::SwitchToThread();
+  }
+
+  TimingData ret = Merge(generation);
+
+  for (int i = 0; i < kNumMetricCells; ++i) {
+    Cell &cell = cells_[generation][i];
+    cell.count = 0;
+    StoreInt64(&cell.sum, 0);
+    StoreInt64(&cell.minimum, std::numeric_limits<int64>::max());
+    StoreInt64(&cell.maximum, std::numeric_limits<int64>::min());
+  }
+
   return ret;
 }
 
 uint32 TimingMetric::count() const {
   ObjectLock lock(this);
-  uint32 ret = data_.count;
-  return ret;
+  return Merge(generation_).count;
 }
 
 int64 TimingMetric::sum() const {
   ObjectLock lock(this);
-  int64 ret = data_.sum;
-  return ret;
+  return Merge(generation_).sum;
 }
 
 int64 TimingMetric::minimum() const {
   ObjectLock lock(this);
-  int64 ret = data_.minimum;
-  return ret;
+  return Merge(generation_).minimum;
 }
 
 int64 TimingMetric::maximum() const {
   ObjectLock lock(this);
-  int64 ret = data_.maximum;
-  return ret;
+  return Merge(generation_).maximum;
 }
 
 int64 TimingMetric::average() const {
   ObjectLock lock(this);
+  TimingData data = Merge(generation_);
 
   int64 ret = 0;
-  if (0 == data_.count) {
-    DCHECK_EQ(0, data_.sum);
+  if (0 == data.count) {
+    DCHECK_EQ(0, data.sum);
   } else {
-    ret = data_.sum / data_.count;
+    ret = data.sum / data.count;
   }
   return ret;
 }
 
 void TimingMetric::AddSample(int64 time_ms) {
-  ObjectLock lock(this);
-  if (0 == data_.count) {
-    data_.minimum = time_ms;
-    data_.maximum = time_ms;
-  } else {
-    if (data_.minimum > time_ms)
-      data_.minimum = time_ms;
-    if (data_.maximum < time_ms)
-      data_.maximum = time_ms;
-  }
-  data_.count++;
-  data_.sum += time_ms;
+  AddToCell(1, time_ms, time_ms);
 }
 
 void TimingMetric::AddSamples(int64 count, int64 total_time_ms) {
   if (0 == count)
     return;
 
-  int64 time_ms = total_time_ms / count;
+  DCHECK_LE(count, std::numeric_limits<uint32_t>::max());
+  AddToCell(count, total_time_ms, total_time_ms / count);
+}
 
-  ObjectLock lock(this);
-  if (0 == data_.count) {
-    data_.minimum = time_ms;
-    data_.maximum = time_ms;
-  } else {
-    if (data_.minimum > time_ms)
-      data_.minimum = time_ms;
-    if (data_.maximum < time_ms)
-      data_.maximum = time_ms;
+void TimingMetric::AddToCell(int64 count, int64 total_time_ms, int64 time_ms) {
+  const int index = CurrentMetricCell();
+
+  // Registers as a writer of the current generation. If Reset switched the
+  // generation in the meantime, the cell may already have been merged.
+  Cell *cell = NULL;
+  for (;;) {
+    const int32 generation = generation_;
+    cell = &cells_[generation][index];
+    ::InterlockedIncrement(AsLong(&cell->writers));
+    if (generation == generation_)
+      break;
+    ::InterlockedDecrement(AsLong(&cell->writers));
   }
 
-  DCHECK_LE(count, std::numeric_limits<uint32_t>::max());
-  data_.count += static_cast<uint32>(count);
-  data_.sum += total_time_ms;
+  MinInt64(&cell->minimum, time_ms);
+  MaxInt64(&cell->maximum, time_ms);
+  AddInt64(&cell->sum, total_time_ms);
+  ::InterlockedExchangeAdd(AsLong(&cell->count), static_cast<LONG>(count));
+
+  ::InterlockedDecrement(AsLong(&cell->writers));
+}
+
+TimingMetric::TimingData TimingMetric::Merge(int generation) const {
+  TimingData ret;
+  memset(&ret, 0, sizeof(ret));
+
+  for (int i = 0; i < kNumMetricCells; ++i) {
+    const Cell &cell = cells_[generation][i];
+    const uint32 count = static_cast<uint32>(cell.count);
+    if (0 == count)
+      continue;
+
+    const int64 minimum = LoadInt64(&cell.minimum);
+    const int64 maximum = LoadInt64(&cell.maximum);
+    if (0 == ret.count) {
+      ret.minimum = minimum;
+      ret.maximum = maximum;
+    } else {
+      ret.minimum = std::min(ret.minimum, minimum);
+      ret.maximum = std::max(ret.maximum, maximum);
+    }
+    ret.count += count;
+    ret.sum += LoadInt64(&cell.sum);
+  }
+
+  return ret;
 }
 
 void TimingMetric::Clear() {
-  memset(&data_, 0, sizeof(data_));
+  generation_ = 0;
+  for (int generation = 0; generation < 2; ++generation) {
+    for (int i = 0; i < kNumMetricCells; ++i) {
+      Cell &cell = cells_[generation][i];
+      cell.writers = 0;
+      cell.count = 0;
+      cell.sum = 0;
+      cell.minimum = std::numeric_limits<int64>::max();
+      cell.maximum = std::numeric_limits<int64>::min();
+    }
+  }
 }
 
 void BoolMetric::Set(bool value) {
-  ObjectLock lock(this);
-  value_ = value ? kBoolTrue : kBoolFalse;
+  ::InterlockedExchange(&value_, value ? kBoolTrue : kBoolFalse);
 }
 
 BoolMetric::TristateBoolValue BoolMetric::Reset() {
-  ObjectLock lock(this);
-  TristateBoolValue ret = value_;
-  value_ = kBoolUnset;
+  return static_cast<TristateBoolValue>(
+      ::InterlockedExchange(&value_, kBoolUnset));
+}
+
+HistogramMetric::HistogramMetric(const char *name,
+                                 MetricCollectionBase *coll)
+    : MetricBase(name, kHistogramType, coll) {
+  for (int i = 0; i < kNumBuckets; ++i)
+    buckets_[i] = 0;
+}
+
+HistogramMetric::HistogramMetric(const char *name, const HistogramData &value)
+    : MetricBase(name, kHistogramType) {
+  for (int i = 0; i < kNumBuckets; ++i)
+    buckets_[i] = static_cast<int32>(value.buckets[i]);
+  sum_.Add(value.sum);
+}
+
+void HistogramMetric::AddSample(int64 value) {
+  if (value < 0)
+    value = 0;
+
+  ::InterlockedIncrement(AsLong(&buckets_[BucketIndex(value)]));
+  sum_.Add(value);
+}
+
+HistogramMetric::HistogramData HistogramMetric::data() const {
+  HistogramData ret;
+  for (int i = 0; i < kNumBuckets; ++i)
+    ret.buckets[i] = static_cast<uint32>(buckets_[i]);
+  ret.sum = sum_.Sum();
+  return ret;
+}
+
+HistogramMetric::HistogramData HistogramMetric::Reset() {
+  HistogramData ret;
+  for (int i = 0; i < kNumBuckets; ++i)
+    ret.buckets[i] = static_cast<uint32>(::InterlockedExchange(
+        AsLong(&buckets_[i]), 0));
+  ret.sum = sum_.Exchange(0);
   return ret;
 }
 
+int HistogramMetric::BucketIndex(int64 value) {
+  if (value < kSubBuckets)
+    return value < 0 ? 0 : static_cast<int>(value);
+
+  // |value| is in [2^msb, 2^(msb + 1)), which is split in kSubBuckets
+  // buckets. The two bits below the most significant bit pick the bucket.
+  int msb = 0;
+  for (uint64 v = static_cast<uint64>(value); v > 1; v >>= 1)
+    ++msb;
+
+  const int sub_bucket = static_cast<int>(value >> (msb - 2)) &
+                         (kSubBuckets - 1);
+  const int index = kSubBuckets * (msb - 1) + sub_bucket;
+  return std::min(index, static_cast<int>(kNumBuckets) - 1);
+}
+
+int64 HistogramMetric::BucketMinimum(int index) {
+  DCHECK_LE(0, index);
+  DCHECK_LE(index, kNumBuckets);
+
+  if (index < kSubBuckets)
+    return index;
+
+  const int msb = index / kSubBuckets + 1;
+  const int64 sub_bucket = index % kSubBuckets;
+  return (kSubBuckets + sub_bucket) << (msb - 2);
+}
+
+uint32 HistogramMetric::Count(const HistogramData &data) {
+  uint32 count = 0;
+  for (int i = 0; i < kNumBuckets; ++i)
+    count += data.buckets[i];
+  return count;
+}
+
+int64 HistogramMetric::Percentile(const HistogramData &data, int percent) {
+  DCHECK_LE(0, percent);
+  DCHECK_LE(percent, 100);
+
+  const uint64 count = Count(data);
+  if (0 == count)
+    return 0;
+
+  uint64 seen = 0;
+  for (int i = 0; i < kNumBuckets; ++i) {
+    seen += data.buckets[i];
+    if (seen * 100 >= count * percent && data.buckets[i]) {
+      return i == kNumBuckets - 1 ? BucketMinimum(i)
+                                  : BucketMinimum(i + 1) - 1;
+    }
+  }
+
+  DCHECK(false);
+  return 0;
+}
+
 void MetricCollection::Initialize() {
   DCHECK(!initialized());
   initialized_ = true;
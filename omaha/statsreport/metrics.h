@@ -72,6 +72,19 @@
 #define DEFINE_METRIC_bool(name)    DEFINE_METRIC(BoolMetric, name)
 
 
+/// Use histogram metrics to report the distribution of samples, typically
+/// durations in milliseconds, where the tail matters more than the average.
+/// The samples are counted in log-linear buckets, which allows reporting
+/// percentiles such as p50, p95 and p99.
+#define DECLARE_METRIC_histogram(name) DECLARE_METRIC(HistogramMetric, name)
+#define DEFINE_METRIC_histogram(name) DEFINE_METRIC(HistogramMetric, name)
+
+/// Collects a sample from here to the end of the current scope, and
+/// adds the sample to the histogram metric supplied
+#define HISTOGRAM_TIME_SCOPE(histogram) \
+  stats_report::HistogramSample __xxhistogramsample__(histogram)
+
+
 /// Implementation macros
 #define DECLARE_METRIC(type, name) \
   namespace omaha_client_statsreport { \
@@ -95,7 +108,8 @@ enum MetricType {
   kCountType,
   kTimingType,
   kIntegerType,
-  kBoolType
+  kBoolType,
+  kHistogramType
 };
 
 // fwd.
@@ -107,6 +121,7 @@ class CountMetric;
 class TimingMetric;
 class IntegerMetric;
 class BoolMetric;
+class HistogramMetric;
 
 /// Base class for all stats instances.
 /// Stats instances are chained together against a MetricCollection to
@@ -122,11 +137,13 @@ public:
   TimingMetric &AsTiming();
   IntegerMetric &AsInteger();
   BoolMetric &AsBool();
+  HistogramMetric &AsHistogram();
 
   const CountMetric &AsCount() const;
   const TimingMetric &AsTiming() const;
   const IntegerMetric &AsInteger() const;
   const BoolMetric &AsBool() const;
+  const HistogramMetric &AsHistogram() const;
   /// @}
 
   /// @name Accessors
@@ -267,6 +284,49 @@ inline bool operator != (const MetricIterator &a, const MetricIterator &b) {
   return !operator == (a, b);
 }
 
+/// The values of count, integer and timing metrics are spread over this many
+/// cells. Writers update the cell of the processor they run on with
+/// interlocked operations, so writers on different processors rarely touch
+/// the same cache line and never wait for each other. Readers merge the cells.
+const int kNumMetricCells = 8;
+
+/// Size and alignment of the cells, so that each cell sits on its own cache
+/// line. Metrics allocated on the heap, such as the ones read back from the
+/// registry, are not written to concurrently and may not be aligned.
+const int kMetricCellSize = 64;
+
+/// Returns the index of the cell the calling thread writes to.
+int CurrentMetricCell();
+
+/// A 64-bit integer spread over kNumMetricCells cells.
+class ShardedInt64 {
+public:
+  ShardedInt64();
+
+  /// Adds to the cell of the calling processor.
+  void Add(int64 addend);
+
+  /// Returns the sum of the cells.
+  int64 Sum() const;
+
+  /// Replaces the value and returns the previous one. Each concurrent Add
+  /// is either included in the returned value or applied to the new value,
+  /// so no addend is lost or counted twice.
+  int64 Exchange(int64 value);
+
+private:
+  struct alignas(kMetricCellSize) Cell {
+    volatile int64 value;
+    char padding[kMetricCellSize - sizeof(int64)];
+  };
+
+  COMPILE_ASSERT(sizeof(Cell) == kMetricCellSize, invalid_metric_cell_size);
+
+  Cell cells_[kNumMetricCells];
+
+  DISALLOW_COPY_AND_ASSIGN(ShardedInt64);
+};
+
 /// Globally defined counters are registered here
 extern MetricCollectionBase g_global_metric_storage;
 
@@ -290,10 +350,11 @@ protected:
   IntegerMetricBase(const char *name,
                     MetricType type,
                     MetricCollectionBase *coll)
-      : MetricBase(name, type, coll), value_(0) {
+      : MetricBase(name, type, coll) {
   }
   IntegerMetricBase(const char *name, MetricType type, int64 value)
-      : MetricBase(name, type), value_(value) {
+      : MetricBase(name, type) {
+    value_.Add(value);
   }
 
   void Increment();
@@ -301,7 +362,7 @@ protected:
   void Add(int64 value);
   void Subtract(int64 value);
 
-  int64 value_;
+  ShardedInt64 value_;
 
 private:
   DISALLOW_COPY_AND_ASSIGN(IntegerMetricBase);
@@ -341,9 +402,7 @@ public:
     Clear();
   }
 
-  TimingMetric(const char *name, const TimingData &value)
-      : MetricBase(name, kTimingType), data_(value) {
-  }
+  TimingMetric(const char *name, const TimingData &value);
 
   uint32 count() const;
   int64 sum() const;
@@ -366,15 +425,40 @@ public:
   /// @param total_time_ms the total time consumed by all the "count" samples
   void AddSamples(int64 count, int64 total_time_ms);
 
-  /// Nulls the metric and returns the current values.
+  /// Nulls the metric and returns the current values. The samples added
+  /// while the metric is being reset are either all included in the returned
+  /// values or all kept in the metric.
   TimingData Reset();
 
 private:
   DISALLOW_COPY_AND_ASSIGN(TimingMetric);
 
+  /// The samples added on one processor. |writers| counts the threads which
+  /// are updating the cell.
+  struct alignas(kMetricCellSize) Cell {
+    volatile int32 writers;
+    volatile int32 count;
+    volatile int64 sum;
+    volatile int64 minimum;
+    volatile int64 maximum;
+    char padding[kMetricCellSize - 2 * sizeof(int32) - 3 * sizeof(int64)];
+  };
+
+  COMPILE_ASSERT(sizeof(Cell) == kMetricCellSize, invalid_timing_cell_size);
+
+  /// Adds |count| samples of |time_ms| each, summing up to |total_time_ms|.
+  void AddToCell(int64 count, int64 total_time_ms, int64 time_ms);
+
+  /// Merges the cells of |generation|.
+  TimingData Merge(int generation) const;
+
   void Clear();
 
-  TimingData data_;
+  /// Writers add samples to the cells of the current generation. Reset
+  /// switches the generation, waits for the writers still updating the cells
+  /// of the previous generation, then merges and clears these cells.
+  Cell cells_[2][kNumMetricCells];
+  volatile int32 generation_;
 };
 
 /// A convenience class to sample the time from construction to destruction
@@ -490,13 +574,94 @@ public:
   /// Nulls the metric and returns the current values.
   TristateBoolValue Reset();
 
-  /// Returns the current value - not threadsafe
-  TristateBoolValue value() const { return value_; };
+  /// Returns the current value.
+  TristateBoolValue value() const {
+    return static_cast<TristateBoolValue>(value_);
+  }
 
 private:
   DISALLOW_COPY_AND_ASSIGN(BoolMetric);
 
-  TristateBoolValue value_;
+  volatile long value_;  // NOLINT
+};
+
+/// A histogram metric counts samples in buckets of exponentially growing
+/// width. Samples from 0 to 3 have a bucket each. Each larger power of two is
+/// split in kSubBuckets buckets of equal width, so the relative error of a
+/// percentile is at most 25%. The last bucket also collects the samples
+/// from 2^21 up, which is about 35 minutes for samples in milliseconds.
+class HistogramMetric: public MetricBase {
+public:
+  enum {
+    kSubBuckets = 4,
+    kNumBuckets = 80,
+  };
+
+  struct HistogramData {
+    uint32 buckets[kNumBuckets];
+    int64 sum;
+  };
+
+  HistogramMetric(const char *name, MetricCollectionBase *coll);
+  HistogramMetric(const char *name, const HistogramData &value);
+
+  /// Adds a single sample to the metric. Negative samples count as zero.
+  void AddSample(int64 value);
+
+  /// Returns the current values.
+  HistogramData data() const;
+
+  /// Nulls the metric and returns the current values. Each bucket is reset
+  /// atomically, so no concurrently added sample is lost or counted twice.
+  /// The sum of a sample added while the metric is reset may be reported
+  /// with the next values, though.
+  HistogramData Reset();
+
+  /// Returns the index of the bucket |value| falls in.
+  static int BucketIndex(int64 value);
+
+  /// Returns the smallest sample of the bucket at |index|.
+  static int64 BucketMinimum(int index);
+
+  /// Returns the number of samples in |data|.
+  static uint32 Count(const HistogramData &data);
+
+  /// Returns the upper bound of the bucket which holds the |percent|
+  /// percentile of the samples in |data|, or zero if there are no samples.
+  static int64 Percentile(const HistogramData &data, int percent);
+
+private:
+  DISALLOW_COPY_AND_ASSIGN(HistogramMetric);
+
+  volatile int32 buckets_[kNumBuckets];
+  ShardedInt64 sum_;
+};
+
+/// A convenience class to sample the time from construction to destruction
+/// against a given histogram metric.
+class HistogramSample {
+public:
+  /// @param histogram the metric the sample is to be tallied against
+  explicit HistogramSample(HistogramMetric &histogram)
+      : histogram_(histogram) {
+  }
+
+  ~HistogramSample() {
+    const int64 time_ms(static_cast<int64>(timer_.GetElapsedMs()));
+    if (time_ms < 0) {
+      return;
+    }
+    histogram_.AddSample(time_ms);
+  }
+
+private:
+  /// Collects the sample for us.
+  omaha::HighresTimer timer_;
+
+  /// The metric we tally against.
+  HistogramMetric &histogram_;
+
+  DISALLOW_COPY_AND_ASSIGN(HistogramSample);
 };
 
 inline CountMetric &MetricBase::AsCount() {
@@ -523,6 +688,12 @@ inline BoolMetric &MetricBase::AsBool() {
   return static_cast<BoolMetric&>(*this);
 }
 
+inline HistogramMetric &MetricBase::AsHistogram() {
+  DCHECK_EQ(kHistogramType, type());
+
+  return static_cast<HistogramMetric&>(*this);
+}
+
 inline const CountMetric &MetricBase::AsCount() const {
   DCHECK_EQ(kCountType, type());
 
@@ -547,6 +718,12 @@ inline const BoolMetric &MetricBase::AsBool() const {
   return static_cast<const BoolMetric&>(*this);
 }
 
+inline const HistogramMetric &MetricBase::AsHistogram() const {
+  DCHECK_EQ(kHistogramType, type());
+
+  return static_cast<const HistogramMetric&>(*this);
+}
+
 }  // namespace stats_report
 
 #endif  // OMAHA_STATSREPORT_METRICS_H__
@@ -14,8 +14,10 @@
 // ========================================================================
 
 #include <algorithm>
+#include <iostream>
 #include <new>
 #include <ostream>
+#include <vector>
 
 #include "gtest/gtest.h"
 #include "omaha/statsreport/metrics.h"
@@ -32,6 +34,9 @@ DEFINE_METRIC_integer(integer);
 DECLARE_METRIC_bool(bool);
 DEFINE_METRIC_bool(bool);
 
+DECLARE_METRIC_histogram(histogram);
+DEFINE_METRIC_histogram(histogram);
+
 namespace stats_report {
 
 std::ostream& operator <<(std::ostream& str, const MetricIterator&it) {
@@ -46,6 +51,52 @@ protected:
   MetricCollection coll_;
 };
 
+// Hammers a count and a timing metric from several threads.
+class MetricsThreadsTest: public MetricsTest {
+protected:
+  MetricsThreadsTest(): count_("count", &coll_), timing_("timing", &coll_),
+       iterations_(0) {
+  }
+
+  // Runs |num_threads| threads, which add |iterations| times to the metrics,
+  // and returns the elapsed time in milliseconds. |while_running| is called
+  // on the calling thread while the threads run.
+  template <typename Callback>
+  ULONGLONG Run(int num_threads, int iterations, Callback while_running) {
+    iterations_ = iterations;
+
+    omaha::HighresTimer timer;
+    std::vector<HANDLE> threads;
+    for (int i = 0; i < num_threads; ++i) {
+      HANDLE thread = ::CreateThread(NULL, 0, &ThreadProc, this, 0, NULL);
+      EXPECT_TRUE(thread);
+      if (thread)
+        threads.push_back(thread);
+    }
+
+    while_running();
+
+    for (size_t i = 0; i < threads.size(); ++i) {
+      EXPECT_EQ(WAIT_OBJECT_0, ::WaitForSingleObject(threads[i], INFINITE));
+      ::CloseHandle(threads[i]);
+    }
+    return timer.GetElapsedMs();
+  }
+
+  static DWORD WINAPI ThreadProc(void *param) {
+    MetricsThreadsTest *test = static_cast<MetricsThreadsTest*>(param);
+    for (int i = 0; i < test->iterations_; ++i) {
+      ++test->count_;
+      test->timing_.AddSample(i % 100);
+    }
+    return 0;
+  }
+
+  CountMetric count_;
+  TimingMetric timing_;
+  int iterations_;
+};
+
 class MetricsEnumTest: public MetricsTest {
 public:
   virtual void SetUp() {
@@ -58,13 +109,15 @@ public:
 
 protected:
   MetricsEnumTest(): count_("count", &coll_), timing_("timing", &coll_),
-       integer_("integer", &coll_), bool_("bool", &coll_){
+       integer_("integer", &coll_), bool_("bool", &coll_),
+       histogram_("histogram", &coll_) {
   }
 
   CountMetric count_;
   TimingMetric timing_;
   IntegerMetric integer_;
   BoolMetric bool_;
+  HistogramMetric histogram_;
 };
 
 } // namespace
@@ -81,12 +134,14 @@ TEST_F(MetricsTest, Globals) {
 
   EXPECT_EQ(0, ::metric_integer.value());
   EXPECT_EQ(BoolMetric::kBoolUnset, ::metric_bool.Reset());
+  EXPECT_EQ(0, HistogramMetric::Count(::metric_histogram.Reset()));
 
   // Check for correct initialization
   EXPECT_STREQ("count", metric_count.name());
   EXPECT_STREQ("timing", metric_timing.name());
   EXPECT_STREQ("integer", metric_integer.name());
   EXPECT_STREQ("bool", metric_bool.name());
+  EXPECT_STREQ("histogram", metric_histogram.name());
 }
 
 TEST_F(MetricsTest, CollectionInitialization) {
@@ -258,12 +313,78 @@ TEST_F(MetricsTest, Bool) {
   EXPECT_EQ(BoolMetric::kBoolUnset, foo.Reset());
 }
 
+TEST_F(MetricsTest, Histogram) {
+  HistogramMetric foo("foo", &coll_);
+
+  EXPECT_EQ(kHistogramType, foo.type());
+  HistogramMetric &foo_ref = foo.AsHistogram();
+
+  for (int i = 1; i <= 100; ++i)
+    foo.AddSample(i);
+  foo.AddSample(-5);
+
+  HistogramMetric::HistogramData data = foo.data();
+  EXPECT_EQ(101, HistogramMetric::Count(data));
+  EXPECT_EQ(5050, data.sum);
+  EXPECT_EQ(1, data.buckets[0]);
+
+  // The percentiles are the upper bounds of the buckets, which are at most
+  // 25% above the exact values.
+  EXPECT_EQ(55, HistogramMetric::Percentile(data, 50));
+  EXPECT_EQ(95, HistogramMetric::Percentile(data, 95));
+  EXPECT_EQ(111, HistogramMetric::Percentile(data, 99));
+
+  data = foo.Reset();
+  EXPECT_EQ(101, HistogramMetric::Count(data));
+  EXPECT_EQ(0, HistogramMetric::Count(foo.data()));
+  EXPECT_EQ(0, foo.data().sum);
+  EXPECT_EQ(0, HistogramMetric::Percentile(foo.data(), 50));
+}
+
+TEST_F(MetricsTest, HistogramBuckets) {
+  for (int64 value = 0; value < 4; ++value) {
+    EXPECT_EQ(value, HistogramMetric::BucketIndex(value));
+    EXPECT_EQ(value, HistogramMetric::BucketMinimum(static_cast<int>(value)));
+  }
+
+  // Each bucket starts right after the previous one and is at most a
+  // quarter as wide as its minimum.
+  for (int i = 1; i < HistogramMetric::kNumBuckets; ++i) {
+    const int64 minimum = HistogramMetric::BucketMinimum(i);
+    const int64 previous = HistogramMetric::BucketMinimum(i - 1);
+    EXPECT_LT(previous, minimum);
+    EXPECT_LE((minimum - previous) * 4, std::max<int64>(minimum, 4));
+    EXPECT_EQ(i, HistogramMetric::BucketIndex(minimum));
+    EXPECT_EQ(i - 1, HistogramMetric::BucketIndex(minimum - 1));
+  }
+
+  EXPECT_EQ(HistogramMetric::kNumBuckets - 1,
+            HistogramMetric::BucketIndex(int64(1) << 40));
+  EXPECT_EQ(0, HistogramMetric::BucketIndex(-1));
+}
+
+TEST_F(MetricsTest, HistogramSample) {
+  HistogramMetric foo("foo", &coll_);
+
+  {
+    HistogramSample sample(foo);
+
+    ::Sleep(30);
+  }
+
+  HistogramMetric::HistogramData data = foo.Reset();
+  EXPECT_EQ(1, HistogramMetric::Count(data));
+  EXPECT_GE(30 + 70, data.sum);
+  EXPECT_LE(14, data.sum);
+}
+
 TEST_F(MetricsEnumTest, Enumeration) {
   MetricBase *metrics[] = {
         &count_,
         &timing_,
         &integer_,
         &bool_,
+        &histogram_,
   };
 
   for (int i = 0; i < sizeof(metrics) / sizeof(metrics[0]); ++i) {
@@ -282,7 +403,9 @@ TEST_F(MetricsEnumTest, Enumeration) {
 
 TEST_F(MetricsEnumTest, Iterator) {
   typedef MetricBase *MetricBasePtr;
-  MetricBasePtr metrics[] = { &count_, &timing_, &integer_, &bool_, };
+  MetricBasePtr metrics[] = {
+      &count_, &timing_, &integer_, &bool_, &histogram_,
+  };
   int num_stats = sizeof(metrics) / sizeof(metrics[0]);
 
   MetricIterator it(coll_), end;
@@ -356,6 +479,94 @@ TEST_F(MetricsTest, SimpleConstruction) {
   EXPECT_EQ(kBoolType, bool_false.type());
   EXPECT_STREQ("bool_false", bool_false.name());
   EXPECT_TRUE(NULL == bool_false.next());
+
+  HistogramMetric::HistogramData histogram_data = {};
+  histogram_data.buckets[3] = 2;
+  histogram_data.sum = 6;
+  const HistogramMetric h("h", histogram_data);
+
+  EXPECT_EQ(2, HistogramMetric::Count(h.data()));
+  EXPECT_EQ(6, h.data().sum);
+  EXPECT_EQ(kHistogramType, h.type());
+  EXPECT_STREQ("h", h.name());
+  EXPECT_TRUE(NULL == h.next());
+}
+
+TEST_F(MetricsTest, ShardedInt64) {
+  ShardedInt64 value;
+
+  EXPECT_EQ(0, value.Sum());
+  value.Add(10);
+  value.Add(-3);
+  EXPECT_EQ(7, value.Sum());
+  EXPECT_EQ(7, value.Exchange(100));
+  EXPECT_EQ(100, value.Sum());
+  EXPECT_EQ(100, value.Exchange(0));
+  EXPECT_EQ(0, value.Sum());
+
+  EXPECT_LE(0, CurrentMetricCell());
+  EXPECT_GT(kNumMetricCells, CurrentMetricCell());
+}
+
+TEST_F(MetricsThreadsTest, ConcurrentWriters) {
+  const int kNumThreads = 8;
+  const int kIterations = 100000;
+
+  Run(kNumThreads, kIterations, [] {});
+
+  EXPECT_EQ(kNumThreads * kIterations, count_.value());
+
+  TimingMetric::TimingData data = timing_.Reset();
+  EXPECT_EQ(kNumThreads * kIterations, data.count);
+  EXPECT_EQ(kNumThreads * (kIterations / 100) * (99 * 100 / 2), data.sum);
+  EXPECT_EQ(0, data.minimum);
+  EXPECT_EQ(99, data.maximum);
+}
+
+// Resets the metrics while the writers run, as the aggregator does. No sample
+// is lost or counted twice.
+TEST_F(MetricsThreadsTest, ResetWhileWriting) {
+  const int kNumThreads = 8;
+  const int kIterations = 100000;
+
+  int64 counts = 0;
+  int64 samples = 0;
+  int64 sum = 0;
+  Run(kNumThreads, kIterations, [&] {
+    for (int i = 0; i < 100; ++i) {
+      counts += count_.Reset();
+      TimingMetric::TimingData data = timing_.Reset();
+      samples += data.count;
+      sum += data.sum;
+      ::Sleep(0);
+    }
+  });
+
+  counts += count_.Reset();
+  TimingMetric::TimingData data = timing_.Reset();
+  samples += data.count;
+  sum += data.sum;
+
+  EXPECT_EQ(kNumThreads * kIterations, counts);
+  EXPECT_EQ(kNumThreads * kIterations, samples);
+  EXPECT_EQ(kNumThreads * (kIterations / 100) * (99 * 100 / 2), sum);
+}
+
+// Reports the number of metric updates per second as the number of threads
+// updating the same metrics grows.
+TEST_F(MetricsThreadsTest, DISABLED_Contention) {
+  const int kIterations = 1000000;
+
+  for (int num_threads = 1; num_threads <= 32; num_threads *= 2) {
+    const ULONGLONG elapsed_ms = Run(num_threads, kIterations, [] {});
+    EXPECT_EQ(num_threads * kIterations, count_.Reset());
+    EXPECT_EQ(num_threads * kIterations, timing_.Reset().count);
+
+    std::cout << num_threads << " threads: "
+              << 2 * num_threads * static_cast<ULONGLONG>(kIterations) /
+                     (elapsed_ms + 1) / 1000
+              << " million updates/s" << std::endl;
+  }
 }
 
 }  // namespace stats_reports
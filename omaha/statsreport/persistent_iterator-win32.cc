@@ -51,6 +51,10 @@ void PersistentMetricsIteratorWin32::Next() {
         subkey_name = kBooleansKeyName;
         break;
        case kBooleans:
+        state_ = kHistograms;
+        subkey_name = kHistogramsKeyName;
+        break;
+       case kHistograms:
         state_ = kFinished;
         break;
        case kFinished:
@@ -73,7 +77,8 @@ void PersistentMetricsIteratorWin32::Next() {
       CString wide_value_name;
       DWORD value_name_len = 255;
       DWORD value_type = 0;
-      BYTE buf[sizeof(TimingMetric::TimingData)];
+      // Histograms are the largest values.
+      BYTE buf[sizeof(HistogramMetric::HistogramData)];
       DWORD value_len = sizeof(buf);
 
       // Get the next key and value
@@ -124,6 +129,13 @@ void PersistentMetricsIteratorWin32::Next() {
           current_value_.reset(new BoolMetric(current_value_name_.GetString(),
                                           *reinterpret_cast<uint32*>(&buf[0])));
           break;
+         case kHistograms:
+          if (value_len != sizeof(HistogramMetric::HistogramData))
+            continue;
+          current_value_.reset(new HistogramMetric(
+              current_value_name_.GetString(),
+              *reinterpret_cast<HistogramMetric::HistogramData*>(&buf[0])));
+          break;
          default:
           DCHECK(false && "Impossible state during reg value enumeration");
           break;
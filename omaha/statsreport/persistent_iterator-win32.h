@@ -89,6 +89,7 @@ class PersistentMetricsIteratorWin32
     kTimings,
     kIntegers,
     kBooleans,
+    kHistograms,
     kFinished,
   };
 
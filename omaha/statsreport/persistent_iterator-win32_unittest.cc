@@ -81,6 +81,14 @@ bool equals(MetricBase *a, MetricBase *b) {
    case kBoolType:
     return a->AsBool().value() == b->AsBool().value();
     break;
+   case kHistogramType: {
+      HistogramMetric::HistogramData ah = a->AsHistogram().data();
+      HistogramMetric::HistogramData bh = b->AsHistogram().data();
+
+      return 0 == memcmp(ah.buckets, bh.buckets, sizeof(ah.buckets)) &&
+             ah.sum == bh.sum;
+    }
+    break;
 
    case kInvalidType:
    default: